@@ -333,54 +333,181 @@ bgp_adj_out_remove (struct bgp_node *rn, struct bgp_adj_out *adj,
   bgp_adj_out_free (adj);
 }
 
-void
-bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr)
+/* Entries in use across all peers, for "show bgp memory".  */
+static unsigned long adj_in_count;
+
+static struct bgp_adj_in *
+bgp_adj_in_alloc (struct peer *peer)
+{
+  struct bgp_adj_in_arena *arena;
+  struct bgp_adj_in_chunk *chunk;
+  struct bgp_adj_in *adj;
+
+  if (! peer->adj_in_arena)
+    peer->adj_in_arena = XCALLOC (MTYPE_BGP_ADJ_IN_ARENA,
+				  sizeof (struct bgp_adj_in_arena));
+  arena = peer->adj_in_arena;
+
+  if (arena->free)
+    {
+      adj = arena->free;
+      arena->free = adj->next;
+    }
+  else
+    {
+      if (! arena->fresh)
+	{
+	  chunk = XMALLOC (MTYPE_BGP_ADJ_IN, sizeof (struct bgp_adj_in_chunk));
+	  chunk->next = arena->chunks;
+	  arena->chunks = chunk;
+	  arena->fresh = BGP_ADJ_IN_CHUNK_SIZE;
+	}
+      adj = &arena->chunks->entry[BGP_ADJ_IN_CHUNK_SIZE - arena->fresh--];
+    }
+
+  arena->count++;
+  adj_in_count++;
+  memset (adj, 0, sizeof (struct bgp_adj_in));
+  return adj;
+}
+
+static void
+bgp_adj_in_release (struct peer *peer, struct bgp_adj_in *adj)
+{
+  struct bgp_adj_in_arena *arena = peer->adj_in_arena;
+  struct bgp_adj_in_chunk *chunk, *next;
+
+  adj_in_count--;
+  if (--arena->count)
+    {
+      adj->next = arena->free;
+      arena->free = adj;
+      return;
+    }
+
+  /* That was the last one, drop the lot.  */
+  for (chunk = arena->chunks; chunk; chunk = next)
+    {
+      next = chunk->next;
+      XFREE (MTYPE_BGP_ADJ_IN, chunk);
+    }
+  XFREE (MTYPE_BGP_ADJ_IN_ARENA, peer->adj_in_arena);
+}
+
+/* Record attr, as received from peer for rn, in the Adj-RIB-In.
+   accepted is what inbound policy made of it, if the route was not
+   filtered.  When policy left the attributes alone, the interned
+   accepted attr is all the Adj-RIB-In needs, so no entry is kept and 1
+   is returned; the caller then flags the route with BGP_INFO_ADJ_IN.  */
+int
+bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr,
+		struct attr *accepted)
 {
   struct bgp_adj_in *adj;
 
   for (adj = rn->adj_in; adj; adj = adj->next)
+    if (adj->peer == peer)
+      break;
+
+  if (accepted && attrhash_cmp (accepted, attr))
     {
-      if (adj->peer == peer)
+      if (adj)
 	{
-	  if (adj->attr != attr)
-	    {
-	      bgp_attr_unintern (&adj->attr);
-	      adj->attr = bgp_attr_intern (attr);
-	    }
-	  return;
+	  bgp_adj_in_remove (rn, adj);
+	  bgp_unlock_node (rn);
 	}
+      return 1;
     }
-  adj = XCALLOC (MTYPE_BGP_ADJ_IN, sizeof (struct bgp_adj_in));
+
+  if (adj)
+    {
+      if (adj->attr != attr)
+	{
+	  bgp_attr_unintern (&adj->attr);
+	  adj->attr = bgp_attr_intern (attr);
+	}
+      adj->stale = 0;
+      return 0;
+    }
+
+  adj = bgp_adj_in_alloc (peer);
   adj->peer = peer_lock (peer); /* adj_in peer reference */
   adj->attr = bgp_attr_intern (attr);
   BGP_ADJ_IN_ADD (rn, adj);
   bgp_lock_node (rn);
+  return 0;
 }
 
 void
 bgp_adj_in_remove (struct bgp_node *rn, struct bgp_adj_in *bai)
 {
+  struct peer *peer = bai->peer;
+
   bgp_attr_unintern (&bai->attr);
   BGP_ADJ_IN_DEL (rn, bai);
-  peer_unlock (bai->peer); /* adj_in peer reference */
-  XFREE (MTYPE_BGP_ADJ_IN, bai);
+  bgp_adj_in_release (peer, bai);
+  peer_unlock (peer); /* adj_in peer reference */
+}
+
+static struct bgp_info *
+bgp_adj_in_shared (struct bgp_node *rn, const struct peer *peer)
+{
+  struct bgp_info *ri;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer && CHECK_FLAG (ri->flags, BGP_INFO_ADJ_IN)
+	&& ! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+      return ri;
+  return NULL;
 }
 
 int
 bgp_adj_in_unset (struct bgp_node *rn, struct peer *peer)
 {
   struct bgp_adj_in *adj;
+  struct bgp_info *ri;
 
   for (adj = rn->adj_in; adj; adj = adj->next)
     if (adj->peer == peer)
       break;
 
-  if (! adj)
-    return 0;
+  if (adj)
+    {
+      bgp_adj_in_remove (rn, adj);
+      bgp_unlock_node (rn);
+      return 1;
+    }
 
-  bgp_adj_in_remove (rn, adj);
-  bgp_unlock_node (rn);
-  return 1;
+  if ((ri = bgp_adj_in_shared (rn, peer)) != NULL)
+    {
+      bgp_info_unset_flag (rn, ri, BGP_INFO_ADJ_IN);
+      return 1;
+    }
+
+  return 0;
+}
+
+/* The attributes peer sent for rn, before inbound policy.  */
+struct attr *
+bgp_adj_in_lookup (struct bgp_node *rn, const struct peer *peer)
+{
+  struct bgp_adj_in *adj;
+  struct bgp_info *ri;
+
+  for (adj = rn->adj_in; adj; adj = adj->next)
+    if (adj->peer == peer)
+      return adj->attr;
+
+  if ((ri = bgp_adj_in_shared (rn, peer)) != NULL)
+    return ri->attr;
+
+  return NULL;
+}
+
+unsigned long
+bgp_adj_in_count (void)
+{
+  return adj_in_count;
 }
 
 void
@@ -95,6 +95,36 @@ struct bgp_adj_in
 
   /* Received attribute.  */
   struct attr *attr;
+
+  /* Not received again yet in an enhanced route refresh, see
+     bgp_set_stale_route.  */
+  u_char stale;
+};
+
+/* Adj-RIB-In entries are carved out of per-peer chunks rather than
+   allocated one by one, and a peer's chunks are all released together
+   once its last entry has gone, as happens when the session resets.  */
+#define BGP_ADJ_IN_CHUNK_SIZE 1024
+
+struct bgp_adj_in_chunk
+{
+  struct bgp_adj_in_chunk *next;
+  struct bgp_adj_in entry[BGP_ADJ_IN_CHUNK_SIZE];
+};
+
+struct bgp_adj_in_arena
+{
+  /* Chunks, newest first.  */
+  struct bgp_adj_in_chunk *chunks;
+
+  /* Entries of the newest chunk not handed out yet.  */
+  unsigned int fresh;
+
+  /* Entries given back, linked through their next pointer.  */
+  struct bgp_adj_in *free;
+
+  /* Entries in use.  */
+  unsigned long count;
 };
 
 /* BGP advertisement list.  */
@@ -160,9 +190,12 @@ extern void bgp_adj_out_remove (struct bgp_node *, struct bgp_adj_out *,
 extern int bgp_adj_out_lookup (struct peer *, struct prefix *, afi_t, safi_t,
 			struct bgp_node *);
 
-extern void bgp_adj_in_set (struct bgp_node *, struct peer *, struct attr *);
+extern int bgp_adj_in_set (struct bgp_node *, struct peer *, struct attr *,
+			   struct attr *);
 extern int bgp_adj_in_unset (struct bgp_node *, struct peer *);
 extern void bgp_adj_in_remove (struct bgp_node *, struct bgp_adj_in *);
+extern struct attr *bgp_adj_in_lookup (struct bgp_node *, const struct peer *);
+extern unsigned long bgp_adj_in_count (void);
 
 extern struct bgp_advertise *
 bgp_advertise_clean (struct peer *, struct bgp_adj_out *, afi_t, safi_t);
@@ -92,6 +92,16 @@ static struct hash *ashash;
 /* Stream for SNMP. See aspath_snmp_pathseg */
 static struct stream *snmp_stream;
 
+/* AS path strings are only rendered when something asks for one, and
+ * are kept for at most ASPATH_STR_CACHE_SIZE paths at a time, the
+ * oldest giving way to the newest.  A string returned by aspath_print()
+ * therefore stays valid until that many other paths have been printed,
+ * or the path itself is changed or freed.
+ */
+#define ASPATH_STR_CACHE_SIZE 16384
+static struct aspath *aspath_str_cache[ASPATH_STR_CACHE_SIZE];
+static unsigned int aspath_str_cache_next;
+
 /* Callers are required to initialize the memory */
 static as_t *
 assegment_data_new (int num)
@@ -317,6 +327,24 @@ assegment_normalise (struct assegment *head)
   return head;
 }
 
+/* Drop the rendered string, after the path has changed or before it
+   is freed. */
+static void
+aspath_str_clear (struct aspath *as)
+{
+  if (as->str)
+    {
+      XFREE (MTYPE_AS_STR, as->str);
+      as->str = NULL;
+      as->str_len = 0;
+    }
+  if (as->str_slot)
+    {
+      aspath_str_cache[as->str_slot - 1] = NULL;
+      as->str_slot = 0;
+    }
+}
+
 static struct aspath *
 aspath_new (void)
 {
@@ -331,8 +359,7 @@ aspath_free (struct aspath *aspath)
     return;
   if (aspath->segments)
     assegment_free_all (aspath->segments);
-  if (aspath->str)
-    XFREE (MTYPE_AS_STR, aspath->str);
+  aspath_str_clear (aspath);
   XFREE (MTYPE_AS_PATH, aspath);
 }
 
@@ -496,6 +523,23 @@ aspath_leftmost (struct aspath *aspath)
   return leftmost;
 }
 
+/* The AS the path originated in, RFC 6811: the last AS of a path ending
+   in an AS_SEQUENCE, else 0.  Paths without any hop outside our own
+   confederation have no origin here, aspath_count_hops tells those. */
+as_t
+aspath_origin (struct aspath *aspath)
+{
+  struct assegment *seg, *last = NULL;
+
+  for (seg = aspath->segments; seg; seg = seg->next)
+    if (seg->length)
+      last = seg;
+
+  if (last && last->type == AS_SEQUENCE)
+    return last->as[last->length - 1];
+  return 0;
+}
+
 /* Return 1 if there are any 4-byte ASes in the path */
 unsigned int
 aspath_has_as4 (struct aspath *aspath)
@@ -620,12 +664,34 @@ aspath_make_str_count (struct aspath *as)
   return;
 }
 
-static void
-aspath_str_update (struct aspath *as)
+/* Return the string form of the path, rendering it if need be. */
+static const char *
+aspath_str (struct aspath *as)
 {
+  struct aspath *old;
+  unsigned int slot;
+
   if (as->str)
-    XFREE (MTYPE_AS_STR, as->str);
+    return as->str;
+
   aspath_make_str_count (as);
+  if (! as->str)
+    return NULL;
+
+  /* Make room in the cache. */
+  slot = aspath_str_cache_next;
+  aspath_str_cache_next = (slot + 1) % ASPATH_STR_CACHE_SIZE;
+  if ((old = aspath_str_cache[slot]) != NULL)
+    {
+      XFREE (MTYPE_AS_STR, old->str);
+      old->str = NULL;
+      old->str_len = 0;
+      old->str_slot = 0;
+    }
+  aspath_str_cache[slot] = as;
+  as->str_slot = slot + 1;
+
+  return as->str;
 }
 
 /* Intern allocated AS path. */
@@ -634,10 +700,8 @@ aspath_intern (struct aspath *aspath)
 {
   struct aspath *find;
 
-  /* Assert this AS path structure is not interned and has the string
-     representation built. */
+  /* Assert this AS path structure is not interned. */
   assert (aspath->refcnt == 0);
-  assert (aspath->str);
 
   /* Check AS path hash. */
   find = hash_get (ashash, aspath, hash_alloc_intern);
@@ -654,7 +718,6 @@ aspath_intern (struct aspath *aspath)
 struct aspath *
 aspath_dup (struct aspath *aspath)
 {
-  unsigned short buflen = aspath->str_len + 1;
   struct aspath *new;
 
   new = XCALLOC (MTYPE_AS_PATH, sizeof (struct aspath));
@@ -662,18 +725,6 @@ aspath_dup (struct aspath *aspath)
   if (aspath->segments)
     new->segments = assegment_dup_all (aspath->segments);
 
-  if (!aspath->str)
-    return new;
-
-  new->str = XMALLOC (MTYPE_AS_STR, buflen);
-  new->str_len = aspath->str_len;
-
-  /* copy the string data */
-  if (aspath->str_len > 0)
-    memcpy (new->str, aspath->str, buflen);
-  else
-    new->str[0] = '\0';
-
   return new;
 }
 
@@ -683,19 +734,15 @@ aspath_hash_alloc (void *arg)
   const struct aspath *aspath = arg;
   struct aspath *new;
 
-  /* Malformed AS path value. */
-  assert (aspath->str);
-  if (! aspath->str)
-    return NULL;
-
   /* New aspath structure is needed. */
-  new = XMALLOC (MTYPE_AS_PATH, sizeof (struct aspath));
+  new = XCALLOC (MTYPE_AS_PATH, sizeof (struct aspath));
 
-  /* Reuse segments and string representation */
-  new->refcnt = 0;
+  /* Reuse segments */
   new->segments = aspath->segments;
-  new->str = aspath->str;
-  new->str_len = aspath->str_len;
+
+  /* No as-path regex has been applied yet, 0 is never an id. */
+  new->regex_id = 0;
+  new->regex_match = 0;
 
   return new;
 }
@@ -830,11 +877,7 @@ aspath_parse (struct stream *s, size_t length, int use32bit)
 
   /* if the aspath was already hashed free temporary memory. */
   if (find->refcnt)
-    {
-      assegment_free_all (as.segments);
-      /* aspath_key_make() always updates the string */
-      XFREE (MTYPE_AS_STR, as.str);
-    }
+    assegment_free_all (as.segments);
 
   find->refcnt++;
 
@@ -1097,7 +1140,7 @@ aspath_aggregate (struct aspath *as1, struct aspath *as2)
     }
   
   assegment_normalise (aspath->segments);
-  aspath_str_update (aspath);
+  aspath_str_clear (aspath);
   return aspath;
 }
 
@@ -1219,7 +1262,7 @@ aspath_aggregate_mpath (struct aspath *as1, struct aspath *as2)
     }
 
   assegment_normalise (aspath->segments);
-  aspath_str_update (aspath);
+  aspath_str_clear (aspath);
   return aspath;
 }
 
@@ -1343,7 +1386,7 @@ aspath_merge (struct aspath *as1, struct aspath *as2)
   
   last->next = as2->segments;
   as2->segments = new;
-  aspath_str_update (as2);
+  aspath_str_clear (as2);
   return as2;
 }
 
@@ -1364,7 +1407,7 @@ aspath_prepend (struct aspath *as1, struct aspath *as2)
   if (seg2 == NULL)
     {
       as2->segments = assegment_dup_all (as1->segments);
-      aspath_str_update (as2);
+      aspath_str_clear (as2);
       return as2;
     }
   
@@ -1387,7 +1430,7 @@ aspath_prepend (struct aspath *as1, struct aspath *as2)
   if (seg2 == NULL)
     {
       as2->segments = assegment_dup_all (as1->segments);
-      aspath_str_update (as2);
+      aspath_str_clear (as2);
       return as2;
     }
   
@@ -1427,7 +1470,7 @@ aspath_prepend (struct aspath *as1, struct aspath *as2)
       /* we've now prepended as1's segment chain to as2, merging
        * the inbetween AS_SEQUENCE of seg2 in the process 
        */
-      aspath_str_update (as2);
+      aspath_str_clear (as2);
       return as2;
     }
   else
@@ -1506,7 +1549,7 @@ aspath_filter_exclude (struct aspath * source, struct aspath * exclude_list)
       lastseg->next = newseg;
     lastseg = newseg;
   }
-  aspath_str_update (newpath);
+  aspath_str_clear (newpath);
   /* We are happy returning even an empty AS_PATH, because the administrator
    * might expect this very behaviour. There's a mean to avoid this, if necessary,
    * by having a match rule against certain AS_PATH regexps in the route-map index.
@@ -1545,7 +1588,7 @@ aspath_add_asns (struct aspath *aspath, as_t asno, u_char type, unsigned num)
       aspath->segments = newsegment;
     }
 
-  aspath_str_update (aspath);
+  aspath_str_clear (aspath);
   return aspath;
 }
 
@@ -1639,7 +1682,7 @@ aspath_reconcile_as4 ( struct aspath *aspath, struct aspath *as4path)
   
   if ( BGP_DEBUG(as4, AS4))
     zlog_debug("[AS4] got AS_PATH %s and AS4_PATH %s synthesizing now",
-               aspath->str, as4path->str);
+               aspath_print (aspath), aspath_print (as4path));
 
   while (seg && hops > 0)
     {
@@ -1694,11 +1737,11 @@ aspath_reconcile_as4 ( struct aspath *aspath, struct aspath *as4path)
   mergedpath = aspath_merge (newpath, aspath_dup(as4path));
   aspath_free (newpath);
   mergedpath->segments = assegment_normalise (mergedpath->segments);
-  aspath_str_update (mergedpath);
+  aspath_str_clear (mergedpath);
   
   if ( BGP_DEBUG(as4, AS4))
     zlog_debug ("[AS4] result of synthesizing is %s",
-                mergedpath->str);
+                aspath_print (mergedpath));
   
   return mergedpath;
 }
@@ -1754,7 +1797,7 @@ aspath_delete_confed_seq (struct aspath *aspath)
       assegment_free (seg);
       seg = aspath->segments;
     }
-  aspath_str_update (aspath);
+  aspath_str_clear (aspath);
   return aspath;
 }
 
@@ -1811,7 +1854,6 @@ aspath_empty_get (void)
   struct aspath *aspath;
 
   aspath = aspath_new ();
-  aspath_make_str_count (aspath);
   return aspath;
 }
 
@@ -1970,8 +2012,6 @@ aspath_str2aspath (const char *str)
 	}
     }
 
-  aspath_make_str_count (aspath);
-
   return aspath;
 }
 
@@ -1980,13 +2020,23 @@ unsigned int
 aspath_key_make (void *p)
 {
   struct aspath *aspath = (struct aspath *) p;
-  unsigned int key = 0;
+  struct assegment *seg;
+  unsigned int key = 2334325;
 
-  if (!aspath->str)
-    aspath_str_update (aspath);
+  /* An interned path never changes, so its hash need only be worked
+   * out once.  Every attribute carrying the path hashes it again.
+   */
+  if (aspath->hash)
+    return aspath->hash;
 
-  key = jhash (aspath->str, aspath->str_len, 2334325);
+  for (seg = aspath->segments; seg; seg = seg->next)
+    {
+      key = jhash_2words (seg->type, seg->length, key);
+      key = jhash2 (seg->as, seg->length, key);
+    }
 
+  if (aspath->refcnt)
+    aspath->hash = key;
   return key;
 }
 
@@ -2037,7 +2087,7 @@ aspath_finish (void)
 const char *
 aspath_print (struct aspath *as)
 {
-  return (as ? as->str : NULL);
+  return (as ? aspath_str (as) : NULL);
 }
 
 /* Printing functions */
@@ -2048,7 +2098,7 @@ void
 aspath_print_vty (struct vty *vty, const char *format, struct aspath *as, const char * suffix)
 {
   assert (format);
-  vty_out (vty, format, as->str);
+  vty_out (vty, format, aspath_str (as));
   if (as->str_len && strlen (suffix))
     vty_out (vty, "%s", suffix);
 }
@@ -2061,7 +2111,7 @@ aspath_show_all_iterator (struct hash_backet *backet, struct vty *vty)
   as = (struct aspath *) backet->data;
 
   vty_out (vty, "[%p:%u] (%ld) ", (void *)backet, backet->key, as->refcnt);
-  vty_out (vty, "%s%s", as->str, VTY_NEWLINE);
+  vty_out (vty, "%s%s", aspath_str (as), VTY_NEWLINE);
 }
 
 /* Print all aspath and hash information.  This function is used from
@@ -64,9 +64,21 @@ struct aspath
   struct assegment *segments;
   
   /* String expression of AS path.  This string is used by vty output
-     and AS path regular expression match.  */
+     and AS path regular expression match.  It is rendered on demand,
+     use aspath_print() rather than reading it directly.  */
   char *str;
   unsigned short str_len;
+
+  /* Where the string sits in the cache of rendered strings, plus 1. */
+  u_int32_t str_slot;
+
+  /* Hash value, remembered once interned, see aspath_key_make. */
+  unsigned int hash;
+
+  /* Last as-path regex applied to this (interned) path and whether it
+     matched, see bgp_aspath_regexec. */
+  u_int32_t regex_id;
+  u_char regex_match;
 };
 
 #define ASPATH_STR_DEFAULT_LEN 32
@@ -108,6 +120,7 @@ extern unsigned int aspath_count_confeds (struct aspath *);
 extern unsigned int aspath_size (struct aspath *);
 extern as_t aspath_highest (struct aspath *);
 extern as_t aspath_leftmost (struct aspath *);
+extern as_t aspath_origin (struct aspath *);
 extern size_t aspath_put (struct stream *, struct aspath *, int);
 
 extern struct aspath *aspath_reconcile_as4 (struct aspath *, struct aspath *);
@@ -110,6 +110,7 @@ cluster_hash_alloc (void *p)
     cluster->list = NULL;
 
   cluster->refcnt = 0;
+  cluster->hash = 0;
 
   return cluster;
 }
@@ -143,9 +144,16 @@ cluster_loop_check (struct cluster_list *cluster, struct in_addr originator)
 static unsigned int
 cluster_hash_key_make (void *p)
 {
-  const struct cluster_list *cluster = p;
+  struct cluster_list *cluster = p;
+  unsigned int key;
 
-  return jhash(cluster->list, cluster->length, 0);
+  if (cluster->hash)
+    return cluster->hash;
+
+  key = jhash(cluster->list, cluster->length, 0);
+  if (cluster->refcnt)
+    cluster->hash = key;
+  return key;
 }
 
 static int
@@ -372,9 +380,16 @@ transit_unintern (struct transit *transit)
 static unsigned int
 transit_hash_key_make (void *p)
 {
-  const struct transit * transit = p;
+  struct transit * transit = p;
+  unsigned int key;
 
-  return jhash(transit->val, transit->length, 0);
+  if (transit->hash)
+    return transit->hash;
+
+  key = jhash(transit->val, transit->length, 0);
+  if (transit->refcnt)
+    transit->hash = key;
+  return key;
 }
 
 static int
@@ -404,6 +419,80 @@ transit_finish (void)
 /* Attribute hash routines. */
 static struct hash *attrhash;
 
+/* The extra attributes of an interned attr, if it has any, live in
+ * the same allocation right behind it, see bgp_attr_hash_alloc.
+ */
+#define ATTR_EXTRA_INLINE(attr)	((struct attr_extra *)((attr) + 1))
+
+/* Number of interned attrs carrying extra attributes. */
+static unsigned long attr_extra_inline_count;
+
+/* Wire encoding cache.  The encoded attribute set of an UPDATE depends
+ * on the interned attr and on the few properties of the receiving peer
+ * (and of the peer the route was learned from) which
+ * bgp_packet_attribute looks at.  Those properties are collected in the
+ * key, so peers which agree on them share one encoding.  Entries hang
+ * off the interned attr and are released along with it.
+ */
+struct attr_encode_key
+{
+  afi_t afi;
+  safi_t safi;
+  u_char sort;
+  u_char use32bit;
+  u_char replace_as;
+  u_char reflect;
+  u_int32_t af_flags;
+  as_t local_as;
+  as_t change_local_as;
+  as_t confed_id;
+  struct in_addr cluster_id;
+  struct in_addr originator_id;
+};
+
+struct attr_encode
+{
+  struct attr_encode *next;
+  struct attr_encode_key key;
+  bgp_size_t length;
+  u_char data[1];	/* will be extended */
+};
+
+/* Encodings kept per interned attribute, most recently used first. */
+#define ATTR_ENCODE_MAX 4
+
+#define ATTR_ENCODE_AF_FLAGS (PEER_FLAG_SEND_COMMUNITY \
+                              | PEER_FLAG_SEND_EXT_COMMUNITY \
+                              | PEER_FLAG_SEND_LARGE_COMMUNITY \
+                              | PEER_FLAG_AS_PATH_UNCHANGED \
+                              | PEER_FLAG_RSERVER_CLIENT)
+
+static unsigned long attr_encode_hit;
+static unsigned long attr_encode_miss;
+static unsigned long attr_encode_bytes;
+
+static void
+attr_encode_free_all (struct attr *attr)
+{
+  struct attr_encode *enc;
+
+  while ((enc = attr->encode) != NULL)
+    {
+      attr->encode = enc->next;
+      attr_encode_bytes -= enc->length;
+      XFREE (MTYPE_ATTR_ENCODE, enc);
+    }
+}
+
+void
+attr_encode_stats (unsigned long *hit, unsigned long *miss,
+                   unsigned long *bytes)
+{
+  *hit = attr_encode_hit;
+  *miss = attr_encode_miss;
+  *bytes = attr_encode_bytes;
+}
+
 static struct attr_extra *
 bgp_attr_extra_new (void)
 {
@@ -442,6 +531,8 @@ bgp_attr_dup (struct attr *new, struct attr *orig)
   struct attr_extra *extra = new->extra;
 
   *new = *orig;
+  /* The copy is there to be changed, it is not interned. */
+  new->hash = 0;
   /* if caller provided attr_extra space, use it in any case.
    *
    * This is neccesary even if orig->extra equals NULL, because otherwise
@@ -483,6 +574,12 @@ attr_unknown_count (void)
   return transit_hash->count;
 }
 
+unsigned long int
+attr_extra_count (void)
+{
+  return attr_extra_inline_count;
+}
+
 unsigned int
 attrhash_key_make (void *p)
 {
@@ -491,10 +588,15 @@ attrhash_key_make (void *p)
   uint32_t key = 0;
 #define MIX(val)	key = jhash_1word(val, key)
 
+  /* Interned, so the hash was worked out when it was allocated. */
+  if (attr->hash)
+    return attr->hash;
+
   MIX(attr->origin);
   MIX(attr->nexthop.s_addr);
   MIX(attr->med);
   MIX(attr->local_pref);
+  MIX(attr->weight);
 
   key += attr->origin;
   key += attr->nexthop.s_addr;
@@ -505,7 +607,6 @@ attrhash_key_make (void *p)
     {
       MIX(extra->aggregator_as);
       MIX(extra->aggregator_addr.s_addr);
-      MIX(extra->weight);
       MIX(extra->mp_nexthop_global_in.s_addr);
       MIX(extra->originator_id.s_addr);
       MIX(extra->tag);
@@ -541,13 +642,24 @@ attrhash_cmp (const void *p1, const void *p2)
   const struct attr * attr1 = p1;
   const struct attr * attr2 = p2;
 
+  if (attr1 == attr2)
+    return 1;
+
+  /* Two interned attributes with different hashes can't be equal. */
+  if (attr1->hash && attr2->hash && attr1->hash != attr2->hash)
+    return 0;
+
+  /* Everything hanging off an attribute being interned is interned
+   * already, so the sub-objects can be compared by pointer.
+   */
   if (attr1->flag == attr2->flag
       && attr1->origin == attr2->origin
       && attr1->nexthop.s_addr == attr2->nexthop.s_addr
       && attr1->aspath == attr2->aspath
       && attr1->community == attr2->community
       && attr1->med == attr2->med
-      && attr1->local_pref == attr2->local_pref)
+      && attr1->local_pref == attr2->local_pref
+      && attr1->weight == attr2->weight)
     {
       const struct attr_extra *ae1 = attr1->extra;
       const struct attr_extra *ae2 = attr2->extra;
@@ -555,7 +667,6 @@ attrhash_cmp (const void *p1, const void *p2)
       if (ae1 && ae2
           && ae1->aggregator_as == ae2->aggregator_as
           && ae1->aggregator_addr.s_addr == ae2->aggregator_addr.s_addr
-          && ae1->weight == ae2->weight
           && ae1->tag == ae2->tag
           && ae1->mp_nexthop_len == ae2->mp_nexthop_len
           && IPV6_ADDR_SAME (&ae1->mp_nexthop_global, &ae2->mp_nexthop_global)
@@ -584,14 +695,28 @@ attrhash_init (void)
   attrhash = hash_create (attrhash_key_make, attrhash_cmp);
 }
 
+static void
+bgp_attr_interned_free (struct attr *attr)
+{
+  attr_encode_free_all (attr);
+  if (attr->extra && attr->extra == ATTR_EXTRA_INLINE (attr))
+    {
+      encap_free (attr->extra->encap_subtlvs);
+      attr->extra = NULL;
+      attr_extra_inline_count--;
+    }
+  else
+    bgp_attr_extra_free (attr);
+  XFREE (MTYPE_ATTR, attr);
+}
+
 /*
  * special for hash_clean below
  */
 static void
 attr_vfree (void *attr)
 {
-  bgp_attr_extra_free ((struct attr *)attr);
-  XFREE (MTYPE_ATTR, attr);
+  bgp_attr_interned_free ((struct attr *)attr);
 }
 
 static void
@@ -626,18 +751,27 @@ bgp_attr_hash_alloc (void *p)
   struct attr * val = (struct attr *) p;
   struct attr *attr;
 
-  attr = XMALLOC (MTYPE_ATTR, sizeof (struct attr));
-  *attr = *val;
-  if (val->extra)
+  if (! val->extra)
+    {
+      attr = XMALLOC (MTYPE_ATTR, sizeof (struct attr));
+      *attr = *val;
+    }
+  else
     {
-      attr->extra = bgp_attr_extra_new ();
+      attr = XMALLOC (MTYPE_ATTR, sizeof (struct attr)
+                                  + sizeof (struct attr_extra));
+      *attr = *val;
+      attr->extra = ATTR_EXTRA_INLINE (attr);
       *attr->extra = *val->extra;
+      attr_extra_inline_count++;
 
       if (attr->extra->encap_subtlvs) {
 	attr->extra->encap_subtlvs = encap_tlv_dup(attr->extra->encap_subtlvs);
       }
     }
+  attr->encode = NULL;
   attr->refcnt = 0;
+  attr->hash = attrhash_key_make (attr);
   return attr;
 }
 
@@ -715,7 +849,7 @@ bgp_attr_default_set (struct attr *attr, u_char origin)
   attr->flag |= ATTR_FLAG_BIT (BGP_ATTR_ORIGIN);
   attr->aspath = aspath_empty ();
   attr->flag |= ATTR_FLAG_BIT (BGP_ATTR_AS_PATH);
-  attr->extra->weight = BGP_ATTR_DEFAULT_WEIGHT;
+  attr->weight = BGP_ATTR_DEFAULT_WEIGHT;
   attr->extra->tag = 0;
   attr->flag |= ATTR_FLAG_BIT (BGP_ATTR_NEXT_HOP);
   attr->extra->mp_nexthop_len = IPV6_MAX_BYTELEN;
@@ -778,7 +912,7 @@ bgp_attr_aggregate_intern (struct bgp *bgp, u_char origin,
       attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_COMMUNITIES);
     }
 
-  attre.weight = BGP_ATTR_DEFAULT_WEIGHT;
+  attr.weight = BGP_ATTR_DEFAULT_WEIGHT;
   attre.mp_nexthop_len = IPV6_MAX_BYTELEN;
 
   if (! as_set || atomic_aggregate)
@@ -853,8 +987,7 @@ bgp_attr_unintern (struct attr **pattr)
     {
       ret = hash_release (attrhash, attr);
       assert (ret != NULL);
-      bgp_attr_extra_free (attr);
-      XFREE (MTYPE_ATTR, attr);
+      bgp_attr_interned_free (attr);
       *pattr = NULL;
     }
 
@@ -3049,6 +3182,108 @@ bgp_packet_attribute (struct bgp *bgp, struct peer *peer,
   return stream_get_endp (s) - cp;
 }
 
+static void
+attr_encode_key_make (struct attr_encode_key *key, struct bgp *bgp,
+                      struct peer *peer, struct attr *attr,
+                      afi_t afi, safi_t safi, struct peer *from)
+{
+  memset (key, 0, sizeof (struct attr_encode_key));
+
+  key->afi = afi;
+  key->safi = safi;
+  key->sort = peer->sort;
+  key->use32bit = CHECK_FLAG (peer->cap, PEER_CAP_AS4_RCV) ? 1 : 0;
+  key->replace_as = CHECK_FLAG (peer->flags, PEER_FLAG_LOCAL_AS_REPLACE_AS)
+                    ? 1 : 0;
+  key->af_flags = peer->af_flags[afi][safi] & ATTR_ENCODE_AF_FLAGS;
+  key->local_as = peer->local_as;
+  key->change_local_as = peer->change_local_as;
+
+  if (CHECK_FLAG (bgp->config, BGP_CONFIG_CONFEDERATION))
+    key->confed_id = bgp->confed_id;
+
+  /* Reflected routes carry ORIGINATOR_ID and CLUSTER_LIST built from
+   * the source peer and our own cluster id.
+   */
+  if (peer->sort == BGP_PEER_IBGP && from && from->sort == BGP_PEER_IBGP)
+    {
+      key->reflect = 1;
+      if (bgp->config & BGP_CONFIG_CLUSTER_ID)
+        key->cluster_id = bgp->cluster_id;
+      else
+        key->cluster_id = bgp->router_id;
+      if (! (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID)))
+        key->originator_id = from->remote_id;
+    }
+}
+
+/* Write the attribute set of an interned ATTR, as bgp_packet_attribute
+ * would for an UPDATE without an embedded MP_REACH_NLRI, reusing an
+ * earlier encoding for an equivalent peer where there is one.
+ */
+bgp_size_t
+bgp_packet_attribute_cached (struct bgp *bgp, struct peer *peer,
+                             struct stream *s, struct attr *attr,
+                             afi_t afi, safi_t safi, struct peer *from)
+{
+  struct attr_encode_key key;
+  struct attr_encode *enc;
+  struct attr_encode *prev;
+  bgp_size_t length;
+  size_t cp;
+  int count;
+
+  if (! bgp)
+    bgp = bgp_get_default ();
+
+  /* Only interned attributes have a stable identity to cache on. */
+  if (! attr->refcnt)
+    return bgp_packet_attribute (bgp, peer, s, attr, NULL, afi, safi,
+                                 from, NULL, NULL);
+
+  attr_encode_key_make (&key, bgp, peer, attr, afi, safi, from);
+
+  for (prev = NULL, enc = attr->encode, count = 0; enc;
+       prev = enc, enc = enc->next, count++)
+    if (memcmp (&enc->key, &key, sizeof (struct attr_encode_key)) == 0)
+      {
+        if (prev)
+          {
+            prev->next = enc->next;
+            enc->next = attr->encode;
+            attr->encode = enc;
+          }
+        attr_encode_hit++;
+        stream_put (s, enc->data, enc->length);
+        return enc->length;
+      }
+
+  attr_encode_miss++;
+  cp = stream_get_endp (s);
+  length = bgp_packet_attribute (bgp, peer, s, attr, NULL, afi, safi,
+                                 from, NULL, NULL);
+
+  /* Drop the least recently used encoding when the list is full. */
+  if (count >= ATTR_ENCODE_MAX)
+    {
+      for (prev = attr->encode; prev->next->next; prev = prev->next)
+        ;
+      attr_encode_bytes -= prev->next->length;
+      XFREE (MTYPE_ATTR_ENCODE, prev->next);
+      prev->next = NULL;
+    }
+
+  enc = XMALLOC (MTYPE_ATTR_ENCODE, sizeof (struct attr_encode) + length);
+  memcpy (&enc->key, &key, sizeof (struct attr_encode_key));
+  enc->length = length;
+  memcpy (enc->data, STREAM_DATA (s) + cp, length);
+  enc->next = attr->encode;
+  attr->encode = enc;
+  attr_encode_bytes += length;
+
+  return length;
+}
+
 size_t
 bgp_packet_mpunreach_start (struct stream *s, afi_t afi, safi_t safi)
 {
@@ -56,7 +56,8 @@ struct bgp_attr_encap_subtlv {
 
 /* Additional/uncommon BGP attributes.
  * lazily allocated as and when a struct attr
- * requires it.
+ * requires it.  An interned attr keeps these in the same allocation,
+ * right behind it.
  */
 struct attr_extra
 {
@@ -84,9 +85,6 @@ struct attr_extra
   /* Route Reflector Originator attribute */
   struct in_addr originator_id;
   
-  /* Local weight, not actually an attribute */
-  u_int32_t weight;
-  
   /* Aggregator ASN */
   as_t aggregator_as;
   
@@ -100,21 +98,18 @@ struct attr_extra
   route_tag_t tag;
 };
 
-/* BGP core attribute structure. */
+/* BGP core attribute structure.  What best path selection and
+ * interning look at comes first, so that in the common case they stay
+ * within the first cache line.
+ */
 struct attr
 {
   /* AS Path structure */
   struct aspath *aspath;
 
-  /* Community structure */
-  struct community *community;	
-  
   /* Lazily allocated pointer to extra attributes */
   struct attr_extra *extra;
   
-  /* Reference count of this attribute. */
-  unsigned long refcnt;
-
   /* Flag of attribute is set or not. */
   u_int32_t flag;
   
@@ -123,8 +118,23 @@ struct attr
   u_int32_t med;
   u_int32_t local_pref;
   
+  /* Local weight, not actually an attribute */
+  u_int32_t weight;
+  
+  /* Hash value, only ever set on interned attributes */
+  unsigned int hash;
+
   /* Path origin attribute */
   u_char origin;
+
+  /* Reference count of this attribute. */
+  unsigned long refcnt;
+
+  /* Community structure */
+  struct community *community;	
+  
+  /* Cached wire encodings, only ever set on interned attributes */
+  struct attr_encode *encode;
 };
 
 /* Router Reflector related structure. */
@@ -133,6 +143,7 @@ struct cluster_list
   unsigned long refcnt;
   int length;
   struct in_addr *list;
+  unsigned int hash;
 };
 
 /* Unknown transit attribute. */
@@ -141,6 +152,7 @@ struct transit
   unsigned long refcnt;
   int length;
   u_char *val;
+  unsigned int hash;
 };
 
 #define ATTR_FLAG_BIT(X)  (1 << ((X) - 1))
@@ -177,6 +189,9 @@ extern bgp_size_t bgp_packet_attribute (struct bgp *bgp, struct peer *,
 					struct prefix *, afi_t, safi_t,
 					struct peer *, struct prefix_rd *,
 					u_char *);
+extern bgp_size_t bgp_packet_attribute_cached (struct bgp *bgp, struct peer *,
+					       struct stream *, struct attr *,
+					       afi_t, safi_t, struct peer *);
 extern void bgp_dump_routes_attr (struct stream *, struct attr *,
 				  struct prefix *);
 extern int attrhash_cmp (const void *, const void *);
@@ -184,6 +199,9 @@ extern unsigned int attrhash_key_make (void *);
 extern void attr_show_all (struct vty *);
 extern unsigned long int attr_count (void);
 extern unsigned long int attr_unknown_count (void);
+extern unsigned long int attr_extra_count (void);
+extern void attr_encode_stats (unsigned long *, unsigned long *,
+                               unsigned long *);
 
 /* Cluster list prototypes. */
 extern int cluster_loop_check (struct cluster_list *, struct in_addr);
@@ -109,6 +109,331 @@ community_list_free (struct community_list *list)
   XFREE (MTYPE_COMMUNITY_LIST, list);
 }
 
+/* One entry of a compiled community-list.  */
+struct community_compiled_entry
+{
+  /* Permit or deny.  */
+  u_char direct;
+
+  /* The entry matches whatever the route carries: "any", or a
+     standard community entry naming "internet".  */
+  u_char always;
+
+  /* Number of values, and their positions in the sorted values of
+     the list.  */
+  int size;
+  int *pos;
+
+  /* Summary of the values.  */
+  u_int64_t bloom;
+};
+
+/* A standard community-list or large-community-list compiled for
+   matching.  The values named by all of its entries are merged into
+   one sorted array, so each value a route carries is looked up once,
+   however many entries the list has, and each entry is then a set of
+   positions in that array.  */
+struct community_list_compiled
+{
+  /* Size of one value: 4 for communities, 12 for large ones.  */
+  int width;
+
+  /* Every value named by an entry, sorted and unique, and their
+     summary.  */
+  int nvals;
+  u_char *vals;
+  u_int64_t bloom;
+
+  /* For each value, the first entry matching that value alone, as
+     when deleting values; -1 when none does.  Values not in the list
+     are only matched by the first "always" entry, first_any.  */
+  int *first;
+  int first_any;
+
+  /* The entries, in the order of the list.  */
+  int nentries;
+  struct community_compiled_entry *entries;
+
+  /* Storage for the positions of all the entries.  */
+  int *pos;
+};
+
+static u_int64_t
+community_list_bloom_bit (const u_char *pnt, int width)
+{
+  u_int32_t val;
+
+  if (width == LCOMMUNITY_SIZE)
+    return lcommunity_bloom_bit (pnt);
+
+  memcpy (&val, pnt, sizeof (u_int32_t));
+  return community_bloom_bit (ntohl (val));
+}
+
+/* Callbacks from qsort().  Communities are kept in network byte
+   order, so comparing octets sorts them by value.  */
+static int
+community_list_val_cmp (const void *a1, const void *a2)
+{
+  return memcmp (a1, a2, sizeof (u_int32_t));
+}
+
+static int
+lcommunity_list_val_cmp (const void *a1, const void *a2)
+{
+  return memcmp (a1, a2, LCOMMUNITY_SIZE);
+}
+
+/* Values of a standard entry.  */
+static const u_char *
+community_entry_vals (struct community_entry *entry, int *size)
+{
+  if (entry->style == COMMUNITY_LIST_STANDARD && entry->u.com)
+    {
+      *size = entry->u.com->size;
+      return (const u_char *) entry->u.com->val;
+    }
+  if (entry->style == LARGE_COMMUNITY_LIST_STANDARD && entry->u.lcom)
+    {
+      *size = entry->u.lcom->size;
+      return entry->u.lcom->val;
+    }
+  *size = 0;
+  return NULL;
+}
+
+/* Position of a value in a compiled list, -1 if no entry names it.  */
+static int
+community_list_compiled_find (struct community_list_compiled *cl,
+			      const u_char *pnt)
+{
+  int low = 0;
+  int high = cl->nvals - 1;
+  int mid;
+  int ret;
+
+  if (! (cl->bloom & community_list_bloom_bit (pnt, cl->width)))
+    return -1;
+
+  while (low <= high)
+    {
+      mid = (low + high) / 2;
+      if (cl->width == LCOMMUNITY_SIZE)
+	ret = memcmp (cl->vals + mid * LCOMMUNITY_SIZE, pnt, LCOMMUNITY_SIZE);
+      else
+	ret = memcmp (cl->vals + mid * sizeof (u_int32_t), pnt,
+		      sizeof (u_int32_t));
+      if (ret == 0)
+	return mid;
+      if (ret < 0)
+	low = mid + 1;
+      else
+	high = mid - 1;
+    }
+  return -1;
+}
+
+static void
+community_list_compiled_free (struct community_list_compiled *cl)
+{
+  if (cl->vals)
+    XFREE (MTYPE_COMMUNITY_LIST_COMPILED, cl->vals);
+  if (cl->first)
+    XFREE (MTYPE_COMMUNITY_LIST_COMPILED, cl->first);
+  if (cl->pos)
+    XFREE (MTYPE_COMMUNITY_LIST_COMPILED, cl->pos);
+  if (cl->entries)
+    XFREE (MTYPE_COMMUNITY_LIST_COMPILED, cl->entries);
+  XFREE (MTYPE_COMMUNITY_LIST_COMPILED, cl);
+}
+
+/* Drop the compiled form of a list whose entries change.  */
+static void
+community_list_compiled_flush (struct community_list *list)
+{
+  if (list->compiled)
+    {
+      community_list_compiled_free (list->compiled);
+      list->compiled = NULL;
+    }
+}
+
+/* Compile a standard community-list (width 4) or large-community-list
+   (width 12).  Expanded lists are left to the regular expression
+   code, NULL is returned for them.  */
+static struct community_list_compiled *
+community_list_compile (struct community_list *list, int width)
+{
+  struct community_list_compiled *cl;
+  struct community_compiled_entry *ce;
+  struct community_entry *entry;
+  const u_char *val;
+  int style;
+  int total;
+  int size;
+  int i, j, k, n;
+
+  if (list->compiled)
+    return list->compiled;
+
+  style = (width == LCOMMUNITY_SIZE
+	   ? LARGE_COMMUNITY_LIST_STANDARD : COMMUNITY_LIST_STANDARD);
+
+  total = n = 0;
+  for (entry = list->head; entry; entry = entry->next)
+    {
+      if (entry->style != style)
+	return NULL;
+      community_entry_vals (entry, &size);
+      total += size;
+      n++;
+    }
+
+  cl = XCALLOC (MTYPE_COMMUNITY_LIST_COMPILED,
+		sizeof (struct community_list_compiled));
+  cl->width = width;
+  cl->nentries = n;
+  cl->entries = XCALLOC (MTYPE_COMMUNITY_LIST_COMPILED,
+			 n * sizeof (struct community_compiled_entry));
+  cl->first_any = -1;
+
+  /* Every value of every entry, sorted and made unique.  */
+  if (total)
+    {
+      cl->vals = XMALLOC (MTYPE_COMMUNITY_LIST_COMPILED, total * width);
+      cl->pos = XMALLOC (MTYPE_COMMUNITY_LIST_COMPILED, total * sizeof (int));
+
+      for (j = 0, entry = list->head; entry; entry = entry->next)
+	{
+	  val = community_entry_vals (entry, &size);
+	  memcpy (cl->vals + j * width, val, size * width);
+	  j += size;
+	}
+      qsort (cl->vals, total, width, width == LCOMMUNITY_SIZE
+	     ? lcommunity_list_val_cmp : community_list_val_cmp);
+
+      for (i = n = 0; i < total; i++)
+	if (n == 0 || memcmp (cl->vals + (n - 1) * width,
+			      cl->vals + i * width, width) != 0)
+	  {
+	    if (n != i)
+	      memcpy (cl->vals + n * width, cl->vals + i * width, width);
+	    cl->bloom |= community_list_bloom_bit (cl->vals + n * width, width);
+	    n++;
+	  }
+      cl->nvals = n;
+
+      cl->first = XMALLOC (MTYPE_COMMUNITY_LIST_COMPILED, n * sizeof (int));
+      for (i = 0; i < n; i++)
+	cl->first[i] = -1;
+    }
+
+  /* Each entry as positions in the values.  */
+  for (j = 0, ce = cl->entries, entry = list->head; entry;
+       entry = entry->next, ce++)
+    {
+      val = community_entry_vals (entry, &size);
+
+      ce->direct = entry->direct;
+      ce->always = (entry->any
+		    || (style == COMMUNITY_LIST_STANDARD
+			&& community_include (entry->u.com,
+					      COMMUNITY_INTERNET)));
+      ce->size = size;
+      ce->pos = cl->pos + j;
+      j += size;
+
+      for (i = 0; i < size; i++)
+	{
+	  k = community_list_compiled_find (cl, val + i * width);
+	  ce->pos[i] = k;
+	  ce->bloom |= community_list_bloom_bit (val + i * width, width);
+	  if (cl->first[k] < 0)
+	    cl->first[k] = ce - cl->entries;
+	}
+
+      if (ce->always)
+	{
+	  if (cl->first_any < 0)
+	    cl->first_any = ce - cl->entries;
+	  for (i = 0; i < cl->nvals; i++)
+	    if (cl->first[i] < 0)
+	      cl->first[i] = ce - cl->entries;
+	}
+    }
+
+  list->compiled = cl;
+  return cl;
+}
+
+/* Match the values a route carries against a compiled list.  VALS is
+   NULL when the route has no such attribute.  When EXACT, the route
+   must carry the values of the entry and no other.  The values of the
+   route are looked up once, for all of the entries, and only when the
+   summaries leave some entry which may match.  */
+static int
+community_list_compiled_match (struct community_list_compiled *cl,
+			       const u_char *vals, int size,
+			       u_int64_t bloom, int indexed, int exact)
+{
+  u_int64_t found[cl->nvals / 64 + 1];
+  struct community_compiled_entry *ce;
+  int scanned = 0;
+  int i, k;
+
+  for (ce = cl->entries; ce < cl->entries + cl->nentries; ce++)
+    {
+      if (ce->always)
+	return ce->direct == COMMUNITY_PERMIT ? 1 : 0;
+
+      if (! vals)
+	continue;
+      if (exact ? ce->size != size : ce->size > size)
+	continue;
+      if (indexed && (bloom & ce->bloom) != ce->bloom)
+	continue;
+
+      if (! scanned)
+	{
+	  memset (found, 0, sizeof (found));
+	  for (i = 0; i < size; i++)
+	    {
+	      k = community_list_compiled_find (cl, vals + i * cl->width);
+	      if (k >= 0)
+		found[k / 64] |= (u_int64_t) 1 << (k % 64);
+	    }
+	  scanned = 1;
+	}
+
+      for (i = 0; i < ce->size; i++)
+	if (! (found[ce->pos[i] / 64] & ((u_int64_t) 1 << (ce->pos[i] % 64))))
+	  break;
+      if (i == ce->size)
+	return ce->direct == COMMUNITY_PERMIT ? 1 : 0;
+    }
+  return 0;
+}
+
+/* Indexes of the values which a compiled list permits, for deletion.
+   Returns how many were stored in INDEX.  */
+static int
+community_list_compiled_delete (struct community_list_compiled *cl,
+				const u_char *vals, int size,
+				u_int32_t *index)
+{
+  int count = 0;
+  int i, k, e;
+
+  for (i = 0; i < size; i++)
+    {
+      k = community_list_compiled_find (cl, vals + i * cl->width);
+      e = (k >= 0 ? cl->first[k] : cl->first_any);
+      if (e >= 0 && cl->entries[e].direct == COMMUNITY_PERMIT)
+	index[count++] = i;
+    }
+  return count;
+}
+
 static struct community_list *
 community_list_insert (struct community_list_handler *ch,
 		       const char *name, int master)
@@ -245,6 +570,8 @@ community_list_delete (struct community_list *list)
   struct community_list_list *clist;
   struct community_entry *entry, *next;
 
+  community_list_compiled_flush (list);
+
   for (entry = list->head; entry; entry = next)
     {
       next = entry->next;
@@ -277,6 +604,8 @@ static void
 community_list_entry_add (struct community_list *list,
                           struct community_entry *entry)
 {
+  community_list_compiled_flush (list);
+
   entry->next = NULL;
   entry->prev = list->tail;
 
@@ -292,6 +621,8 @@ static void
 community_list_entry_delete (struct community_list *list,
                              struct community_entry *entry, int style)
 {
+  community_list_compiled_flush (list);
+
   if (entry->next)
     entry->next->prev = entry->prev;
   else
@@ -570,6 +901,15 @@ int
 community_list_match (struct community *com, struct community_list *list)
 {
   struct community_entry *entry;
+  struct community_list_compiled *cl;
+
+  cl = community_list_compile (list, sizeof (u_int32_t));
+  if (cl)
+    return community_list_compiled_match (cl,
+			com ? (const u_char *) com->val : NULL,
+			com ? com->size : 0, com ? com->bloom : 0,
+			com && CHECK_FLAG (com->flags, COMMUNITY_FLAG_INDEXED),
+			0);
 
   for (entry = list->head; entry; entry = entry->next)
     {
@@ -597,6 +937,14 @@ int
 lcommunity_list_match (struct lcommunity *lcom, struct community_list *list)
 {
   struct community_entry *entry;
+  struct community_list_compiled *cl;
+
+  cl = community_list_compile (list, LCOMMUNITY_SIZE);
+  if (cl)
+    return community_list_compiled_match (cl, lcom ? lcom->val : NULL,
+			lcom ? lcom->size : 0, lcom ? lcom->bloom : 0,
+			lcom && CHECK_FLAG (lcom->flags, LCOMMUNITY_FLAG_INDEXED),
+			0);
 
   for (entry = list->head; entry; entry = entry->next)
     {
@@ -648,6 +996,15 @@ community_list_exact_match (struct community *com,
                             struct community_list *list)
 {
   struct community_entry *entry;
+  struct community_list_compiled *cl;
+
+  cl = community_list_compile (list, sizeof (u_int32_t));
+  if (cl)
+    return community_list_compiled_match (cl,
+			com ? (const u_char *) com->val : NULL,
+			com ? com->size : 0, com ? com->bloom : 0,
+			com && CHECK_FLAG (com->flags, COMMUNITY_FLAG_INDEXED),
+			1);
 
   for (entry = list->head; entry; entry = entry->next)
     {
@@ -678,15 +1035,24 @@ community_list_match_delete (struct community *com,
 {
   struct community_entry *entry;
   u_int32_t val;
+  struct community_list_compiled *cl;
   u_int32_t com_index_to_delete[com->size];
   int delete_index = 0;
   int i;
 
+  /* A standard list finds every value to delete in one pass.  */
+  cl = community_list_compile (list, sizeof (u_int32_t));
+  if (cl)
+    delete_index = community_list_compiled_delete (cl,
+						   (const u_char *) com->val,
+						   com->size,
+						   com_index_to_delete);
+
   /* Loop over each community value and evaluate each against the
    * community-list.  If we need to delete a community value add its index to
    * com_index_to_delete.
    */
-  for (i = 0; i < com->size; i++)
+  for (i = 0; ! cl && i < com->size; i++)
     {
       val = community_val_get (com, i);
 
@@ -730,7 +1096,8 @@ community_list_match_delete (struct community *com,
   /* Delete all of the communities we flagged for deletion */
   for (i = delete_index-1; i >= 0; i--)
     {
-      val = community_val_get (com, com_index_to_delete[i]);
+      memcpy (&val, com_nthval (com, com_index_to_delete[i]),
+	      sizeof (u_int32_t));
       community_del_val (com, &val);
     }
 
@@ -903,17 +1270,24 @@ lcommunity_list_match_delete (struct lcommunity *lcom,
 			      struct community_list *list)
 {
   struct community_entry *entry;
+  struct community_list_compiled *cl;
   u_int32_t com_index_to_delete[lcom->size];
   u_char *ptr;
   int delete_index = 0;
   int i;
 
+  /* A standard list finds every value to delete in one pass.  */
+  cl = community_list_compile (list, LCOMMUNITY_SIZE);
+  if (cl)
+    delete_index = community_list_compiled_delete (cl, lcom->val, lcom->size,
+						   com_index_to_delete);
+
   /* Loop over each lcommunity value and evaluate each against the
    * community-list.  If we need to delete a community value add its index to
    * com_index_to_delete.
    */
 
-  for (i = 0; i < lcom->size; i++)
+  for (i = 0; ! cl && i < lcom->size; i++)
     {
       ptr = lcom->val + (i * LCOMMUNITY_SIZE);
       for (entry = list->head; entry; entry = entry->next)
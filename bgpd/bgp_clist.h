@@ -61,6 +61,10 @@ struct community_list
   /* Community-list entry in this community-list.  */
   struct community_entry *head;
   struct community_entry *tail;
+
+  /* Standard entries compiled for matching, built on first use and
+     dropped whenever an entry is added or removed.  */
+  struct community_list_compiled *compiled;
 };
 
 /* Each entry in community-list.  */
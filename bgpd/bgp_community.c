@@ -81,6 +81,7 @@ community_del_val (struct community *com, u_int32_t *val)
 	    memmove (com->val + i, com->val + (i + 1), c * sizeof (*val));
 
 	  com->size--;
+	  UNSET_FLAG (com->flags, COMMUNITY_FLAG_INDEXED|COMMUNITY_FLAG_SORTED);
 
 	  if (com->size > 0)
 	    com->val = XREALLOC (MTYPE_COMMUNITY_VAL, com->val,
@@ -130,11 +131,61 @@ community_compare (const void *a1, const void *a2)
   return 0;
 }
 
+/* Build the index of a community which will not change any more.  */
+void
+community_index (struct community *com)
+{
+  u_int32_t val;
+  u_int32_t prev = 0;
+  int sorted = 1;
+  int i;
+
+  com->bloom = 0;
+  for (i = 0; i < com->size; i++)
+    {
+      val = ntohl (com->val[i]);
+      com->bloom |= community_bloom_bit (val);
+      if (i && val <= prev)
+	sorted = 0;
+      prev = val;
+    }
+
+  SET_FLAG (com->flags, COMMUNITY_FLAG_INDEXED);
+  if (sorted)
+    SET_FLAG (com->flags, COMMUNITY_FLAG_SORTED);
+  else
+    UNSET_FLAG (com->flags, COMMUNITY_FLAG_SORTED);
+}
+
 int
 community_include (struct community *com, u_int32_t val)
 {
   int i;
 
+  if (CHECK_FLAG (com->flags, COMMUNITY_FLAG_INDEXED)
+      && ! (com->bloom & community_bloom_bit (val)))
+    return 0;
+
+  if (CHECK_FLAG (com->flags, COMMUNITY_FLAG_SORTED))
+    {
+      int low = 0;
+      int high = com->size - 1;
+      u_int32_t v;
+
+      while (low <= high)
+	{
+	  i = (low + high) / 2;
+	  v = ntohl (com->val[i]);
+	  if (v == val)
+	    return 1;
+	  if (v < val)
+	    low = i + 1;
+	  else
+	    high = i - 1;
+	}
+      return 0;
+    }
+
   val = htonl (val);
 
   for (i = 0; i < com->size; i++)
@@ -312,6 +363,9 @@ community_intern (struct community *com)
   /* Increment refrence counter.  */
   find->refcnt++;
 
+  if (! CHECK_FLAG (find->flags, COMMUNITY_FLAG_INDEXED))
+    community_index (find);
+
   /* Make string.  */
   if (! find->str)
     find->str = community_com2str (find);
@@ -399,6 +453,10 @@ community_hash_make (struct community *com)
   unsigned int key = 0;
   int c;
 
+  /* Interned communities never change. */
+  if (com->hash)
+    return com->hash;
+
   for (c = 0; c < size; c += 4)
     {
       key += pnt[c];
@@ -407,6 +465,8 @@ community_hash_make (struct community *com)
       key += pnt[c + 3];
     }
 
+  if (com->refcnt)
+    com->hash = key;
   return key;
 }
 
@@ -425,6 +485,35 @@ community_match (const struct community *com1, const struct community *com2)
   if (com1->size < com2->size)
     return 0;
 
+  if (CHECK_FLAG (com1->flags, COMMUNITY_FLAG_INDEXED)
+      && CHECK_FLAG (com2->flags, COMMUNITY_FLAG_INDEXED))
+    {
+      /* A value of com2 absent from the summary of com1 cannot be on
+	 com1.  */
+      if ((com1->bloom & com2->bloom) != com2->bloom)
+	return 0;
+
+      /* Both in order: one merge walk, failing at the first value of
+	 com2 which com1 passes over.  */
+      if (CHECK_FLAG (com1->flags, COMMUNITY_FLAG_SORTED)
+	  && CHECK_FLAG (com2->flags, COMMUNITY_FLAG_SORTED))
+	{
+	  u_int32_t v1, v2;
+
+	  while (i < com1->size && j < com2->size)
+	    {
+	      v1 = ntohl (com1->val[i]);
+	      v2 = ntohl (com2->val[j]);
+	      if (v1 == v2)
+		j++;
+	      else if (v1 > v2)
+		return 0;
+	      i++;
+	    }
+	  return j == com2->size;
+	}
+    }
+
   /* Every community on com2 needs to be on com1 for this to match */
   while (i < com1->size && j < com2->size)
     {
@@ -467,6 +556,7 @@ community_merge (struct community *com1, struct community *com2)
 
   memcpy (com1->val + com1->size, com2->val, com2->size * 4);
   com1->size += com2->size;
+  UNSET_FLAG (com1->flags, COMMUNITY_FLAG_INDEXED|COMMUNITY_FLAG_SORTED);
 
   return com1;
 }
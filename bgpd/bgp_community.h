@@ -33,6 +33,18 @@ struct community
   /* Communities value.  */
   u_int32_t *val;
 
+  /* Hash value, remembered once interned.  */
+  unsigned int hash;
+
+  /* Index of the values, built for communities which no longer
+     change (interned ones): one bit per value in a 64-bit summary,
+     so most absent values are rejected without a scan, and whether
+     val is in ascending order, so lookups may binary search.  */
+  u_int64_t bloom;
+  u_char flags;
+#define COMMUNITY_FLAG_INDEXED		(1 << 0)
+#define COMMUNITY_FLAG_SORTED		(1 << 1)
+
   /* String of community attribute.  This sring is used by vty output
      and expanded community-list for regular expression match.  */
   char *str;
@@ -50,6 +62,10 @@ struct community
 #define com_lastval(X)   ((X)->val + (X)->size - 1)
 #define com_nthval(X,n)  ((X)->val + (n))
 
+/* Summary bit of a community value, in host order.  */
+#define community_bloom_bit(V) \
+  ((u_int64_t) 1 << ((u_int32_t) ((V) * 2654435761U) >> 26))
+
 /* Prototypes of communities attribute functions.  */
 extern void community_init (void);
 extern void community_finish (void);
@@ -71,5 +87,6 @@ extern void community_del_val (struct community *, u_int32_t *);
 extern unsigned long community_count (void);
 extern struct hash *community_hash (void);
 extern u_int32_t community_val_get (struct community *com, int i);
+extern void community_index (struct community *);
 
 #endif /* _QUAGGA_BGP_COMMUNITY_H */
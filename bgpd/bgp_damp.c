@@ -44,14 +44,20 @@ static struct bgp_damp_config *damp = &bgp_damp_cfg;
 #define BGP_DAMP_LIST_ADD(N,A)  BGP_INFO_ADD(N,A,no_reuse_list)
 #define BGP_DAMP_LIST_DEL(N,A)  BGP_INFO_DEL(N,A,no_reuse_list)
 
+/* Fractional bits of reuse_index_scale. */
+#define REUSE_INDEX_SHIFT	16
+
 /* Calculate reuse list index by penalty value.  */
 static int
 bgp_reuse_index (int penalty)
 {
-  unsigned int i;
+  unsigned int i = 0;
   int index;
 
-  i = (int)(((double) penalty / damp->reuse_limit - 1.0) * damp->scale_factor);
+  /* (penalty / reuse_limit - 1) * scale_factor, in fixed point. */
+  if (penalty > (int) damp->reuse_limit)
+    i = ((u_int64_t) (penalty - damp->reuse_limit) * damp->reuse_index_scale)
+        >> REUSE_INDEX_SHIFT;
   
   if ( i >= damp->reuse_index_size )
     i = damp->reuse_index_size - 1;
@@ -88,37 +94,31 @@ bgp_reuse_list_delete (struct bgp_damp_info *bdi)
     damp->reuse_list[bdi->index] = bdi->next;
 }   
 
-/* Return decayed penalty value.  */
+/* Return decayed penalty value.  The decay array holds the factors
+   with DAMP_DECAY_SHIFT fractional bits, so this is integer only.  */
 int 
 bgp_damp_decay (time_t tdiff, int penalty)
 {
   unsigned int i;
 
-  i = (int) ((double) tdiff / DELTA_T);
-
-  if (i == 0)
+  if (tdiff < DELTA_T)
     return penalty; 
   
+  i = tdiff / DELTA_T;
   if (i >= damp->decay_array_size)
     return 0;
 
-  return (int) (penalty * damp->decay_array[i]);
+  return ((u_int64_t) penalty * damp->decay_array[i]) >> DAMP_DECAY_SHIFT;
 }
 
-/* Handler of reuse timer event.  Each route in the current reuse-list
-   is evaluated.  RFC2439 Section 4.8.7.  */
-static int
-bgp_reuse_timer (struct thread *t)
+/* Move the current zeroth reuse list onto the list of routes due for
+   reuse and rotate the reuse lists.  RFC2439 Section 4.8.7.  */
+static void
+bgp_reuse_list_rotate (void)
 {
   struct bgp_damp_info *bdi;
-  struct bgp_damp_info *next;
-  time_t t_now, t_diff;
-    
-  damp->t_reuse = NULL;
-  damp->t_reuse =
-    thread_add_timer (bm->master, bgp_reuse_timer, NULL, DELTA_REUSE);
-
-  t_now = bgp_clock ();
+  struct bgp_damp_info *last;
+  unsigned int pending = damp->reuse_list_size;
 
   /* 1.  save a pointer to the current zeroth queue head and zero the
      list head entry.  */
@@ -129,12 +129,39 @@ bgp_reuse_timer (struct thread *t)
      rotating the circular queue of list-heads.  */
   damp->reuse_offset = (damp->reuse_offset + 1) % damp->reuse_list_size;
 
+  if (! bdi)
+    return;
+
+  /* Put the saved list in front of any routes still due.  */
+  for (last = bdi; ; last = last->next)
+    {
+      last->index = pending;
+      if (! last->next)
+	break;
+    }
+  last->next = damp->reuse_list[pending];
+  if (last->next)
+    last->next->prev = last;
+  damp->reuse_list[pending] = bdi;
+}
+
+/* Evaluate the routes due for reuse, RFC2439 Section 4.8.7.  Routes
+   which can be used again are only queued for bgp_process, and when
+   called from THREAD this gives way as soon as it should.  Returns 1
+   if routes are left to be looked at.  */
+static int
+bgp_reuse_pending (time_t t_now, struct thread *thread)
+{
+  struct bgp_damp_info *bdi;
+  time_t t_diff;
+
   /* 3. if ( the saved list head pointer is non-empty ) */
-  for (; bdi; bdi = next)
+  while ((bdi = damp->reuse_list[damp->reuse_list_size]) != NULL)
     {
       struct bgp *bgp = bdi->binfo->peer->bgp;
+      struct bgp_table *table = bgp_node_table (bdi->rn);
       
-      next = bdi->next;
+      bgp_reuse_list_delete (bdi);
 
       /* Set t-diff = t-now - t-updated.  */
       t_diff = t_now - bdi->t_updated;
@@ -156,11 +183,11 @@ bgp_reuse_timer (struct thread *t)
 	    {
 	      bgp_info_unset_flag (bdi->rn, bdi->binfo, BGP_INFO_HISTORY);
 	      bgp_aggregate_increment (bgp, &bdi->rn->p, bdi->binfo,
-				       bdi->afi, bdi->safi);   
-	      bgp_process (bgp, bdi->rn, bdi->afi, bdi->safi);
+				       table->afi, table->safi);   
+	      bgp_process (bgp, bdi->rn, table->afi, table->safi);
 	    }
 
-	  if (bdi->penalty <= damp->reuse_limit / 2.0)
+	  if (bdi->penalty <= damp->reuse_limit / 2)
 	    bgp_damp_info_free (bdi, 1);
 	  else
 	    BGP_DAMP_LIST_ADD (damp, bdi);
@@ -168,11 +195,54 @@ bgp_reuse_timer (struct thread *t)
       else
 	/* Re-insert into another list (See RFC2439 Section 4.8.6).  */
 	bgp_reuse_list_add (bdi);
+
+      if (thread && thread_should_yield (thread))
+	return 1;
     }
 
   return 0;
 }
 
+static int
+bgp_reuse_walk (struct thread *thread)
+{
+  damp->t_reuse_walk = NULL;
+
+  if (bgp_reuse_pending (bgp_clock (), thread))
+    damp->t_reuse_walk =
+      thread_add_background (bm->master, bgp_reuse_walk, NULL, 0);
+
+  return 0;
+}
+
+/* Handler of reuse timer event.  The routes on the current reuse-list
+   are evaluated in the background, so that a large number of them
+   coming due at once does not hold up everything else.  */
+static int
+bgp_reuse_timer (struct thread *t)
+{
+  damp->t_reuse = NULL;
+  damp->t_reuse =
+    thread_add_timer (bm->master, bgp_reuse_timer, NULL, DELTA_REUSE);
+
+  bgp_reuse_list_rotate ();
+
+  if (damp->reuse_list[damp->reuse_list_size] && ! damp->t_reuse_walk)
+    damp->t_reuse_walk =
+      thread_add_background (bm->master, bgp_reuse_walk, NULL, 0);
+
+  return 0;
+}
+
+/* Do what one reuse timer event does as of T_NOW, evaluating all the
+   routes due straight away.  */
+void
+bgp_damp_reuse_run (time_t t_now)
+{
+  bgp_reuse_list_rotate ();
+  bgp_reuse_pending (t_now, NULL);
+}
+
 /* A route becomes unreachable (RFC2439 Section 4.8.2).  */
 int
 bgp_damp_withdraw (struct bgp_info *binfo, struct bgp_node *rn,
@@ -180,7 +250,7 @@ bgp_damp_withdraw (struct bgp_info *binfo, struct bgp_node *rn,
 {
   time_t t_now;
   struct bgp_damp_info *bdi = NULL;
-  double last_penalty = 0;
+  unsigned int last_penalty = 0;
   
   t_now = bgp_clock ();
 
@@ -204,9 +274,6 @@ bgp_damp_withdraw (struct bgp_info *binfo, struct bgp_node *rn,
       bdi->flap = 1;
       bdi->start_time = t_now;
       bdi->suppress_time = 0;
-      bdi->index = -1;
-      bdi->afi = afi;
-      bdi->safi = safi;
       (bgp_info_extra_get (binfo))->damp_info = bdi;
       BGP_DAMP_LIST_ADD (damp, bdi);
     }
@@ -290,7 +357,7 @@ bgp_damp_update (struct bgp_info *binfo, struct bgp_node *rn,
   else
     status = BGP_DAMP_SUPPRESSED;  
 
-  if (bdi->penalty > damp->reuse_limit / 2.0)
+  if (bdi->penalty > damp->reuse_limit / 2)
     bdi->t_updated = t_now;
   else
     bgp_damp_info_free (bdi, 0);
@@ -335,7 +402,7 @@ bgp_damp_scan (struct bgp_info *binfo, afi_t afi, safi_t safi)
       t_diff = t_now - bdi->t_updated;
       bdi->penalty = bgp_damp_decay (t_diff, bdi->penalty);
 
-      if (bdi->penalty <= damp->reuse_limit / 2.0)
+      if (bdi->penalty <= damp->reuse_limit / 2)
         {
           /* release the bdi, bdi->binfo. */  
           bgp_damp_info_free (bdi, 1);
@@ -375,6 +442,7 @@ static void
 bgp_damp_parameter_set (int hlife, int reuse, int sup, int maxsup)
 {
   double reuse_max_ratio;
+  double decay, factor;
   unsigned int i;
   double j;
 	
@@ -391,13 +459,12 @@ bgp_damp_parameter_set (int hlife, int reuse, int sup, int maxsup)
   /* Decay-array computations */
   damp->decay_array_size = ceil ((double) damp->max_suppress_time / DELTA_T);
   damp->decay_array = XMALLOC (MTYPE_BGP_DAMP_ARRAY,
-			       sizeof(double) * (damp->decay_array_size));
-  damp->decay_array[0] = 1.0;
-  damp->decay_array[1] = exp ((1.0/((double)damp->half_life/DELTA_T)) * log(0.5));
+			       sizeof(u_int32_t) * (damp->decay_array_size));
+  decay = exp ((1.0/((double)damp->half_life/DELTA_T)) * log(0.5));
 
   /* Calculate decay values for all possible times */
-  for (i = 2; i < damp->decay_array_size; i++)
-    damp->decay_array[i] = damp->decay_array[i-1] * damp->decay_array[1];
+  for (i = 0, factor = 1.0; i < damp->decay_array_size; i++, factor *= decay)
+    damp->decay_array[i] = factor * (1 << DAMP_DECAY_SHIFT) + 0.5;
 	
   /* Reuse-list computations */
   i = ceil ((double)damp->max_suppress_time / DELTA_REUSE) + 1;
@@ -406,8 +473,8 @@ bgp_damp_parameter_set (int hlife, int reuse, int sup, int maxsup)
   damp->reuse_list_size = i; 
 
   damp->reuse_list = XCALLOC (MTYPE_BGP_DAMP_ARRAY, 
-			      damp->reuse_list_size 
-			      * sizeof (struct bgp_reuse_node *));
+			      (damp->reuse_list_size + 1)
+			      * sizeof (struct bgp_damp_info *));
 
   /* Reuse-array computations */
   damp->reuse_index = XCALLOC (MTYPE_BGP_DAMP_ARRAY,
@@ -419,6 +486,8 @@ bgp_damp_parameter_set (int hlife, int reuse, int sup, int maxsup)
     reuse_max_ratio = j;
 
   damp->scale_factor = (double)damp->reuse_index_size/(reuse_max_ratio - 1);
+  damp->reuse_index_scale = damp->scale_factor * (1 << REUSE_INDEX_SHIFT)
+                            / damp->reuse_limit;
 
   for (i = 0; i < damp->reuse_index_size; i++)
     {
@@ -475,7 +544,7 @@ bgp_damp_info_clean (void)
 
   damp->reuse_offset = 0;
 
-  for (i = 0; i < damp->reuse_list_size; i++)
+  for (i = 0; i <= damp->reuse_list_size; i++)
     {
       if (! damp->reuse_list[i])
 	continue;
@@ -507,6 +576,9 @@ bgp_damp_disable (struct bgp *bgp, afi_t afi, safi_t safi)
   if (damp->t_reuse )
     thread_cancel (damp->t_reuse);
   damp->t_reuse = NULL;
+  if (damp->t_reuse_walk)
+    thread_cancel (damp->t_reuse_walk);
+  damp->t_reuse_walk = NULL;
 
   /* Clean BGP dampening information.  */
   bgp_damp_info_clean ();
@@ -550,7 +622,9 @@ bgp_get_reuse_time (unsigned int penalty, char *buf, size_t len)
 
   if (penalty > damp->reuse_limit)
     {
-      reuse_time = (int) (DELTA_T * ((log((double)damp->reuse_limit/penalty))/(log(damp->decay_array[1])))); 
+      reuse_time = (int) (damp->half_life
+                          * log ((double) penalty / damp->reuse_limit)
+                          / log (2.0));
 
       if (reuse_time > damp->max_suppress_time)
 	reuse_time = damp->max_suppress_time;
@@ -29,37 +29,36 @@ struct bgp_damp_info
   struct bgp_damp_info *next;
   struct bgp_damp_info *prev;
 
+  /* Back reference to bgp_info. */
+  struct bgp_info *binfo;
+
+  /* Back reference to bgp_node, whose table gives the afi/safi. */
+  struct bgp_node *rn;
+
   /* Figure-of-merit.  */
   unsigned int penalty;
 
   /* Number of flapping.  */
   unsigned int flap;
 	
+  /* The times below are bgp_clock () values, which fit in 32 bits. */
+
   /* First flap time  */
-  time_t start_time;
+  u_int32_t start_time;
  
   /* Last time penalty was updated.  */
-  time_t t_updated;
+  u_int32_t t_updated;
 
   /* Time of route start to be suppressed.  */
-  time_t suppress_time;
-
-  /* Back reference to bgp_info. */
-  struct bgp_info *binfo;
-
-  /* Back reference to bgp_node. */
-  struct bgp_node *rn;
+  u_int32_t suppress_time;
 
   /* Current index in the reuse_list. */
-  int index;
+  u_int16_t index;
 
   /* Last time message type. */
   u_char lastrecord;
 #define BGP_RECORD_UPDATE	1U
 #define BGP_RECORD_WITHDRAW	2U
-
-  afi_t afi;
-  safi_t safi;
 };
 
 /* Specified parameter set configuration. */
@@ -92,14 +91,18 @@ struct bgp_damp_config
   unsigned int decay_array_size; /* Calculated using config parameters */
   double scale_factor;
   unsigned int reuse_scale_factor; 
+  u_int32_t reuse_index_scale;	/* scale_factor / reuse_limit, fixed point */
          
-  /* Decay array per-set based. */ 
-  double *decay_array;	
+  /* Decay array per-set based, fixed point, see bgp_damp_decay. */ 
+  u_int32_t *decay_array;	
 
   /* Reuse index array per-set based. */ 
   int *reuse_index;
 
-  /* Reuse list array per-set based. */  
+  /* Reuse list array per-set based.  One more list than
+   * reuse_list_size, the last holds routes which came due for reuse
+   * but have yet to be looked at, see bgp_reuse_timer.
+   */
   struct bgp_damp_info **reuse_list;
   int reuse_offset;
         
@@ -108,6 +111,9 @@ struct bgp_damp_config
 
   /* Reuse timer thread per-set base. */
   struct thread* t_reuse;
+
+  /* Background thread working through the routes due for reuse. */
+  struct thread *t_reuse_walk;
 };
 
 #define BGP_DAMP_NONE           0
@@ -129,6 +135,9 @@ struct bgp_damp_config
 #define REUSE_LIST_SIZE          256
 #define REUSE_ARRAY_SIZE        1024
 
+/* Fractional bits of the fixed point decay array. */
+#define DAMP_DECAY_SHIFT          24
+
 extern int bgp_damp_enable (struct bgp *, afi_t, safi_t, time_t, unsigned int, 
                      unsigned int, time_t);
 extern int bgp_damp_disable (struct bgp *, afi_t, safi_t);
@@ -139,6 +148,7 @@ extern int bgp_damp_scan (struct bgp_info *, afi_t, safi_t);
 extern void bgp_damp_info_free (struct bgp_damp_info *, int);
 extern void bgp_damp_info_clean (void);
 extern int bgp_damp_decay (time_t, int);
+extern void bgp_damp_reuse_run (time_t);
 extern void bgp_config_write_damp (struct vty *);
 extern void bgp_damp_info_vty (struct vty *, struct bgp_info *);
 extern const char * bgp_damp_reuse_time_vty (struct vty *, struct bgp_info *,
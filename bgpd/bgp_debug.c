@@ -96,7 +96,7 @@ static const struct message bgp_notify_msg[] =
   { BGP_NOTIFY_HOLD_ERR, "Hold Timer Expired"},
   { BGP_NOTIFY_FSM_ERR, "Finite State Machine Error"},
   { BGP_NOTIFY_CEASE, "Cease"},
-  { BGP_NOTIFY_CAPABILITY_ERR, "CAPABILITY Message Error"},
+  { BGP_NOTIFY_ROUTE_REFRESH_ERR, "ROUTE-REFRESH Message Error"},
 };
 static const int bgp_notify_msg_max = BGP_NOTIFY_MAX;
 
@@ -152,14 +152,12 @@ static const struct message bgp_notify_cease_msg[] =
 };
 static const int bgp_notify_cease_msg_max = BGP_NOTIFY_CEASE_MAX;
 
-static const struct message bgp_notify_capability_msg[] = 
+static const struct message bgp_notify_route_refresh_msg[] = 
 {
   { BGP_NOTIFY_SUBCODE_UNSPECIFIC, "/Unspecific"},
-  { BGP_NOTIFY_CAPABILITY_INVALID_ACTION, "/Invalid Action Value" },
-  { BGP_NOTIFY_CAPABILITY_INVALID_LENGTH, "/Invalid Capability Length"},
-  { BGP_NOTIFY_CAPABILITY_MALFORMED_CODE, "/Malformed Capability Value"},
+  { BGP_NOTIFY_ROUTE_REFRESH_INVALID_MSG_LEN, "/Invalid Message Length"},
 };
-static const int bgp_notify_capability_msg_max = BGP_NOTIFY_CAPABILITY_MAX;
+static const int bgp_notify_route_refresh_msg_max = BGP_NOTIFY_ROUTE_REFRESH_MAX;
 
 /* Origin strings. */
 const char *bgp_origin_str[] = {"i","e","?"};
@@ -274,8 +272,9 @@ bgp_notify_print(struct peer *peer, struct bgp_notify *bgp_notify,
       subcode_str = LOOKUP_DEF (bgp_notify_cease_msg, bgp_notify->subcode,
                                 "Unrecognized Error Subcode");
       break;
-    case BGP_NOTIFY_CAPABILITY_ERR:
-      subcode_str = LOOKUP_DEF (bgp_notify_capability_msg, bgp_notify->subcode,
+    case BGP_NOTIFY_ROUTE_REFRESH_ERR:
+      subcode_str = LOOKUP_DEF (bgp_notify_route_refresh_msg,
+                                bgp_notify->subcode,
                                 "Unrecognized Error Subcode");
       break;
     }
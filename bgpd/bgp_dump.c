@@ -29,6 +29,10 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "linklist.h"
 #include "filter.h"
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif /* HAVE_ZLIB */
+
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_route.h"
@@ -87,8 +91,23 @@ struct bgp_dump
   char *interval_str;
 
   struct thread *t_interval;
+
+  /* Table walk of a routes-mrt dump in progress. */
+  struct thread *t_walk;
+  bgp_table_iter_t iter;
+  afi_t afi;
+  unsigned int seq;
+
+#ifdef HAVE_ZLIB
+  /* Compressed routes-mrt output, when the file name ends in ".gz". */
+  gzFile gz;
+#endif /* HAVE_ZLIB */
 };
 
+/* Output buffer of a routes-mrt dump, so the table goes out in large
+   writes rather than one per record. */
+#define BGP_DUMP_ROUTES_BUFSIZ (1024 * 1024)
+
 static int bgp_dump_unset (struct vty *vty, struct bgp_dump *bgp_dump);
 static int bgp_dump_interval_func (struct thread *);
 
@@ -149,6 +168,110 @@ bgp_dump_open_file (struct bgp_dump *bgp_dump)
   return bgp_dump->fp;
 }
 
+static int
+bgp_dump_compressed (const char *filename)
+{
+  size_t len = strlen (filename);
+
+  return len > 3 && strcmp (filename + len - 3, ".gz") == 0;
+}
+
+/* Open the file for a routes-mrt dump, compressed if so named. */
+static int
+bgp_dump_routes_open (struct bgp_dump *bgp_dump)
+{
+  if (bgp_dump_open_file (bgp_dump) == NULL)
+    return -1;
+
+  if (! bgp_dump_compressed (bgp_dump->filename))
+    {
+      setvbuf (bgp_dump->fp, NULL, _IOFBF, BGP_DUMP_ROUTES_BUFSIZ);
+      return 0;
+    }
+
+#ifdef HAVE_ZLIB
+  {
+    int fd;
+
+    fd = dup (fileno (bgp_dump->fp));
+    if (fd >= 0)
+      bgp_dump->gz = gzdopen (fd, "wb");
+    if (bgp_dump->gz == NULL)
+      {
+	zlog_warn ("bgp_dump_routes_open: can't compress %s",
+		   bgp_dump->filename);
+	if (fd >= 0)
+	  close (fd);
+	fclose (bgp_dump->fp);
+	bgp_dump->fp = NULL;
+	return -1;
+      }
+    gzbuffer (bgp_dump->gz, BGP_DUMP_ROUTES_BUFSIZ);
+  }
+#endif /* HAVE_ZLIB */
+  return 0;
+}
+
+/* Close the dump file.  Returns -1 if what was still buffered could
+   not be written out. */
+static int
+bgp_dump_close (struct bgp_dump *bgp_dump)
+{
+  int ret = 0;
+
+#ifdef HAVE_ZLIB
+  if (bgp_dump->gz)
+    {
+      if (gzclose (bgp_dump->gz) != Z_OK)
+	ret = -1;
+      bgp_dump->gz = NULL;
+    }
+#endif /* HAVE_ZLIB */
+  if (bgp_dump->fp)
+    {
+      if (fclose (bgp_dump->fp) != 0)
+	ret = -1;
+      bgp_dump->fp = NULL;
+    }
+  return ret;
+}
+
+/* Write OBUF to the routes-mrt dump.  A short write, say on a full
+   disk, abandons the dump and closes the file; returns -1 then. */
+static int
+bgp_dump_routes_write (struct stream *obuf)
+{
+  size_t size = stream_get_endp (obuf);
+  const char *error = NULL;
+
+  if (bgp_dump_routes.fp == NULL)
+    return -1;
+
+#ifdef HAVE_ZLIB
+  if (bgp_dump_routes.gz)
+    {
+      int errnum;
+
+      if (gzwrite (bgp_dump_routes.gz, STREAM_DATA (obuf), size)
+	  != (int) size)
+	error = gzerror (bgp_dump_routes.gz, &errnum);
+    }
+  else
+#endif /* HAVE_ZLIB */
+  if (fwrite (STREAM_DATA (obuf), size, 1, bgp_dump_routes.fp) != 1
+      || ferror (bgp_dump_routes.fp))
+    error = safe_strerror (errno);
+
+  if (error)
+    {
+      zlog_warn ("bgp_dump_routes_write: %s: %s, dump abandoned",
+		 bgp_dump_routes.filename, error);
+      bgp_dump_close (&bgp_dump_routes);
+      return -1;
+    }
+  return 0;
+}
+
 static int
 bgp_dump_interval_add (struct bgp_dump *bgp_dump, int interval)
 {
@@ -302,14 +425,13 @@ bgp_dump_routes_index_table(struct bgp *bgp)
 
   bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
 
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
-  fflush (bgp_dump_routes.fp);
+  bgp_dump_routes_write (obuf);
 }
 
 
 static struct bgp_info *
 bgp_dump_route_node_record (int afi, struct bgp_node *rn,
-                            struct bgp_info *info, unsigned int seq)
+                            struct bgp_info *info, unsigned int *seq)
 {
   struct stream *obuf;
   size_t sizep;
@@ -327,7 +449,7 @@ bgp_dump_route_node_record (int afi, struct bgp_node *rn,
                      BGP_DUMP_ROUTES);
 
   /* Sequence number */
-  stream_putl (obuf, seq);
+  stream_putl (obuf, *seq);
 
   /* Prefix length */
   stream_putc (obuf, rn->p.prefixlen);
@@ -362,6 +484,12 @@ bgp_dump_route_node_record (int afi, struct bgp_node *rn,
     {
       size_t cur_endp;
 
+      /* Peers that came up after the index table was written have no
+         index to refer to. */
+      if (info->peer->table_dump_index == 0
+          && info->peer != info->peer->bgp->peer_self)
+        continue;
+
       /* Peer index */
       stream_putw (obuf, info->peer->table_dump_index);
 
@@ -388,53 +516,121 @@ bgp_dump_route_node_record (int afi, struct bgp_node *rn,
       endp = cur_endp;
     }
 
+  /* Nothing to write, every path was skipped or the one left is too
+     large to fit a record. */
+  if (entry_count == 0)
+    return info ? info->next : NULL;
+
   /* Overwrite the entry count, now that we know the right number */
   stream_putw_at (obuf, sizep, entry_count);
 
   bgp_dump_set_size (obuf, MSG_TABLE_DUMP_V2);
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
+  bgp_dump_routes_write (obuf);
+  (*seq)++;
 
   return info;
 }
 
-/* Runs under child process. */
-static unsigned int
-bgp_dump_routes_func (int afi, int first_run, unsigned int seq)
+/* Walk the IPv4 and then the IPv6 unicast table, a time slice at a
+   time, so a full table dump does not hold up the rest of bgpd.  The
+   table iterator survives changes to the table while paused. */
+static int
+bgp_dump_routes_walk (struct thread *t)
 {
+  struct bgp_dump *bgp_dump;
   struct bgp_info *info;
   struct bgp_node *rn;
   struct bgp *bgp;
-  struct bgp_table *table;
 
-  bgp = bgp_get_default ();
-  if (!bgp)
-    return seq;
+  bgp_dump = THREAD_ARG (t);
+  bgp_dump->t_walk = NULL;
 
-  if (bgp_dump_routes.fp == NULL)
-    return seq;
+  while (1)
+    {
+      while ((rn = bgp_table_iter_next (&bgp_dump->iter)))
+	{
+	  info = rn->info;
+	  while (info)
+	    info = bgp_dump_route_node_record (bgp_dump->afi, rn, info,
+					       &bgp_dump->seq);
+
+	  /* A write failed and the file is gone. */
+	  if (bgp_dump->fp == NULL)
+	    {
+	      bgp_table_iter_cleanup (&bgp_dump->iter);
+	      return 0;
+	    }
+
+	  if (thread_should_yield (t))
+	    {
+	      bgp_table_iter_pause (&bgp_dump->iter);
+	      bgp_dump->t_walk = thread_add_background (bm->master,
+							bgp_dump_routes_walk,
+							bgp_dump, 0);
+	      return 0;
+	    }
+	}
+      bgp_table_iter_cleanup (&bgp_dump->iter);
+
+      bgp = bgp_get_default ();
+      if (bgp_dump->afi == AFI_IP6 || bgp == NULL)
+	break;
 
-  /* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers,
-     so this should only be done on the first call to bgp_dump_routes_func.
-     ( this function will be called once for ipv4 and once for ipv6 ) */
-  if(first_run)
-    bgp_dump_routes_index_table(bgp);
+      bgp_dump->afi = AFI_IP6;
+      bgp_table_iter_init (&bgp_dump->iter, bgp->rib[AFI_IP6][SAFI_UNICAST]);
+    }
+
+  /* Close the file now. For a RIB dump there's no point in leaving
+   * it open until the next scheduled dump starts. */
+  if (bgp_dump_close (bgp_dump) < 0)
+    zlog_warn ("bgp_dump_routes_walk: %s: %s, dump may be truncated",
+	       bgp_dump->filename, safe_strerror (errno));
+  return 0;
+}
 
-  /* Walk down each BGP route. */
-  table = bgp->rib[afi][SAFI_UNICAST];
+static void
+bgp_dump_routes_start (struct bgp_dump *bgp_dump)
+{
+  struct bgp *bgp;
 
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+  if (bgp_dump->t_walk)
     {
-      info = rn->info;
-      while (info)
-      {
-        info = bgp_dump_route_node_record(afi, rn, info, seq);
-        seq++;
-      }
+      zlog_warn ("bgp_dump_routes_start: previous dump of %s not finished,"
+		 " skipping", bgp_dump->filename);
+      return;
+    }
+
+  if (bgp_dump_routes_open (bgp_dump) < 0)
+    return;
+
+  bgp = bgp_get_default ();
+  if (! bgp)
+    {
+      bgp_dump_close (bgp_dump);
+      return;
     }
 
-  fflush (bgp_dump_routes.fp);
+  /* The index table covers the peers of both address families. */
+  bgp_dump_routes_index_table (bgp);
+  if (bgp_dump->fp == NULL)
+    return;
+
+  bgp_dump->afi = AFI_IP;
+  bgp_dump->seq = 0;
+  bgp_table_iter_init (&bgp_dump->iter, bgp->rib[AFI_IP][SAFI_UNICAST]);
+  bgp_dump->t_walk = thread_add_background (bm->master, bgp_dump_routes_walk,
+					    bgp_dump, 0);
+}
 
-  return seq;
+static void
+bgp_dump_routes_stop (struct bgp_dump *bgp_dump)
+{
+  if (bgp_dump->t_walk)
+    {
+      thread_cancel (bgp_dump->t_walk);
+      bgp_dump->t_walk = NULL;
+      bgp_table_iter_cleanup (&bgp_dump->iter);
+    }
 }
 
 static int
@@ -444,21 +640,14 @@ bgp_dump_interval_func (struct thread *t)
   bgp_dump = THREAD_ARG (t);
   bgp_dump->t_interval = NULL;
 
-  /* Reschedule dump even if file couldn't be opened this time... */
-  if (bgp_dump_open_file (bgp_dump) != NULL)
-    {
-      /* In case of bgp_dump_routes, we need special route dump function. */
-      if (bgp_dump->type == BGP_DUMP_ROUTES)
-	{
-	  unsigned int seq = bgp_dump_routes_func (AFI_IP, 1, 0);
-	  bgp_dump_routes_func (AFI_IP6, 0, seq);
-	  /* Close the file now. For a RIB dump there's no point in leaving
-	   * it open until the next scheduled dump starts. */
-	  fclose(bgp_dump->fp); bgp_dump->fp = NULL;
-	}
-    }
+  /* In case of bgp_dump_routes, we need special route dump function. */
+  if (bgp_dump->type == BGP_DUMP_ROUTES)
+    bgp_dump_routes_start (bgp_dump);
+  else
+    bgp_dump_open_file (bgp_dump);
 
-  /* if interval is set reschedule */
+  /* Reschedule dump even if file couldn't be opened this time...
+     if interval is set reschedule */
   if (bgp_dump->interval > 0)
     bgp_dump_interval_add (bgp_dump, bgp_dump->interval);
 
@@ -661,6 +850,15 @@ bgp_dump_set (struct vty *vty, struct bgp_dump *bgp_dump,
         }
     }
 
+#ifndef HAVE_ZLIB
+  if (type == BGP_DUMP_ROUTES && bgp_dump_compressed (path))
+    {
+      vty_out (vty, "%% Compressed dumps are not supported in this build%s",
+	       VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+#endif /* HAVE_ZLIB */
+
   /* Removing previous config */
   bgp_dump_unset(vty, bgp_dump);
 
@@ -710,12 +908,9 @@ bgp_dump_unset (struct vty *vty, struct bgp_dump *bgp_dump)
       bgp_dump->filename = NULL;
     }
 
-  /* Closing file. */
-  if (bgp_dump->fp)
-    {
-      fclose (bgp_dump->fp);
-      bgp_dump->fp = NULL;
-    }
+  /* Abandon a table walk in progress and close the file. */
+  bgp_dump_routes_stop (bgp_dump);
+  bgp_dump_close (bgp_dump);
 
   /* Removing interval thread. */
   if (bgp_dump->t_interval)
@@ -888,6 +1083,9 @@ bgp_dump_init (void)
 void
 bgp_dump_finish (void)
 {
+  bgp_dump_routes_stop (&bgp_dump_routes);
+  bgp_dump_close (&bgp_dump_routes);
+
   stream_free (bgp_dump_obuf);
   bgp_dump_obuf = NULL;
 }
@@ -233,12 +233,16 @@ ecommunity_unintern (struct ecommunity **ecom)
 unsigned int
 ecommunity_hash_make (void *arg)
 {
-  const struct ecommunity *ecom = arg;
+  struct ecommunity *ecom = arg;
   int size = ecom->size * ECOMMUNITY_SIZE;
   u_int8_t *pnt = ecom->val;
   unsigned int key = 0;
   int c;
 
+  /* Interned communities never change. */
+  if (ecom->hash)
+    return ecom->hash;
+
   for (c = 0; c < size; c += ECOMMUNITY_SIZE)
     {
       key += pnt[c];
@@ -251,6 +255,8 @@ ecommunity_hash_make (void *arg)
       key += pnt[c + 7];
     }
 
+  if (ecom->refcnt)
+    ecom->hash = key;
   return key;
 }
 
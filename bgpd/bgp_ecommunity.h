@@ -57,6 +57,9 @@ struct ecommunity
   /* Extended Communities value.  */
   u_int8_t *val;
 
+  /* Hash value, remembered once interned.  */
+  unsigned int hash;
+
   /* Human readable format string.  */
   char *str;
 };
@@ -41,6 +41,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_network.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_dump.h"
+#include "bgpd/bgp_zebra.h"
 #include "bgpd/bgp_open.h"
 #include "bgpd/bgp_nht.h"
 #ifdef HAVE_SNMP
@@ -506,6 +507,9 @@ bgp_stop (struct peer *peer)
 
       /* Reset peer synctime */
       peer->synctime = 0;
+
+      UNSET_FLAG (peer->sflags, PEER_STATUS_PACKET_RCVD);
+      UNSET_FLAG (peer->sflags, PEER_STATUS_TABLE_RCVD);
     }
   
   /* Stop read and write threads when exists. */
@@ -559,6 +563,9 @@ bgp_stop (struct peer *peer)
         prefix_bgp_orf_remove_all (afi, orf_name);
       }
 
+  /* Cached policy results hold references to attributes. */
+  bgp_policy_cache_flush (peer);
+
   /* Reset keepalive and holdtime */
   if (CHECK_FLAG (peer->config, PEER_CONFIG_TIMER))
     {
@@ -971,6 +978,20 @@ bgp_fsm_keepalive (struct peer *peer)
   peer->keepalive_in++;
 
   BGP_TIMER_OFF (peer->t_holdtime);
+
+  /* A KEEPALIVE behind an UPDATE, or behind the one many peers send as
+     they reach Established, follows the table the peer had for us: as
+     near to End-of-RIB as we get from a peer that does not send one. */
+  if (! CHECK_FLAG (peer->sflags, PEER_STATUS_TABLE_RCVD))
+    {
+      if (CHECK_FLAG (peer->sflags, PEER_STATUS_PACKET_RCVD))
+	{
+	  SET_FLAG (peer->sflags, PEER_STATUS_TABLE_RCVD);
+	  bgp_fib_hold_check (peer->bgp);
+	}
+      else
+	SET_FLAG (peer->sflags, PEER_STATUS_PACKET_RCVD);
+    }
   return 0;
 }
 
@@ -979,6 +1000,7 @@ static int
 bgp_fsm_update (struct peer *peer)
 {
   BGP_TIMER_OFF (peer->t_holdtime);
+  SET_FLAG (peer->sflags, PEER_STATUS_PACKET_RCVD);
   return 0;
 }
 
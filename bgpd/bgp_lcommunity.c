@@ -185,6 +185,7 @@ lcommunity_merge (struct lcommunity *lcom1, struct lcommunity *lcom2)
   memcpy (lcom1->val + (lcom1->size * LCOMMUNITY_SIZE),
 	  lcom2->val, lcom2->size * LCOMMUNITY_SIZE);
   lcom1->size += lcom2->size;
+  UNSET_FLAG (lcom1->flags, LCOMMUNITY_FLAG_INDEXED|LCOMMUNITY_FLAG_SORTED);
 
   return lcom1;
 }
@@ -204,6 +205,9 @@ lcommunity_intern (struct lcommunity *lcom)
 
   find->refcnt++;
 
+  if (! CHECK_FLAG (find->flags, LCOMMUNITY_FLAG_INDEXED))
+    lcommunity_index (find);
+
   if (! find->str)
     find->str = lcommunity_lcom2str (find, LCOMMUNITY_FORMAT_DISPLAY);
 
@@ -234,12 +238,16 @@ lcommunity_unintern (struct lcommunity **lcom)
 unsigned int
 lcommunity_hash_make (void *arg)
 {
-  const struct lcommunity *lcom = arg;
+  struct lcommunity *lcom = arg;
   int size = lcom->size * LCOMMUNITY_SIZE;
   u_int8_t *pnt = lcom->val;
   unsigned int key = 0;
   int c;
 
+  /* Interned communities never change. */
+  if (lcom->hash)
+    return lcom->hash;
+
   for (c = 0; c < size; c += LCOMMUNITY_SIZE)
     {
       key += pnt[c];
@@ -256,6 +264,8 @@ lcommunity_hash_make (void *arg)
       key += pnt[c + 11];
     }
 
+  if (lcom->refcnt)
+    lcom->hash = key;
   return key;
 }
 
@@ -416,12 +426,72 @@ lcommunity_str2com (const char *str)
     return lcom;
 }
 
+/* Summary bit of a large community value.  */
+u_int64_t
+lcommunity_bloom_bit (const u_char *pnt)
+{
+  u_int32_t v[3];
+
+  memcpy (v, pnt, LCOMMUNITY_SIZE);
+  return (u_int64_t) 1 << ((u_int32_t) (ntohl (v[0]) * 2654435761U
+					 ^ ntohl (v[1]) * 2246822519U
+					 ^ ntohl (v[2]) * 3266489917U) >> 26);
+}
+
+/* Build the index of a large community which will not change any
+   more.  */
+void
+lcommunity_index (struct lcommunity *lcom)
+{
+  int sorted = 1;
+  int i;
+
+  lcom->bloom = 0;
+  for (i = 0; i < lcom->size; i++)
+    {
+      lcom->bloom |= lcommunity_bloom_bit (lcom->val + i * LCOMMUNITY_SIZE);
+      if (i && memcmp (lcom->val + (i - 1) * LCOMMUNITY_SIZE,
+		       lcom->val + i * LCOMMUNITY_SIZE, LCOMMUNITY_SIZE) >= 0)
+	sorted = 0;
+    }
+
+  SET_FLAG (lcom->flags, LCOMMUNITY_FLAG_INDEXED);
+  if (sorted)
+    SET_FLAG (lcom->flags, LCOMMUNITY_FLAG_SORTED);
+  else
+    UNSET_FLAG (lcom->flags, LCOMMUNITY_FLAG_SORTED);
+}
+
 int
 lcommunity_include (struct lcommunity *lcom, u_char *ptr)
 {
   int i;
   u_char *lcom_ptr;
 
+  if (CHECK_FLAG (lcom->flags, LCOMMUNITY_FLAG_INDEXED)
+      && ! (lcom->bloom & lcommunity_bloom_bit (ptr)))
+    return 0;
+
+  if (CHECK_FLAG (lcom->flags, LCOMMUNITY_FLAG_SORTED))
+    {
+      int low = 0;
+      int high = lcom->size - 1;
+      int ret;
+
+      while (low <= high)
+	{
+	  i = (low + high) / 2;
+	  ret = memcmp (lcom->val + i * LCOMMUNITY_SIZE, ptr, LCOMMUNITY_SIZE);
+	  if (ret == 0)
+	    return 1;
+	  if (ret < 0)
+	    low = i + 1;
+	  else
+	    high = i - 1;
+	}
+      return 0;
+    }
+
   for (i = 0; i < lcom->size; i++) {
     lcom_ptr = lcom->val + (i * LCOMMUNITY_SIZE);
     if (memcmp (ptr, lcom_ptr, LCOMMUNITY_SIZE) == 0)
@@ -512,6 +582,31 @@ lcommunity_match (const struct lcommunity *lcom1,
   if (lcom1->size < lcom2->size)
     return 0;
 
+  if (CHECK_FLAG (lcom1->flags, LCOMMUNITY_FLAG_INDEXED)
+      && CHECK_FLAG (lcom2->flags, LCOMMUNITY_FLAG_INDEXED))
+    {
+      int ret;
+
+      if ((lcom1->bloom & lcom2->bloom) != lcom2->bloom)
+	return 0;
+
+      if (CHECK_FLAG (lcom1->flags, LCOMMUNITY_FLAG_SORTED)
+	  && CHECK_FLAG (lcom2->flags, LCOMMUNITY_FLAG_SORTED))
+	{
+	  while (i < lcom1->size && j < lcom2->size)
+	    {
+	      ret = memcmp (lcom1->val + i * LCOMMUNITY_SIZE,
+			    lcom2->val + j * LCOMMUNITY_SIZE, LCOMMUNITY_SIZE);
+	      if (ret == 0)
+		j++;
+	      else if (ret > 0)
+		return 0;
+	      i++;
+	    }
+	  return j == lcom2->size;
+	}
+    }
+
   /* Every community on com2 needs to be on com1 for this to match */
   while (i < lcom1->size && j < lcom2->size)
     {
@@ -546,6 +641,8 @@ lcommunity_del_val (struct lcommunity *lcom, u_char *ptr)
 	    memmove (lcom->val + i*LCOMMUNITY_SIZE, lcom->val + (i + 1)*LCOMMUNITY_SIZE, c * LCOMMUNITY_SIZE);
 
 	  lcom->size--;
+	  UNSET_FLAG (lcom->flags,
+		      LCOMMUNITY_FLAG_INDEXED|LCOMMUNITY_FLAG_SORTED);
 
 	  if (lcom->size > 0)
 	    lcom->val = XREALLOC (MTYPE_COMMUNITY_VAL, lcom->val,
@@ -42,6 +42,16 @@ struct lcommunity
   /* Extended Communities value.  */
   u_int8_t *val;
 
+  /* Hash value, remembered once interned.  */
+  unsigned int hash;
+
+  /* Index of the values of an interned attribute, as for
+     communities: a 64-bit summary and whether val is in order.  */
+  u_int64_t bloom;
+  u_char flags;
+#define LCOMMUNITY_FLAG_INDEXED		(1 << 0)
+#define LCOMMUNITY_FLAG_SORTED		(1 << 1)
+
   /* Human readable format string.  */
   char *str;
 };
@@ -72,4 +82,6 @@ extern int lcommunity_match (const struct lcommunity *, const struct lcommunity
 extern char *lcommunity_str (struct lcommunity *);
 extern int lcommunity_include (struct lcommunity *lcom, u_char *ptr);
 extern void lcommunity_del_val (struct lcommunity *lcom, u_char *ptr);
+extern u_int64_t lcommunity_bloom_bit (const u_char *);
+extern void lcommunity_index (struct lcommunity *);
 #endif /* _QUAGGA_BGP_LCOMMUNITY_H */
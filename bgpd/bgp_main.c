@@ -51,6 +51,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_filter.h"
 #include "bgpd/bgp_zebra.h"
+#include "bgpd/bgp_mpath.h"
+#include "bgpd/bgp_rpki.h"
 
 /* bgpd options, we use GNU getopt library. */
 static const struct option longopts[] = 
@@ -201,7 +203,10 @@ sigint (void)
 
   if (! retain_mode) 
     {
-      bgp_terminate ();
+      if (bgp_graceful_restart_configured ())
+        bgp_terminate_graceful ();
+      else
+        bgp_terminate ();
       if (bgpd_privs.user)      /* NULL if skip_runas flag set */
         zprivs_terminate (&bgpd_privs);
     }
@@ -279,6 +284,9 @@ bgp_exit (int status)
         bgp_connected_delete (c);
     }
 
+  /* multipath sets, all released with their paths */
+  bgp_mpath_finish ();
+
   /* reverse bgp_attr_init */
   bgp_attr_finish ();
 
@@ -288,6 +296,9 @@ bgp_exit (int status)
   /* reverse bgp_route_init */
   bgp_route_finish ();
 
+  /* reverse bgp_rpki_init */
+  bgp_rpki_finish ();
+
   /* reverse bgp_route_map_init/route_map_init */
   route_map_finish ();
 
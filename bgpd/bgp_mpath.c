@@ -29,6 +29,8 @@
 #include "sockunion.h"
 #include "memory.h"
 #include "filter.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -41,6 +43,14 @@
 #include "bgpd/bgp_lcommunity.h"
 #include "bgpd/bgp_mpath.h"
 
+/* Interned multipath sets, created on first use */
+static struct hash *mpath_set_hash;
+
+/* Number of aggregate attributes built, for the tests */
+static unsigned long mpath_set_aggregated;
+
+static void bgp_mpath_set_release (struct bgp_mpath_set **);
+
 bool
 bgp_mpath_is_configured_sort (struct bgp *bgp, bgp_peer_sort_t sort,
                               afi_t afi, safi_t safi)
@@ -275,8 +285,8 @@ bgp_info_mpath_free (struct bgp_info_mpath **mpath)
 {
   if (mpath && *mpath)
     {
-      if ((*mpath)->mp_attr)
-        bgp_attr_unintern (&(*mpath)->mp_attr);
+      if ((*mpath)->mp_set)
+        bgp_mpath_set_release (&(*mpath)->mp_set);
       XFREE (MTYPE_BGP_MPATH_INFO, *mpath);
       *mpath = NULL;
     }
@@ -410,26 +420,107 @@ bgp_info_mpath_count_set (struct bgp_info *binfo, u_int32_t count)
 struct attr *
 bgp_info_mpath_attr (struct bgp_info *binfo)
 {
-  if (!binfo->mpath)
+  if (!binfo->mpath || !binfo->mpath->mp_set)
     return NULL;
-  return binfo->mpath->mp_attr;
+  return binfo->mpath->mp_set->mp_attr;
 }
 
 /*
- * bgp_info_mpath_attr_set
+ * bgp_info_mpath_set_set
  *
- * Sets the aggregated attribute into bestpath's mpath element
+ * Sets the multipath set into bestpath's mpath element, releasing
+ * any previous one
  */
 static void
-bgp_info_mpath_attr_set (struct bgp_info *binfo, struct attr *attr)
+bgp_info_mpath_set_set (struct bgp_info *binfo, struct bgp_mpath_set *set)
 {
   struct bgp_info_mpath *mpath;
-  if (!attr && !binfo->mpath)
+  if (!set && !binfo->mpath)
     return;
   mpath = bgp_info_mpath_get (binfo);
   if (!mpath)
     return;
-  mpath->mp_attr = attr;
+  if (mpath->mp_set)
+    bgp_mpath_set_release (&mpath->mp_set);
+  mpath->mp_set = set;
+}
+
+/*
+ * bgp_mpath_set_hash_key
+ *
+ * Hash a multipath set by the addresses of its interned attributes
+ */
+static unsigned int
+bgp_mpath_set_hash_key (void *p)
+{
+  struct bgp_mpath_set *set = p;
+
+  if (!set->hash)
+    set->hash = jhash (set->attrs, set->count * sizeof (struct attr *),
+                       set->count);
+  return set->hash;
+}
+
+static int
+bgp_mpath_set_hash_cmp (const void *p1, const void *p2)
+{
+  const struct bgp_mpath_set *set1 = p1;
+  const struct bgp_mpath_set *set2 = p2;
+
+  return (set1->count == set2->count
+          && !memcmp (set1->attrs, set2->attrs,
+                      set1->count * sizeof (struct attr *)));
+}
+
+/*
+ * bgp_mpath_set_hash_alloc
+ *
+ * Make the interned copy of a lookup key, taking a reference on each
+ * attribute so that none of them can be freed, and its address reused,
+ * while the set exists
+ */
+static void *
+bgp_mpath_set_hash_alloc (void *p)
+{
+  struct bgp_mpath_set *key = p;
+  struct bgp_mpath_set *set;
+  u_int32_t i;
+
+  set = XCALLOC (MTYPE_BGP_MPATH_SET, sizeof (struct bgp_mpath_set)
+                 + key->count * sizeof (struct attr *));
+  set->hash = key->hash;
+  set->count = key->count;
+  set->attrs = (struct attr **) (set + 1);
+  for (i = 0; i < key->count; i++)
+    set->attrs[i] = bgp_attr_intern (key->attrs[i]);
+
+  return set;
+}
+
+/*
+ * bgp_mpath_set_release
+ *
+ * Drop a reference to a multipath set, freeing it with the last one
+ */
+static void
+bgp_mpath_set_release (struct bgp_mpath_set **pset)
+{
+  struct bgp_mpath_set *set = *pset;
+  struct bgp_mpath_set *ret;
+  u_int32_t i;
+
+  *pset = NULL;
+  if (--set->refcnt)
+    return;
+
+  ret = hash_release (mpath_set_hash, set);
+  assert (ret == set);
+
+  if (set->mp_attr)
+    bgp_attr_unintern (&set->mp_attr);
+  for (i = 0; i < set->count; i++)
+    bgp_attr_unintern (&set->attrs[i]);
+  XFREE (MTYPE_BGP_MPATH_SET, set);
 }
 
 /*
@@ -626,85 +717,30 @@ bgp_mp_dmed_deselect (struct bgp_info *dmed_best)
 }
 
 /*
- * bgp_info_mpath_aggregate_update
+ * bgp_mpath_set_aggregate
  *
- * Set the multipath aggregate attribute. We need to see if the
- * aggregate has changed and then set the ATTR_CHANGED flag on the
- * bestpath info so that a peer update will be generated. The
- * change is detected by generating the current attribute,
- * interning it, and then comparing the interned pointer with the
- * current value. We can skip this generate/compare step if there
- * is no change in multipath selection and no attribute change in
- * any multipath.
+ * Build the aggregated attribute of a multipath set from the attributes
+ * of its bestpath and multipaths. Only done once for each set, however
+ * many prefixes share it.
  */
-void
-bgp_info_mpath_aggregate_update (struct bgp_info *new_best,
-                                 struct bgp_info *old_best)
+static struct attr *
+bgp_mpath_set_aggregate (struct bgp_mpath_set *set)
 {
-  struct bgp_info *mpinfo;
+  struct attr *mpattr;
   struct aspath *aspath;
   struct aspath *asmerge;
-  struct attr *new_attr, *old_attr;
-  u_char origin, attr_chg;
+  struct attr *new_attr;
+  u_char origin;
   struct community *community, *commerge;
   struct ecommunity *ecomm, *ecommerge;
   struct lcommunity *lcomm, *lcommerge;
   struct attr_extra *ae;
   struct attr attr = { 0 };
+  u_int32_t i;
 
-  if (old_best && (old_best != new_best) &&
-      (old_attr = bgp_info_mpath_attr (old_best)))
-    {
-      bgp_attr_unintern (&old_attr);
-      bgp_info_mpath_attr_set (old_best, NULL);
-    }
-
-  if (!new_best)
-    return;
-
-  if (!bgp_info_mpath_count (new_best))
-    {
-      if ((new_attr = bgp_info_mpath_attr (new_best)))
-        {
-          bgp_attr_unintern (&new_attr);
-          bgp_info_mpath_attr_set (new_best, NULL);
-          SET_FLAG (new_best->flags, BGP_INFO_ATTR_CHANGED);
-        }
-      return;
-    }
-
-  /*
-   * Bail out here if the following is true:
-   * - MULTIPATH_CHG bit is not set on new_best, and
-   * - No change in bestpath, and
-   * - ATTR_CHANGED bit is not set on new_best or any of the multipaths
-   */
-  if (!CHECK_FLAG (new_best->flags, BGP_INFO_MULTIPATH_CHG) &&
-      (old_best == new_best))
-    {
-      attr_chg = 0;
-
-      if (CHECK_FLAG (new_best->flags, BGP_INFO_ATTR_CHANGED))
-        attr_chg = 1;
-      else
-        for (mpinfo = bgp_info_mpath_first (new_best); mpinfo;
-             mpinfo = bgp_info_mpath_next (mpinfo))
-          {
-            if (CHECK_FLAG (mpinfo->flags, BGP_INFO_ATTR_CHANGED))
-              {
-                attr_chg = 1;
-                break;
-              }
-          }
-
-      if (!attr_chg)
-        {
-          assert (bgp_info_mpath_attr (new_best));
-          return;
-        }
-    }
+  mpath_set_aggregated++;
 
-  bgp_attr_dup (&attr, new_best->attr);
+  bgp_attr_dup (&attr, set->attrs[0]);
 
   /* aggregate attribute from multipath constituents */
   aspath = aspath_dup (attr.aspath);
@@ -715,29 +751,30 @@ bgp_info_mpath_aggregate_update (struct bgp_info *new_best,
 
   lcomm = (ae && ae->lcommunity) ? lcommunity_dup (ae->lcommunity) : NULL;
 
-  for (mpinfo = bgp_info_mpath_first (new_best); mpinfo;
-       mpinfo = bgp_info_mpath_next (mpinfo))
+  for (i = 1; i < set->count; i++)
     {
-      asmerge = aspath_aggregate_mpath (aspath, mpinfo->attr->aspath);
+      mpattr = set->attrs[i];
+
+      asmerge = aspath_aggregate_mpath (aspath, mpattr->aspath);
       aspath_free (aspath);
       aspath = asmerge;
 
-      if (origin < mpinfo->attr->origin)
-        origin = mpinfo->attr->origin;
+      if (origin < mpattr->origin)
+        origin = mpattr->origin;
 
-      if (mpinfo->attr->community)
+      if (mpattr->community)
         {
           if (community)
             {
-              commerge = community_merge (community, mpinfo->attr->community);
+              commerge = community_merge (community, mpattr->community);
               community = community_uniq_sort (commerge);
               community_free (commerge);
             }
           else
-            community = community_dup (mpinfo->attr->community);
+            community = community_dup (mpattr->community);
         }
 
-      ae = mpinfo->attr->extra;
+      ae = mpattr->extra;
       if (ae && ae->ecommunity)
         {
           if (ecomm)
@@ -776,6 +813,12 @@ bgp_info_mpath_aggregate_update (struct bgp_info *new_best,
       ae->ecommunity = ecomm;
       attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_EXT_COMMUNITIES);
     }
+  if (lcomm)
+    {
+      ae = bgp_attr_extra_get (&attr);
+      ae->lcommunity = lcomm;
+      attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_LARGE_COMMUNITIES);
+    }
 
   /* Zap multipath attr nexthop so we set nexthop to self */
   attr.nexthop.s_addr = 0;
@@ -787,13 +830,156 @@ bgp_info_mpath_aggregate_update (struct bgp_info *new_best,
   new_attr = bgp_attr_intern (&attr);
   bgp_attr_extra_free (&attr);
 
-  if (new_attr != bgp_info_mpath_attr (new_best))
+  return new_attr;
+}
+
+/*
+ * bgp_mpath_set_get
+ *
+ * Find or make the multipath set of a bestpath, as it stands after
+ * bgp_info_mpath_update, taking a reference to it
+ */
+static struct bgp_mpath_set *
+bgp_mpath_set_get (struct bgp_info *new_best)
+{
+  u_int32_t mp_count = bgp_info_mpath_count (new_best);
+  struct attr *attrs[mp_count + 1];
+  struct bgp_mpath_set key;
+  struct bgp_mpath_set *set;
+  struct bgp_info *mpinfo;
+
+  memset (&key, 0, sizeof (key));
+  key.attrs = attrs;
+  attrs[key.count++] = new_best->attr;
+  for (mpinfo = bgp_info_mpath_first (new_best);
+       mpinfo && key.count <= mp_count;
+       mpinfo = bgp_info_mpath_next (mpinfo))
+    attrs[key.count++] = mpinfo->attr;
+
+  if (!mpath_set_hash)
+    mpath_set_hash = hash_create (bgp_mpath_set_hash_key,
+                                  bgp_mpath_set_hash_cmp);
+
+  set = hash_get (mpath_set_hash, &key, bgp_mpath_set_hash_alloc);
+  set->refcnt++;
+  if (!set->mp_attr)
+    set->mp_attr = bgp_mpath_set_aggregate (set);
+
+  return set;
+}
+
+/*
+ * bgp_info_mpath_aggregate_update
+ *
+ * Set the multipath aggregate attribute. We need to see if the
+ * aggregate has changed and then set the ATTR_CHANGED flag on the
+ * bestpath info so that a peer update will be generated. The
+ * change is detected by finding the multipath set of the current
+ * selection and comparing its interned aggregate with the current
+ * value. We can skip this lookup if there is no change in multipath
+ * selection and no attribute change in any multipath.
+ */
+void
+bgp_info_mpath_aggregate_update (struct bgp_info *new_best,
+                                 struct bgp_info *old_best)
+{
+  struct bgp_info *mpinfo;
+  struct bgp_mpath_set *set;
+  u_char attr_chg;
+
+  if (old_best && (old_best != new_best) && bgp_info_mpath_attr (old_best))
+    bgp_info_mpath_set_set (old_best, NULL);
+
+  if (!new_best)
+    return;
+
+  if (!bgp_info_mpath_count (new_best))
+    {
+      if (bgp_info_mpath_attr (new_best))
+        {
+          bgp_info_mpath_set_set (new_best, NULL);
+          SET_FLAG (new_best->flags, BGP_INFO_ATTR_CHANGED);
+        }
+      return;
+    }
+
+  /*
+   * Bail out here if the following is true:
+   * - MULTIPATH_CHG bit is not set on new_best, and
+   * - No change in bestpath, and
+   * - ATTR_CHANGED bit is not set on new_best or any of the multipaths
+   */
+  if (!CHECK_FLAG (new_best->flags, BGP_INFO_MULTIPATH_CHG) &&
+      (old_best == new_best))
+    {
+      attr_chg = 0;
+
+      if (CHECK_FLAG (new_best->flags, BGP_INFO_ATTR_CHANGED))
+        attr_chg = 1;
+      else
+        for (mpinfo = bgp_info_mpath_first (new_best); mpinfo;
+             mpinfo = bgp_info_mpath_next (mpinfo))
+          {
+            if (CHECK_FLAG (mpinfo->flags, BGP_INFO_ATTR_CHANGED))
+              {
+                attr_chg = 1;
+                break;
+              }
+          }
+
+      if (!attr_chg)
+        {
+          assert (bgp_info_mpath_attr (new_best));
+          return;
+        }
+    }
+
+  set = bgp_mpath_set_get (new_best);
+
+  if (set == new_best->mpath->mp_set)
+    {
+      bgp_mpath_set_release (&set);
+      return;
+    }
+
+  if (set->mp_attr != bgp_info_mpath_attr (new_best))
+    SET_FLAG (new_best->flags, BGP_INFO_ATTR_CHANGED);
+  bgp_info_mpath_set_set (new_best, set);
+}
+
+/*
+ * bgp_mpath_set_count
+ *
+ * Number of distinct multipath sets in use
+ */
+unsigned long
+bgp_mpath_set_count (void)
+{
+  return mpath_set_hash ? mpath_set_hash->count : 0;
+}
+
+/*
+ * bgp_mpath_set_aggregated
+ *
+ * Number of aggregated attributes built so far
+ */
+unsigned long
+bgp_mpath_set_aggregated (void)
+{
+  return mpath_set_aggregated;
+}
+
+/*
+ * bgp_mpath_finish
+ *
+ * Free the multipath set hash, empty once all paths are gone
+ */
+void
+bgp_mpath_finish (void)
+{
+  if (mpath_set_hash)
     {
-      if ((old_attr = bgp_info_mpath_attr (new_best)))
-        bgp_attr_unintern (&old_attr);
-      bgp_info_mpath_attr_set (new_best, new_attr);
-      SET_FLAG (new_best->flags, BGP_INFO_ATTR_CHANGED);
+      hash_free (mpath_set_hash);
+      mpath_set_hash = NULL;
     }
-  else
-    bgp_attr_unintern (&new_attr);
 }
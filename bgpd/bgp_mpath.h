@@ -44,6 +44,31 @@ struct bgp_info_mpath
   /* When attached to best path, the number of selected multipaths */
   u_int32_t mp_count;
 
+  /* When attached to best path, the multipath set, which holds the
+   * aggregated attribute for advertising multipath route
+   */
+  struct bgp_mpath_set *mp_set;
+};
+
+/* The attributes of a bestpath and of its multipaths, in multipath
+ * list order, and the attribute aggregated from them. Sets are
+ * interned: prefixes learnt with the same attributes from the same
+ * contributors share one set, and its aggregate is built only once.
+ */
+struct bgp_mpath_set
+{
+  /* Reference count, one per bestpath using the set */
+  unsigned long refcnt;
+
+  /* Hash of the contributing attributes */
+  unsigned int hash;
+
+  /* Interned attributes of the bestpath and its multipaths, each
+   * holding a reference
+   */
+  u_int32_t count;
+  struct attr **attrs;
+
   /* Aggregated attribute for advertising multipath route */
   struct attr *mp_attr;
 };
@@ -79,4 +104,9 @@ extern struct bgp_info *bgp_info_mpath_next (struct bgp_info *);
 extern u_int32_t bgp_info_mpath_count (struct bgp_info *);
 extern struct attr *bgp_info_mpath_attr (struct bgp_info *);
 
+/* Interned multipath sets */
+extern unsigned long bgp_mpath_set_count (void);
+extern unsigned long bgp_mpath_set_aggregated (void);
+extern void bgp_mpath_finish (void);
+
 #endif /* _QUAGGA_BGP_MPATH_H */
@@ -431,6 +431,7 @@ static const struct message capcode_str[] =
   { CAPABILITY_CODE_RESTART,		"Graceful Restart"		},
   { CAPABILITY_CODE_AS4,		"4-octet AS number"		},
   { CAPABILITY_CODE_DYNAMIC,		"Dynamic"			},
+  { CAPABILITY_CODE_ENHANCED_RR,	"Enhanced Route Refresh"	},
   { CAPABILITY_CODE_REFRESH_OLD,	"Route Refresh (Old)"		},
   { CAPABILITY_CODE_ORF_OLD,		"ORF (Old)"			},
 };
@@ -445,6 +446,7 @@ static const size_t cap_minsizes[] =
   [CAPABILITY_CODE_RESTART]	= CAPABILITY_CODE_RESTART_LEN,
   [CAPABILITY_CODE_AS4]		= CAPABILITY_CODE_AS4_LEN,
   [CAPABILITY_CODE_DYNAMIC]	= CAPABILITY_CODE_DYNAMIC_LEN,
+  [CAPABILITY_CODE_ENHANCED_RR]	= CAPABILITY_CODE_ENHANCED_RR_LEN,
   [CAPABILITY_CODE_REFRESH_OLD]	= CAPABILITY_CODE_REFRESH_LEN,
   [CAPABILITY_CODE_ORF_OLD]	= CAPABILITY_CODE_ORF_LEN,
 };
@@ -462,6 +464,7 @@ static const size_t cap_modsizes[] =
   [CAPABILITY_CODE_RESTART]     = 1,
   [CAPABILITY_CODE_AS4]         = 4,
   [CAPABILITY_CODE_DYNAMIC]     = 1,
+  [CAPABILITY_CODE_ENHANCED_RR] = 1,
   [CAPABILITY_CODE_REFRESH_OLD] = 1,
   [CAPABILITY_CODE_ORF_OLD]     = 1,
 };
@@ -526,6 +529,7 @@ bgp_capability_parse (struct peer *peer, size_t length, int *mp_capability,
           case CAPABILITY_CODE_RESTART:
           case CAPABILITY_CODE_AS4:
           case CAPABILITY_CODE_DYNAMIC:
+          case CAPABILITY_CODE_ENHANCED_RR:
               /* Check length. */
               if (caphdr.length < cap_minsizes[caphdr.code])
                 {
@@ -601,6 +605,9 @@ bgp_capability_parse (struct peer *peer, size_t length, int *mp_capability,
           case CAPABILITY_CODE_DYNAMIC:
             SET_FLAG (peer->cap, PEER_CAP_DYNAMIC_RCV);
             break;
+          case CAPABILITY_CODE_ENHANCED_RR:
+            SET_FLAG (peer->cap, PEER_CAP_ENHANCED_RR_RCV);
+            break;
           case CAPABILITY_CODE_AS4:
               /* Already handled as a special-case parsing of the capabilities
                * at the beginning of OPEN processing. So we care not a jot
@@ -1068,6 +1075,13 @@ bgp_open_capability (struct stream *s, struct peer *peer)
   stream_putc (s, CAPABILITY_CODE_REFRESH);
   stream_putc (s, CAPABILITY_CODE_REFRESH_LEN);
 
+  /* Enhanced route refresh. */
+  SET_FLAG (peer->cap, PEER_CAP_ENHANCED_RR_ADV);
+  stream_putc (s, BGP_OPEN_OPT_CAP);
+  stream_putc (s, CAPABILITY_CODE_ENHANCED_RR_LEN + 2);
+  stream_putc (s, CAPABILITY_CODE_ENHANCED_RR);
+  stream_putc (s, CAPABILITY_CODE_ENHANCED_RR_LEN);
+
   /* AS4 */
   SET_FLAG (peer->cap, PEER_CAP_AS4_ADV);
   stream_putc (s, BGP_OPEN_OPT_CAP);
@@ -1126,7 +1140,8 @@ bgp_open_capability (struct stream *s, struct peer *peer)
             {
               stream_putw (s, afi);
               stream_putc (s, safi);
-              stream_putc (s, 0); //Forwarding is not retained as of now.
+              /* zebra keeps the unicast routes across our restarts. */
+              stream_putc (s, safi == SAFI_UNICAST ? RESTART_F_BIT : 0);
             }
     }
 
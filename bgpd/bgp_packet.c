@@ -50,6 +50,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_encap.h"
 #include "bgpd/bgp_advertise.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_zebra.h"
 
 int stream_put_prefix (struct stream *, struct prefix *);
 
@@ -140,7 +141,32 @@ bgp_connect_check (struct peer *peer)
     }
 }
 
-/* Make BGP update packet.  */
+/* Is the head of the update FIFO allowed out yet?  Routes from a
+   restarting peer are held back until its End-of-RIB has been seen. */
+static int
+bgp_update_ready (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_advertise *adv;
+
+  adv = BGP_ADV_FIFO_HEAD (&peer->sync[afi][safi]->update);
+  if (! adv || ! adv->binfo || adv->binfo->uptime >= peer->synctime)
+    return 0;
+
+  if (CHECK_FLAG (adv->binfo->peer->cap, PEER_CAP_RESTART_RCV)
+      && CHECK_FLAG (adv->binfo->peer->cap, PEER_CAP_RESTART_ADV)
+      && ! (CHECK_FLAG (adv->binfo->peer->cap, PEER_CAP_RESTART_BIT_RCV) &&
+            CHECK_FLAG (adv->binfo->peer->cap, PEER_CAP_RESTART_BIT_ADV))
+      && ! CHECK_FLAG (adv->binfo->flags, BGP_INFO_STALE)
+      && safi != SAFI_MPLS_VPN)
+    return CHECK_FLAG (adv->binfo->peer->af_sflags[afi][safi],
+                       PEER_STATUS_EOR_RECEIVED) ? 1 : 0;
+
+  return 1;
+}
+
+/* Make BGP update packet.  For IPv4 unicast peer->work may already
+   hold the header and withdrawn routes of the message, see
+   bgp_withdraw_packet.  */
 static struct stream *
 bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
 {
@@ -159,7 +185,6 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
   size_t mpattr_pos = 0;
 
   s = peer->work;
-  stream_reset (s);
   snlri = peer->scratch;
   stream_reset (snlri);
 
@@ -181,47 +206,41 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
       if (space_remaining < space_needed)
 	break;
 
-      /* If packet is empty, set attribute. */
-      if (stream_empty (s))
+      /* If packet has no attributes yet, set them. */
+      if (! attrlen_pos)
 	{
-	  struct prefix_rd *prd = NULL;
-	  u_char *tag = NULL;
 	  struct peer *from = NULL;
 
-	  if (rn->prn)
-	    prd = (struct prefix_rd *) &rn->prn->p;
           if (binfo)
-            {
-              from = binfo->peer;
-              if (binfo->extra)
-                tag = binfo->extra->tag;
-            }
+            from = binfo->peer;
 
 	  /* 1: Write the BGP message header - 16 bytes marker, 2 bytes length,
-	   * one byte message type.
+	   * one byte message type, then an empty withdrawn routes length,
+	   * unless the message already carries withdrawn routes.
 	   */
-	  bgp_packet_set_marker (s, BGP_MSG_UPDATE);
-
-	  /* 2: withdrawn routes length */
-	  stream_putw (s, 0);
+	  if (stream_empty (s))
+	    {
+	      bgp_packet_set_marker (s, BGP_MSG_UPDATE);
+	      stream_putw (s, 0);
+	    }
 
-	  /* 3: total attributes length - attrlen_pos stores the position */
+	  /* 2: total attributes length - attrlen_pos stores the position */
 	  attrlen_pos = stream_get_endp (s);
 	  stream_putw (s, 0);
 
-	  /* 4: if there is MP_REACH_NLRI attribute, that should be the first
+	  /* 3: if there is MP_REACH_NLRI attribute, that should be the first
 	   * attribute, according to draft-ietf-idr-error-handling. Save the
 	   * position.
 	   */
 	  mpattr_pos = stream_get_endp(s);
 
-	  /* 5: Encode all the attributes, except MP_REACH_NLRI attr. */
-	  total_attr_len = bgp_packet_attribute (NULL, peer, s,
-	                                         adv->baa->attr,
-                                                 ((afi == AFI_IP && safi == SAFI_UNICAST) ?
-                                                  &rn->p : NULL),
-                                                 afi, safi,
-	                                         from, prd, tag);
+	  /* 4: Encode all the attributes, except MP_REACH_NLRI attr.  The
+	   * encoding is shared by all UPDATEs, and all equivalent peers,
+	   * sending this interned attribute.
+	   */
+	  total_attr_len = bgp_packet_attribute_cached (NULL, peer, s,
+	                                                adv->baa->attr,
+	                                                afi, safi, from);
           space_remaining = STREAM_CONCAT_REMAIN (s, snlri, STREAM_SIZE(s)) -
                             BGP_MAX_PACKET_SIZE_OVERFLOW;
           space_needed = BGP_NLRI_LENGTH + bgp_packet_mpattr_prefix_size (afi, safi, &rn->p);;
@@ -230,11 +249,22 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
            * return */
           if (space_remaining < space_needed)
             {
+              /* Send the withdrawn routes already in the message on their
+               * own, the attributes get a message to themselves next time.
+               */
+              if (attrlen_pos > BGP_HEADER_SIZE + BGP_UNFEASIBLE_LEN)
+                {
+                  stream_set_endp (s, attrlen_pos);
+                  attrlen_pos = 0;
+                  break;
+                }
+
               zlog_err ("%s cannot send UPDATE, the attributes do not leave "
                         "room for NLRI", peer->host);
               /* Flush the FIFO update queue */
               while (adv)
                 adv = bgp_advertise_clean (peer, adv->adj, afi, safi);
+              stream_reset (s);
               return NULL;
             } 
 
@@ -281,19 +311,28 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
 
   if (! stream_empty (s))
     {
-      if (!stream_empty(snlri))
+      if (! attrlen_pos)
 	{
-	  bgp_packet_mpattr_end(snlri, mpattrlen_pos);
-	  total_attr_len += stream_get_endp(snlri);
+	  /* Only withdrawn routes made it into the message. */
+	  stream_putw (s, 0);
+	  packet = stream_dup (s);
 	}
+      else
+	{
+	  if (!stream_empty(snlri))
+	    {
+	      bgp_packet_mpattr_end(snlri, mpattrlen_pos);
+	      total_attr_len += stream_get_endp(snlri);
+	    }
 
-      /* set the total attribute length correctly */
-      stream_putw_at (s, attrlen_pos, total_attr_len);
+	  /* set the total attribute length correctly */
+	  stream_putw_at (s, attrlen_pos, total_attr_len);
 
-      if (!stream_empty(snlri))
-	packet = stream_dupcat(s, snlri, mpattr_pos);
-      else
-	packet = stream_dup (s);
+	  if (!stream_empty(snlri))
+	    packet = stream_dupcat(s, snlri, mpattr_pos);
+	  else
+	    packet = stream_dup (s);
+	}
       bgp_packet_set_size (packet);
       bgp_packet_add (peer, packet);
       BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
@@ -441,6 +480,13 @@ bgp_withdraw_packet (struct peer *peer, afi_t afi, safi_t safi)
 	  unfeasible_len
 	    = stream_get_endp (s) - BGP_HEADER_SIZE - BGP_UNFEASIBLE_LEN;
 	  stream_putw_at (s, BGP_HEADER_SIZE, unfeasible_len);
+
+	  /* Once the withdraws are all out, fill the rest of the message
+	     with reachable routes rather than sending them separately. */
+	  if (! BGP_ADV_FIFO_HEAD (&peer->sync[afi][safi]->withdraw)
+	      && bgp_update_ready (peer, afi, safi))
+	    return bgp_update_packet (peer, afi, safi);
+
 	  stream_putw (s, 0);
 	}
       else
@@ -603,6 +649,49 @@ bgp_default_withdraw_send (struct peer *peer, afi_t afi, safi_t safi)
   BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
 }
 
+/* Make a Beginning or End of Route Refresh message for afi/safi and
+   queue it to the peer. */
+static struct stream *
+bgp_route_refresh_demarcation (struct peer *peer, afi_t afi, safi_t safi,
+			       u_char subtype)
+{
+  struct stream *s;
+
+  if (BGP_DEBUG (normal, NORMAL))
+    zlog_debug ("send %s of Route Refresh for %s to %s",
+		subtype == REFRESH_SUBTYPE_BORR ? "Beginning" : "End",
+		afi_safi_print (afi, safi), peer->host);
+
+  /* Adjust safi code. */
+  if (safi == SAFI_MPLS_VPN)
+    safi = SAFI_MPLS_LABELED_VPN;
+
+  s = stream_new (BGP_MSG_ROUTE_REFRESH_MIN_SIZE);
+
+  if (CHECK_FLAG (peer->cap, PEER_CAP_REFRESH_NEW_RCV))
+    bgp_packet_set_marker (s, BGP_MSG_ROUTE_REFRESH_NEW);
+  else
+    bgp_packet_set_marker (s, BGP_MSG_ROUTE_REFRESH_OLD);
+
+  stream_putw (s, afi);
+  stream_putc (s, subtype);
+  stream_putc (s, safi);
+
+  bgp_packet_set_size (s);
+  bgp_packet_add (peer, s);
+  return s;
+}
+
+/* Whether everything for afi/safi re-advertised on a route refresh
+   request has gone out, and it is time to say so. */
+static int
+bgp_route_refresh_done (struct peer *peer, afi_t afi, safi_t safi)
+{
+  return (CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_EORR_SEND)
+	  && ! FIFO_HEAD (&peer->sync[afi][safi]->update)
+	  && ! FIFO_HEAD (&peer->sync[afi][safi]->withdraw));
+}
+
 /* Get next packet to be written.  */
 static struct stream *
 bgp_write_packet (struct peer *peer)
@@ -631,32 +720,20 @@ bgp_write_packet (struct peer *peer)
   for (afi = AFI_IP; afi < AFI_MAX; afi++)
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
       {
-	adv = BGP_ADV_FIFO_HEAD (&peer->sync[afi][safi]->update);
-	if (adv)
+	if (bgp_update_ready (peer, afi, safi))
 	  {
-            if (adv->binfo && adv->binfo->uptime < peer->synctime)
-	      {
-		if (CHECK_FLAG (adv->binfo->peer->cap, PEER_CAP_RESTART_RCV)
-		    && CHECK_FLAG (adv->binfo->peer->cap, PEER_CAP_RESTART_ADV)
-		    && ! (CHECK_FLAG (adv->binfo->peer->cap,
-                                      PEER_CAP_RESTART_BIT_RCV) &&
-		          CHECK_FLAG (adv->binfo->peer->cap,
-                                      PEER_CAP_RESTART_BIT_ADV))
-		    && ! CHECK_FLAG (adv->binfo->flags, BGP_INFO_STALE)
-		    && safi != SAFI_MPLS_VPN)
-		  {
-		    if (CHECK_FLAG (adv->binfo->peer->af_sflags[afi][safi],
-			PEER_STATUS_EOR_RECEIVED))
-		      s = bgp_update_packet (peer, afi, safi);
-		  }
-		else
-		  s = bgp_update_packet (peer, afi, safi);
-	      }
-
+	    s = bgp_update_packet (peer, afi, safi);
 	    if (s)
 	      return s;
 	  }
 
+	if (bgp_route_refresh_done (peer, afi, safi))
+	  {
+	    UNSET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_EORR_SEND);
+	    return bgp_route_refresh_demarcation (peer, afi, safi,
+						  REFRESH_SUBTYPE_EORR);
+	  }
+
 	if (CHECK_FLAG (peer->cap, PEER_CAP_RESTART_RCV))
 	  {
 	    if (peer->afc_nego[afi][safi] && peer->synctime
@@ -695,6 +772,11 @@ bgp_write_proceed (struct peer *peer)
 	if (adv->binfo->uptime < peer->synctime)
 	  return 1;
 
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      if (bgp_route_refresh_done (peer, afi, safi))
+	return 1;
+
   return 0;
 }
 
@@ -1992,6 +2074,9 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
 	  if (peer->nsf[afi][safi])
 	    bgp_clear_stale_route (peer, afi, safi);
 
+	  /* We may have all routes back after our own restart. */
+	  bgp_fib_hold_check (peer->bgp);
+
 	  if (BGP_DEBUG (normal, NORMAL))
 	    zlog (peer->log, LOG_DEBUG, "rcvd End-of-RIB for %s from %s",
 		  peer->host, afi_safi_print (afi, safi));
@@ -2113,6 +2198,7 @@ bgp_route_refresh_receive (struct peer *peer, bgp_size_t size)
 {
   afi_t afi;
   safi_t safi;
+  u_char subtype;
   struct stream *s;
 
   /* If peer does not have the capability, send notification. */
@@ -2140,13 +2226,27 @@ bgp_route_refresh_receive (struct peer *peer, bgp_size_t size)
   
   /* Parse packet. */
   afi = stream_getw (s);
-  /* reserved byte */
-  stream_getc (s);
+  /* subtype, reserved before RFC 7313 */
+  subtype = stream_getc (s);
   safi = stream_getc (s);
 
   if (BGP_DEBUG (normal, NORMAL))
-    zlog_debug ("%s rcvd REFRESH_REQ for afi/safi: %d/%d",
-	       peer->host, afi, safi);
+    zlog_debug ("%s rcvd REFRESH_REQ for afi/safi: %d/%d, subtype %d",
+	       peer->host, afi, safi, subtype);
+
+  if (subtype != REFRESH_SUBTYPE_NORMAL)
+    {
+      if (subtype != REFRESH_SUBTYPE_BORR && subtype != REFRESH_SUBTYPE_EORR)
+	return;
+
+      if (size != BGP_MSG_ROUTE_REFRESH_MIN_SIZE - BGP_HEADER_SIZE)
+	{
+	  zlog_info ("%s Route refresh demarcation length error", peer->host);
+	  bgp_notify_send (peer, BGP_NOTIFY_ROUTE_REFRESH_ERR,
+			   BGP_NOTIFY_ROUTE_REFRESH_INVALID_MSG_LEN);
+	  return;
+	}
+    }
 
   /* Check AFI and SAFI. */
   if ((afi != AFI_IP && afi != AFI_IP6)
@@ -2165,6 +2265,27 @@ bgp_route_refresh_receive (struct peer *peer, bgp_size_t size)
   if (safi == SAFI_MPLS_LABELED_VPN)
     safi = SAFI_MPLS_VPN;
 
+  /* The peer is about to send its routes afresh.  Those it does not
+     send again before the end are gone. */
+  if (subtype == REFRESH_SUBTYPE_BORR)
+    {
+      if (peer->afc[afi][safi] && safi != SAFI_MPLS_VPN)
+	{
+	  SET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_BORR_RECEIVED);
+	  bgp_set_stale_route (peer, afi, safi);
+	}
+      return;
+    }
+  if (subtype == REFRESH_SUBTYPE_EORR)
+    {
+      if (CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_BORR_RECEIVED))
+	{
+	  UNSET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_BORR_RECEIVED);
+	  bgp_clear_stale_route (peer, afi, safi);
+	}
+      return;
+    }
+
   if (size != BGP_MSG_ROUTE_REFRESH_MIN_SIZE - BGP_HEADER_SIZE)
     {
       u_char *end;
@@ -2312,6 +2433,17 @@ bgp_route_refresh_receive (struct peer *peer, bgp_size_t size)
   if (CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_WAIT_REFRESH))
     UNSET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_WAIT_REFRESH);
 
+  /* Bracket the routes with BoRR and EoRR, so the peer can tell which
+     of what it had from us are no more. */
+  else if (CHECK_FLAG (peer->cap, PEER_CAP_ENHANCED_RR_RCV)
+	   && CHECK_FLAG (peer->cap, PEER_CAP_ENHANCED_RR_ADV)
+	   && peer->afc_nego[afi][safi] && safi != SAFI_MPLS_VPN)
+    {
+      bgp_route_refresh_demarcation (peer, afi, safi, REFRESH_SUBTYPE_BORR);
+      SET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_EORR_SEND);
+      BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+    }
+
   /* Perform route refreshment to the peer */
   bgp_announce_route (peer, afi, safi);
 }
@@ -30,6 +30,11 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define REFRESH_IMMEDIATE 1
 #define REFRESH_DEFER     2 
 
+/* Route refresh message subtypes (RFC 7313) */
+#define REFRESH_SUBTYPE_NORMAL 0
+#define REFRESH_SUBTYPE_BORR   1 /* Beginning of Route Refresh */
+#define REFRESH_SUBTYPE_EORR   2 /* End of Route Refresh */
+
 /* ORF Common part flag */
 #define ORF_COMMON_PART_ADD        0x00 
 #define ORF_COMMON_PART_REMOVE     0x80 
@@ -24,6 +24,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "command.h"
 #include "memory.h"
 #include "filter.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "bgpd.h"
 #include "bgp_aspath.h"
@@ -83,7 +85,7 @@ bgp_regcomp (const char *regstr)
 int
 bgp_regexec (regex_t *regex, struct aspath *aspath)
 {
-  return regexec (regex, aspath->str, 0, NULL, 0);
+  return regexec (regex, aspath_print (aspath), 0, NULL, 0);
 }
 
 void
@@ -92,3 +94,750 @@ bgp_regex_free (regex_t *regex)
   regfree (regex);
   XFREE (MTYPE_BGP_REGEXP, regex);
 }
+
+/* AS path regular expressions.
+
+   The expression is compiled into a Thompson NFA over the characters
+   of the AS path string form, with `_' handled as above.  Paths made
+   only of AS_SEQUENCE segments are then matched a whole AS number at a
+   time: the NFA is determinised lazily into states holding the NFA
+   state set at the start of an AS number, and the transition for each
+   (state, AS number) pair is cached, so a match costs one hash lookup
+   per AS number.  Other paths are matched on the string by simulating
+   the NFA directly.  Expressions using anything beyond plain POSIX
+   ERE operators and bracket lists are handed to regcomp () instead. */
+
+/* NFA state opcodes. */
+#define RE_CHAR		0	/* Consume a character in cset. */
+#define RE_SPLIT	1	/* Epsilon to out and out1. */
+#define RE_NOP		2	/* Epsilon to out. */
+#define RE_BOL		3	/* Epsilon to out at start of string. */
+#define RE_EOL		4	/* Epsilon to out at end of string. */
+#define RE_MATCH	5
+
+struct re_state
+{
+  u_char op;
+  int out;
+  int out1;
+  u_int32_t cset[8];
+};
+
+/* Bounds on the lazily built DFA, which is thrown away when hit. */
+#define RE_DSTATE_MAX	1024
+#define RE_DTRANS_MAX	65536
+
+/* DFA state: closed NFA state set at the start of an AS number. */
+struct re_dstate
+{
+  u_int32_t id;
+  int nwords;
+  u_int32_t *set;
+};
+
+struct re_dtrans
+{
+  struct re_dstate *from;
+  as_t asn;
+
+  /* A match ends within this AS number or its separator. */
+  u_char matched;
+
+  /* Result if this is the last AS number of the path. */
+  u_char last;
+
+  /* State at the start of the next AS number. */
+  struct re_dstate *to;
+};
+
+struct bgp_aspath_regex
+{
+  u_int32_t id;
+
+  /* Used for expressions the NFA compiler does not handle. */
+  regex_t *posix;
+
+  struct re_state *states;
+  int nstates;
+  int size;
+  int start;
+  int match;
+
+  /* Bitset words per NFA state set and scratch sets. */
+  int nwords;
+  u_int32_t *work[4];
+
+  /* Results for the empty path and for any path, when known upfront. */
+  u_char empty;
+  u_char always;
+
+  struct re_dstate *initial;
+  struct hash *dstates;
+  struct hash *dtrans;
+  u_int32_t dstate_id;
+};
+
+/* Identifies compiled expressions in the per-aspath result memo. */
+static u_int32_t bgp_aspath_regex_id;
+
+#define RE_SET_TEST(S,N)	((S)[(N) >> 5] & (1U << ((N) & 31)))
+#define RE_SET_ADD(S,N)		((S)[(N) >> 5] |= (1U << ((N) & 31)))
+
+static int
+re_state_new (struct bgp_aspath_regex *re, u_char op)
+{
+  struct re_state *s;
+
+  if (re->nstates == re->size)
+    {
+      re->size = re->size ? re->size * 2 : 32;
+      re->states = XREALLOC (MTYPE_BGP_ASPATH_REGEX, re->states,
+			     re->size * sizeof (struct re_state));
+    }
+  s = &re->states[re->nstates];
+  memset (s, 0, sizeof (struct re_state));
+  s->op = op;
+  s->out = -1;
+  s->out1 = -1;
+  return re->nstates++;
+}
+
+/* Dangling out pointers of a fragment are chained through the out
+   fields themselves, encoded as state * 2 + (out1 ? 1 : 0). */
+static int *
+re_slot (struct bgp_aspath_regex *re, int code)
+{
+  struct re_state *s = &re->states[code >> 1];
+
+  return (code & 1) ? &s->out1 : &s->out;
+}
+
+static void
+re_patch (struct bgp_aspath_regex *re, int list, int target)
+{
+  int next;
+
+  while (list != -1)
+    {
+      next = *re_slot (re, list);
+      *re_slot (re, list) = target;
+      list = next;
+    }
+}
+
+static int
+re_append (struct bgp_aspath_regex *re, int l1, int l2)
+{
+  int l = l1;
+
+  if (l1 == -1)
+    return l2;
+  while (*re_slot (re, l) != -1)
+    l = *re_slot (re, l);
+  *re_slot (re, l) = l2;
+  return l1;
+}
+
+struct re_frag
+{
+  int start;
+  int out;
+};
+
+struct re_parser
+{
+  struct bgp_aspath_regex *re;
+  const char *p;
+  int error;
+
+  /* Last atom was an anchor, which POSIX does not let us repeat. */
+  int anchor;
+};
+
+static struct re_frag re_parse_alt (struct re_parser *);
+
+static struct re_frag
+re_frag_state (struct bgp_aspath_regex *re, u_char op)
+{
+  struct re_frag f;
+
+  f.start = re_state_new (re, op);
+  f.out = f.start << 1;
+  return f;
+}
+
+static struct re_frag
+re_frag_alt (struct bgp_aspath_regex *re, struct re_frag f1, struct re_frag f2)
+{
+  struct re_frag f;
+
+  f.start = re_state_new (re, RE_SPLIT);
+  re->states[f.start].out = f1.start;
+  re->states[f.start].out1 = f2.start;
+  f.out = re_append (re, f1.out, f2.out);
+  return f;
+}
+
+static void
+re_cset_range (u_int32_t *cset, int lo, int hi)
+{
+  int c;
+
+  for (c = lo; c <= hi; c++)
+    RE_SET_ADD (cset, c);
+}
+
+/* Parse a bracket list, P points after the '['. */
+static struct re_frag
+re_parse_bracket (struct re_parser *ps)
+{
+  struct re_frag f;
+  u_int32_t cset[8];
+  int negate = 0;
+  int first = 1;
+  int lo, hi;
+  int i;
+
+  memset (cset, 0, sizeof (cset));
+  f = re_frag_state (ps->re, RE_CHAR);
+
+  if (*ps->p == '^')
+    {
+      negate = 1;
+      ps->p++;
+    }
+
+  while (*ps->p && (first || *ps->p != ']'))
+    {
+      /* Character classes, equivalence classes and collating elements */
+      if (*ps->p == '[' && (ps->p[1] == ':' || ps->p[1] == '='
+			    || ps->p[1] == '.'))
+	{
+	  ps->error = 1;
+	  return f;
+	}
+      lo = (u_char) *ps->p++;
+      hi = lo;
+      if (*ps->p == '-' && ps->p[1] && ps->p[1] != ']')
+	{
+	  hi = (u_char) ps->p[1];
+	  ps->p += 2;
+	  if (hi < lo)
+	    {
+	      ps->error = 1;
+	      return f;
+	    }
+	}
+      re_cset_range (cset, lo, hi);
+      first = 0;
+    }
+  if (*ps->p != ']')
+    {
+      ps->error = 1;
+      return f;
+    }
+  ps->p++;
+
+  if (negate)
+    for (i = 0; i < 8; i++)
+      cset[i] = ~cset[i];
+  memcpy (ps->re->states[f.start].cset, cset, sizeof (cset));
+  return f;
+}
+
+static struct re_frag
+re_parse_atom (struct re_parser *ps)
+{
+  struct bgp_aspath_regex *re = ps->re;
+  struct re_frag f, f1, f2;
+  int c;
+
+  c = (u_char) *ps->p++;
+  ps->anchor = (c == '^' || c == '$' || c == '_');
+  switch (c)
+    {
+    case '(':
+      if (*ps->p == ')')
+	{
+	  ps->p++;
+	  return re_frag_state (re, RE_NOP);
+	}
+      f = re_parse_alt (ps);
+      if (*ps->p != ')')
+	ps->error = 1;
+      else
+	ps->p++;
+      return f;
+    case '[':
+      return re_parse_bracket (ps);
+    case '^':
+      return re_frag_state (re, RE_BOL);
+    case '$':
+      return re_frag_state (re, RE_EOL);
+    case '.':
+      f = re_frag_state (re, RE_CHAR);
+      memset (re->states[f.start].cset, 0xff, sizeof (u_int32_t) * 8);
+      return f;
+    case '_':
+      /* (^|[,{}() ]|$) */
+      f = re_frag_state (re, RE_CHAR);
+      RE_SET_ADD (re->states[f.start].cset, ',');
+      RE_SET_ADD (re->states[f.start].cset, '{');
+      RE_SET_ADD (re->states[f.start].cset, '}');
+      RE_SET_ADD (re->states[f.start].cset, '(');
+      RE_SET_ADD (re->states[f.start].cset, ')');
+      RE_SET_ADD (re->states[f.start].cset, ' ');
+      f1 = re_frag_state (re, RE_BOL);
+      f2 = re_frag_state (re, RE_EOL);
+      return re_frag_alt (re, f1, re_frag_alt (re, f, f2));
+    case '\\':
+      c = (u_char) *ps->p++;
+      /* Back references and GNU operators. */
+      if (c == '\0' || isalnum (c) || strchr ("<>`'", c))
+	{
+	  ps->error = 1;
+	  return re_frag_state (re, RE_NOP);
+	}
+      break;
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+    case '|':
+    case ')':
+      ps->error = 1;
+      return re_frag_state (re, RE_NOP);
+    }
+
+  f = re_frag_state (re, RE_CHAR);
+  RE_SET_ADD (re->states[f.start].cset, c);
+  return f;
+}
+
+static struct re_frag
+re_parse_repeat (struct re_parser *ps)
+{
+  struct bgp_aspath_regex *re = ps->re;
+  struct re_frag f;
+  int s;
+
+  f = re_parse_atom (ps);
+  if (ps->anchor && *ps->p && strchr ("*+?{", *ps->p))
+    ps->error = 1;
+
+  while (! ps->error)
+    {
+      switch (*ps->p)
+	{
+	case '*':
+	  s = re_state_new (re, RE_SPLIT);
+	  re->states[s].out = f.start;
+	  re_patch (re, f.out, s);
+	  f.start = s;
+	  f.out = (s << 1) | 1;
+	  break;
+	case '+':
+	  s = re_state_new (re, RE_SPLIT);
+	  re->states[s].out = f.start;
+	  re_patch (re, f.out, s);
+	  f.out = (s << 1) | 1;
+	  break;
+	case '?':
+	  s = re_state_new (re, RE_SPLIT);
+	  re->states[s].out = f.start;
+	  f.start = s;
+	  f.out = re_append (re, f.out, (s << 1) | 1);
+	  break;
+	case '{':
+	  ps->error = 1;
+	  return f;
+	default:
+	  return f;
+	}
+      ps->p++;
+    }
+  return f;
+}
+
+static struct re_frag
+re_parse_seq (struct re_parser *ps)
+{
+  struct re_frag f, next;
+
+  if (*ps->p == '\0' || *ps->p == '|' || *ps->p == ')')
+    return re_frag_state (ps->re, RE_NOP);
+
+  f = re_parse_repeat (ps);
+  while (! ps->error && *ps->p && *ps->p != '|' && *ps->p != ')')
+    {
+      next = re_parse_repeat (ps);
+      re_patch (ps->re, f.out, next.start);
+      f.out = next.out;
+    }
+  return f;
+}
+
+static struct re_frag
+re_parse_alt (struct re_parser *ps)
+{
+  struct re_frag f;
+
+  f = re_parse_seq (ps);
+  while (! ps->error && *ps->p == '|')
+    {
+      ps->p++;
+      f = re_frag_alt (ps->re, f, re_parse_seq (ps));
+    }
+  return f;
+}
+
+/* Add STATE and everything reachable from it by epsilon moves. */
+static void
+re_closure (struct bgp_aspath_regex *re, u_int32_t *set, int state,
+	    int bol, int eol)
+{
+  struct re_state *s;
+
+  while (state >= 0 && ! RE_SET_TEST (set, state))
+    {
+      RE_SET_ADD (set, state);
+      s = &re->states[state];
+      switch (s->op)
+	{
+	case RE_SPLIT:
+	  re_closure (re, set, s->out1, bol, eol);
+	  state = s->out;
+	  break;
+	case RE_NOP:
+	  state = s->out;
+	  break;
+	case RE_BOL:
+	  state = bol ? s->out : -1;
+	  break;
+	case RE_EOL:
+	  state = eol ? s->out : -1;
+	  break;
+	default:
+	  return;
+	}
+    }
+}
+
+/* Consume C from CUR into NEXT, restarting the search there as well. */
+static void
+re_step (struct bgp_aspath_regex *re, u_int32_t *cur, int c, u_int32_t *next,
+	 int eol)
+{
+  int i;
+
+  memset (next, 0, re->nwords * sizeof (u_int32_t));
+  for (i = 0; i < re->nstates; i++)
+    if (RE_SET_TEST (cur, i) && re->states[i].op == RE_CHAR
+	&& RE_SET_TEST (re->states[i].cset, c))
+      re_closure (re, next, re->states[i].out, 0, eol);
+  re_closure (re, next, re->start, 0, eol);
+}
+
+/* Match against a string by simulating the NFA. */
+static int
+re_exec_str (struct bgp_aspath_regex *re, const char *str)
+{
+  u_int32_t *cur = re->work[0];
+  u_int32_t *next = re->work[1];
+  u_int32_t *tmp;
+
+  memset (cur, 0, re->nwords * sizeof (u_int32_t));
+  re_closure (re, cur, re->start, 1, *str == '\0');
+  if (RE_SET_TEST (cur, re->match))
+    return 1;
+
+  for (; *str; str++)
+    {
+      re_step (re, cur, (u_char) *str, next, str[1] == '\0');
+      if (RE_SET_TEST (next, re->match))
+	return 1;
+      tmp = cur;
+      cur = next;
+      next = tmp;
+    }
+  return 0;
+}
+
+static unsigned int
+re_dstate_key (void *p)
+{
+  struct re_dstate *d = p;
+
+  return jhash2 (d->set, d->nwords, 0);
+}
+
+static int
+re_dstate_cmp (const void *p1, const void *p2)
+{
+  const struct re_dstate *d1 = p1;
+  const struct re_dstate *d2 = p2;
+
+  return d1->nwords == d2->nwords
+    && memcmp (d1->set, d2->set, d1->nwords * sizeof (u_int32_t)) == 0;
+}
+
+static unsigned int
+re_dtrans_key (void *p)
+{
+  struct re_dtrans *t = p;
+
+  return jhash_2words (t->from->id, t->asn, 0);
+}
+
+static int
+re_dtrans_cmp (const void *p1, const void *p2)
+{
+  const struct re_dtrans *t1 = p1;
+  const struct re_dtrans *t2 = p2;
+
+  return t1->from == t2->from && t1->asn == t2->asn;
+}
+
+static void
+re_dstate_free (void *p)
+{
+  struct re_dstate *d = p;
+
+  XFREE (MTYPE_BGP_ASPATH_REGEX_DFA, d->set);
+  XFREE (MTYPE_BGP_ASPATH_REGEX_DFA, d);
+}
+
+static void
+re_dtrans_free (void *p)
+{
+  XFREE (MTYPE_BGP_ASPATH_REGEX_DFA, p);
+}
+
+/* Find or make the DFA state for SET. */
+static struct re_dstate *
+re_dstate_get (struct bgp_aspath_regex *re, u_int32_t *set)
+{
+  struct re_dstate lookup;
+  struct re_dstate *d;
+
+  lookup.nwords = re->nwords;
+  lookup.set = set;
+  d = hash_lookup (re->dstates, &lookup);
+  if (d)
+    return d;
+
+  d = XMALLOC (MTYPE_BGP_ASPATH_REGEX_DFA, sizeof (struct re_dstate));
+  d->id = ++re->dstate_id;
+  d->nwords = re->nwords;
+  d->set = XMALLOC (MTYPE_BGP_ASPATH_REGEX_DFA,
+		    re->nwords * sizeof (u_int32_t));
+  memcpy (d->set, set, re->nwords * sizeof (u_int32_t));
+  hash_get (re->dstates, d, hash_alloc_intern);
+  return d;
+}
+
+static void
+re_dfa_reset (struct bgp_aspath_regex *re)
+{
+  u_int32_t *set = re->work[0];
+
+  hash_clean (re->dtrans, re_dtrans_free);
+  hash_clean (re->dstates, re_dstate_free);
+
+  memset (set, 0, re->nwords * sizeof (u_int32_t));
+  re_closure (re, set, re->start, 1, 0);
+  re->initial = re_dstate_get (re, set);
+}
+
+/* Work out the transition from state D on AS number ASN. */
+static struct re_dtrans *
+re_dtrans_make (struct bgp_aspath_regex *re, struct re_dstate *d, as_t asn)
+{
+  struct re_dtrans *t;
+  u_int32_t *cur = re->work[0];
+  u_int32_t *next = re->work[1];
+  u_int32_t *tmp;
+  char buf[16];
+  int len, i;
+
+  t = XCALLOC (MTYPE_BGP_ASPATH_REGEX_DFA, sizeof (struct re_dtrans));
+  t->from = d;
+  t->asn = asn;
+
+  len = snprintf (buf, sizeof (buf), "%u", asn);
+  memcpy (cur, d->set, re->nwords * sizeof (u_int32_t));
+  for (i = 0; i < len - 1; i++)
+    {
+      re_step (re, cur, (u_char) buf[i], next, 0);
+      if (RE_SET_TEST (next, re->match))
+	{
+	  t->matched = t->last = 1;
+	  return t;
+	}
+      tmp = cur;
+      cur = next;
+      next = tmp;
+    }
+
+  /* Last digit, at the end of the path or followed by a space. */
+  re_step (re, cur, (u_char) buf[i], re->work[2], 1);
+  t->last = RE_SET_TEST (re->work[2], re->match) ? 1 : 0;
+
+  re_step (re, cur, (u_char) buf[i], next, 0);
+  if (! RE_SET_TEST (next, re->match))
+    {
+      re_step (re, next, ' ', re->work[3], 0);
+      if (! RE_SET_TEST (re->work[3], re->match))
+	{
+	  t->to = re_dstate_get (re, re->work[3]);
+	  return t;
+	}
+    }
+  t->matched = t->last = 1;
+  return t;
+}
+
+static int
+re_exec_aspath (struct bgp_aspath_regex *re, struct aspath *aspath)
+{
+  struct assegment *seg;
+  struct re_dstate *d;
+  struct re_dtrans lookup;
+  struct re_dtrans *t;
+  int i;
+
+  if (re->always)
+    return 1;
+  if (! aspath->segments)
+    return re->empty;
+
+  for (seg = aspath->segments; seg; seg = seg->next)
+    if (seg->type != AS_SEQUENCE || seg->length == 0)
+      return re_exec_str (re, aspath_print (aspath));
+
+  if (re->dstates->count > RE_DSTATE_MAX
+      || re->dtrans->count > RE_DTRANS_MAX)
+    re_dfa_reset (re);
+
+  d = re->initial;
+  for (seg = aspath->segments; seg; seg = seg->next)
+    for (i = 0; i < seg->length; i++)
+      {
+	lookup.from = d;
+	lookup.asn = seg->as[i];
+	t = hash_lookup (re->dtrans, &lookup);
+	if (! t)
+	  {
+	    t = re_dtrans_make (re, d, seg->as[i]);
+	    hash_get (re->dtrans, t, hash_alloc_intern);
+	  }
+	if (t->matched)
+	  return 1;
+	if (! seg->next && i == seg->length - 1)
+	  return t->last;
+	d = t->to;
+      }
+  return 0;
+}
+
+/* Compile an AS path regular expression. */
+struct bgp_aspath_regex *
+bgp_aspath_regcomp (const char *regstr)
+{
+  struct bgp_aspath_regex *re;
+  struct re_parser ps;
+  struct re_frag f;
+  regex_t *posix;
+  int i;
+
+  /* Also validates the expression for the POSIX fallback. */
+  posix = bgp_regcomp (regstr);
+  if (! posix)
+    return NULL;
+
+  re = XCALLOC (MTYPE_BGP_ASPATH_REGEX, sizeof (struct bgp_aspath_regex));
+  /* 0 marks paths no expression has been applied to. */
+  if (++bgp_aspath_regex_id == 0)
+    ++bgp_aspath_regex_id;
+  re->id = bgp_aspath_regex_id;
+
+  ps.re = re;
+  ps.p = regstr;
+  ps.error = 0;
+  f = re_parse_alt (&ps);
+  if (ps.error || *ps.p != '\0')
+    {
+      re->posix = posix;
+      XFREE (MTYPE_BGP_ASPATH_REGEX, re->states);
+      re->nstates = 0;
+      return re;
+    }
+  bgp_regex_free (posix);
+
+  re->match = re_state_new (re, RE_MATCH);
+  re_patch (re, f.out, re->match);
+  re->start = f.start;
+
+  re->nwords = (re->nstates + 31) / 32;
+  for (i = 0; i < 4; i++)
+    re->work[i] = XMALLOC (MTYPE_BGP_ASPATH_REGEX,
+			   re->nwords * sizeof (u_int32_t));
+
+  re->empty = re_exec_str (re, "");
+
+  /* E.g. "" or ".*" match at the very start of every path. */
+  memset (re->work[0], 0, re->nwords * sizeof (u_int32_t));
+  re_closure (re, re->work[0], re->start, 1, 0);
+  re->always = re->empty && RE_SET_TEST (re->work[0], re->match) ? 1 : 0;
+
+  re->dstates = hash_create (re_dstate_key, re_dstate_cmp);
+  re->dtrans = hash_create (re_dtrans_key, re_dtrans_cmp);
+  re_dfa_reset (re);
+
+  return re;
+}
+
+/* Match ASPATH against RE, returns 0 on match like regexec (). */
+int
+bgp_aspath_regexec (struct bgp_aspath_regex *re, struct aspath *aspath)
+{
+  int match;
+
+  /* Interned paths never change, remember the last result on them. */
+  if (aspath->refcnt && aspath->regex_id == re->id)
+    return aspath->regex_match ? 0 : REG_NOMATCH;
+
+  if (re->posix)
+    match = (bgp_regexec (re->posix, aspath) != REG_NOMATCH);
+  else
+    match = re_exec_aspath (re, aspath);
+
+  if (aspath->refcnt)
+    {
+      aspath->regex_id = re->id;
+      aspath->regex_match = match;
+    }
+  return match ? 0 : REG_NOMATCH;
+}
+
+void
+bgp_aspath_regex_free (struct bgp_aspath_regex *re)
+{
+  int i;
+
+  if (re->posix)
+    bgp_regex_free (re->posix);
+  if (re->dstates)
+    {
+      hash_clean (re->dtrans, re_dtrans_free);
+      hash_free (re->dtrans);
+      hash_clean (re->dstates, re_dstate_free);
+      hash_free (re->dstates);
+    }
+  for (i = 0; i < 4; i++)
+    if (re->work[i])
+      XFREE (MTYPE_BGP_ASPATH_REGEX, re->work[i]);
+  if (re->states)
+    XFREE (MTYPE_BGP_ASPATH_REGEX, re->states);
+  XFREE (MTYPE_BGP_ASPATH_REGEX, re);
+}
@@ -37,4 +37,11 @@ extern void bgp_regex_free (regex_t *regex);
 extern regex_t *bgp_regcomp (const char *str);
 extern int bgp_regexec (regex_t *regex, struct aspath *aspath);
 
+struct bgp_aspath_regex;
+
+extern struct bgp_aspath_regex *bgp_aspath_regcomp (const char *str);
+extern int bgp_aspath_regexec (struct bgp_aspath_regex *re,
+			       struct aspath *aspath);
+extern void bgp_aspath_regex_free (struct bgp_aspath_regex *re);
+
 #endif /* _QUAGGA_BGP_REGEX_H */
@@ -58,6 +58,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_mpath.h"
 #include "bgpd/bgp_nht.h"
+#include "bgpd/bgp_rpki.h"
 
 /* Extern from bgp_dump.c */
 extern const char *bgp_origin_str[];
@@ -356,12 +357,8 @@ bgp_info_cmp (struct bgp *bgp, struct bgp_info *new, struct bgp_info *exist,
   existattre = existattr->extra;
 
   /* 1. Weight check. */
-  new_weight = exist_weight = 0;
-
-  if (newattre)
-    new_weight = newattre->weight;
-  if (existattre)
-    exist_weight = existattre->weight;
+  new_weight = newattr->weight;
+  exist_weight = existattr->weight;
 
   if (new_weight > exist_weight)
     return -1;
@@ -568,9 +565,83 @@ bgp_info_cmp (struct bgp *bgp, struct bgp_info *new, struct bgp_info *exist,
   return -1;
 }
 
+/* Bumped whenever a filter or route-map that peer policy may refer to
+   changes, which invalidates every peer's policy cache. */
+static u_int32_t bgp_policy_generation;
+
+void
+bgp_policy_changed (void)
+{
+  bgp_policy_generation++;
+}
+
+void
+bgp_policy_cache_flush (struct peer *peer)
+{
+  int i;
+
+  for (i = 0; i < BGP_POLICY_MAX; i++)
+    if (peer->policy_cache[i])
+      {
+	if (peer->policy_cache[i]->attr)
+	  bgp_attr_unintern (&peer->policy_cache[i]->attr);
+	XFREE (MTYPE_BGP_POLICY_CACHE, peer->policy_cache[i]);
+      }
+}
+
+/* Return PEER's cached policy results for ATTR, resetting them when
+   ATTR differs from the last one seen or policy changed since.  ATTR
+   need not be interned, the cache holds its own interned copy. */
+static struct bgp_policy_cache *
+bgp_policy_cache_get (struct peer *peer, int which, struct attr *attr,
+		      afi_t afi, safi_t safi, struct route_map *map,
+		      struct as_list *aslist)
+{
+  struct bgp_policy_cache *cache;
+
+  cache = peer->policy_cache[which];
+  if (! cache)
+    cache = peer->policy_cache[which] =
+      XCALLOC (MTYPE_BGP_POLICY_CACHE, sizeof (struct bgp_policy_cache));
+
+  if (cache->attr
+      && cache->generation == bgp_policy_generation
+      && cache->afi == afi && cache->safi == safi
+      && cache->map == map && cache->aslist == aslist
+      && cache->weight == peer->weight
+      && (cache->attr == attr || attrhash_cmp (cache->attr, attr)))
+    return cache;
+
+  if (cache->attr)
+    bgp_attr_unintern (&cache->attr);
+  cache->attr = bgp_attr_intern (attr);
+  cache->generation = bgp_policy_generation;
+  cache->afi = afi;
+  cache->safi = safi;
+  cache->map = map;
+  cache->aslist = aslist;
+  cache->weight = peer->weight;
+  cache->aslist_result = -1;
+  memset (&cache->memo, 0, sizeof (struct route_map_memo));
+
+  return cache;
+}
+
+static enum as_filter_type
+bgp_policy_cache_aslist (struct bgp_policy_cache *cache, struct as_list *aslist,
+			 struct attr *attr)
+{
+  if (! cache)
+    return as_list_apply (aslist, attr->aspath);
+
+  if (cache->aslist_result < 0)
+    cache->aslist_result = as_list_apply (aslist, attr->aspath);
+  return cache->aslist_result;
+}
+
 static enum filter_type
 bgp_input_filter (struct peer *peer, struct prefix *p, struct attr *attr,
-		  afi_t afi, safi_t safi)
+		  afi_t afi, safi_t safi, struct bgp_policy_cache *cache)
 {
   struct bgp_filter *filter;
 
@@ -599,7 +670,8 @@ bgp_input_filter (struct peer *peer, struct prefix *p, struct attr *attr,
   if (FILTER_LIST_IN_NAME (filter)) {
     FILTER_EXIST_WARN(FILTER_LIST, as, filter);
     
-    if (as_list_apply (FILTER_LIST_IN (filter), attr->aspath)== AS_FILTER_DENY)
+    if (bgp_policy_cache_aslist (cache, FILTER_LIST_IN (filter), attr)
+	== AS_FILTER_DENY)
       return FILTER_DENY;
   }
   
@@ -609,7 +681,7 @@ bgp_input_filter (struct peer *peer, struct prefix *p, struct attr *attr,
 
 static enum filter_type
 bgp_output_filter (struct peer *peer, struct prefix *p, struct attr *attr,
-		   afi_t afi, safi_t safi)
+		   afi_t afi, safi_t safi, struct bgp_policy_cache *cache)
 {
   struct bgp_filter *filter;
 
@@ -638,7 +710,8 @@ bgp_output_filter (struct peer *peer, struct prefix *p, struct attr *attr,
   if (FILTER_LIST_OUT_NAME (filter)) {
     FILTER_EXIST_WARN(FILTER_LIST, as, filter);
     
-    if (as_list_apply (FILTER_LIST_OUT (filter), attr->aspath) == AS_FILTER_DENY)
+    if (bgp_policy_cache_aslist (cache, FILTER_LIST_OUT (filter), attr)
+	== AS_FILTER_DENY)
       return FILTER_DENY;
   }
 
@@ -691,7 +764,7 @@ bgp_cluster_filter (struct peer *peer, struct attr *attr)
 
 static int
 bgp_input_modifier (struct peer *peer, struct prefix *p, struct attr *attr,
-		    afi_t afi, safi_t safi)
+		    afi_t afi, safi_t safi, struct bgp_policy_cache *cache)
 {
   struct bgp_filter *filter;
   struct bgp_info info;
@@ -701,7 +774,7 @@ bgp_input_modifier (struct peer *peer, struct prefix *p, struct attr *attr,
 
   /* Apply default weight value. */
   if (peer->weight)
-    (bgp_attr_extra_get (attr))->weight = peer->weight;
+    attr->weight = peer->weight;
 
   /* Route map apply. */
   if (ROUTE_MAP_IN_NAME (filter))
@@ -713,7 +786,11 @@ bgp_input_modifier (struct peer *peer, struct prefix *p, struct attr *attr,
       SET_FLAG (peer->rmap_type, PEER_RMAP_TYPE_IN); 
 
       /* Apply BGP route map to the attribute. */
-      ret = route_map_apply (ROUTE_MAP_IN (filter), p, RMAP_BGP, &info);
+      if (cache)
+	ret = route_map_apply_memo (ROUTE_MAP_IN (filter), p, RMAP_BGP, &info,
+				    &cache->memo);
+      else
+	ret = route_map_apply (ROUTE_MAP_IN (filter), p, RMAP_BGP, &info);
 
       peer->rmap_type = 0;
 
@@ -770,7 +847,7 @@ bgp_import_modifier (struct peer *rsclient, struct peer *peer,
 
   /* Apply default weight value. */
   if (peer->weight)
-    (bgp_attr_extra_get (attr))->weight = peer->weight;
+    attr->weight = peer->weight;
 
   /* Route map apply. */
   if (ROUTE_MAP_IMPORT_NAME (filter))
@@ -808,6 +885,7 @@ bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
   int transparent;
   int reflect;
   struct attr *riattr;
+  struct bgp_policy_cache *cache;
 
   from = ri->peer;
   filter = &peer->filter[afi][safi];
@@ -877,7 +955,12 @@ bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
       }
 
   /* Output filter check. */
-  if (bgp_output_filter (peer, p, riattr, afi, safi) == FILTER_DENY)
+  cache = NULL;
+  if (FILTER_LIST_OUT_NAME (filter))
+    cache = bgp_policy_cache_get (peer, BGP_POLICY_FILTER_OUT, riattr,
+				  afi, safi, NULL, FILTER_LIST_OUT (filter));
+
+  if (bgp_output_filter (peer, p, riattr, afi, safi, cache) == FILTER_DENY)
     {
       if (BGP_DEBUG (filter, FILTER))
 	zlog (peer->log, LOG_DEBUG,
@@ -1073,9 +1156,20 @@ bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
       struct bgp_info info;
       struct attr dummy_attr;
       struct attr_extra dummy_extra;
+      struct route_map *map;
 
       dummy_attr.extra = &dummy_extra;
 
+      if (ri->extra && ri->extra->suppress)
+	map = UNSUPPRESS_MAP (filter);
+      else
+	map = ROUTE_MAP_OUT (filter);
+
+      /* The matches only ever see ATTR as it stands now, so consecutive
+	 prefixes exported with the same attributes share their results. */
+      cache = bgp_policy_cache_get (peer, BGP_POLICY_OUT, attr, afi, safi,
+				    map, NULL);
+
       info.peer = peer;
       info.attr = attr;
 
@@ -1090,10 +1184,7 @@ bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
 
       SET_FLAG (peer->rmap_type, PEER_RMAP_TYPE_OUT); 
 
-      if (ri->extra && ri->extra->suppress)
-	ret = route_map_apply (UNSUPPRESS_MAP (filter), p, RMAP_BGP, &info);
-      else
-	ret = route_map_apply (ROUTE_MAP_OUT (filter), p, RMAP_BGP, &info);
+      ret = route_map_apply_memo (map, p, RMAP_BGP, &info, &cache->memo);
 
       peer->rmap_type = 0;
 
@@ -1171,7 +1262,7 @@ bgp_announce_check_rsclient (struct bgp_info *ri, struct peer *rsclient,
       }
 
   /* Output filter check. */
-  if (bgp_output_filter (rsclient, p, riattr, afi, safi) == FILTER_DENY)
+  if (bgp_output_filter (rsclient, p, riattr, afi, safi, NULL) == FILTER_DENY)
     {
       if (BGP_DEBUG (filter, FILTER))
        zlog (rsclient->log, LOG_DEBUG,
@@ -2115,40 +2206,17 @@ bgp_withdraw_rsclient (struct peer *rsclient, afi_t afi, safi_t safi,
   bgp_unlock_node (rn);
 }
 
-static int
-bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
-	    afi_t afi, safi_t safi, int type, int sub_type,
-	    struct prefix_rd *prd, u_char *tag, int soft_reconfig)
+/* Run the checks and inbound policy deciding whether the route for p
+   with attr received from peer is accepted.  If so, returns NULL with
+   the attributes it is accepted with in new_attr, whose extra the caller
+   provides.  Else returns the reason it was filtered.  */
+static const char *
+bgp_input_policy (struct peer *peer, struct prefix *p, struct attr *attr,
+		  afi_t afi, safi_t safi, struct attr *new_attr)
 {
-  int ret;
   int aspath_loop_count = 0;
-  struct bgp_node *rn;
-  struct bgp *bgp;
-  struct attr new_attr;
-  struct attr_extra new_extra;
-  struct attr *attr_new;
-  struct bgp_info *ri;
-  struct bgp_info *new;
-  const char *reason;
-  char buf[SU_ADDRSTRLEN];
-  int connected = 0;
-
-  memset (&new_attr, 0, sizeof(struct attr));
-  memset (&new_extra, 0, sizeof(struct attr_extra));
-
-  bgp = peer->bgp;
-  rn = bgp_afi_node_get (bgp->rib[afi][safi], afi, safi, p, prd);
-  
-  /* When peer's soft reconfiguration enabled.  Record input packet in
-     Adj-RIBs-In.  */
-  if (! soft_reconfig && CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG)
-      && peer != bgp->peer_self)
-    bgp_adj_in_set (rn, peer, attr);
-
-  /* Check previously received route. */
-  for (ri = rn->info; ri; ri = ri->next)
-    if (ri->peer == peer && ri->type == type && ri->sub_type == sub_type)
-      break;
+  struct bgp_filter *filter;
+  struct bgp_policy_cache *cache;
 
   /* AS path local-as loop check. */
   if (peer->change_local_as)
@@ -2157,56 +2225,48 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	aspath_loop_count = 1;
 
       if (aspath_loop_check (attr->aspath, peer->change_local_as) > aspath_loop_count) 
-	{
-	  reason = "as-path contains our own AS;";
-	  goto filtered;
-	}
+	return "as-path contains our own AS;";
     }
 
   /* AS path loop check. */
-  if (aspath_loop_check (attr->aspath, bgp->as) > peer->allowas_in[afi][safi]
-      || (CHECK_FLAG(bgp->config, BGP_CONFIG_CONFEDERATION)
-	  && aspath_loop_check(attr->aspath, bgp->confed_id)
+  if (aspath_loop_check (attr->aspath, peer->bgp->as) > peer->allowas_in[afi][safi]
+      || (CHECK_FLAG(peer->bgp->config, BGP_CONFIG_CONFEDERATION)
+	  && aspath_loop_check(attr->aspath, peer->bgp->confed_id)
 	  > peer->allowas_in[afi][safi]))
-    {
-      reason = "as-path contains our own AS;";
-      goto filtered;
-    }
+    return "as-path contains our own AS;";
 
   /* Route reflector originator ID check.  */
   if (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID)
-      && IPV4_ADDR_SAME (&bgp->router_id, &attr->extra->originator_id))
-    {
-      reason = "originator is us;";
-      goto filtered;
-    }
+      && IPV4_ADDR_SAME (&peer->bgp->router_id, &attr->extra->originator_id))
+    return "originator is us;";
 
   /* Route reflector cluster ID check.  */
   if (bgp_cluster_filter (peer, attr))
-    {
-      reason = "reflected from the same cluster;";
-      goto  filtered;
-    }
+    return "reflected from the same cluster;";
+
+  /* Attribute-only policy results are shared by all prefixes arriving
+     with the same attributes. */
+  filter = &peer->filter[afi][safi];
+  cache = NULL;
+  if (FILTER_LIST_IN_NAME (filter) || ROUTE_MAP_IN_NAME (filter))
+    cache = bgp_policy_cache_get (peer, BGP_POLICY_IN, attr, afi, safi,
+				  ROUTE_MAP_IN (filter),
+				  FILTER_LIST_IN (filter));
 
   /* Apply incoming filter.  */
-  if (bgp_input_filter (peer, p, attr, afi, safi) == FILTER_DENY)
-    {
-      reason = "filter;";
-      goto filtered;
-    }
+  if (bgp_input_filter (peer, p, attr, afi, safi, cache) == FILTER_DENY)
+    return "filter;";
 
-  new_attr.extra = &new_extra;
-  bgp_attr_dup (&new_attr, attr);
+  bgp_attr_dup (new_attr, attr);
 
   /* Apply incoming route-map.
    * NB: new_attr may now contain newly allocated values from route-map "set"
-   * commands, so we need bgp_attr_flush in the error paths, until we intern
-   * the attr (which takes over the memory references) */
-  if (bgp_input_modifier (peer, p, &new_attr, afi, safi) == RMAP_DENY)
+   * commands, so we need bgp_attr_flush in the error paths, until the
+   * caller interns the attr (which takes over the memory references) */
+  if (bgp_input_modifier (peer, p, new_attr, afi, safi, cache) == RMAP_DENY)
     {
-      reason = "route-map;";
-      bgp_attr_flush (&new_attr);
-      goto filtered;
+      bgp_attr_flush (new_attr);
+      return "route-map;";
     }
 
   /* IPv4 unicast next hop check.  */
@@ -2214,23 +2274,85 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
     {
       /* Next hop must not be 0.0.0.0 nor Class D/E address. Next hop
 	 must not be my own address.  */
-      if (new_attr.nexthop.s_addr == 0
-	  || IPV4_CLASS_DE (ntohl (new_attr.nexthop.s_addr))
-	  || bgp_nexthop_self (&new_attr))
+      if (new_attr->nexthop.s_addr == 0
+	  || IPV4_CLASS_DE (ntohl (new_attr->nexthop.s_addr))
+	  || bgp_nexthop_self (new_attr))
 	{
-	  reason = "martian next-hop;";
-	  bgp_attr_flush (&new_attr);
-	  goto filtered;
+	  bgp_attr_flush (new_attr);
+	  return "martian next-hop;";
 	}
     }
 
+  return NULL;
+}
+
+/* Validate the origin of the route as received, RFC 6811. */
+static void
+bgp_update_rpki_state (struct bgp_info *ri, struct prefix *p,
+		       struct attr *attr, safi_t safi)
+{
+  if (safi == SAFI_UNICAST || safi == SAFI_MULTICAST)
+    ri->rpki_state = bgp_rpki_validate_route (p, attr, ri->peer->bgp);
+  else
+    ri->rpki_state = BGP_RPKI_NOT_BEING_USED;
+}
+
+static int
+bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
+	    afi_t afi, safi_t safi, int type, int sub_type,
+	    struct prefix_rd *prd, u_char *tag, int soft_reconfig)
+{
+  int ret;
+  struct bgp_node *rn;
+  struct bgp *bgp;
+  struct attr new_attr;
+  struct attr_extra new_extra;
+  struct attr *attr_new;
+  struct bgp_info *ri;
+  struct bgp_info *new;
+  const char *reason;
+  char buf[SU_ADDRSTRLEN];
+  int connected = 0;
+  int adj_in, adj_in_shared = 0;
+
+  memset (&new_attr, 0, sizeof(struct attr));
+  memset (&new_extra, 0, sizeof(struct attr_extra));
+
+  bgp = peer->bgp;
+  rn = bgp_afi_node_get (bgp->rib[afi][safi], afi, safi, p, prd);
+  
+  /* When peer's soft reconfiguration enabled, the input packet is
+     recorded in Adj-RIBs-In once we know what policy makes of it.  That
+     goes for soft reconfiguration too, as the new policy may change
+     whether the accepted attr can stand in for the received one.  */
+  adj_in = (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG)
+	    && peer != bgp->peer_self);
+
+  /* Check previously received route. */
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer && ri->type == type && ri->sub_type == sub_type)
+      break;
+
+  new_attr.extra = &new_extra;
+  if ((reason = bgp_input_policy (peer, p, attr, afi, safi, &new_attr)))
+    goto filtered;
+
   attr_new = bgp_attr_intern (&new_attr);
 
+  if (adj_in)
+    adj_in_shared = bgp_adj_in_set (rn, peer, attr, attr_new);
+
   /* If the update is implicit withdraw. */
   if (ri)
     {
       ri->uptime = bgp_clock ();
 
+      /* Either way ri->attr is attr_new from here on. */
+      if (adj_in_shared)
+	bgp_info_set_flag (rn, ri, BGP_INFO_ADJ_IN);
+      else
+	bgp_info_unset_flag (rn, ri, BGP_INFO_ADJ_IN);
+
       /* Same attribute comes in. */
       if (!CHECK_FLAG (ri->flags, BGP_INFO_REMOVED) 
           && attrhash_cmp (ri->attr, attr_new))
@@ -2318,6 +2440,7 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
       /* Update to new attribute.  */
       bgp_attr_unintern (&ri->attr);
       ri->attr = attr_new;
+      bgp_update_rpki_state (ri, p, attr, safi);
 
       /* Update MPLS tag.  */
       if (safi == SAFI_MPLS_VPN)
@@ -2385,6 +2508,9 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 
   /* Make new BGP info. */
   new = info_make(type, sub_type, peer, attr_new, rn);
+  if (adj_in_shared)
+    SET_FLAG (new->flags, BGP_INFO_ADJ_IN);
+  bgp_update_rpki_state (new, p, attr, safi);
 
   /* Update MPLS tag. */
   if (safi == SAFI_MPLS_VPN)
@@ -2446,8 +2572,14 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	  inet_ntop (p->family, &p->u.prefix, buf, SU_ADDRSTRLEN),
 	  p->prefixlen, reason);
 
+  if (adj_in)
+    bgp_adj_in_set (rn, peer, attr, NULL);
+
   if (ri)
-    bgp_rib_remove (rn, ri, peer, afi, safi);
+    {
+      bgp_info_unset_flag (rn, ri, BGP_INFO_ADJ_IN);
+      bgp_rib_remove (rn, ri, peer, afi, safi);
+    }
 
   bgp_unlock_node (rn);
   bgp_attr_flush (&new_attr);
@@ -2732,19 +2864,29 @@ bgp_soft_reconfig_table_rsclient (struct peer *rsclient, afi_t afi,
 {
   struct bgp_node *rn;
   struct bgp_adj_in *ain;
+  struct bgp_info *ri;
 
   if (! table)
     table = rsclient->bgp->rib[afi][safi];
 
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain; ain = ain->next)
-      {
-        struct bgp_info *ri = rn->info;
-        u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+    {
+      u_char *tag;
 
+      ri = rn->info;
+      tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+
+      for (ain = rn->adj_in; ain; ain = ain->next)
         bgp_update_rsclient (rsclient, afi, safi, ain->attr, ain->peer,
                 &rn->p, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, tag);
-      }
+
+      /* Routes policy accepted unchanged are their own Adj-RIB-In. */
+      for (ri = rn->info; ri; ri = ri->next)
+        if (CHECK_FLAG (ri->flags, BGP_INFO_ADJ_IN)
+            && ! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+          bgp_update_rsclient (rsclient, afi, safi, ri->attr, ri->peer,
+                  &rn->p, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, tag);
+    }
 }
 
 void
@@ -2770,37 +2912,190 @@ bgp_soft_reconfig_rsclient (struct peer *rsclient, afi_t afi, safi_t safi)
         }
 }
 
+/* What inbound policy made of one set of received attributes, kept for
+   the length of a soft reconfiguration when policy pays no heed to the
+   prefix.  accepted is NULL if the route was filtered. */
+struct bgp_policy_result
+{
+  struct attr *received;
+  struct attr *accepted;
+};
+
+static unsigned int
+bgp_policy_result_key (void *p)
+{
+  return ((struct bgp_policy_result *) p)->received->hash;
+}
+
+static int
+bgp_policy_result_cmp (const void *p1, const void *p2)
+{
+  return ((const struct bgp_policy_result *) p1)->received
+    == ((const struct bgp_policy_result *) p2)->received;
+}
+
+static void
+bgp_policy_result_free (void *p)
+{
+  struct bgp_policy_result *result = p;
+
+  if (result->accepted)
+    bgp_attr_unintern (&result->accepted);
+  XFREE (MTYPE_BGP_POLICY_RESULT, result);
+}
+
+/* Whether the outcome of peer's inbound policy may be shared between
+   prefixes received with the same attributes. */
+static int
+bgp_input_policy_prefix_free (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_filter *filter = &peer->filter[afi][safi];
+
+  if (DISTRIBUTE_IN_NAME (filter) || PREFIX_LIST_IN_NAME (filter))
+    return 0;
+  if (ROUTE_MAP_IN_NAME (filter)
+      && (! ROUTE_MAP_IN (filter)
+	  || ! route_map_object_only (ROUTE_MAP_IN (filter))))
+    return 0;
+  return 1;
+}
+
+/* Inbound policy run afresh over attr, received from peer for rn.
+   Returns the interned attributes the route would have, or NULL if it
+   would be filtered.  */
+static struct attr *
+bgp_input_policy_eval (struct peer *peer, struct bgp_node *rn,
+		       struct attr *attr, afi_t afi, safi_t safi,
+		       struct hash *results)
+{
+  struct bgp_policy_result key, *result;
+  struct attr new_attr;
+  struct attr_extra new_extra;
+  struct attr *accepted = NULL;
+
+  if (results)
+    {
+      key.received = attr;
+      if ((result = hash_lookup (results, &key)) != NULL)
+	return result->accepted ? bgp_attr_intern (result->accepted) : NULL;
+    }
+
+  memset (&new_attr, 0, sizeof (struct attr));
+  memset (&new_extra, 0, sizeof (struct attr_extra));
+  new_attr.extra = &new_extra;
+  if (! bgp_input_policy (peer, &rn->p, attr, afi, safi, &new_attr))
+    {
+      accepted = bgp_attr_intern (&new_attr);
+      bgp_attr_flush (&new_attr);
+    }
+
+  if (results)
+    {
+      result = XCALLOC (MTYPE_BGP_POLICY_RESULT,
+			sizeof (struct bgp_policy_result));
+      result->received = attr;
+      result->accepted = accepted ? bgp_attr_intern (accepted) : NULL;
+      hash_get (results, result, hash_alloc_intern);
+    }
+  return accepted;
+}
+
+/* Whether the route peer sent for rn with attr comes out of inbound
+   policy as it went in last time: filtered again, or accepted with the
+   very attributes the route has.  Then there is nothing to redo. */
+static int
+bgp_soft_reconfig_unchanged (struct peer *peer, struct bgp_node *rn,
+			     struct attr *attr, afi_t afi, safi_t safi,
+			     struct hash *results)
+{
+  struct bgp_info *ri;
+  struct attr *accepted;
+  int unchanged;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer && ri->type == ZEBRA_ROUTE_BGP
+	&& ri->sub_type == BGP_ROUTE_NORMAL)
+      break;
+
+  /* Dampening history and stale routes are bgp_update's business. */
+  if (ri && CHECK_FLAG (ri->flags, BGP_INFO_HISTORY | BGP_INFO_STALE))
+    return 0;
+  if (ri && CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+    ri = NULL;
+
+  accepted = bgp_input_policy_eval (peer, rn, attr, afi, safi, results);
+  if (! accepted)
+    return ri == NULL;
+
+  unchanged = (ri && ri->attr == accepted
+	       && (CHECK_FLAG (ri->flags, BGP_INFO_ADJ_IN) != 0)
+		  == (accepted == attr));
+  bgp_attr_unintern (&accepted);
+  return unchanged;
+}
+
 static void
 bgp_soft_reconfig_table (struct peer *peer, afi_t afi, safi_t safi,
 			 struct bgp_table *table, struct prefix_rd *prd)
 {
   int ret;
   struct bgp_node *rn;
-  struct bgp_adj_in *ain;
+  struct attr *attr;
+  struct hash *results = NULL;
+  int fast;
+  unsigned long examined = 0, changed = 0;
 
   if (! table)
     table = peer->bgp->rib[afi][safi];
 
+  /* Only routes policy now treats differently need to go through
+     bgp_update again, and so be reprocessed and readvertised.  RS-clients
+     see every update though, so give them the lot. */
+  fast = ! listcount (peer->bgp->rsclient);
+  if (fast && bgp_input_policy_prefix_free (peer, afi, safi))
+    results = hash_create (bgp_policy_result_key, bgp_policy_result_cmp);
+
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain; ain = ain->next)
+    if ((attr = bgp_adj_in_lookup (rn, peer)) != NULL)
       {
-	if (ain->peer == peer)
-	  {
-	    struct bgp_info *ri = rn->info;
-	    u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+	struct bgp_info *ri = rn->info;
+	u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
 
-	    ret = bgp_update (peer, &rn->p, ain->attr, afi, safi,
-			      ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
-			      prd, tag, 1);
+	/* The update may move attr between the Adj-RIB-In and the
+	   route, hold on to it meanwhile. */
+	attr = bgp_attr_intern (attr);
+	examined++;
 
-	    if (ret < 0)
-	      {
-		bgp_unlock_node (rn);
-		return;
-	      }
+	if (fast && bgp_soft_reconfig_unchanged (peer, rn, attr, afi, safi,
+						 results))
+	  {
+	    bgp_attr_unintern (&attr);
 	    continue;
 	  }
+
+	changed++;
+	ret = bgp_update (peer, &rn->p, attr, afi, safi,
+			  ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
+			  prd, tag, 1);
+	bgp_attr_unintern (&attr);
+
+	if (ret < 0)
+	  {
+	    bgp_unlock_node (rn);
+	    break;
+	  }
       }
+
+  if (results)
+    {
+      hash_clean (results, bgp_policy_result_free);
+      hash_free (results);
+    }
+
+  if (BGP_DEBUG (update, UPDATE_IN))
+    zlog (peer->log, LOG_DEBUG,
+	  "%s soft reconfiguration in for %s: %lu routes, %lu changed",
+	  peer->host, afi_safi_print (afi, safi), examined, changed);
 }
 
 void
@@ -2828,6 +3123,26 @@ bgp_soft_reconfig_in (struct peer *peer, afi_t afi, safi_t safi)
         }
 }
 
+/* Inbound policy run again over what peer sent for rn alone, when
+   something the policy looks at other than the policy itself changed. */
+void
+bgp_soft_reconfig_node (struct peer *peer, struct bgp_node *rn,
+			afi_t afi, safi_t safi)
+{
+  struct attr *attr;
+
+  if (peer->status != Established
+      || (attr = bgp_adj_in_lookup (rn, peer)) == NULL)
+    return;
+
+  attr = bgp_attr_intern (attr);
+  if (listcount (peer->bgp->rsclient)
+      || ! bgp_soft_reconfig_unchanged (peer, rn, attr, afi, safi, NULL))
+    bgp_update (peer, &rn->p, attr, afi, safi, ZEBRA_ROUTE_BGP,
+		BGP_ROUTE_NORMAL, NULL, NULL, 1);
+  bgp_attr_unintern (&attr);
+}
+
 
 struct bgp_clear_node_queue
 {
@@ -3130,18 +3445,11 @@ bgp_clear_adj_in (struct peer *peer, afi_t afi, safi_t safi)
 {
   struct bgp_table *table;
   struct bgp_node *rn;
-  struct bgp_adj_in *ain;
 
   table = peer->bgp->rib[afi][safi];
 
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain ; ain = ain->next)
-      if (ain->peer == peer)
-	{
-          bgp_adj_in_remove (rn, ain);
-          bgp_unlock_node (rn);
-          break;
-	}
+    bgp_adj_in_unset (rn, peer);
 }
 
 void
@@ -3149,6 +3457,7 @@ bgp_clear_stale_route (struct peer *peer, afi_t afi, safi_t safi)
 {
   struct bgp_node *rn;
   struct bgp_info *ri;
+  struct bgp_adj_in *adj;
   struct bgp_table *table;
 
   table = peer->bgp->rib[afi][safi];
@@ -3159,7 +3468,52 @@ bgp_clear_stale_route (struct peer *peer, afi_t afi, safi_t safi)
 	if (ri->peer == peer)
 	  {
 	    if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
-	      bgp_rib_remove (rn, ri, peer, afi, safi);
+	      {
+		bgp_adj_in_unset (rn, peer);
+		bgp_rib_remove (rn, ri, peer, afi, safi);
+	      }
+	    break;
+	  }
+
+      /* Routes policy filtered are only in the Adj-RIB-In, they must
+	 not come back with the next soft reconfiguration. */
+      for (adj = rn->adj_in; adj; adj = adj->next)
+	if (adj->peer == peer)
+	  {
+	    if (adj->stale)
+	      bgp_adj_in_unset (rn, peer);
+	    break;
+	  }
+    }
+}
+
+/* Mark all of peer's routes stale, for those the peer does not send
+   again before it says it is done to be swept by bgp_clear_stale_route
+   (RFC 7313). */
+void
+bgp_set_stale_route (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  struct bgp_adj_in *adj;
+  struct bgp_table *table;
+
+  table = peer->bgp->rib[afi][safi];
+
+  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+    {
+      for (ri = rn->info; ri; ri = ri->next)
+	if (ri->peer == peer)
+	  {
+	    if (! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED | BGP_INFO_HISTORY))
+	      bgp_info_set_flag (rn, ri, BGP_INFO_STALE);
+	    break;
+	  }
+
+      for (adj = rn->adj_in; adj; adj = adj->next)
+	if (adj->peer == peer)
+	  {
+	    adj->stale = 1;
 	    break;
 	  }
     }
@@ -6044,7 +6398,7 @@ route_vty_out(
       else
 	  vty_out (vty, "       ");
 
-      vty_out (vty, "%7u ", (attr->extra ? attr->extra->weight : 0));
+      vty_out (vty, "%7u ", attr->weight);
     
       /* Print aspath */
       if (attr->aspath)
@@ -6107,7 +6461,7 @@ route_vty_out_tmp (struct vty *vty, struct prefix *p,
       else
 	vty_out (vty, "       ");
       
-      vty_out (vty, "%7u ", (attr->extra ? attr->extra->weight : 0));
+      vty_out (vty, "%7u ", attr->weight);
       
       /* Print aspath */
       if (attr->aspath)
@@ -6382,8 +6736,8 @@ route_vty_out_detail (struct vty *vty, struct bgp *bgp, struct prefix *p,
       else
 	vty_out (vty, ", localpref %u", bgp->default_local_pref);
 
-      if (attr->extra && attr->extra->weight != 0)
-	vty_out (vty, ", weight %u", attr->extra->weight);
+      if (attr->weight != 0)
+	vty_out (vty, ", weight %u", attr->weight);
 
       if (attr->extra && attr->extra->tag != 0)
         vty_out (vty, ", tag %d", attr->extra->tag);
@@ -6459,6 +6813,10 @@ route_vty_out_detail (struct vty *vty, struct bgp *bgp, struct prefix *p,
       if (binfo->extra && binfo->extra->damp_info)
 	bgp_damp_info_vty (vty, binfo);
 
+      if (binfo->rpki_state != BGP_RPKI_NOT_BEING_USED)
+	vty_out (vty, "      RPKI validation state: %s%s",
+		 bgp_rpki_state_str (binfo->rpki_state), VTY_NEWLINE);
+
       /* Line 8 display Uptime */
 #ifdef HAVE_CLOCK_MONOTONIC
       tbuf = time(NULL) - (bgp_clock() - binfo->uptime);
@@ -6510,30 +6868,56 @@ enum bgp_show_type
   bgp_show_type_damp_neighbor
 };
 
+/* Where a table walk for "show ip bgp" got to.  The walk is paused
+   whenever the vty has plenty of output queued and picks up from the
+   next prefix once that has been written. */
+struct bgp_show_state
+{
+  bgp_table_iter_t iter;
+  struct in_addr router_id;
+  enum bgp_show_type type;
+  void *output_arg;
+  void (*output_free) (void *);
+  union sockunion su;
+
+  /* Only walks whose argument stays valid may be paused. */
+  int stream;
+
+  int header;
+  unsigned long output_count;
+  unsigned long total_count;
+};
+
+static void
+bgp_show_state_free (void *arg)
+{
+  struct bgp_show_state *state = arg;
+
+  bgp_table_iter_cleanup (&state->iter);
+  if (state->output_free)
+    (*state->output_free) (state->output_arg);
+  XFREE (MTYPE_BGP_SHOW_STATE, state);
+}
+
 static int
-bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router_id,
-	  enum bgp_show_type type, void *output_arg)
+bgp_show_table_walk (struct vty *vty, void *arg)
 {
+  struct bgp_show_state *state = arg;
+  enum bgp_show_type type = state->type;
+  void *output_arg = state->output_arg;
   struct bgp_info *ri;
   struct bgp_node *rn;
-  int header = 1;
   int display;
-  unsigned long output_count;
-  unsigned long total_count;
-
-  /* This is first entry point, so reset total line. */
-  output_count = 0;
-  total_count  = 0;
 
   /* Start processing of routes. */
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn)) 
+  while ((rn = bgp_table_iter_next (&state->iter)))
     if (rn->info != NULL)
       {
 	display = 0;
 
 	for (ri = rn->info; ri; ri = ri->next)
 	  {
-            total_count++;
+            state->total_count++;
 	    if (type == bgp_show_type_flap_statistics
 		|| type == bgp_show_type_flap_address
 		|| type == bgp_show_type_flap_prefix
@@ -6553,9 +6937,9 @@ bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router
 	    if (type == bgp_show_type_regexp
 		|| type == bgp_show_type_flap_regexp)
 	      {
-		regex_t *regex = output_arg;
+		struct bgp_aspath_regex *regex = output_arg;
 		    
-		if (bgp_regexec (regex, ri->attr->aspath) == REG_NOMATCH)
+		if (bgp_aspath_regexec (regex, ri->attr->aspath) == REG_NOMATCH)
 		  continue;
 	      }
 	    if (type == bgp_show_type_prefix_list
@@ -6704,9 +7088,9 @@ bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router
 		  continue;
 	      }
 
-	    if (header)
+	    if (state->header)
 	      {
-		vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (*router_id), VTY_NEWLINE);
+		vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (state->router_id), VTY_NEWLINE);
 		vty_out (vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
 		vty_out (vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
 		if (type == bgp_show_type_dampend_paths
@@ -6725,7 +7109,7 @@ bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router
 		  vty_out (vty, BGP_SHOW_FLAP_HEADER, VTY_NEWLINE);
 		else
 		  vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
-		header = 0;
+		state->header = 0;
 	      }
 
 	    if (type == bgp_show_type_dampend_paths
@@ -6747,25 +7131,78 @@ bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router
 	    display++;
 	  }
 	if (display)
-	  output_count++;
+	  state->output_count++;
+
+	if (state->stream && vty_output_full (vty))
+	  {
+	    bgp_table_iter_pause (&state->iter);
+	    return 1;
+	  }
       }
 
   /* No route is displayed */
-  if (output_count == 0)
+  if (state->output_count == 0)
     {
       if (type == bgp_show_type_normal)
-        vty_out (vty, "No BGP prefixes displayed, %ld exist%s", total_count, VTY_NEWLINE);
+        vty_out (vty, "No BGP prefixes displayed, %ld exist%s",
+		 state->total_count, VTY_NEWLINE);
     }
   else
     vty_out (vty, "%sDisplayed  %ld out of %ld total prefixes%s",
-	     VTY_NEWLINE, output_count, total_count, VTY_NEWLINE);
+	     VTY_NEWLINE, state->output_count, state->total_count,
+	     VTY_NEWLINE);
+
+  return 0;
+}
+
+/* Show TABLE, handing OUTPUT_ARG to OUTPUT_FREE once done with it.
+   Large tables are written out a piece at a time as the vty drains,
+   for which the argument has to be owned by the walk or copied. */
+static int
+bgp_show_table_owned (struct vty *vty, struct bgp_table *table,
+		      struct in_addr *router_id, enum bgp_show_type type,
+		      void *output_arg, void (*output_free) (void *))
+{
+  struct bgp_show_state *state;
+
+  state = XCALLOC (MTYPE_BGP_SHOW_STATE, sizeof (struct bgp_show_state));
+  bgp_table_iter_init (&state->iter, table);
+  state->router_id = *router_id;
+  state->type = type;
+  state->output_arg = output_arg;
+  state->output_free = output_free;
+  state->header = 1;
+
+  if (type == bgp_show_type_neighbor
+      || type == bgp_show_type_flap_neighbor
+      || type == bgp_show_type_damp_neighbor)
+    {
+      state->su = *(union sockunion *) output_arg;
+      state->output_arg = &state->su;
+      state->stream = 1;
+    }
+  else
+    state->stream = (output_arg == NULL || output_free != NULL);
+
+  if (bgp_show_table_walk (vty, state))
+    vty_output_defer (vty, bgp_show_table_walk, state, bgp_show_state_free);
+  else
+    bgp_show_state_free (state);
 
   return CMD_SUCCESS;
 }
 
 static int
-bgp_show (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi,
-         enum bgp_show_type type, void *output_arg)
+bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router_id,
+	  enum bgp_show_type type, void *output_arg)
+{
+  return bgp_show_table_owned (vty, table, router_id, type, output_arg, NULL);
+}
+
+static int
+bgp_show_owned (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi,
+		enum bgp_show_type type, void *output_arg,
+		void (*output_free) (void *))
 {
   struct bgp_table *table;
 
@@ -6776,13 +7213,23 @@ bgp_show (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi,
   if (bgp == NULL)
     {
       vty_out (vty, "No BGP process is configured%s", VTY_NEWLINE);
+      if (output_free)
+	(*output_free) (output_arg);
       return CMD_WARNING;
     }
 
 
   table = bgp->rib[afi][safi];
 
-  return bgp_show_table (vty, table, &bgp->router_id, type, output_arg);
+  return bgp_show_table_owned (vty, table, &bgp->router_id, type,
+			       output_arg, output_free);
+}
+
+static int
+bgp_show (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi,
+         enum bgp_show_type type, void *output_arg)
+{
+  return bgp_show_owned (vty, bgp, afi, safi, type, output_arg, NULL);
 }
 
 /* Header of detailed BGP route information */
@@ -8113,6 +8560,12 @@ DEFUN (show_bgp_view_ipv6_prefix,
   return bgp_show_route (vty, argv[0], argv[1], AFI_IP6, SAFI_UNICAST, NULL, 1, BGP_PATH_ALL);
 }
 
+static void
+bgp_show_regex_free (void *arg)
+{
+  bgp_aspath_regex_free (arg);
+}
+
 static int
 bgp_show_regexp (struct vty *vty, int argc, const char **argv, afi_t afi,
 		 safi_t safi, enum bgp_show_type type)
@@ -8121,8 +8574,7 @@ bgp_show_regexp (struct vty *vty, int argc, const char **argv, afi_t afi,
   struct buffer *b;
   char *regstr;
   int first;
-  regex_t *regex;
-  int rc;
+  struct bgp_aspath_regex *regex;
   
   first = 0;
   b = buffer_new (1024);
@@ -8144,7 +8596,7 @@ bgp_show_regexp (struct vty *vty, int argc, const char **argv, afi_t afi,
   regstr = buffer_getstr (b);
   buffer_free (b);
 
-  regex = bgp_regcomp (regstr);
+  regex = bgp_aspath_regcomp (regstr);
   XFREE(MTYPE_TMP, regstr);
   if (! regex)
     {
@@ -8153,9 +8605,8 @@ bgp_show_regexp (struct vty *vty, int argc, const char **argv, afi_t afi,
       return CMD_WARNING;
     }
 
-  rc = bgp_show (vty, NULL, afi, safi, type, regex);
-  bgp_regex_free (regex);
-  return rc;
+  return bgp_show_owned (vty, NULL, afi, safi, type, regex,
+			 bgp_show_regex_free);
 }
 
 
@@ -12301,6 +12752,12 @@ DEFUN (show_bgp_ipv6_safi_lcommunity_list,
   return bgp_show_lcommunity_list (vty, argv[1], AFI_IP6, safi);
 }
 
+static void
+bgp_show_prefix_free (void *arg)
+{
+  prefix_free (arg);
+}
+
 static int
 bgp_show_prefix_longer (struct vty *vty, const char *prefix, afi_t afi,
 			safi_t safi, enum bgp_show_type type)
@@ -12317,9 +12774,7 @@ bgp_show_prefix_longer (struct vty *vty, const char *prefix, afi_t afi,
       return CMD_WARNING;
     }
 
-  ret = bgp_show (vty, NULL, afi, safi, type, p);
-  prefix_free(p);
-  return ret;
+  return bgp_show_owned (vty, NULL, afi, safi, type, p, bgp_show_prefix_free);
 }
 
 DEFUN (show_ip_bgp_prefix_longer,
@@ -13214,12 +13669,10 @@ bgp_peer_count_walker (struct thread *t)
   
   for (rn = bgp_table_top (pc->table); rn; rn = bgp_route_next (rn))
     {
-      struct bgp_adj_in *ain;
       struct bgp_info *ri;
       
-      for (ain = rn->adj_in; ain; ain = ain->next)
-        if (ain->peer == peer)
-          pc->count[PCOUNT_ADJ_IN]++;
+      if (bgp_adj_in_lookup (rn, peer))
+        pc->count[PCOUNT_ADJ_IN]++;
 
       for (ri = rn->info; ri; ri = ri->next)
         {
@@ -13493,7 +13946,7 @@ show_adj_route (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
 		int in)
 {
   struct bgp_table *table;
-  struct bgp_adj_in *ain;
+  struct attr *attr;
   struct bgp_adj_out *adj;
   unsigned long output_count;
   struct bgp_node *rn;
@@ -13525,27 +13978,23 @@ show_adj_route (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
     if (in)
       {
-	for (ain = rn->adj_in; ain; ain = ain->next)
-	  if (ain->peer == peer)
-	    {
-	      if (header1)
-		{
-		  vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (bgp->router_id), VTY_NEWLINE);
-		  vty_out (vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-		  vty_out (vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-		  header1 = 0;
-		}
-	      if (header2)
-		{
-		  vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
-		  header2 = 0;
-		}
-	      if (ain->attr)
-		{ 
-		  route_vty_out_tmp (vty, &rn->p, ain->attr, safi);
-		  output_count++;
-		}
-	    }
+	if ((attr = bgp_adj_in_lookup (rn, peer)) != NULL)
+	  {
+	    if (header1)
+	      {
+		vty_out (vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa (bgp->router_id), VTY_NEWLINE);
+		vty_out (vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+		vty_out (vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+		header1 = 0;
+	      }
+	    if (header2)
+	      {
+		vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
+		header2 = 0;
+	      }
+	    route_vty_out_tmp (vty, &rn->p, attr, safi);
+	    output_count++;
+	  }
       }
     else
       {
@@ -22,6 +22,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define _QUAGGA_BGP_ROUTE_H
 
 #include "queue.h"
+#include "routemap.h"
 #include "bgp_table.h"
 
 struct bgp_nexthop_cache;
@@ -94,6 +95,7 @@ struct bgp_info
 #define BGP_INFO_COUNTED	(1 << 10)
 #define BGP_INFO_MULTIPATH      (1 << 11)
 #define BGP_INFO_MULTIPATH_CHG  (1 << 12)
+#define BGP_INFO_ADJ_IN         (1 << 13) /* attr is also the Adj-RIB-In copy */
 
   /* BGP route type.  This can be static, RIP, OSPF, BGP etc.  */
   u_char type;
@@ -105,6 +107,9 @@ struct bgp_info
 #define BGP_ROUTE_STATIC       1
 #define BGP_ROUTE_AGGREGATE    2
 #define BGP_ROUTE_REDISTRIBUTE 3 
+
+  /* Origin validation state, BGP_RPKI_*, of what the peer sent. */
+  u_char rpki_state;
 };
 
 /* BGP static route configuration. */
@@ -182,6 +187,26 @@ struct bgp_static
 #define UNSUPPRESS_MAP_NAME(F)  ((F)->usmap.name)
 #define UNSUPPRESS_MAP(F)       ((F)->usmap.map)
 
+/* Results of the attribute-only parts of a peer's policy for the last
+   attribute it applied to, see bgp_policy_cache_get. */
+struct bgp_policy_cache
+{
+  /* Key. */
+  struct attr *attr;
+  u_int32_t generation;
+  afi_t afi;
+  safi_t safi;
+  struct route_map *map;
+  struct as_list *aslist;
+  u_int32_t weight;
+
+  /* Filter-list result, -1 until evaluated. */
+  int aslist_result;
+
+  /* Route-map object-only match results. */
+  struct route_map_memo memo;
+};
+
 enum bgp_clear_route_type
 {
   BGP_CLEAR_ROUTE_NORMAL,
@@ -203,6 +228,8 @@ extern void bgp_announce_route (struct peer *, afi_t, safi_t);
 extern void bgp_announce_route_all (struct peer *);
 extern void bgp_default_originate (struct peer *, afi_t, safi_t, int);
 extern void bgp_soft_reconfig_in (struct peer *, afi_t, safi_t);
+extern void bgp_soft_reconfig_node (struct peer *, struct bgp_node *,
+				    afi_t, safi_t);
 extern void bgp_soft_reconfig_rsclient (struct peer *, afi_t, safi_t);
 extern void bgp_check_local_routes_rsclient (struct peer *rsclient, afi_t afi, safi_t safi);
 extern void bgp_clear_route (struct peer *, afi_t, safi_t,
@@ -210,6 +237,7 @@ extern void bgp_clear_route (struct peer *, afi_t, safi_t,
 extern void bgp_clear_route_all (struct peer *);
 extern void bgp_clear_adj_in (struct peer *, afi_t, safi_t);
 extern void bgp_clear_stale_route (struct peer *, afi_t, safi_t);
+extern void bgp_set_stale_route (struct peer *, afi_t, safi_t);
 
 extern struct bgp_info *bgp_info_lock (struct bgp_info *);
 extern struct bgp_info *bgp_info_unlock (struct bgp_info *);
@@ -270,4 +298,7 @@ extern void route_vty_out_tmp (struct vty *, struct prefix *, struct attr *, saf
 extern void bgp_peer_clear_node_queue_drain_immediate (struct peer *peer);
 extern void bgp_process_queues_drain_immediate (void);
 
+extern void bgp_policy_changed (void);
+extern void bgp_policy_cache_flush (struct peer *);
+
 #endif /* _QUAGGA_BGP_ROUTE_H */
@@ -53,6 +53,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_ecommunity.h"
 #include "bgpd/bgp_lcommunity.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_rpki.h"
 
 /* Memo of route-map commands.
 
@@ -318,7 +319,8 @@ struct route_map_rule_cmd route_match_peer_cmd =
   "peer",
   route_match_peer,
   route_match_peer_compile,
-  route_match_peer_free
+  route_match_peer_free,
+  RMAP_RULE_OBJECT
 };
 
 /* `match ip address IP_ACCESS_LIST' */
@@ -417,7 +419,8 @@ struct route_map_rule_cmd route_match_ip_next_hop_cmd =
   "ip next-hop",
   route_match_ip_next_hop,
   route_match_ip_next_hop_compile,
-  route_match_ip_next_hop_free
+  route_match_ip_next_hop_free,
+  RMAP_RULE_OBJECT
 };
 
 /* `match ip route-source ACCESS-LIST' */
@@ -475,7 +478,8 @@ struct route_map_rule_cmd route_match_ip_route_source_cmd =
   "ip route-source",
   route_match_ip_route_source,
   route_match_ip_route_source_compile,
-  route_match_ip_route_source_free
+  route_match_ip_route_source_free,
+  RMAP_RULE_OBJECT
 };
 
 /* `match ip address prefix-list PREFIX_LIST' */
@@ -562,7 +566,8 @@ struct route_map_rule_cmd route_match_ip_next_hop_prefix_list_cmd =
   "ip next-hop prefix-list",
   route_match_ip_next_hop_prefix_list,
   route_match_ip_next_hop_prefix_list_compile,
-  route_match_ip_next_hop_prefix_list_free
+  route_match_ip_next_hop_prefix_list_free,
+  RMAP_RULE_OBJECT
 };
 
 /* `match ip route-source prefix-list PREFIX_LIST' */
@@ -615,7 +620,8 @@ struct route_map_rule_cmd route_match_ip_route_source_prefix_list_cmd =
   "ip route-source prefix-list",
   route_match_ip_route_source_prefix_list,
   route_match_ip_route_source_prefix_list_compile,
-  route_match_ip_route_source_prefix_list_free
+  route_match_ip_route_source_prefix_list_free,
+  RMAP_RULE_OBJECT
 };
 
 /* `match local-preference LOCAL-PREF' */
@@ -681,7 +687,8 @@ struct route_map_rule_cmd route_match_local_pref_cmd =
   "local-preference",
   route_match_local_pref,
   route_match_local_pref_compile,
-  route_match_local_pref_free
+  route_match_local_pref_free,
+  RMAP_RULE_OBJECT
 };
 
 /* `match metric METRIC' */
@@ -710,6 +717,7 @@ struct route_map_rule_cmd route_match_metric_cmd =
   route_match_metric,
   route_value_compile,
   route_value_free,
+  RMAP_RULE_OBJECT
 };
 
 /* `match as-path ASPATH' */
@@ -757,7 +765,8 @@ struct route_map_rule_cmd route_match_aspath_cmd =
   "as-path",
   route_match_aspath,
   route_match_aspath_compile,
-  route_match_aspath_free
+  route_match_aspath_free,
+  RMAP_RULE_OBJECT
 };
 
 /* `match community COMMUNIY' */
@@ -841,7 +850,8 @@ struct route_map_rule_cmd route_match_community_cmd =
   "community",
   route_match_community,
   route_match_community_compile,
-  route_match_community_free
+  route_match_community_free,
+  RMAP_RULE_OBJECT
 };
 
 /* Match function for lcommunity match. */
@@ -912,7 +922,8 @@ struct route_map_rule_cmd route_match_lcommunity_cmd =
   "large-community",
   route_match_lcommunity,
   route_match_lcommunity_compile,
-  route_match_lcommunity_free
+  route_match_lcommunity_free,
+  RMAP_RULE_OBJECT
 };
 
 
@@ -962,7 +973,8 @@ struct route_map_rule_cmd route_match_ecommunity_cmd =
   "extcommunity",
   route_match_ecommunity,
   route_match_ecommunity_compile,
-  route_match_ecommunity_free
+  route_match_ecommunity_free,
+  RMAP_RULE_OBJECT
 };
 
 /* `match nlri` and `set nlri` are replaced by `address-family ipv4`
@@ -1018,7 +1030,65 @@ struct route_map_rule_cmd route_match_origin_cmd =
   "origin",
   route_match_origin,
   route_match_origin_compile,
-  route_match_origin_free
+  route_match_origin_free,
+  RMAP_RULE_OBJECT
+};
+
+/* `match rpki' */
+
+/* The validation state depends on the prefix as well as the path, and on
+   the ROAs loaded, so the result is not one for the object alone. */
+static route_map_result_t
+route_match_rpki (void *rule, struct prefix *prefix,
+		  route_map_object_t type, void *object)
+{
+  u_char *state;
+  struct bgp_info *bgp_info;
+
+  if (type == RMAP_BGP)
+    {
+      state = rule;
+      bgp_info = object;
+
+      if (bgp_rpki_validate_route (prefix, bgp_info->attr,
+				   bgp_info->peer->bgp) == *state)
+	return RMAP_MATCH;
+    }
+
+  return RMAP_NOMATCH;
+}
+
+static void *
+route_match_rpki_compile (const char *arg)
+{
+  u_char *state;
+
+  state = XMALLOC (MTYPE_ROUTE_MAP_COMPILED, sizeof (u_char));
+
+  if (strcmp (arg, "valid") == 0)
+    *state = BGP_RPKI_VALID;
+  else if (strcmp (arg, "invalid") == 0)
+    *state = BGP_RPKI_INVALID;
+  else
+    *state = BGP_RPKI_NOTFOUND;
+
+  return state;
+}
+
+static void
+route_match_rpki_free (void *rule)
+{
+  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
+}
+
+/* Route map commands for origin validation state matching. */
+struct route_map_rule_cmd route_match_rpki_cmd =
+{
+  "rpki",
+  route_match_rpki,
+  route_match_rpki_compile,
+  route_match_rpki_free,
+  0
 };
 
 /* match probability  { */
@@ -1109,6 +1179,7 @@ static struct route_map_rule_cmd route_match_tag_cmd =
   route_match_tag,
   route_map_rule_tag_compile,
   route_map_rule_tag_free,
+  RMAP_RULE_OBJECT
 };
 
 
@@ -1270,10 +1341,7 @@ route_set_weight (void *rule, struct prefix *prefix, route_map_object_t type,
     
       /* Set weight value. */ 
       weight = route_value_adjust(rv, 0, bgp_info->peer);
-      if (weight)
-        (bgp_attr_extra_get (bgp_info->attr))->weight = weight;
-      else if (bgp_info->attr->extra)
-        bgp_info->attr->extra->weight = 0;
+      bgp_info->attr->weight = weight;
     }
 
   return RMAP_OKAY;
@@ -2236,7 +2304,8 @@ struct route_map_rule_cmd route_match_ipv6_next_hop_cmd =
   "ipv6 next-hop",
   route_match_ipv6_next_hop,
   route_match_ipv6_next_hop_compile,
-  route_match_ipv6_next_hop_free
+  route_match_ipv6_next_hop_free,
+  RMAP_RULE_OBJECT
 };
 
 /* `match ipv6 address prefix-list PREFIX_LIST' */
@@ -2716,6 +2785,8 @@ bgp_route_map_update (const char *unused)
   if (bm->bgp == NULL)          /* may be called during cleanup */
     return;
 
+  bgp_policy_changed ();
+
   /* For neighbor route-map updates. */
   for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
     {
@@ -3377,6 +3448,45 @@ ALIAS (no_match_origin,
        "local IGP\n"
        "unknown heritage\n")
 
+DEFUN (match_rpki,
+       match_rpki_cmd,
+       "match rpki (valid|invalid|notfound)",
+       MATCH_STR
+       "RPKI origin validation state\n"
+       "Origin validated by a ROA\n"
+       "Prefix covered by a ROA, but not for the origin AS or length\n"
+       "No ROA covers the prefix\n")
+{
+  if (strncmp (argv[0], "valid", 1) == 0)
+    return bgp_route_match_add (vty, vty->index, "rpki", "valid");
+  if (strncmp (argv[0], "invalid", 1) == 0)
+    return bgp_route_match_add (vty, vty->index, "rpki", "invalid");
+  if (strncmp (argv[0], "notfound", 1) == 0)
+    return bgp_route_match_add (vty, vty->index, "rpki", "notfound");
+
+  return CMD_WARNING;
+}
+
+DEFUN (no_match_rpki,
+       no_match_rpki_cmd,
+       "no match rpki",
+       NO_STR
+       MATCH_STR
+       "RPKI origin validation state\n")
+{
+  return bgp_route_match_delete (vty, vty->index, "rpki", NULL);
+}
+
+ALIAS (no_match_rpki,
+       no_match_rpki_val_cmd,
+       "no match rpki (valid|invalid|notfound)",
+       NO_STR
+       MATCH_STR
+       "RPKI origin validation state\n"
+       "Origin validated by a ROA\n"
+       "Prefix covered by a ROA, but not for the origin AS or length\n"
+       "No ROA covers the prefix\n")
+
 DEFUN (match_tag,
        match_tag_cmd,
        "match tag <1-4294967295>",
@@ -4495,6 +4605,14 @@ ALIAS (no_match_pathlimit_as,
        "Match Pathlimit ASN\n")
 
 
+/* Edits to existing route-maps are only picked up by soft
+   reconfiguration, but the cached match results must go at once. */
+static void
+bgp_route_map_event (route_map_event_t event, const char *name)
+{
+  bgp_policy_changed ();
+}
+
 /* Initialization of route map. */
 void
 bgp_route_map_init (void)
@@ -4503,6 +4621,7 @@ bgp_route_map_init (void)
   route_map_init_vty ();
   route_map_add_hook (bgp_route_map_update);
   route_map_delete_hook (bgp_route_map_update);
+  route_map_event_hook (bgp_route_map_event);
 
   route_map_install_match (&route_match_peer_cmd);
   route_map_install_match (&route_match_local_pref_cmd);
@@ -4519,6 +4638,7 @@ bgp_route_map_init (void)
   route_map_install_match (&route_match_local_pref_cmd);
   route_map_install_match (&route_match_metric_cmd);
   route_map_install_match (&route_match_origin_cmd);
+  route_map_install_match (&route_match_rpki_cmd);
   route_map_install_match (&route_match_probability_cmd);
   route_map_install_match (&route_match_tag_cmd);
 
@@ -4587,6 +4707,9 @@ bgp_route_map_init (void)
   install_element (RMAP_NODE, &match_origin_cmd);
   install_element (RMAP_NODE, &no_match_origin_cmd);
   install_element (RMAP_NODE, &no_match_origin_val_cmd);
+  install_element (RMAP_NODE, &match_rpki_cmd);
+  install_element (RMAP_NODE, &no_match_rpki_cmd);
+  install_element (RMAP_NODE, &no_match_rpki_val_cmd);
   install_element (RMAP_NODE, &match_probability_cmd);
   install_element (RMAP_NODE, &no_match_probability_cmd);
   install_element (RMAP_NODE, &no_match_probability_val_cmd);
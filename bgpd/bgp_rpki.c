@@ -0,0 +1,1224 @@
+/* BGP prefix origin validation (RPKI), RFC 6811 and RFC 8210
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+MA 02111-1307, USA.  */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "prefix.h"
+#include "table.h"
+#include "memory.h"
+#include "log.h"
+#include "stream.h"
+#include "thread.h"
+#include "sockunion.h"
+#include "network.h"
+#include "linklist.h"
+#include "routemap.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_rpki.h"
+
+/* One ROA, or rather one (prefix, max length, origin AS) triple of it. */
+struct bgp_roa
+{
+  as_t asn;
+  u_char maxlen;
+
+  /* Not announced again since the cache reset, see bgp_rpki_roa_sweep. */
+  u_char stale;
+};
+
+/* The ROAs for one prefix, the info of its node in the index. */
+struct bgp_roa_set
+{
+  unsigned int count;
+  struct bgp_roa roas[];
+};
+
+/* The ROA index: a prefix trie per address family, walked down once to
+   validate a route against every ROA covering it. */
+static struct route_table *roa_table[AFI_MAX];
+static unsigned long roa_count[AFI_MAX];
+
+/* Prefixes whose ROAs changed since the routes were last revalidated. */
+static struct route_table *roa_dirty[AFI_MAX];
+
+/* Routes looked at by revalidation, for telling it was incremental. */
+static unsigned long rpki_revalidated;
+
+/* The RTR cache we get the ROAs from. */
+struct rpki_cache
+{
+  char *host;
+  union sockunion su;
+  u_int16_t port;
+
+  int fd;
+  u_char version;
+
+  u_char state;
+#define RPKI_CACHE_IDLE		0
+#define RPKI_CACHE_CONNECTING	1
+#define RPKI_CACHE_QUERY	2
+#define RPKI_CACHE_DATA		3
+#define RPKI_CACHE_SYNCED	4
+
+  /* The data coming in replaces all we had. */
+  u_char reset;
+
+  u_char have_serial;
+  u_int16_t session_id;
+  u_int32_t serial;
+
+  u_int32_t refresh;
+  u_int32_t retry;
+  u_int32_t expire;
+
+  struct stream *ibuf;
+  struct stream *obuf;
+
+  struct thread *t_read;
+  struct thread *t_connect;
+  struct thread *t_timer;
+  struct thread *t_expire;
+};
+
+static struct rpki_cache *rpki_cache;
+
+static const char *rpki_cache_state_str[] =
+{
+  "idle",
+  "connecting",
+  "query sent",
+  "receiving data",
+  "synchronized",
+};
+
+const char *
+bgp_rpki_state_str (int state)
+{
+  switch (state)
+    {
+    case BGP_RPKI_VALID:
+      return "valid";
+    case BGP_RPKI_INVALID:
+      return "invalid";
+    case BGP_RPKI_NOTFOUND:
+      return "not found";
+    default:
+      return "not used";
+    }
+}
+
+/* The ROA index. */
+
+static void
+bgp_rpki_dirty (afi_t afi, struct prefix *p)
+{
+  struct route_node *rn;
+
+  if (! roa_dirty[afi])
+    roa_dirty[afi] = route_table_init ();
+
+  /* The mark keeps the lock, the table goes as a whole. */
+  rn = route_node_get (roa_dirty[afi], p);
+  if (rn->info)
+    route_unlock_node (rn);
+  else
+    rn->info = rn;
+}
+
+static int
+bgp_rpki_roa_check (struct prefix *p, u_char maxlen, afi_t *afi)
+{
+  *afi = family2afi (p->family);
+  if (*afi != AFI_IP && *afi != AFI_IP6)
+    return -1;
+  if (maxlen < p->prefixlen || maxlen > prefix_blen (p) * 8)
+    return -1;
+  return 0;
+}
+
+/* Add a ROA.  A stale one just announced again is kept as it was.
+   Returns -1 for a ROA already there, or one that makes no sense. */
+int
+bgp_rpki_roa_add (struct prefix *p, u_char maxlen, as_t asn)
+{
+  struct route_node *rn;
+  struct bgp_roa_set *set;
+  struct prefix key;
+  unsigned int i;
+  afi_t afi;
+
+  if (bgp_rpki_roa_check (p, maxlen, &afi) < 0)
+    return -1;
+
+  prefix_copy (&key, p);
+  apply_mask (&key);
+
+  if (! roa_table[afi])
+    roa_table[afi] = route_table_init ();
+  rn = route_node_get (roa_table[afi], &key);
+
+  set = rn->info;
+  if (set)
+    {
+      route_unlock_node (rn);
+
+      for (i = 0; i < set->count; i++)
+	if (set->roas[i].asn == asn && set->roas[i].maxlen == maxlen)
+	  {
+	    if (! set->roas[i].stale)
+	      return -1;
+	    set->roas[i].stale = 0;
+	    return 0;
+	  }
+    }
+
+  /* The lock taken by route_node_get stays with a new set. */
+  set = XREALLOC (MTYPE_BGP_RPKI_ROA, set, sizeof (struct bgp_roa_set)
+		  + (set ? set->count + 1 : 1) * sizeof (struct bgp_roa));
+  if (! rn->info)
+    set->count = 0;
+  rn->info = set;
+
+  set->roas[set->count].asn = asn;
+  set->roas[set->count].maxlen = maxlen;
+  set->roas[set->count].stale = 0;
+  set->count++;
+
+  roa_count[afi]++;
+  bgp_rpki_dirty (afi, &key);
+  return 0;
+}
+
+static void
+bgp_rpki_roa_remove (afi_t afi, struct route_node *rn, unsigned int i)
+{
+  struct bgp_roa_set *set = rn->info;
+
+  set->roas[i] = set->roas[--set->count];
+  if (set->count == 0)
+    {
+      XFREE (MTYPE_BGP_RPKI_ROA, set);
+      rn->info = NULL;
+      route_unlock_node (rn);
+    }
+
+  roa_count[afi]--;
+  bgp_rpki_dirty (afi, &rn->p);
+}
+
+/* Withdraw a ROA.  Returns -1 if there was no such ROA. */
+int
+bgp_rpki_roa_delete (struct prefix *p, u_char maxlen, as_t asn)
+{
+  struct route_node *rn;
+  struct bgp_roa_set *set;
+  struct prefix key;
+  unsigned int i;
+  afi_t afi;
+
+  if (bgp_rpki_roa_check (p, maxlen, &afi) < 0 || ! roa_table[afi])
+    return -1;
+
+  prefix_copy (&key, p);
+  apply_mask (&key);
+
+  if ((rn = route_node_lookup (roa_table[afi], &key)) == NULL)
+    return -1;
+
+  set = rn->info;
+  for (i = 0; i < set->count; i++)
+    if (set->roas[i].asn == asn && set->roas[i].maxlen == maxlen)
+      break;
+
+  if (i == set->count)
+    {
+      route_unlock_node (rn);
+      return -1;
+    }
+
+  bgp_rpki_roa_remove (afi, rn, i);
+  route_unlock_node (rn);
+  return 0;
+}
+
+/* Mark every ROA stale, before a cache sends all it has again. */
+static void
+bgp_rpki_roa_mark_stale (void)
+{
+  struct route_node *rn;
+  struct bgp_roa_set *set;
+  unsigned int i;
+  afi_t afi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    if (roa_table[afi])
+      for (rn = route_top (roa_table[afi]); rn; rn = route_next (rn))
+	if ((set = rn->info) != NULL)
+	  for (i = 0; i < set->count; i++)
+	    set->roas[i].stale = 1;
+}
+
+/* Remove the ROAs still stale: the cache did not send them again. */
+static void
+bgp_rpki_roa_sweep (void)
+{
+  struct route_node *rn;
+  struct bgp_roa_set *set;
+  unsigned int i;
+  afi_t afi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    {
+      if (! roa_table[afi])
+	continue;
+
+      for (rn = route_top (roa_table[afi]); rn; rn = route_next (rn))
+	{
+	  for (i = 0; (set = rn->info) != NULL && i < set->count; )
+	    {
+	      if (set->roas[i].stale)
+		bgp_rpki_roa_remove (afi, rn, i);
+	      else
+		i++;
+	    }
+	}
+    }
+}
+
+unsigned long
+bgp_rpki_roa_count (void)
+{
+  return roa_count[AFI_IP] + roa_count[AFI_IP6];
+}
+
+/* Validate a route for prefix p originated by origin, RFC 6811: valid if
+   any ROA covering p has the origin AS and a max length p is within,
+   invalid if ROAs cover p but none does, else not found.  The trie is
+   walked down the once, every covering ROA sits on the way. */
+int
+bgp_rpki_validate (struct prefix *p, as_t origin)
+{
+  struct route_node *rn;
+  struct bgp_roa_set *set;
+  unsigned int i;
+  int covered = 0;
+  afi_t afi;
+
+  afi = family2afi (p->family);
+  if (afi != AFI_IP && afi != AFI_IP6)
+    return BGP_RPKI_NOT_BEING_USED;
+  if (! rpki_cache && ! roa_count[AFI_IP] && ! roa_count[AFI_IP6])
+    return BGP_RPKI_NOT_BEING_USED;
+  if (! roa_table[afi])
+    return BGP_RPKI_NOTFOUND;
+
+  rn = roa_table[afi]->top;
+  while (rn && rn->p.prefixlen <= p->prefixlen && prefix_match (&rn->p, p))
+    {
+      if ((set = rn->info) != NULL)
+	{
+	  covered = 1;
+
+	  /* AS 0 ROAs say the prefix is not to be originated at all. */
+	  if (origin)
+	    for (i = 0; i < set->count; i++)
+	      if (set->roas[i].asn == origin
+		  && p->prefixlen <= set->roas[i].maxlen)
+		return BGP_RPKI_VALID;
+	}
+
+      if (rn->p.prefixlen == p->prefixlen)
+	break;
+      rn = rn->link[prefix_bit (&p->u.prefix, rn->p.prefixlen)];
+    }
+
+  return covered ? BGP_RPKI_INVALID : BGP_RPKI_NOTFOUND;
+}
+
+/* Validate a route with attr received by bgp.  Routes from within our
+   AS, or confederation, have it as their origin. */
+int
+bgp_rpki_validate_route (struct prefix *p, struct attr *attr,
+			 struct bgp *bgp)
+{
+  as_t origin;
+
+  if (attr->aspath && aspath_count_hops (attr->aspath))
+    origin = aspath_origin (attr->aspath);
+  else if (CHECK_FLAG (bgp->config, BGP_CONFIG_CONFEDERATION))
+    origin = bgp->confed_id;
+  else
+    origin = bgp->as;
+
+  return bgp_rpki_validate (p, origin);
+}
+
+/* Whether the inbound policy of peer looks at validation state. */
+static int
+bgp_rpki_policy_used (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_filter *filter = &peer->filter[afi][safi];
+
+  return (peer->status == Established && peer->afc_nego[afi][safi]
+	  && ROUTE_MAP_IN (filter)
+	  && route_map_has_match (ROUTE_MAP_IN (filter), "rpki"));
+}
+
+/* Revalidate the routes for rn, and run inbound policy looking at their
+   validation state again for the peers in policy_peers. */
+static void
+bgp_rpki_revalidate_node (struct bgp *bgp, struct bgp_node *rn,
+			  afi_t afi, safi_t safi, struct list *policy_peers)
+{
+  struct bgp_info *ri;
+  struct listnode *node;
+  struct peer *peer;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->type == ZEBRA_ROUTE_BGP && ri->sub_type == BGP_ROUTE_NORMAL
+	&& ri->peer != bgp->peer_self)
+      {
+	ri->rpki_state = bgp_rpki_validate_route (&rn->p, ri->attr, bgp);
+	rpki_revalidated++;
+      }
+
+  for (ALL_LIST_ELEMENTS_RO (policy_peers, node, peer))
+    bgp_soft_reconfig_node (peer, rn, afi, safi);
+}
+
+/* Revalidate the routes of bgp within the prefixes whose ROAs changed. */
+static void
+bgp_rpki_revalidate_bgp (struct bgp *bgp, afi_t afi, safi_t safi)
+{
+  struct route_node *dn, *up;
+  struct bgp_node *top, *rn;
+  struct list *policy_peers;
+  struct listnode *node;
+  struct peer *peer;
+
+  if (! bgp->rib[afi][safi])
+    return;
+
+  /* Peers whose policy could change what they sent need it run again:
+     over the Adj-RIB-In as soft reconfiguration would, or by asking
+     for the routes once more. */
+  policy_peers = list_new ();
+  for (ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
+    if (bgp_rpki_policy_used (peer, afi, safi))
+      {
+	if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG))
+	  listnode_add (policy_peers, peer);
+	else if (CHECK_FLAG (peer->cap, PEER_CAP_REFRESH_ADV)
+		 && (CHECK_FLAG (peer->cap, PEER_CAP_REFRESH_OLD_RCV)
+		     || CHECK_FLAG (peer->cap, PEER_CAP_REFRESH_NEW_RCV)))
+	  bgp_route_refresh_send (peer, afi, safi, 0, 0, 0);
+      }
+
+  for (dn = route_top (roa_dirty[afi]); dn; dn = route_next (dn))
+    {
+      if (! dn->info)
+	continue;
+
+      /* Done along with a changed prefix covering it. */
+      for (up = dn->parent; up; up = up->parent)
+	if (up->info)
+	  break;
+      if (up)
+	continue;
+
+      top = bgp_node_get (bgp->rib[afi][safi], &dn->p);
+      for (rn = bgp_lock_node (top); rn; rn = bgp_route_next_until (rn, top))
+	if (rn->info)
+	  bgp_rpki_revalidate_node (bgp, rn, afi, safi, policy_peers);
+      bgp_unlock_node (top);
+    }
+
+  list_delete (policy_peers);
+}
+
+/* Bring the validation state of routes up to date with the ROAs, looking
+   only at those for prefixes whose ROAs changed. */
+void
+bgp_rpki_revalidate (void)
+{
+  struct listnode *node;
+  struct bgp *bgp;
+  afi_t afi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    {
+      if (! roa_dirty[afi])
+	continue;
+
+      for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+	{
+	  bgp_rpki_revalidate_bgp (bgp, afi, SAFI_UNICAST);
+	  bgp_rpki_revalidate_bgp (bgp, afi, SAFI_MULTICAST);
+	}
+
+      route_table_finish (roa_dirty[afi]);
+      roa_dirty[afi] = NULL;
+    }
+}
+
+unsigned long
+bgp_rpki_revalidated (void)
+{
+  return rpki_revalidated;
+}
+
+/* The RTR client. */
+
+static void rpki_cache_connect (struct rpki_cache *);
+
+static int
+rpki_cache_connect_timer (struct thread *thread)
+{
+  struct rpki_cache *cache = THREAD_ARG (thread);
+
+  cache->t_timer = NULL;
+  rpki_cache_connect (cache);
+  return 0;
+}
+
+static void
+rpki_cache_close (struct rpki_cache *cache)
+{
+  THREAD_OFF (cache->t_read);
+  THREAD_OFF (cache->t_connect);
+  THREAD_OFF (cache->t_timer);
+
+  if (cache->fd >= 0)
+    {
+      close (cache->fd);
+      cache->fd = -1;
+    }
+  stream_reset (cache->ibuf);
+
+  /* Part of an update was applied, only a reset puts it right. */
+  if (cache->state == RPKI_CACHE_DATA)
+    cache->have_serial = 0;
+  cache->state = RPKI_CACHE_IDLE;
+}
+
+/* Drop the connection, and try again in delay seconds. */
+static void
+rpki_cache_retry (struct rpki_cache *cache, u_int32_t delay)
+{
+  rpki_cache_close (cache);
+  cache->t_timer = thread_add_timer (bm->master, rpki_cache_connect_timer,
+				     cache, delay);
+}
+
+static void
+rpki_cache_header (struct stream *s, u_char version, u_char type,
+		   u_int16_t session, u_int32_t length)
+{
+  stream_reset (s);
+  stream_putc (s, version);
+  stream_putc (s, type);
+  stream_putw (s, session);
+  stream_putl (s, length);
+}
+
+static int
+rpki_cache_send (struct rpki_cache *cache)
+{
+  size_t length = stream_get_endp (cache->obuf);
+
+  if (write (cache->fd, STREAM_DATA (cache->obuf), length) != (ssize_t) length)
+    {
+      zlog_warn ("RPKI cache %s: write failed: %s", cache->host,
+		 safe_strerror (errno));
+      rpki_cache_retry (cache, cache->retry);
+      return -1;
+    }
+  return 0;
+}
+
+/* Ask for what changed since the serial we have, or for everything. */
+static void
+rpki_cache_query (struct rpki_cache *cache)
+{
+  if (cache->have_serial)
+    {
+      rpki_cache_header (cache->obuf, cache->version, RTR_SERIAL_QUERY,
+			 cache->session_id, RTR_SERIAL_QUERY_SIZE);
+      stream_putl (cache->obuf, cache->serial);
+    }
+  else
+    rpki_cache_header (cache->obuf, cache->version, RTR_RESET_QUERY, 0,
+		       RTR_HEADER_SIZE);
+
+  if (rpki_cache_send (cache) == 0)
+    cache->state = RPKI_CACHE_QUERY;
+}
+
+/* Report an error to the cache, and start over with it after a while. */
+static void
+rpki_cache_error (struct rpki_cache *cache, u_int16_t code, const char *text)
+{
+  size_t len = strlen (text);
+
+  zlog_warn ("RPKI cache %s: %s", cache->host, text);
+
+  rpki_cache_header (cache->obuf, cache->version, RTR_ERROR_REPORT, code,
+		     RTR_HEADER_SIZE + 8 + len);
+  stream_putl (cache->obuf, 0);
+  stream_putl (cache->obuf, len);
+  stream_put (cache->obuf, text, len);
+  if (rpki_cache_send (cache) == 0)
+    rpki_cache_retry (cache, cache->retry);
+}
+
+static int
+rpki_cache_refresh_timer (struct thread *thread)
+{
+  struct rpki_cache *cache = THREAD_ARG (thread);
+
+  cache->t_timer = NULL;
+  if (cache->state == RPKI_CACHE_SYNCED)
+    rpki_cache_query (cache);
+  return 0;
+}
+
+/* The cache has not been heard from for too long to trust its ROAs. */
+static int
+rpki_cache_expire_timer (struct thread *thread)
+{
+  struct rpki_cache *cache = THREAD_ARG (thread);
+
+  cache->t_expire = NULL;
+  zlog_warn ("RPKI cache %s: data expired", cache->host);
+
+  cache->have_serial = 0;
+  bgp_rpki_roa_mark_stale ();
+  bgp_rpki_roa_sweep ();
+  bgp_rpki_revalidate ();
+  return 0;
+}
+
+static void
+rpki_cache_prefix (struct rpki_cache *cache, struct stream *s, afi_t afi)
+{
+  struct prefix p;
+  u_char flags, maxlen;
+  as_t asn;
+  int ret;
+
+  memset (&p, 0, sizeof (struct prefix));
+  p.family = afi2family (afi);
+
+  flags = stream_getc (s);
+  p.prefixlen = stream_getc (s);
+  maxlen = stream_getc (s);
+  stream_getc (s);
+  stream_get (&p.u.prefix, s, afi == AFI_IP ? 4 : 16);
+  asn = stream_getl (s);
+
+  if (p.prefixlen > prefix_blen (&p) * 8)
+    {
+      rpki_cache_error (cache, RTR_ERROR_CORRUPT_DATA, "bad prefix length");
+      return;
+    }
+
+  if (CHECK_FLAG (flags, RTR_FLAG_ANNOUNCE))
+    {
+      if ((ret = bgp_rpki_roa_add (&p, maxlen, asn)) < 0)
+	rpki_cache_error (cache, RTR_ERROR_DUPLICATE_ANNOUNCE,
+			  "duplicate announcement");
+    }
+  else if ((ret = bgp_rpki_roa_delete (&p, maxlen, asn)) < 0)
+    rpki_cache_error (cache, RTR_ERROR_UNKNOWN_WITHDRAWAL,
+		      "withdrawal of unknown record");
+}
+
+static void
+rpki_cache_end_of_data (struct rpki_cache *cache, struct stream *s,
+			u_int16_t session)
+{
+  if (session != cache->session_id)
+    {
+      rpki_cache_error (cache, RTR_ERROR_CORRUPT_DATA, "session changed");
+      return;
+    }
+
+  cache->serial = stream_getl (s);
+  cache->have_serial = 1;
+  if (cache->version >= RTR_PROTOCOL_VERSION_1)
+    {
+      u_int32_t refresh = stream_getl (s);
+      u_int32_t retry = stream_getl (s);
+      u_int32_t expire = stream_getl (s);
+
+      /* Zero would have us spin, keep what we had. */
+      if (refresh)
+	cache->refresh = refresh;
+      if (retry)
+	cache->retry = retry;
+      if (expire)
+	cache->expire = expire;
+    }
+  cache->state = RPKI_CACHE_SYNCED;
+
+  if (cache->reset)
+    bgp_rpki_roa_sweep ();
+  cache->reset = 0;
+
+  zlog_info ("RPKI cache %s: serial %u, %lu ROAs", cache->host,
+	     cache->serial, bgp_rpki_roa_count ());
+
+  bgp_rpki_revalidate ();
+
+  THREAD_OFF (cache->t_timer);
+  THREAD_OFF (cache->t_expire);
+  cache->t_timer = thread_add_timer (bm->master, rpki_cache_refresh_timer,
+				     cache, cache->refresh);
+  cache->t_expire = thread_add_timer (bm->master, rpki_cache_expire_timer,
+				      cache, cache->expire);
+}
+
+static void
+rpki_cache_error_report (struct rpki_cache *cache, struct stream *s,
+			 u_int16_t code, u_int32_t length)
+{
+  char text[RTR_PDU_MAX];
+  u_int32_t left, len;
+
+  /* The two lengths, then the erroneous PDU and the text, neither
+     longer than what is left of the PDU. */
+  if (length < RTR_HEADER_SIZE + 8)
+    {
+      rpki_cache_error (cache, RTR_ERROR_CORRUPT_DATA,
+			"truncated error report");
+      return;
+    }
+  left = length - RTR_HEADER_SIZE - 8;
+
+  len = stream_getl (s);
+  if (len > left)
+    {
+      rpki_cache_error (cache, RTR_ERROR_CORRUPT_DATA,
+			"bad error report PDU length");
+      return;
+    }
+  stream_forward_getp (s, len);
+  left -= len;
+
+  len = stream_getl (s);
+  if (len > left)
+    {
+      rpki_cache_error (cache, RTR_ERROR_CORRUPT_DATA,
+			"bad error report text length");
+      return;
+    }
+  stream_get (text, s, len);
+  text[len] = '\0';
+
+  zlog_warn ("RPKI cache %s: error %u: %s", cache->host, code, text);
+
+  /* A version 0 cache, drop down to it. */
+  if (code == RTR_ERROR_UNSUPPORTED_VERSION
+      && cache->version > RTR_PROTOCOL_VERSION_0)
+    {
+      cache->version = RTR_PROTOCOL_VERSION_0;
+      cache->have_serial = 0;
+      rpki_cache_retry (cache, 0);
+      return;
+    }
+
+  rpki_cache_retry (cache, cache->retry);
+}
+
+/* Handle one complete PDU, at the getp of s. */
+static void
+rpki_cache_pdu (struct rpki_cache *cache, struct stream *s)
+{
+  u_char version, type;
+  u_int16_t session;
+  u_int32_t length;
+  size_t start = stream_get_getp (s);
+
+  version = stream_getc (s);
+  type = stream_getc (s);
+  session = stream_getw (s);
+  length = stream_getl (s);
+
+  if (type == RTR_ERROR_REPORT)
+    {
+      rpki_cache_error_report (cache, s, session, length);
+      return;
+    }
+
+  if (version != cache->version)
+    {
+      rpki_cache_error (cache, RTR_ERROR_UNSUPPORTED_VERSION,
+			"unexpected protocol version");
+      return;
+    }
+
+  switch (type)
+    {
+    case RTR_SERIAL_NOTIFY:
+      if (cache->state == RPKI_CACHE_SYNCED)
+	{
+	  THREAD_OFF (cache->t_timer);
+	  rpki_cache_query (cache);
+	}
+      break;
+    case RTR_CACHE_RESPONSE:
+      if (cache->state != RPKI_CACHE_QUERY)
+	{
+	  rpki_cache_error (cache, RTR_ERROR_CORRUPT_DATA,
+			    "unexpected cache response");
+	  return;
+	}
+      if (! cache->have_serial)
+	{
+	  /* Whatever is not sent again goes at the end. */
+	  cache->session_id = session;
+	  cache->reset = 1;
+	  bgp_rpki_roa_mark_stale ();
+	}
+      else if (session != cache->session_id)
+	{
+	  rpki_cache_error (cache, RTR_ERROR_CORRUPT_DATA, "session changed");
+	  return;
+	}
+      cache->state = RPKI_CACHE_DATA;
+      break;
+    case RTR_IPV4_PREFIX:
+    case RTR_IPV6_PREFIX:
+      if (cache->state != RPKI_CACHE_DATA
+	  || length != (type == RTR_IPV4_PREFIX
+			? RTR_IPV4_PREFIX_SIZE : RTR_IPV6_PREFIX_SIZE))
+	{
+	  rpki_cache_error (cache, RTR_ERROR_CORRUPT_DATA,
+			    "unexpected prefix PDU");
+	  return;
+	}
+      rpki_cache_prefix (cache, s, type == RTR_IPV4_PREFIX ? AFI_IP : AFI_IP6);
+      break;
+    case RTR_END_OF_DATA:
+      if (cache->state != RPKI_CACHE_DATA
+	  || length < (cache->version >= RTR_PROTOCOL_VERSION_1
+		       ? RTR_END_OF_DATA_V1_SIZE : RTR_END_OF_DATA_V0_SIZE))
+	{
+	  rpki_cache_error (cache, RTR_ERROR_CORRUPT_DATA,
+			    "unexpected end of data");
+	  return;
+	}
+      rpki_cache_end_of_data (cache, s, session);
+      break;
+    case RTR_CACHE_RESET:
+      cache->have_serial = 0;
+      rpki_cache_query (cache);
+      break;
+    case RTR_ROUTER_KEY:
+      /* BGPsec router keys are of no use to us. */
+      break;
+    default:
+      rpki_cache_error (cache, RTR_ERROR_UNSUPPORTED_PDU,
+			"unsupported PDU type");
+      return;
+    }
+
+  if (cache->fd >= 0)
+    stream_set_getp (s, start + length);
+}
+
+static int
+rpki_cache_read (struct thread *thread)
+{
+  struct rpki_cache *cache = THREAD_ARG (thread);
+  struct stream *s = cache->ibuf;
+  u_int32_t length;
+  ssize_t nbytes;
+  size_t left;
+
+  cache->t_read = NULL;
+
+  nbytes = stream_read_try (s, cache->fd, STREAM_WRITEABLE (s));
+  if (nbytes == 0 || nbytes == -1)
+    {
+      zlog_warn ("RPKI cache %s: connection %s", cache->host,
+		 nbytes ? "failed" : "closed");
+      rpki_cache_retry (cache, cache->retry);
+      return 0;
+    }
+
+  /* Every complete PDU read, there may be many. */
+  while (cache->fd >= 0 && STREAM_READABLE (s) >= RTR_HEADER_SIZE)
+    {
+      length = stream_getl_from (s, stream_get_getp (s) + 4);
+      if (length < RTR_HEADER_SIZE || length > RTR_PDU_MAX)
+	{
+	  rpki_cache_error (cache, RTR_ERROR_CORRUPT_DATA, "bad PDU length");
+	  return 0;
+	}
+      if (STREAM_READABLE (s) < length)
+	break;
+      rpki_cache_pdu (cache, s);
+    }
+
+  if (cache->fd < 0)
+    return 0;
+
+  /* Keep the partial PDU left for next time. */
+  left = STREAM_READABLE (s);
+  memmove (STREAM_DATA (s), STREAM_PNT (s), left);
+  stream_set_getp (s, 0);
+  stream_set_endp (s, left);
+
+  cache->t_read = thread_add_read (bm->master, rpki_cache_read, cache,
+				   cache->fd);
+  return 0;
+}
+
+static void
+rpki_cache_connected (struct rpki_cache *cache)
+{
+  zlog_info ("RPKI cache %s: connected, RTR version %u", cache->host,
+	     cache->version);
+
+  cache->t_read = thread_add_read (bm->master, rpki_cache_read, cache,
+				   cache->fd);
+  rpki_cache_query (cache);
+}
+
+static int
+rpki_cache_connect_check (struct thread *thread)
+{
+  struct rpki_cache *cache = THREAD_ARG (thread);
+  socklen_t slen;
+  int status;
+
+  cache->t_connect = NULL;
+
+  slen = sizeof (status);
+  if (getsockopt (cache->fd, SOL_SOCKET, SO_ERROR, (void *) &status, &slen) < 0
+      || status != 0)
+    {
+      zlog_info ("RPKI cache %s: connect failed", cache->host);
+      rpki_cache_retry (cache, RTR_CONNECT_RETRY);
+      return 0;
+    }
+
+  rpki_cache_connected (cache);
+  return 0;
+}
+
+static void
+rpki_cache_connect (struct rpki_cache *cache)
+{
+  rpki_cache_close (cache);
+
+  cache->fd = sockunion_socket (&cache->su);
+  if (cache->fd < 0)
+    {
+      rpki_cache_retry (cache, RTR_CONNECT_RETRY);
+      return;
+    }
+  set_nonblocking (cache->fd);
+  cache->state = RPKI_CACHE_CONNECTING;
+
+  switch (sockunion_connect (cache->fd, &cache->su, htons (cache->port), 0))
+    {
+    case connect_success:
+      rpki_cache_connected (cache);
+      break;
+    case connect_in_progress:
+      cache->t_connect = thread_add_write (bm->master, rpki_cache_connect_check,
+					   cache, cache->fd);
+      break;
+    default:
+      zlog_info ("RPKI cache %s: connect failed", cache->host);
+      rpki_cache_retry (cache, RTR_CONNECT_RETRY);
+      break;
+    }
+}
+
+static void
+rpki_cache_free (struct rpki_cache *cache)
+{
+  rpki_cache_close (cache);
+  THREAD_OFF (cache->t_expire);
+  stream_free (cache->ibuf);
+  stream_free (cache->obuf);
+  XFREE (MTYPE_BGP_RPKI_CACHE, cache->host);
+  XFREE (MTYPE_BGP_RPKI_CACHE, cache);
+}
+
+/* Get the ROAs from the RTR cache at host, port.  The ROAs had so far
+   are kept until the new cache has sent its own. */
+int
+bgp_rpki_cache_set (const char *host, u_int16_t port)
+{
+  struct rpki_cache *cache;
+  union sockunion su;
+
+  if (str2sockunion (host, &su) < 0)
+    return -1;
+
+  if (rpki_cache)
+    rpki_cache_free (rpki_cache);
+
+  cache = XCALLOC (MTYPE_BGP_RPKI_CACHE, sizeof (struct rpki_cache));
+  cache->host = XSTRDUP (MTYPE_BGP_RPKI_CACHE, host);
+  cache->su = su;
+  cache->port = port;
+  cache->fd = -1;
+  cache->version = RTR_PROTOCOL_VERSION_1;
+  cache->refresh = RTR_DEFAULT_REFRESH;
+  cache->retry = RTR_DEFAULT_RETRY;
+  cache->expire = RTR_DEFAULT_EXPIRE;
+  cache->ibuf = stream_new (RTR_PDU_MAX * 16);
+  cache->obuf = stream_new (RTR_PDU_MAX);
+  rpki_cache = cache;
+
+  cache->t_timer = thread_add_event (bm->master, rpki_cache_connect_timer,
+				     cache, 0);
+  return 0;
+}
+
+/* Stop origin validation altogether. */
+void
+bgp_rpki_cache_unset (void)
+{
+  if (! rpki_cache)
+    return;
+
+  rpki_cache_free (rpki_cache);
+  rpki_cache = NULL;
+
+  bgp_rpki_roa_mark_stale ();
+  bgp_rpki_roa_sweep ();
+  bgp_rpki_revalidate ();
+}
+
+/* The serial of the data we have from the cache, if any, in *serial. */
+int
+bgp_rpki_cache_serial (u_int32_t *serial)
+{
+  if (! rpki_cache || ! rpki_cache->have_serial
+      || rpki_cache->state != RPKI_CACHE_SYNCED)
+    return -1;
+  *serial = rpki_cache->serial;
+  return 0;
+}
+
+DEFUN (rpki_cache_config,
+       rpki_cache_cmd,
+       "rpki cache (A.B.C.D|X:X::X:X) <1-65535>",
+       "RPKI origin validation\n"
+       "RTR cache to get ROAs from\n"
+       "IPv4 address of the cache\n"
+       "IPv6 address of the cache\n"
+       "TCP port of the cache\n")
+{
+  u_int16_t port;
+
+  VTY_GET_INTEGER_RANGE ("port", port, argv[1], 1, 65535);
+
+  if (rpki_cache && rpki_cache->port == port
+      && strcmp (rpki_cache->host, argv[0]) == 0)
+    return CMD_SUCCESS;
+
+  if (bgp_rpki_cache_set (argv[0], port) < 0)
+    {
+      vty_out (vty, "%% Malformed address%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_rpki_cache_config,
+       no_rpki_cache_cmd,
+       "no rpki cache",
+       NO_STR
+       "RPKI origin validation\n"
+       "RTR cache to get ROAs from\n")
+{
+  bgp_rpki_cache_unset ();
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_rpki_cache_config,
+       no_rpki_cache_val_cmd,
+       "no rpki cache (A.B.C.D|X:X::X:X) <1-65535>",
+       NO_STR
+       "RPKI origin validation\n"
+       "RTR cache to get ROAs from\n"
+       "IPv4 address of the cache\n"
+       "IPv6 address of the cache\n"
+       "TCP port of the cache\n")
+
+DEFUN (show_rpki_cache,
+       show_rpki_cache_cmd,
+       "show rpki cache",
+       SHOW_STR
+       "RPKI origin validation\n"
+       "RTR cache to get ROAs from\n")
+{
+  struct rpki_cache *cache = rpki_cache;
+
+  if (! cache)
+    {
+      vty_out (vty, "No RPKI cache configured%s", VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+
+  vty_out (vty, "RPKI cache %s port %u, RTR version %u%s",
+	   cache->host, cache->port, cache->version, VTY_NEWLINE);
+  vty_out (vty, "  State: %s%s", rpki_cache_state_str[cache->state],
+	   VTY_NEWLINE);
+  if (cache->have_serial)
+    vty_out (vty, "  Session %u, serial %u%s", cache->session_id,
+	     cache->serial, VTY_NEWLINE);
+  vty_out (vty, "  Refresh %us, retry %us, expire %us%s",
+	   cache->refresh, cache->retry, cache->expire, VTY_NEWLINE);
+  vty_out (vty, "  %lu IPv4 and %lu IPv6 ROAs%s",
+	   roa_count[AFI_IP], roa_count[AFI_IP6], VTY_NEWLINE);
+  return CMD_SUCCESS;
+}
+
+DEFUN (show_rpki_prefix_table,
+       show_rpki_prefix_table_cmd,
+       "show rpki prefix-table",
+       SHOW_STR
+       "RPKI origin validation\n"
+       "ROAs loaded\n")
+{
+  struct route_node *rn;
+  struct bgp_roa_set *set;
+  char buf[PREFIX_STRLEN];
+  unsigned int i;
+  afi_t afi;
+
+  vty_out (vty, "%-43s %6s %10s%s", "Prefix", "Maxlen", "Origin-AS",
+	   VTY_NEWLINE);
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    if (roa_table[afi])
+      for (rn = route_top (roa_table[afi]); rn; rn = route_next (rn))
+	if ((set = rn->info) != NULL)
+	  for (i = 0; i < set->count; i++)
+	    vty_out (vty, "%-43s %6u %10u%s",
+		     prefix2str (&rn->p, buf, sizeof (buf)),
+		     set->roas[i].maxlen, set->roas[i].asn, VTY_NEWLINE);
+
+  vty_out (vty, "%s%lu ROAs%s", VTY_NEWLINE, bgp_rpki_roa_count (),
+	   VTY_NEWLINE);
+  return CMD_SUCCESS;
+}
+
+DEFUN (show_rpki_prefix,
+       show_rpki_prefix_cmd,
+       "show rpki prefix (A.B.C.D/M|X:X::X:X/M) <1-4294967295>",
+       SHOW_STR
+       "RPKI origin validation\n"
+       "Validate a route\n"
+       "IPv4 prefix\n"
+       "IPv6 prefix\n"
+       "Origin AS\n")
+{
+  struct prefix p;
+  as_t asn;
+
+  if (! str2prefix (argv[0], &p))
+    {
+      vty_out (vty, "%% Malformed prefix%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  VTY_GET_INTEGER_RANGE ("AS", asn, argv[1], 1, BGP_AS4_MAX);
+
+  vty_out (vty, "%s%s", bgp_rpki_state_str (bgp_rpki_validate (&p, asn)),
+	   VTY_NEWLINE);
+  return CMD_SUCCESS;
+}
+
+int
+bgp_rpki_config_write (struct vty *vty)
+{
+  if (! rpki_cache)
+    return 0;
+
+  vty_out (vty, "rpki cache %s %u%s", rpki_cache->host, rpki_cache->port,
+	   VTY_NEWLINE);
+  return 1;
+}
+
+void
+bgp_rpki_init (void)
+{
+  install_element (CONFIG_NODE, &rpki_cache_cmd);
+  install_element (CONFIG_NODE, &no_rpki_cache_cmd);
+  install_element (CONFIG_NODE, &no_rpki_cache_val_cmd);
+
+  install_element (VIEW_NODE, &show_rpki_cache_cmd);
+  install_element (VIEW_NODE, &show_rpki_prefix_table_cmd);
+  install_element (VIEW_NODE, &show_rpki_prefix_cmd);
+  install_element (ENABLE_NODE, &show_rpki_cache_cmd);
+  install_element (ENABLE_NODE, &show_rpki_prefix_table_cmd);
+  install_element (ENABLE_NODE, &show_rpki_prefix_cmd);
+}
+
+void
+bgp_rpki_finish (void)
+{
+  struct route_node *rn;
+  afi_t afi;
+
+  if (rpki_cache)
+    {
+      rpki_cache_free (rpki_cache);
+      rpki_cache = NULL;
+    }
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    {
+      if (roa_table[afi])
+	{
+	  for (rn = route_top (roa_table[afi]); rn; rn = route_next (rn))
+	    if (rn->info)
+	      {
+		XFREE (MTYPE_BGP_RPKI_ROA, rn->info);
+		rn->info = NULL;
+		route_unlock_node (rn);
+	      }
+	  route_table_finish (roa_table[afi]);
+	  roa_table[afi] = NULL;
+	}
+      if (roa_dirty[afi])
+	{
+	  route_table_finish (roa_dirty[afi]);
+	  roa_dirty[afi] = NULL;
+	}
+      roa_count[afi] = 0;
+    }
+}
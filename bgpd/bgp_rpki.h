@@ -0,0 +1,93 @@
+/* BGP prefix origin validation (RPKI), RFC 6811 and RFC 8210
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+MA 02111-1307, USA.  */
+
+#ifndef _QUAGGA_BGP_RPKI_H
+#define _QUAGGA_BGP_RPKI_H
+
+/* Origin validation state of a route, as kept in bgp_info.  Zero when
+   no ROA has been loaded, so nothing was validated. */
+#define BGP_RPKI_NOT_BEING_USED	0
+#define BGP_RPKI_VALID		1
+#define BGP_RPKI_NOTFOUND	2
+#define BGP_RPKI_INVALID	3
+
+/* RTR protocol, RFC 8210 (version 1) and RFC 6810 (version 0). */
+#define RTR_PROTOCOL_VERSION_0	0
+#define RTR_PROTOCOL_VERSION_1	1
+
+#define RTR_SERIAL_NOTIFY	0
+#define RTR_SERIAL_QUERY	1
+#define RTR_RESET_QUERY		2
+#define RTR_CACHE_RESPONSE	3
+#define RTR_IPV4_PREFIX		4
+#define RTR_IPV6_PREFIX		6
+#define RTR_END_OF_DATA		7
+#define RTR_CACHE_RESET		8
+#define RTR_ROUTER_KEY		9
+#define RTR_ERROR_REPORT	10
+
+#define RTR_HEADER_SIZE		8
+#define RTR_SERIAL_NOTIFY_SIZE	12
+#define RTR_SERIAL_QUERY_SIZE	12
+#define RTR_IPV4_PREFIX_SIZE	20
+#define RTR_IPV6_PREFIX_SIZE	32
+#define RTR_END_OF_DATA_V0_SIZE	12
+#define RTR_END_OF_DATA_V1_SIZE	24
+#define RTR_PDU_MAX		4096
+
+/* Flags of prefix PDUs. */
+#define RTR_FLAG_ANNOUNCE	0x01
+
+/* Error Report codes. */
+#define RTR_ERROR_CORRUPT_DATA		0
+#define RTR_ERROR_INTERNAL		1
+#define RTR_ERROR_NO_DATA		2
+#define RTR_ERROR_INVALID_REQUEST	3
+#define RTR_ERROR_UNSUPPORTED_VERSION	4
+#define RTR_ERROR_UNSUPPORTED_PDU	5
+#define RTR_ERROR_UNKNOWN_WITHDRAWAL	6
+#define RTR_ERROR_DUPLICATE_ANNOUNCE	7
+
+/* Timers, in seconds, until the cache tells us otherwise. */
+#define RTR_DEFAULT_REFRESH	3600
+#define RTR_DEFAULT_RETRY	600
+#define RTR_DEFAULT_EXPIRE	7200
+#define RTR_CONNECT_RETRY	30
+
+extern void bgp_rpki_init (void);
+extern void bgp_rpki_finish (void);
+extern int bgp_rpki_config_write (struct vty *);
+
+/* The ROA index. */
+extern int bgp_rpki_roa_add (struct prefix *, u_char maxlen, as_t);
+extern int bgp_rpki_roa_delete (struct prefix *, u_char maxlen, as_t);
+extern unsigned long bgp_rpki_roa_count (void);
+extern int bgp_rpki_validate (struct prefix *, as_t origin);
+extern int bgp_rpki_validate_route (struct prefix *, struct attr *,
+				    struct bgp *);
+extern void bgp_rpki_revalidate (void);
+extern const char *bgp_rpki_state_str (int);
+
+/* The cache connection. */
+extern int bgp_rpki_cache_set (const char *host, u_int16_t port);
+extern void bgp_rpki_cache_unset (void);
+extern int bgp_rpki_cache_serial (u_int32_t *);
+extern unsigned long bgp_rpki_revalidated (void);
+
+#endif /* _QUAGGA_BGP_RPKI_H */
@@ -1005,6 +1005,7 @@ DEFUN (bgp_graceful_restart,
 
   bgp = vty->index;
   bgp_flag_set (bgp, BGP_FLAG_GRACEFUL_RESTART);
+  bgp_zebra_graceful_restart_update ();
   return CMD_SUCCESS;
 }
 
@@ -1019,6 +1020,9 @@ DEFUN (no_bgp_graceful_restart,
 
   bgp = vty->index;
   bgp_flag_unset (bgp, BGP_FLAG_GRACEFUL_RESTART);
+  bgp_zebra_graceful_restart_update ();
+  if (bgp->t_fib_hold)
+    bgp_fib_hold_end (bgp);
   return CMD_SUCCESS;
 }
 
@@ -1039,6 +1043,7 @@ DEFUN (bgp_graceful_restart_stalepath_time,
 
   VTY_GET_INTEGER_RANGE ("stalepath-time", stalepath, argv[0], 1, 3600);
   bgp->stalepath_time = stalepath;
+  bgp_zebra_graceful_restart_update ();
   return CMD_SUCCESS;
 }
 
@@ -1059,6 +1064,7 @@ DEFUN (bgp_graceful_restart_restart_time,
 
   VTY_GET_INTEGER_RANGE ("restart-time", restart, argv[0], 1, 3600);
   bgp->restart_time = restart;
+  bgp_zebra_graceful_restart_update ();
   return CMD_SUCCESS;
 }
 
@@ -1077,6 +1083,7 @@ DEFUN (no_bgp_graceful_restart_stalepath_time,
     return CMD_WARNING;
 
   bgp->stalepath_time = BGP_DEFAULT_STALEPATH_TIME;
+  bgp_zebra_graceful_restart_update ();
   return CMD_SUCCESS;
 }
 
@@ -1095,6 +1102,7 @@ DEFUN (no_bgp_graceful_restart_restart_time,
     return CMD_WARNING;
 
   bgp->restart_time = BGP_DEFAULT_RESTART_TIME;
+  bgp_zebra_graceful_restart_update ();
   return CMD_SUCCESS;
 }
 
@@ -7361,6 +7369,7 @@ DEFUN (show_bgp_memory,
 {
   char memstrbuf[MTYPE_MEMSTR_LEN];
   unsigned long count;
+  unsigned long paths, path_bytes, attr_bytes;
   
   /* RIB related usage stats */
   count = mtype_stats_alloc (MTYPE_BGP_NODE);
@@ -7369,16 +7378,20 @@ DEFUN (show_bgp_memory,
                          count * sizeof (struct bgp_node)),
            VTY_NEWLINE);
   
-  count = mtype_stats_alloc (MTYPE_BGP_ROUTE);
+  paths = count = mtype_stats_alloc (MTYPE_BGP_ROUTE);
+  path_bytes = count * sizeof (struct bgp_info);
   vty_out (vty, "%ld BGP routes, using %s of memory%s", count,
            mtype_memstr (memstrbuf, sizeof (memstrbuf),
                          count * sizeof (struct bgp_info)),
            VTY_NEWLINE);
   if ((count = mtype_stats_alloc (MTYPE_BGP_ROUTE_EXTRA)))
-    vty_out (vty, "%ld BGP route ancillaries, using %s of memory%s", count,
-             mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                           count * sizeof (struct bgp_info_extra)),
-             VTY_NEWLINE);
+    {
+      path_bytes += count * sizeof (struct bgp_info_extra);
+      vty_out (vty, "%ld BGP route ancillaries, using %s of memory%s", count,
+               mtype_memstr (memstrbuf, sizeof (memstrbuf),
+                             count * sizeof (struct bgp_info_extra)),
+               VTY_NEWLINE);
+    }
   
   if ((count = mtype_stats_alloc (MTYPE_BGP_STATIC)))
     vty_out (vty, "%ld Static routes, using %s of memory%s", count,
@@ -7388,9 +7401,10 @@ DEFUN (show_bgp_memory,
   
   /* Adj-In/Out */
   if ((count = mtype_stats_alloc (MTYPE_BGP_ADJ_IN)))
-    vty_out (vty, "%ld Adj-In entries, using %s of memory%s", count,
+    vty_out (vty, "%ld Adj-In entries, using %s of memory%s",
+             bgp_adj_in_count (),
              mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                           count * sizeof (struct bgp_adj_in)),
+                           count * sizeof (struct bgp_adj_in_chunk)),
              VTY_NEWLINE);
   if ((count = mtype_stats_alloc (MTYPE_BGP_ADJ_OUT)))
     vty_out (vty, "%ld Adj-Out entries, using %s of memory%s", count,
@@ -7410,11 +7424,13 @@ DEFUN (show_bgp_memory,
                          count * sizeof (struct bgp_damp_info)),
              VTY_NEWLINE);
 
-  /* Attributes */
+  /* Attributes, interned ones carry their extra attributes inline */
   count = attr_count();
-  vty_out (vty, "%ld BGP attributes, using %s of memory%s", count, 
-           mtype_memstr (memstrbuf, sizeof (memstrbuf), 
-                         count * sizeof(struct attr)), 
+  attr_bytes = count * sizeof (struct attr)
+               + attr_extra_count () * sizeof (struct attr_extra);
+  vty_out (vty, "%ld BGP attributes, %ld with extra attributes, "
+           "using %s of memory%s", count, attr_extra_count (),
+           mtype_memstr (memstrbuf, sizeof (memstrbuf), attr_bytes),
            VTY_NEWLINE);
   if ((count = mtype_stats_alloc (MTYPE_ATTR_EXTRA)))
     vty_out (vty, "%ld BGP extra attributes, using %s of memory%s", count, 
@@ -7424,15 +7440,27 @@ DEFUN (show_bgp_memory,
   
   if ((count = attr_unknown_count()))
     vty_out (vty, "%ld unknown attributes%s", count, VTY_NEWLINE);
+  if ((count = mtype_stats_alloc (MTYPE_ATTR_ENCODE)))
+    {
+      unsigned long hit, miss, bytes;
+
+      attr_encode_stats (&hit, &miss, &bytes);
+      vty_out (vty, "%ld cached attribute encodings, using %s of memory, "
+               "%lu hits, %lu misses%s", count,
+               mtype_memstr (memstrbuf, sizeof (memstrbuf), bytes),
+               hit, miss, VTY_NEWLINE);
+    }
   
   /* AS_PATH attributes */
   count = aspath_count ();
+  attr_bytes += count * sizeof (struct aspath);
   vty_out (vty, "%ld BGP AS-PATH entries, using %s of memory%s", count,
            mtype_memstr (memstrbuf, sizeof (memstrbuf),
                          count * sizeof (struct aspath)),
            VTY_NEWLINE);
   
   count = mtype_stats_alloc (MTYPE_AS_SEG);
+  attr_bytes += count * sizeof (struct assegment);
   vty_out (vty, "%ld BGP AS-PATH segments, using %s of memory%s", count,
            mtype_memstr (memstrbuf, sizeof (memstrbuf),
                          count * sizeof (struct assegment)),
@@ -7440,25 +7468,45 @@ DEFUN (show_bgp_memory,
   
   /* Other attributes */
   if ((count = community_count ()))
-    vty_out (vty, "%ld BGP community entries, using %s of memory%s", count,
-             mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                         count * sizeof (struct community)),
-             VTY_NEWLINE);
+    {
+      attr_bytes += count * sizeof (struct community);
+      vty_out (vty, "%ld BGP community entries, using %s of memory%s", count,
+               mtype_memstr (memstrbuf, sizeof (memstrbuf),
+                             count * sizeof (struct community)),
+               VTY_NEWLINE);
+    }
   if ((count = mtype_stats_alloc (MTYPE_ECOMMUNITY)))
-    vty_out (vty, "%ld BGP community entries, using %s of memory%s", count,
-             mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                         count * sizeof (struct ecommunity)),
-             VTY_NEWLINE);
+    {
+      attr_bytes += count * sizeof (struct ecommunity);
+      vty_out (vty, "%ld BGP community entries, using %s of memory%s", count,
+               mtype_memstr (memstrbuf, sizeof (memstrbuf),
+                             count * sizeof (struct ecommunity)),
+               VTY_NEWLINE);
+    }
   if ((count = mtype_stats_alloc (MTYPE_LCOMMUNITY)))
-    vty_out (vty, "%ld BGP large-community entries, using %s of memory%s",
-	     count,
-             mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                         count * sizeof (struct lcommunity)),
-             VTY_NEWLINE);
+    {
+      attr_bytes += count * sizeof (struct lcommunity);
+      vty_out (vty, "%ld BGP large-community entries, using %s of memory%s",
+               count,
+               mtype_memstr (memstrbuf, sizeof (memstrbuf),
+                             count * sizeof (struct lcommunity)),
+               VTY_NEWLINE);
+    }
   if ((count = mtype_stats_alloc (MTYPE_CLUSTER)))
-    vty_out (vty, "%ld Cluster lists, using %s of memory%s", count,
-             mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                         count * sizeof (struct cluster_list)),
+    {
+      attr_bytes += count * sizeof (struct cluster_list);
+      vty_out (vty, "%ld Cluster lists, using %s of memory%s", count,
+               mtype_memstr (memstrbuf, sizeof (memstrbuf),
+                             count * sizeof (struct cluster_list)),
+               VTY_NEWLINE);
+    }
+  
+  /* What each path costs on average, its bgp_info and its share of the
+   * interned attributes it points to.
+   */
+  if (paths)
+    vty_out (vty, "%lu bytes per path, %lu of them for attributes%s",
+             (path_bytes + attr_bytes) / paths, attr_bytes / paths,
              VTY_NEWLINE);
   
   /* Peer related usage */
@@ -8534,6 +8582,19 @@ bgp_show_peer (struct vty *vty, struct peer *p)
 	      vty_out (vty, "%s", VTY_NEWLINE);
 	    }
 
+	  /* Enhanced Route Refresh */
+	  if (CHECK_FLAG (p->cap, PEER_CAP_ENHANCED_RR_ADV)
+	      || CHECK_FLAG (p->cap, PEER_CAP_ENHANCED_RR_RCV))
+	    {
+	      vty_out (vty, "    Enhanced Route Refresh:");
+	      if (CHECK_FLAG (p->cap, PEER_CAP_ENHANCED_RR_ADV))
+		vty_out (vty, " advertised");
+	      if (CHECK_FLAG (p->cap, PEER_CAP_ENHANCED_RR_RCV))
+		vty_out (vty, " %sreceived",
+			 CHECK_FLAG (p->cap, PEER_CAP_ENHANCED_RR_ADV) ? "and " : "");
+	      vty_out (vty, "%s", VTY_NEWLINE);
+	    }
+
 	  /* Multiprotocol Extensions */
 	  for (afi = AFI_IP ; afi < AFI_MAX ; afi++)
 	    for (safi = SAFI_UNICAST ; safi < SAFI_MAX ; safi++)
@@ -11430,6 +11491,7 @@ community_list_set_vty (struct vty *vty, int argc, const char **argv,
   /* When community_list_set() return nevetive value, it means
      malformed community string.  */
   ret = community_list_set (bgp_clist, argv[0], str, direct, style);
+  bgp_policy_changed ();
 
   /* Free temporary community list string allocated by
      argv_concat().  */
@@ -11475,6 +11537,7 @@ community_list_unset_vty (struct vty *vty, int argc, const char **argv,
 
   /* Unset community list.  */
   ret = community_list_unset (bgp_clist, argv[0], str, direct, style);
+  bgp_policy_changed ();
 
   /* Free temporary community list string allocated by
      argv_concat().  */
@@ -11786,6 +11849,7 @@ lcommunity_list_set_vty (struct vty *vty, int argc, const char **argv,
     str = NULL;
 
   ret = lcommunity_list_set (bgp_clist, argv[0], str, direct, style);
+  bgp_policy_changed ();
 
   /* Free temporary community list string allocated by
      argv_concat().  */
@@ -11828,6 +11892,7 @@ lcommunity_list_unset_vty (struct vty *vty, int argc, const char **argv,
 
   /* Unset community list.  */
   ret = lcommunity_list_unset (bgp_clist, argv[0], str, direct, style);
+  bgp_policy_changed ();
 
   /* Free temporary community list string allocated by
      argv_concat().  */
@@ -12136,6 +12201,7 @@ extcommunity_list_set_vty (struct vty *vty, int argc, const char **argv,
     str = NULL;
 
   ret = extcommunity_list_set (bgp_clist, argv[0], str, direct, style);
+  bgp_policy_changed ();
 
   /* Free temporary community list string allocated by
      argv_concat().  */
@@ -12178,6 +12244,7 @@ extcommunity_list_unset_vty (struct vty *vty, int argc, const char **argv,
 
   /* Unset community list.  */
   ret = extcommunity_list_unset (bgp_clist, argv[0], str, direct, style);
+  bgp_policy_changed ();
 
   /* Free temporary community list string allocated by
      argv_concat().  */
@@ -706,6 +706,10 @@ bgp_zebra_announce (struct prefix *p, struct bgp_info *info, struct bgp *bgp, sa
   if (! vrf_bitmap_check (zclient->redist[ZEBRA_ROUTE_BGP], VRF_DEFAULT))
     return;
 
+  /* Graceful restart, the whole table goes in at the end. */
+  if (bgp->t_fib_hold)
+    return;
+
   flags = 0;
   peer = info->peer;
 
@@ -987,6 +991,10 @@ bgp_zebra_withdraw (struct prefix *p, struct bgp_info *info, safi_t safi)
   peer = info->peer;
   flags = 0;
 
+  /* Graceful restart, zebra has kept the route, or will sweep it. */
+  if (peer->bgp->t_fib_hold)
+    return;
+
   if (peer->sort == BGP_PEER_IBGP)
     {
       SET_FLAG (flags, ZEBRA_FLAG_INTERNAL);
@@ -1166,6 +1174,148 @@ bgp_redistribute_unset (struct bgp *bgp, afi_t afi, int type)
   return CMD_SUCCESS;
 }
 
+/* Graceful restart.  With it configured zebra is to keep our routes
+   when we go, and we hold back FIB updates when we are back until our
+   peers have sent their routes again.  Then the best routes go to
+   zebra in one pass, taking the place of those it kept, and zebra
+   sweeps what is left.  */
+void
+bgp_zebra_graceful_restart_update (void)
+{
+  struct bgp *bgp;
+  struct listnode *node;
+  u_int32_t stale_time = 0;
+
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+    if (bgp_flag_check (bgp, BGP_FLAG_GRACEFUL_RESTART))
+      stale_time = MAX (stale_time, bgp->restart_time + bgp->stalepath_time);
+
+  if (zclient == NULL || zclient->stale_time == MIN (stale_time, UINT16_MAX))
+    return;
+
+  zclient->stale_time = MIN (stale_time, UINT16_MAX);
+  if (zclient->sock >= 0)
+    zebra_hello_send (zclient);
+}
+
+static int
+bgp_fib_hold_timer_expire (struct thread *thread)
+{
+  struct bgp *bgp = THREAD_ARG (thread);
+
+  bgp->t_fib_hold = NULL;
+  zlog_info ("graceful restart: not all peers have sent End-of-RIB, "
+	     "updating the FIB anyway");
+  bgp_fib_hold_end (bgp);
+  return 0;
+}
+
+/* Hold back FIB updates, for at most the time zebra keeps our routes
+   for us. */
+static void
+bgp_fib_hold_start (struct bgp *bgp)
+{
+  if (bgp->name || bgp_option_check (BGP_OPT_NO_FIB))
+    return;
+
+  THREAD_TIMER_OFF (bgp->t_fib_hold);
+  THREAD_TIMER_ON (bm->master, bgp->t_fib_hold, bgp_fib_hold_timer_expire,
+		   bgp, bgp->restart_time + bgp->stalepath_time);
+}
+
+/* Put the best routes in the FIB, and have zebra remove the routes it
+   kept for us that we have not replaced. */
+void
+bgp_fib_hold_end (struct bgp *bgp)
+{
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  afi_t afi;
+  unsigned long count = 0;
+
+  THREAD_TIMER_OFF (bgp->t_fib_hold);
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (rn = bgp_table_top (bgp->rib[afi][SAFI_UNICAST]); rn;
+	 rn = bgp_route_next (rn))
+      for (ri = rn->info; ri; ri = ri->next)
+	if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+	  {
+	    if (ri->type == ZEBRA_ROUTE_BGP
+		&& ri->sub_type == BGP_ROUTE_NORMAL)
+	      {
+		bgp_zebra_announce (&rn->p, ri, bgp, SAFI_UNICAST);
+		count++;
+	      }
+	    break;
+	  }
+
+  zlog_info ("graceful restart: %lu routes sent to zebra, sweeping the rest",
+	     count);
+  zebra_stale_sweep_send (zclient);
+}
+
+/* Whether every peer has sent us its routes again, if so end the
+   hold on FIB updates.  Peers that do not do graceful restart say
+   nothing at the end.  For those we wait for a KEEPALIVE that follows
+   an UPDATE, or a second one since Established: the first may be sent
+   as the session comes up, ahead of the table, but a peer queues its
+   table straight away and the next KEEPALIVE behind it.  A peer still
+   sending its table when a KEEPALIVE is due may have its routes swept
+   early, and a peer that never sends one is left to the hold timer. */
+void
+bgp_fib_hold_check (struct bgp *bgp)
+{
+  struct peer *peer;
+  struct listnode *node;
+  afi_t afi;
+  safi_t safi;
+
+  if (! bgp->t_fib_hold)
+    return;
+
+  for (ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
+    {
+      if (CHECK_FLAG (peer->flags, PEER_FLAG_SHUTDOWN))
+	continue;
+      if (peer->status != Established)
+	return;
+      if (! CHECK_FLAG (peer->cap, PEER_CAP_RESTART_RCV))
+	{
+	  if (! CHECK_FLAG (peer->sflags, PEER_STATUS_TABLE_RCVD))
+	    return;
+	  continue;
+	}
+      for (afi = AFI_IP; afi < AFI_MAX; afi++)
+	for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+	  if (peer->afc_nego[afi][safi]
+	      && ! CHECK_FLAG (peer->af_sflags[afi][safi],
+			       PEER_STATUS_EOR_RECEIVED))
+	    return;
+    }
+
+  bgp_fib_hold_end (bgp);
+}
+
+/* Zebra has kept our routes from before we went away.  Leave them in
+   place until the peers have sent theirs again, then replace them in
+   one pass. */
+static int
+bgp_zebra_stale_kept (int command, struct zclient *zclient,
+		      zebra_size_t length, vrf_id_t vrf_id)
+{
+  struct bgp *bgp;
+
+  bgp = bgp_get_default ();
+  if (! bgp || ! bgp_flag_check (bgp, BGP_FLAG_GRACEFUL_RESTART))
+    return 0;
+
+  bgp_fib_hold_start (bgp);
+  /* Peers may be up already, or there may be none to wait for. */
+  bgp_fib_hold_check (bgp);
+  return 0;
+}
+
 void
 bgp_zclient_reset (void)
 {
@@ -1200,6 +1350,7 @@ bgp_zebra_init (struct thread_master *master)
   zclient->ipv6_route_add = zebra_read_ipv6;
   zclient->ipv6_route_delete = zebra_read_ipv6;
   zclient->nexthop_update = bgp_read_nexthop_update;
+  zclient->stale_kept = bgp_zebra_stale_kept;
 
   bgp_nexthop_buf = stream_new(BGP_NEXTHOP_BUF_SIZE);
   bgp_ifindices_buf = stream_new(BGP_IFINDICES_BUF_SIZE);
@@ -38,6 +38,10 @@ extern int bgp_config_write_redistribute (struct vty *, struct bgp *, afi_t, saf
 extern void bgp_zebra_announce (struct prefix *, struct bgp_info *, struct bgp *, safi_t);
 extern void bgp_zebra_withdraw (struct prefix *, struct bgp_info *, safi_t);
 
+extern void bgp_zebra_graceful_restart_update (void);
+extern void bgp_fib_hold_check (struct bgp *);
+extern void bgp_fib_hold_end (struct bgp *);
+
 extern int bgp_redistribute_set (struct bgp *, afi_t, int);
 extern int bgp_redistribute_rmap_set (struct bgp *, afi_t, int, const char *);
 extern int bgp_redistribute_metric_set (struct bgp *, afi_t, int, u_int32_t);
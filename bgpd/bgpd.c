@@ -37,6 +37,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "linklist.h"
 #include "workqueue.h"
 #include "table.h"
+#include "zclient.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -62,6 +63,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_mpath.h"
 #include "bgpd/bgp_nht.h"
+#include "bgpd/bgp_rpki.h"
 #ifdef HAVE_SNMP
 #include "bgpd/bgp_snmp.h"
 #endif /* HAVE_SNMP */
@@ -70,6 +72,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 static struct bgp_master bgp_master;
 
 extern struct in_addr router_id_zebra;
+extern struct zclient *zclient;
 
 /* BGP process wide configuration pointer to export.  */
 struct bgp_master *bm;
@@ -1313,6 +1316,9 @@ peer_delete (struct peer *peer)
       peer_unlock (peer); /* bgp peer list reference */
       list_delete_node (bgp->peer, pn);
     }
+
+  /* A FIB hold may have been waiting on this peer only. */
+  bgp_fib_hold_check (bgp);
       
   if (peer_rsclient_active (peer)
       && (pn = listnode_lookup (bgp->rsclient, peer)))
@@ -2224,6 +2230,7 @@ bgp_delete (struct bgp *bgp)
   SET_FLAG(bgp->flags, BGP_FLAG_DELETING);
 
   THREAD_OFF (bgp->t_startup);
+  THREAD_OFF (bgp->t_fib_hold);
 
   for (ALL_LIST_ELEMENTS (bgp->peer, node, next, peer))
     {
@@ -2600,6 +2607,9 @@ peer_flag_modify_action (struct peer *peer, u_int32_t flag)
 			     BGP_NOTIFY_CEASE_ADMIN_SHUTDOWN);
 	  else
 	    BGP_EVENT_ADD (peer, BGP_Stop);
+
+	  /* No longer to be waited for by a FIB hold. */
+	  bgp_fib_hold_check (peer->bgp);
 	}
       else
 	{
@@ -3950,6 +3960,8 @@ peer_distribute_update (struct access_list *access)
   struct peer_group *group;
   struct bgp_filter *filter;
 
+  bgp_policy_changed ();
+
   for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
     {
       for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
@@ -4109,6 +4121,8 @@ peer_prefix_list_update (struct prefix_list *plist)
   safi_t safi;
   int direct;
 
+  bgp_policy_changed ();
+
   for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
     {
       for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
@@ -4263,6 +4277,8 @@ peer_aslist_update (void)
   struct peer_group *group;
   struct bgp_filter *filter;
 
+  bgp_policy_changed ();
+
   for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
     {
       for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
@@ -5336,6 +5352,9 @@ bgp_config_write (struct vty *vty)
       write++;
     }
 
+  /* Origin validation. */
+  write += bgp_rpki_config_write (vty);
+
   /* BGP configuration. */
   for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
     {
@@ -5561,6 +5580,7 @@ bgp_init (void)
   bgp_scan_vty_init();
   bgp_mplsvpn_init ();
   bgp_encap_init ();
+  bgp_rpki_init ();
 
   /* Access list initialize. */
   access_list_init ();
@@ -5612,3 +5632,52 @@ bgp_terminate (void)
       bm->process_rsclient_queue = NULL;
     }
 }
+
+/* Is graceful restart configured on any instance? */
+int
+bgp_graceful_restart_configured (void)
+{
+  struct bgp *bgp;
+  struct listnode *node;
+
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+    if (bgp_flag_check (bgp, BGP_FLAG_GRACEFUL_RESTART))
+      return 1;
+  return 0;
+}
+
+/* Stop as a graceful restart expects: the sessions are dropped without
+ * a NOTIFICATION, so that peers keep our routes as stale, and nothing is
+ * withdrawn from zebra, which keeps the routes in the FIB until we have
+ * come back and swept them.
+ */
+void
+bgp_terminate_graceful (void)
+{
+  struct bgp *bgp;
+  struct peer *peer;
+  struct listnode *node, *nnode;
+  struct listnode *mnode, *mnnode;
+
+  for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
+    for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
+      if (peer->fd >= 0)
+        {
+          close (peer->fd);
+          peer->fd = -1;
+          peer->status = Idle;
+        }
+
+  zclient_stop (zclient);
+
+  if (bm->process_main_queue)
+    {
+      work_queue_free (bm->process_main_queue);
+      bm->process_main_queue = NULL;
+    }
+  if (bm->process_rsclient_queue)
+    {
+      work_queue_free (bm->process_rsclient_queue);
+      bm->process_rsclient_queue = NULL;
+    }
+}
@@ -106,6 +106,10 @@ struct bgp
 
   struct thread *t_startup;
 
+  /* Graceful restart, FIB updates held back until peers have sent
+     their routes again. */
+  struct thread *t_fib_hold;
+
   /* BGP flags. */
   u_int32_t flags;
 #define BGP_FLAG_ALWAYS_COMPARE_MED       (1 << 0)
@@ -378,6 +382,8 @@ struct peer
 #define PEER_CAP_AS4_RCV                    (1 << 8) /* as4 received */
 #define PEER_CAP_RESTART_BIT_ADV            (1 << 9) /* sent restart state */
 #define PEER_CAP_RESTART_BIT_RCV            (1 << 10) /* peer restart state */
+#define PEER_CAP_ENHANCED_RR_ADV            (1 << 11) /* enhanced refresh advertised */
+#define PEER_CAP_ENHANCED_RR_RCV            (1 << 12) /* enhanced refresh received */
 
   /* Capability flags (reset in bgp_stop) */
   u_int16_t af_cap[AFI_MAX][SAFI_MAX];
@@ -446,6 +452,8 @@ struct peer
 #define PEER_STATUS_GROUP             (1 << 4) /* peer-group conf */
 #define PEER_STATUS_NSF_MODE          (1 << 5) /* NSF aware peer */
 #define PEER_STATUS_NSF_WAIT          (1 << 6) /* wait comeback peer */
+#define PEER_STATUS_PACKET_RCVD       (1 << 7) /* update/keepalive rcvd while up */
+#define PEER_STATUS_TABLE_RCVD        (1 << 8) /* table taken as rcvd, no EoR */
 
   /* Peer status af flags (reset in bgp_stop) */
   u_int16_t af_sflags[AFI_MAX][SAFI_MAX];
@@ -456,6 +464,8 @@ struct peer
 #define PEER_STATUS_PREFIX_LIMIT      (1 << 4) /* exceed prefix-limit */
 #define PEER_STATUS_EOR_SEND          (1 << 5) /* end-of-rib send to peer */
 #define PEER_STATUS_EOR_RECEIVED      (1 << 6) /* end-of-rib received from peer */
+#define PEER_STATUS_EORR_SEND         (1 << 7) /* end-of-route-refresh to send */
+#define PEER_STATUS_BORR_RECEIVED     (1 << 8) /* route refresh under way from peer */
 
   /* Default attribute value for the peer. */
   u_int32_t config;
@@ -522,6 +532,9 @@ struct peer
   /* Announcement attribute hash.  */
   struct hash *hash[AFI_MAX][SAFI_MAX];
 
+  /* Where the peer's Adj-RIB-In entries are allocated from.  */
+  struct bgp_adj_in_arena *adj_in_arena;
+
   /* Notify data. */
   struct bgp_notify notify;
 
@@ -534,6 +547,13 @@ struct peer
   /* ORF Prefix-list */
   struct prefix_list *orf_plist[AFI_MAX][SAFI_MAX];
 
+  /* Policy results for the last attribute seen, see bgp_route.c. */
+#define BGP_POLICY_IN		0 /* filter-list and route-map in */
+#define BGP_POLICY_FILTER_OUT	1 /* filter-list out, on the best path */
+#define BGP_POLICY_OUT		2 /* route-map out, on the exported attr */
+#define BGP_POLICY_MAX		3
+  struct bgp_policy_cache *policy_cache[BGP_POLICY_MAX];
+
   /* Prefix count. */
   unsigned long pcount[AFI_MAX][SAFI_MAX];
 
@@ -670,7 +690,7 @@ struct bgp_nlri
 #define BGP_NOTIFY_HOLD_ERR                      4
 #define BGP_NOTIFY_FSM_ERR                       5
 #define BGP_NOTIFY_CEASE                         6
-#define BGP_NOTIFY_CAPABILITY_ERR                7
+#define BGP_NOTIFY_ROUTE_REFRESH_ERR             7 /* RFC 7313 */
 #define BGP_NOTIFY_MAX	                         8
 
 #define BGP_NOTIFY_SUBCODE_UNSPECIFIC            0
@@ -717,11 +737,9 @@ struct bgp_nlri
 #define BGP_NOTIFY_CEASE_OUT_OF_RESOURCE         8
 #define BGP_NOTIFY_CEASE_MAX                     9
 
-/* BGP_NOTIFY_CAPABILITY_ERR sub codes (draft-ietf-idr-dynamic-cap-02). */
-#define BGP_NOTIFY_CAPABILITY_INVALID_ACTION     1
-#define BGP_NOTIFY_CAPABILITY_INVALID_LENGTH     2
-#define BGP_NOTIFY_CAPABILITY_MALFORMED_CODE     3
-#define BGP_NOTIFY_CAPABILITY_MAX                4
+/* BGP_NOTIFY_ROUTE_REFRESH_ERR sub codes (RFC 7313).  */
+#define BGP_NOTIFY_ROUTE_REFRESH_INVALID_MSG_LEN 1
+#define BGP_NOTIFY_ROUTE_REFRESH_MAX             2
 
 /* BGP finite state machine status.  */
 #define Idle                                     1
@@ -840,6 +858,8 @@ extern struct bgp_master *bm;
 
 /* Prototypes. */
 extern void bgp_terminate (void);
+extern int bgp_graceful_restart_configured (void);
+extern void bgp_terminate_graceful (void);
 extern void bgp_reset (void);
 extern time_t bgp_clock (void);
 extern void bgp_zclient_reset (void);
@@ -127,6 +127,18 @@ buffer_empty (struct buffer *b)
   return (b->head == NULL);
 }
 
+int
+buffer_pending_exceeds (struct buffer *b, size_t size)
+{
+  struct buffer_data *data;
+  size_t total = 0;
+
+  for (data = b->head; data; data = data->next)
+    if ((total += data->cp - data->sp) > size)
+      return 1;
+  return 0;
+}
+
 /* Clear and free all allocated data. */
 void
 buffer_reset (struct buffer *b)
@@ -52,6 +52,10 @@ char *buffer_getstr (struct buffer *);
 /* Returns 1 if there is no pending data in the buffer.  Otherwise returns 0. */
 int buffer_empty (struct buffer *);
 
+/* Returns 1 if more than the given number of bytes are waiting to be
+   flushed.  Otherwise returns 0. */
+int buffer_pending_exceeds (struct buffer *, size_t);
+
 typedef enum
   {
     /* An I/O error occurred.  The buffer should be destroyed and the
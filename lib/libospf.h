@@ -41,6 +41,7 @@
 #endif
 #define OSPF_MIN_LS_INTERVAL                  5000  /* msec */
 #define OSPF_MIN_LS_ARRIVAL                   1000  /* msec */
+#define OSPF_FLOOD_PACING_DEFAULT               33  /* msec */
 #define OSPF_LSA_INITIAL_AGE                     0	/* useful for debug */
 #define OSPF_LSA_MAXAGE                       3600
 #define OSPF_CHECK_AGE                         300
@@ -86,6 +87,10 @@
 #define OSPF_SPF_HOLDTIME_DEFAULT           50
 #define OSPF_SPF_MAX_HOLDTIME_DEFAULT	    5000
 
+/* Threads calculating the SPF trees of areas. */
+#define OSPF_SPF_THREADS_DEFAULT            1
+#define OSPF_SPF_THREADS_MAX                32
+
 #define OSPF_LSA_MAXAGE_CHECK_INTERVAL		30
 #define OSPF_LSA_MAXAGE_REMOVE_DELAY_DEFAULT	60
 
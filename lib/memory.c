@@ -251,18 +251,27 @@ static struct
 } mstat [MTYPE_MAX];
 #endif /* MEMORY_LOG */
 
-/* Increment allocation counter. */
+/* Increment allocation counter.  Daemons may allocate from more than
+   one thread, as ospfd does calculating SPF trees. */
 static void
 alloc_inc (int type)
 {
+#ifdef HAVE_PTHREAD
+  __sync_fetch_and_add (&mstat[type].alloc, 1);
+#else
   mstat[type].alloc++;
+#endif
 }
 
 /* Decrement allocation counter. */
 static void
 alloc_dec (int type)
 {
+#ifdef HAVE_PTHREAD
+  __sync_fetch_and_sub (&mstat[type].alloc, 1);
+#else
   mstat[type].alloc--;
+#endif
 }
 
 /* Looking up memory status from vty interface. */
@@ -89,6 +89,7 @@ struct memory_list memory_list_zebra[] =
   { MTYPE_NETLINK_NAME,	"Netlink name"			},
   { MTYPE_NETLINK_RCVBUF,	"Netlink receive buffer"	},
   { MTYPE_RNH,		        "Nexthop tracking object"	},
+  { MTYPE_SHOW_ROUTE_STATE,	"Show route state"		},
   { -1, NULL },
 };
 
@@ -103,6 +104,7 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_PEER_PASSWORD,	"Peer password string"		},
   { MTYPE_ATTR,			"BGP attribute"			},
   { MTYPE_ATTR_EXTRA,		"BGP extra attributes"		},
+  { MTYPE_ATTR_ENCODE,		"BGP attribute wire encoding"	},
   { MTYPE_AS_PATH,		"BGP aspath"			},
   { MTYPE_AS_SEG,		"BGP aspath seg"		},
   { MTYPE_AS_SEG_DATA,		"BGP aspath segment data"	},
@@ -118,8 +120,13 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_BGP_ADVERTISE,	"BGP adv"			},
   { MTYPE_BGP_SYNCHRONISE,	"BGP synchronise"		},
   { MTYPE_BGP_ADJ_IN,		"BGP adj in"			},
+  { MTYPE_BGP_ADJ_IN_ARENA,	"BGP adj in arena"		},
   { MTYPE_BGP_ADJ_OUT,		"BGP adj out"			},
   { MTYPE_BGP_MPATH_INFO,	"BGP multipath info"		},
+  { MTYPE_BGP_MPATH_SET,	"BGP multipath set"		},
+  { MTYPE_BGP_POLICY_CACHE,	"BGP policy cache"		},
+  { MTYPE_BGP_POLICY_RESULT,	"BGP policy result"		},
+  { MTYPE_BGP_SHOW_STATE,	"BGP show state"		},
   { 0, NULL },
   { MTYPE_AS_LIST,		"BGP AS list"			},
   { MTYPE_AS_FILTER,		"BGP AS filter"			},
@@ -138,6 +145,7 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_COMMUNITY_LIST_ENTRY,	"community-list entry"		},
   { MTYPE_COMMUNITY_LIST_CONFIG,  "community-list config"	},
   { MTYPE_COMMUNITY_LIST_HANDLER, "community-list handler"	},
+  { MTYPE_COMMUNITY_LIST_COMPILED, "community-list matcher"	},
   { 0, NULL },
   { MTYPE_CLUSTER,		"Cluster list"			},
   { MTYPE_CLUSTER_VAL,		"Cluster list val"		},
@@ -154,7 +162,11 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_PEER_UPDATE_SOURCE,	"BGP peer update interface"	},
   { MTYPE_BGP_DAMP_INFO,	"Dampening info"		},
   { MTYPE_BGP_DAMP_ARRAY,	"BGP Dampening array"		},
+  { MTYPE_BGP_RPKI_ROA,		"BGP RPKI ROA set"		},
+  { MTYPE_BGP_RPKI_CACHE,	"BGP RPKI cache"		},
   { MTYPE_BGP_REGEXP,		"BGP regexp"			},
+  { MTYPE_BGP_ASPATH_REGEX,	"BGP as-path regexp"		},
+  { MTYPE_BGP_ASPATH_REGEX_DFA,	"BGP as-path regexp DFA"	},
   { MTYPE_BGP_AGGREGATE,	"BGP aggregate"			},
   { MTYPE_BGP_ADDR,		"BGP own address"		},
   { MTYPE_ENCAP_TLV,		"ENCAP TLV",			},
@@ -206,16 +218,18 @@ struct memory_list memory_list_ospf[] =
   { MTYPE_OSPF_TMP,           "OSPF tmp mem"			},
   { MTYPE_OSPF_LSA,           "OSPF LSA"			},
   { MTYPE_OSPF_LSA_DATA,      "OSPF LSA data"			},
+  { MTYPE_OSPF_LSA_RXMT,      "OSPF LSA retransmit"		},
+  { MTYPE_OSPF_LSA_LINKS,     "OSPF LSA link index"		},
   { MTYPE_OSPF_LSDB,          "OSPF LSDB"			},
+  { MTYPE_OSPF_LSDB_INDEX,    "OSPF LSDB index"		},
   { MTYPE_OSPF_PACKET,        "OSPF packet"			},
   { MTYPE_OSPF_FIFO,          "OSPF FIFO queue"			},
   { MTYPE_OSPF_VERTEX,        "OSPF vertex"			},
-  { MTYPE_OSPF_VERTEX_PARENT, "OSPF vertex parent",		},
-  { MTYPE_OSPF_NEXTHOP,       "OSPF nexthop"			},
   { MTYPE_OSPF_PATH,	      "OSPF path"			},
   { MTYPE_OSPF_VL_DATA,       "OSPF VL data"			},
   { MTYPE_OSPF_CRYPT_KEY,     "OSPF crypt key"			},
   { MTYPE_OSPF_EXTERNAL_INFO, "OSPF ext. info"			},
+  { MTYPE_OSPF_EXTERNAL_DEP,  "OSPF ext. dependency"		},
   { MTYPE_OSPF_DISTANCE,      "OSPF distance"			},
   { MTYPE_OSPF_IF_INFO,       "OSPF if info"			},
   { MTYPE_OSPF_IF_PARAMS,     "OSPF if params"			},
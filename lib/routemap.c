@@ -742,40 +742,66 @@ route_map_delete_set (struct route_map_index *index, const char *set_name,
 static route_map_result_t
 route_map_apply_match (struct route_map_rule_list *match_list,
                        struct prefix *prefix, route_map_object_t type,
-                       void *object)
+                       void *object, struct route_map_memo *memo, int pos)
 {
-  route_map_result_t ret = RMAP_NOMATCH;
+  route_map_result_t ret = RMAP_MATCH;
   struct route_map_rule *match;
-
+  u_int64_t bit;
+  int memoised = 0;
 
   /* Check all match rule and if there is no match rule, go to the
      set statement. */
   if (!match_list->head)
-    ret = RMAP_MATCH;
-  else
+    return RMAP_MATCH;
+
+  /* Object rules are evaluated once per object, the rest per prefix. */
+  if (memo && pos < RMAP_MEMO_INDEXES)
     {
-      for (match = match_list->head; match; match = match->next)
+      bit = (u_int64_t) 1 << pos;
+      if (! (memo->known & bit))
         {
-          /* Try each match statement in turn, If any do not return
-             RMAP_MATCH, return, otherwise continue on to next match 
-             statement. All match statements must match for end-result
-             to be a match. */
-          ret = (*match->cmd->func_apply) (match->value, prefix,
-                                           type, object);
-          if (ret != RMAP_MATCH)
-            return ret;
+          for (match = match_list->head; match; match = match->next)
+            if (CHECK_FLAG (match->cmd->flags, RMAP_RULE_OBJECT))
+              {
+                ret = (*match->cmd->func_apply) (match->value, prefix,
+                                                 type, object);
+                if (ret != RMAP_MATCH)
+                  break;
+              }
+          memo->known |= bit;
+          if (ret == RMAP_MATCH)
+            memo->match |= bit;
         }
+      if (! (memo->match & bit))
+        return RMAP_NOMATCH;
+      memoised = 1;
+    }
+
+  for (match = match_list->head; match; match = match->next)
+    {
+      if (memoised && CHECK_FLAG (match->cmd->flags, RMAP_RULE_OBJECT))
+        continue;
+
+      /* Try each match statement in turn, If any do not return
+         RMAP_MATCH, return, otherwise continue on to next match 
+         statement. All match statements must match for end-result
+         to be a match. */
+      ret = (*match->cmd->func_apply) (match->value, prefix,
+                                       type, object);
+      if (ret != RMAP_MATCH)
+        return ret;
     }
-  return ret;
+  return RMAP_MATCH;
 }
 
-/* Apply route map to the object. */
-route_map_result_t
-route_map_apply (struct route_map *map, struct prefix *prefix,
-                 route_map_object_t type, void *object)
+static route_map_result_t
+route_map_apply_internal (struct route_map *map, struct prefix *prefix,
+                          route_map_object_t type, void *object,
+                          struct route_map_memo *memo)
 {
   static int recursion = 0;
   int ret = 0;
+  int pos;
   struct route_map_index *index;
   struct route_map_rule *set;
 
@@ -791,10 +817,11 @@ route_map_apply (struct route_map *map, struct prefix *prefix,
   if (map == NULL)
     return RMAP_DENYMATCH;
 
-  for (index = map->head; index; index = index->next)
+  for (index = map->head, pos = 0; index; index = index->next, pos++)
     {
       /* Apply this index. */
-      ret = route_map_apply_match (&index->match_list, prefix, type, object);
+      ret = route_map_apply_match (&index->match_list, prefix, type, object,
+                                   memo, pos);
 
       /* Now we apply the matrix from above */
       if (ret == RMAP_NOMATCH)
@@ -810,6 +837,11 @@ route_map_apply (struct route_map *map, struct prefix *prefix,
                 ret = (*set->cmd->func_apply) (set->value, prefix,
                                                type, object);
 
+              /* The object may have changed, later matches can't use
+                 the memo any more. */
+              if (index->set_list.head)
+                memo = NULL;
+
               /* Call another route-map if available */
               if (index->nextrm)
                 {
@@ -819,7 +851,8 @@ route_map_apply (struct route_map *map, struct prefix *prefix,
                   if (nextrm) /* Target route-map found, jump to it */
                     {
                       recursion++;
-                      ret = route_map_apply (nextrm, prefix, type, object);
+                      ret = route_map_apply_internal (nextrm, prefix, type,
+                                                      object, NULL);
                       recursion--;
                     }
 
@@ -844,6 +877,7 @@ route_map_apply (struct route_map *map, struct prefix *prefix,
                         {
                           index = next;
                           next = next->next;
+                          pos++;
                         }
                       if (next == NULL)
                         {
@@ -864,6 +898,88 @@ route_map_apply (struct route_map *map, struct prefix *prefix,
   return RMAP_DENYMATCH;
 }
 
+/* Apply route map to the object. */
+route_map_result_t
+route_map_apply (struct route_map *map, struct prefix *prefix,
+                 route_map_object_t type, void *object)
+{
+  return route_map_apply_internal (map, prefix, type, object, NULL);
+}
+
+/* Apply route map to the object, skipping the object-only match rules
+   whose result MEMO already holds from an earlier prefix. */
+route_map_result_t
+route_map_apply_memo (struct route_map *map, struct prefix *prefix,
+                      route_map_object_t type, void *object,
+                      struct route_map_memo *memo)
+{
+  return route_map_apply_internal (map, prefix, type, object, memo);
+}
+
+static int
+route_map_object_only_internal (struct route_map *map, int recursion)
+{
+  struct route_map_index *index;
+  struct route_map_rule *match;
+  struct route_map *nextrm;
+
+  if (recursion > RMAP_RECURSION_LIMIT)
+    return 0;
+
+  for (index = map->head; index; index = index->next)
+    {
+      for (match = index->match_list.head; match; match = match->next)
+        if (! CHECK_FLAG (match->cmd->flags, RMAP_RULE_OBJECT))
+          return 0;
+
+      if (index->nextrm
+          && (nextrm = route_map_lookup_by_name (index->nextrm)) != NULL
+          && ! route_map_object_only_internal (nextrm, recursion + 1))
+        return 0;
+    }
+  return 1;
+}
+
+/* Whether MAP, and any map it calls, only matches on the object, so
+   gives the same result for every prefix applied with the same object. */
+int
+route_map_object_only (struct route_map *map)
+{
+  return route_map_object_only_internal (map, 1);
+}
+
+static int
+route_map_has_match_internal (struct route_map *map, const char *name,
+                              int recursion)
+{
+  struct route_map_index *index;
+  struct route_map_rule *match;
+  struct route_map *nextrm;
+
+  if (recursion > RMAP_RECURSION_LIMIT)
+    return 0;
+
+  for (index = map->head; index; index = index->next)
+    {
+      for (match = index->match_list.head; match; match = match->next)
+        if (strcmp (match->cmd->str, name) == 0)
+          return 1;
+
+      if (index->nextrm
+          && (nextrm = route_map_lookup_by_name (index->nextrm)) != NULL
+          && route_map_has_match_internal (nextrm, name, recursion + 1))
+        return 1;
+    }
+  return 0;
+}
+
+/* Whether MAP, or any map it calls, has a match rule called NAME. */
+int
+route_map_has_match (struct route_map *map, const char *name)
+{
+  return route_map_has_match_internal (map, name, 1);
+}
+
 void
 route_map_add_hook (void (*func) (const char *))
 {
@@ -90,8 +90,15 @@ struct route_map_rule_cmd
 
   /* Free allocated value by func_compile (). */
   void (*func_free)(void *);
+
+  /* RMAP_RULE_* flags, zero if nothing is known about the rule. */
+  u_char flags;
 };
 
+/* Match rule looks only at the object, never at the prefix, so its
+   result may be remembered for other prefixes sharing the object. */
+#define RMAP_RULE_OBJECT	0x01
+
 /* Route map apply error. */
 enum
 {
@@ -139,6 +146,18 @@ struct route_map_index
   struct route_map_index *prev;
 };
 
+/* Results of the RMAP_RULE_OBJECT match rules of the first
+   RMAP_MEMO_INDEXES indexes of a route map, for callers applying one map
+   to many prefixes sharing the same object.  The caller owns the memo
+   and must zero it whenever the object or the route map changes. */
+#define RMAP_MEMO_INDEXES	64
+
+struct route_map_memo
+{
+  u_int64_t known;
+  u_int64_t match;
+};
+
 /* Route map list structure. */
 struct route_map
 {
@@ -194,6 +213,17 @@ extern route_map_result_t route_map_apply (struct route_map *map,
                                            route_map_object_t object_type,
                                            void *object);
 
+/* Apply route map, reusing and filling MEMO. */
+extern route_map_result_t route_map_apply_memo (struct route_map *map,
+                                                struct prefix *,
+                                                route_map_object_t object_type,
+                                                void *object,
+                                                struct route_map_memo *memo);
+
+/* Whether MAP's result is independent of the prefix. */
+extern int route_map_object_only (struct route_map *map);
+extern int route_map_has_match (struct route_map *map, const char *name);
+
 extern void route_map_add_hook (void (*func) (const char *));
 extern void route_map_delete_hook (void (*func) (const char *));
 extern void route_map_event_hook (void (*func) (route_map_event_t, const char *));
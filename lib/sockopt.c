@@ -453,8 +453,8 @@ getsockopt_ipv4_ifindex (struct msghdr *msgh)
   
   pktinfo = 
     (struct in_pktinfo *)getsockopt_cmsg_data (msgh, IPPROTO_IP, IP_PKTINFO);
-  /* XXX Can pktinfo be NULL?  Clean up post 0.98. */
-  ifindex = pktinfo->ipi_ifindex;
+  /* None on a socket not set up for it. */
+  ifindex = pktinfo ? pktinfo->ipi_ifindex : 0;
   
 #elif defined(IP_RECVIF)
 
@@ -172,6 +172,59 @@ vty_out (struct vty *vty, const char *format, ...)
   return len;
 }
 
+/* Returns 1 when a long running show command should stop producing
+   output and let the client catch up.  Only vtys that are flushed from
+   the write thread can be resumed later, so files and the vtysh
+   itself never ask for that. */
+int
+vty_output_full (struct vty *vty)
+{
+  if (vty->type != VTY_TERM && vty->type != VTY_SHELL_SERV)
+    return 0;
+  return buffer_pending_exceeds (vty->obuf, VTY_OUTPUT_HIWAT);
+}
+
+/* Continue the output of the command just executed once the output
+   buffer has been flushed.  FUNC is called with ARG each time the
+   buffer drains and returns non-zero while it has more to say; it must
+   make progress on every call.  ARG_FREE, if set, releases ARG when the
+   output is finished or abandoned.  The command itself must return
+   CMD_SUCCESS after deferring. */
+void
+vty_output_defer (struct vty *vty, int (*func) (struct vty *, void *),
+		  void *arg, void (*arg_free) (void *))
+{
+  assert (vty->output_func == NULL);
+
+  vty->output_func = func;
+  vty->output_arg = arg;
+  vty->output_free = arg_free;
+}
+
+/* Drop any deferred output. */
+static void
+vty_output_cancel (struct vty *vty)
+{
+  if (vty->output_free)
+    (*vty->output_free) (vty->output_arg);
+  vty->output_func = NULL;
+  vty->output_arg = NULL;
+  vty->output_free = NULL;
+}
+
+/* Produce the next part of the deferred output.  Returns 1 while there
+   is more to come. */
+static int
+vty_output_resume (struct vty *vty)
+{
+  if (vty->output_func == NULL)
+    return 0;
+  if ((*vty->output_func) (vty, vty->output_arg))
+    return 1;
+  vty_output_cancel (vty);
+  return 0;
+}
+
 static int
 vty_log_out (struct vty *vty, const char *level, const char *proto_str,
 	     const char *format, struct timestamp_control *ctl, va_list va)
@@ -1378,7 +1431,7 @@ vty_execute (struct vty *vty)
   vty->cp = vty->length = 0;
   vty_clear_buf (vty);
 
-  if (vty->status != VTY_CLOSE )
+  if (vty->status != VTY_CLOSE && vty->output_func == NULL)
     vty_prompt (vty);
 
   return ret;
@@ -1420,43 +1473,43 @@ vty_escape_map (unsigned char c, struct vty *vty)
 static void
 vty_buffer_reset (struct vty *vty)
 {
+  vty_output_cancel (vty);
+  vty->held_len = 0;
   buffer_reset (vty->obuf);
   vty_prompt (vty);
   vty_redraw_line (vty);
 }
 
-/* Read data via vty socket. */
-static int
-vty_read (struct thread *thread)
+/* Keep input that arrived while output is deferred until the output
+   is done, see vty_input_release.  What does not fit is dropped. */
+static void
+vty_input_hold (struct vty *vty, unsigned char *buf, int nbytes)
 {
-  int i;
-  int nbytes;
-  unsigned char buf[VTY_READ_BUFSIZ];
+  if (vty->held == NULL)
+    vty->held = XMALLOC (MTYPE_VTY, VTY_READ_BUFSIZ);
+  if (nbytes > VTY_READ_BUFSIZ - vty->held_len)
+    nbytes = VTY_READ_BUFSIZ - vty->held_len;
+  memcpy (vty->held + vty->held_len, buf, nbytes);
+  vty->held_len += nbytes;
+}
 
-  int vty_sock = THREAD_FD (thread);
-  struct vty *vty = THREAD_ARG (thread);
-  vty->t_read = NULL;
+/* Act on the input in BUF. */
+static void
+vty_input (struct vty *vty, unsigned char *buf, int nbytes)
+{
+  int i;
 
-  /* Read raw data from socket */
-  if ((nbytes = read (vty->fd, buf, VTY_READ_BUFSIZ)) <= 0)
+  for (i = 0; i < nbytes; i++) 
     {
-      if (nbytes < 0)
+      /* Output still to come from an earlier command holds back what
+	 follows, bar the pager's keys. */
+      if (vty->output_func && vty->status != VTY_MORE
+	  && vty->status != VTY_CLOSE)
 	{
-	  if (ERRNO_IO_RETRY(errno))
-	    {
-	      vty_event (VTY_READ, vty_sock, vty);
-	      return 0;
-	    }
-	  vty->monitor = 0; /* disable monitoring to avoid infinite recursion */
-	  zlog_warn("%s: read error on vty client fd %d, closing: %s",
-		    __func__, vty->fd, safe_strerror(errno));
-          buffer_reset(vty->obuf);
+	  vty_input_hold (vty, buf + i, nbytes - i);
+	  break;
 	}
-      vty->status = VTY_CLOSE;
-    }
 
-  for (i = 0; i < nbytes; i++) 
-    {
       if (buf[i] == IAC)
 	{
 	  if (!vty->iac)
@@ -1608,6 +1661,10 @@ vty_read (struct thread *thread)
 	case '\r':
 	  vty_out (vty, "%s", VTY_NEWLINE);
 	  vty_execute (vty);
+	  /* Don't hold the LF of a CR LF for a line of its own. */
+	  if (vty->output_func && buf[i] == '\r'
+	      && i + 1 < nbytes && buf[i + 1] == '\n')
+	    i++;
 	  break;
 	case '\t':
 	  vty_complete_command (vty);
@@ -1633,6 +1690,51 @@ vty_read (struct thread *thread)
 	  break;
 	}
     }
+}
+
+/* Act on the input held back, once the output it waited for is
+   done. */
+static void
+vty_input_release (struct vty *vty)
+{
+  unsigned char buf[VTY_READ_BUFSIZ];
+  int nbytes = vty->held_len;
+
+  memcpy (buf, vty->held, nbytes);
+  vty->held_len = 0;
+  vty_input (vty, buf, nbytes);
+}
+
+/* Read data via vty socket. */
+static int
+vty_read (struct thread *thread)
+{
+  int nbytes;
+  unsigned char buf[VTY_READ_BUFSIZ];
+
+  int vty_sock = THREAD_FD (thread);
+  struct vty *vty = THREAD_ARG (thread);
+  vty->t_read = NULL;
+
+  /* Read raw data from socket */
+  if ((nbytes = read (vty->fd, buf, VTY_READ_BUFSIZ)) <= 0)
+    {
+      if (nbytes < 0)
+	{
+	  if (ERRNO_IO_RETRY(errno))
+	    {
+	      vty_event (VTY_READ, vty_sock, vty);
+	      return 0;
+	    }
+	  vty->monitor = 0; /* disable monitoring to avoid infinite recursion */
+	  zlog_warn("%s: read error on vty client fd %d, closing: %s",
+		    __func__, vty->fd, safe_strerror(errno));
+          buffer_reset(vty->obuf);
+	}
+      vty->status = VTY_CLOSE;
+    }
+  else
+    vty_input (vty, buf, nbytes);
 
   /* Check status. */
   if (vty->status == VTY_CLOSE)
@@ -1640,7 +1742,10 @@ vty_read (struct thread *thread)
   else
     {
       vty_event (VTY_WRITE, vty->wfd, vty);
-      vty_event (VTY_READ, vty_sock, vty);
+      /* With input held back, read on only for the pager, vty_flush
+	 starts reading again once the output is done. */
+      if (vty->held_len == 0 || vty->status == VTY_MORE)
+	vty_event (VTY_READ, vty_sock, vty);
     }
   return 0;
 }
@@ -1689,6 +1794,26 @@ vty_flush (struct thread *thread)
     case BUFFER_EMPTY:
       if (vty->status == VTY_CLOSE)
 	vty_close (vty);
+      else if (vty->output_func)
+	{
+	  /* Carry on with the deferred output, the prompt and any input
+	     held back follow the last of it. */
+	  vty->status = VTY_NORMAL;
+	  if (! vty_output_resume (vty))
+	    {
+	      vty_prompt (vty);
+	      if (vty->held_len)
+		vty_input_release (vty);
+	      if (vty->status == VTY_CLOSE)
+		{
+		  vty_close (vty);
+		  return 0;
+		}
+	      if (vty->held_len == 0 && vty->t_read == NULL)
+		vty_event (VTY_READ, vty_sock, vty);
+	    }
+	  vty_event (VTY_WRITE, vty_sock, vty);
+	}
       else
 	{
 	  vty->status = VTY_NORMAL;
@@ -1701,6 +1826,9 @@ vty_flush (struct thread *thread)
       vty->status = VTY_MORE;
       if (vty->lines == 0)
 	vty_event (VTY_WRITE, vty_sock, vty);
+      else if (vty->t_read == NULL)
+	/* The pager needs a key even with input held back. */
+	vty_event (VTY_READ, vty_sock, vty);
       break;
     }
 
@@ -2210,21 +2338,76 @@ vtysh_flush(struct vty *vty)
       return -1;
       break;
     case BUFFER_EMPTY:
+      if (vty->output_func)
+	vty_event(VTYSH_WRITE, vty->wfd, vty);
       break;
     }
   return 0;
 }
 
+/* Act on the command lines in BUF, holding back those that follow a
+   command whose output is deferred.  Returns -1 if the vty was closed. */
 static int
-vtysh_read (struct thread *thread)
+vtysh_input (struct vty *vty, unsigned char *buf, int nbytes)
 {
   int ret;
+  unsigned char *p;
+  u_char header[4] = {0, 0, 0, 0};
+
+  if (vty->length + nbytes >= vty->max)
+    {
+      /* Clear command line buffer. */
+      vty->cp = vty->length = 0;
+      vty_clear_buf (vty);
+      vty_out (vty, "%% Command is too long.%s", VTY_NEWLINE);
+      return 0;
+    }
+  
+  for (p = buf; p < buf+nbytes; p++)
+    {
+      if (vty->output_func)
+	{
+	  vty_input_hold (vty, p, buf + nbytes - p);
+	  break;
+	}
+
+      vty->buf[vty->length++] = *p;
+      if (*p == '\0')
+	{
+	  /* Pass this line to parser. */
+	  ret = vty_execute (vty);
+	  /* Note that vty_execute clears the command buffer and resets
+	     vty->length to 0. */
+
+	  /* Return result. */
+#ifdef VTYSH_DEBUG
+	  printf ("result: %d\n", ret);
+	  printf ("vtysh node: %d\n", vty->node);
+#endif /* VTYSH_DEBUG */
+
+	  /* The result follows the output, which may not all be there
+	     yet. */
+	  if (vty->output_func == NULL)
+	    {
+	      header[3] = ret;
+	      buffer_put(vty->obuf, header, 4);
+	    }
+
+	  if (!vty->t_write && (vtysh_flush(vty) < 0))
+	    /* Try to flush results; exit if a write error occurs. */
+	    return -1;
+	}
+    }
+  return 0;
+}
+
+static int
+vtysh_read (struct thread *thread)
+{
   int sock;
   int nbytes;
   struct vty *vty;
   unsigned char buf[VTY_READ_BUFSIZ];
-  unsigned char *p;
-  u_char header[4] = {0, 0, 0, 0};
 
   sock = THREAD_FD (thread);
   vty = THREAD_ARG (thread);
@@ -2255,43 +2438,12 @@ vtysh_read (struct thread *thread)
   printf ("line: %.*s\n", nbytes, buf);
 #endif /* VTYSH_DEBUG */
 
-  if (vty->length + nbytes >= vty->max)
-    {
-      /* Clear command line buffer. */
-      vty->cp = vty->length = 0;
-      vty_clear_buf (vty);
-      vty_out (vty, "%% Command is too long.%s", VTY_NEWLINE);
-      goto out;
-    }
-  
-  for (p = buf; p < buf+nbytes; p++)
-    {
-      vty->buf[vty->length++] = *p;
-      if (*p == '\0')
-	{
-	  
-	  /* Pass this line to parser. */
-	  ret = vty_execute (vty);
-	  /* Note that vty_execute clears the command buffer and resets
-	     vty->length to 0. */
-
-	  /* Return result. */
-#ifdef VTYSH_DEBUG
-	  printf ("result: %d\n", ret);
-	  printf ("vtysh node: %d\n", vty->node);
-#endif /* VTYSH_DEBUG */
-
-	  header[3] = ret;
-	  buffer_put(vty->obuf, header, 4);
-
-	  if (!vty->t_write && (vtysh_flush(vty) < 0))
-	    /* Try to flush results; exit if a write error occurs. */
-	    return 0;
-	}
-    }
+  if (vtysh_input (vty, buf, nbytes) < 0)
+    return 0;
 
-out:
-  vty_event (VTYSH_READ, sock, vty);
+  /* Held input waits for vtysh_write to read on. */
+  if (vty->held_len == 0)
+    vty_event (VTYSH_READ, sock, vty);
 
   return 0;
 }
@@ -2300,9 +2452,33 @@ static int
 vtysh_write (struct thread *thread)
 {
   struct vty *vty = THREAD_ARG (thread);
+  unsigned char buf[VTY_READ_BUFSIZ];
+  int nbytes;
 
   vty->t_write = NULL;
-  vtysh_flush(vty);
+
+  /* Deferred output is continued only once the last of it has gone,
+     then comes the result and any input held back. */
+  if (vty->output_func && buffer_empty (vty->obuf)
+      && ! vty_output_resume (vty))
+    {
+      u_char header[4] = {0, 0, 0, CMD_SUCCESS};
+
+      buffer_put(vty->obuf, header, 4);
+
+      if (vty->held_len)
+	{
+	  nbytes = vty->held_len;
+	  memcpy (buf, vty->held, nbytes);
+	  vty->held_len = 0;
+	  if (vtysh_input (vty, buf, nbytes) < 0)
+	    return 0;
+	}
+      if (vty->held_len == 0 && vty->t_read == NULL)
+	vty_event (VTYSH_READ, vty->fd, vty);
+    }
+  if (! vty->t_write)
+    vtysh_flush(vty);
   return 0;
 }
 
@@ -2345,6 +2521,9 @@ vty_close (struct vty *vty)
   if (vty->t_timeout)
     thread_cancel (vty->t_timeout);
 
+  /* Abandon any output still to come. */
+  vty_output_cancel (vty);
+
   /* Flush buffer. */
   buffer_flush_all (vty->obuf, vty->wfd);
 
@@ -2367,6 +2546,8 @@ vty_close (struct vty *vty)
 
   if (vty->buf)
     XFREE (MTYPE_VTY, vty->buf);
+  if (vty->held)
+    XFREE (MTYPE_VTY, vty->held);
 
   /* Check configure. */
   vty_config_unlock (vty);
@@ -121,6 +121,15 @@ struct vty
 
   /* What address is this vty comming from. */
   char address[SU_ADDRSTRLEN];
+
+  /* Deferred command output, see vty_output_defer(). */
+  int (*output_func) (struct vty *, void *);
+  void *output_arg;
+  void (*output_free) (void *);
+
+  /* Input held back until the deferred output is done. */
+  unsigned char *held;
+  int held_len;
 };
 
 /* Integrated configuration file. */
@@ -135,6 +144,10 @@ struct vty
 /* Vty read buffer size. */
 #define VTY_READ_BUFSIZ 512
 
+/* Amount of unflushed output above which long running show commands
+   should stop and continue once the client has caught up. */
+#define VTY_OUTPUT_HIWAT (64 * 1024)
+
 /* Directory separator. */
 #ifndef DIRECTORY_SEP
 #define DIRECTORY_SEP '/'
@@ -238,6 +251,9 @@ extern void vty_reset (void);
 extern struct vty *vty_new (void);
 extern struct vty *vty_stdio (void (*atclose)(void));
 extern int vty_out (struct vty *, const char *, ...) PRINTF_ATTRIBUTE(2, 3);
+extern int vty_output_full (struct vty *);
+extern void vty_output_defer (struct vty *, int (*)(struct vty *, void *),
+			      void *, void (*)(void *));
 extern void vty_read_config (char *, char *);
 extern void vty_time_print (struct vty *, int);
 extern void vty_serv_sock (const char *, unsigned short, const char *);
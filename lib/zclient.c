@@ -355,7 +355,7 @@ zebra_message_send (struct zclient *zclient, int command, vrf_id_t vrf_id)
   return zclient_send_message(zclient);
 }
 
-static int
+int
 zebra_hello_send (struct zclient *zclient)
 {
   struct stream *s;
@@ -368,6 +368,8 @@ zebra_hello_send (struct zclient *zclient)
       /* The VRF ID in the HELLO message is always 0. */
       zclient_create_header (s, ZEBRA_HELLO, VRF_DEFAULT);
       stream_putc (s, zclient->redist_default);
+      if (zclient->stale_time)
+	stream_putw (s, zclient->stale_time);
       stream_putw_at (s, 0, stream_get_endp (s));
       return zclient_send_message(zclient);
     }
@@ -375,6 +377,16 @@ zebra_hello_send (struct zclient *zclient)
   return 0;
 }
 
+/* Tell zebra we have sent all our routes again, after coming back with
+   our routes kept for us, and what we did not send again can go. */
+int
+zebra_stale_sweep_send (struct zclient *zclient)
+{
+  if (zclient->sock < 0)
+    return -1;
+  return zebra_message_send (zclient, ZEBRA_STALE_SWEEP, VRF_DEFAULT);
+}
+
 /* Send requests to zebra daemon for the information in a VRF. */
 void
 zclient_send_requests (struct zclient *zclient, vrf_id_t vrf_id)
@@ -1191,6 +1203,10 @@ zclient_read (struct thread *thread)
       if (zclient->nexthop_update)
 	(*zclient->nexthop_update) (command, zclient, length, vrf_id);
       break;
+    case ZEBRA_STALE_KEPT:
+      if (zclient->stale_kept)
+	(*zclient->stale_kept) (command, zclient, length, vrf_id);
+      break;
     default:
       break;
     }
@@ -71,6 +71,11 @@ struct zclient
 
   /* Redistribute information. */
   u_char redist_default;
+
+  /* Seconds zebra is to keep our routes, marked stale, should we go
+     away, for us to send them again when we are back.  0 to have them
+     removed there and then. */
+  u_int16_t stale_time;
   vrf_bitmap_t redist[ZEBRA_ROUTE_MAX];
 
   /* Redistribute defauilt. */
@@ -91,6 +96,7 @@ struct zclient
   int (*ipv6_route_add) (int, struct zclient *, uint16_t, vrf_id_t);
   int (*ipv6_route_delete) (int, struct zclient *, uint16_t, vrf_id_t);
   int (*nexthop_update) (int, struct zclient *, uint16_t, vrf_id_t);
+  int (*stale_kept) (int, struct zclient *, uint16_t, vrf_id_t);
 };
 
 /* Zebra API message flag. */
@@ -156,6 +162,12 @@ extern const char *zclient_serv_path_get (void);
 
 extern void zclient_send_requests (struct zclient *, vrf_id_t);
 
+/* Send hello, saying what routes we send and how long to keep them. */
+extern int zebra_hello_send (struct zclient *);
+
+/* Have zebra remove what routes it kept for us we did not send again. */
+extern int zebra_stale_sweep_send (struct zclient *);
+
 /* Send redistribute command to zebra daemon. Do not update zclient state. */
 extern int zebra_redistribute_send (int command, struct zclient *, int type,
     vrf_id_t vrf_id);
@@ -429,7 +429,9 @@ struct in_pktinfo
 #define ZEBRA_NEXTHOP_REGISTER            27
 #define ZEBRA_NEXTHOP_UNREGISTER          28
 #define ZEBRA_NEXTHOP_UPDATE              29
-#define ZEBRA_MESSAGE_MAX                 30
+#define ZEBRA_STALE_SWEEP                 30
+#define ZEBRA_STALE_KEPT                  31
+#define ZEBRA_MESSAGE_MAX                 32
 
 /* Marker value used in new Zserv, in the byte location corresponding
  * the command value in the old zserv header. To allow old and new
@@ -1459,40 +1459,82 @@ static u_char *recvbuf = NULL;
 static u_char *sendbuf = NULL;
 static unsigned int iobuflen = 0;
 
+/* Packets ospf6_send has queued, in buffers of iobuflen each, to go
+   out together once the current thread is done or the queue full. */
+static u_char *sendqbuf = NULL;
+static struct ospf6_msg sendq[OSPF6_WRITE_BATCH];
+static int sendq_count = 0;
+static struct thread *t_sendq = NULL;
+
+static void
+ospf6_send_flush (void)
+{
+  if (sendq_count == 0)
+    return;
+
+  if (ospf6_sendmmsg (sendq, sendq_count) != sendq_count)
+    zlog_err ("Could not send entire message");
+  sendq_count = 0;
+}
+
+static int
+ospf6_send_event (struct thread *thread)
+{
+  t_sendq = NULL;
+  ospf6_send_flush ();
+  return 0;
+}
+
 int
 ospf6_iobuf_size (unsigned int size)
 {
-  u_char *recvnew, *sendnew;
+  u_char *recvnew, *sendnew, *sendqnew;
+  int i;
 
   if (size <= iobuflen)
     return iobuflen;
 
-  recvnew = XMALLOC (MTYPE_OSPF6_MESSAGE, size);
+  recvnew = XMALLOC (MTYPE_OSPF6_MESSAGE, size * OSPF6_READ_BATCH);
   sendnew = XMALLOC (MTYPE_OSPF6_MESSAGE, size);
-  if (recvnew == NULL || sendnew == NULL)
+  sendqnew = XMALLOC (MTYPE_OSPF6_MESSAGE, size * OSPF6_WRITE_BATCH);
+  if (recvnew == NULL || sendnew == NULL || sendqnew == NULL)
     {
       if (recvnew)
         XFREE (MTYPE_OSPF6_MESSAGE, recvnew);
       if (sendnew)
         XFREE (MTYPE_OSPF6_MESSAGE, sendnew);
+      if (sendqnew)
+        XFREE (MTYPE_OSPF6_MESSAGE, sendqnew);
       zlog_debug ("Could not allocate I/O buffer of size %d.", size);
       return iobuflen;
     }
 
+  /* Queued packets live in the buffers about to go. */
+  ospf6_send_flush ();
+
   if (recvbuf)
     XFREE (MTYPE_OSPF6_MESSAGE, recvbuf);
   if (sendbuf)
     XFREE (MTYPE_OSPF6_MESSAGE, sendbuf);
+  if (sendqbuf)
+    XFREE (MTYPE_OSPF6_MESSAGE, sendqbuf);
   recvbuf = recvnew;
   sendbuf = sendnew;
+  sendqbuf = sendqnew;
   iobuflen = size;
 
+  for (i = 0; i < OSPF6_WRITE_BATCH; i++)
+    sendq[i].buf = sendqbuf + i * iobuflen;
+
   return iobuflen;
 }
 
 void
 ospf6_message_terminate (void)
 {
+  ospf6_send_flush ();
+  THREAD_OFF (t_sendq);
+
   if (recvbuf)
     {
       XFREE (MTYPE_OSPF6_MESSAGE, recvbuf);
@@ -1505,60 +1547,42 @@ ospf6_message_terminate (void)
       sendbuf = NULL;
     }
 
+  if (sendqbuf)
+    {
+      XFREE (MTYPE_OSPF6_MESSAGE, sendqbuf);
+      sendqbuf = NULL;
+    }
+
   iobuflen = 0;
 }
 
-int
-ospf6_receive (struct thread *thread)
+/* Process a packet as read by ospf6_recvmmsg. */
+static void
+ospf6_receive_packet (struct ospf6_msg *msg)
 {
-  int sockfd;
-  unsigned int len;
   char srcname[64], dstname[64];
-  struct in6_addr src, dst;
-  ifindex_t ifindex;
-  struct iovec iovector[2];
+  struct in6_addr *src = &msg->src, *dst = &msg->dst;
+  unsigned int len = msg->len;
   struct ospf6_interface *oi;
   struct ospf6_header *oh;
 
-  /* add next read thread */
-  sockfd = THREAD_FD (thread);
-  thread_add_read (master, ospf6_receive, NULL, sockfd);
-
-  /* initialize */
-  memset (&src, 0, sizeof (src));
-  memset (&dst, 0, sizeof (dst));
-  ifindex = 0;
-  memset (recvbuf, 0, iobuflen);
-  iovector[0].iov_base = recvbuf;
-  iovector[0].iov_len = iobuflen;
-  iovector[1].iov_base = NULL;
-  iovector[1].iov_len = 0;
-
-  /* receive message */
-  len = ospf6_recvmsg (&src, &dst, &ifindex, iovector);
-  if (len > iobuflen)
-    {
-      zlog_err ("Excess message read");
-      return 0;
-    }
-
-  oi = ospf6_interface_lookup_by_ifindex (ifindex);
+  oi = ospf6_interface_lookup_by_ifindex (msg->ifindex);
   if (oi == NULL || oi->area == NULL || CHECK_FLAG(oi->flag, OSPF6_INTERFACE_DISABLE))
     {
       zlog_debug ("Message received on disabled interface");
-      return 0;
+      return;
     }
   if (CHECK_FLAG (oi->flag, OSPF6_INTERFACE_PASSIVE))
     {
       if (IS_OSPF6_DEBUG_MESSAGE (OSPF6_MESSAGE_TYPE_UNKNOWN, RECV))
         zlog_debug ("%s: Ignore message on passive interface %s",
                     __func__, oi->interface->name);
-      return 0;
+      return;
     }
 
-  oh = (struct ospf6_header *) recvbuf;
+  oh = (struct ospf6_header *) msg->buf;
   if (ospf6_rxpacket_examin (oi, oh, len) != MSG_OK)
-    return 0;
+    return;
 
   /* Being here means, that no sizing/alignment issues were detected in
      the input packet. This renders the additional checks performed below
@@ -1568,8 +1592,8 @@ ospf6_receive (struct thread *thread)
   /* Log */
   if (IS_OSPF6_DEBUG_MESSAGE (oh->type, RECV))
     {
-      inet_ntop (AF_INET6, &src, srcname, sizeof (srcname));
-      inet_ntop (AF_INET6, &dst, dstname, sizeof (dstname));
+      inet_ntop (AF_INET6, src, srcname, sizeof (srcname));
+      inet_ntop (AF_INET6, dst, dstname, sizeof (dstname));
       zlog_debug ("%s received on %s",
                  LOOKUP (ospf6_message_type_str, oh->type), oi->interface->name);
       zlog_debug ("    src: %s", srcname);
@@ -1600,28 +1624,60 @@ ospf6_receive (struct thread *thread)
   switch (oh->type)
     {
       case OSPF6_MESSAGE_TYPE_HELLO:
-        ospf6_hello_recv (&src, &dst, oi, oh);
+        ospf6_hello_recv (src, dst, oi, oh);
         break;
 
       case OSPF6_MESSAGE_TYPE_DBDESC:
-        ospf6_dbdesc_recv (&src, &dst, oi, oh);
+        ospf6_dbdesc_recv (src, dst, oi, oh);
         break;
 
       case OSPF6_MESSAGE_TYPE_LSREQ:
-        ospf6_lsreq_recv (&src, &dst, oi, oh);
+        ospf6_lsreq_recv (src, dst, oi, oh);
         break;
 
       case OSPF6_MESSAGE_TYPE_LSUPDATE:
-        ospf6_lsupdate_recv (&src, &dst, oi, oh);
+        ospf6_lsupdate_recv (src, dst, oi, oh);
         break;
 
       case OSPF6_MESSAGE_TYPE_LSACK:
-        ospf6_lsack_recv (&src, &dst, oi, oh);
+        ospf6_lsack_recv (src, dst, oi, oh);
         break;
 
       default:
         assert (0);
     }
+}
+
+int
+ospf6_receive (struct thread *thread)
+{
+  int sockfd;
+  struct ospf6_msg msgs[OSPF6_READ_BATCH];
+  int budget;
+  int count;
+  int i;
+
+  /* add next read thread */
+  sockfd = THREAD_FD (thread);
+  thread_add_read (master, ospf6_receive, NULL, sockfd);
+
+  /* Read what is waiting in batches, until the budget for one wakeup
+     is spent or the socket is drained. */
+  for (budget = OSPF6_READ_BUDGET; budget > 0; budget -= count)
+    {
+      for (i = 0; i < OSPF6_READ_BATCH; i++)
+        {
+          msgs[i].buf = recvbuf + i * iobuflen;
+          msgs[i].len = iobuflen;
+        }
+
+      count = ospf6_recvmmsg (msgs, MIN (budget, OSPF6_READ_BATCH));
+      for (i = 0; i < count; i++)
+        ospf6_receive_packet (&msgs[i]);
+
+      if (count < OSPF6_READ_BATCH)
+        break;
+    }
 
   return 0;
 }
@@ -1630,15 +1686,8 @@ static void
 ospf6_send (struct in6_addr *src, struct in6_addr *dst,
             struct ospf6_interface *oi, struct ospf6_header *oh)
 {
-  unsigned int len;
   char srcname[64], dstname[64];
-  struct iovec iovector[2];
-
-  /* initialize */
-  iovector[0].iov_base = (caddr_t) oh;
-  iovector[0].iov_len = ntohs (oh->length);
-  iovector[1].iov_base = NULL;
-  iovector[1].iov_len = 0;
+  struct ospf6_msg *msg;
 
   /* fill OSPF header */
   oh->version = OSPFV3_VERSION;
@@ -1687,10 +1736,21 @@ ospf6_send (struct in6_addr *src, struct in6_addr *dst,
         }
     }
 
-  /* send message */
-  len = ospf6_sendmsg (src, dst, &oi->interface->ifindex, iovector);
-  if (len != ntohs (oh->length))
-    zlog_err ("Could not send entire message");
+  /* queue message, to be sent with any others queued by this thread */
+  msg = &sendq[sendq_count++];
+  if (src)
+    memcpy (&msg->src, src, sizeof (struct in6_addr));
+  else
+    memset (&msg->src, 0, sizeof (struct in6_addr));
+  memcpy (&msg->dst, dst, sizeof (struct in6_addr));
+  msg->ifindex = oi->interface->ifindex;
+  msg->len = ntohs (oh->length);
+  memcpy (msg->buf, oh, msg->len);
+
+  if (sendq_count == OSPF6_WRITE_BATCH)
+    ospf6_send_flush ();
+  else if (t_sendq == NULL)
+    t_sendq = thread_add_event (master, ospf6_send_event, NULL, 0);
 }
 
 static uint32_t
@@ -24,6 +24,18 @@
 
 #define OSPF6_MESSAGE_BUFSIZ  4096
 
+/* Packets read at a time, each into a buffer of its own, and at most
+   per wakeup of the read thread; without recvmmsg () a wakeup reads
+   one packet.  Packets queued to be sent together. */
+#ifdef HAVE_RECVMMSG
+#define OSPF6_READ_BATCH         8
+#define OSPF6_READ_BUDGET       64
+#else
+#define OSPF6_READ_BATCH         1
+#define OSPF6_READ_BUDGET        1
+#endif /* HAVE_RECVMMSG */
+#define OSPF6_WRITE_BATCH       16
+
 /* Debug option */
 extern unsigned char conf_debug_ospf6_message[];
 #define OSPF6_DEBUG_MESSAGE_SEND 0x01
@@ -25,6 +25,7 @@
 #include "memory.h"
 #include "sockunion.h"
 #include "sockopt.h"
+#include "network.h"
 #include "privs.h"
 
 #include "libospf.h"
@@ -152,39 +153,36 @@ iov_totallen (struct iovec *iov)
   return totallen;
 }
 
-int
-ospf6_sendmsg (struct in6_addr *src, struct in6_addr *dst,
-               ifindex_t *ifindex, struct iovec *message)
+/* Set up SMSGHDR to send MESSAGE to DST by IFINDEX from SRC, if given,
+   using the caller's storage for the address and control message. */
+static void
+ospf6_sendmsg_hdr (struct msghdr *smsghdr, struct sockaddr_in6 *dst_sin6,
+                   u_char *cmsgbuf, struct in6_addr *src,
+                   struct in6_addr *dst, ifindex_t ifindex,
+                   struct iovec *message, int iovlen)
 {
-  int retval;
-  struct msghdr smsghdr;
   struct cmsghdr *scmsgp;
-  u_char cmsgbuf[CMSG_SPACE(sizeof (struct in6_pktinfo))];
   struct in6_pktinfo *pktinfo;
-  struct sockaddr_in6 dst_sin6;
-
-  assert (dst);
-  assert (*ifindex);
 
   scmsgp = (struct cmsghdr *)cmsgbuf;
   pktinfo = (struct in6_pktinfo *)(CMSG_DATA(scmsgp));
-  memset (&dst_sin6, 0, sizeof (struct sockaddr_in6));
+  memset (dst_sin6, 0, sizeof (struct sockaddr_in6));
 
   /* source address */
-  pktinfo->ipi6_ifindex = *ifindex;
+  pktinfo->ipi6_ifindex = ifindex;
   if (src)
     memcpy (&pktinfo->ipi6_addr, src, sizeof (struct in6_addr));
   else
     memset (&pktinfo->ipi6_addr, 0, sizeof (struct in6_addr));
 
   /* destination address */
-  dst_sin6.sin6_family = AF_INET6;
+  dst_sin6->sin6_family = AF_INET6;
 #ifdef SIN6_LEN
-  dst_sin6.sin6_len = sizeof (struct sockaddr_in6);
+  dst_sin6->sin6_len = sizeof (struct sockaddr_in6);
 #endif /*SIN6_LEN*/
-  memcpy (&dst_sin6.sin6_addr, dst, sizeof (struct in6_addr));
+  memcpy (&dst_sin6->sin6_addr, dst, sizeof (struct in6_addr));
 #ifdef HAVE_SIN6_SCOPE_ID
-  dst_sin6.sin6_scope_id = *ifindex;
+  dst_sin6->sin6_scope_id = ifindex;
 #endif
 
   /* send control msg */
@@ -194,13 +192,29 @@ ospf6_sendmsg (struct in6_addr *src, struct in6_addr *dst,
   /* scmsgp = CMSG_NXTHDR (&smsghdr, scmsgp); */
 
   /* send msg hdr */
-  memset (&smsghdr, 0, sizeof (smsghdr));
-  smsghdr.msg_iov = message;
-  smsghdr.msg_iovlen = iov_count (message);
-  smsghdr.msg_name = (caddr_t) &dst_sin6;
-  smsghdr.msg_namelen = sizeof (struct sockaddr_in6);
-  smsghdr.msg_control = (caddr_t) cmsgbuf;
-  smsghdr.msg_controllen = scmsgp->cmsg_len;
+  memset (smsghdr, 0, sizeof (struct msghdr));
+  smsghdr->msg_iov = message;
+  smsghdr->msg_iovlen = iovlen;
+  smsghdr->msg_name = (caddr_t) dst_sin6;
+  smsghdr->msg_namelen = sizeof (struct sockaddr_in6);
+  smsghdr->msg_control = (caddr_t) cmsgbuf;
+  smsghdr->msg_controllen = scmsgp->cmsg_len;
+}
+
+int
+ospf6_sendmsg (struct in6_addr *src, struct in6_addr *dst,
+               ifindex_t *ifindex, struct iovec *message)
+{
+  int retval;
+  struct msghdr smsghdr;
+  u_char cmsgbuf[CMSG_SPACE(sizeof (struct in6_pktinfo))];
+  struct sockaddr_in6 dst_sin6;
+
+  assert (dst);
+  assert (*ifindex);
+
+  ospf6_sendmsg_hdr (&smsghdr, &dst_sin6, cmsgbuf, src, dst, *ifindex,
+                     message, iov_count (message));
 
   retval = sendmsg (ospf6_sock, &smsghdr, 0);
   if (retval != iov_totallen (message))
@@ -210,20 +224,93 @@ ospf6_sendmsg (struct in6_addr *src, struct in6_addr *dst,
   return retval;
 }
 
+/* Send COUNT packets, with as few system calls as the platform allows.
+   A packet the kernel refuses is logged and skipped, as by
+   ospf6_sendmsg.  Returns the number of packets sent whole. */
 int
-ospf6_recvmsg (struct in6_addr *src, struct in6_addr *dst,
-               ifindex_t *ifindex, struct iovec *message)
+ospf6_sendmmsg (struct ospf6_msg *msgs, int count)
+{
+  int i;
+  int sent = 0;
+  struct iovec iov[OSPF6_MSG_BATCH];
+#ifdef HAVE_SENDMMSG
+  struct mmsghdr smsghdr[OSPF6_MSG_BATCH];
+  u_char cmsgbuf[OSPF6_MSG_BATCH][CMSG_SPACE(sizeof (struct in6_pktinfo))];
+  struct sockaddr_in6 dst_sin6[OSPF6_MSG_BATCH];
+  int done, ret;
+#endif /* HAVE_SENDMMSG */
+
+  assert (count <= OSPF6_MSG_BATCH);
+
+  for (i = 0; i < count; i++)
+    {
+      assert (msgs[i].ifindex);
+      iov[i].iov_base = msgs[i].buf;
+      iov[i].iov_len = msgs[i].len;
+    }
+
+#ifdef HAVE_SENDMMSG
+  for (i = 0; i < count; i++)
+    {
+      ospf6_sendmsg_hdr (&smsghdr[i].msg_hdr, &dst_sin6[i], cmsgbuf[i],
+                         IN6_IS_ADDR_UNSPECIFIED (&msgs[i].src)
+                           ? NULL : &msgs[i].src,
+                         &msgs[i].dst, msgs[i].ifindex, &iov[i], 1);
+      smsghdr[i].msg_len = 0;
+    }
+
+  /* sendmmsg () stops at the first packet it fails to send, the error
+     then is that of the next call. */
+  for (done = 0; done < count; done += ret)
+    {
+      ret = sendmmsg (ospf6_sock, &smsghdr[done], count - done, 0);
+      if (ret < 0)
+        {
+          zlog_warn ("sendmsg failed: ifindex: %d: %s (%d)",
+                     msgs[done].ifindex, safe_strerror (errno), errno);
+          ret = 1;
+          continue;
+        }
+      for (i = done; i < done + ret; i++)
+        if (smsghdr[i].msg_len == msgs[i].len)
+          sent++;
+        else
+          zlog_warn ("sendmsg failed: ifindex: %d: sent %u of %u bytes",
+                     msgs[i].ifindex, smsghdr[i].msg_len, msgs[i].len);
+    }
+#else
+  for (i = 0; i < count; i++)
+    {
+      struct msghdr smsghdr;
+      u_char cmsgbuf[CMSG_SPACE(sizeof (struct in6_pktinfo))];
+      struct sockaddr_in6 dst_sin6;
+
+      ospf6_sendmsg_hdr (&smsghdr, &dst_sin6, cmsgbuf,
+                         IN6_IS_ADDR_UNSPECIFIED (&msgs[i].src)
+                           ? NULL : &msgs[i].src,
+                         &msgs[i].dst, msgs[i].ifindex, &iov[i], 1);
+      if (sendmsg (ospf6_sock, &smsghdr, 0) == (ssize_t) msgs[i].len)
+        sent++;
+      else
+        zlog_warn ("sendmsg failed: ifindex: %d: %s (%d)",
+                   msgs[i].ifindex, safe_strerror (errno), errno);
+    }
+#endif /* HAVE_SENDMMSG */
+
+  return sent;
+}
+
+/* Set up RMSGHDR to receive into MESSAGE, using the caller's storage
+   for the address and control message. */
+static void
+ospf6_recvmsg_hdr (struct msghdr *rmsghdr, struct sockaddr_in6 *src_sin6,
+                   u_char *cmsgbuf, size_t cmsglen,
+                   struct iovec *message, int iovlen)
 {
-  int retval;
-  struct msghdr rmsghdr;
   struct cmsghdr *rcmsgp;
-  u_char cmsgbuf[CMSG_SPACE(sizeof (struct in6_pktinfo))];
-  struct in6_pktinfo *pktinfo;
-  struct sockaddr_in6 src_sin6;
 
   rcmsgp = (struct cmsghdr *)cmsgbuf;
-  pktinfo = (struct in6_pktinfo *)(CMSG_DATA(rcmsgp));
-  memset (&src_sin6, 0, sizeof (struct sockaddr_in6));
+  memset (src_sin6, 0, sizeof (struct sockaddr_in6));
 
   /* receive control msg */
   rcmsgp->cmsg_level = IPPROTO_IPV6;
@@ -232,13 +319,28 @@ ospf6_recvmsg (struct in6_addr *src, struct in6_addr *dst,
   /* rcmsgp = CMSG_NXTHDR (&rmsghdr, rcmsgp); */
 
   /* receive msg hdr */
-  memset (&rmsghdr, 0, sizeof (rmsghdr));
-  rmsghdr.msg_iov = message;
-  rmsghdr.msg_iovlen = iov_count (message);
-  rmsghdr.msg_name = (caddr_t) &src_sin6;
-  rmsghdr.msg_namelen = sizeof (struct sockaddr_in6);
-  rmsghdr.msg_control = (caddr_t) cmsgbuf;
-  rmsghdr.msg_controllen = sizeof (cmsgbuf);
+  memset (rmsghdr, 0, sizeof (struct msghdr));
+  rmsghdr->msg_iov = message;
+  rmsghdr->msg_iovlen = iovlen;
+  rmsghdr->msg_name = (caddr_t) src_sin6;
+  rmsghdr->msg_namelen = sizeof (struct sockaddr_in6);
+  rmsghdr->msg_control = (caddr_t) cmsgbuf;
+  rmsghdr->msg_controllen = cmsglen;
+}
+
+int
+ospf6_recvmsg (struct in6_addr *src, struct in6_addr *dst,
+               ifindex_t *ifindex, struct iovec *message)
+{
+  int retval;
+  struct msghdr rmsghdr;
+  u_char cmsgbuf[CMSG_SPACE(sizeof (struct in6_pktinfo))];
+  struct in6_pktinfo *pktinfo;
+  struct sockaddr_in6 src_sin6;
+
+  pktinfo = (struct in6_pktinfo *)(CMSG_DATA((struct cmsghdr *)cmsgbuf));
+  ospf6_recvmsg_hdr (&rmsghdr, &src_sin6, cmsgbuf, sizeof (cmsgbuf),
+                     message, iov_count (message));
 
   retval = recvmsg (ospf6_sock, &rmsghdr, 0);
   if (retval < 0)
@@ -259,4 +361,73 @@ ospf6_recvmsg (struct in6_addr *src, struct in6_addr *dst,
   return retval;
 }
 
+/* Read up to COUNT packets waiting on the socket, each into the buffer
+   of its message, of LEN bytes; LEN is set to the length read.
+   Returns the number of packets read. */
+int
+ospf6_recvmmsg (struct ospf6_msg *msgs, int count)
+{
+#ifdef HAVE_RECVMMSG
+  int i;
+  int retval;
+  struct mmsghdr rmsghdr[OSPF6_MSG_BATCH];
+  struct iovec iov[OSPF6_MSG_BATCH];
+  u_char cmsgbuf[OSPF6_MSG_BATCH][CMSG_SPACE(sizeof (struct in6_pktinfo))];
+  struct sockaddr_in6 src_sin6[OSPF6_MSG_BATCH];
+  struct in6_pktinfo *pktinfo;
+
+  assert (count > 0 && count <= OSPF6_MSG_BATCH);
+
+  for (i = 0; i < count; i++)
+    {
+      iov[i].iov_base = msgs[i].buf;
+      iov[i].iov_len = msgs[i].len;
+      ospf6_recvmsg_hdr (&rmsghdr[i].msg_hdr, &src_sin6[i], cmsgbuf[i],
+                         sizeof (cmsgbuf[i]), &iov[i], 1);
+      rmsghdr[i].msg_len = 0;
+    }
 
+  /* The read thread found the socket readable, so only a spurious
+     wakeup finds nothing; later calls of a wakeup must not block. */
+  retval = recvmmsg (ospf6_sock, rmsghdr, count, MSG_DONTWAIT, NULL);
+  if (retval < 0)
+    {
+      if (!ERRNO_IO_RETRY (errno))
+        zlog_warn ("recvmmsg failed: %s", safe_strerror (errno));
+      return 0;
+    }
+
+  for (i = 0; i < retval; i++)
+    {
+      if (rmsghdr[i].msg_len == msgs[i].len)
+        zlog_warn ("recvmsg read full buffer size: %u", rmsghdr[i].msg_len);
+
+      pktinfo = (struct in6_pktinfo *)(CMSG_DATA((struct cmsghdr *)cmsgbuf[i]));
+      memcpy (&msgs[i].src, &src_sin6[i].sin6_addr, sizeof (struct in6_addr));
+      memcpy (&msgs[i].dst, &pktinfo->ipi6_addr, sizeof (struct in6_addr));
+      msgs[i].ifindex = pktinfo->ipi6_ifindex;
+      msgs[i].len = rmsghdr[i].msg_len;
+    }
+
+  return retval;
+#else
+  int retval;
+  struct iovec iovector[2];
+
+  assert (count > 0);
+
+  msgs[0].ifindex = 0;
+  iovector[0].iov_base = msgs[0].buf;
+  iovector[0].iov_len = msgs[0].len;
+  iovector[1].iov_base = NULL;
+  iovector[1].iov_len = 0;
+
+  retval = ospf6_recvmsg (&msgs[0].src, &msgs[0].dst, &msgs[0].ifindex,
+                          iovector);
+  if (retval < 0 || (unsigned int) retval > msgs[0].len)
+    return 0;
+
+  msgs[0].len = retval;
+  return 1;
+#endif /* HAVE_RECVMMSG */
+}
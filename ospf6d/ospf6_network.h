@@ -24,6 +24,19 @@
 
 
 
+/* Most packets ospf6_sendmmsg or ospf6_recvmmsg take at a time. */
+#define OSPF6_MSG_BATCH 16
+
+/* A packet to send with ospf6_sendmmsg, or as read by ospf6_recvmmsg. */
+struct ospf6_msg
+{
+  struct in6_addr src;		/* Unspecified lets the kernel choose. */
+  struct in6_addr dst;
+  ifindex_t ifindex;
+  u_char *buf;
+  unsigned int len;		/* To read, the size of buf. */
+};
+
 extern int ospf6_sock;
 extern struct in6_addr allspfrouters6;
 extern struct in6_addr alldrouters6;
@@ -35,6 +48,8 @@ extern int ospf6_sendmsg (struct in6_addr *, struct in6_addr *,
                           ifindex_t *, struct iovec *);
 extern int ospf6_recvmsg (struct in6_addr *, struct in6_addr *,
                           ifindex_t *, struct iovec *);
+extern int ospf6_sendmmsg (struct ospf6_msg *, int);
+extern int ospf6_recvmmsg (struct ospf6_msg *, int);
 
 #endif /* OSPF6_NETWORK_H */
 
@@ -49,6 +49,7 @@
 #include "ospfd/ospf_abr.h"
 #include "ospfd/ospf_ase.h"
 #include "ospfd/ospf_zebra.h"
+#include "ospfd/ospf_gr.h"
 #include "ospfd/ospf_dump.h"
 
 static struct ospf_area_range *
@@ -1812,6 +1813,10 @@ ospf_abr_task (struct ospf *ospf)
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("ospf_abr_task(): Start");
 
+  /* Restarting gracefully, summaries from before stay. */
+  if (OSPF_GR_IS_RESTARTING (ospf))
+    return;
+
   if (ospf->new_table == NULL || ospf->new_rtrs == NULL)
     {
       if (IS_DEBUG_OSPF_EVENT)
@@ -31,6 +31,7 @@
 #include "table.h"
 #include "vty.h"
 #include "log.h"
+#include "jhash.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_interface.h"
@@ -632,71 +633,463 @@ ospf_ase_compare_tables (struct route_table *new_external_route,
   return 0;
 }
 
+/* Make the AS-external routes to the destinations in prefixes, whose
+   info is the list of AS-external-LSAs to each, afresh and install the
+   changes.  Routes to other destinations stay as they are. */
+static unsigned long
+ospf_ase_update_prefixes (struct ospf *ospf, struct route_table *prefixes)
+{
+  struct route_node *rn, *old_rn, *new_rn;
+  struct route_table *tmp_old;
+  struct listnode *node;
+  struct ospf_lsa *lsa;
+  unsigned long count = 0;
+
+  for (rn = route_top (prefixes); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	for (ALL_LIST_ELEMENTS_RO ((struct list *) rn->info, node, lsa))
+	  ospf_ase_calculate_route (ospf, lsa);
+	count++;
+      }
+
+  /* prepare temporary old routing table for compare */
+  tmp_old = route_table_init ();
+  for (rn = route_top (prefixes); rn; rn = route_next (rn))
+    if (rn->info
+	&& (old_rn = route_node_lookup (ospf->old_external_route, &rn->p)))
+      {
+	route_node_get (tmp_old, &rn->p)->info = old_rn->info;
+	route_unlock_node (old_rn);
+      }
+
+  /* install changes to zebra */
+  ospf_ase_compare_tables (ospf->new_external_route, tmp_old);
+  route_table_finish (tmp_old);
+
+  /* update ospf->old_external_route table */
+  for (rn = route_top (prefixes); rn; rn = route_next (rn))
+    {
+      if (! rn->info)
+	continue;
+
+      if ((old_rn = route_node_lookup (ospf->old_external_route, &rn->p)))
+	{
+	  ospf_route_free (old_rn->info);
+	  old_rn->info = NULL;
+	  route_unlock_node (old_rn);
+	  route_unlock_node (old_rn);
+	}
+
+      /* the new route moves to ospf->old_external_route */
+      if ((new_rn = route_node_lookup (ospf->new_external_route, &rn->p)))
+	{
+	  route_node_get (ospf->old_external_route, &rn->p)->info
+	    = new_rn->info;
+	  new_rn->info = NULL;
+	  route_unlock_node (new_rn);
+	  route_unlock_node (new_rn);
+	}
+    }
+
+  return count;
+}
+
+/* Add the prefix to table, with the list of AS-external-LSAs to it as
+   info.  Return 1 if it was added, 0 if it was there already or no LSA
+   to it was ever seen. */
 static int
-ospf_ase_calculate_timer (struct thread *t)
+ospf_ase_prefix_add (struct ospf *ospf, struct route_table *table,
+		     struct prefix *p)
+{
+  struct route_node *rn, *lsas_rn;
+
+  lsas_rn = route_node_lookup (ospf->external_lsas, p);
+  if (! lsas_rn)
+    return 0;
+  route_unlock_node (lsas_rn);
+
+  rn = route_node_get (table, p);
+  if (rn->info)
+    {
+      route_unlock_node (rn);
+      return 0;
+    }
+  rn->info = lsas_rn->info;
+  return 1;
+}
+
+static void
+ospf_ase_lsa_prefix (struct ospf_lsa *lsa, struct prefix_ipv4 *p)
+{
+  struct as_external_lsa *al;
+
+  al = (struct as_external_lsa *) lsa->data;
+  p->family = AF_INET;
+  p->prefix = lsa->data->id;
+  p->prefixlen = ip_masklen (al->mask);
+  apply_mask_ipv4 (p);
+}
+
+static void
+ospf_ase_host_prefix (struct in_addr addr, struct prefix_ipv4 *p)
+{
+  memset (p, 0, sizeof (struct prefix_ipv4));
+  p->family = AF_INET;
+  p->prefix = addr;
+  p->prefixlen = IPV4_MAX_BITLEN;
+}
+
+/* Dependencies of AS-external-LSAs on the routes to their ASBRs and
+   forwarding addresses.  Each dependency keeps a copy of the route the
+   last calculation used, so a calculation after SPF need only redo the
+   destinations whose LSAs go over a route that has since changed. */
+
+static unsigned int
+ospf_ase_dep_lsa_key (void *lsa)
+{
+  return jhash (&lsa, sizeof (lsa), 0);
+}
+
+static int
+ospf_ase_dep_lsa_cmp (const void *lsa1, const void *lsa2)
+{
+  return lsa1 == lsa2;
+}
+
+static struct ospf_route *
+ospf_ase_route_dup (struct ospf_route *or)
+{
+  struct ospf_route *new;
+
+  if (or == NULL)
+    return NULL;
+
+  new = ospf_route_new ();
+  new->type = or->type;
+  new->path_type = or->path_type;
+  new->cost = or->cost;
+  new->u = or->u;
+  ospf_route_copy_nexthops (new, or->paths);
+
+  return new;
+}
+
+/* Would an external route over or1 be the same as one over or2? */
+static int
+ospf_ase_route_same (struct ospf_route *or1, struct ospf_route *or2)
+{
+  struct listnode *n1, *n2;
+  struct ospf_path *op1, *op2;
+
+  if (or1 == NULL || or2 == NULL)
+    return or1 == or2;
+
+  if (or1->path_type != or2->path_type
+      || or1->cost != or2->cost
+      || or1->u.std.flags != or2->u.std.flags
+      || ! IPV4_ADDR_SAME (&or1->u.std.area_id, &or2->u.std.area_id)
+      || listcount (or1->paths) != listcount (or2->paths))
+    return 0;
+
+  for (n1 = listhead (or1->paths), n2 = listhead (or2->paths);
+       n1 && n2; n1 = listnextnode (n1), n2 = listnextnode (n2))
+    {
+      op1 = listgetdata (n1);
+      op2 = listgetdata (n2);
+
+      if (! IPV4_ADDR_SAME (&op1->nexthop, &op2->nexthop)
+	  || op1->ifindex != op2->ifindex)
+	return 0;
+    }
+
+  return 1;
+}
+
+/* The route an AS-external-LSA from the ASBR, or with the forwarding
+   address, at p would be calculated over now, as in
+   ospf_ase_calculate_route(). */
+static struct ospf_route *
+ospf_ase_dep_route (struct ospf *ospf, struct prefix_ipv4 *p, int fwd)
+{
+  struct route_node *rn;
+  struct ospf_route *or;
+
+  if (! fwd)
+    return ospf_find_asbr_route (ospf, ospf->new_rtrs, p);
+
+  if (ospf->new_table == NULL
+      || ! ospf_ase_forward_address_check (ospf, p->prefix))
+    return NULL;
+
+  rn = route_node_match (ospf->new_table, (struct prefix *) p);
+  if (rn == NULL)
+    return NULL;
+  or = rn->info;
+  route_unlock_node (rn);
+
+  return or;
+}
+
+static void
+ospf_ase_dep_free (struct ospf_ase_dep *dep)
+{
+  hash_clean (dep->lsas, NULL);
+  hash_free (dep->lsas);
+  if (dep->route)
+    ospf_route_free (dep->route);
+  XFREE (MTYPE_OSPF_EXTERNAL_DEP, dep);
+}
+
+static void
+ospf_ase_dep_add (struct ospf *ospf, struct route_table *deps, int fwd,
+		  struct in_addr addr, struct ospf_lsa *lsa)
+{
+  struct route_node *rn;
+  struct ospf_ase_dep *dep;
+  struct prefix_ipv4 p;
+
+  ospf_ase_host_prefix (addr, &p);
+  rn = route_node_get (deps, (struct prefix *) &p);
+  if ((dep = rn->info) != NULL)
+    route_unlock_node (rn);
+  else
+    {
+      /* New LSAs are calculated over the route as it is now. */
+      dep = XCALLOC (MTYPE_OSPF_EXTERNAL_DEP, sizeof (struct ospf_ase_dep));
+      dep->lsas = hash_create_size (8, ospf_ase_dep_lsa_key,
+				    ospf_ase_dep_lsa_cmp);
+      dep->route = ospf_ase_route_dup (ospf_ase_dep_route (ospf, &p, fwd));
+      rn->info = dep;
+    }
+
+  hash_get (dep->lsas, lsa, hash_alloc_intern);
+}
+
+/* An emptied dependency stays until the next calculation, as the LSA
+   replacing one is often registered after the old one goes. */
+static void
+ospf_ase_dep_delete (struct route_table *deps, struct in_addr addr,
+		     struct ospf_lsa *lsa)
+{
+  struct route_node *rn;
+  struct prefix_ipv4 p;
+
+  ospf_ase_host_prefix (addr, &p);
+  rn = route_node_lookup (deps, (struct prefix *) &p);
+  if (rn)
+    {
+      hash_release (((struct ospf_ase_dep *) rn->info)->lsas, lsa);
+      route_unlock_node (rn);
+    }
+}
+
+struct ospf_ase_dirty
 {
   struct ospf *ospf;
+  struct route_table *prefixes;
+};
+
+static void
+ospf_ase_dep_dirty (struct hash_backet *backet, void *arg)
+{
+  struct ospf_ase_dirty *dirty = arg;
+  struct prefix_ipv4 p;
+
+  ospf_ase_lsa_prefix (backet->data, &p);
+  ospf_ase_prefix_add (dirty->ospf, dirty->prefixes, (struct prefix *) &p);
+}
+
+/* Bring the route of each dependency up to date, adding the
+   destinations of the LSAs over a route that changed to prefixes, and
+   drop the dependencies left without LSAs. */
+static void
+ospf_ase_deps_update (struct ospf *ospf, struct route_table *deps, int fwd,
+		      struct route_table *prefixes)
+{
+  struct route_node *rn;
+  struct ospf_ase_dep *dep;
+  struct ospf_route *or;
+  struct ospf_ase_dirty dirty = { ospf, prefixes };
+
+  for (rn = route_top (deps); rn; rn = route_next (rn))
+    if ((dep = rn->info) != NULL)
+      {
+	if (dep->lsas->count == 0)
+	  {
+	    ospf_ase_dep_free (dep);
+	    rn->info = NULL;
+	    route_unlock_node (rn);
+	    continue;
+	  }
+
+	or = ospf_ase_dep_route (ospf, (struct prefix_ipv4 *) &rn->p, fwd);
+	if (ospf_ase_route_same (dep->route, or))
+	  continue;
+
+	if (dep->route)
+	  ospf_route_free (dep->route);
+	dep->route = ospf_ase_route_dup (or);
+
+	if (prefixes)
+	  hash_iterate (dep->lsas, ospf_ase_dep_dirty, &dirty);
+      }
+}
+
+/* Bring ospf->external_internal up to date with the routing table,
+   adding the destinations an internal route now overrides, or no
+   longer does, to prefixes. */
+static void
+ospf_ase_internal_update (struct ospf *ospf, struct route_table *prefixes)
+{
+  struct route_node *rn, *int_rn;
+
+  for (rn = route_top (ospf->external_internal); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	if (ospf->new_table
+	    && (int_rn = route_node_lookup (ospf->new_table, &rn->p)))
+	  {
+	    route_unlock_node (int_rn);
+	    continue;
+	  }
+
+	if (prefixes)
+	  ospf_ase_prefix_add (ospf, prefixes, &rn->p);
+	rn->info = NULL;
+	route_unlock_node (rn);
+      }
+
+  if (ospf->new_table == NULL)
+    return;
+
+  for (rn = route_top (ospf->new_table); rn; rn = route_next (rn))
+    if (rn->info
+	&& ospf_ase_prefix_add (ospf, ospf->external_internal, &rn->p)
+	&& prefixes)
+      ospf_ase_prefix_add (ospf, prefixes, &rn->p);
+}
+
+/* Calculate all AS-external routes afresh. */
+static void
+ospf_ase_calculate_full (struct ospf *ospf)
+{
   struct ospf_lsa *lsa;
   struct route_node *rn;
   struct listnode *node;
   struct ospf_area *area;
+
+  /* Calculate external route for each AS-external-LSA */
+  LSDB_LOOP (EXTERNAL_LSDB (ospf), rn, lsa)
+    ospf_ase_calculate_route (ospf, lsa);
+
+  /*  This version simple adds to the table all NSSA areas  */
+  if (ospf->anyNSSA)
+    for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+      {
+	if (IS_DEBUG_OSPF_NSSA)
+	  zlog_debug ("ospf_ase_calculate_timer(): looking at area %s",
+		     inet_ntoa (area->area_id));
+
+	if (area->external_routing == OSPF_AREA_NSSA)
+	  LSDB_LOOP (NSSA_LSDB (area), rn, lsa)
+	    ospf_ase_calculate_route (ospf, lsa);
+      }
+  /* kevinm: And add the NSSA routes in ospf_top */
+  LSDB_LOOP (NSSA_LSDB (ospf),rn,lsa)
+	ospf_ase_calculate_route(ospf,lsa);
+
+  /* Compare old and new external routing table and install the
+     difference info zebra/kernel */
+  ospf_ase_compare_tables (ospf->new_external_route,
+			   ospf->old_external_route);
+
+  /* Delete old external routing table */
+  ospf_route_table_free (ospf->old_external_route);
+  ospf->old_external_route = ospf->new_external_route;
+  ospf->new_external_route = route_table_init ();
+
+  ospf_ase_deps_update (ospf, ospf->external_asbrs, 0, NULL);
+  ospf_ase_deps_update (ospf, ospf->external_fwds, 1, NULL);
+  ospf_ase_internal_update (ospf, NULL);
+}
+
+/* Calculate the AS-external routes after the routing table changed,
+   either all of them or, for OSPF_ASE_CALC_INCREMENTAL, only those to
+   destinations with an LSA over an ASBR or forwarding address route
+   that changed, or that an internal route began or ceased to
+   override. */
+void
+ospf_ase_calculate (struct ospf *ospf, int kind)
+{
+  struct route_table *prefixes;
   struct timeval start_time, stop_time;
+  unsigned long count;
 
-  ospf = THREAD_ARG (t);
-  ospf->t_ase_calc = NULL;
+  quagga_gettime(QUAGGA_CLK_MONOTONIC, &start_time);
 
-  if (ospf->ase_calc)
+  if (kind == OSPF_ASE_CALC_FULL)
     {
-      ospf->ase_calc = 0;
+      ospf_ase_calculate_full (ospf);
 
-      quagga_gettime(QUAGGA_CLK_MONOTONIC, &start_time);
-
-      /* Calculate external route for each AS-external-LSA */
-      LSDB_LOOP (EXTERNAL_LSDB (ospf), rn, lsa)
-	ospf_ase_calculate_route (ospf, lsa);
+      quagga_gettime(QUAGGA_CLK_MONOTONIC, &stop_time);
+      if (IS_DEBUG_OSPF_EVENT)
+	zlog_info ("SPF Processing Time(usecs): External Routes: %lld\n",
+		   (stop_time.tv_sec - start_time.tv_sec)*1000000LL+
+		   (stop_time.tv_usec - start_time.tv_usec));
+      return;
+    }
 
-      /*  This version simple adds to the table all NSSA areas  */
-      if (ospf->anyNSSA)
-	for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
-	  {
-	    if (IS_DEBUG_OSPF_NSSA)
-	      zlog_debug ("ospf_ase_calculate_timer(): looking at area %s",
-			 inet_ntoa (area->area_id));
+  prefixes = route_table_init ();
+  ospf_ase_deps_update (ospf, ospf->external_asbrs, 0, prefixes);
+  ospf_ase_deps_update (ospf, ospf->external_fwds, 1, prefixes);
+  ospf_ase_internal_update (ospf, prefixes);
+  count = ospf_ase_update_prefixes (ospf, prefixes);
+  route_table_finish (prefixes);
+
+  quagga_gettime(QUAGGA_CLK_MONOTONIC, &stop_time);
+  if (IS_DEBUG_OSPF_EVENT)
+    zlog_info ("SPF Processing Time(usecs): External Routes: %lld, "
+	       "%lu destinations recalculated\n",
+	       (stop_time.tv_sec - start_time.tv_sec)*1000000LL+
+	       (stop_time.tv_usec - start_time.tv_usec), count);
+}
 
-	    if (area->external_routing == OSPF_AREA_NSSA)
-	      LSDB_LOOP (NSSA_LSDB (area), rn, lsa)
-		ospf_ase_calculate_route (ospf, lsa);
-	  }
-      /* kevinm: And add the NSSA routes in ospf_top */
-      LSDB_LOOP (NSSA_LSDB (ospf),rn,lsa)
-      		ospf_ase_calculate_route(ospf,lsa);
+static int
+ospf_ase_calculate_timer (struct thread *t)
+{
+  struct ospf *ospf;
+  int kind;
 
-      /* Compare old and new external routing table and install the
-	 difference info zebra/kernel */
-      ospf_ase_compare_tables (ospf->new_external_route,
-			       ospf->old_external_route);
+  ospf = THREAD_ARG (t);
+  ospf->t_ase_calc = NULL;
 
-      /* Delete old external routing table */
-      ospf_route_table_free (ospf->old_external_route);
-      ospf->old_external_route = ospf->new_external_route;
-      ospf->new_external_route = route_table_init ();
+  if (ospf->ase_calc)
+    {
+      kind = ospf->ase_calc;
+      ospf->ase_calc = 0;
 
-      quagga_gettime(QUAGGA_CLK_MONOTONIC, &stop_time);
+      ospf_ase_calculate (ospf, kind);
+    }
 
-      zlog_info ("SPF Processing Time(usecs): External Routes: %lld\n",
-		 (stop_time.tv_sec - start_time.tv_sec)*1000000LL+
-		 (stop_time.tv_usec - start_time.tv_usec));
+  /* Back from a graceful restart, the routes calculated in full. */
+  if (ospf->gr_state == OSPF_GR_RESYNC && ospf->t_spf_calc == NULL)
+    {
+      ospf->gr_state = OSPF_GR_NONE;
+      ospf_zebra_resync (ospf);
     }
   return 0;
 }
 
+/* Have the next ASE calculation be at least of the given kind. */
 void
-ospf_ase_calculate_schedule (struct ospf *ospf)
+ospf_ase_calculate_schedule (struct ospf *ospf, int kind)
 {
   if (ospf == NULL)
     return;
 
-  ospf->ase_calc = 1;
+  if (ospf->ase_calc < kind)
+    ospf->ase_calc = kind;
 }
 
 void
@@ -719,10 +1112,7 @@ ospf_ase_register_external_lsa (struct ospf_lsa *lsa, struct ospf *top)
   struct as_external_lsa *al;
 
   al = (struct as_external_lsa *) lsa->data;
-  p.family = AF_INET;
-  p.prefix = lsa->data->id;
-  p.prefixlen = ip_masklen (al->mask);
-  apply_mask_ipv4 (&p);
+  ospf_ase_lsa_prefix (lsa, &p);
 
   rn = route_node_get (top->external_lsas, (struct prefix *) &p);
   if ((lst = rn->info) == NULL)
@@ -733,6 +1123,10 @@ ospf_ase_register_external_lsa (struct ospf_lsa *lsa, struct ospf *top)
   /* We assume that if LSA is deleted from DB
      is is also deleted from this RT */
   listnode_add (lst, ospf_lsa_lock (lsa)); /* external_lsas lst */
+
+  ospf_ase_dep_add (top, top->external_asbrs, 0, lsa->data->adv_router, lsa);
+  if (al->e[0].fwd_addr.s_addr)
+    ospf_ase_dep_add (top, top->external_fwds, 1, al->e[0].fwd_addr, lsa);
 }
 
 void
@@ -744,10 +1138,11 @@ ospf_ase_unregister_external_lsa (struct ospf_lsa *lsa, struct ospf *top)
   struct as_external_lsa *al;
 
   al = (struct as_external_lsa *) lsa->data;
-  p.family = AF_INET;
-  p.prefix = lsa->data->id;
-  p.prefixlen = ip_masklen (al->mask);
-  apply_mask_ipv4 (&p);
+  ospf_ase_lsa_prefix (lsa, &p);
+
+  ospf_ase_dep_delete (top->external_asbrs, lsa->data->adv_router, lsa);
+  if (al->e[0].fwd_addr.s_addr)
+    ospf_ase_dep_delete (top->external_fwds, al->e[0].fwd_addr, lsa);
 
   rn = route_node_lookup (top->external_lsas, (struct prefix *) &p);
 
@@ -778,21 +1173,33 @@ ospf_ase_external_lsas_finish (struct route_table *rt)
   route_table_finish (rt);
 }
 
+void
+ospf_ase_external_deps_finish (struct ospf *ospf)
+{
+  struct route_table *deps[] = { ospf->external_asbrs, ospf->external_fwds };
+  struct route_node *rn;
+  unsigned int i;
+
+  for (i = 0; i < array_size (deps); i++)
+    {
+      for (rn = route_top (deps[i]); rn; rn = route_next (rn))
+	if (rn->info)
+	  ospf_ase_dep_free (rn->info);
+      route_table_finish (deps[i]);
+    }
+
+  /* info is the list in ospf->external_lsas */
+  route_table_finish (ospf->external_internal);
+}
+
 void
 ospf_ase_incremental_update (struct ospf *ospf, struct ospf_lsa *lsa)
 {
-  struct list *lsas;
-  struct listnode *node;
-  struct route_node *rn, *rn2;
+  struct route_node *rn;
   struct prefix_ipv4 p;
-  struct route_table *tmp_old;
-  struct as_external_lsa *al;
+  struct route_table *prefixes;
 
-  al = (struct as_external_lsa *) lsa->data;
-  p.family = AF_INET;
-  p.prefix = lsa->data->id;
-  p.prefixlen = ip_masklen (al->mask);
-  apply_mask_ipv4 (&p);
+  ospf_ase_lsa_prefix (lsa, &p);
 
   /* if new_table is NULL, there was no spf calculation, thus
      incremental update is unneeded */
@@ -801,67 +1208,23 @@ ospf_ase_incremental_update (struct ospf *ospf, struct ospf_lsa *lsa)
   
   /* If there is already an intra-area or inter-area route
      to the destination, no recalculation is necessary
-     (internal routes take precedence). */
+     (internal routes take precedence).  Note the destination, to
+     recalculate once the internal route goes. */
   
   rn = route_node_lookup (ospf->new_table, (struct prefix *) &p);
   if (rn)
     {
       route_unlock_node (rn);
       if (rn->info)
-	return;
-    }
-
-  rn = route_node_lookup (ospf->external_lsas, (struct prefix *) &p);
-  assert (rn); 
-  assert (rn->info);
-  lsas = rn->info;
-  route_unlock_node (rn);
-
-  for (ALL_LIST_ELEMENTS_RO (lsas, node, lsa))
-    ospf_ase_calculate_route (ospf, lsa);
-
-  /* prepare temporary old routing table for compare */
-  tmp_old = route_table_init ();
-  rn = route_node_lookup (ospf->old_external_route, (struct prefix *) &p);
-  if (rn && rn->info)
-    {
-      rn2 = route_node_get (tmp_old, (struct prefix *) &p);
-      rn2->info = rn->info;
-      route_unlock_node (rn);
-    }
-
-  /* install changes to zebra */
-  ospf_ase_compare_tables (ospf->new_external_route, tmp_old);
-
-  /* update ospf->old_external_route table */
-  if (rn && rn->info)
-    ospf_route_free ((struct ospf_route *) rn->info);
-
-  rn2 = route_node_lookup (ospf->new_external_route, (struct prefix *) &p);
-  /* if new route exists, install it to ospf->old_external_route */
-  if (rn2 && rn2->info)
-    {
-      if (!rn)
-	rn = route_node_get (ospf->old_external_route, (struct prefix *) &p);
-      rn->info = rn2->info;
-    }
-  else
-    {
-      /* remove route node from ospf->old_external_route */
-      if (rn)
 	{
-	  rn->info = NULL;
-	  route_unlock_node (rn);
+	  ospf_ase_prefix_add (ospf, ospf->external_internal,
+			       (struct prefix *) &p);
+	  return;
 	}
     }
 
-  if (rn2)
-    {
-      /* rn2->info is stored in route node of ospf->old_external_route */
-      rn2->info = NULL;
-      route_unlock_node (rn2);
-      route_unlock_node (rn2);
-    }
-
-  route_table_finish (tmp_old);
+  prefixes = route_table_init ();
+  ospf_ase_prefix_add (ospf, prefixes, (struct prefix *) &p);
+  ospf_ase_update_prefixes (ospf, prefixes);
+  route_table_finish (prefixes);
 }
@@ -23,6 +23,17 @@
 #ifndef _ZEBRA_OSPF_ASE_H
 #define _ZEBRA_OSPF_ASE_H
 
+/* Kinds of ASE calculation, in ospf->ase_calc. */
+#define OSPF_ASE_CALC_INCREMENTAL	1
+#define OSPF_ASE_CALC_FULL		2
+
+/* The external LSAs calculated over the route to one ASBR or one
+   forwarding address, and that route as the last calculation saw it. */
+struct ospf_ase_dep
+{
+  struct hash *lsas;
+  struct ospf_route *route;
+};
 
 extern struct ospf_route *ospf_find_asbr_route (struct ospf *,
 						struct route_table *,
@@ -35,10 +46,12 @@ extern struct ospf_route *ospf_find_asbr_route_through_area (struct
 							     *);
 
 extern int ospf_ase_calculate_route (struct ospf *, struct ospf_lsa *);
-extern void ospf_ase_calculate_schedule (struct ospf *);
+extern void ospf_ase_calculate_schedule (struct ospf *, int);
+extern void ospf_ase_calculate (struct ospf *, int);
 extern void ospf_ase_calculate_timer_add (struct ospf *);
 
 extern void ospf_ase_external_lsas_finish (struct route_table *);
+extern void ospf_ase_external_deps_finish (struct ospf *);
 extern void ospf_ase_incremental_update (struct ospf *, struct ospf_lsa *);
 extern void ospf_ase_register_external_lsa (struct ospf_lsa *, struct ospf *);
 extern void ospf_ase_unregister_external_lsa (struct ospf_lsa *,
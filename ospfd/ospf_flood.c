@@ -47,6 +47,7 @@
 #include "ospfd/ospf_route.h"
 #include "ospfd/ospf_zebra.h"
 #include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_gr.h"
 
 extern struct zclient *zclient;
 
@@ -318,7 +319,12 @@ ospf_flood (struct ospf *ospf, struct ospf_neighbor *nbr,
      either updating the LSA or in some cases flushing it from
      the routing domain. */
   if (ospf_lsa_is_self_originated (ospf, new))
-    ospf_process_self_originated_lsa (ospf, new, oi->area);
+    {
+      /* Restarting gracefully, the LSAs from before are kept as they
+         are, to be taken over once the restart is over, RFC 3623 2.2. */
+      if (!OSPF_GR_IS_RESTARTING (ospf))
+        ospf_process_self_originated_lsa (ospf, new, oi->area);
+    }
   else
     /* Update statistics value for OSPF-MIB. */
     ospf->rx_lsa_count++;
@@ -327,7 +333,7 @@ ospf_flood (struct ospf *ospf, struct ospf_neighbor *nbr,
 }
 
 /* OSPF LSA flooding -- RFC2328 Section 13.3. */
-static int
+int
 ospf_flood_through_interface (struct ospf_interface *oi,
 			      struct ospf_neighbor *inbr,
 			      struct ospf_lsa *lsa)
@@ -803,29 +809,157 @@ ospf_ls_request_new (struct lsa_header *lsah)
 }
 
 
-/* Management functions for neighbor's ls-retransmit list. */
+/* Management functions for neighbor's ls-retransmit list.
+
+   A neighbor takes a slot in ospf->ls_rxmt_nbrs the first time an LSA
+   is put on its list, and every LSA has a map with a bit per slot
+   telling whether it is on the list of that neighbor, so an LSA is
+   taken off the lists of all neighbors going through only those it is
+   on.  Those LSAs are found in the queue of the neighbor, which holds a
+   lock on them; deleting one only clears its bit, and its entry in the
+   queue goes the next time the queue is compacted, that is when it is
+   walked to retransmit or it is full.  A second bit per slot in the
+   map tells whether the queue still holds the LSA. */
+#define OSPF_RXMT_LISTED	0
+#define OSPF_RXMT_QUEUED	1
+
+static int
+ospf_lsa_rxmt_test (struct ospf_lsa *lsa, int slot, int which)
+{
+  if (slot < 0 || (unsigned int) slot / 32 >= lsa->rxmt_words)
+    return 0;
+  return (lsa->rxmt_map[which * lsa->rxmt_words + slot / 32]
+	  >> (slot % 32)) & 1;
+}
+
+static void
+ospf_lsa_rxmt_set (struct ospf_lsa *lsa, int slot, int which, int on)
+{
+  u_int32_t *map;
+  u_int16_t words;
+
+  if ((unsigned int) slot / 32 >= lsa->rxmt_words)
+    {
+      words = slot / 32 + 1;
+      map = XCALLOC (MTYPE_OSPF_LSA_RXMT, 2 * words * sizeof (u_int32_t));
+      if (lsa->rxmt_map)
+	{
+	  memcpy (map, lsa->rxmt_map, lsa->rxmt_words * sizeof (u_int32_t));
+	  memcpy (map + words, lsa->rxmt_map + lsa->rxmt_words,
+		  lsa->rxmt_words * sizeof (u_int32_t));
+	  XFREE (MTYPE_OSPF_LSA_RXMT, lsa->rxmt_map);
+	}
+      lsa->rxmt_map = map;
+      lsa->rxmt_words = words;
+    }
+
+  map = &lsa->rxmt_map[which * lsa->rxmt_words + slot / 32];
+  if (on)
+    *map |= 1U << (slot % 32);
+  else
+    *map &= ~(1U << (slot % 32));
+}
+
 unsigned long
 ospf_ls_retransmit_count (struct ospf_neighbor *nbr)
 {
-  return ospf_lsdb_count_all (&nbr->ls_rxmt);
+  return nbr->ls_rxmt.count;
 }
 
 unsigned long
 ospf_ls_retransmit_count_self (struct ospf_neighbor *nbr, int lsa_type)
 {
-  return ospf_lsdb_count_self (&nbr->ls_rxmt, lsa_type);
+  struct ospf_lsa *lsa;
+  unsigned long count = 0;
+  unsigned int i;
+
+  for (i = 0; i < nbr->ls_rxmt.length; i++)
+    {
+      lsa = nbr->ls_rxmt.queue[i];
+      if (ospf_lsa_rxmt_test (lsa, nbr->ls_rxmt.slot, OSPF_RXMT_LISTED)
+	  && IS_LSA_SELF (lsa) && lsa->data->type == lsa_type)
+	count++;
+    }
+  return count;
+}
+
+/* Count the LSAs listed for the neighbour that change the topology,
+   those a graceful restart helper must not have pending, RFC 3623 3.1. */
+unsigned long
+ospf_ls_retransmit_count_changes (struct ospf_neighbor *nbr)
+{
+  struct ospf_lsa *lsa;
+  unsigned long count = 0;
+  unsigned int i;
+
+  for (i = 0; i < nbr->ls_rxmt.length; i++)
+    {
+      lsa = nbr->ls_rxmt.queue[i];
+      if (!ospf_lsa_rxmt_test (lsa, nbr->ls_rxmt.slot, OSPF_RXMT_LISTED))
+	continue;
+      switch (lsa->data->type)
+	{
+	case OSPF_ROUTER_LSA:
+	case OSPF_NETWORK_LSA:
+	case OSPF_SUMMARY_LSA:
+	case OSPF_ASBR_SUMMARY_LSA:
+	case OSPF_AS_EXTERNAL_LSA:
+	case OSPF_AS_NSSA_LSA:
+	  count++;
+	  break;
+	default:
+	  break;
+	}
+    }
+  return count;
 }
 
 int
 ospf_ls_retransmit_isempty (struct ospf_neighbor *nbr)
 {
-  return ospf_lsdb_isempty (&nbr->ls_rxmt);
+  return nbr->ls_rxmt.count == 0;
+}
+
+/* Drop the LSAs deleted from the list from the queue. */
+void
+ospf_ls_retransmit_compact (struct ospf_neighbor *nbr)
+{
+  struct ospf_ls_rxmt *rxmt = &nbr->ls_rxmt;
+  struct ospf_lsa *lsa;
+  unsigned int i, n;
+
+  for (i = n = 0; i < rxmt->length; i++)
+    {
+      lsa = rxmt->queue[i];
+      if (ospf_lsa_rxmt_test (lsa, rxmt->slot, OSPF_RXMT_LISTED))
+	rxmt->queue[n++] = lsa;
+      else
+	{
+	  ospf_lsa_rxmt_set (lsa, rxmt->slot, OSPF_RXMT_QUEUED, 0);
+	  ospf_lsa_unlock (&lsa);
+	}
+    }
+  rxmt->length = n;
+}
+
+static void
+ospf_ls_retransmit_unlist (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
+{
+  lsa->retransmit_counter--;
+  nbr->ls_rxmt.count--;
+  ospf_lsa_rxmt_set (lsa, nbr->ls_rxmt.slot, OSPF_RXMT_LISTED, 0);
+
+  if (IS_DEBUG_OSPF (lsa, LSA_FLOODING))		/* -- endo. */
+    zlog_debug ("RXmtL(%lu)--, NBR(%s), LSA[%s]",
+		ospf_ls_retransmit_count (nbr),
+		inet_ntoa (nbr->router_id), dump_lsa_key (lsa));
 }
 
 /* Add LSA to be retransmitted to neighbor's ls-retransmit list. */
 void
 ospf_ls_retransmit_add (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 {
+  struct ospf_ls_rxmt *rxmt = &nbr->ls_rxmt;
   struct ospf_lsa *old;
 
   old = ospf_ls_retransmit_lookup (nbr, lsa);
@@ -833,11 +967,14 @@ ospf_ls_retransmit_add (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
   if (ospf_lsa_more_recent (old, lsa) < 0)
     {
       if (old)
-	{
-	  old->retransmit_counter--;
-	  ospf_lsdb_delete (&nbr->ls_rxmt, old);
-	}
+	ospf_ls_retransmit_unlist (nbr, old);
+
+      if (rxmt->slot < 0)
+	rxmt->slot = vector_set (nbr->oi->ospf->ls_rxmt_nbrs, nbr);
+
       lsa->retransmit_counter++;
+      rxmt->count++;
+      ospf_lsa_rxmt_set (lsa, rxmt->slot, OSPF_RXMT_LISTED, 1);
       /*
        * We cannot make use of the newly introduced callback function
        * "lsdb->new_lsa_hook" to replace debug output below, just because
@@ -848,7 +985,26 @@ ospf_ls_retransmit_add (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 	  zlog_debug ("RXmtL(%lu)++, NBR(%s), LSA[%s]",
                      ospf_ls_retransmit_count (nbr),
 		     inet_ntoa (nbr->router_id), dump_lsa_key (lsa));
-      ospf_lsdb_add (&nbr->ls_rxmt, lsa);
+
+      if (ospf_lsa_rxmt_test (lsa, rxmt->slot, OSPF_RXMT_QUEUED))
+	return;
+
+      /* Make room, dropping what was deleted first if that is most. */
+      if (rxmt->length == rxmt->size)
+	{
+	  ospf_lsa_lock (lsa);
+	  if (rxmt->length - rxmt->count > rxmt->count)
+	    ospf_ls_retransmit_compact (nbr);
+	  ospf_lsa_unlock (&lsa);
+	}
+      if (rxmt->length == rxmt->size)
+	{
+	  rxmt->size = rxmt->size ? rxmt->size * 2 : 64;
+	  rxmt->queue = XREALLOC (MTYPE_OSPF_LSA_RXMT, rxmt->queue,
+				  rxmt->size * sizeof (struct ospf_lsa *));
+	}
+      rxmt->queue[rxmt->length++] = ospf_lsa_lock (lsa);
+      ospf_lsa_rxmt_set (lsa, rxmt->slot, OSPF_RXMT_QUEUED, 1);
     }
 }
 
@@ -856,88 +1012,123 @@ ospf_ls_retransmit_add (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 void
 ospf_ls_retransmit_delete (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 {
-  if (ospf_ls_retransmit_lookup (nbr, lsa))
-    {
-      lsa->retransmit_counter--;  
-      if (IS_DEBUG_OSPF (lsa, LSA_FLOODING))		/* -- endo. */
-	  zlog_debug ("RXmtL(%lu)--, NBR(%s), LSA[%s]",
-                     ospf_ls_retransmit_count (nbr),
-		     inet_ntoa (nbr->router_id), dump_lsa_key (lsa));
-      ospf_lsdb_delete (&nbr->ls_rxmt, lsa);
-    }
+  struct ospf_lsa *lsr;
+
+  if ((lsr = ospf_ls_retransmit_lookup (nbr, lsa)) != NULL)
+    ospf_ls_retransmit_unlist (nbr, lsr);
 }
 
 /* Clear neighbor's ls-retransmit list. */
 void
 ospf_ls_retransmit_clear (struct ospf_neighbor *nbr)
 {
-  struct ospf_lsdb *lsdb;
-  int i;
-
-  lsdb = &nbr->ls_rxmt;
+  struct ospf_ls_rxmt *rxmt = &nbr->ls_rxmt;
+  struct ospf_lsa *lsa;
+  unsigned int i;
 
-  for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++)
+  for (i = 0; i < rxmt->length; i++)
     {
-      struct route_table *table = lsdb->type[i].db;
-      struct route_node *rn;
-      struct ospf_lsa *lsa;
-
-      for (rn = route_top (table); rn; rn = route_next (rn))
-	if ((lsa = rn->info) != NULL)
-	  ospf_ls_retransmit_delete (nbr, lsa);
+      lsa = rxmt->queue[i];
+      if (ospf_lsa_rxmt_test (lsa, rxmt->slot, OSPF_RXMT_LISTED))
+	ospf_ls_retransmit_unlist (nbr, lsa);
     }
+  ospf_ls_retransmit_compact (nbr);
 
   ospf_lsa_unlock (&nbr->ls_req_last);
   nbr->ls_req_last = NULL;
 }
 
-/* Lookup LSA from neighbor's ls-retransmit list. */
-struct ospf_lsa *
-ospf_ls_retransmit_lookup (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
+/* Clear neighbor's ls-retransmit list, and give up its queue and slot. */
+void
+ospf_ls_retransmit_free (struct ospf_neighbor *nbr)
 {
-  return ospf_lsdb_lookup (&nbr->ls_rxmt, lsa);
+  struct ospf_ls_rxmt *rxmt = &nbr->ls_rxmt;
+
+  if (rxmt->length)
+    ospf_ls_retransmit_clear (nbr);
+  if (rxmt->queue)
+    XFREE (MTYPE_OSPF_LSA_RXMT, rxmt->queue);
+  rxmt->size = 0;
+  if (rxmt->slot >= 0)
+    vector_unset (nbr->oi->ospf->ls_rxmt_nbrs, rxmt->slot);
+  rxmt->slot = -1;
 }
 
-static void
-ospf_ls_retransmit_delete_nbr_if (struct ospf_interface *oi,
-				  struct ospf_lsa *lsa)
+/* Lookup LSA from neighbor's ls-retransmit list.  The LSAs on the lists
+   are those in the database, but for the new instance being flooded
+   before it is installed. */
+struct ospf_lsa *
+ospf_ls_retransmit_lookup (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 {
-  struct route_node *rn;
-  struct ospf_neighbor *nbr;
+  struct ospf_lsdb *lsdb;
   struct ospf_lsa *lsr;
 
-  if (ospf_if_is_enable (oi))
-    for (rn = route_top (oi->nbrs); rn; rn = route_next (rn))
-      /* If LSA find in LS-retransmit list, then remove it. */
-      if ((nbr = rn->info) != NULL)
+  if (nbr->ls_rxmt.count == 0)
+    return NULL;
+  if (ospf_lsa_rxmt_test (lsa, nbr->ls_rxmt.slot, OSPF_RXMT_LISTED))
+    return lsa;
+
+  switch (lsa->data->type)
+    {
+    case OSPF_AS_EXTERNAL_LSA:
+    case OSPF_OPAQUE_AS_LSA:
+      lsdb = nbr->oi->ospf->lsdb;
+      break;
+    default:
+      lsdb = nbr->oi->area->lsdb;
+      break;
+    }
+
+  lsr = ospf_lsdb_lookup (lsdb, lsa);
+  if (lsr && ospf_lsa_rxmt_test (lsr, nbr->ls_rxmt.slot, OSPF_RXMT_LISTED))
+    return lsr;
+
+  /* Link-local opaque-LSAs share one key in the area database, those
+     flooded through a single interface (grace-LSAs) are not in it. */
+  if (lsa->data->type == OSPF_OPAQUE_LINK_LSA)
+    {
+      unsigned int i;
+
+      for (i = 0; i < nbr->ls_rxmt.length; i++)
 	{
-	  lsr = ospf_ls_retransmit_lookup (nbr, lsa);
-	     
-	  /* If LSA find in ls-retransmit list, remove it. */
-	  if (lsr != NULL && lsr->data->ls_seqnum == lsa->data->ls_seqnum)
-	    ospf_ls_retransmit_delete (nbr, lsr);
+	  lsr = nbr->ls_rxmt.queue[i];
+	  if (lsr->data->type == OSPF_OPAQUE_LINK_LSA
+	      && lsr->data->id.s_addr == lsa->data->id.s_addr
+	      && lsr->data->adv_router.s_addr == lsa->data->adv_router.s_addr
+	      && ospf_lsa_rxmt_test (lsr, nbr->ls_rxmt.slot, OSPF_RXMT_LISTED))
+	    return lsr;
 	}
+    }
+  return NULL;
+}
+
+/* Remove LSA from the ls-retransmit lists of all neighbors. */
+static void
+ospf_ls_retransmit_delete_nbr_all (struct ospf *ospf, struct ospf_lsa *lsa)
+{
+  struct ospf_neighbor *nbr;
+  u_int32_t bits;
+  int word, slot;
+
+  for (word = 0; word < lsa->rxmt_words && lsa->retransmit_counter; word++)
+    for (bits = lsa->rxmt_map[word], slot = word * 32; bits;
+	 bits >>= 1, slot++)
+      if ((bits & 1)
+	  && (nbr = vector_lookup (ospf->ls_rxmt_nbrs, slot)) != NULL)
+	ospf_ls_retransmit_unlist (nbr, lsa);
 }
 
 void
 ospf_ls_retransmit_delete_nbr_area (struct ospf_area *area,
 				    struct ospf_lsa *lsa)
 {
-  struct listnode *node, *nnode;
-  struct ospf_interface *oi;
-
-  for (ALL_LIST_ELEMENTS (area->oiflist, node, nnode, oi))
-    ospf_ls_retransmit_delete_nbr_if (oi, lsa);
+  ospf_ls_retransmit_delete_nbr_all (area->ospf, lsa);
 }
 
 void
 ospf_ls_retransmit_delete_nbr_as (struct ospf *ospf, struct ospf_lsa *lsa)
 {
-  struct listnode *node, *nnode;
-  struct ospf_interface *oi;
-
-  for (ALL_LIST_ELEMENTS (ospf->oiflist, node, nnode, oi))
-    ospf_ls_retransmit_delete_nbr_if (oi, lsa);
+  ospf_ls_retransmit_delete_nbr_all (ospf, lsa);
 }
 
 
@@ -27,6 +27,9 @@ extern int ospf_flood (struct ospf *, struct ospf_neighbor *,
 		       struct ospf_lsa *, struct ospf_lsa *);
 extern int ospf_flood_through (struct ospf *, struct ospf_neighbor *,
 			       struct ospf_lsa *);
+extern int ospf_flood_through_interface (struct ospf_interface *,
+					 struct ospf_neighbor *,
+					 struct ospf_lsa *);
 extern int ospf_flood_through_area (struct ospf_area *,
 				    struct ospf_neighbor *,
 				    struct ospf_lsa *);
@@ -47,12 +50,15 @@ extern struct ospf_lsa *ospf_ls_request_lookup (struct ospf_neighbor *,
 extern unsigned long ospf_ls_retransmit_count (struct ospf_neighbor *);
 extern unsigned long ospf_ls_retransmit_count_self (struct ospf_neighbor *,
 						    int);
+extern unsigned long ospf_ls_retransmit_count_changes (struct ospf_neighbor *);
 extern int ospf_ls_retransmit_isempty (struct ospf_neighbor *);
 extern void ospf_ls_retransmit_add (struct ospf_neighbor *,
 				    struct ospf_lsa *);
 extern void ospf_ls_retransmit_delete (struct ospf_neighbor *,
 				       struct ospf_lsa *);
 extern void ospf_ls_retransmit_clear (struct ospf_neighbor *);
+extern void ospf_ls_retransmit_compact (struct ospf_neighbor *);
+extern void ospf_ls_retransmit_free (struct ospf_neighbor *);
 extern struct ospf_lsa *ospf_ls_retransmit_lookup (struct ospf_neighbor *,
 						   struct ospf_lsa *);
 extern void ospf_ls_retransmit_delete_nbr_area (struct ospf_area *,
@@ -0,0 +1,976 @@
+/* OSPF graceful restart, RFC 3623
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+MA 02111-1307, USA.  */
+
+/* A router restarting gracefully sends grace-LSAs before it goes, and
+   zebra keeps its routes in the FIB meanwhile.  When it is back it
+   neither originates nor flushes LSAs, nor changes the FIB, until its
+   adjacencies are all back as its router-LSA from before has them, or
+   the grace period is over.  Then it originates its LSAs afresh, and
+   once its routes are calculated they go to zebra in one pass, zebra
+   removing what was kept and not sent again.
+
+   A neighbour helping it goes on describing the adjacency as full,
+   whatever the hellos say, unless the topology changes meanwhile. */
+
+#include <zebra.h>
+
+#include "linklist.h"
+#include "prefix.h"
+#include "if.h"
+#include "table.h"
+#include "memory.h"
+#include "command.h"
+#include "vty.h"
+#include "stream.h"
+#include "log.h"
+#include "thread.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_interface.h"
+#include "ospfd/ospf_ism.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_neighbor.h"
+#include "ospfd/ospf_nsm.h"
+#include "ospfd/ospf_flood.h"
+#include "ospfd/ospf_packet.h"
+#include "ospfd/ospf_spf.h"
+#include "ospfd/ospf_abr.h"
+#include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_zebra.h"
+#include "ospfd/ospf_gr.h"
+
+/* Where the end of the grace period is kept across the restart. */
+const char *ospf_gr_state_file = PATH_OSPFD_GR;
+
+static const char *ospf_gr_reason_str[] =
+{
+  "unknown",
+  "software restart",
+  "software reload/upgrade",
+  "switch to redundant control processor",
+};
+
+static const char *
+ospf_gr_reason (u_char reason)
+{
+  return reason <= GR_REASON_SWITCHOVER
+    ? ospf_gr_reason_str[reason] : ospf_gr_reason_str[GR_REASON_UNKNOWN];
+}
+
+/* Make a grace-LSA for the interface, not installed: it is flooded
+   through the interface alone. */
+struct ospf_lsa *
+ospf_gr_lsa_new (struct ospf_interface *oi, u_int32_t grace_period,
+		 u_char reason)
+{
+  struct stream *s;
+  struct lsa_header *lsah;
+  struct ospf_lsa *new;
+  struct in_addr id;
+  u_int16_t length;
+
+  s = stream_new (OSPF_MAX_LSA_SIZE);
+  lsah = (struct lsa_header *) STREAM_DATA (s);
+
+  id.s_addr = htonl (SET_OPAQUE_LSID (OPAQUE_TYPE_GRACE_LSA, 0));
+  lsa_header_set (s, (LSA_OPTIONS_GET (oi->area)
+		      | LSA_OPTIONS_NSSA_GET (oi->area) | OSPF_OPTION_O),
+		  OSPF_OPAQUE_LINK_LSA, id, oi->ospf->router_id);
+
+  stream_putw (s, GR_TLV_GRACE_PERIOD);
+  stream_putw (s, 4);
+  stream_putl (s, grace_period);
+
+  stream_putw (s, GR_TLV_REASON);
+  stream_putw (s, 1);
+  stream_putc (s, reason);
+  stream_put (s, NULL, 3);
+
+  /* Neighbours on multi-access networks know us by our address. */
+  if (oi->type != OSPF_IFTYPE_POINTOPOINT
+      && oi->type != OSPF_IFTYPE_VIRTUALLINK)
+    {
+      stream_putw (s, GR_TLV_IF_ADDRESS);
+      stream_putw (s, 4);
+      stream_put_ipv4 (s, oi->address->u.prefix4.s_addr);
+    }
+
+  length = stream_get_endp (s);
+  lsah->length = htons (length);
+
+  new = ospf_lsa_new ();
+  new->data = ospf_lsa_data_new (length);
+  memcpy (new->data, lsah, length);
+  stream_free (s);
+
+  SET_FLAG (new->flags, OSPF_LSA_SELF | OSPF_LSA_SELF_CHECKED);
+  new->area = oi->area;
+  new->oi = oi;
+  ospf_lsa_checksum (new->data);
+
+  return new;
+}
+
+/* Read a grace-LSA, -1 if it lacks the grace period or the reason. */
+int
+ospf_gr_lsa_parse (struct lsa_header *lsah, struct ospf_gr_info *info)
+{
+  u_char *p = (u_char *) lsah + OSPF_LSA_HEADER_SIZE;
+  u_char *lim = (u_char *) lsah + ntohs (lsah->length);
+  u_int16_t type, length;
+  u_int32_t val;
+  int seen = 0;
+
+  memset (info, 0, sizeof (struct ospf_gr_info));
+
+  while (p + 4 <= lim)
+    {
+      type = (p[0] << 8) | p[1];
+      length = (p[2] << 8) | p[3];
+      p += 4;
+      if (p + length > lim)
+	return -1;
+
+      switch (type)
+	{
+	case GR_TLV_GRACE_PERIOD:
+	  if (length != 4)
+	    return -1;
+	  memcpy (&val, p, 4);
+	  info->grace_period = ntohl (val);
+	  seen |= 1 << GR_TLV_GRACE_PERIOD;
+	  break;
+	case GR_TLV_REASON:
+	  if (length != 1)
+	    return -1;
+	  info->reason = p[0];
+	  seen |= 1 << GR_TLV_REASON;
+	  break;
+	case GR_TLV_IF_ADDRESS:
+	  if (length != 4)
+	    return -1;
+	  memcpy (&info->if_address, p, 4);
+	  break;
+	default:
+	  break;
+	}
+      p += ROUNDUP (length, 4);
+    }
+
+  if (seen != ((1 << GR_TLV_GRACE_PERIOD) | (1 << GR_TLV_REASON)))
+    return -1;
+  return 0;
+}
+
+/* Originate the network-LSA of the interface as it is, flushing it when
+   nobody is left adjacent, as nsm_change_state does. */
+static void
+ospf_gr_network_lsa_update (struct ospf_interface *oi)
+{
+  if (oi->state != ISM_DR)
+    return;
+
+  if (oi->network_lsa_self && ospf_nbr_count_adjacent (oi) == 0)
+    {
+      ospf_lsa_flush_area (oi->network_lsa_self, oi->area);
+      ospf_lsa_unlock (&oi->network_lsa_self);
+      oi->network_lsa_self = NULL;
+    }
+  else
+    ospf_network_lsa_update (oi);
+}
+
+/* What a change to the LSDB calls for is done once the LSA is in, as
+   it may originate our LSAs anew, replacing the one being installed. */
+static int
+ospf_gr_event (struct thread *thread)
+{
+  struct ospf *ospf = THREAD_ARG (thread);
+  struct listnode *node;
+  struct ospf_interface *oi;
+
+  ospf->t_gr_event = NULL;
+  ospf_gr_restart_check (ospf);
+
+  if (ospf->gr_originate)
+    {
+      ospf->gr_originate = 0;
+      ospf_router_lsa_update (ospf);
+      for (ALL_LIST_ELEMENTS_RO (ospf->oiflist, node, oi))
+	ospf_gr_network_lsa_update (oi);
+    }
+  return 0;
+}
+
+static void
+ospf_gr_event_schedule (struct ospf *ospf)
+{
+  if (ospf->t_gr_event == NULL)
+    ospf->t_gr_event = thread_add_event (master, ospf_gr_event, ospf, 0);
+}
+
+/*------------------------------------------------------------------------*
+ * Helper, RFC 3623 section 3.
+ *------------------------------------------------------------------------*/
+
+static void
+ospf_gr_helper_end (struct ospf_neighbor *nbr, const char *why)
+{
+  struct ospf_interface *oi = nbr->oi;
+
+  oi->ospf->gr_helping--;
+  zlog_notice ("graceful restart: no longer helping %s on %s, %s",
+	       inet_ntoa (nbr->router_id), IF_NAME (oi), why);
+
+  /* The hellos decide again, the adjacency goes if they have stopped. */
+  if (nbr->t_inactivity == NULL)
+    OSPF_NSM_EVENT_SCHEDULE (nbr, NSM_InactivityTimer);
+
+  /* Describe the adjacency as it is. */
+  oi->ospf->gr_originate = 1;
+  ospf_gr_event_schedule (oi->ospf);
+  if (oi->type == OSPF_IFTYPE_BROADCAST || oi->type == OSPF_IFTYPE_NBMA)
+    OSPF_ISM_EVENT_SCHEDULE (oi, ISM_NeighborChange);
+}
+
+static int
+ospf_gr_helper_timer (struct thread *thread)
+{
+  struct ospf_neighbor *nbr = THREAD_ARG (thread);
+
+  nbr->t_gr_helper = NULL;
+  ospf_gr_helper_end (nbr, "grace period over");
+  return 0;
+}
+
+void
+ospf_gr_helper_exit (struct ospf_neighbor *nbr, const char *why)
+{
+  if (nbr->t_gr_helper == NULL)
+    return;
+
+  OSPF_NSM_TIMER_OFF (nbr->t_gr_helper);
+  ospf_gr_helper_end (nbr, why);
+}
+
+/* A grace-LSA from a neighbour has come, help it restart if we can. */
+static void
+ospf_gr_helper_enter (struct ospf *ospf, struct ospf_lsa *lsa)
+{
+  struct ospf_interface *oi = lsa->oi;
+  struct ospf_neighbor *nbr;
+  struct ospf_gr_info info;
+  const char *why = NULL;
+  long remaining;
+
+  if (oi == NULL || ospf_gr_lsa_parse (lsa->data, &info) < 0)
+    return;
+
+  if (oi->type == OSPF_IFTYPE_POINTOPOINT
+      || oi->type == OSPF_IFTYPE_VIRTUALLINK
+      || info.if_address.s_addr == 0)
+    nbr = ospf_nbr_lookup_by_routerid (oi->nbrs, &lsa->data->adv_router);
+  else
+    nbr = ospf_nbr_lookup_by_addr (oi->nbrs, &info.if_address);
+  if (nbr == NULL || !IPV4_ADDR_SAME (&nbr->router_id,
+				      &lsa->data->adv_router))
+    return;
+
+  /* Flushed, the restart is over. */
+  if (IS_LSA_MAXAGE (lsa))
+    {
+      ospf_gr_helper_exit (nbr, "restart over");
+      return;
+    }
+
+  remaining = (long) info.grace_period - LS_AGE (lsa);
+
+  /* Already helping, the grace period may have changed. */
+  if (nbr->t_gr_helper)
+    {
+      OSPF_NSM_TIMER_OFF (nbr->t_gr_helper);
+      if (remaining > 0)
+	nbr->t_gr_helper = thread_add_timer (master, ospf_gr_helper_timer,
+					     nbr, remaining);
+      else
+	ospf_gr_helper_end (nbr, "grace period over");
+      return;
+    }
+
+  /* RFC 3623 3.1. */
+  if (!ospf->gr_helper)
+    why = "helper mode is off";
+  else if (OSPF_GR_IS_RESTARTING (ospf))
+    why = "restarting ourselves";
+  else if (nbr->state != NSM_Full)
+    why = "not fully adjacent";
+  else if (remaining <= 0)
+    why = "grace period over";
+  else if (ospf_ls_retransmit_count_changes (nbr) > 0)
+    why = "topology changes pending for it";
+
+  if (why)
+    {
+      zlog_info ("graceful restart: not helping %s on %s, %s",
+		 inet_ntoa (nbr->router_id), IF_NAME (oi), why);
+      return;
+    }
+
+  ospf->gr_helping++;
+  nbr->t_gr_helper = thread_add_timer (master, ospf_gr_helper_timer,
+				       nbr, remaining);
+  zlog_notice ("graceful restart: helping %s on %s for %lds, %s",
+	       inet_ntoa (nbr->router_id), IF_NAME (oi), remaining,
+	       ospf_gr_reason (info.reason));
+}
+
+/* The topology changed, stop helping the neighbours the change is to
+   be flooded to, RFC 3623 3.2. */
+static void
+ospf_gr_helper_topology_change (struct ospf *ospf, struct ospf_lsa *lsa)
+{
+  struct listnode *node;
+  struct ospf_interface *oi;
+  struct route_node *rn;
+  struct ospf_neighbor *nbr;
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->oiflist, node, oi))
+    {
+      if (lsa->data->type != OSPF_AS_EXTERNAL_LSA && oi->area != lsa->area)
+	continue;
+
+      for (rn = route_top (oi->nbrs); rn; rn = route_next (rn))
+	if ((nbr = rn->info) != NULL && nbr->t_gr_helper
+	    && !IPV4_ADDR_SAME (&nbr->router_id, &lsa->data->adv_router))
+	  ospf_gr_helper_exit (nbr, "topology changed");
+    }
+}
+
+/*------------------------------------------------------------------------*
+ * Restarting router, RFC 3623 section 2.
+ *------------------------------------------------------------------------*/
+
+/* Going down, send grace-LSAs and keep the end of the grace period for
+   when we are back.  0 if there is nobody to send them to. */
+int
+ospf_gr_shutdown (struct ospf *ospf)
+{
+  struct listnode *node;
+  struct ospf_interface *oi;
+  struct ospf_lsa *lsa;
+  FILE *fp;
+  int sent = 0;
+
+  if (ospf->gr_grace_period == 0
+      || !CHECK_FLAG (ospf->config, OSPF_OPAQUE_CAPABLE))
+    return 0;
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->oiflist, node, oi))
+    {
+      if (oi->type == OSPF_IFTYPE_VIRTUALLINK || oi->state == ISM_Down
+	  || ospf_nbr_count_opaque_capable (oi) == 0)
+	continue;
+
+      lsa = ospf_gr_lsa_new (oi, ospf->gr_grace_period, GR_REASON_RESTART);
+      ospf_flood_through_interface (oi, NULL, lsa);
+      ospf_lsa_discard (lsa);
+      sent = 1;
+    }
+
+  if (!sent)
+    return 0;
+
+  if ((fp = fopen (ospf_gr_state_file, "w")) != NULL)
+    {
+      fprintf (fp, "%lld\n",
+	       (long long) quagga_time (NULL) + ospf->gr_grace_period);
+      fclose (fp);
+    }
+  else
+    zlog_warn ("graceful restart: cannot write %s: %s",
+	       ospf_gr_state_file, safe_strerror (errno));
+
+  zlog_notice ("graceful restart: grace-LSAs sent, grace period %us",
+	       ospf->gr_grace_period);
+  ospf->gr_state = OSPF_GR_SHUTDOWN;
+  ospf->gr_shutdown_wait = OSPF_GR_SHUTDOWN_WAIT;
+  return 1;
+}
+
+/* Whether the grace-LSAs are acknowledged, or it is time to go anyway,
+   polled every second. */
+int
+ospf_gr_shutdown_done (struct ospf *ospf)
+{
+  struct listnode *node;
+  struct ospf_interface *oi;
+  struct route_node *rn;
+  struct ospf_neighbor *nbr;
+
+  if (ospf->gr_shutdown_wait == 0 || --ospf->gr_shutdown_wait == 0)
+    return 1;
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->oiflist, node, oi))
+    for (rn = route_top (oi->nbrs); rn; rn = route_next (rn))
+      if ((nbr = rn->info) != NULL
+	  && ospf_ls_retransmit_count_self (nbr, OSPF_OPAQUE_LINK_LSA) > 0)
+	{
+	  route_unlock_node (rn);
+	  return 0;
+	}
+  return 1;
+}
+
+static int
+ospf_gr_restart_timer (struct thread *thread)
+{
+  struct ospf *ospf = THREAD_ARG (thread);
+
+  ospf->t_gr_restart = NULL;
+  ospf_gr_restart_exit (ospf, "grace period over");
+  return 0;
+}
+
+void
+ospf_gr_restart_begin (struct ospf *ospf, unsigned long remaining)
+{
+  ospf->gr_state = OSPF_GR_RESTARTING;
+  ospf->gr_seqnum = 0;
+  OSPF_TIMER_OFF (ospf->t_gr_restart);
+  OSPF_TIMER_ON (ospf->t_gr_restart, ospf_gr_restart_timer, remaining);
+  zlog_notice ("graceful restart: restarting, %lus of grace left",
+	       remaining);
+}
+
+/* Back, restarting gracefully if we went so within the grace period. */
+void
+ospf_gr_startup (void)
+{
+  struct ospf *ospf;
+  long long end;
+  time_t now;
+  FILE *fp;
+
+  if ((fp = fopen (ospf_gr_state_file, "r")) == NULL)
+    return;
+  if (fscanf (fp, "%lld", &end) != 1)
+    end = 0;
+  fclose (fp);
+  unlink (ospf_gr_state_file);
+
+  ospf = ospf_lookup ();
+  if (ospf == NULL || ospf->gr_grace_period == 0
+      || !CHECK_FLAG (ospf->config, OSPF_OPAQUE_CAPABLE))
+    return;
+
+  now = quagga_time (NULL);
+  if (end <= now)
+    {
+      zlog_warn ("graceful restart: back after the grace period");
+      return;
+    }
+  ospf_gr_restart_begin (ospf, end - now);
+}
+
+static struct ospf_neighbor *
+ospf_gr_area_nbr (struct ospf_area *area, struct in_addr *router_id)
+{
+  struct listnode *node;
+  struct ospf_interface *oi;
+  struct ospf_neighbor *nbr;
+
+  for (ALL_LIST_ELEMENTS_RO (area->oiflist, node, oi))
+    if ((nbr = ospf_nbr_lookup_by_routerid (oi->nbrs, router_id)))
+      return nbr;
+  return NULL;
+}
+
+/* The checks below say 0 when the adjacency is back, 1 when it is not
+   yet, -1 when the topology changed meanwhile. */
+
+/* A point-to-point link of our router-LSA from before. */
+static int
+ospf_gr_check_ptop (struct ospf_area *area, struct ospf_lsa *self,
+		    struct router_lsa_link *l)
+{
+  struct ospf_lsa *peer;
+  struct ospf_neighbor *nbr;
+
+  peer = ospf_lsdb_lookup_by_id (area->lsdb, OSPF_ROUTER_LSA,
+				 l->link_id, l->link_id);
+  if (peer && !IS_LSA_MAXAGE (peer) && ospf_lsa_has_link (peer, self->data) < 0)
+    return -1;
+
+  nbr = ospf_gr_area_nbr (area, &l->link_id);
+  return (nbr && nbr->state == NSM_Full) ? 0 : 1;
+}
+
+/* A transit link of our router-LSA from before: Full with every router
+   of the network if we were its DR, else with its DR. */
+static int
+ospf_gr_check_transit (struct ospf_area *area, struct ospf_lsa *self,
+		       struct router_lsa_link *l)
+{
+  struct ospf *ospf = area->ospf;
+  struct listnode *node;
+  struct ospf_interface *oi;
+  struct ospf_neighbor *nbr;
+  struct ospf_lsa *net, *rtr;
+  struct in_addr *id, *lim;
+  int ret = 0;
+
+  for (ALL_LIST_ELEMENTS_RO (area->oiflist, node, oi))
+    if (oi->type != OSPF_IFTYPE_VIRTUALLINK
+	&& IPV4_ADDR_SAME (&oi->address->u.prefix4, &l->link_data))
+      break;
+  if (node == NULL)
+    return -1;
+
+  if (!IPV4_ADDR_SAME (&l->link_id, &l->link_data))
+    {
+      nbr = ospf_nbr_lookup_by_addr (oi->nbrs, &l->link_id);
+      if (nbr == NULL)
+	return 1;
+      net = ospf_lsdb_lookup_by_id (area->lsdb, OSPF_NETWORK_LSA,
+				    l->link_id, nbr->router_id);
+      if (net && !IS_LSA_MAXAGE (net)
+	  && ospf_lsa_has_link (net, self->data) < 0)
+	return -1;
+      return nbr->state == NSM_Full ? 0 : 1;
+    }
+
+  /* We were the DR. */
+  net = ospf_lsdb_lookup_by_id (area->lsdb, OSPF_NETWORK_LSA,
+				l->link_id, ospf->router_id);
+  if (net == NULL || IS_LSA_MAXAGE (net))
+    return 0;
+
+  id = (struct in_addr *) ((u_char *) net->data + OSPF_LSA_HEADER_SIZE + 4);
+  lim = (struct in_addr *) ((u_char *) net->data + ntohs (net->data->length));
+  for (; id < lim; id++)
+    {
+      if (IPV4_ADDR_SAME (id, &ospf->router_id))
+	continue;
+      rtr = ospf_lsdb_lookup_by_id (area->lsdb, OSPF_ROUTER_LSA, *id, *id);
+      if (rtr && !IS_LSA_MAXAGE (rtr) && ospf_lsa_has_link (rtr, net->data) < 0)
+	return -1;
+      nbr = ospf_nbr_lookup_by_routerid (oi->nbrs, id);
+      if (nbr == NULL || nbr->state != NSM_Full)
+	ret = 1;
+    }
+  return ret;
+}
+
+/* Whether the adjacencies of the area are back, as our router-LSA from
+   before has them, RFC 3623 2.2. */
+static int
+ospf_gr_check_area (struct ospf_area *area)
+{
+  struct ospf *ospf = area->ospf;
+  struct ospf_lsa *self;
+  struct router_lsa_link *l;
+  struct listnode *node;
+  struct ospf_interface *oi;
+  struct route_node *rn;
+  struct ospf_neighbor *nbr;
+  u_char *p, *lim;
+  int r, ret = 0;
+
+  self = ospf_lsdb_lookup_by_id (area->lsdb, OSPF_ROUTER_LSA,
+				 ospf->router_id, ospf->router_id);
+
+  /* Not heard of, wait for the neighbours there are. */
+  if (self == NULL || IS_LSA_MAXAGE (self))
+    {
+      for (ALL_LIST_ELEMENTS_RO (area->oiflist, node, oi))
+	for (rn = route_top (oi->nbrs); rn; rn = route_next (rn))
+	  if ((nbr = rn->info) != NULL && nbr != oi->nbr_self
+	      && nbr->state > NSM_Attempt && nbr->state < NSM_Full)
+	    {
+	      route_unlock_node (rn);
+	      return 1;
+	    }
+      return 0;
+    }
+
+  p = (u_char *) self->data + OSPF_LSA_HEADER_SIZE + 4;
+  lim = (u_char *) self->data + ntohs (self->data->length);
+  while (p + OSPF_ROUTER_LSA_LINK_SIZE <= lim)
+    {
+      l = (struct router_lsa_link *) p;
+      p += OSPF_ROUTER_LSA_LINK_SIZE
+	   + l->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE;
+
+      switch (l->m[0].type)
+	{
+	case LSA_LINK_TYPE_POINTOPOINT:
+	  r = ospf_gr_check_ptop (area, self, l);
+	  break;
+	case LSA_LINK_TYPE_TRANSIT:
+	  r = ospf_gr_check_transit (area, self, l);
+	  break;
+	default:
+	  /* Stub networks need no adjacency, virtual links are left to
+	     the grace period. */
+	  continue;
+	}
+      if (r < 0)
+	return -1;
+      if (r > 0)
+	ret = 1;
+    }
+  return ret;
+}
+
+/* Whether the restart is over, the adjacencies all back or the
+   topology changed. */
+void
+ospf_gr_restart_check (struct ospf *ospf)
+{
+  struct listnode *node;
+  struct ospf_area *area;
+  int r, ret = 0;
+
+  if (!OSPF_GR_IS_RESTARTING (ospf))
+    return;
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    {
+      r = ospf_gr_check_area (area);
+      if (r < 0)
+	{
+	  ospf_gr_restart_exit (ospf, "topology changed");
+	  return;
+	}
+      if (r > 0)
+	ret = 1;
+    }
+
+  if (ret == 0)
+    ospf_gr_restart_exit (ospf, "adjacencies all back");
+}
+
+/* The restart is over: originate our LSAs afresh, going on from the
+   sequence numbers of those from before, flush those no longer wanted,
+   then the grace-LSAs.  The FIB waits for the routes, RFC 3623 2.3. */
+void
+ospf_gr_restart_exit (struct ospf *ospf, const char *why)
+{
+  struct listnode *node, *node2;
+  struct ospf_area *area;
+  struct ospf_interface *oi;
+  struct ospf_lsa *lsa;
+  struct route_node *rn;
+  int type;
+
+  if (!OSPF_GR_IS_RESTARTING (ospf))
+    return;
+
+  zlog_notice ("graceful restart: restart over, %s", why);
+  ospf->gr_state = OSPF_GR_RESYNC;
+  OSPF_TIMER_OFF (ospf->t_gr_restart);
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    {
+      if (area->router_lsa_self == NULL
+	  && (lsa = ospf_lsdb_lookup_by_id (area->lsdb, OSPF_ROUTER_LSA,
+					    ospf->router_id,
+					    ospf->router_id)))
+	area->router_lsa_self = ospf_lsa_lock (lsa);
+      ospf_router_lsa_update_area (area);
+
+      for (ALL_LIST_ELEMENTS_RO (area->oiflist, node2, oi))
+	{
+	  if (oi->type == OSPF_IFTYPE_VIRTUALLINK)
+	    continue;
+
+	  lsa = ospf_lsdb_lookup_by_id (area->lsdb, OSPF_NETWORK_LSA,
+					oi->address->u.prefix4,
+					ospf->router_id);
+	  if (oi->state == ISM_DR)
+	    {
+	      if (oi->network_lsa_self == NULL && lsa)
+		oi->network_lsa_self = ospf_lsa_lock (lsa);
+	      ospf_gr_network_lsa_update (oi);
+	    }
+	  else if (lsa && oi->network_lsa_self == NULL
+		   && !IS_LSA_MAXAGE (lsa))
+	    ospf_lsa_flush_area (lsa, area);
+	}
+    }
+
+  /* AS-external-LSAs, of the routes redistributed now. */
+  for (type = 0; type < ZEBRA_ROUTE_MAX; type++)
+    if (type != ZEBRA_ROUTE_OSPF)
+      ospf_external_lsa_refresh_type (ospf, type, LSA_REFRESH_FORCE);
+  ospf_external_lsa_refresh_default (ospf);
+  LSDB_LOOP (EXTERNAL_LSDB (ospf), rn, lsa)
+    if (IS_LSA_SELF (lsa) && !IS_LSA_MAXAGE (lsa)
+	&& !CHECK_FLAG (lsa->flags, OSPF_LSA_LOCAL_XLT)
+	&& ospf_external_info_check (lsa) == NULL)
+      ospf_lsa_flush_as (ospf, lsa);
+
+  /* Summary-LSAs, the ABR task flushing those no longer approved. */
+  ospf_schedule_abr_task (ospf);
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->oiflist, node, oi))
+    {
+      if (oi->type == OSPF_IFTYPE_VIRTUALLINK || oi->state == ISM_Down)
+	continue;
+
+      lsa = ospf_gr_lsa_new (oi, ospf->gr_grace_period, GR_REASON_RESTART);
+      lsa->data->ls_seqnum
+	= htonl (MAX (ospf->gr_seqnum, OSPF_INITIAL_SEQUENCE_NUMBER) + 1);
+      lsa->data->ls_age = htons (OSPF_LSA_MAXAGE);
+      ospf_lsa_checksum (lsa->data);
+      ospf_flood_through_interface (oi, NULL, lsa);
+      ospf_lsa_discard (lsa);
+    }
+
+  ospf_spf_calculate_schedule (ospf, SPF_FLAG_CONFIG_CHANGE);
+}
+
+/* Our own grace-LSA, from a neighbour: acknowledged and dropped while
+   going or restarting, keeping its sequence number for the flush. */
+int
+ospf_gr_self_lsa_received (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
+{
+  struct ospf *ospf = nbr->oi->ospf;
+
+  if (lsa->data->type != OSPF_OPAQUE_LINK_LSA
+      || GET_OPAQUE_TYPE (ntohl (lsa->data->id.s_addr))
+	 != OPAQUE_TYPE_GRACE_LSA
+      || (ospf->gr_state != OSPF_GR_RESTARTING
+	  && ospf->gr_state != OSPF_GR_SHUTDOWN))
+    return 0;
+
+  ospf->gr_seqnum = MAX (ospf->gr_seqnum, ntohl (lsa->data->ls_seqnum));
+  ospf_ls_ack_send (nbr, lsa);
+  ospf_lsa_discard (lsa);
+  return 1;
+}
+
+/* An LSA installed, its contents changed. */
+void
+ospf_gr_lsa_change (struct ospf *ospf, struct ospf_lsa *lsa)
+{
+  switch (lsa->data->type)
+    {
+    case OSPF_OPAQUE_LINK_LSA:
+      if (!IS_LSA_SELF (lsa)
+	  && GET_OPAQUE_TYPE (ntohl (lsa->data->id.s_addr))
+	     == OPAQUE_TYPE_GRACE_LSA)
+	ospf_gr_helper_enter (ospf, lsa);
+      return;
+    case OSPF_ROUTER_LSA:
+    case OSPF_NETWORK_LSA:
+      if (OSPF_GR_IS_RESTARTING (ospf))
+	ospf_gr_event_schedule (ospf);
+      break;
+    case OSPF_SUMMARY_LSA:
+    case OSPF_ASBR_SUMMARY_LSA:
+    case OSPF_AS_EXTERNAL_LSA:
+    case OSPF_AS_NSSA_LSA:
+      break;
+    default:
+      return;
+    }
+
+  if (ospf->gr_helping)
+    ospf_gr_helper_topology_change (ospf, lsa);
+}
+
+/*------------------------------------------------------------------------*
+ * Opaque-LSA hooks and configuration.
+ *------------------------------------------------------------------------*/
+
+static void
+ospf_gr_nsm_change (struct ospf_neighbor *nbr, int old_state)
+{
+  struct ospf *ospf = nbr->oi->ospf;
+
+  if (nbr->state == NSM_Full && old_state != NSM_Full)
+    ospf_gr_restart_check (ospf);
+}
+
+static void
+ospf_gr_config_write_router (struct vty *vty)
+{
+  struct ospf *ospf = ospf_lookup ();
+
+  if (ospf == NULL)
+    return;
+
+  if (ospf->gr_grace_period == OSPF_GR_GRACE_PERIOD_DEFAULT)
+    vty_out (vty, " graceful-restart%s", VTY_NEWLINE);
+  else if (ospf->gr_grace_period)
+    vty_out (vty, " graceful-restart grace-period %u%s",
+	     ospf->gr_grace_period, VTY_NEWLINE);
+  if (ospf->gr_helper)
+    vty_out (vty, " graceful-restart helper%s", VTY_NEWLINE);
+}
+
+static void
+ospf_gr_show_info (struct vty *vty, struct ospf_lsa *lsa)
+{
+  struct ospf_gr_info info;
+
+  if (ospf_gr_lsa_parse (lsa->data, &info) < 0)
+    {
+      vty_out (vty, "  Malformed grace-LSA%s", VTY_NEWLINE);
+      return;
+    }
+
+  vty_out (vty, "  Grace period: %u seconds%s", info.grace_period,
+	   VTY_NEWLINE);
+  vty_out (vty, "  Restart reason: %s%s", ospf_gr_reason (info.reason),
+	   VTY_NEWLINE);
+  if (info.if_address.s_addr)
+    vty_out (vty, "  Interface address: %s%s", inet_ntoa (info.if_address),
+	     VTY_NEWLINE);
+}
+
+#define OSPF_GR_STR "Graceful restart, RFC 3623\n"
+
+static int
+ospf_gr_grace_period_set (struct vty *vty, u_int16_t grace_period)
+{
+  struct ospf *ospf = vty->index;
+
+  if (grace_period && !CHECK_FLAG (ospf->config, OSPF_OPAQUE_CAPABLE))
+    {
+      vty_out (vty, "%% Graceful restart needs \"capability opaque\"%s",
+	       VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  ospf->gr_grace_period = grace_period;
+  ospf_zebra_graceful_restart_update (grace_period);
+  return CMD_SUCCESS;
+}
+
+DEFUN (ospf_graceful_restart,
+       ospf_graceful_restart_cmd,
+       "graceful-restart",
+       OSPF_GR_STR)
+{
+  return ospf_gr_grace_period_set (vty, OSPF_GR_GRACE_PERIOD_DEFAULT);
+}
+
+DEFUN (ospf_graceful_restart_grace_period,
+       ospf_graceful_restart_grace_period_cmd,
+       "graceful-restart grace-period <1-1800>",
+       OSPF_GR_STR
+       "Time neighbors and zebra keep our routes while we restart\n"
+       "Seconds\n")
+{
+  u_int16_t grace_period;
+
+  VTY_GET_INTEGER_RANGE ("grace period", grace_period, argv[0],
+			 1, OSPF_GR_GRACE_PERIOD_MAX);
+  return ospf_gr_grace_period_set (vty, grace_period);
+}
+
+DEFUN (no_ospf_graceful_restart,
+       no_ospf_graceful_restart_cmd,
+       "no graceful-restart",
+       NO_STR
+       OSPF_GR_STR)
+{
+  return ospf_gr_grace_period_set (vty, 0);
+}
+
+ALIAS (no_ospf_graceful_restart,
+       no_ospf_graceful_restart_grace_period_cmd,
+       "no graceful-restart grace-period <1-1800>",
+       NO_STR
+       OSPF_GR_STR
+       "Time neighbors and zebra keep our routes while we restart\n"
+       "Seconds\n")
+
+DEFUN (ospf_graceful_restart_helper,
+       ospf_graceful_restart_helper_cmd,
+       "graceful-restart helper",
+       OSPF_GR_STR
+       "Help neighbors restart gracefully\n")
+{
+  struct ospf *ospf = vty->index;
+
+  ospf->gr_helper = 1;
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_ospf_graceful_restart_helper,
+       no_ospf_graceful_restart_helper_cmd,
+       "no graceful-restart helper",
+       NO_STR
+       OSPF_GR_STR
+       "Help neighbors restart gracefully\n")
+{
+  struct ospf *ospf = vty->index;
+  struct listnode *node;
+  struct ospf_interface *oi;
+  struct route_node *rn;
+  struct ospf_neighbor *nbr;
+
+  ospf->gr_helper = 0;
+  for (ALL_LIST_ELEMENTS_RO (ospf->oiflist, node, oi))
+    for (rn = route_top (oi->nbrs); rn; rn = route_next (rn))
+      if ((nbr = rn->info) != NULL)
+	ospf_gr_helper_exit (nbr, "helper mode turned off");
+  return CMD_SUCCESS;
+}
+
+void
+ospf_gr_finish (struct ospf *ospf)
+{
+  OSPF_TIMER_OFF (ospf->t_gr_restart);
+  OSPF_TIMER_OFF (ospf->t_gr_event);
+
+  /* Not going for a restart, zebra is not to keep our routes. */
+  if (ospf->gr_state != OSPF_GR_SHUTDOWN)
+    ospf_zebra_graceful_restart_update (0);
+}
+
+void
+ospf_gr_init (void)
+{
+  ospf_register_opaque_functab (OSPF_OPAQUE_LINK_LSA, OPAQUE_TYPE_GRACE_LSA,
+				NULL,	/* new interface */
+				NULL,	/* del interface */
+				NULL,	/* ISM change */
+				ospf_gr_nsm_change,
+				ospf_gr_config_write_router,
+				NULL,	/* Config. write interface */
+				NULL,	/* Config. write debug */
+				ospf_gr_show_info,
+				NULL,	/* originator, grace-LSAs are sent */
+				NULL,	/* refresher, nor refreshed */
+				NULL,	/* new_lsa_hook */
+				NULL);	/* del_lsa_hook */
+
+  install_element (OSPF_NODE, &ospf_graceful_restart_cmd);
+  install_element (OSPF_NODE, &ospf_graceful_restart_grace_period_cmd);
+  install_element (OSPF_NODE, &no_ospf_graceful_restart_cmd);
+  install_element (OSPF_NODE, &no_ospf_graceful_restart_grace_period_cmd);
+  install_element (OSPF_NODE, &ospf_graceful_restart_helper_cmd);
+  install_element (OSPF_NODE, &no_ospf_graceful_restart_helper_cmd);
+}
@@ -0,0 +1,75 @@
+/* OSPF graceful restart, RFC 3623
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the
+Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston,
+MA 02111-1307, USA.  */
+
+#ifndef _QUAGGA_OSPF_GR_H
+#define _QUAGGA_OSPF_GR_H
+
+/* Grace-LSA, a link-local opaque-LSA of opaque type 3 and ID 0, its
+   TLVs as in RFC 3623 appendix A. */
+#define GR_TLV_GRACE_PERIOD	1
+#define GR_TLV_REASON		2
+#define GR_TLV_IF_ADDRESS	3
+
+#define GR_REASON_UNKNOWN	0
+#define GR_REASON_RESTART	1
+#define GR_REASON_RELOAD	2
+#define GR_REASON_SWITCHOVER	3
+
+#define OSPF_GR_GRACE_PERIOD_DEFAULT	120
+#define OSPF_GR_GRACE_PERIOD_MAX	1800
+
+/* Seconds going down waits at most for grace-LSAs to be acknowledged. */
+#define OSPF_GR_SHUTDOWN_WAIT	5
+
+/* What a grace-LSA says. */
+struct ospf_gr_info
+{
+  u_int32_t grace_period;
+  u_char reason;
+  struct in_addr if_address;	/* 0 if not given. */
+};
+
+extern const char *ospf_gr_state_file;
+
+/* Whether the LSAs are those from before a graceful restart, not to
+   be originated afresh. */
+#define OSPF_GR_IS_RESTARTING(O)	((O)->gr_state == OSPF_GR_RESTARTING)
+
+extern void ospf_gr_init (void);
+extern void ospf_gr_startup (void);
+extern void ospf_gr_finish (struct ospf *);
+
+extern struct ospf_lsa *ospf_gr_lsa_new (struct ospf_interface *,
+					 u_int32_t, u_char);
+extern int ospf_gr_lsa_parse (struct lsa_header *, struct ospf_gr_info *);
+extern void ospf_gr_lsa_change (struct ospf *, struct ospf_lsa *);
+extern int ospf_gr_self_lsa_received (struct ospf_neighbor *,
+				      struct ospf_lsa *);
+
+/* Restarting router. */
+extern int ospf_gr_shutdown (struct ospf *);
+extern int ospf_gr_shutdown_done (struct ospf *);
+extern void ospf_gr_restart_begin (struct ospf *, unsigned long);
+extern void ospf_gr_restart_check (struct ospf *);
+extern void ospf_gr_restart_exit (struct ospf *, const char *);
+
+/* Helper. */
+extern void ospf_gr_helper_exit (struct ospf_neighbor *, const char *);
+
+#endif /* _QUAGGA_OSPF_GR_H */
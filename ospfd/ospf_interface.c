@@ -328,6 +328,9 @@ ospf_if_free (struct ospf_interface *oi)
 
   ospf_opaque_type9_lsa_term (oi);
 
+  /* The trees kept for incremental SPF may have nexthops through it. */
+  ospf_spf_tree_flush (oi->ospf);
+
   /* Free Pseudo Neighbour */
   ospf_nbr_delete (oi->nbr_self);
   
@@ -1029,7 +1032,6 @@ ospf_vl_set_params (struct ospf_vl_data *vl_data, struct vertex *v)
 {
   int changed = 0;
   struct ospf_interface *voi;
-  struct listnode *node;
   struct vertex_parent *vp = NULL;
   unsigned int i;
   struct router_lsa *rl;
@@ -1043,7 +1045,7 @@ ospf_vl_set_params (struct ospf_vl_data *vl_data, struct vertex *v)
       changed = 1;
     }
 
-  for (ALL_LIST_ELEMENTS_RO (v->parents, node, vp))
+  for (vp = v->parents; vp; vp = vp->next)
     {
       vl_data->nexthop.oi = vp->nexthop->oi;
       vl_data->nexthop.router = vp->nexthop->router;
@@ -213,7 +213,7 @@ struct ospf_interface
   struct thread *t_wait;                /* timer */
   struct thread *t_ls_ack;              /* timer */
   struct thread *t_ls_ack_direct;       /* event */
-  struct thread *t_ls_upd_event;        /* event */
+  struct thread *t_ls_upd_event;        /* event, or flood pacing timer */
   struct thread *t_opaque_lsa_self;     /* Type-9 Opaque-LSAs */
 
   int on_write_q;
@@ -227,6 +227,11 @@ struct ospf_interface
   u_int32_t ls_req_out;         /* LS request message output count. */
   u_int32_t ls_upd_in;          /* LS update message input count. */
   u_int32_t ls_upd_out;         /* LS update message output count. */
+  u_int32_t ls_upd_lsa_out;     /* LSAs sent in LS updates. */
+  u_int64_t ls_upd_octets_out;  /* Octets of LSAs sent in LS updates. */
+  u_int32_t ls_upd_queue_count; /* LSAs in ls_upd_queue. */
+  u_int32_t ls_upd_queue_octets; /* Octets of LSAs in ls_upd_queue. */
+  u_int32_t ls_upd_queue_max;   /* Most LSAs ls_upd_queue held. */
   u_int32_t ls_ack_in;          /* LS Ack message input count. */
   u_int32_t ls_ack_out;         /* LS Ack message output count. */
   u_int32_t discarded;		/* discarded input count by error. */
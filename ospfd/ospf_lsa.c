@@ -50,6 +50,7 @@
 #include "ospfd/ospf_ase.h"
 #include "ospfd/ospf_zebra.h"
 #include "ospfd/ospf_abr.h"
+#include "ospfd/ospf_gr.h"
 
 
 u_int32_t
@@ -231,7 +232,7 @@ ospf_lsa_new ()
   new->retransmit_counter = 0;
   new->tv_recv = recent_relative_time ();
   new->tv_orig = new->tv_recv;
-  new->refresh_list = -1;
+  new->wheel_slot = -1;
   
   return new;
 }
@@ -251,13 +252,18 @@ ospf_lsa_dup (struct ospf_lsa *lsa)
   UNSET_FLAG (new->flags, OSPF_LSA_DISCARD);
   new->lock = 1;
   new->retransmit_counter = 0;
+  new->rxmt_map = NULL;
+  new->rxmt_words = 0;
+  new->link_index = NULL;
+  new->link_index_mask = 0;
   new->data = ospf_lsa_data_dup (lsa->data);
 
-  /* kevinm: Clear the refresh_list, otherwise there are going
+  /* kevinm: Clear the wheel slot, otherwise there are going
      to be problems when we try to remove the LSA from the
-     queue (which it's not a member of.)
-     XXX: Should we add the LSA to the refresh_list queue? */
-  new->refresh_list = -1;
+     wheel (which it's not a member of.)
+     XXX: Should we add the LSA to the refresh list? */
+  new->wheel_slot = -1;
+  new->wheel_prev = new->wheel_next = NULL;
 
   if (IS_DEBUG_OSPF (lsa, LSA))
     zlog_debug ("LSA: duplicated %p (new: %p)", (void *)lsa, (void *)new);
@@ -278,7 +284,12 @@ ospf_lsa_free (struct ospf_lsa *lsa)
   if (lsa->data != NULL)
     ospf_lsa_data_free (lsa->data);
 
-  assert (lsa->refresh_list < 0);
+  assert (lsa->wheel_slot < 0);
+
+  if (lsa->rxmt_map != NULL)
+    XFREE (MTYPE_OSPF_LSA_RXMT, lsa->rxmt_map);
+  if (lsa->link_index != NULL)
+    XFREE (MTYPE_OSPF_LSA_LINKS, lsa->link_index);
 
   memset (lsa, 0, sizeof (struct ospf_lsa)); 
   XFREE (MTYPE_OSPF_LSA, lsa);
@@ -466,7 +477,7 @@ ospf_nbr_lookup_ptop (struct ospf_interface *oi)
   for (rn = route_top (oi->nbrs); rn; rn = route_next (rn))
     if ((nbr = rn->info))
       if (!IPV4_ADDR_SAME (&nbr->router_id, &oi->ospf->router_id))
-	if (nbr->state == NSM_Full)
+	if (NBR_IS_ADJACENT (nbr))
 	  {
 	    route_unlock_node (rn);
 	    break;
@@ -551,7 +562,7 @@ lsa_link_ptop_set (struct stream *s, struct ospf_interface *oi)
     zlog_debug ("LSA[Type1]: Set link Point-to-Point");
 
   if ((nbr = ospf_nbr_lookup_ptop (oi)))
-    if (nbr->state == NSM_Full)
+    if (NBR_IS_ADJACENT (nbr))
       {
 	/* For unnumbered point-to-point networks, the Link Data field
 	   should specify the interface's MIB-II ifIndex value. */
@@ -591,9 +602,9 @@ lsa_link_broadcast_set (struct stream *s, struct ospf_interface *oi)
 
   dr = ospf_nbr_lookup_by_addr (oi->nbrs, &DR (oi));
   /* Describe Type 2 link. */
-  if (dr && (dr->state == NSM_Full ||
+  if (dr && (NBR_IS_ADJACENT (dr) ||
 	     IPV4_ADDR_SAME (&oi->address->u.prefix4, &DR (oi))) &&
-      ospf_nbr_count (oi, NSM_Full) > 0)
+      ospf_nbr_count_adjacent (oi) > 0)
     {
       if (IS_DEBUG_OSPF (lsa, LSA_GENERATE))
         zlog_debug ("LSA[Type1]: Interface %s has a DR. "
@@ -637,7 +648,7 @@ lsa_link_virtuallink_set (struct stream *s, struct ospf_interface *oi)
 
   if (oi->state == ISM_PointToPoint)
     if ((nbr = ospf_nbr_lookup_ptop (oi)))
-      if (nbr->state == NSM_Full)
+      if (NBR_IS_ADJACENT (nbr))
 	{
 	  return link_info_set (s, nbr->router_id, oi->address->u.prefix4,
 			        LSA_LINK_TYPE_VIRTUALLINK, 0, cost);
@@ -673,7 +684,7 @@ lsa_link_ptomp_set (struct stream *s, struct ospf_interface *oi)
     if ((nbr = rn->info) != NULL)
       /* Ignore myself. */
       if (!IPV4_ADDR_SAME (&nbr->router_id, &oi->ospf->router_id))
-	if (nbr->state == NSM_Full)
+	if (NBR_IS_ADJACENT (nbr))
 
 	  {
 	    links += link_info_set (s, nbr->router_id, oi->address->u.prefix4,
@@ -954,6 +965,10 @@ ospf_router_lsa_update_area (struct ospf_area *area)
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("[router-LSA]: (router-LSA area update)");
 
+  /* Restarting gracefully, the router-LSA from before stays. */
+  if (OSPF_GR_IS_RESTARTING (area->ospf))
+    return 0;
+
   /* Now refresh router-LSA. */
   if (area->router_lsa_self)
     ospf_lsa_refresh (area->ospf, area->router_lsa_self);
@@ -973,6 +988,9 @@ ospf_router_lsa_update (struct ospf *ospf)
   if (IS_DEBUG_OSPF (lsa, LSA_GENERATE))
     zlog_debug ("Timer[router-LSA Update]: (timer expire)");
 
+  if (OSPF_GR_IS_RESTARTING (ospf))
+    return 0;
+
   for (ALL_LIST_ELEMENTS (ospf->areas, node, nnode, area))
     {
       struct ospf_lsa *lsa = area->router_lsa_self;
@@ -1037,7 +1055,7 @@ ospf_network_lsa_body_set (struct stream *s, struct ospf_interface *oi)
 
   for (rn = route_top (oi->nbrs); rn; rn = route_next (rn))
     if ((nbr = rn->info) != NULL)
-      if (nbr->state == NSM_Full || nbr == oi->nbr_self)
+      if (NBR_IS_ADJACENT (nbr) || nbr == oi->nbr_self)
 	stream_put_ipv4 (s, nbr->router_id.s_addr);
 }
 
@@ -1052,7 +1070,7 @@ ospf_network_lsa_new (struct ospf_interface *oi)
 
   /* If there are no neighbours on this network (the net is stub),
      the router does not originate network-LSA (see RFC 12.4.2) */
-  if (oi->full_nbrs == 0)
+  if (ospf_nbr_count_adjacent (oi) == 0)
     return NULL;
   
   if (IS_DEBUG_OSPF (lsa, LSA_GENERATE))
@@ -1112,6 +1130,9 @@ ospf_network_lsa_update (struct ospf_interface *oi)
 {
   struct ospf_lsa *new;
   
+  if (OSPF_GR_IS_RESTARTING (oi->ospf))
+    return;
+
   if (oi->network_lsa_self != NULL)
     {
       ospf_lsa_refresh (oi->ospf, oi->network_lsa_self);
@@ -2055,6 +2076,10 @@ ospf_external_lsa_originate (struct ospf *ospf, struct external_info *ei)
 
      */
   
+  /* Restarting gracefully, originated on exit from the restart. */
+  if (OSPF_GR_IS_RESTARTING (ospf))
+    return NULL;
+
   /* Check the AS-external-LSA should be originated. */
   if (!ospf_redistribute_check (ospf, ei, NULL))
     return NULL;
@@ -2325,6 +2350,9 @@ ospf_external_lsa_refresh (struct ospf *ospf, struct ospf_lsa *lsa,
   struct ospf_lsa *new;
   int changed;
   
+  if (OSPF_GR_IS_RESTARTING (ospf))
+    return NULL;
+
   /* Check the AS-external-LSA should be originated. */
   if (!ospf_redistribute_check (ospf, ei, &changed))
     {
@@ -2587,7 +2615,7 @@ ospf_discard_from_db (struct ospf *ospf,
   if (!old)
     return;
 
-  if (old->refresh_list >= 0)
+  if (old->wheel_slot >= 0 && old->wheel_list == OSPF_LSA_WHEEL_REFRESH)
     ospf_refresher_unregister_lsa (ospf, old);
 
   switch (old->data->type)
@@ -2713,6 +2741,16 @@ ospf_lsa_install (struct ospf *ospf, struct ospf_interface *oi,
         }
     }
 
+  /* Note what changed for the next shortest-path calculation, which
+     looks links up by ID. */
+  if (lsa->data->type == OSPF_ROUTER_LSA
+      || lsa->data->type == OSPF_NETWORK_LSA)
+    {
+      ospf_spf_lsa_index (lsa);
+      if (rt_recalc)
+        ospf_spf_lsa_update (lsa->area, old, lsa);
+    }
+
   /* discard old LSA from LSDB */
   if (old != NULL)
     ospf_discard_from_db (ospf, lsdb, lsa);
@@ -2765,6 +2803,11 @@ ospf_lsa_install (struct ospf *ospf, struct ospf_interface *oi,
   if (new == NULL)
     return new;  /* Installation failed, cannot proceed further -- endo. */
 
+  /* Graceful restart, either side, watches the changes; a helper
+     decides again on each new instance of a grace-LSA. */
+  if (rt_recalc || new->data->type == OSPF_OPAQUE_LINK_LSA)
+    ospf_gr_lsa_change (ospf, new);
+
   /* Debug logs. */
   if (IS_DEBUG_OSPF (lsa, LSA_INSTALL))
     {
@@ -2990,6 +3033,100 @@ ospf_lsa_maxage (struct ospf *ospf, struct ospf_lsa *lsa)
                  ospf->maxage_delay);
 }
 
+/* The LSA wheel. */
+
+/* Put the LSA on the list of the slot for time due, or of the next
+   slot the walker of the list goes through if that is later. */
+static void
+ospf_lsa_wheel_add (struct ospf *ospf, struct ospf_lsa *lsa, int list,
+		    time_t due)
+{
+  time_t done = ospf->lsa_wheel.done[list];
+  time_t slot;
+  int i;
+
+  assert (lsa->wheel_slot < 0);
+
+  slot = (due + OSPF_LSA_WHEEL_GRANULARITY - 1) / OSPF_LSA_WHEEL_GRANULARITY;
+  if (slot <= done)
+    slot = done + 1;
+  else if (slot >= done + OSPF_LSA_WHEEL_SLOTS)
+    slot = done + OSPF_LSA_WHEEL_SLOTS - 1;
+  i = slot % OSPF_LSA_WHEEL_SLOTS;
+
+  lsa->wheel_slot = i;
+  lsa->wheel_list = list;
+  lsa->wheel_prev = NULL;
+  lsa->wheel_next = ospf->lsa_wheel.slots[list][i];
+  if (lsa->wheel_next)
+    lsa->wheel_next->wheel_prev = lsa;
+  ospf->lsa_wheel.slots[list][i] = lsa;
+  ospf->lsa_wheel.count[list]++;
+}
+
+static void
+ospf_lsa_wheel_delete (struct ospf *ospf, struct ospf_lsa *lsa)
+{
+  if (lsa->wheel_prev)
+    lsa->wheel_prev->wheel_next = lsa->wheel_next;
+  else
+    ospf->lsa_wheel.slots[lsa->wheel_list][lsa->wheel_slot] = lsa->wheel_next;
+  if (lsa->wheel_next)
+    lsa->wheel_next->wheel_prev = lsa->wheel_prev;
+
+  lsa->wheel_prev = lsa->wheel_next = NULL;
+  lsa->wheel_slot = -1;
+  ospf->lsa_wheel.count[lsa->wheel_list]--;
+}
+
+/* Take the next LSA off the list in the slots up to the current time,
+   NULL once there are none.  LSAs put back while walking go into
+   later slots. */
+static struct ospf_lsa *
+ospf_lsa_wheel_next (struct ospf *ospf, int list)
+{
+  time_t now = recent_relative_time ().tv_sec / OSPF_LSA_WHEEL_GRANULARITY;
+  time_t *done = &ospf->lsa_wheel.done[list];
+  struct ospf_lsa *lsa;
+
+  /* Every slot once is enough after a long time without a walk. */
+  if (now - *done > OSPF_LSA_WHEEL_SLOTS)
+    *done = now - OSPF_LSA_WHEEL_SLOTS;
+
+  for (;;)
+    {
+      if ((lsa = ospf->lsa_wheel.slots[list][*done % OSPF_LSA_WHEEL_SLOTS]))
+	{
+	  ospf_lsa_wheel_delete (ospf, lsa);
+	  return lsa;
+	}
+      if (*done >= now)
+	return NULL;
+      (*done)++;
+    }
+}
+
+/* Index an LSA of the database by when it reaches MaxAge.  LSAs
+   registered for refresh are not, nor are other self-originated
+   LSAs: they are flushed explicitly. */
+void
+ospf_lsa_age_register (struct ospf *ospf, struct ospf_lsa *lsa)
+{
+  if (lsa->wheel_slot >= 0 || IS_LSA_SELF (lsa))
+    return;
+
+  ospf_lsa_wheel_add (ospf, lsa, OSPF_LSA_WHEEL_MAXAGE,
+		      lsa->tv_recv.tv_sec + 1
+		      + OSPF_LSA_MAXAGE - ntohs (lsa->data->ls_age));
+}
+
+void
+ospf_lsa_age_unregister (struct ospf *ospf, struct ospf_lsa *lsa)
+{
+  if (lsa->wheel_slot >= 0 && lsa->wheel_list == OSPF_LSA_WHEEL_MAXAGE)
+    ospf_lsa_wheel_delete (ospf, lsa);
+}
+
 static int
 ospf_lsa_maxage_walker_remover (struct ospf *ospf, struct ospf_lsa *lsa)
 {
@@ -2997,84 +3134,64 @@ ospf_lsa_maxage_walker_remover (struct ospf *ospf, struct ospf_lsa *lsa)
   if (CHECK_FLAG (lsa->flags, OSPF_LSA_LOCAL_XLT))
     return 0;
 
-  if (IS_LSA_MAXAGE (lsa))
-    /* Self-originated LSAs should NOT time-out instead,
-       they're flushed and submitted to the max_age list explicitly. */
-    if (!ospf_lsa_is_self_originated (ospf, lsa))
-      {
-	if (IS_DEBUG_OSPF (lsa, LSA_FLOODING))
-	  zlog_debug("LSA[%s]: is MaxAge", dump_lsa_key (lsa));
+  /* Self-originated LSAs should NOT time-out instead,
+     they're flushed and submitted to the max_age list explicitly. */
+  if (ospf_lsa_is_self_originated (ospf, lsa))
+    return 0;
 
-        switch (lsa->data->type)
-          {
-          case OSPF_OPAQUE_LINK_LSA:
-          case OSPF_OPAQUE_AREA_LSA:
-          case OSPF_OPAQUE_AS_LSA:
-            /*
-             * As a general rule, whenever network topology has changed
-             * (due to an LSA removal in this case), routing recalculation
-             * should be triggered. However, this is not true for opaque
-             * LSAs. Even if an opaque LSA instance is going to be removed
-             * from the routing domain, it does not mean a change in network
-             * topology, and thus, routing recalculation is not needed here.
-             */
-            break;
-          case OSPF_AS_EXTERNAL_LSA:
-          case OSPF_AS_NSSA_LSA:
-	    ospf_ase_incremental_update (ospf, lsa);
-            break;
-          default:
-	    ospf_spf_calculate_schedule (ospf, SPF_FLAG_MAXAGE);
-            break;
-          }
-	ospf_lsa_maxage (ospf, lsa);
-      }
+  /* Not there yet, by the odd second. */
+  if (! IS_LSA_MAXAGE (lsa))
+    {
+      ospf_lsa_age_register (ospf, lsa);
+      return 0;
+    }
+
+  if (IS_DEBUG_OSPF (lsa, LSA_FLOODING))
+    zlog_debug("LSA[%s]: is MaxAge", dump_lsa_key (lsa));
 
-  if (IS_LSA_MAXAGE (lsa) && !ospf_lsa_is_self_originated (ospf, lsa))
-    if (LS_AGE (lsa) > OSPF_LSA_MAXAGE + 30)
-      printf ("Eek! Shouldn't happen!\n");
+  switch (lsa->data->type)
+    {
+    case OSPF_OPAQUE_LINK_LSA:
+    case OSPF_OPAQUE_AREA_LSA:
+    case OSPF_OPAQUE_AS_LSA:
+      /*
+       * As a general rule, whenever network topology has changed
+       * (due to an LSA removal in this case), routing recalculation
+       * should be triggered. However, this is not true for opaque
+       * LSAs. Even if an opaque LSA instance is going to be removed
+       * from the routing domain, it does not mean a change in network
+       * topology, and thus, routing recalculation is not needed here.
+       */
+      break;
+    case OSPF_AS_EXTERNAL_LSA:
+    case OSPF_AS_NSSA_LSA:
+      ospf_ase_incremental_update (ospf, lsa);
+      break;
+    case OSPF_ROUTER_LSA:
+    case OSPF_NETWORK_LSA:
+      ospf_spf_lsa_update (lsa->area, lsa, NULL);
+      /* Fallthrough */
+    default:
+      ospf_spf_calculate_schedule (ospf, SPF_FLAG_MAXAGE);
+      break;
+    }
+  ospf_lsa_maxage (ospf, lsa);
 
   return 0;
 }
 
-/* Periodical check of MaxAge LSA. */
+/* Periodical check of MaxAge LSA: only those the wheel has reaching
+   MaxAge since the last check are looked at. */
 int
 ospf_lsa_maxage_walker (struct thread *thread)
 {
   struct ospf *ospf = THREAD_ARG (thread);
-  struct route_node *rn;
   struct ospf_lsa *lsa;
-  struct ospf_area *area;
-  struct listnode *node, *nnode;
 
   ospf->t_maxage_walker = NULL;
 
-  for (ALL_LIST_ELEMENTS (ospf->areas, node, nnode, area))
-    {
-      LSDB_LOOP (ROUTER_LSDB (area), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-      LSDB_LOOP (NETWORK_LSDB (area), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-      LSDB_LOOP (SUMMARY_LSDB (area), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-      LSDB_LOOP (ASBR_SUMMARY_LSDB (area), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-      LSDB_LOOP (OPAQUE_AREA_LSDB (area), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-      LSDB_LOOP (OPAQUE_LINK_LSDB (area), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-      LSDB_LOOP (NSSA_LSDB (area), rn, lsa)
-        ospf_lsa_maxage_walker_remover (ospf, lsa);
-    }
-
-  /* for AS-external-LSAs. */
-  if (ospf->lsdb)
-    {
-      LSDB_LOOP (EXTERNAL_LSDB (ospf), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-      LSDB_LOOP (OPAQUE_AS_LSDB (ospf), rn, lsa)
-	ospf_lsa_maxage_walker_remover (ospf, lsa);
-    }
+  while ((lsa = ospf_lsa_wheel_next (ospf, OSPF_LSA_WHEEL_MAXAGE)))
+    ospf_lsa_maxage_walker_remover (ospf, lsa);
 
   OSPF_TIMER_ON (ospf->t_maxage_walker, ospf_lsa_maxage_walker,
 		 OSPF_LSA_MAXAGE_CHECK_INTERVAL);
@@ -3145,19 +3262,31 @@ ospf_lsa_lookup_by_id (struct ospf_area *area, u_int32_t type,
 {
   struct ospf_lsa *lsa;
   struct route_node *rn;
+  struct prefix_ls lp;
 
   switch (type)
     {
     case OSPF_ROUTER_LSA:
       return ospf_lsdb_lookup_by_id (area->lsdb, type, id, id);
     case OSPF_NETWORK_LSA:
-      for (rn = route_top (NETWORK_LSDB (area)); rn; rn = route_next (rn))
+      /* Whichever router advertises it: the table is keyed by ID, then
+       * advertising router, so the instances of an ID follow its /32.
+       */
+      memset (&lp, 0, sizeof (struct prefix_ls));
+      lp.prefixlen = 32;
+      lp.id = id;
+      for (rn = route_table_get_next (NETWORK_LSDB (area),
+                                      (struct prefix *) &lp);
+           rn && rn->p.prefixlen >= lp.prefixlen
+              && prefix_match ((struct prefix *) &lp, &rn->p);
+           rn = route_next (rn))
 	if ((lsa = rn->info))
-	  if (IPV4_ADDR_SAME (&lsa->data->id, &id))
-	    {
-	      route_unlock_node (rn);
-	      return lsa;
-	    }
+	  {
+	    route_unlock_node (rn);
+	    return lsa;
+	  }
+      if (rn)
+        route_unlock_node (rn);
       break;
     case OSPF_SUMMARY_LSA:
     case OSPF_ASBR_SUMMARY_LSA:
@@ -3597,6 +3726,11 @@ ospf_lsa_refresh (struct ospf *ospf, struct ospf_lsa *lsa)
   assert (IS_LSA_SELF (lsa));
   assert (lsa->lock > 0);
 
+  /* Restarting gracefully, only the opaque LSAs (grace-LSAs among them)
+     are originated before the restart is over. */
+  if (OSPF_GR_IS_RESTARTING (ospf) && !IS_OPAQUE_LSA (lsa->data->type))
+    return NULL;
+
   switch (lsa->data->type)
     {
       /* Router and Network LSAs are processed differently. */
@@ -3638,46 +3772,39 @@ ospf_lsa_refresh (struct ospf *ospf, struct ospf_lsa *lsa)
 void
 ospf_refresher_register_lsa (struct ospf *ospf, struct ospf_lsa *lsa)
 {
-  u_int16_t index, current_index;
-  
+  int delay;
+
   assert (lsa->lock > 0);
   assert (IS_LSA_SELF (lsa));
 
-  if (lsa->refresh_list < 0)
+  if (lsa->wheel_slot >= 0)
     {
-      int delay;
-
-      if (LS_AGE (lsa) == 0 &&
-	  ntohl (lsa->data->ls_seqnum) == OSPF_INITIAL_SEQUENCE_NUMBER)
-	/* Randomize first update by  OSPF_LS_REFRESH_SHIFT factor */ 
-	delay = OSPF_LS_REFRESH_SHIFT + (random () % OSPF_LS_REFRESH_TIME);
-      else
-	/* Randomize another updates by +-OSPF_LS_REFRESH_JITTER factor */
-	delay = OSPF_LS_REFRESH_TIME - LS_AGE (lsa) - OSPF_LS_REFRESH_JITTER
-	  + (random () % (2*OSPF_LS_REFRESH_JITTER)); 
+      if (lsa->wheel_list == OSPF_LSA_WHEEL_REFRESH)
+	return;
+      /* Self-originated now, it is refreshed rather than aged out. */
+      ospf_lsa_wheel_delete (ospf, lsa);
+    }
 
-      if (delay < 0)
-	delay = 0;
+  if (LS_AGE (lsa) == 0 &&
+      ntohl (lsa->data->ls_seqnum) == OSPF_INITIAL_SEQUENCE_NUMBER)
+    /* Randomize first update by  OSPF_LS_REFRESH_SHIFT factor */ 
+    delay = OSPF_LS_REFRESH_SHIFT + (random () % OSPF_LS_REFRESH_TIME);
+  else
+    /* Randomize another updates by +-OSPF_LS_REFRESH_JITTER factor */
+    delay = OSPF_LS_REFRESH_TIME - LS_AGE (lsa) - OSPF_LS_REFRESH_JITTER
+      + (random () % (2*OSPF_LS_REFRESH_JITTER)); 
 
-      current_index = ospf->lsa_refresh_queue.index + (quagga_time (NULL)
-                - ospf->lsa_refresher_started)/OSPF_LSA_REFRESHER_GRANULARITY;
-      
-      index = (current_index + delay/OSPF_LSA_REFRESHER_GRANULARITY)
-	      % (OSPF_LSA_REFRESHER_SLOTS);
+  if (delay < 0)
+    delay = 0;
 
-      if (IS_DEBUG_OSPF (lsa, LSA_REFRESH))
-	zlog_debug ("LSA[Refresh]: lsa %s with age %d added to index %d",
-		   inet_ntoa (lsa->data->id), LS_AGE (lsa), index);
-      if (!ospf->lsa_refresh_queue.qs[index])
-	ospf->lsa_refresh_queue.qs[index] = list_new ();
-      listnode_add (ospf->lsa_refresh_queue.qs[index],
-                    ospf_lsa_lock (lsa)); /* lsa_refresh_queue */
-      lsa->refresh_list = index;
-      if (IS_DEBUG_OSPF (lsa, LSA_REFRESH))
-        zlog_debug ("LSA[Refresh:%s]: ospf_refresher_register_lsa(): "
-                   "setting refresh_list on lsa %p (slod %d)", 
-                   inet_ntoa (lsa->data->id), (void *)lsa, index);
-    }
+  ospf_lsa_wheel_add (ospf, ospf_lsa_lock (lsa), /* lsa_wheel */
+		      OSPF_LSA_WHEEL_REFRESH,
+		      recent_relative_time ().tv_sec + delay);
+  if (IS_DEBUG_OSPF (lsa, LSA_REFRESH))
+    zlog_debug ("LSA[Refresh:%s]: ospf_refresher_register_lsa(): "
+		"lsa %p with age %d added to slot %d",
+		inet_ntoa (lsa->data->id), (void *)lsa, LS_AGE (lsa),
+		lsa->wheel_slot);
 }
 
 void
@@ -3685,78 +3812,33 @@ ospf_refresher_unregister_lsa (struct ospf *ospf, struct ospf_lsa *lsa)
 {
   assert (lsa->lock > 0);
   assert (IS_LSA_SELF (lsa));
-  if (lsa->refresh_list >= 0)
+  if (lsa->wheel_slot >= 0 && lsa->wheel_list == OSPF_LSA_WHEEL_REFRESH)
     {
-      struct list *refresh_list = ospf->lsa_refresh_queue.qs[lsa->refresh_list];
-      listnode_delete (refresh_list, lsa);
-      if (!listcount (refresh_list))
-	{
-	  list_free (refresh_list);
-	  ospf->lsa_refresh_queue.qs[lsa->refresh_list] = NULL;
-	}
-      ospf_lsa_unlock (&lsa); /* lsa_refresh_queue */
-      lsa->refresh_list = -1;
+      ospf_lsa_wheel_delete (ospf, lsa);
+      ospf_lsa_unlock (&lsa); /* lsa_wheel */
     }
 }
 
 int
 ospf_lsa_refresh_walker (struct thread *t)
 {
-  struct list *refresh_list;
   struct listnode *node, *nnode;
   struct ospf *ospf = THREAD_ARG (t);
   struct ospf_lsa *lsa;
-  int i;
   struct list *lsa_to_refresh = list_new ();
 
   if (IS_DEBUG_OSPF (lsa, LSA_REFRESH))
     zlog_debug ("LSA[Refresh]:ospf_lsa_refresh_walker(): start");
 
-  
-  i = ospf->lsa_refresh_queue.index;
-  
-  /* Note: if clock has jumped backwards, then time change could be negative,
-     so we are careful to cast the expression to unsigned before taking
-     modulus. */
-  ospf->lsa_refresh_queue.index =
-   ((unsigned long)(ospf->lsa_refresh_queue.index +
-		    (quagga_time (NULL) - ospf->lsa_refresher_started)
-		    / OSPF_LSA_REFRESHER_GRANULARITY))
-		    % OSPF_LSA_REFRESHER_SLOTS;
-
-  if (IS_DEBUG_OSPF (lsa, LSA_REFRESH))
-    zlog_debug ("LSA[Refresh]: ospf_lsa_refresh_walker(): next index %d",
-	       ospf->lsa_refresh_queue.index);
-
-  for (;i != ospf->lsa_refresh_queue.index;
-       i = (i + 1) % OSPF_LSA_REFRESHER_SLOTS)
+  /* The lock of the wheel goes with the LSA to lsa_to_refresh. */
+  while ((lsa = ospf_lsa_wheel_next (ospf, OSPF_LSA_WHEEL_REFRESH)))
     {
       if (IS_DEBUG_OSPF (lsa, LSA_REFRESH))
-	zlog_debug ("LSA[Refresh]: ospf_lsa_refresh_walker(): "
-	           "refresh index %d", i);
+	zlog_debug ("LSA[Refresh:%s]: ospf_lsa_refresh_walker(): "
+		    "refresh lsa %p", inet_ntoa (lsa->data->id), (void *)lsa);
 
-      refresh_list = ospf->lsa_refresh_queue.qs [i];
-      
-      assert (i >= 0);
-
-      ospf->lsa_refresh_queue.qs [i] = NULL;
-
-      if (refresh_list)
-	{
-	  for (ALL_LIST_ELEMENTS (refresh_list, node, nnode, lsa))
-	    {
-	      if (IS_DEBUG_OSPF (lsa, LSA_REFRESH))
-		zlog_debug ("LSA[Refresh:%s]: ospf_lsa_refresh_walker(): "
-		           "refresh lsa %p (slot %d)",
-		           inet_ntoa (lsa->data->id), (void *)lsa, i);
-
-	      assert (lsa->lock > 0);
-	      list_delete_node (refresh_list, node);
-	      lsa->refresh_list = -1;
-	      listnode_add (lsa_to_refresh, lsa);
-	    }
-	  list_free (refresh_list);
-	}
+      assert (lsa->lock > 0);
+      listnode_add (lsa_to_refresh, lsa);
     }
 
   ospf->t_lsa_refresher = thread_add_timer (master, ospf_lsa_refresh_walker,
@@ -3767,7 +3849,7 @@ ospf_lsa_refresh_walker (struct thread *t)
     {
       ospf_lsa_refresh (ospf, lsa);
       assert (lsa->lock > 0);
-      ospf_lsa_unlock (&lsa); /* lsa_refresh_queue & temp for lsa_to_refresh*/
+      ospf_lsa_unlock (&lsa); /* lsa_wheel & temp for lsa_to_refresh*/
     }
   
   list_delete (lsa_to_refresh);
@@ -100,6 +100,18 @@ struct ospf_lsa
   /* References to this LSA in neighbor retransmission lists*/
   int retransmit_counter;
 
+  /* Which neighbors' retransmission lists the LSA is on, by their
+     slot, and which of their queues still hold it: two bitmaps of
+     rxmt_words words each, see ospf_flood.c. */
+  u_int32_t *rxmt_map;
+  u_int16_t rxmt_words;
+
+  /* Links of a router- or network-LSA to other vertices, hashed by
+     their ID, for the SPF calculation to find links back; see
+     ospf_spf.c. */
+  u_int16_t link_index_mask;
+  u_int32_t *link_index;
+
   /* Area the LSA belongs to, may be NULL if AS-external-LSA. */
   struct ospf_area *area;
 
@@ -109,8 +121,12 @@ struct ospf_lsa
   /* Related Route. */
   void *route;
 
-  /* Refreshement List or Queue */
-  int refresh_list;
+  /* Slot of ospf->lsa_wheel the LSA is on, -1 if none, and which of
+     its lists, OSPF_LSA_WHEEL_MAXAGE or OSPF_LSA_WHEEL_REFRESH. */
+  int wheel_slot;
+  u_char wheel_list;
+  struct ospf_lsa *wheel_prev;
+  struct ospf_lsa *wheel_next;
   
   /* For Type-9 Opaque-LSAs */
   struct ospf_interface *oi;
@@ -322,6 +338,8 @@ extern void ospf_schedule_lsa_flush_area (struct ospf_area *, struct ospf_lsa *)
 extern void ospf_refresher_register_lsa (struct ospf *, struct ospf_lsa *);
 extern void ospf_refresher_unregister_lsa (struct ospf *, struct ospf_lsa *);
 extern int ospf_lsa_refresh_walker (struct thread *);
+extern void ospf_lsa_age_register (struct ospf *, struct ospf_lsa *);
+extern void ospf_lsa_age_unregister (struct ospf *, struct ospf_lsa *);
 
 extern void ospf_lsa_maxage_delete (struct ospf *, struct ospf_lsa *);
 
@@ -26,6 +26,7 @@
 #include "table.h"
 #include "memory.h"
 #include "log.h"
+#include "jhash.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_asbr.h"
@@ -50,6 +51,8 @@ ospf_lsdb_init (struct ospf_lsdb *lsdb)
   
   for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++)
     lsdb->type[i].db = route_table_init ();
+  lsdb->index = NULL;
+  lsdb->index_mask = 0;
 }
 
 void
@@ -72,6 +75,105 @@ ospf_lsdb_cleanup (struct ospf_lsdb *lsdb)
     route_table_finish (lsdb->type[i].db);
 }
 
+/* The index is open-addressed with linear probing and kept at most
+   half full.  Deleting an LSA shifts later LSAs of its run back into
+   the hole, so that a lookup stops at the first empty slot. */
+#define OSPF_LSDB_INDEX_MIN	16
+
+static u_int32_t
+ospf_lsdb_index_key (u_char type, struct in_addr id,
+		     struct in_addr adv_router)
+{
+  return jhash_3words (type, id.s_addr, adv_router.s_addr, 0);
+}
+
+static struct ospf_lsa *
+ospf_lsdb_index_lookup (struct ospf_lsdb *lsdb, u_char type,
+			struct in_addr id, struct in_addr adv_router)
+{
+  struct ospf_lsdb_slot *slot;
+  struct lsa_header *lsah;
+  u_int32_t key, i;
+
+  if (lsdb->index == NULL)
+    return NULL;
+
+  key = ospf_lsdb_index_key (type, id, adv_router);
+  for (i = key & lsdb->index_mask; (slot = &lsdb->index[i])->lsa != NULL;
+       i = (i + 1) & lsdb->index_mask)
+    if (slot->key == key)
+      {
+	lsah = slot->lsa->data;
+	if (lsah->type == type
+	    && lsah->id.s_addr == id.s_addr
+	    && lsah->adv_router.s_addr == adv_router.s_addr)
+	  return slot->lsa;
+      }
+  return NULL;
+}
+
+static void
+ospf_lsdb_index_put (struct ospf_lsdb_slot *index, u_int32_t mask,
+		     u_int32_t key, struct ospf_lsa *lsa)
+{
+  u_int32_t i;
+
+  for (i = key & mask; index[i].lsa != NULL; i = (i + 1) & mask)
+    ;
+  index[i].key = key;
+  index[i].lsa = lsa;
+}
+
+static void
+ospf_lsdb_index_add (struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
+{
+  struct ospf_lsdb_slot *old = lsdb->index;
+  u_int32_t size, i;
+
+  /* Grow, counting the LSA to add. */
+  size = old ? lsdb->index_mask + 1 : 0;
+  if ((lsdb->total + 1) * 2 > size)
+    {
+      lsdb->index_mask = (size ? size * 2 : OSPF_LSDB_INDEX_MIN) - 1;
+      lsdb->index = XCALLOC (MTYPE_OSPF_LSDB_INDEX,
+			     (lsdb->index_mask + 1) * sizeof (*lsdb->index));
+      for (i = 0; i < size; i++)
+	if (old[i].lsa != NULL)
+	  ospf_lsdb_index_put (lsdb->index, lsdb->index_mask,
+			       old[i].key, old[i].lsa);
+      if (old)
+	XFREE (MTYPE_OSPF_LSDB_INDEX, old);
+    }
+
+  ospf_lsdb_index_put (lsdb->index, lsdb->index_mask,
+		       ospf_lsdb_index_key (lsa->data->type, lsa->data->id,
+					    lsa->data->adv_router), lsa);
+}
+
+static void
+ospf_lsdb_index_del (struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
+{
+  struct ospf_lsdb_slot *index = lsdb->index;
+  u_int32_t mask = lsdb->index_mask;
+  u_int32_t i, j;
+
+  i = ospf_lsdb_index_key (lsa->data->type, lsa->data->id,
+			   lsa->data->adv_router) & mask;
+  for (; index[i].lsa != lsa; i = (i + 1) & mask)
+    assert (index[i].lsa != NULL);
+
+  /* An LSA further on may fill the hole unless its own slot lies
+     after the hole, cyclically. */
+  for (j = (i + 1) & mask; index[j].lsa != NULL; j = (j + 1) & mask)
+    if (((j - index[j].key) & mask) >= ((j - i) & mask))
+      {
+	index[i] = index[j];
+	i = j;
+      }
+  index[i].key = 0;
+  index[i].lsa = NULL;
+}
+
 void
 ls_prefix_set (struct prefix_ls *lp, struct ospf_lsa *lsa)
 {
@@ -99,8 +201,11 @@ ospf_lsdb_delete_entry (struct ospf_lsdb *lsdb, struct route_node *rn)
   lsdb->type[lsa->data->type].count--;
   lsdb->type[lsa->data->type].checksum -= ntohs(lsa->data->checksum);
   lsdb->total--;
+  ospf_lsdb_index_del (lsdb, lsa);
   rn->info = NULL;
   route_unlock_node (rn);
+  if (lsdb->ospf)
+    ospf_lsa_age_unregister (lsdb->ospf, lsa);
 #ifdef MONITOR_LSDB_CHANGE
   if (lsdb->del_lsa_hook != NULL)
     (* lsdb->del_lsa_hook)(lsa);
@@ -117,17 +222,14 @@ ospf_lsdb_add (struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
   struct prefix_ls lp;
   struct route_node *rn;
 
+  /* nothing to do? */
+  if (ospf_lsdb_lookup (lsdb, lsa) == lsa)
+    return;
+
   table = lsdb->type[lsa->data->type].db;
   ls_prefix_set (&lp, lsa);
   rn = route_node_get (table, (struct prefix *)&lp);
   
-  /* nothing to do? */
-  if (rn->info && rn->info == lsa)
-    {
-      route_unlock_node (rn);
-      return;
-    }
-  
   /* purge old entry? */
   if (rn->info)
     ospf_lsdb_delete_entry (lsdb, rn);
@@ -135,6 +237,7 @@ ospf_lsdb_add (struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
   if (IS_LSA_SELF (lsa))
     lsdb->type[lsa->data->type].count_self++;
   lsdb->type[lsa->data->type].count++;
+  ospf_lsdb_index_add (lsdb, lsa);
   lsdb->total++;
 
 #ifdef MONITOR_LSDB_CHANGE
@@ -143,6 +246,8 @@ ospf_lsdb_add (struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
 #endif /* MONITOR_LSDB_CHANGE */
   lsdb->type[lsa->data->type].checksum += ntohs(lsa->data->checksum);
   rn->info = ospf_lsa_lock (lsa); /* lsdb */
+  if (lsdb->ospf)
+    ospf_lsa_age_register (lsdb->ospf, lsa);
 }
 
 void
@@ -169,6 +274,9 @@ ospf_lsdb_delete (struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
     }
   
   assert (lsa->data->type < OSPF_MAX_LSA);
+  if (ospf_lsdb_lookup (lsdb, lsa) != lsa)
+    return;
+
   table = lsdb->type[lsa->data->type].db;
   ls_prefix_set (&lp, lsa);
   if ((rn = route_node_lookup (table, (struct prefix *) &lp)))
@@ -193,6 +301,13 @@ ospf_lsdb_delete_all (struct ospf_lsdb *lsdb)
 	if (rn->info != NULL)
 	  ospf_lsdb_delete_entry (lsdb, rn);
     }
+
+  if (lsdb->index)
+    {
+      XFREE (MTYPE_OSPF_LSDB_INDEX, lsdb->index);
+      lsdb->index = NULL;
+      lsdb->index_mask = 0;
+    }
 }
 
 void
@@ -215,48 +330,15 @@ ospf_lsdb_clean_stat (struct ospf_lsdb *lsdb)
 struct ospf_lsa *
 ospf_lsdb_lookup (struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
 {
-  struct route_table *table;
-  struct prefix_ls lp;
-  struct route_node *rn;
-  struct ospf_lsa *find;
-
-  table = lsdb->type[lsa->data->type].db;
-  ls_prefix_set (&lp, lsa);
-  rn = route_node_lookup (table, (struct prefix *) &lp);
-  if (rn)
-    {
-      find = rn->info;
-      route_unlock_node (rn);
-      return find;
-    }
-  return NULL;
+  return ospf_lsdb_index_lookup (lsdb, lsa->data->type, lsa->data->id,
+				 lsa->data->adv_router);
 }
 
 struct ospf_lsa *
 ospf_lsdb_lookup_by_id (struct ospf_lsdb *lsdb, u_char type,
 		       struct in_addr id, struct in_addr adv_router)
 {
-  struct route_table *table;
-  struct prefix_ls lp;
-  struct route_node *rn;
-  struct ospf_lsa *find;
-
-  table = lsdb->type[type].db;
-
-  memset (&lp, 0, sizeof (struct prefix_ls));
-  lp.family = 0;
-  lp.prefixlen = 64;
-  lp.id = id;
-  lp.adv_router = adv_router;
-
-  rn = route_node_lookup (table, (struct prefix *) &lp);
-  if (rn)
-    {
-      find = rn->info;
-      route_unlock_node (rn);
-      return find;
-    }
-  return NULL;
+  return ospf_lsdb_index_lookup (lsdb, type, id, adv_router);
 }
 
 struct ospf_lsa *
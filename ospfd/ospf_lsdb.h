@@ -23,6 +23,13 @@
 #ifndef _ZEBRA_OSPF_LSDB_H
 #define _ZEBRA_OSPF_LSDB_H
 
+/* A slot of the LSDB index, with the hash of the LSA's key. */
+struct ospf_lsdb_slot
+{
+  u_int32_t key;
+  struct ospf_lsa *lsa;
+};
+
 /* OSPF LSDB structure. */
 struct ospf_lsdb
 {
@@ -34,6 +41,14 @@ struct ospf_lsdb
     struct route_table *db;
   } type[OSPF_MAX_LSA];
   unsigned long total;
+  /* The LSAs of all types again, hashed by type, Link State ID and
+     Advertising Router for lookups; the tables above keep them in
+     order for walks.  NULL until the first LSA is added. */
+  struct ospf_lsdb_slot *index;
+  u_int32_t index_mask;
+  /* The instance aging the LSAs, for the area and AS databases; NULL
+     for the lists of neighbors. */
+  struct ospf *ospf;
 #define MONITOR_LSDB_CHANGE 1 /* XXX */
 #ifdef MONITOR_LSDB_CHANGE
   /* Hooks for callback functions to catch every add/del event. */
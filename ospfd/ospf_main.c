@@ -50,6 +50,7 @@
 #include "ospfd/ospf_dump.h"
 #include "ospfd/ospf_zebra.h"
 #include "ospfd/ospf_vty.h"
+#include "ospfd/ospf_gr.h"
 
 /* ospfd privileges */
 zebra_capabilities_t _caps_p [] = 
@@ -317,6 +318,9 @@ main (int argc, char **argv)
   /* Start execution only if not in dry-run mode */
   if (dryrun)
     return(0);
+
+  /* Back within a grace period? */
+  ospf_gr_startup ();
   
   /* Change to the daemon program. */
   if (daemon_mode && daemon (0, 0) < 0)
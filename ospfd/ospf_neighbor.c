@@ -94,7 +94,7 @@ ospf_nbr_new (struct ospf_interface *oi)
   nbr->nbr_nbma = NULL;
 
   ospf_lsdb_init (&nbr->db_sum);
-  ospf_lsdb_init (&nbr->ls_rxmt);
+  nbr->ls_rxmt.slot = -1;
   ospf_lsdb_init (&nbr->ls_req);
 
   nbr->crypt_seqnum = 0;
@@ -115,13 +115,11 @@ ospf_nbr_free (struct ospf_neighbor *nbr)
     ospf_ls_request_delete_all (nbr);
 
   /* Free retransmit list. */
-  if (ospf_ls_retransmit_count (nbr))
-    ospf_ls_retransmit_clear (nbr);
+  ospf_ls_retransmit_free (nbr);
 
   /* Cleanup LSDBs. */
   ospf_lsdb_cleanup (&nbr->db_sum);
   ospf_lsdb_cleanup (&nbr->ls_req);
-  ospf_lsdb_cleanup (&nbr->ls_rxmt);
   
   /* Clear last send packet. */
   if (nbr->last_send)
@@ -133,6 +131,13 @@ ospf_nbr_free (struct ospf_neighbor *nbr)
       nbr->nbr_nbma = NULL;
     }
 
+  /* No longer helped through a graceful restart. */
+  if (nbr->t_gr_helper)
+    {
+      OSPF_NSM_TIMER_OFF (nbr->t_gr_helper);
+      nbr->oi->ospf->gr_helping--;
+    }
+
   /* Cancel all timers. */
   OSPF_NSM_TIMER_OFF (nbr->t_inactivity);
   OSPF_NSM_TIMER_OFF (nbr->t_db_desc);
@@ -303,6 +308,23 @@ ospf_nbr_count (struct ospf_interface *oi, int state)
   return count;
 }
 
+/* Count the neighbours our LSAs describe as fully adjacent. */
+int
+ospf_nbr_count_adjacent (struct ospf_interface *oi)
+{
+  struct ospf_neighbor *nbr;
+  struct route_node *rn;
+  int count = 0;
+
+  for (rn = route_top (oi->nbrs); rn; rn = route_next (rn))
+    if ((nbr = rn->info))
+      if (!IPV4_ADDR_SAME (&nbr->router_id, &oi->ospf->router_id))
+	if (NBR_IS_ADJACENT (nbr))
+	  count++;
+
+  return count;
+}
+
 int
 ospf_nbr_count_opaque_capable (struct ospf_interface *oi)
 {
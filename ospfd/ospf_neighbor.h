@@ -25,6 +25,19 @@
 
 #include <ospfd/ospf_packet.h>
 
+/* Link state retransmission list of a neighbor.  The LSAs on it are
+   those whose map has the bit of the slot set; the queue holds them in
+   the order they were added, and also those deleted since, until it is
+   next compacted. */
+struct ospf_ls_rxmt
+{
+  struct ospf_lsa **queue;
+  unsigned int length;			/* LSAs in the queue. */
+  unsigned int size;			/* Room in the queue. */
+  unsigned long count;			/* LSAs on the list. */
+  int slot;				/* In ospf->ls_rxmt_nbrs, or -1. */
+};
+
 /* Neighbor Data Structure */
 struct ospf_neighbor
 {
@@ -60,7 +73,7 @@ struct ospf_neighbor
   } last_recv;
 
   /* LSA data. */
-  struct ospf_lsdb ls_rxmt;
+  struct ospf_ls_rxmt ls_rxmt;
   struct ospf_lsdb db_sum;
   struct ospf_lsdb ls_req;
   struct ospf_lsa *ls_req_last;
@@ -79,6 +92,7 @@ struct ospf_neighbor
   struct thread *t_ls_req;
   struct thread *t_ls_upd;
   struct thread *t_hello_reply;
+  struct thread *t_gr_helper;		/* Its grace period, while helped. */
 
   /* NBMA configured neighbour */
   struct ospf_nbr_nbma *nbr_nbma;
@@ -94,6 +108,10 @@ struct ospf_neighbor
 #define NBR_IS_DR(n)	IPV4_ADDR_SAME (&n->address.u.prefix4, &n->d_router)
 #define NBR_IS_BDR(n)   IPV4_ADDR_SAME (&n->address.u.prefix4, &n->bd_router)
 
+/* Whether our LSAs describe the neighbour as fully adjacent: it is, or
+   it is restarting gracefully with our help. */
+#define NBR_IS_ADJACENT(n) ((n)->state == NSM_Full || (n)->t_gr_helper != NULL)
+
 /* Prototypes. */
 extern struct ospf_neighbor *ospf_nbr_new (struct ospf_interface *);
 extern void ospf_nbr_free (struct ospf_neighbor *);
@@ -102,6 +120,7 @@ extern int ospf_nbr_bidirectional (struct in_addr *, struct in_addr *, int);
 extern void ospf_nbr_self_reset (struct ospf_interface *);
 extern void ospf_nbr_add_self (struct ospf_interface *);
 extern int ospf_nbr_count (struct ospf_interface *, int);
+extern int ospf_nbr_count_adjacent (struct ospf_interface *);
 extern int ospf_nbr_count_opaque_capable (struct ospf_interface *);
 extern struct ospf_neighbor *ospf_nbr_get (struct ospf_interface *,
 					   struct ospf_header *,
@@ -720,7 +720,7 @@ nsm_change_state (struct ospf_neighbor *nbr, int state)
       /* Originate network-LSA. */
       if (oi->state == ISM_DR)
 	{
-	  if (oi->network_lsa_self && oi->full_nbrs == 0)
+	  if (oi->network_lsa_self && ospf_nbr_count_adjacent (oi) == 0)
 	    {
 	      ospf_lsa_flush_area (oi->network_lsa_self, oi->area);
 	      ospf_lsa_unlock (&oi->network_lsa_self);
@@ -770,6 +770,12 @@ ospf_nsm_event (struct thread *thread)
   nbr = THREAD_ARG (thread);
   event = THREAD_VAL (thread);
 
+  /* A neighbour restarting gracefully with our help keeps its adjacency
+     though its hellos stop or forget us, RFC 3623 3.2. */
+  if (nbr->t_gr_helper
+      && (event == NSM_InactivityTimer || event == NSM_OneWayReceived))
+    return 0;
+
   if (IS_DEBUG_OSPF (nsm, NSM_EVENTS))
     zlog_debug ("NSM[%s:%s]: %s (%s)", IF_NAME (nbr->oi),
 	       inet_ntoa (nbr->router_id),
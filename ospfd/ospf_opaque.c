@@ -63,6 +63,7 @@
 
 #include "ospfd/ospf_te.h"
 #include "ospfd/ospf_ri.h"
+#include "ospfd/ospf_gr.h"
 
 #ifdef SUPPORT_OSPF_API
 int ospf_apiserver_init (void);
@@ -91,6 +92,8 @@ ospf_opaque_init (void)
   if (ospf_router_info_init () != 0)
     exit (1);
 
+  ospf_gr_init ();
+
 #ifdef SUPPORT_OSPF_API
   if ((ospf_apiserver_enable) && (ospf_apiserver_init () != 0))
     exit (1);
@@ -32,6 +32,7 @@
 #include "stream.h"
 #include "log.h"
 #include "sockopt.h"
+#include "network.h"
 #include "checksum.h"
 #include "md5.h"
 
@@ -48,6 +49,7 @@
 #include "ospfd/ospf_spf.h"
 #include "ospfd/ospf_flood.h"
 #include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_gr.h"
 
 /* Packet Type String. */
 const struct message ospf_packet_type_str[] =
@@ -478,40 +480,35 @@ ospf_ls_upd_timer (struct thread *thread)
   nbr = THREAD_ARG (thread);
   nbr->t_ls_upd = NULL;
 
+  /* Let go of the LSAs acknowledged since. */
+  ospf_ls_retransmit_compact (nbr);
+
   /* Send Link State Update. */
   if (ospf_ls_retransmit_count (nbr) > 0)
     {
       struct list *update;
-      struct ospf_lsdb *lsdb;
-      int i;
+      struct ospf_lsa *lsa;
+      unsigned int i;
       int retransmit_interval;
 
       retransmit_interval = OSPF_IF_PARAM (nbr->oi, retransmit_interval);
 
-      lsdb = &nbr->ls_rxmt;
       update = list_new ();
 
-      for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++)
+      for (i = 0; i < nbr->ls_rxmt.length; i++)
 	{
-	  struct route_table *table = lsdb->type[i].db;
-	  struct route_node *rn;
-	  
-	  for (rn = route_top (table); rn; rn = route_next (rn))
-	    {
-	      struct ospf_lsa *lsa;
-	      
-	      if ((lsa = rn->info) != NULL)
-		/* Don't retransmit an LSA if we received it within
-		  the last RxmtInterval seconds - this is to allow the
-		  neighbour a chance to acknowledge the LSA as it may
-		  have ben just received before the retransmit timer
-		  fired.  This is a small tweak to what is in the RFC,
-		  but it will cut out out a lot of retransmit traffic
-		  - MAG */
-		if (tv_cmp (tv_sub (recent_relative_time (), lsa->tv_recv), 
-			    int2tv (retransmit_interval)) >= 0)
-		  listnode_add (update, rn->info);
-	    }
+	  lsa = nbr->ls_rxmt.queue[i];
+
+	  /* Don't retransmit an LSA if we received it within
+	     the last RxmtInterval seconds - this is to allow the
+	     neighbour a chance to acknowledge the LSA as it may
+	     have ben just received before the retransmit timer
+	     fired.  This is a small tweak to what is in the RFC,
+	     but it will cut out out a lot of retransmit traffic
+	     - MAG */
+	  if (tv_cmp (tv_sub (recent_relative_time (), lsa->tv_recv),
+		      int2tv (retransmit_interval)) >= 0)
+	    listnode_add (update, lsa);
 	}
 
       if (listcount (update) > 0)
@@ -628,95 +625,73 @@ ospf_write_frags (int fd, struct ospf_packet *op, struct ip *iph,
 }
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-static int
-ospf_write (struct thread *thread)
+/* One packet of a batch ospf_write hands to the kernel. */
+struct ospf_write_pkt
 {
-  struct ospf *ospf = THREAD_ARG (thread);
-  struct ospf_interface *oi;
   struct ospf_packet *op;
+  u_char type;
   struct sockaddr_in sa_dst;
   struct ip iph;
-  struct msghdr msg;
   struct iovec iov[2];
-  u_char type;
-  int ret;
-  int flags = 0;
-  struct listnode *node;
+  struct msghdr msg;
+};
+
+/* Set up the IP header and message for a packet to go out. */
+static void
+ospf_write_prepare (struct ospf_interface *oi, struct ospf_packet *op,
+		    struct ospf_write_pkt *pkt)
+{
 #ifdef WANT_OSPF_WRITE_FRAGMENT
   static u_int16_t ipid = 0;
-  u_int16_t maxdatasize;
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
+  struct ip *iph = &pkt->iph;
 #define OSPF_WRITE_IPHL_SHIFT 2
-  
-  ospf->t_write = NULL;
 
-  node = listhead (ospf->oi_write_q);
-  assert (node);
-  oi = listgetdata (node);
-  assert (oi);
+  assert (op->length >= OSPF_HEADER_SIZE);
 
 #ifdef WANT_OSPF_WRITE_FRAGMENT
   /* seed ipid static with low order bits of time */
   if (ipid == 0)
     ipid = (time(NULL) & 0xffff);
-
-  /* convenience - max OSPF data per packet,
-   * and reliability - not more data, than our
-   * socket can accept
-   */
-  maxdatasize = MIN (oi->ifp->mtu, ospf->maxsndbuflen) -
-    sizeof (struct ip);
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
-  
-  /* Get one packet from queue. */
-  op = ospf_fifo_head (oi->obuf);
-  assert (op);
-  assert (op->length >= OSPF_HEADER_SIZE);
 
-  if (op->dst.s_addr == htonl (OSPF_ALLSPFROUTERS)
-      || op->dst.s_addr == htonl (OSPF_ALLDROUTERS))
-      ospf_if_ipmulticast (ospf, oi->address, oi->ifp->ifindex);
-    
   /* Rewrite the md5 signature & update the seq */
   ospf_make_md5_digest (oi, op);
 
+  pkt->op = op;
+
   /* Retrieve OSPF packet type. */
   stream_set_getp (op->s, 1);
-  type = stream_getc (op->s);
+  pkt->type = stream_getc (op->s);
   
   /* reset get pointer */
   stream_set_getp (op->s, 0);
 
-  memset (&iph, 0, sizeof (struct ip));
-  memset (&sa_dst, 0, sizeof (sa_dst));
+  memset (iph, 0, sizeof (struct ip));
+  memset (&pkt->sa_dst, 0, sizeof (pkt->sa_dst));
   
-  sa_dst.sin_family = AF_INET;
+  pkt->sa_dst.sin_family = AF_INET;
 #ifdef HAVE_STRUCT_SOCKADDR_IN_SIN_LEN
-  sa_dst.sin_len = sizeof(sa_dst);
+  pkt->sa_dst.sin_len = sizeof(pkt->sa_dst);
 #endif /* HAVE_STRUCT_SOCKADDR_IN_SIN_LEN */
-  sa_dst.sin_addr = op->dst;
-  sa_dst.sin_port = htons (0);
-
-  /* Set DONTROUTE flag if dst is unicast. */
-  if (oi->type != OSPF_IFTYPE_VIRTUALLINK)
-    if (!IN_MULTICAST (htonl (op->dst.s_addr)))
-      flags = MSG_DONTROUTE;
+  pkt->sa_dst.sin_addr = op->dst;
+  pkt->sa_dst.sin_port = htons (0);
 
-  iph.ip_hl = sizeof (struct ip) >> OSPF_WRITE_IPHL_SHIFT;
+  iph->ip_hl = sizeof (struct ip) >> OSPF_WRITE_IPHL_SHIFT;
   /* it'd be very strange for header to not be 4byte-word aligned but.. */
   if ( sizeof (struct ip) 
-        > (unsigned int)(iph.ip_hl << OSPF_WRITE_IPHL_SHIFT) )
-    iph.ip_hl++; /* we presume sizeof struct ip cant overflow ip_hl.. */
+        > (unsigned int)(iph->ip_hl << OSPF_WRITE_IPHL_SHIFT) )
+    iph->ip_hl++; /* we presume sizeof struct ip cant overflow ip_hl.. */
   
-  iph.ip_v = IPVERSION;
-  iph.ip_tos = IPTOS_PREC_INTERNETCONTROL;
-  iph.ip_len = (iph.ip_hl << OSPF_WRITE_IPHL_SHIFT) + op->length;
+  iph->ip_v = IPVERSION;
+  iph->ip_tos = IPTOS_PREC_INTERNETCONTROL;
+  iph->ip_len = (iph->ip_hl << OSPF_WRITE_IPHL_SHIFT) + op->length;
 
 #if defined(__DragonFly__)
   /*
    * DragonFly's raw socket expects ip_len/ip_off in network byte order.
    */
-  iph.ip_len = htons(iph.ip_len);
+  iph->ip_len = htons(iph->ip_len);
 #endif
 
 #ifdef WANT_OSPF_WRITE_FRAGMENT
@@ -724,78 +699,197 @@ ospf_write (struct thread *thread)
    * XXX: this presumes this is only programme sending OSPF packets 
    * otherwise, no guarantee ipid will be unique
    */
-  iph.ip_id = ++ipid;
+  iph->ip_id = ++ipid;
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-  iph.ip_off = 0;
+  iph->ip_off = 0;
   if (oi->type == OSPF_IFTYPE_VIRTUALLINK)
-    iph.ip_ttl = OSPF_VL_IP_TTL;
+    iph->ip_ttl = OSPF_VL_IP_TTL;
   else
-    iph.ip_ttl = OSPF_IP_TTL;
-  iph.ip_p = IPPROTO_OSPFIGP;
-  iph.ip_sum = 0;
-  iph.ip_src.s_addr = oi->address->u.prefix4.s_addr;
-  iph.ip_dst.s_addr = op->dst.s_addr;
-
-  memset (&msg, 0, sizeof (msg));
-  msg.msg_name = (caddr_t) &sa_dst;
-  msg.msg_namelen = sizeof (sa_dst); 
-  msg.msg_iov = iov;
-  msg.msg_iovlen = 2;
-  iov[0].iov_base = (char*)&iph;
-  iov[0].iov_len = iph.ip_hl << OSPF_WRITE_IPHL_SHIFT;
-  iov[1].iov_base = STREAM_PNT (op->s);
-  iov[1].iov_len = op->length;
-  
-  /* Sadly we can not rely on kernels to fragment packets because of either
-   * IP_HDRINCL and/or multicast destination being set.
+    iph->ip_ttl = OSPF_IP_TTL;
+  iph->ip_p = IPPROTO_OSPFIGP;
+  iph->ip_sum = 0;
+  iph->ip_src.s_addr = oi->address->u.prefix4.s_addr;
+  iph->ip_dst.s_addr = op->dst.s_addr;
+
+  memset (&pkt->msg, 0, sizeof (pkt->msg));
+  pkt->msg.msg_name = (caddr_t) &pkt->sa_dst;
+  pkt->msg.msg_namelen = sizeof (pkt->sa_dst); 
+  pkt->msg.msg_iov = pkt->iov;
+  pkt->msg.msg_iovlen = 2;
+  pkt->iov[0].iov_base = (char*)iph;
+  pkt->iov[0].iov_len = iph->ip_hl << OSPF_WRITE_IPHL_SHIFT;
+  pkt->iov[1].iov_base = STREAM_PNT (op->s);
+  pkt->iov[1].iov_len = op->length;
+}
+
+/* Send flags for a packet: DONTROUTE if dst is unicast. */
+static int
+ospf_write_flags (struct ospf_interface *oi, struct ospf_packet *op)
+{
+  if (oi->type != OSPF_IFTYPE_VIRTUALLINK)
+    if (!IN_MULTICAST (htonl (op->dst.s_addr)))
+      return MSG_DONTROUTE;
+  return 0;
+}
+
+/* Send up to MAX packets from the head of the queue of OI with one
+   system call, and take them off the queue.  A batch holds packets
+   sharing their send flags only, and a packet needing fragmentation
+   goes out alone.  Returns the number of packets dequeued, at least
+   one: a packet the kernel refuses is dropped, as ever. */
+static int
+ospf_write_batch (struct ospf *ospf, struct ospf_interface *oi, int max)
+{
+  struct ospf_write_pkt pkts[OSPF_WRITE_BATCH];
+  struct ospf_packet *op;
+  int count, flags = 0, multicast = 0;
+  int i, ret;
+#ifdef HAVE_SENDMMSG
+  struct mmsghdr msgs[OSPF_WRITE_BATCH];
+#endif /* HAVE_SENDMMSG */
+#ifdef WANT_OSPF_WRITE_FRAGMENT
+  u_int16_t maxdatasize;
+
+  /* convenience - max OSPF data per packet,
+   * and reliability - not more data, than our
+   * socket can accept
    */
+  maxdatasize = MIN (oi->ifp->mtu, ospf->maxsndbuflen) -
+    sizeof (struct ip);
+#endif /* WANT_OSPF_WRITE_FRAGMENT */
+
+  assert (max <= OSPF_WRITE_BATCH);
+
+  for (count = 0, op = ospf_fifo_head (oi->obuf);
+       op != NULL && count < max; op = op->next)
+    {
+      if (count == 0)
+	flags = ospf_write_flags (oi, op);
+      else if (ospf_write_flags (oi, op) != flags)
+	break;
 #ifdef WANT_OSPF_WRITE_FRAGMENT
-  if ( op->length > maxdatasize )
-    ospf_write_frags (ospf->fd, op, &iph, &msg, maxdatasize, 
-                      oi->ifp->mtu, flags, type);
+      if (count > 0 && op->length > maxdatasize)
+	break;
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-  /* send final fragment (could be first) */
-  sockopt_iphdrincl_swab_htosys (&iph);
-  ret = sendmsg (ospf->fd, &msg, flags);
-  sockopt_iphdrincl_swab_systoh (&iph);
-  
+      if (op->dst.s_addr == htonl (OSPF_ALLSPFROUTERS)
+	  || op->dst.s_addr == htonl (OSPF_ALLDROUTERS))
+	multicast = 1;
+
+      ospf_write_prepare (oi, op, &pkts[count++]);
+
+      /* Sadly we can not rely on kernels to fragment packets because of
+       * either IP_HDRINCL and/or multicast destination being set.
+       */
+#ifdef WANT_OSPF_WRITE_FRAGMENT
+      if ( op->length > maxdatasize )
+	{
+	  ospf_write_frags (ospf->fd, op, &pkts[0].iph, &pkts[0].msg,
+			    maxdatasize, oi->ifp->mtu, flags, pkts[0].type);
+	  break;
+	}
+#endif /* WANT_OSPF_WRITE_FRAGMENT */
+    }
+  assert (count > 0);
+
+  /* All packets of the batch leave by the one interface. */
+  if (multicast)
+    ospf_if_ipmulticast (ospf, oi->address, oi->ifp->ifindex);
+
+  /* send final fragments (could be first) */
+  for (i = 0; i < count; i++)
+    sockopt_iphdrincl_swab_htosys (&pkts[i].iph);
+#ifdef HAVE_SENDMMSG
+  for (i = 0; i < count; i++)
+    {
+      msgs[i].msg_hdr = pkts[i].msg;
+      msgs[i].msg_len = 0;
+    }
+  ret = sendmmsg (ospf->fd, msgs, count, flags);
+#else
+  for (ret = 0; ret < count; ret++)
+    if (sendmsg (ospf->fd, &pkts[ret].msg, flags) < 0)
+      break;
+  if (ret == 0)
+    ret = -1;
+#endif /* HAVE_SENDMMSG */
+  for (i = 0; i < count; i++)
+    sockopt_iphdrincl_swab_systoh (&pkts[i].iph);
+
+  /* Packets after one the kernel refused stay queued for the next
+     batch; the refused one is dropped. */
   if (ret < 0)
-    zlog_warn ("*** sendmsg in ospf_write failed to %s, "
-	       "id %d, off %d, len %d, interface %s, mtu %u: %s",
-	       inet_ntoa (iph.ip_dst), iph.ip_id, iph.ip_off, iph.ip_len,
-	       oi->ifp->name, oi->ifp->mtu, safe_strerror (errno));
+    {
+      zlog_warn ("*** sendmsg in ospf_write failed to %s, "
+		 "id %d, off %d, len %d, interface %s, mtu %u: %s",
+		 inet_ntoa (pkts[0].iph.ip_dst), pkts[0].iph.ip_id,
+		 pkts[0].iph.ip_off, pkts[0].iph.ip_len,
+		 oi->ifp->name, oi->ifp->mtu, safe_strerror (errno));
+      count = 1;
+    }
+  else
+    count = ret;
 
-  /* Show debug sending packet. */
-  if (IS_DEBUG_OSPF_PACKET (type - 1, SEND))
+  for (i = 0; i < count; i++)
     {
-      if (IS_DEBUG_OSPF_PACKET (type - 1, DETAIL))
+      struct ospf_write_pkt *pkt = &pkts[i];
+
+      /* Show debug sending packet. */
+      if (IS_DEBUG_OSPF_PACKET (pkt->type - 1, SEND))
 	{
-	  zlog_debug ("-----------------------------------------------------");
-	  ospf_ip_header_dump (&iph);
-	  stream_set_getp (op->s, 0);
-	  ospf_packet_dump (op->s);
-	}
+	  if (IS_DEBUG_OSPF_PACKET (pkt->type - 1, DETAIL))
+	    {
+	      zlog_debug ("-----------------------------------------------------");
+	      ospf_ip_header_dump (&pkt->iph);
+	      stream_set_getp (pkt->op->s, 0);
+	      ospf_packet_dump (pkt->op->s);
+	    }
 
-      zlog_debug ("%s sent to [%s] via [%s].",
-		 LOOKUP (ospf_packet_type_str, type), inet_ntoa (op->dst),
-		 IF_NAME (oi));
+	  zlog_debug ("%s sent to [%s] via [%s].",
+		     LOOKUP (ospf_packet_type_str, pkt->type),
+		     inet_ntoa (pkt->op->dst), IF_NAME (oi));
 
-      if (IS_DEBUG_OSPF_PACKET (type - 1, DETAIL))
-	zlog_debug ("-----------------------------------------------------");
+	  if (IS_DEBUG_OSPF_PACKET (pkt->type - 1, DETAIL))
+	    zlog_debug ("-----------------------------------------------------");
+	}
+
+      /* Now delete packet from queue. */
+      assert (ospf_fifo_head (oi->obuf) == pkt->op);
+      ospf_packet_delete (oi);
     }
 
-  /* Now delete packet from queue. */
-  ospf_packet_delete (oi);
+  return count;
+}
 
-  /* Move this interface to the tail of write_q to
-	 serve everyone in a round robin fashion */
-  listnode_move_to_tail (ospf->oi_write_q, node);
-  if (ospf_fifo_head (oi->obuf) == NULL)
+static int
+ospf_write (struct thread *thread)
+{
+  struct ospf *ospf = THREAD_ARG (thread);
+  struct ospf_interface *oi;
+  struct listnode *node;
+  int budget;
+
+  ospf->t_write = NULL;
+
+  /* Send in batches until the budget for one wakeup is spent, so that
+     a long queue does not hold up everything else. */
+  for (budget = OSPF_WRITE_BUDGET;
+       budget > 0 && (node = listhead (ospf->oi_write_q)) != NULL; )
     {
-      oi->on_write_q = 0;
-      list_delete_node (ospf->oi_write_q, node);
+      oi = listgetdata (node);
+      assert (oi);
+
+      budget -= ospf_write_batch (ospf, oi, MIN (budget, OSPF_WRITE_BATCH));
+
+      /* Move this interface to the tail of write_q to
+	 serve everyone in a round robin fashion */
+      listnode_move_to_tail (ospf->oi_write_q, node);
+      if (ospf_fifo_head (oi->obuf) == NULL)
+	{
+	  oi->on_write_q = 0;
+	  list_delete_node (ospf->oi_write_q, node);
+	}
     }
   
   /* If packets still remain in queue, call write thread. */
@@ -1880,6 +1974,10 @@ ospf_ls_upd (struct ospf *ospf, struct ip *iph, struct ospf_header *ospfh,
                 zlog_debug ("LSA[%s]: Previously originated Opaque-LSA,"
                             "not found in the LSDB.", dump_lsa_key (lsa));
 
+              /* Our grace-LSAs, restarting gracefully. */
+              if (ospf_gr_self_lsa_received (nbr, lsa))
+                continue;
+
               SET_FLAG (lsa->flags, OSPF_LSA_SELF);
               
               ospf_opaque_self_originated_lsa_received (nbr, lsa);
@@ -2101,31 +2199,87 @@ ospf_ls_ack (struct ip *iph, struct ospf_header *ospfh,
   return;
 }
 
-static struct stream *
-ospf_recv_packet (int fd, struct interface **ifp, struct stream *ibuf)
+/* Read up to COUNT packets waiting on the socket into the ibufs of
+   OSPF, with the indexes of the interfaces they came in on, where the
+   platform tells.  Returns the number of packets read. */
+static int
+ospf_recv_packets (struct ospf *ospf, ifindex_t *ifindex, int count)
 {
   int ret;
-  struct ip *iph;
-  u_int16_t ip_len;
-  ifindex_t ifindex = 0;
-  struct iovec iov;
+  int i;
+  struct iovec iov[OSPF_READ_BATCH];
   /* Header and data both require alignment. */
-  char buff [CMSG_SPACE(SOPT_SIZE_CMSG_IFINDEX_IPV4())];
+  char buff[OSPF_READ_BATCH][CMSG_SPACE(SOPT_SIZE_CMSG_IFINDEX_IPV4())];
+#ifdef HAVE_RECVMMSG
+  struct mmsghdr msgs[OSPF_READ_BATCH];
+#else
   struct msghdr msgh;
+#endif /* HAVE_RECVMMSG */
 
+  assert (count > 0 && count <= OSPF_READ_BATCH);
+
+#ifdef HAVE_RECVMMSG
+  memset (msgs, 0, sizeof (msgs[0]) * count);
+  for (i = 0; i < count; i++)
+    {
+      stream_reset (ospf->ibuf[i]);
+      iov[i].iov_base = STREAM_DATA (ospf->ibuf[i]);
+      iov[i].iov_len = OSPF_MAX_PACKET_SIZE+1;
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_control = (caddr_t) buff[i];
+      msgs[i].msg_hdr.msg_controllen = sizeof (buff[i]);
+    }
+
+  /* The read thread found the socket readable, so only a spurious
+     wakeup finds nothing; later calls of a wakeup must not block. */
+  ret = recvmmsg (ospf->fd, msgs, count, MSG_DONTWAIT, NULL);
+  if (ret < 0)
+    {
+      if (!ERRNO_IO_RETRY (errno))
+	zlog_warn("recvmmsg failed: %s", safe_strerror(errno));
+      return 0;
+    }
+
+  for (i = 0; i < ret; i++)
+    {
+      stream_set_endp (ospf->ibuf[i], msgs[i].msg_len);
+      ifindex[i] = getsockopt_ifindex (AF_INET, &msgs[i].msg_hdr);
+    }
+  return ret;
+#else
+  i = 0;
   memset (&msgh, 0, sizeof (struct msghdr));
-  msgh.msg_iov = &iov;
+  msgh.msg_iov = &iov[i];
   msgh.msg_iovlen = 1;
-  msgh.msg_control = (caddr_t) buff;
-  msgh.msg_controllen = sizeof (buff);
+  msgh.msg_control = (caddr_t) buff[i];
+  msgh.msg_controllen = sizeof (buff[i]);
   
-  ret = stream_recvmsg (ibuf, fd, &msgh, 0, OSPF_MAX_PACKET_SIZE+1);
+  stream_reset (ospf->ibuf[i]);
+  ret = stream_recvmsg (ospf->ibuf[i], ospf->fd, &msgh, 0,
+			OSPF_MAX_PACKET_SIZE+1);
   if (ret < 0)
     {
       zlog_warn("stream_recvmsg failed: %s", safe_strerror(errno));
-      return NULL;
+      return 0;
     }
-  if ((unsigned int)ret < sizeof(iph)) /* ret must be > 0 now */
+
+  ifindex[i] = getsockopt_ifindex (AF_INET, &msgh);
+  return 1;
+#endif /* HAVE_RECVMMSG */
+}
+
+/* Check a packet as read by ospf_recv_packets. */
+static struct stream *
+ospf_recv_packet (struct stream *ibuf, ifindex_t ifindex,
+		  struct interface **ifp)
+{
+  int ret;
+  struct ip *iph;
+  u_int16_t ip_len;
+
+  ret = stream_get_endp (ibuf);
+  if ((unsigned int)ret < sizeof(iph))
     {
       zlog_warn("ospf_recv_packet: discarding runt packet of length %d "
 		"(ip header size is %u)",
@@ -2167,8 +2321,6 @@ ospf_recv_packet (int fd, struct interface **ifp, struct stream *ibuf)
   ip_len = ntohs(iph->ip_len) + (iph->ip_hl << 2);
 #endif
 
-  ifindex = getsockopt_ifindex (AF_INET, &msgh);
-  
   *ifp = if_lookup_by_index (ifindex);
 
   if (ret != ip_len)
@@ -2704,28 +2856,17 @@ ospf_verify_header (struct stream *ibuf, struct ospf_interface *oi,
   return 0;
 }
 
-/* Starting point of packet process function. */
-int
-ospf_read (struct thread *thread)
+/* Process a packet received on IFP, if known. */
+static int
+ospf_read_packet (struct ospf *ospf, struct stream *ibuf,
+		  struct interface *ifp)
 {
   int ret;
-  struct stream *ibuf;
-  struct ospf *ospf;
   struct ospf_interface *oi;
   struct ip *iph;
   struct ospf_header *ospfh;
   u_int16_t length;
-  struct interface *ifp;
-
-  /* first of all get interface pointer. */
-  ospf = THREAD_ARG (thread);
-
-  /* prepare for next packet. */
-  ospf->t_read = thread_add_read (master, ospf_read, ospf, ospf->fd);
 
-  stream_reset(ospf->ibuf);
-  if (!(ibuf = ospf_recv_packet (ospf->fd, &ifp, ospf->ibuf)))
-    return -1;
   /* This raw packet is known to be at least as big as its IP header. */
   
   /* Note that there should not be alignment problems with this assignment
@@ -2927,6 +3068,41 @@ ospf_read (struct thread *thread)
   return 0;
 }
 
+/* Starting point of packet process function. */
+int
+ospf_read (struct thread *thread)
+{
+  struct ospf *ospf;
+  struct interface *ifp;
+  ifindex_t ifindex[OSPF_READ_BATCH];
+  int budget;
+  int count;
+  int i;
+
+  /* first of all get interface pointer. */
+  ospf = THREAD_ARG (thread);
+
+  /* prepare for next packet. */
+  ospf->t_read = thread_add_read (master, ospf_read, ospf, ospf->fd);
+
+  /* Read what is waiting in batches, until the budget for one wakeup
+     is spent or the socket is drained. */
+  for (budget = OSPF_READ_BUDGET; budget > 0; budget -= count)
+    {
+      count = ospf_recv_packets (ospf, ifindex,
+				 MIN (budget, OSPF_READ_BATCH));
+
+      for (i = 0; i < count; i++)
+	if (ospf_recv_packet (ospf->ibuf[i], ifindex[i], &ifp))
+	  ospf_read_packet (ospf, ospf->ibuf[i], ifp);
+
+      if (count < OSPF_READ_BATCH)
+	break;
+    }
+
+  return 0;
+}
+
 /* Make OSPF header. */
 static void
 ospf_make_header (int type, struct ospf_interface *oi, struct stream *s)
@@ -3295,6 +3471,8 @@ ospf_make_ls_upd (struct ospf_interface *oi, struct list *update, struct stream
       length += ntohs (lsa->data->length);
       count++;
 
+      oi->ls_upd_queue_count--;
+      oi->ls_upd_queue_octets -= ntohs (lsa->data->length);
       list_delete_node (update, node);
       ospf_lsa_unlock (&lsa); /* oi->ls_upd_queue */
     }
@@ -3302,6 +3480,9 @@ ospf_make_ls_upd (struct ospf_interface *oi, struct list *update, struct stream
   /* Now set #LSAs. */
   stream_putl_at (s, pp, count);
 
+  oi->ls_upd_lsa_out += count;
+  oi->ls_upd_octets_out += length - OSPF_LS_UPD_MIN_SIZE;
+
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("ospf_make_ls_upd: Stop");
   return length;
@@ -3583,21 +3764,6 @@ ospf_ls_req_send (struct ospf_neighbor *nbr)
   OSPF_NSM_TIMER_ON (nbr->t_ls_req, ospf_ls_req_timer, nbr->v_ls_req);
 }
 
-/* Send Link State Update with an LSA. */
-void
-ospf_ls_upd_send_lsa (struct ospf_neighbor *nbr, struct ospf_lsa *lsa,
-		      int flag)
-{
-  struct list *update;
-
-  update = list_new ();
-
-  listnode_add (update, lsa);
-  ospf_ls_upd_send (nbr, update, flag);
-
-  list_delete (update);
-}
-
 /* Determine size for packet. Must be at least big enough to accomodate next
  * LSA on list, which may be bigger than MTU size.
  *
@@ -3652,7 +3818,10 @@ ospf_ls_upd_packet_new (struct list *update, struct ospf_interface *oi)
                  " OSPF routing is broken!",
                  inet_ntoa (lsa->data->id), ntohs (lsa->data->length),
                  (long int) size);
+      oi->ls_upd_queue_count--;
+      oi->ls_upd_queue_octets -= ntohs (lsa->data->length);
       list_delete_node (update, ln);
+      ospf_lsa_unlock (&lsa); /* oi->ls_upd_queue */
       return NULL;
     }
 
@@ -3680,6 +3849,8 @@ ospf_ls_upd_queue_send (struct ospf_interface *oi, struct list *update,
 			    inet_ntoa(addr));
   
   op = ospf_ls_upd_packet_new (update, oi);
+  if (op == NULL)
+    return;
 
   /* Prepare OSPF common header. */
   ospf_make_header (OSPF_MSG_LS_UPD, oi, op->s);
@@ -3703,11 +3874,35 @@ ospf_ls_upd_queue_send (struct ospf_interface *oi, struct list *update,
 
   /* Add packet to the interface output queue. */
   ospf_packet_add (oi, op);
+  oi->ls_upd_out++;
 
   /* Hook thread to write packet. */
   OSPF_ISM_WRITE_ON (oi->ospf);
 }
 
+static int ospf_ls_upd_send_queue_event (struct thread *);
+
+/* Send the queued LSAs at once if flood pacing is off or they fill an
+   LS Update, else once flood pacing gathered more of them. */
+static void
+ospf_ls_upd_send_schedule (struct ospf_interface *oi)
+{
+  if (oi->ospf->flood_pacing == 0
+      || oi->ls_upd_queue_octets + OSPF_LS_UPD_MIN_SIZE
+         >= ospf_packet_max (oi))
+    {
+      if (oi->t_ls_upd_event && oi->t_ls_upd_event->type == THREAD_EVENT)
+	return;
+      OSPF_TIMER_OFF (oi->t_ls_upd_event);
+      oi->t_ls_upd_event =
+	thread_add_event (master, ospf_ls_upd_send_queue_event, oi, 0);
+    }
+  else if (oi->t_ls_upd_event == NULL)
+    oi->t_ls_upd_event =
+      thread_add_timer_msec (master, ospf_ls_upd_send_queue_event, oi,
+			     oi->ospf->flood_pacing);
+}
+
 static int
 ospf_ls_upd_send_queue_event (struct thread *thread)
 {
@@ -3744,13 +3939,13 @@ ospf_ls_upd_send_queue_event (struct thread *thread)
         again = 1;
     }
 
+  /* Full updates go at once, the rest once pacing gathered more. */
   if (again != 0)
     {
       if (IS_DEBUG_OSPF_EVENT)
         zlog_debug ("ospf_ls_upd_send_queue: update lists not cleared,"
-                   " %d nodes to try again, raising new event", again);
-      oi->t_ls_upd_event = 
-        thread_add_event (master, ospf_ls_upd_send_queue_event, oi, 0);
+                   " %d nodes to try again", again);
+      ospf_ls_upd_send_schedule (oi);
     }
 
   if (IS_DEBUG_OSPF_EVENT)
@@ -3759,14 +3954,13 @@ ospf_ls_upd_send_queue_event (struct thread *thread)
   return 0;
 }
 
-void
-ospf_ls_upd_send (struct ospf_neighbor *nbr, struct list *update, int flag)
+/* The update list of the destination LSAs for the neighbor go to. */
+static struct list *
+ospf_ls_upd_queue_get (struct ospf_neighbor *nbr, int flag)
 {
   struct ospf_interface *oi;
-  struct ospf_lsa *lsa;
   struct prefix_ipv4 p;
   struct route_node *rn;
-  struct listnode *node;
   
   oi = nbr->oi;
 
@@ -3802,12 +3996,40 @@ ospf_ls_upd_send (struct ospf_neighbor *nbr, struct list *update, int flag)
   else
     route_unlock_node (rn);
 
-  for (ALL_LIST_ELEMENTS_RO (update, node, lsa))
-    listnode_add (rn->info, ospf_lsa_lock (lsa)); /* oi->ls_upd_queue */
+  return rn->info;
+}
 
-  if (oi->t_ls_upd_event == NULL)
-    oi->t_ls_upd_event =
-      thread_add_event (master, ospf_ls_upd_send_queue_event, oi, 0);
+static void
+ospf_ls_upd_queue_add (struct ospf_interface *oi, struct list *update,
+		       struct ospf_lsa *lsa)
+{
+  listnode_add (update, ospf_lsa_lock (lsa)); /* oi->ls_upd_queue */
+  oi->ls_upd_queue_octets += ntohs (lsa->data->length);
+  if (++oi->ls_upd_queue_count > oi->ls_upd_queue_max)
+    oi->ls_upd_queue_max = oi->ls_upd_queue_count;
+}
+
+/* Send Link State Update with an LSA. */
+void
+ospf_ls_upd_send_lsa (struct ospf_neighbor *nbr, struct ospf_lsa *lsa,
+		      int flag)
+{
+  ospf_ls_upd_queue_add (nbr->oi, ospf_ls_upd_queue_get (nbr, flag), lsa);
+  ospf_ls_upd_send_schedule (nbr->oi);
+}
+
+void
+ospf_ls_upd_send (struct ospf_neighbor *nbr, struct list *update, int flag)
+{
+  struct ospf_interface *oi = nbr->oi;
+  struct list *queue;
+  struct listnode *node;
+  struct ospf_lsa *lsa;
+
+  queue = ospf_ls_upd_queue_get (nbr, flag);
+  for (ALL_LIST_ELEMENTS_RO (update, node, lsa))
+    ospf_ls_upd_queue_add (oi, queue, lsa);
+  ospf_ls_upd_send_schedule (oi);
 }
 
 static void
@@ -765,14 +765,13 @@ void
 ospf_route_copy_nexthops_from_vertex (struct ospf_route *to,
 				      struct vertex *v)
 {
-  struct listnode *node;
   struct ospf_path *path;
   struct vertex_nexthop *nexthop;
   struct vertex_parent *vp;
 
   assert (to->paths);
 
-  for (ALL_LIST_ELEMENTS_RO (v->parents, node, vp))
+  for (vp = v->parents; vp; vp = vp->next)
     {
       nexthop = vp->nexthop;
       
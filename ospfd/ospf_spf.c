@@ -29,7 +29,11 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "table.h"
 #include "log.h"
 #include "sockunion.h"          /* for inet_ntop () */
-#include "pqueue.h"
+#include "jhash.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif /* HAVE_PTHREAD */
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_interface.h"
@@ -71,155 +75,335 @@ ospf_get_spf_reason_str (char *buf)
   buf[0] = '\0';
   if (spf_reason_flags)
     {
-      if (spf_reason_flags & SPF_FLAG_ROUTER_LSA_INSTALL)
+      if (spf_reason_flags & (1 << SPF_FLAG_ROUTER_LSA_INSTALL))
         strcat (buf, "R, ");
-      if (spf_reason_flags & SPF_FLAG_NETWORK_LSA_INSTALL)
+      if (spf_reason_flags & (1 << SPF_FLAG_NETWORK_LSA_INSTALL))
         strcat (buf, "N, ");
-      if (spf_reason_flags & SPF_FLAG_SUMMARY_LSA_INSTALL)
+      if (spf_reason_flags & (1 << SPF_FLAG_SUMMARY_LSA_INSTALL))
         strcat (buf, "S, ");
-      if (spf_reason_flags & SPF_FLAG_ASBR_SUMMARY_LSA_INSTALL)
+      if (spf_reason_flags & (1 << SPF_FLAG_ASBR_SUMMARY_LSA_INSTALL))
         strcat (buf, "AS, ");
-      if (spf_reason_flags & SPF_FLAG_ABR_STATUS_CHANGE)
+      if (spf_reason_flags & (1 << SPF_FLAG_ABR_STATUS_CHANGE))
         strcat (buf, "ABR, ");
-      if (spf_reason_flags & SPF_FLAG_ASBR_STATUS_CHANGE)
+      if (spf_reason_flags & (1 << SPF_FLAG_ASBR_STATUS_CHANGE))
         strcat (buf, "ASBR, ");
-      if (spf_reason_flags & SPF_FLAG_MAXAGE)
+      if (spf_reason_flags & (1 << SPF_FLAG_MAXAGE))
         strcat (buf, "M, ");
+      if (spf_reason_flags & (1 << SPF_FLAG_CONFIG_CHANGE))
+        strcat (buf, "C, ");
       buf[strlen(buf)-2] = '\0'; /* skip the last ", " */
     }
 }
 
-static void ospf_vertex_free (void *);
-/* List of allocated vertices, to simplify cleanup of SPF.
- * Not thread-safe obviously. If it ever needs to be, it'd have to be
- * dynamically allocated at begin of ospf_spf_calculate
+/* The vertices of an area's tree, their parents and the nexthops on
+ * them are carved out of blocks kept with the area.  A full calculation
+ * drops the whole tree at once and carves the blocks again; vertices
+ * taken off the tree one by one, by an incremental calculation, go on
+ * free lists to be reused.
  */
-static struct list vertex_list = { .del = ospf_vertex_free };
+#define OSPF_SPF_ARENA_BLOCK    16384
 
-/* Heap related functions, for the managment of the candidates, to
- * be used with pqueue. */
-static int
-cmp (void * node1 , void * node2)
+enum ospf_spf_arena_kind
+{
+  OSPF_SPF_ARENA_VERTEX,
+  OSPF_SPF_ARENA_PARENT,
+  OSPF_SPF_ARENA_NEXTHOP,
+  OSPF_SPF_ARENA_KINDS,
+};
+
+struct ospf_spf_arena_block
+{
+  struct ospf_spf_arena_block *next;
+  size_t used;
+};
+
+#define OSPF_SPF_ARENA_ALIGN(S) (((S) + sizeof (void *) - 1) \
+                                 & ~(sizeof (void *) - 1))
+#define OSPF_SPF_ARENA_HEADER \
+  OSPF_SPF_ARENA_ALIGN (sizeof (struct ospf_spf_arena_block))
+
+/* The candidate list of 16.1 (2): a 4-ary heap of vertices, the stat
+ * of the LSA of each holding its position for the decrease-key of a
+ * shorter path found to it.
+ */
+#define OSPF_SPF_HEAP_ARITY     4
+
+struct ospf_spf_heap
+{
+  struct vertex **array;
+  unsigned int count;
+  unsigned int max;
+};
+
+struct ospf_spf_arena
+{
+  struct ospf_spf_arena_block *blocks;
+  struct ospf_spf_arena_block *current;
+  void *free[OSPF_SPF_ARENA_KINDS];
+  struct ospf_spf_heap candidates;
+
+  /* What the tree found wrong, logged by the main thread once it is
+     done, as it may be calculated on a worker. */
+  unsigned int no_oi;			/* Links of no interface found, */
+  int no_oi_lsa_pos;			/* the last at this position. */
+  unsigned int no_nexthop;		/* Point-to-point links, */
+  struct ospf_interface *no_nexthop_oi;	/* the last on this. */
+  unsigned int no_vl_data;		/* Virtual links not approved. */
+  unsigned int bad_link_type;		/* Router-LSA links, */
+  int bad_link_type_last;		/* the last of this type. */
+};
+
+static struct ospf_spf_arena *
+ospf_spf_arena_new (void)
+{
+  return XCALLOC (MTYPE_OSPF_VERTEX, sizeof (struct ospf_spf_arena));
+}
+
+static void *
+ospf_spf_arena_alloc (struct ospf_spf_arena *arena,
+                      enum ospf_spf_arena_kind kind, size_t size)
 {
-  struct vertex * v1 = (struct vertex *) node1;
-  struct vertex * v2 = (struct vertex *) node2;
-  if (v1 != NULL && v2 != NULL )
+  struct ospf_spf_arena_block *b;
+  void *p;
+
+  if ((p = arena->free[kind]) != NULL)
+    arena->free[kind] = *(void **) p;
+  else
     {
-      /* network vertices must be chosen before router vertices of same
-       * cost in order to find all shortest paths
-       */
-      if ( ((v1->distance - v2->distance) == 0)
-          && (v1->type != v2->type))
+      size = OSPF_SPF_ARENA_ALIGN (size);
+      assert (size <= OSPF_SPF_ARENA_BLOCK - OSPF_SPF_ARENA_HEADER);
+
+      b = arena->current;
+      while (b == NULL || b->used + size > OSPF_SPF_ARENA_BLOCK)
         {
-          switch (v1->type)
+          /* Carve the next block kept from an earlier tree, if any. */
+          if (b != NULL && b->next != NULL)
             {
-              case OSPF_VERTEX_NETWORK:
-                return -1;
-              case OSPF_VERTEX_ROUTER:
-                return 1;
+              b = b->next;
+              b->used = OSPF_SPF_ARENA_HEADER;
+              continue;
             }
+
+          b = XMALLOC (MTYPE_OSPF_VERTEX, OSPF_SPF_ARENA_BLOCK);
+          b->next = NULL;
+          b->used = OSPF_SPF_ARENA_HEADER;
+          if (arena->current)
+            arena->current->next = b;
+          else
+            arena->blocks = b;
         }
-      else
-        return (v1->distance - v2->distance);
+      arena->current = b;
+      p = (u_char *) b + b->used;
+      b->used += size;
     }
-  return 0;
+
+  memset (p, 0, size);
+  return p;
 }
 
 static void
-update_stat (void *node , int position)
+ospf_spf_arena_free (struct ospf_spf_arena *arena,
+                     enum ospf_spf_arena_kind kind, void *p)
 {
-  struct vertex *v = node;
-
-  /* Set the status of the vertex, when its position changes. */
-  *(v->stat) = position;
+  *(void **) p = arena->free[kind];
+  arena->free[kind] = p;
 }
 
-static struct vertex_nexthop *
-vertex_nexthop_new (void)
+/* Drop everything carved, keeping the blocks for the next tree. */
+static void
+ospf_spf_arena_reset (struct ospf_spf_arena *arena)
 {
-  return XCALLOC (MTYPE_OSPF_NEXTHOP, sizeof (struct vertex_nexthop));
+  int kind;
+
+  for (kind = 0; kind < OSPF_SPF_ARENA_KINDS; kind++)
+    arena->free[kind] = NULL;
+  arena->current = arena->blocks;
+  if (arena->current)
+    arena->current->used = OSPF_SPF_ARENA_HEADER;
+  arena->candidates.count = 0;
 }
 
 static void
-vertex_nexthop_free (struct vertex_nexthop *nh)
+ospf_spf_arena_delete (struct ospf_spf_arena *arena)
+{
+  struct ospf_spf_arena_block *b, *next;
+
+  for (b = arena->blocks; b; b = next)
+    {
+      next = b->next;
+      XFREE (MTYPE_OSPF_VERTEX, b);
+    }
+  if (arena->candidates.array)
+    XFREE (MTYPE_OSPF_VERTEX, arena->candidates.array);
+  XFREE (MTYPE_OSPF_VERTEX, arena);
+}
+
+/* The vertices of an area's tree are kept from one calculation to the
+ * next, in area->spf_vertices, and hashed by the type and ID of their
+ * LSA, which they hold a lock on.
+ */
+static unsigned int
+ospf_vertex_hash_key (void *data)
+{
+  struct vertex *v = data;
+
+  return jhash_2words (v->type, v->id.s_addr, 0);
+}
+
+static int
+ospf_vertex_hash_cmp (const void *d1, const void *d2)
+{
+  const struct vertex *v1 = d1;
+  const struct vertex *v2 = d2;
+
+  return v1->type == v2->type && IPV4_ADDR_SAME (&v1->id, &v2->id);
+}
+
+static struct vertex *
+ospf_vertex_lookup (struct ospf_area *area, u_char type, struct in_addr id)
 {
-  XFREE (MTYPE_OSPF_NEXTHOP, nh);
+  struct vertex key;
+
+  key.type = type;
+  key.id = id;
+  return hash_lookup (area->spf_vertex_hash, &key);
 }
 
-/* Free the canonical nexthop objects for an area, ie the nexthop objects
- * attached to the first-hop router vertices, and any intervening network
- * vertices.
+/* Heap related functions, for the managment of the candidates.
+ * Network vertices must be chosen before router vertices of same
+ * cost in order to find all shortest paths.
  */
+static int
+ospf_vertex_before (struct vertex *v1, struct vertex *v2)
+{
+  if (v1->distance != v2->distance)
+    return v1->distance < v2->distance;
+  return v1->type == OSPF_VERTEX_NETWORK && v2->type == OSPF_VERTEX_ROUTER;
+}
+
 static void
-ospf_canonical_nexthops_free (struct vertex *root)
+ospf_spf_heap_set (struct ospf_spf_heap *heap, unsigned int i,
+                   struct vertex *v)
 {
-  struct listnode *node, *nnode;
-  struct vertex *child;
-  
-  for (ALL_LIST_ELEMENTS (root->children, node, nnode, child))
+  heap->array[i] = v;
+  *(v->stat) = i;
+}
+
+static void
+ospf_spf_heap_up (struct ospf_spf_heap *heap, unsigned int i)
+{
+  struct vertex *v = heap->array[i];
+  unsigned int parent;
+
+  while (i > 0)
     {
-      struct listnode *n2, *nn2;
-      struct vertex_parent *vp;
-      
-      /* router vertices through an attached network each
-       * have a distinct (canonical / not inherited) nexthop
-       * which must be freed.
-       *
-       * A network vertex can only have router vertices as its
-       * children, so only one level of recursion is possible.
-       */
-      if (child->type == OSPF_VERTEX_NETWORK)
-        ospf_canonical_nexthops_free (child);
-      
-      /* Free child nexthops pointing back to this root vertex */
-      for (ALL_LIST_ELEMENTS (child->parents, n2, nn2, vp))
-        if (vp->parent == root && vp->nexthop)
-          vertex_nexthop_free (vp->nexthop);
+      parent = (i - 1) / OSPF_SPF_HEAP_ARITY;
+      if (!ospf_vertex_before (v, heap->array[parent]))
+        break;
+      ospf_spf_heap_set (heap, i, heap->array[parent]);
+      i = parent;
+    }
+  ospf_spf_heap_set (heap, i, v);
+}
+
+static void
+ospf_spf_heap_down (struct ospf_spf_heap *heap, unsigned int i)
+{
+  struct vertex *v = heap->array[i];
+  unsigned int child, last, best;
+
+  while ((child = i * OSPF_SPF_HEAP_ARITY + 1) < heap->count)
+    {
+      last = child + OSPF_SPF_HEAP_ARITY;
+      if (last > heap->count)
+        last = heap->count;
+      for (best = child++; child < last; child++)
+        if (ospf_vertex_before (heap->array[child], heap->array[best]))
+          best = child;
+
+      if (!ospf_vertex_before (heap->array[best], v))
+        break;
+      ospf_spf_heap_set (heap, i, heap->array[best]);
+      i = best;
+    }
+  ospf_spf_heap_set (heap, i, v);
+}
+
+static void
+ospf_spf_heap_push (struct ospf_spf_heap *heap, struct vertex *v)
+{
+  if (heap->count == heap->max)
+    {
+      heap->max = heap->max ? heap->max * 2 : 256;
+      heap->array = XREALLOC (MTYPE_OSPF_VERTEX, heap->array,
+                              heap->max * sizeof (struct vertex *));
+    }
+  heap->array[heap->count] = v;
+  ospf_spf_heap_up (heap, heap->count++);
+}
+
+static struct vertex *
+ospf_spf_heap_pop (struct ospf_spf_heap *heap)
+{
+  struct vertex *v = heap->array[0];
+
+  if (--heap->count > 0)
+    {
+      heap->array[0] = heap->array[heap->count];
+      ospf_spf_heap_down (heap, 0);
     }
-}      
+  return v;
+}
+
+static struct vertex_nexthop *
+vertex_nexthop_new (struct ospf_area *area)
+{
+  return ospf_spf_arena_alloc (area->spf_arena, OSPF_SPF_ARENA_NEXTHOP,
+                               sizeof (struct vertex_nexthop));
+}
 
 /* TODO: Parent list should be excised, in favour of maintaining only
  * vertex_nexthop, with refcounts.
  */
 static struct vertex_parent *
-vertex_parent_new (struct vertex *v, int backlink, struct vertex_nexthop *hop)
+vertex_parent_new (struct ospf_area *area, struct vertex *v,
+                   struct vertex *child, int backlink,
+                   struct vertex_nexthop *hop)
 {
   struct vertex_parent *new;
   
-  new = XMALLOC (MTYPE_OSPF_VERTEX_PARENT, sizeof (struct vertex_parent));
-  
-  if (new == NULL)
-    return NULL;
-  
+  new = ospf_spf_arena_alloc (area->spf_arena, OSPF_SPF_ARENA_PARENT,
+                              sizeof (struct vertex_parent));
   new->parent = v;
+  new->child = child;
   new->backlink = backlink;
   new->nexthop = hop;
   return new;
 }
 
 static void
-vertex_parent_free (void *p)
+vertex_parent_free (struct ospf_area *area, struct vertex_parent *vp)
 {
-  XFREE (MTYPE_OSPF_VERTEX_PARENT, p);
+  ospf_spf_arena_free (area->spf_arena, OSPF_SPF_ARENA_PARENT, vp);
 }
 
 static struct vertex *
-ospf_vertex_new (struct ospf_lsa *lsa)
+ospf_vertex_new (struct ospf_area *area, struct ospf_lsa *lsa)
 {
   struct vertex *new;
 
-  new = XCALLOC (MTYPE_OSPF_VERTEX, sizeof (struct vertex));
+  new = ospf_spf_arena_alloc (area->spf_arena, OSPF_SPF_ARENA_VERTEX,
+                              sizeof (struct vertex));
 
   new->flags = 0;
   new->stat = &(lsa->stat);
   new->type = lsa->data->type;
   new->id = lsa->data->id;
   new->lsa = lsa->data;
-  new->children = list_new ();
-  new->parents = list_new ();
-  new->parents->del = vertex_parent_free;
+  new->lsa_p = ospf_lsa_lock (lsa);
   
-  listnode_add (&vertex_list, new);
+  listnode_add (area->spf_vertices, new);
+  hash_get (area->spf_vertex_hash, new, hash_alloc_intern);
   
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("%s: Created %s vertex %s", __func__,
@@ -229,38 +413,53 @@ ospf_vertex_new (struct ospf_lsa *lsa)
 }
 
 static void
-ospf_vertex_free (void *data)
+ospf_spf_flush_parents (struct ospf_area *area, struct vertex *w)
 {
-  struct vertex *v = data;
+  struct vertex_parent *vp, *next;
   
+  /* delete the existing nexthops */
+  for (vp = w->parents; vp; vp = next)
+    {
+      next = vp->next;
+      vertex_parent_free (area, vp);
+    }
+  w->parents = NULL;
+}
+
+static void
+ospf_vertex_free (struct ospf_area *area, struct vertex *v)
+{
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("%s: Free %s vertex %s", __func__,
                 v->type == OSPF_VERTEX_ROUTER ? "Router" : "Network",
                 inet_ntoa (v->lsa->id));
   
-  /* There should be no parents potentially holding references to this vertex
-   * Children however may still be there, but presumably referenced by other
-   * vertices
+  /* The children of the vertex are linked through their own parents,
+   * which go with them.
    */
-  //assert (listcount (v->parents) == 0);
-  
-  if (v->children)
-    list_delete (v->children);
-  v->children = NULL;
-  
-  if (v->parents)
-    list_delete (v->parents);
-  v->parents = NULL;
+  ospf_spf_flush_parents (area, v);
   
   v->lsa = NULL;
+  ospf_lsa_unlock (&v->lsa_p);
   
-  XFREE (MTYPE_OSPF_VERTEX, v);
+  ospf_spf_arena_free (area->spf_arena, OSPF_SPF_ARENA_VERTEX, v);
+}
+
+/* Take a vertex off its area's tree and free it. */
+static void
+ospf_vertex_delete (struct ospf_area *area, struct vertex *v)
+{
+  listnode_delete (area->spf_vertices, v);
+  hash_release (area->spf_vertex_hash, v);
+  ospf_vertex_free (area, v);
 }
 
 static void
 ospf_vertex_dump(const char *msg, struct vertex *v,
 		 int print_parents, int print_children)
 {
+  struct vertex_parent *vp;
+
   if ( ! IS_DEBUG_OSPF_EVENT)
     return;
 
@@ -273,30 +472,21 @@ ospf_vertex_dump(const char *msg, struct vertex *v,
 
   if (print_parents)
     {
-      struct listnode *node;
-      struct vertex_parent *vp;
-      
-      for (ALL_LIST_ELEMENTS_RO (v->parents, node, vp))
+      for (vp = v->parents; vp; vp = vp->next)
         {
 	  char buf1[BUFSIZ];
 	  
-	  if (vp)
-	    {
-	      zlog_debug ("parent %s backlink %d nexthop %s  interface %s",
-	                 inet_ntoa(vp->parent->lsa->id), vp->backlink,
-			 inet_ntop(AF_INET, &vp->nexthop->router, buf1, BUFSIZ),
-			 vp->nexthop->oi ? IF_NAME(vp->nexthop->oi) : "NULL");
-	    }
+	  zlog_debug ("parent %s backlink %d nexthop %s  interface %s",
+	             inet_ntoa(vp->parent->lsa->id), vp->backlink,
+		     inet_ntop(AF_INET, &vp->nexthop->router, buf1, BUFSIZ),
+		     vp->nexthop->oi ? IF_NAME(vp->nexthop->oi) : "NULL");
 	}
     }
 
   if (print_children)
     {
-      struct listnode *cnode;
-      struct vertex *cv;
-      
-      for (ALL_LIST_ELEMENTS_RO (v->children, cnode, cv))
-        ospf_vertex_dump(" child:", cv, 0, 0);
+      for (vp = v->children; vp; vp = vp->sibling)
+        ospf_vertex_dump(" child:", vp->child, 0, 0);
     }
 }
 
@@ -305,50 +495,181 @@ ospf_vertex_dump(const char *msg, struct vertex *v,
 static void
 ospf_vertex_add_parent (struct vertex *v)
 {
-  struct vertex_parent *vp;
-  struct listnode *node;
+  struct vertex_parent *vp, *prev;
   
   assert (v && v->parents);
   
-  for (ALL_LIST_ELEMENTS_RO (v->parents, node, vp))
+  for (vp = v->parents; vp; vp = vp->next)
     {
-      assert (vp->parent && vp->parent->children);
+      assert (vp->parent);
       
       /* No need to add two links from the same parent. */
-      if (listnode_lookup (vp->parent->children, v) == NULL)
-        listnode_add (vp->parent->children, v);
+      for (prev = v->parents; prev != vp; prev = prev->next)
+        if (prev->parent == vp->parent)
+          break;
+      if (prev != vp)
+        continue;
+
+      vp->sibling = NULL;
+      if (vp->parent->children_tail)
+        vp->parent->children_tail->sibling = vp;
+      else
+        vp->parent->children = vp;
+      vp->parent->children_tail = vp;
     }
 }
 
+/* Take a vertex out of the children of one of its parents. */
+static void
+ospf_vertex_unlink_child (struct vertex_parent *vp)
+{
+  struct vertex *parent = vp->parent;
+  struct vertex_parent *cp, *prev = NULL;
+
+  for (cp = parent->children; cp; prev = cp, cp = cp->sibling)
+    if (cp == vp)
+      {
+        if (prev)
+          prev->sibling = vp->sibling;
+        else
+          parent->children = vp->sibling;
+        if (parent->children_tail == vp)
+          parent->children_tail = prev;
+        vp->sibling = NULL;
+        return;
+      }
+}
+
 static void
 ospf_spf_init (struct ospf_area *area)
 {
   struct vertex *v;
   
   /* Create root node. */
-  v = ospf_vertex_new (area->router_lsa_self);
+  v = ospf_vertex_new (area, area->router_lsa_self);
   
   area->spf = v;
+}
 
-  /* Reset ABR and ASBR router counts. */
-  area->abr_count = 0;
-  area->asbr_count = 0;
+/* Router-LSAs with fewer links than this, and network-LSAs with fewer
+ * attached routers, are scanned for the link back to a vertex.
+ */
+#define OSPF_SPF_LINK_INDEX_MIN 8
+
+/* Index the links of a router- or network-LSA by ID, so the check of
+ * 16.1 (2)(b) for a link back from W to V does not scan W, which on a
+ * hub would make the calculation quadratic.  Built once, as the LSA is
+ * installed, and only read by the calculations after.  Each slot holds
+ * the offset of the link in the LSA and its position, plus one.
+ */
+void
+ospf_spf_lsa_index (struct ospf_lsa *lsa)
+{
+  struct lsa_header *h = lsa->data;
+  struct router_lsa_link *l;
+  u_char *p, *lim;
+  unsigned int count, size, slot, i;
+  u_int32_t *index;
+  struct in_addr *id;
+
+  if (lsa->link_index != NULL)
+    return;
+
+  p = (u_char *) h + OSPF_LSA_HEADER_SIZE + 4;
+  lim = (u_char *) h + ntohs (h->length);
+
+  if (h->type == OSPF_ROUTER_LSA)
+    count = ntohs (((struct router_lsa *) h)->links);
+  else if (h->type == OSPF_NETWORK_LSA)
+    count = (lim - p) / sizeof (struct in_addr);
+  else
+    return;
+
+  if (count < OSPF_SPF_LINK_INDEX_MIN)
+    return;
+
+  for (size = 16; size < count * 2; size <<= 1)
+    ;
+  index = XCALLOC (MTYPE_OSPF_LSA_LINKS, size * sizeof (u_int32_t));
+
+  for (i = 0; i < count && p < lim; i++)
+    {
+      if (h->type == OSPF_ROUTER_LSA)
+        {
+          l = (struct router_lsa_link *) p;
+          id = &l->link_id;
+          p += OSPF_ROUTER_LSA_LINK_SIZE
+               + l->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE;
+          if (l->m[0].type == LSA_LINK_TYPE_STUB)
+            continue;
+        }
+      else
+        {
+          id = (struct in_addr *) p;
+          p += sizeof (struct in_addr);
+        }
+
+      for (slot = jhash_1word (id->s_addr, 0) & (size - 1);
+           index[slot] != 0;
+           slot = (slot + 1) & (size - 1))
+        ;
+      index[slot] = (((u_char *) id - (u_char *) h) << 16) | (i + 1);
+    }
+
+  lsa->link_index = index;
+  lsa->link_index_mask = size - 1;
 }
 
 /* return index of link back to V from W, or -1 if no link found */
-static int
-ospf_lsa_has_link (struct lsa_header *w, struct lsa_header *v)
+int
+ospf_lsa_has_link (struct ospf_lsa *w_lsa, struct lsa_header *v)
 {
-  unsigned int i, length;
+  struct lsa_header *w = w_lsa->data;
+  unsigned int i, length, slot;
+  struct router_lsa_link *l;
   struct router_lsa *rl;
   struct network_lsa *nl;
 
+  if (w->type == OSPF_NETWORK_LSA && v->type == OSPF_NETWORK_LSA)
+    return -1;
+
+  if (w_lsa->link_index)
+    {
+      for (slot = jhash_1word (v->id.s_addr, 0) & w_lsa->link_index_mask;
+           w_lsa->link_index[slot] != 0;
+           slot = (slot + 1) & w_lsa->link_index_mask)
+        {
+          u_int32_t e = w_lsa->link_index[slot];
+          u_char *id = (u_char *) w + (e >> 16);
+
+          if (!IPV4_ADDR_SAME ((struct in_addr *) id, &v->id))
+            continue;
+          if (w->type == OSPF_ROUTER_LSA)
+            {
+              l = (struct router_lsa_link *) id;
+              switch (l->m[0].type)
+                {
+                case LSA_LINK_TYPE_POINTOPOINT:
+                case LSA_LINK_TYPE_VIRTUALLINK:
+                  if (v->type != OSPF_ROUTER_LSA)
+                    continue;
+                  break;
+                case LSA_LINK_TYPE_TRANSIT:
+                  if (v->type != OSPF_NETWORK_LSA)
+                    continue;
+                  break;
+                default:
+                  continue;
+                }
+            }
+          return (e & 0xffff) - 1;
+        }
+      return -1;
+    }
+
   /* In case of W is Network LSA. */
   if (w->type == OSPF_NETWORK_LSA)
     {
-      if (v->type == OSPF_NETWORK_LSA)
-        return -1;
-
       nl = (struct network_lsa *) w;
       length = (ntohs (w->length) - OSPF_LSA_HEADER_SIZE - 4) / 4;
 
@@ -399,6 +720,7 @@ ospf_lsa_has_link (struct lsa_header *w, struct lsa_header *v)
   return -1;
 }
 
+
 /* Find the next link after prev_link from v to w.  If prev_link is
  * NULL, return the first link from v to w.  Ignore stub and virtual links;
  * these link types will never be returned.
@@ -442,31 +764,16 @@ ospf_get_next_link (struct vertex *v, struct vertex *w,
   return NULL;
 }
 
-static void
-ospf_spf_flush_parents (struct vertex *w)
-{
-  struct vertex_parent *vp;
-  struct listnode *ln, *nn;
-  
-  /* delete the existing nexthops */
-  for (ALL_LIST_ELEMENTS (w->parents, ln, nn, vp))
-    {
-      list_delete_node (w->parents, ln);
-      vertex_parent_free (vp);
-    }
-}
-
 /* 
  * Consider supplied next-hop for inclusion to the supplied list of
  * equal-cost next-hops, adjust list as neccessary.  
  */
 static void
-ospf_spf_add_parent (struct vertex *v, struct vertex *w,
-                     struct vertex_nexthop *newhop,
+ospf_spf_add_parent (struct ospf_area *area, struct vertex *v,
+                     struct vertex *w, struct vertex_nexthop *newhop,
                      unsigned int distance)
 {
-  struct vertex_parent *vp, *wp;
-  struct listnode *node;
+  struct vertex_parent *vp, *wp, *last = NULL;
     
   /* we must have a newhop, and a distance */
   assert (v && w && newhop);
@@ -496,14 +803,14 @@ ospf_spf_add_parent (struct vertex *v, struct vertex *w,
       if (IS_DEBUG_OSPF_EVENT)
         zlog_debug ("%s: distance %d better than %d, flushing existing parents",
                     __func__, distance, w->distance);
-      ospf_spf_flush_parents (w);
+      ospf_spf_flush_parents (area, w);
       w->distance = distance;
     }
   
   /* new parent is <= existing parents, add it to parent list (if nexthop
    * not on parent list)
    */  
-  for (ALL_LIST_ELEMENTS_RO(w->parents, node, wp))
+  for (wp = w->parents; wp; last = wp, wp = wp->next)
     {
       if (memcmp(newhop, wp->nexthop, sizeof(*newhop)) == 0)
         {
@@ -513,8 +820,12 @@ ospf_spf_add_parent (struct vertex *v, struct vertex *w,
         }
     }
 
-  vp = vertex_parent_new (v, ospf_lsa_has_link (w->lsa, v->lsa), newhop);
-  listnode_add (w->parents, vp);
+  vp = vertex_parent_new (area, v, w, ospf_lsa_has_link (w->lsa_p, v->lsa),
+                          newhop);
+  if (last)
+    last->next = vp;
+  else
+    w->parents = vp;
 
   return;
 }
@@ -535,7 +846,6 @@ ospf_nexthop_calculation (struct ospf_area *area, struct vertex *v,
                           struct vertex *w, struct router_lsa_link *l,
                           unsigned int distance, int lsa_pos)
 {
-  struct listnode *node, *nnode;
   struct vertex_nexthop *nh;
   struct vertex_parent *vp;
   struct ospf_interface *oi = NULL;
@@ -565,10 +875,8 @@ ospf_nexthop_calculation (struct ospf_area *area, struct vertex *v,
       oi = ospf_if_lookup_by_lsa_pos (area, lsa_pos);
       if (!oi)
 	{
-	  zlog_debug("%s: OI not found in LSA: lsa_pos:%d link_id:%s link_data:%s",
-		     __func__, lsa_pos,
-		     inet_ntop (AF_INET, &l->link_id, buf1, BUFSIZ),
-		     inet_ntop (AF_INET, &l->link_data, buf2, BUFSIZ));
+	  area->spf_arena->no_oi++;
+	  area->spf_arena->no_oi_lsa_pos = lsa_pos;
 	  return 0;
 	}
 
@@ -654,15 +962,17 @@ ospf_nexthop_calculation (struct ospf_area *area, struct vertex *v,
               if (added)
                 {
                   /* found all necessary info to build nexthop */
-                  nh = vertex_nexthop_new ();
+                  nh = vertex_nexthop_new (area);
                   nh->oi = oi;
                   nh->router = nexthop;
-                  ospf_spf_add_parent (v, w, nh, distance);
+                  ospf_spf_add_parent (area, v, w, nh, distance);
                   return 1;
                 }
               else
-		zlog_info("%s: could not determine nexthop for link %s",
-			  __func__, oi->ifp->name);
+                {
+                  area->spf_arena->no_nexthop++;
+                  area->spf_arena->no_nexthop_oi = oi;
+                }
             } /* end point-to-point link from V to W */
           else if (l->m[0].type == LSA_LINK_TYPE_VIRTUALLINK)
             {
@@ -680,15 +990,14 @@ ospf_nexthop_calculation (struct ospf_area *area, struct vertex *v,
               if (vl_data 
                   && CHECK_FLAG (vl_data->flags, OSPF_VL_FLAG_APPROVED))
                 {
-                  nh = vertex_nexthop_new ();
+                  nh = vertex_nexthop_new (area);
                   nh->oi = vl_data->nexthop.oi;
                   nh->router = vl_data->nexthop.router;
-                  ospf_spf_add_parent (v, w, nh, distance);
+                  ospf_spf_add_parent (area, v, w, nh, distance);
                   return 1;
                 }
               else
-                  zlog_info("ospf_nexthop_calculation(): "
-                            "vl_data for VL link not found");
+                area->spf_arena->no_vl_data++;
             } /* end virtual-link from V to W */
           return 0;
         } /* end W is a Router vertex */
@@ -696,10 +1005,10 @@ ospf_nexthop_calculation (struct ospf_area *area, struct vertex *v,
         {
           assert(w->type == OSPF_VERTEX_NETWORK);
 
-	  nh = vertex_nexthop_new ();
+	  nh = vertex_nexthop_new (area);
 	  nh->oi = oi;
 	  nh->router.s_addr = 0; /* Nexthop not required */
-	  ospf_spf_add_parent (v, w, nh, distance);
+	  ospf_spf_add_parent (area, v, w, nh, distance);
 	  return 1;
         }
     } /* end V is the root */
@@ -707,7 +1016,7 @@ ospf_nexthop_calculation (struct ospf_area *area, struct vertex *v,
   else if (v->type == OSPF_VERTEX_NETWORK)
     {
       /* See if any of V's parents are the root. */
-      for (ALL_LIST_ELEMENTS (v->parents, node, nnode, vp))
+      for (vp = v->parents; vp; vp = vp->next)
         {
           if (vp->parent == area->spf) /* connects to root? */
 	    {
@@ -726,11 +1035,11 @@ ospf_nexthop_calculation (struct ospf_area *area, struct vertex *v,
 		   * use can then be derived from the next hop IP address (or 
 		   * it can be inherited from the parent network).
 		   */
-		  nh = vertex_nexthop_new ();
+		  nh = vertex_nexthop_new (area);
 		  nh->oi = vp->nexthop->oi;
 		  nh->router = l->link_data;
 		  added = 1;
-                  ospf_spf_add_parent (v, w, nh, distance);
+                  ospf_spf_add_parent (area, v, w, nh, distance);
                 }
               /* Note lack of return is deliberate. See next comment. */
           }
@@ -773,23 +1082,51 @@ ospf_nexthop_calculation (struct ospf_area *area, struct vertex *v,
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("%s: Intervening routers, adding parent(s)", __func__);
 
-  for (ALL_LIST_ELEMENTS (v->parents, node, nnode, vp))
+  for (vp = v->parents; vp; vp = vp->next)
     {
       added = 1;
-      ospf_spf_add_parent (v, w, vp->nexthop, distance);
+      ospf_spf_add_parent (area, v, w, vp->nexthop, distance);
     }
   
   return added;
 }
 
+/* Whether reaching W, a vertex kept on the tree from the last
+ * calculation, through V at the given distance would change its parents.
+ */
+static int
+ospf_spf_kept_reached (struct ospf_area *area, struct vertex *v,
+                       struct ospf_lsa *w_lsa, unsigned int distance)
+{
+  struct vertex *w;
+  struct vertex_parent *vp;
+
+  w = ospf_vertex_lookup (area, w_lsa->data->type, w_lsa->data->id);
+  if (w == NULL || CHECK_FLAG (w->flags, OSPF_VERTEX_NEW) || w == area->spf)
+    return 0;
+
+  if (distance < w->distance)
+    return 1;
+  if (distance > w->distance)
+    return 0;
+
+  for (vp = w->parents; vp; vp = vp->next)
+    if (vp->parent == v)
+      return 0;
+  return 1;
+}
+
 /* RFC2328 Section 16.1 (2).
  * v is on the SPF tree.  Examine the links in v's LSA.  Update the list
  * of candidates with any vertices not already on the list.  If a lower-cost
  * path is found to a vertex already on the candidate list, store the new cost.
+ *
+ * When growing a kept tree incrementally, returns -1 if a path through v
+ * would change a vertex kept from the last calculation, 0 otherwise.
  */
-static void
+static int
 ospf_spf_next (struct vertex *v, struct ospf_area *area,
-	       struct pqueue * candidate)
+	       struct ospf_spf_heap *candidate, int incremental)
 {
   struct ospf_lsa *w_lsa = NULL;
   u_char *p;
@@ -798,14 +1135,6 @@ ospf_spf_next (struct vertex *v, struct ospf_area *area,
   struct in_addr *r;
   int type = 0, lsa_pos=-1, lsa_pos_next=0;
 
-  /* If this is a router-LSA, and bit V of the router-LSA (see Section
-     A.4.2:RFC2328) is set, set Area A's TransitCapability to TRUE.  */
-  if (v->type == OSPF_VERTEX_ROUTER)
-    {
-      if (IS_ROUTER_LSA_VIRTUAL ((struct router_lsa *) v->lsa))
-        area->transit = OSPF_TRANSIT_TRUE;
-    }
-  
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("%s: Next vertex of %s vertex %s",
                 __func__, 
@@ -877,7 +1206,8 @@ ospf_spf_next (struct vertex *v, struct ospf_area *area,
                   zlog_debug ("found the LSA");
               break;
             default:
-              zlog_warn ("Invalid LSA link type %d", type);
+              area->spf_arena->bad_link_type++;
+              area->spf_arena->bad_link_type_last = type;
               continue;
             }
         }
@@ -913,22 +1243,13 @@ ospf_spf_next (struct vertex *v, struct ospf_area *area,
           continue;
         }
 
-      if (ospf_lsa_has_link (w_lsa->data, v->lsa) < 0 )
+      if (ospf_lsa_has_link (w_lsa, v->lsa) < 0 )
         {
           if (IS_DEBUG_OSPF_EVENT)
             zlog_debug ("The LSA doesn't have a link back");
           continue;
         }
 
-      /* (c) If vertex W is already on the shortest-path tree, examine
-         the next link in the LSA. */
-      if (w_lsa->stat == LSA_SPF_IN_SPFTREE)
-	{
-	  if (IS_DEBUG_OSPF_EVENT)
-	    zlog_debug ("The LSA is already in SPF");
-	  continue;
-	}
-
       /* (d) Calculate the link state cost D of the resulting path
          from the root to vertex W.  D is equal to the sum of the link
          state cost of the (already calculated) shortest path to
@@ -941,17 +1262,36 @@ ospf_spf_next (struct vertex *v, struct ospf_area *area,
       else /* v is not a Router-LSA */
 	distance = v->distance;
 
+      /* (c) If vertex W is already on the shortest-path tree, examine
+         the next link in the LSA.  A vertex kept from the last
+         calculation must not be offered a path as good as its own. */
+      if (w_lsa->stat == LSA_SPF_IN_SPFTREE)
+	{
+	  if (IS_DEBUG_OSPF_EVENT)
+	    zlog_debug ("The LSA is already in SPF");
+	  if (incremental
+	      && ospf_spf_kept_reached (area, v, w_lsa, distance))
+	    return -1;
+	  continue;
+	}
+
       /* Is there already vertex W in candidate list? */
       if (w_lsa->stat == LSA_SPF_NOT_EXPLORED)
 	{
           /* prepare vertex W. */
-          w = ospf_vertex_new (w_lsa);
+          w = ospf_vertex_new (area, w_lsa);
+          if (incremental)
+            SET_FLAG (w->flags, OSPF_VERTEX_NEW);
 
           /* Calculate nexthop to W. */
           if (ospf_nexthop_calculation (area, v, w, l, distance, lsa_pos))
-            pqueue_enqueue (w, candidate);
-          else if (IS_DEBUG_OSPF_EVENT)
-            zlog_debug ("Nexthop Calc failed");
+            ospf_spf_heap_push (candidate, w);
+          else
+            {
+              if (IS_DEBUG_OSPF_EVENT)
+                zlog_debug ("Nexthop Calc failed");
+              ospf_vertex_delete (area, w);
+            }
 	}
       else if (w_lsa->stat >= 0)
 	{
@@ -979,22 +1319,18 @@ ospf_spf_next (struct vertex *v, struct ospf_area *area,
                * will flush the old parents
                */
 	      if (ospf_nexthop_calculation (area, v, w, l, distance, lsa_pos))
-                /* Decrease the key of the node in the heap.
-                 * trickle-sort it up towards root, just in case this
-                 * node should now be the new root due the cost change. 
-                 * (next pqueu_{de,en}queue will fully re-heap the queue).
-                 */
-                trickle_up (w_lsa->stat, candidate);
+                /* Decrease the key of the node in the heap. */
+                ospf_spf_heap_up (candidate, w_lsa->stat);
             }
         } /* end W is already on the candidate list */
     } /* end loop over the links in V's LSA */
+
+  return 0;
 }
 
 static void
 ospf_spf_dump (struct vertex *v, int i)
 {
-  struct listnode *cnode;
-  struct listnode *nnode;
   struct vertex_parent *parent;
 
   if (v->type == OSPF_VERTEX_ROUTER)
@@ -1011,7 +1347,7 @@ ospf_spf_dump (struct vertex *v, int i)
     }
 
   if (IS_DEBUG_OSPF_EVENT)
-    for (ALL_LIST_ELEMENTS_RO (v->parents, nnode, parent))
+    for (parent = v->parents; parent; parent = parent->next)
       {
         zlog_debug (" nexthop %p %s %s", 
                     (void *)parent->nexthop,
@@ -1022,8 +1358,8 @@ ospf_spf_dump (struct vertex *v, int i)
 
   i++;
 
-  for (ALL_LIST_ELEMENTS_RO (v->children, cnode, v))
-    ospf_spf_dump (v, i);
+  for (parent = v->children; parent; parent = parent->sibling)
+    ospf_spf_dump (parent->child, i);
 }
 
 /* Second stage of SPF calculation. */
@@ -1032,7 +1368,7 @@ ospf_spf_process_stubs (struct ospf_area *area, struct vertex *v,
                         struct route_table *rt,
                         int parent_is_root)
 {
-  struct listnode *cnode, *cnnode;
+  struct vertex_parent *vp;
   struct vertex *child;
 
   if (IS_DEBUG_OSPF_EVENT)
@@ -1073,8 +1409,9 @@ ospf_spf_process_stubs (struct ospf_area *area, struct vertex *v,
 
   ospf_vertex_dump("ospf_process_stubs(): after examining links: ", v, 1, 1);
 
-  for (ALL_LIST_ELEMENTS (v->children, cnode, cnnode, child))
+  for (vp = v->children; vp; vp = vp->sibling)
     {
+      child = vp->child;
       if (CHECK_FLAG (child->flags, OSPF_VERTEX_PROCESSED))
         continue;
       
@@ -1181,65 +1518,562 @@ ospf_rtrs_print (struct route_table *rtrs)
 }
 #endif
 
-/* Calculating the shortest-path tree for an area. */
+/* Free an area's shortest-path tree: the vertices let go of their LSAs,
+ * and everything else goes with the arena in one go.
+ */
 static void
-ospf_spf_calculate (struct ospf_area *area, struct route_table *new_table,
-                    struct route_table *new_rtrs)
+ospf_spf_tree_free (struct ospf_area *area)
 {
-  struct pqueue *candidate;
+  struct listnode *node;
   struct vertex *v;
-  
-  if (IS_DEBUG_OSPF_EVENT)
-    {
-      zlog_debug ("ospf_spf_calculate: Start");
-      zlog_debug ("ospf_spf_calculate: running Dijkstra for area %s",
-                 inet_ntoa (area->area_id));
-    }
 
-  /* Check router-lsa-self.  If self-router-lsa is not yet allocated,
-     return this area's calculation. */
-  if (!area->router_lsa_self)
+  area->spf = NULL;
+
+  if (area->spf_vertex_hash)
+    hash_clean (area->spf_vertex_hash, NULL);
+  if (area->spf_vertices)
     {
-      if (IS_DEBUG_OSPF_EVENT)
-        zlog_debug ("ospf_spf_calculate: "
-                   "Skip area %s's calculation due to empty router_lsa_self",
-                   inet_ntoa (area->area_id));
-      return;
+      for (ALL_LIST_ELEMENTS_RO (area->spf_vertices, node, v))
+        ospf_lsa_unlock (&v->lsa_p);
+      list_delete_all_node (area->spf_vertices);
     }
+  if (area->spf_arena)
+    ospf_spf_arena_reset (area->spf_arena);
+}
 
-  /* RFC2328 16.1. (1). */
-  /* Initialize the algorithm's data structures. */
-  
-  /* This function scans all the LSA database and set the stat field to
-   * LSA_SPF_NOT_EXPLORED. */
-  ospf_lsdb_clean_stat (area->lsdb);
-  /* Create a new heap for the candidates. */ 
-  candidate = pqueue_create();
-  candidate->cmp = cmp;
-  candidate->update = update_stat;
+static void
+ospf_spf_tree_init (struct ospf_area *area)
+{
+  if (area->spf_vertices == NULL)
+    area->spf_vertices = list_new ();
+  if (area->spf_vertex_hash == NULL)
+    area->spf_vertex_hash = hash_create (ospf_vertex_hash_key,
+                                         ospf_vertex_hash_cmp);
+  if (area->spf_arena == NULL)
+    area->spf_arena = ospf_spf_arena_new ();
+}
 
-  /* Initialize the shortest-path tree to only the root (which is the
-     router doing the calculation). */
-  ospf_spf_init (area);
-  v = area->spf;
-  /* Set LSA position to LSA_SPF_IN_SPFTREE. This vertex is the root of the
-   * spanning tree. */
-  *(v->stat) = LSA_SPF_IN_SPFTREE;
+/* Free all SPF state of an area, when it goes away. */
+void
+ospf_spf_area_finish (struct ospf_area *area)
+{
+  ospf_spf_tree_free (area);
+  if (area->spf_vertices)
+    list_free (area->spf_vertices);
+  area->spf_vertices = NULL;
+  if (area->spf_vertex_hash)
+    hash_free (area->spf_vertex_hash);
+  area->spf_vertex_hash = NULL;
+  if (area->spf_arena)
+    ospf_spf_arena_delete (area->spf_arena);
+  area->spf_arena = NULL;
+}
+
+/* Drop the trees kept for incremental calculation, so the next
+ * calculation of every area starts from scratch; their nexthops name
+ * interfaces.
+ */
+void
+ospf_spf_tree_flush (struct ospf *ospf)
+{
+  struct listnode *node;
+  struct ospf_area *area;
+
+  if (ospf == NULL)
+    return;
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    ospf_spf_tree_free (area);
+}
+
+/* Vertices in the order Dijkstra takes them off the candidate list:
+ * by distance, networks before routers, then by ID.
+ */
+static int
+ospf_vertex_order_cmp (const void *p1, const void *p2)
+{
+  const struct vertex *v1 = *(const struct vertex * const *) p1;
+  const struct vertex *v2 = *(const struct vertex * const *) p2;
+
+  if (v1->distance != v2->distance)
+    return v1->distance < v2->distance ? -1 : 1;
+  if (v1->type != v2->type)
+    return v1->type == OSPF_VERTEX_NETWORK ? -1 : 1;
+  return IPV4_ADDR_CMP (&v1->id, &v2->id);
+}
+
+static void
+ospf_spf_order (struct ospf_area *area)
+{
+  struct listnode *node;
+  struct vertex **vertices;
+  unsigned int i, count;
+
+  count = listcount (area->spf_vertices);
+  if (count < 2)
+    return;
+
+  vertices = XMALLOC (MTYPE_TMP, count * sizeof (struct vertex *));
+  i = 0;
+  for (node = listhead (area->spf_vertices); node; node = listnextnode (node))
+    vertices[i++] = listgetdata (node);
+
+  qsort (vertices, count, sizeof (struct vertex *), ospf_vertex_order_cmp);
+
+  i = 0;
+  for (node = listhead (area->spf_vertices); node; node = listnextnode (node))
+    node->data = vertices[i++];
+  XFREE (MTYPE_TMP, vertices);
+}
+
+/* RFC2328 16.1 (4) and the second stage: build the intra-area routes of
+ * an area from its shortest-path tree.  This is all a calculation does
+ * when no LSA on or near the tree has changed: a partial route
+ * calculation.
+ */
+static void
+ospf_spf_routes (struct ospf_area *area, struct route_table *new_table,
+                 struct route_table *new_rtrs)
+{
+  struct listnode *node;
+  struct vertex *v;
 
   /* Set Area A's TransitCapability to FALSE. */
   area->transit = OSPF_TRANSIT_FALSE;
   area->shortcut_capability = 1;
+
+  /* Reset ABR and ASBR router counts. */
+  area->abr_count = 0;
+  area->asbr_count = 0;
+
+  for (ALL_LIST_ELEMENTS_RO (area->spf_vertices, node, v))
+    {
+      UNSET_FLAG (v->flags, OSPF_VERTEX_PROCESSED);
+
+      /* If this is a router-LSA, and bit V of the router-LSA (see Section
+         A.4.2:RFC2328) is set, set Area A's TransitCapability to TRUE.  */
+      if (v->type == OSPF_VERTEX_ROUTER
+          && IS_ROUTER_LSA_VIRTUAL ((struct router_lsa *) v->lsa))
+        area->transit = OSPF_TRANSIT_TRUE;
+
+      if (v == area->spf)
+        continue;
+
+      if (v->type == OSPF_VERTEX_ROUTER)
+        ospf_intra_add_router (new_rtrs, v, area);
+      else
+        ospf_intra_add_transit (new_table, v, area);
+    }
+
+  if (IS_DEBUG_OSPF_EVENT)
+    {
+      ospf_spf_dump (area->spf, 0);
+      ospf_route_table_dump (new_table);
+    }
+
+  /* Second stage of SPF calculation procedure's  */
+  ospf_spf_process_stubs (area, area->spf, new_table, 0);
+
+  ospf_vertex_dump (__func__, area->spf, 0, 1);
+}
+
+/* The next link of a router-LSA that is not to a stub network, or NULL. */
+static struct router_lsa_link *
+ospf_spf_transit_link (u_char **p, u_char *lim, int *pos)
+{
+  struct router_lsa_link *l;
+
+  while (*p + OSPF_ROUTER_LSA_LINK_SIZE <= lim)
+    {
+      l = (struct router_lsa_link *) *p;
+      *p += OSPF_ROUTER_LSA_LINK_SIZE
+            + l->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE;
+      (*pos)++;
+      if (l->m[0].type != LSA_LINK_TYPE_STUB)
+        return l;
+    }
+  return NULL;
+}
+
+/* Whether two instances of an LSA give the same edges in the graph, so
+ * the shortest-path tree does not depend on which is installed.  Stub
+ * links only make routes.  The links of the calculating router's own
+ * LSA are found by their position, so they must not move.
+ */
+static int
+ospf_spf_links_same (struct lsa_header *h1, struct lsa_header *h2,
+                     int positions)
+{
+  u_char *p1, *p2, *lim1, *lim2;
+  struct router_lsa_link *l1, *l2;
+  int pos1 = 0, pos2 = 0;
+
+  if (h1->type != h2->type
+      || !IPV4_ADDR_SAME (&h1->id, &h2->id)
+      || !IPV4_ADDR_SAME (&h1->adv_router, &h2->adv_router))
+    return 0;
+
+  if (h1->type == OSPF_NETWORK_LSA)
+    return h1->length == h2->length
+           && memcmp ((u_char *) h1 + OSPF_LSA_HEADER_SIZE,
+                      (u_char *) h2 + OSPF_LSA_HEADER_SIZE,
+                      ntohs (h1->length) - OSPF_LSA_HEADER_SIZE) == 0;
+
+  p1 = (u_char *) h1 + OSPF_LSA_HEADER_SIZE + 4;
+  p2 = (u_char *) h2 + OSPF_LSA_HEADER_SIZE + 4;
+  lim1 = (u_char *) h1 + ntohs (h1->length);
+  lim2 = (u_char *) h2 + ntohs (h2->length);
+
+  for (;;)
+    {
+      l1 = ospf_spf_transit_link (&p1, lim1, &pos1);
+      l2 = ospf_spf_transit_link (&p2, lim2, &pos2);
+      if (l1 == NULL || l2 == NULL)
+        return l1 == l2;
+      if (memcmp (l1, l2, OSPF_ROUTER_LSA_LINK_SIZE) != 0)
+        return 0;
+      if (positions && pos1 != pos2)
+        return 0;
+    }
+}
+
+/* Note a router- or network-LSA of an area being replaced by a new
+ * instance, or flushed (new is NULL), so the next calculation can tell
+ * what to recalculate.  Instances giving the same graph are not noted.
+ */
+void
+ospf_spf_lsa_update (struct ospf_area *area, struct ospf_lsa *old,
+                     struct ospf_lsa *new)
+{
+  struct ospf_lsa *lsa = new ? new : old;
+  unsigned int i;
+
+  if (area == NULL || lsa == NULL)
+    return;
+  if (lsa->data->type != OSPF_ROUTER_LSA
+      && lsa->data->type != OSPF_NETWORK_LSA)
+    return;
+
+  if (old && new && !IS_LSA_MAXAGE (old) && !IS_LSA_MAXAGE (new)
+      && ospf_spf_links_same (old->data, new->data, 0))
+    return;
+
+  /* Past the limit the next calculation is a full one anyway. */
+  if (area->spf_changes_count > OSPF_SPF_CHANGES_MAX)
+    return;
+
+  for (i = 0; i < area->spf_changes_count; i++)
+    if (area->spf_changes[i].type == lsa->data->type
+        && IPV4_ADDR_SAME (&area->spf_changes[i].id, &lsa->data->id))
+      return;
+
+  if (area->spf_changes_count < OSPF_SPF_CHANGES_MAX)
+    {
+      area->spf_changes[i].type = lsa->data->type;
+      area->spf_changes[i].id = lsa->data->id;
+    }
+  area->spf_changes_count++;
+}
+
+/* Reset the SPF status of the LSAs a tree is built from. */
+static void
+ospf_spf_clean_stat (struct ospf_area *area)
+{
+  struct route_node *rn;
+  struct ospf_lsa *lsa;
+
+  LSDB_LOOP (ROUTER_LSDB (area), rn, lsa)
+    lsa->stat = LSA_SPF_NOT_EXPLORED;
+  LSDB_LOOP (NETWORK_LSDB (area), rn, lsa)
+    lsa->stat = LSA_SPF_NOT_EXPLORED;
+}
+
+/* Move a kept vertex to a new instance of its LSA, giving the same
+ * graph.
+ */
+static void
+ospf_vertex_lsa_set (struct vertex *v, struct ospf_lsa *lsa)
+{
+  struct vertex_parent *vp;
+
+  ospf_lsa_lock (lsa);
+  ospf_lsa_unlock (&v->lsa_p);
+  v->lsa_p = lsa;
+  v->lsa = lsa->data;
+  v->stat = &lsa->stat;
+
+  for (vp = v->parents; vp; vp = vp->next)
+    vp->backlink = ospf_lsa_has_link (v->lsa_p, vp->parent->lsa);
+}
+
+/* Whether a vertex owns, or is, a canonical nexthop of the tree: the
+ * root, its children and the routers on its networks.
+ */
+static int
+ospf_vertex_near_root (struct ospf_area *area, struct vertex *v)
+{
+  struct vertex_parent *vp, *np;
+
+  if (v == area->spf)
+    return 1;
+
+  for (vp = v->parents; vp; vp = vp->next)
+    {
+      if (vp->parent == area->spf)
+        return 1;
+      if (vp->parent->type == OSPF_VERTEX_NETWORK)
+        for (np = vp->parent->parents; np; np = np->next)
+          if (np->parent == area->spf)
+            return 1;
+    }
+  return 0;
+}
+
+/* Mark a vertex and the subtree below it to be recalculated. */
+static void
+ospf_spf_affect (struct vertex *v, struct list *affected)
+{
+  struct vertex_parent *vp;
+
+  if (CHECK_FLAG (v->flags, OSPF_VERTEX_AFFECTED))
+    return;
+
+  SET_FLAG (v->flags, OSPF_VERTEX_AFFECTED);
+  UNSET_FLAG (v->flags, OSPF_VERTEX_SEED);
+  listnode_add (affected, v);
+
+  for (vp = v->children; vp; vp = vp->sibling)
+    ospf_spf_affect (vp->child, affected);
+}
+
+/* The kept vertices an LSA links to are expanded again, as they may
+ * now reach it.
+ */
+static void
+ospf_spf_seeds_add (struct ospf_area *area, struct lsa_header *lsah,
+                    struct list *seeds)
+{
+  struct router_lsa_link *l;
+  struct in_addr *r;
+  struct vertex *w;
+  u_char *p, *lim;
+  u_char type;
+  int pos = 0;
+
+  p = (u_char *) lsah + OSPF_LSA_HEADER_SIZE + 4;
+  lim = (u_char *) lsah + ntohs (lsah->length);
+
+  for (;;)
+    {
+      if (lsah->type == OSPF_ROUTER_LSA)
+        {
+          if ((l = ospf_spf_transit_link (&p, lim, &pos)) == NULL)
+            break;
+          type = (l->m[0].type == LSA_LINK_TYPE_TRANSIT
+                  ? OSPF_VERTEX_NETWORK : OSPF_VERTEX_ROUTER);
+          w = ospf_vertex_lookup (area, type, l->link_id);
+        }
+      else
+        {
+          if (p + sizeof (struct in_addr) > lim)
+            break;
+          r = (struct in_addr *) p;
+          p += sizeof (struct in_addr);
+          w = ospf_vertex_lookup (area, OSPF_VERTEX_ROUTER, *r);
+        }
+
+      if (w && !CHECK_FLAG (w->flags, OSPF_VERTEX_AFFECTED | OSPF_VERTEX_SEED))
+        {
+          SET_FLAG (w->flags, OSPF_VERTEX_SEED);
+          listnode_add (seeds, w);
+        }
+    }
+}
+
+/* The LSA a kept vertex should now be built from, or NULL. */
+static struct ospf_lsa *
+ospf_vertex_lsa_current (struct ospf_area *area, struct vertex *v)
+{
+  if (v == area->spf)
+    return area->router_lsa_self;
+  return ospf_lsa_lookup_by_id (area, v->type, v->id);
+}
+
+/* Incremental SPF: recalculate only the subtrees of the vertices whose
+ * LSAs changed since the last calculation, and whatever vertices the
+ * changed LSAs now reach, keeping the rest of the tree as it was.
+ * Returns the kind of calculation done, or -1 if it has to be done
+ * from scratch: when a change touches the root or its nexthops, reaches
+ * half of the tree, or would give a kept vertex a better or equal path.
+ * On failure the tree is left inconsistent and must be freed.
+ */
+static int
+ospf_spf_calculate_incremental (struct ospf_area *area)
+{
+  struct list *affected, *seeds;
+  struct listnode *node, *nnode;
+  struct ospf_lsa *lsa;
+  struct vertex *v;
+  struct vertex_parent *vp;
+  struct ospf_spf_heap *candidate;
+  unsigned int i;
+  int ret = -1;
+
+  v = area->spf;
+  lsa = area->router_lsa_self;
+  if (IS_LSA_MAXAGE (lsa)
+      || (lsa != v->lsa_p && !ospf_spf_links_same (v->lsa, lsa->data, 1)))
+    return -1;
+
+  affected = list_new ();
+  seeds = list_new ();
+
+  /* Any vertex whose LSA went away or gives other edges than it did is
+   * affected, with its subtree.
+   */
+  for (ALL_LIST_ELEMENTS_RO (area->spf_vertices, node, v))
+    {
+      lsa = ospf_vertex_lsa_current (area, v);
+      if (lsa == NULL || IS_LSA_MAXAGE (lsa)
+          || (lsa != v->lsa_p
+              && !ospf_spf_links_same (v->lsa, lsa->data, v == area->spf)))
+        ospf_spf_affect (v, affected);
+      else if (lsa != v->lsa_p)
+        ospf_vertex_lsa_set (v, lsa);
+    }
+
+  /* LSAs off the tree which changed may now join it through the
+   * vertices they link to.
+   */
+  for (i = 0; i < area->spf_changes_count; i++)
+    {
+      if (ospf_vertex_lookup (area, area->spf_changes[i].type,
+                              area->spf_changes[i].id))
+        continue;
+      lsa = ospf_lsa_lookup_by_id (area, area->spf_changes[i].type,
+                                   area->spf_changes[i].id);
+      if (lsa && !IS_LSA_MAXAGE (lsa))
+        ospf_spf_seeds_add (area, lsa->data, seeds);
+    }
+
+  if (listcount (affected) == 0 && listcount (seeds) == 0)
+    {
+      ret = OSPF_SPF_PARTIAL;
+      goto out;
+    }
+
+  if (listcount (affected) * 2 > listcount (area->spf_vertices))
+    goto out;
+  for (ALL_LIST_ELEMENTS_RO (affected, node, v))
+    if (ospf_vertex_near_root (area, v))
+      goto out;
+
+  /* The kept neighbours of the affected vertices may reach them, or
+   * what they reached, another way.
+   */
+  for (ALL_LIST_ELEMENTS_RO (affected, node, v))
+    {
+      lsa = ospf_vertex_lsa_current (area, v);
+      if (lsa && !IS_LSA_MAXAGE (lsa))
+        ospf_spf_seeds_add (area, lsa->data, seeds);
+      ospf_spf_seeds_add (area, v->lsa, seeds);
+    }
+  for (ALL_LIST_ELEMENTS_RO (seeds, node, v))
+    if (v == area->spf
+        || (v->type == OSPF_VERTEX_NETWORK
+            && ospf_vertex_near_root (area, v)))
+      goto out;
+
+  if (IS_DEBUG_OSPF_EVENT)
+    zlog_debug ("%s: area %s, %d of %d vertices affected, %d seeds",
+                __func__, inet_ntoa (area->area_id), listcount (affected),
+                listcount (area->spf_vertices), listcount (seeds));
+
+  /* Take the affected vertices off the tree. */
+  ospf_spf_clean_stat (area);
+  for (ALL_LIST_ELEMENTS_RO (affected, node, v))
+    for (vp = v->parents; vp; vp = vp->next)
+      if (!CHECK_FLAG (vp->parent->flags, OSPF_VERTEX_AFFECTED))
+        ospf_vertex_unlink_child (vp);
+  for (ALL_LIST_ELEMENTS (affected, node, nnode, v))
+    ospf_vertex_delete (area, v);
+  for (ALL_LIST_ELEMENTS_RO (area->spf_vertices, node, v))
+    *(v->stat) = LSA_SPF_IN_SPFTREE;
+
+  /* And grow it again from the seeds, RFC2328 16.1 (2) to (5). */
+  candidate = &area->spf_arena->candidates;
+  candidate->count = 0;
+
+  ret = OSPF_SPF_INCREMENTAL;
+  for (ALL_LIST_ELEMENTS_RO (seeds, node, v))
+    if (ospf_spf_next (v, area, candidate, 1) < 0)
+      ret = -1;
+
+  while (ret >= 0 && candidate->count > 0)
+    {
+      v = ospf_spf_heap_pop (candidate);
+      *(v->stat) = LSA_SPF_IN_SPFTREE;
+      ospf_vertex_add_parent (v);
+      if (ospf_spf_next (v, area, candidate, 1) < 0)
+        ret = -1;
+    }
+  candidate->count = 0;
+
+  if (ret >= 0)
+    ospf_spf_order (area);
+
+ out:
+  for (ALL_LIST_ELEMENTS_RO (area->spf_vertices, node, v))
+    UNSET_FLAG (v->flags, OSPF_VERTEX_AFFECTED | OSPF_VERTEX_SEED
+                          | OSPF_VERTEX_NEW);
+  list_delete (affected);
+  list_delete (seeds);
+  return ret;
+}
+
+/* Calculating the shortest-path tree for an area. */
+static void
+ospf_spf_calculate (struct ospf_area *area)
+{
+  struct ospf_spf_heap *candidate;
+  struct vertex *v;
+  
+  if (IS_DEBUG_OSPF_EVENT)
+    {
+      zlog_debug ("ospf_spf_calculate: Start");
+      zlog_debug ("ospf_spf_calculate: running Dijkstra for area %s",
+                 inet_ntoa (area->area_id));
+    }
+
+  ospf_spf_tree_free (area);
+
+  /* RFC2328 16.1. (1). */
+  /* Initialize the algorithm's data structures. */
   
+  /* This function scans the router and network LSAs and sets the stat
+   * field to LSA_SPF_NOT_EXPLORED. */
+  ospf_spf_clean_stat (area);
+  /* The heap for the candidates is kept from the last tree. */
+  candidate = &area->spf_arena->candidates;
+
+  /* Initialize the shortest-path tree to only the root (which is the
+     router doing the calculation). */
+  ospf_spf_init (area);
+  v = area->spf;
+  /* Set LSA position to LSA_SPF_IN_SPFTREE. This vertex is the root of the
+   * spanning tree. */
+  *(v->stat) = LSA_SPF_IN_SPFTREE;
+
   for (;;)
     {
       /* RFC2328 16.1. (2). */
-      ospf_spf_next (v, area, candidate);
+      ospf_spf_next (v, area, candidate, 0);
 
       /* RFC2328 16.1. (3). */
       /* If at this step the candidate list is empty, the shortest-
          path tree (of transit vertices) has been completely built and
          this stage of the procedure terminates. */
-      if (candidate->size == 0)
+      if (candidate->count == 0)
         break;
 
       /* Otherwise, choose the vertex belonging to the candidate list
@@ -1247,70 +2081,390 @@ ospf_spf_calculate (struct ospf_area *area, struct route_table *new_table,
          tree (removing it from the candidate list in the
          process). */
       /* Extract from the candidates the node with the lower key. */
-      v = (struct vertex *) pqueue_dequeue (candidate);
+      v = ospf_spf_heap_pop (candidate);
       /* Update stat field in vertex. */
       *(v->stat) = LSA_SPF_IN_SPFTREE;
 
       ospf_vertex_add_parent (v);
 
-      /* RFC2328 16.1. (4). */
-      if (v->type == OSPF_VERTEX_ROUTER)
-        ospf_intra_add_router (new_rtrs, v, area);
-      else
-        ospf_intra_add_transit (new_table, v, area);
-
       /* RFC2328 16.1. (5). */
       /* Iterate the algorithm by returning to Step 2. */
 
     } /* end loop until no more candidate vertices */
 
+  ospf_spf_order (area);
+
   if (IS_DEBUG_OSPF_EVENT)
+    zlog_debug ("ospf_spf_calculate: Stop. %u vertices",
+                listcount (area->spf_vertices));
+}
+
+/* Prepare an area for the calculation of its tree.  Returns 0 if it
+ * has none to calculate.
+ */
+static int
+ospf_spf_area_ready (struct ospf_area *area)
+{
+  ospf_spf_tree_init (area);
+
+  /* Check router-lsa-self.  If self-router-lsa is not yet allocated,
+     return this area's calculation. */
+  if (!area->router_lsa_self)
     {
-      ospf_spf_dump (area->spf, 0);
-      ospf_route_table_dump (new_table);
+      if (IS_DEBUG_OSPF_EVENT)
+        zlog_debug ("ospf_spf_calculate: "
+                   "Skip area %s's calculation due to empty router_lsa_self",
+                   inet_ntoa (area->area_id));
+      ospf_spf_tree_free (area);
+      area->spf_changes_count = 0;
+      return 0;
     }
+  return 1;
+}
 
-  /* Second stage of SPF calculation procedure's  */
-  ospf_spf_process_stubs (area, area->spf, new_table, 0);
-
-  /* Free candidate queue. */
-  pqueue_delete (candidate);
+/* Calculate the shortest-path tree of an area, incrementally unless
+ * asked for a full calculation.  Returns the kind of calculation done.
+ * This reads nothing of the other areas, and writes nothing but the
+ * vertices of the area and the stat of its LSAs.
+ */
+static int
+ospf_spf_calculate_tree (struct ospf_area *area, int full)
+{
+  struct ospf *ospf = area->ospf;
+  int type = -1;
 
-  ospf_vertex_dump (__func__, area->spf, 0, 1);
-  /* Free nexthop information, canonical versions of which are attached
-   * the first level of router vertices attached to the root vertex, see
-   * ospf_nexthop_calculation.
+  /* Virtual links take their nexthops from the transit areas, which
+   * the tree of the backbone does not follow.
    */
-  ospf_canonical_nexthops_free (area->spf);
+  if (!full && area->spf
+      && area->spf_changes_count <= OSPF_SPF_CHANGES_MAX
+      && !(OSPF_IS_AREA_BACKBONE (area) && ospf->vlinks
+           && listcount (ospf->vlinks)))
+    type = ospf_spf_calculate_incremental (area);
+
+  if (type < 0)
+    {
+      ospf_spf_calculate (area);
+      type = OSPF_SPF_FULL;
+    }
+  area->spf_changes_count = 0;
+
+  return type;
+}
+
+/* Log what the calculation of the tree of an area found wrong. */
+static void
+ospf_spf_log_problems (struct ospf_area *area)
+{
+  struct ospf_spf_arena *arena = area->spf_arena;
+
+  if (arena->no_oi)
+    zlog_debug ("SPF: area %s: OI not found for %u link(s), the last at "
+                "lsa_pos %d", inet_ntoa (area->area_id), arena->no_oi,
+                arena->no_oi_lsa_pos);
+  if (arena->no_nexthop)
+    zlog_info ("SPF: area %s: could not determine nexthop for %u link(s), "
+               "the last on %s", inet_ntoa (area->area_id), arena->no_nexthop,
+               arena->no_nexthop_oi->ifp->name);
+  if (arena->no_vl_data)
+    zlog_info ("SPF: area %s: vl_data for %u VL link(s) not found",
+               inet_ntoa (area->area_id), arena->no_vl_data);
+  if (arena->bad_link_type)
+    zlog_warn ("SPF: area %s: %u link(s) of invalid LSA link type, "
+               "the last %d", inet_ntoa (area->area_id), arena->bad_link_type,
+               arena->bad_link_type_last);
+
+  arena->no_oi = arena->no_nexthop = arena->no_vl_data = 0;
+  arena->bad_link_type = 0;
+  arena->no_nexthop_oi = NULL;
+}
+
+/* Count the calculation of the tree of an area, and build the
+ * intra-area routes of the area from it.  On the main thread, after
+ * the tree is done.
+ */
+static void
+ospf_spf_calculate_routes (struct ospf_area *area, int type,
+                           struct route_table *new_table,
+                           struct route_table *new_rtrs)
+{
+  struct ospf *ospf = area->ospf;
+  struct timeval start_time, stop_time;
+
+  ospf_spf_log_problems (area);
 
   /* Increment SPF Calculation Counter. */
-  area->spf_calculation++;
+  if (type != OSPF_SPF_PARTIAL)
+    area->spf_calculation++;
+  if (type == OSPF_SPF_INCREMENTAL)
+    area->spf_incremental++;
 
-  quagga_gettime (QUAGGA_CLK_MONOTONIC, &area->ospf->ts_spf);
-  area->ts_spf = area->ospf->ts_spf;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start_time);
 
-  if (IS_DEBUG_OSPF_EVENT)
-    zlog_debug ("ospf_spf_calculate: Stop. %zd vertices",
-                mtype_stats_alloc(MTYPE_OSPF_VERTEX));
+  ospf_spf_routes (area, new_table, new_rtrs);
 
-  /* Free SPF vertices, but not the list. List has ospf_vertex_free
-   * as deconstructor.
-   */
-  list_delete_all_node (&vertex_list);
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &stop_time);
+  ospf->spf_time.intra += timeval_elapsed (stop_time, start_time);
+
+  area->ts_spf = stop_time;
+}
+
+/* The tree of an area to calculate, and the kind of calculation done. */
+struct ospf_spf_job
+{
+  struct ospf_area *area;
+  int full;
+  int type;
+};
+
+#ifdef HAVE_PTHREAD
+/* Threads calculating the trees of the areas other than the backbone,
+ * with the main thread, when more than one thread is configured.  The
+ * routes are built from the trees on the main thread afterwards, in the
+ * order of the areas, so they are the same whatever the threads.
+ */
+static struct
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t work;		/* Trees to calculate, or stop. */
+  pthread_cond_t done;		/* All trees calculated. */
+  pthread_t *threads;
+  unsigned int count;
+  int stop;
+
+  struct ospf_spf_job *jobs;
+  unsigned int total;
+  unsigned int next;
+  unsigned int finished;
+} ospf_spf_workers =
+{
+  PTHREAD_MUTEX_INITIALIZER,
+  PTHREAD_COND_INITIALIZER,
+  PTHREAD_COND_INITIALIZER,
+};
+
+/* Calculate trees until none is left to take, with the mutex held. */
+static void
+ospf_spf_workers_run (void)
+{
+  struct ospf_spf_job *job;
+
+  while (ospf_spf_workers.next < ospf_spf_workers.total)
+    {
+      job = &ospf_spf_workers.jobs[ospf_spf_workers.next++];
+      pthread_mutex_unlock (&ospf_spf_workers.mutex);
+
+      job->type = ospf_spf_calculate_tree (job->area, job->full);
+
+      pthread_mutex_lock (&ospf_spf_workers.mutex);
+      if (++ospf_spf_workers.finished == ospf_spf_workers.total)
+        pthread_cond_signal (&ospf_spf_workers.done);
+    }
 }
 
+static void *
+ospf_spf_worker (void *arg)
+{
+  pthread_mutex_lock (&ospf_spf_workers.mutex);
+  while (!ospf_spf_workers.stop)
+    {
+      ospf_spf_workers_run ();
+      if (!ospf_spf_workers.stop)
+        pthread_cond_wait (&ospf_spf_workers.work, &ospf_spf_workers.mutex);
+    }
+  pthread_mutex_unlock (&ospf_spf_workers.mutex);
+
+  return NULL;
+}
+
+/* Stop or start workers so there are count of them.  Returns how many
+ * there are.
+ */
+static unsigned int
+ospf_spf_workers_set (unsigned int count)
+{
+  sigset_t sigs, oldsigs;
+  unsigned int i;
+  int ret;
+
+  if (count == ospf_spf_workers.count)
+    return count;
+
+  if (ospf_spf_workers.count)
+    {
+      pthread_mutex_lock (&ospf_spf_workers.mutex);
+      ospf_spf_workers.stop = 1;
+      pthread_cond_broadcast (&ospf_spf_workers.work);
+      pthread_mutex_unlock (&ospf_spf_workers.mutex);
+
+      for (i = 0; i < ospf_spf_workers.count; i++)
+        pthread_join (ospf_spf_workers.threads[i], NULL);
+      XFREE (MTYPE_OSPF_TMP, ospf_spf_workers.threads);
+      ospf_spf_workers.count = 0;
+      ospf_spf_workers.stop = 0;
+    }
+
+  if (count == 0)
+    return 0;
+
+  ospf_spf_workers.threads = XCALLOC (MTYPE_OSPF_TMP,
+                                      count * sizeof (pthread_t));
+
+  /* Signals are for the main thread to handle. */
+  sigfillset (&sigs);
+  pthread_sigmask (SIG_SETMASK, &sigs, &oldsigs);
+  for (i = 0; i < count; i++)
+    if ((ret = pthread_create (&ospf_spf_workers.threads[i], NULL,
+                               ospf_spf_worker, NULL)) != 0)
+      {
+        zlog_warn ("SPF: can't start calculation thread: %s",
+                   safe_strerror (ret));
+        break;
+      }
+  pthread_sigmask (SIG_SETMASK, &oldsigs, NULL);
+
+  ospf_spf_workers.count = i;
+  return i;
+}
+
+/* Calculate the trees on the workers, the main thread taking its share,
+ * and wait for them all.
+ */
+static void
+ospf_spf_workers_calculate (struct ospf_spf_job *jobs, unsigned int total)
+{
+  pthread_mutex_lock (&ospf_spf_workers.mutex);
+
+  ospf_spf_workers.jobs = jobs;
+  ospf_spf_workers.total = total;
+  ospf_spf_workers.next = ospf_spf_workers.finished = 0;
+  pthread_cond_broadcast (&ospf_spf_workers.work);
+
+  ospf_spf_workers_run ();
+  while (ospf_spf_workers.finished < ospf_spf_workers.total)
+    pthread_cond_wait (&ospf_spf_workers.done, &ospf_spf_workers.mutex);
+
+  ospf_spf_workers.jobs = NULL;
+  ospf_spf_workers.total = ospf_spf_workers.next = 0;
+
+  pthread_mutex_unlock (&ospf_spf_workers.mutex);
+}
+#endif /* HAVE_PTHREAD */
+
+/* Stop the threads calculating trees. */
+void
+ospf_spf_workers_finish (void)
+{
+#ifdef HAVE_PTHREAD
+  ospf_spf_workers_set (0);
+#endif /* HAVE_PTHREAD */
+}
+
+/* Calculate the trees of areas other than the backbone, on as many
+ * threads as configured.  Debugging output stays on the main thread.
+ */
+static void
+ospf_spf_calculate_trees (struct ospf *ospf, struct ospf_spf_job *jobs,
+                          unsigned int total)
+{
+  unsigned int i;
+
+#ifdef HAVE_PTHREAD
+  if (ospf->spf_threads > 1 && total > 1 && !IS_DEBUG_OSPF_EVENT
+      && ospf_spf_workers_set (MIN (ospf->spf_threads, total) - 1))
+    {
+      ospf_spf_workers_calculate (jobs, total);
+      return;
+    }
+#endif /* HAVE_PTHREAD */
+
+  for (i = 0; i < total; i++)
+    jobs[i].type = ospf_spf_calculate_tree (jobs[i].area, jobs[i].full);
+}
+
+/* Calculate every area, the backbone last.  Returns the most thorough
+ * kind of calculation any area needed.
+ */
+int
+ospf_spf_calculate_areas (struct ospf *ospf, struct route_table *new_table,
+                          struct route_table *new_rtrs, int full)
+{
+  struct listnode *node;
+  struct ospf_area *area;
+  struct ospf_spf_job *jobs;
+  struct timeval start_time, stop_time;
+  unsigned int i, total = 0;
+  int type, ret = OSPF_SPF_PARTIAL;
+
+  ospf->spf_time.spf = ospf->spf_time.intra = 0;
+
+  jobs = XCALLOC (MTYPE_OSPF_TMP,
+                  (listcount (ospf->areas) + 1) * sizeof (struct ospf_spf_job));
+
+  /* Calculate SPF for each area. */
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    {
+      /* Do backbone last, so as to first discover intra-area paths
+       * for any back-bone virtual-links
+       */
+      if (ospf->backbone && ospf->backbone == area)
+        continue;
+
+      if (ospf_spf_area_ready (area))
+        {
+          jobs[total].area = area;
+          jobs[total].full = full;
+          total++;
+        }
+    }
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start_time);
+  ospf_spf_calculate_trees (ospf, jobs, total);
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &stop_time);
+  ospf->spf_time.spf += timeval_elapsed (stop_time, start_time);
+
+  for (i = 0; i < total; i++)
+    {
+      ospf_spf_calculate_routes (jobs[i].area, jobs[i].type,
+                                 new_table, new_rtrs);
+      if (jobs[i].type > ret)
+        ret = jobs[i].type;
+    }
+
+  XFREE (MTYPE_OSPF_TMP, jobs);
+
+  /* SPF for backbone, if required */
+  if (ospf->backbone && ospf_spf_area_ready (ospf->backbone))
+    {
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &start_time);
+      type = ospf_spf_calculate_tree (ospf->backbone, full);
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &stop_time);
+      ospf->spf_time.spf += timeval_elapsed (stop_time, start_time);
+
+      ospf_spf_calculate_routes (ospf->backbone, type, new_table, new_rtrs);
+      if (type > ret)
+        ret = type;
+    }
+
+  return ret;
+}
+
+static const char *ospf_spf_type_str[] =
+{
+  "partial",
+  "incremental",
+  "full",
+};
+
 /* Timer for SPF calculation. */
 static int
 ospf_spf_calculate_timer (struct thread *thread)
 {
   struct ospf *ospf = THREAD_ARG (thread);
   struct route_table *new_table, *new_rtrs;
-  struct ospf_area *area;
-  struct listnode *node, *nnode;
   struct timeval start_time, stop_time, spf_start_time;
-  int areas_processed = 0;
-  unsigned long ia_time, prune_time, rt_time;
-  unsigned long abr_time, total_spf_time, spf_time;
+  unsigned long total_spf_time;
+  int type;
   char rbuf[32];		/* reason_buf */
   
   if (IS_DEBUG_OSPF_EVENT)
@@ -1325,50 +2479,36 @@ ospf_spf_calculate_timer (struct thread *thread)
 
   ospf_vl_unapprove (ospf);
 
-  /* Calculate SPF for each area. */
-  for (ALL_LIST_ELEMENTS (ospf->areas, node, nnode, area))
-    {
-      /* Do backbone last, so as to first discover intra-area paths
-       * for any back-bone virtual-links
-       */
-      if (ospf->backbone && ospf->backbone == area)
-        continue;
-
-      ospf_spf_calculate (area, new_table, new_rtrs);
-      areas_processed++;
-    }
-
-  /* SPF for backbone, if required */
-  if (ospf->backbone)
-    {
-      ospf_spf_calculate (ospf->backbone, new_table, new_rtrs);
-      areas_processed++;
-    }
-
-  quagga_gettime (QUAGGA_CLK_MONOTONIC, &stop_time);
-  spf_time = timeval_elapsed (stop_time, spf_start_time);
+  /* A change of configuration may change nexthops without any LSA
+     changing: recalculate every tree from scratch. */
+  type = ospf_spf_calculate_areas (ospf, new_table, new_rtrs,
+                                   spf_reason_flags
+                                   & (1 << SPF_FLAG_CONFIG_CHANGE));
 
   ospf_vl_shut_unapproved (ospf);
 
-  start_time = stop_time;	/* saving a call */
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start_time);
 
   ospf_ia_routing (ospf, new_table, new_rtrs);
 
   quagga_gettime (QUAGGA_CLK_MONOTONIC, &stop_time);
-  ia_time = timeval_elapsed (stop_time, start_time);
+  ospf->spf_time.ia = timeval_elapsed (stop_time, start_time);
 
   quagga_gettime (QUAGGA_CLK_MONOTONIC, &start_time);
   ospf_prune_unreachable_networks (new_table);
   ospf_prune_unreachable_routers (new_rtrs);
 
   quagga_gettime (QUAGGA_CLK_MONOTONIC, &stop_time);
-  prune_time = timeval_elapsed (stop_time, start_time);
+  ospf->spf_time.prune = timeval_elapsed (stop_time, start_time);
   /* AS-external-LSA calculation should not be performed here. */
 
   /* If new Router Route is installed,
-     then schedule re-calculate External routes. */
-  if (1)
-    ospf_ase_calculate_schedule (ospf);
+     then schedule re-calculate External routes: only those over
+     changed routes, unless the configuration changed. */
+  ospf_ase_calculate_schedule (ospf, (spf_reason_flags
+                                      & (1 << SPF_FLAG_CONFIG_CHANGE))
+                                     ? OSPF_ASE_CALC_FULL
+                                     : OSPF_ASE_CALC_INCREMENTAL);
 
   ospf_ase_calculate_timer_add (ospf);
 
@@ -1378,7 +2518,7 @@ ospf_spf_calculate_timer (struct thread *thread)
   ospf_route_install (ospf, new_table);
 
   quagga_gettime (QUAGGA_CLK_MONOTONIC, &stop_time);
-  rt_time = timeval_elapsed (stop_time, start_time);
+  ospf->spf_time.install = timeval_elapsed (stop_time, start_time);
   /* Update ABR/ASBR routing table */
   if (ospf->old_rtrs)
     {
@@ -1395,25 +2535,29 @@ ospf_spf_calculate_timer (struct thread *thread)
     ospf_abr_task (ospf);
 
   quagga_gettime (QUAGGA_CLK_MONOTONIC, &stop_time);
-  abr_time = timeval_elapsed (stop_time, start_time);
+  ospf->spf_time.abr = timeval_elapsed (stop_time, start_time);
 
-  quagga_gettime (QUAGGA_CLK_MONOTONIC, &stop_time);
   total_spf_time = timeval_elapsed (stop_time, spf_start_time);
+  ospf->ts_spf = stop_time;
   ospf->ts_spf_duration.tv_sec = total_spf_time/1000000;
   ospf->ts_spf_duration.tv_usec = total_spf_time % 1000000;
+  ospf->spf_last = type;
+  ospf->spf_runs[type]++;
 
   ospf_get_spf_reason_str (rbuf);
 
   if (IS_DEBUG_OSPF_EVENT)
     {
       zlog_info ("SPF Processing Time(usecs): %ld", total_spf_time);
-      zlog_info ("\t    SPF Time: %ld", spf_time);
-      zlog_info ("\t   InterArea: %ld", ia_time);
-      zlog_info ("\t       Prune: %ld", prune_time);
-      zlog_info ("\tRouteInstall: %ld", rt_time);
+      zlog_info ("\t    SPF Time: %ld (%s)", ospf->spf_time.spf,
+                 ospf_spf_type_str[type]);
+      zlog_info ("\t  IntraArea: %ld", ospf->spf_time.intra);
+      zlog_info ("\t   InterArea: %ld", ospf->spf_time.ia);
+      zlog_info ("\t       Prune: %ld", ospf->spf_time.prune);
+      zlog_info ("\tRouteInstall: %ld", ospf->spf_time.install);
       if (IS_OSPF_ABR (ospf))
         zlog_info ("\t         ABR: %ld (%d areas)",
-                   abr_time, areas_processed);
+                   ospf->spf_time.abr, listcount (ospf->areas));
       zlog_info ("Reason(s) for SPF: %s", rbuf);
     }
 
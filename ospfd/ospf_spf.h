@@ -29,6 +29,9 @@
 
 /* values for vertex->flags */
 #define OSPF_VERTEX_PROCESSED      0x01
+#define OSPF_VERTEX_AFFECTED       0x02  /* incremental SPF: to recalculate */
+#define OSPF_VERTEX_SEED           0x04  /* incremental SPF: to expand again */
+#define OSPF_VERTEX_NEW            0x08  /* incremental SPF: placed this run */
 
 /* The "root" is the node running the SPF calculation */
 
@@ -39,10 +42,12 @@ struct vertex
   u_char type;		/* copied from LSA header */
   struct in_addr id;	/* copied from LSA header */
   struct lsa_header *lsa; /* Router or Network LSA */
+  struct ospf_lsa *lsa_p;	/* the instance holding it, locked */
   int *stat;		/* Link to LSA status. */
   u_int32_t distance;	/* from root to this vertex */  
-  struct list *parents;		/* list of parents in SPF tree */
-  struct list *children;	/* list of children in SPF tree*/
+  struct vertex_parent *parents;	/* parents in SPF tree, by next */
+  struct vertex_parent *children;	/* children in SPF tree, by sibling */
+  struct vertex_parent *children_tail;
 };
 
 /* A nexthop taken on the root node to get to this (parent) vertex */
@@ -52,8 +57,14 @@ struct vertex_nexthop
   struct in_addr router;	/* router address to send to */
 };
 
+/* A parent of a vertex, which also links the vertex into the children
+ * of the parent, once per parent.
+ */
 struct vertex_parent
 {
+  struct vertex_parent *next;	/* next parent of the same vertex */
+  struct vertex_parent *sibling; /* next child of the same parent */
+  struct vertex *child;		/* the vertex this is a parent of */
   struct vertex_nexthop *nexthop; /* link to nexthop info for this parent */
   struct vertex *parent;	/* parent vertex */
   int backlink;			/* index back to parent for router-lsa's */
@@ -71,7 +82,25 @@ typedef enum {
   SPF_FLAG_CONFIG_CHANGE,
 } ospf_spf_reason_t;
 
+/* How the calculation got the shortest-path trees, least work first.
+ * A partial route calculation reuses the kept trees as they are, an
+ * incremental one recalculates only the parts reached through changed
+ * router- and network-LSAs.
+ */
+#define OSPF_SPF_PARTIAL      0
+#define OSPF_SPF_INCREMENTAL  1
+#define OSPF_SPF_FULL         2
+
 extern void ospf_spf_calculate_schedule (struct ospf *, ospf_spf_reason_t);
+extern int ospf_spf_calculate_areas (struct ospf *, struct route_table *,
+                                     struct route_table *, int);
+extern void ospf_spf_lsa_update (struct ospf_area *, struct ospf_lsa *,
+                                 struct ospf_lsa *);
+extern void ospf_spf_lsa_index (struct ospf_lsa *);
+extern int ospf_lsa_has_link (struct ospf_lsa *, struct lsa_header *);
+extern void ospf_spf_tree_flush (struct ospf *);
+extern void ospf_spf_area_finish (struct ospf_area *);
+extern void ospf_spf_workers_finish (void);
 extern void ospf_rtrs_free (struct route_table *);
 
 /* void ospf_spf_calculate_timer_add (); */
@@ -2345,6 +2345,91 @@ DEFUN (no_ospf_timers_min_ls_arrival,
   return CMD_SUCCESS;
 }
 
+DEFUN (ospf_timers_pacing_flood,
+       ospf_timers_pacing_flood_cmd,
+       "timers pacing flood <0-100>",
+       "Adjust routing timers\n"
+       "OSPF packet pacing\n"
+       "OSPF flood pacing\n"
+       "Delay (msec) gathering LSAs into LS updates\n")
+{
+  struct ospf *ospf = vty->index;
+  unsigned int pacing;
+
+  if (argc != 1)
+    {
+      vty_out (vty, "Insufficient arguments%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  VTY_GET_INTEGER_RANGE ("flood pacing", pacing, argv[0], 0, 100);
+
+  ospf->flood_pacing = pacing;
+
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_ospf_timers_pacing_flood,
+       no_ospf_timers_pacing_flood_cmd,
+       "no timers pacing flood",
+       NO_STR
+       "Adjust routing timers\n"
+       "OSPF packet pacing\n"
+       "OSPF flood pacing\n")
+{
+  struct ospf *ospf = vty->index;
+  ospf->flood_pacing = OSPF_FLOOD_PACING_DEFAULT;
+
+  return CMD_SUCCESS;
+}
+
+#ifdef HAVE_PTHREAD
+DEFUN (ospf_spf_threads,
+       ospf_spf_threads_cmd,
+       "spf threads <1-32>",
+       "SPF calculation\n"
+       "Threads calculating the trees of areas\n"
+       "Number of threads\n")
+{
+  struct ospf *ospf = vty->index;
+  unsigned int threads;
+
+  if (argc != 1)
+    {
+      vty_out (vty, "Insufficient arguments%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  VTY_GET_INTEGER_RANGE ("SPF threads", threads, argv[0],
+                         1, OSPF_SPF_THREADS_MAX);
+
+  ospf->spf_threads = threads;
+
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_ospf_spf_threads,
+       no_ospf_spf_threads_cmd,
+       "no spf threads",
+       NO_STR
+       "SPF calculation\n"
+       "Threads calculating the trees of areas\n")
+{
+  struct ospf *ospf = vty->index;
+  ospf->spf_threads = OSPF_SPF_THREADS_DEFAULT;
+
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_ospf_spf_threads,
+       no_ospf_spf_threads_val_cmd,
+       "no spf threads <1-32>",
+       NO_STR
+       "SPF calculation\n"
+       "Threads calculating the trees of areas\n"
+       "Number of threads\n")
+#endif /* HAVE_PTHREAD */
+
 DEFUN (ospf_timers_throttle_spf,
        ospf_timers_throttle_spf_cmd,
        "timers throttle spf <0-600000> <0-600000> <0-600000>",
@@ -2766,8 +2851,8 @@ show_ip_ospf_area (struct vty *vty, struct ospf_area *area)
 	     " this area: %d%s", area->full_vls, VTY_NEWLINE);
 
   /* Show SPF calculation times. */
-  vty_out (vty, "   SPF algorithm executed %d times%s",
-	   area->spf_calculation, VTY_NEWLINE);
+  vty_out (vty, "   SPF algorithm executed %d times, %d incrementally%s",
+	   area->spf_calculation, area->spf_incremental, VTY_NEWLINE);
 
   /* Show number of LSA. */
   vty_out (vty, "   Number of LSA %ld%s", area->lsdb->total, VTY_NEWLINE);
@@ -2850,6 +2935,17 @@ DEFUN (show_ip_ospf,
         vty_out (vty, "   Enabled for %us prior to full shutdown%s",
                  ospf->stub_router_shutdown_time, VTY_NEWLINE);
     }
+
+  /* Show graceful restart. */
+  if (ospf->gr_grace_period)
+    vty_out (vty, " Graceful restart is enabled, grace period %us%s",
+             ospf->gr_grace_period, VTY_NEWLINE);
+  if (ospf->gr_state == OSPF_GR_RESTARTING)
+    vty_out (vty, "   Restarting, %lus of grace left%s",
+             thread_timer_remain_second (ospf->t_gr_restart), VTY_NEWLINE);
+  if (ospf->gr_helper)
+    vty_out (vty, " Graceful restart helper is enabled, helping %u neighbor(s)%s",
+             ospf->gr_helping, VTY_NEWLINE);
   
   /* Show SPF timers. */
   vty_out (vty, " Initial SPF scheduling delay %d millisec(s)%s"
@@ -2860,6 +2956,9 @@ DEFUN (show_ip_ospf,
 	  ospf->spf_holdtime, VTY_NEWLINE,
 	  ospf->spf_max_holdtime, VTY_NEWLINE,
 	  ospf->spf_hold_multiplier, VTY_NEWLINE);
+  if (ospf->spf_threads > 1)
+    vty_out (vty, " Area trees calculated on %u threads%s",
+             ospf->spf_threads, VTY_NEWLINE);
   vty_out (vty, " SPF algorithm ");
   if (ospf->ts_spf.tv_sec || ospf->ts_spf.tv_usec)
     {
@@ -2870,6 +2969,20 @@ DEFUN (show_ip_ospf,
       vty_out (vty, " Last SPF duration %s%s",
 	       ospf_timeval_dump (&ospf->ts_spf_duration, timebuf, sizeof (timebuf)),
 	       VTY_NEWLINE);
+      vty_out (vty, " Last calculation was %s%s",
+               ospf->spf_last == OSPF_SPF_FULL ? "a full SPF"
+               : ospf->spf_last == OSPF_SPF_INCREMENTAL ? "an incremental SPF"
+               : "a partial route calculation", VTY_NEWLINE);
+      vty_out (vty, "  SPF %lu usecs, intra-area %lu, inter-area %lu,"
+               " prune %lu, install %lu, ABR %lu%s",
+               ospf->spf_time.spf, ospf->spf_time.intra, ospf->spf_time.ia,
+               ospf->spf_time.prune, ospf->spf_time.install,
+               ospf->spf_time.abr, VTY_NEWLINE);
+      vty_out (vty, "  %u full SPF, %u incremental SPF,"
+               " %u partial route calculations%s",
+               ospf->spf_runs[OSPF_SPF_FULL],
+               ospf->spf_runs[OSPF_SPF_INCREMENTAL],
+               ospf->spf_runs[OSPF_SPF_PARTIAL], VTY_NEWLINE);
     }
   else
     vty_out (vty, "has not been run%s", VTY_NEWLINE);
@@ -3075,6 +3188,16 @@ show_ip_ospf_interface_sub (struct vty *vty, struct ospf *ospf,
       vty_out (vty, "  Neighbor Count is %d, Adjacent neighbor count is %d%s",
 	       ospf_nbr_count (oi, 0), ospf_nbr_count (oi, NSM_Full),
 	       VTY_NEWLINE);
+
+      vty_out (vty, "  Flood queue length %u, maximum %u%s",
+	       oi->ls_upd_queue_count, oi->ls_upd_queue_max, VTY_NEWLINE);
+      vty_out (vty, "  %u LS updates sent with %u LSAs",
+	       oi->ls_upd_out, oi->ls_upd_lsa_out);
+      if (oi->ls_upd_out)
+	vty_out (vty, ", %u LSAs and %u octets per update on average",
+		 oi->ls_upd_lsa_out / oi->ls_upd_out,
+		 (unsigned int) (oi->ls_upd_octets_out / oi->ls_upd_out));
+      vty_out (vty, "%s", VTY_NEWLINE);
     }
 }
 
@@ -7433,6 +7556,9 @@ ospf_config_write (struct vty *vty)
       if (ospf->min_ls_arrival != OSPF_MIN_LS_ARRIVAL)
   vty_out (vty, " timers lsa arrival %d%s",
      ospf->min_ls_arrival, VTY_NEWLINE);
+      if (ospf->flood_pacing != OSPF_FLOOD_PACING_DEFAULT)
+	vty_out (vty, " timers pacing flood %d%s",
+		 ospf->flood_pacing, VTY_NEWLINE);
 
       /* SPF timers print. */
       if (ospf->spf_delay != OSPF_SPF_DELAY_DEFAULT ||
@@ -7441,6 +7567,8 @@ ospf_config_write (struct vty *vty)
 	vty_out (vty, " timers throttle spf %d %d %d%s",
 		 ospf->spf_delay, ospf->spf_holdtime,
 		 ospf->spf_max_holdtime, VTY_NEWLINE);
+      if (ospf->spf_threads != OSPF_SPF_THREADS_DEFAULT)
+	vty_out (vty, " spf threads %u%s", ospf->spf_threads, VTY_NEWLINE);
       
       /* Max-metric router-lsa print */
       config_write_stub_router (vty, ospf);
@@ -7881,12 +8009,19 @@ ospf_vty_init (void)
   install_element (OSPF_NODE, &no_ospf_timers_min_ls_interval_cmd);
   install_element (OSPF_NODE, &ospf_timers_min_ls_arrival_cmd);
   install_element (OSPF_NODE, &no_ospf_timers_min_ls_arrival_cmd);
+  install_element (OSPF_NODE, &ospf_timers_pacing_flood_cmd);
+  install_element (OSPF_NODE, &no_ospf_timers_pacing_flood_cmd);
 
   /* SPF timer commands */
   install_element (OSPF_NODE, &ospf_timers_spf_cmd);
   install_element (OSPF_NODE, &no_ospf_timers_spf_cmd);
   install_element (OSPF_NODE, &ospf_timers_throttle_spf_cmd);
   install_element (OSPF_NODE, &no_ospf_timers_throttle_spf_cmd);
+#ifdef HAVE_PTHREAD
+  install_element (OSPF_NODE, &ospf_spf_threads_cmd);
+  install_element (OSPF_NODE, &no_ospf_spf_threads_cmd);
+  install_element (OSPF_NODE, &no_ospf_spf_threads_val_cmd);
+#endif /* HAVE_PTHREAD */
   
   /* refresh timer commands */
   install_element (OSPF_NODE, &ospf_refresh_timer_cmd);
@@ -344,6 +344,15 @@ ospf_interface_link_params (int command, struct zclient *zclient,
   return 0;
 }
 
+/* Whether FIB updates are held back, restarting gracefully: zebra keeps
+   the routes from before until all of ours are there again. */
+static int
+ospf_zebra_fib_held (void)
+{
+  struct ospf *ospf = ospf_lookup ();
+
+  return ospf != NULL && ospf->gr_state != OSPF_GR_NONE;
+}
 
 void
 ospf_zebra_add (struct prefix_ipv4 *p, struct ospf_route *or)
@@ -356,6 +365,9 @@ ospf_zebra_add (struct prefix_ipv4 *p, struct ospf_route *or)
   struct ospf_path *path;
   struct listnode *node;
 
+  if (ospf_zebra_fib_held ())
+    return;
+
   if (vrf_bitmap_check (zclient->redist[ZEBRA_ROUTE_OSPF], VRF_DEFAULT))
     {
       message = 0;
@@ -463,6 +475,9 @@ ospf_zebra_delete (struct prefix_ipv4 *p, struct ospf_route *or)
   struct ospf_path *path;
   struct listnode *node;
 
+  if (ospf_zebra_fib_held ())
+    return;
+
   if (vrf_bitmap_check (zclient->redist[ZEBRA_ROUTE_OSPF], VRF_DEFAULT))
     {
       message = 0;
@@ -544,6 +559,9 @@ ospf_zebra_add_discard (struct prefix_ipv4 *p)
 {
   struct zapi_ipv4 api;
 
+  if (ospf_zebra_fib_held ())
+    return;
+
   if (vrf_bitmap_check (zclient->redist[ZEBRA_ROUTE_OSPF], VRF_DEFAULT))
     {
       api.vrf_id = VRF_DEFAULT;
@@ -569,6 +587,9 @@ ospf_zebra_delete_discard (struct prefix_ipv4 *p)
 {
   struct zapi_ipv4 api;
 
+  if (ospf_zebra_fib_held ())
+    return;
+
   if (vrf_bitmap_check (zclient->redist[ZEBRA_ROUTE_OSPF], VRF_DEFAULT))
     {
       api.vrf_id = VRF_DEFAULT;
@@ -590,6 +611,56 @@ ospf_zebra_delete_discard (struct prefix_ipv4 *p)
     }
 }
 
+/* Graceful restart.  With it configured zebra is to keep our routes
+   when we go, for the grace period. */
+void
+ospf_zebra_graceful_restart_update (u_int16_t grace_period)
+{
+  if (zclient == NULL || zclient->stale_time == grace_period)
+    return;
+
+  zclient->stale_time = grace_period;
+  if (zclient->sock >= 0)
+    zebra_hello_send (zclient);
+}
+
+/* Back from a graceful restart with the routes complete, put them all in
+   the FIB in one pass, taking the place of those zebra kept, and have
+   zebra remove what is left of those. */
+void
+ospf_zebra_resync (struct ospf *ospf)
+{
+  struct route_node *rn;
+  struct ospf_route *or;
+  unsigned long count = 0;
+
+  if (ospf->new_table)
+    for (rn = route_top (ospf->new_table); rn; rn = route_next (rn))
+      if ((or = rn->info) != NULL)
+	{
+	  if (or->type == OSPF_DESTINATION_NETWORK)
+	    ospf_zebra_add ((struct prefix_ipv4 *) &rn->p, or);
+	  else if (or->type == OSPF_DESTINATION_DISCARD)
+	    ospf_zebra_add_discard ((struct prefix_ipv4 *) &rn->p);
+	  else
+	    continue;
+	  count++;
+	}
+
+  if (ospf->new_external_route)
+    for (rn = route_top (ospf->new_external_route); rn; rn = route_next (rn))
+      if ((or = rn->info) != NULL)
+	{
+	  ospf_zebra_add ((struct prefix_ipv4 *) &rn->p, or);
+	  count++;
+	}
+
+  zlog_info ("graceful restart: %lu routes sent to zebra, sweeping the rest",
+	     count);
+  if (zclient != NULL)
+    zebra_stale_sweep_send (zclient);
+}
+
 int
 ospf_is_type_redistributed (int type)
 {
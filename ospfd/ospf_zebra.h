@@ -49,6 +49,8 @@ extern void ospf_zebra_delete (struct prefix_ipv4 *, struct ospf_route *);
 
 extern void ospf_zebra_add_discard (struct prefix_ipv4 *);
 extern void ospf_zebra_delete_discard (struct prefix_ipv4 *);
+extern void ospf_zebra_graceful_restart_update (u_int16_t);
+extern void ospf_zebra_resync (struct ospf *);
 
 extern int ospf_redistribute_check (struct ospf *, struct external_info *,
 				    int *);
@@ -52,6 +52,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "ospfd/ospf_flood.h"
 #include "ospfd/ospf_route.h"
 #include "ospfd/ospf_ase.h"
+#include "ospfd/ospf_gr.h"
 
 
 
@@ -179,6 +180,7 @@ ospf_new (void)
   new->nbr_nbma = route_table_init ();
 
   new->lsdb = ospf_lsdb_new ();
+  new->lsdb->ospf = new;
 
   new->default_originate = DEFAULT_ORIGINATE_NONE;
 
@@ -187,6 +189,9 @@ ospf_new (void)
   new->new_external_route = route_table_init ();
   new->old_external_route = route_table_init ();
   new->external_lsas = route_table_init ();
+  new->external_asbrs = route_table_init ();
+  new->external_fwds = route_table_init ();
+  new->external_internal = route_table_init ();
   
   new->stub_router_startup_time = OSPF_STUB_ROUTER_UNCONFIGURED;
   new->stub_router_shutdown_time = OSPF_STUB_ROUTER_UNCONFIGURED;
@@ -205,16 +210,19 @@ ospf_new (void)
   /* LSA timers */
   new->min_ls_interval = OSPF_MIN_LS_INTERVAL;
   new->min_ls_arrival = OSPF_MIN_LS_ARRIVAL;
+  new->flood_pacing = OSPF_FLOOD_PACING_DEFAULT;
 
   /* SPF timer value init. */
   new->spf_delay = OSPF_SPF_DELAY_DEFAULT;
   new->spf_holdtime = OSPF_SPF_HOLDTIME_DEFAULT;
   new->spf_max_holdtime = OSPF_SPF_MAX_HOLDTIME_DEFAULT;
   new->spf_hold_multiplier = 1;
+  new->spf_threads = OSPF_SPF_THREADS_DEFAULT;
 
   /* MaxAge init. */
   new->maxage_delay = OSPF_LSA_MAXAGE_REMOVE_DELAY_DEFAULT;
   new->maxage_lsa = route_table_init();
+  new->ls_rxmt_nbrs = vector_init (VECTOR_MIN_SIZE);
   new->t_maxage_walker =
     thread_add_timer (master, ospf_lsa_maxage_walker,
                       new, OSPF_LSA_MAXAGE_CHECK_INTERVAL);
@@ -222,7 +230,9 @@ ospf_new (void)
   /* Distance table init. */
   new->distance_table = route_table_init ();
 
-  new->lsa_refresh_queue.index = 0;
+  new->lsa_wheel.done[OSPF_LSA_WHEEL_MAXAGE] =
+    new->lsa_wheel.done[OSPF_LSA_WHEEL_REFRESH] =
+    recent_relative_time ().tv_sec / OSPF_LSA_WHEEL_GRANULARITY;
   new->lsa_refresh_interval = OSPF_LSA_REFRESH_INTERVAL_DEFAULT;
   new->t_lsa_refresher = thread_add_timer (master, ospf_lsa_refresh_walker,
 					   new, new->lsa_refresh_interval);
@@ -238,12 +248,13 @@ ospf_new (void)
   if (IS_DEBUG_OSPF (zebra, ZEBRA_INTERFACE))
     zlog_debug ("%s: starting with OSPF send buffer size %u",
       __func__, new->maxsndbuflen);
-  if ((new->ibuf = stream_new(OSPF_MAX_PACKET_SIZE+1)) == NULL)
-    {
-      zlog_err("ospf_new: fatal error: stream_new(%u) failed allocating ibuf",
-	       OSPF_MAX_PACKET_SIZE+1);
-      exit(1);
-    }
+  for (i = 0; i < OSPF_READ_BATCH; i++)
+    if ((new->ibuf[i] = stream_new(OSPF_MAX_PACKET_SIZE+1)) == NULL)
+      {
+	zlog_err("ospf_new: fatal error: stream_new(%u) failed allocating ibuf",
+		 OSPF_MAX_PACKET_SIZE+1);
+	exit(1);
+      }
   new->t_read = thread_add_read (master, ospf_read, new, new->fd);
   new->oi_write_q = list_new ();
   
@@ -338,6 +349,23 @@ ospf_deferred_shutdown_timer (struct thread *t)
   return 0;
 }
 
+/* Timer thread for graceful restart, waiting for the grace-LSAs to be
+ * acknowledged.
+ */
+static int
+ospf_gr_shutdown_timer (struct thread *t)
+{
+  struct ospf *ospf = THREAD_ARG(t);
+
+  ospf->t_deferred_shutdown = NULL;
+  if (ospf_gr_shutdown_done (ospf))
+    ospf_deferred_shutdown_finish (ospf);
+  else
+    OSPF_TIMER_ON (ospf->t_deferred_shutdown, ospf_gr_shutdown_timer, 1);
+
+  return 0;
+}
+
 /* Check whether deferred-shutdown must be scheduled, otherwise call
  * down directly into second-half of instance shutdown.
  */
@@ -364,6 +392,13 @@ ospf_deferred_shutdown_check (struct ospf *ospf)
         }
       timeout = ospf->stub_router_shutdown_time;
     }
+  /* Or have neighbours help us restart? */
+  else if (CHECK_FLAG (om->options, OSPF_MASTER_SHUTDOWN)
+           && ospf_gr_shutdown (ospf))
+    {
+      OSPF_TIMER_ON (ospf->t_deferred_shutdown, ospf_gr_shutdown_timer, 1);
+      return;
+    }
   else
     {
       /* No timer needed */
@@ -429,6 +464,7 @@ ospf_finish_final (struct ospf *ospf)
   int i;
 
   ospf_opaque_type11_lsa_term (ospf);
+  ospf_gr_finish (ospf);
   
   /* be nice if this worked, but it doesn't */
   /*ospf_flush_self_originated_lsas_now (ospf);*/
@@ -507,7 +543,8 @@ ospf_finish_final (struct ospf *ospf)
   OSPF_TIMER_OFF (ospf->t_opaque_lsa_self);
 
   close (ospf->fd);
-  stream_free(ospf->ibuf);
+  for (i = 0; i < OSPF_READ_BATCH; i++)
+    stream_free(ospf->ibuf[i]);
    
   LSDB_LOOP (OPAQUE_AS_LSDB (ospf), rn, lsa)
     ospf_discard_from_db (ospf, ospf->lsdb, lsa);
@@ -529,6 +566,7 @@ ospf_finish_final (struct ospf *ospf)
       route_unlock_node (rn);
     }
   route_table_finish (ospf->maxage_lsa);
+  vector_free (ospf->ls_rxmt_nbrs);
 
   if (ospf->old_table)
     ospf_route_table_free (ospf->old_table);
@@ -553,6 +591,7 @@ ospf_finish_final (struct ospf *ospf)
     }
   if (ospf->external_lsas)
     {
+      ospf_ase_external_deps_finish (ospf);
       ospf_ase_external_lsas_finish (ospf->external_lsas);
     }
 
@@ -575,6 +614,10 @@ ospf_finish_final (struct ospf *ospf)
 
   ospf_delete (ospf);
 
+  /* The last instance stops the threads calculating trees. */
+  if (listcount (om->ospf) == 0)
+    ospf_spf_workers_finish ();
+
   XFREE (MTYPE_OSPF_TOP, ospf);
 }
 
@@ -598,6 +641,7 @@ ospf_area_new (struct ospf *ospf, struct in_addr area_id)
   
   /* New LSDB init. */
   new->lsdb = ospf_lsdb_new ();
+  new->lsdb->ospf = ospf;
 
   /* Self-originated LSAs initialize. */
   new->router_lsa_self = NULL;
@@ -619,6 +663,9 @@ ospf_area_free (struct ospf_area *area)
   struct route_node *rn;
   struct ospf_lsa *lsa;
 
+  /* Free the shortest-path tree, which locks LSAs. */
+  ospf_spf_area_finish (area);
+
   /* Free LSDBs. */
   LSDB_LOOP (ROUTER_LSDB (area), rn, lsa)
     ospf_discard_from_db (area->ospf, area->lsdb, lsa);
@@ -1086,6 +1133,8 @@ ospf_ls_upd_queue_empty (struct ospf_interface *oi)
 	list_free (lst);
 	rn->info = NULL;
       }
+  oi->ls_upd_queue_count = 0;
+  oi->ls_upd_queue_octets = 0;
   
   /* remove update event */
   if (oi->t_ls_upd_event)
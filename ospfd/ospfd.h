@@ -28,6 +28,7 @@
 
 #include "filter.h"
 #include "log.h"
+#include "vector.h"
 
 #define OSPF_VERSION            2
 
@@ -74,6 +75,22 @@
 #define OSPF_DD_FLAG_I                   0x04
 #define OSPF_DD_FLAG_ALL                 0x07
 
+/* Packets the socket is read for at a time, each into a buffer of
+   its own, and at most per wakeup of the read thread.  Without
+   recvmmsg () a wakeup reads one packet. */
+#ifdef HAVE_RECVMMSG
+#define OSPF_READ_BATCH                  8
+#define OSPF_READ_BUDGET                64
+#else
+#define OSPF_READ_BATCH                  1
+#define OSPF_READ_BUDGET                 1
+#endif /* HAVE_RECVMMSG */
+
+/* Packets sent at a time, all by one interface, and at most per
+   wakeup of the write thread. */
+#define OSPF_WRITE_BATCH                16
+#define OSPF_WRITE_BUDGET               64
+
 #define OSPF_LS_REFRESH_SHIFT       (60 * 15)
 #define OSPF_LS_REFRESH_JITTER      60
 
@@ -146,15 +163,32 @@ struct ospf
 
 #define OSPF_STUB_MAX_METRIC_SUMMARY_COST	0x00ff0000
 
+  /* Graceful restart, RFC 3623, see ospf_gr.c. */
+  u_int16_t gr_grace_period;		/* Seconds, 0 if not configured. */
+  u_char gr_helper;			/* Help neighbours restart? */
+  u_char gr_state;
+#define OSPF_GR_NONE		0
+#define OSPF_GR_RESTARTING	1	/* Back, LSAs and FIB as before. */
+#define OSPF_GR_RESYNC		2	/* Back in full, FIB after routes are. */
+#define OSPF_GR_SHUTDOWN	3	/* Going, grace-LSAs sent. */
+  unsigned int gr_helping;		/* Neighbours we are helping. */
+  unsigned int gr_shutdown_wait;	/* Seconds left to wait for acks. */
+  u_int32_t gr_seqnum;			/* Highest of our old grace-LSAs. */
+  struct thread *t_gr_restart;		/* End of our grace period. */
+  struct thread *t_gr_event;		/* Left by installing LSAs. */
+  u_char gr_originate;			/* Helping over, LSAs to update. */
+
   /* LSA timers */
   unsigned int min_ls_interval; /* minimum delay between LSAs (in msec) */
   unsigned int min_ls_arrival; /* minimum interarrival time between LSAs (in msec) */
+  unsigned int flood_pacing; /* delay gathering LSAs into LS updates (in msec) */
 
   /* SPF parameters */
   unsigned int spf_delay;		/* SPF delay time. */
   unsigned int spf_holdtime;		/* SPF hold time. */
   unsigned int spf_max_holdtime;	/* SPF maximum-holdtime */
   unsigned int spf_hold_multiplier;	/* Adaptive multiplier for hold time */
+  unsigned int spf_threads;		/* Threads calculating area trees */
   
   int default_originate;		/* Default information originate. */
 #define DEFAULT_ORIGINATE_NONE		0
@@ -175,7 +209,8 @@ struct ospf
   
   /* Flags. */
   int external_origin;			/* AS-external-LSA origin flag. */
-  int ase_calc;				/* ASE calculation flag. */
+  int ase_calc;				/* ASE calculation flag, one of
+					   OSPF_ASE_CALC_*, 0 if none due. */
 
   struct list *opaque_lsa_self;		/* Type-11 Opaque-LSAs */
 
@@ -192,11 +227,36 @@ struct ospf
   struct route_table *external_lsas;    /* Database of external LSAs,
 					   prefix is LSA's adv. network*/
 
+  /* External LSAs by the routes they are calculated over, as
+     struct ospf_ase_dep at the /32 of the ASBR or forwarding address,
+     and the external prefixes an internal route overrode at the last
+     ASE calculation. */
+  struct route_table *external_asbrs;
+  struct route_table *external_fwds;
+  struct route_table *external_internal;
+
   /* Time stamps */
   struct timeval ts_spf;		/* SPF calculation time stamp. */
   struct timeval ts_spf_duration;	/* Execution time of last SPF */
 
+  /* Routing table calculations, counted by OSPF_SPF_* type. */
+  u_int32_t spf_runs[3];
+  int spf_last;				/* Type of the last one. */
+  struct
+  {
+    unsigned long spf;			/* Shortest-path trees. */
+    unsigned long intra;		/* Intra-area routes from them. */
+    unsigned long ia;			/* Inter-area routes. */
+    unsigned long prune;
+    unsigned long install;
+    unsigned long abr;
+  } spf_time;				/* Phases of the last one, usecs. */
+
   struct route_table *maxage_lsa;       /* List of MaxAge LSA for deletion. */
+
+  /* Neighbors by the slot of their Link state retransmission list in
+     the maps of LSAs, see ospf_flood.c. */
+  vector ls_rxmt_nbrs;
   int redistribute;                     /* Num of redistributed protocols. */
 
   /* Threads. */
@@ -218,7 +278,7 @@ struct ospf
   struct thread *t_read;
   int fd;
   unsigned int maxsndbuflen;
-  struct stream *ibuf;
+  struct stream *ibuf[OSPF_READ_BATCH];
   struct list *oi_write_q;
   
   /* Distribute lists out of other route sources. */
@@ -252,19 +312,28 @@ struct ospf
   
   int default_metric;		/* Default metric for redistribute. */
 
-#define OSPF_LSA_REFRESHER_GRANULARITY 10
-#define OSPF_LSA_REFRESHER_SLOTS ((OSPF_LS_REFRESH_TIME + \
-                                  OSPF_LS_REFRESH_SHIFT)/10 + 1)
-  struct
-  {
-    u_int16_t index;
-    struct list *qs[OSPF_LSA_REFRESHER_SLOTS];
-  } lsa_refresh_queue;
-  
   struct thread *t_lsa_refresher;
   time_t lsa_refresher_started;
 #define OSPF_LSA_REFRESH_INTERVAL_DEFAULT 10
+#define OSPF_LSA_REFRESH_INTERVAL_MAX 1800
   u_int16_t lsa_refresh_interval;
+
+  /* The LSAs of the database by the time they next need looking at,
+     in slots of OSPF_LSA_WHEEL_GRANULARITY seconds of relative time:
+     self-originated LSAs on the refresh lists, by when to refresh them,
+     and the others on the MaxAge lists, by when they reach MaxAge.
+     done[] is the last slot the walker of each list went through. */
+#define OSPF_LSA_WHEEL_GRANULARITY 10
+#define OSPF_LSA_WHEEL_SLOTS ((OSPF_LSA_MAXAGE + OSPF_LSA_REFRESH_INTERVAL_MAX) \
+                              / OSPF_LSA_WHEEL_GRANULARITY + 2)
+#define OSPF_LSA_WHEEL_MAXAGE	0
+#define OSPF_LSA_WHEEL_REFRESH	1
+  struct
+  {
+    struct ospf_lsa *slots[2][OSPF_LSA_WHEEL_SLOTS];
+    unsigned long count[2];
+    time_t done[2];
+  } lsa_wheel;
   
   /* Distance parameter. */
   u_char distance_all;
@@ -379,8 +448,21 @@ struct ospf_area
 #define PREFIX_LIST_OUT(A)  (A)->plist_out.list
 #define PREFIX_NAME_OUT(A)  (A)->plist_out.name
 
-  /* Shortest Path Tree. */
+  /* Shortest Path Tree, kept from one calculation to the next. */
   struct vertex *spf;
+  struct list *spf_vertices;		/* All its vertices, by distance. */
+  struct hash *spf_vertex_hash;		/* The same, by LSA type and ID. */
+  struct ospf_spf_arena *spf_arena;	/* What the tree is allocated from. */
+
+  /* Router- and network-LSAs whose links changed since the last SPF;
+     more than fit call for a full calculation. */
+#define OSPF_SPF_CHANGES_MAX	64
+  struct
+  {
+    u_char type;
+    struct in_addr id;
+  } spf_changes[OSPF_SPF_CHANGES_MAX];
+  unsigned int spf_changes_count;
 
   /* Threads. */
   struct thread *t_stub_router;    /* Stub-router timer */
@@ -388,6 +470,7 @@ struct ospf_area
 
   /* Statistics field. */
   u_int32_t spf_calculation;	/* SPF Calculation Count. */
+  u_int32_t spf_incremental;	/* ... of which incremental. */
 
   /* Time stamps. */
   struct timeval ts_spf;		/* SPF calculation time stamp. */
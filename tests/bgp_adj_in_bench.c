@@ -0,0 +1,331 @@
+/*
+ * BGP soft-reconfiguration inbound memory test
+ *
+ * Receives a full table from one peer with "soft-reconfiguration
+ * inbound" on, and checks that the Adj-RIB-In only keeps entries of its
+ * own for routes whose attributes inbound policy changed or that policy
+ * filtered.  Then changes policy back and forth through soft
+ * reconfiguration, and resets the session, checking the received
+ * attributes are kept exactly and the entries all go in the end.
+ * Soft reconfiguration with policy unchanged must leave every route
+ * alone, and routes not sent again within an enhanced route refresh
+ * must be swept at its end, whether policy filtered them or not.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "memory.h"
+#include "thread.h"
+#include "filter.h"
+#include "linklist.h"
+#include "workqueue.h"
+#include "zclient.h"
+#include "log.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_nexthop.h"
+#include "bgpd/bgp_advertise.h"
+
+#define BENCH_PREFIXES 200000
+#define BENCH_MEDS       1000
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+struct zclient *zclient;
+
+static struct bgp *bgp;
+static as_t asn = 100;
+
+static unsigned long
+bench_msec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start) / 1000;
+}
+
+static void
+bench_prefix (struct prefix *p, int i)
+{
+  memset (p, 0, sizeof (struct prefix));
+  p->family = AF_INET;
+  p->prefixlen = 24;
+  p->u.prefix4.s_addr = htonl ((1 << 24) + (i << 8));
+}
+
+static void
+bench_drain (struct peer *peer)
+{
+  struct thread thread;
+
+  while (((bm->process_main_queue
+	   && listcount (bm->process_main_queue->items))
+	  || (peer->clear_node_queue
+	      && listcount (peer->clear_node_queue->items)))
+	 && thread_fetch (bm->master, &thread))
+    thread_call (&thread);
+}
+
+static void
+bench_report (const char *what, unsigned long msec)
+{
+  printf ("%-28s %5lu ms, %6lu Adj-In entries in %3lu chunks\n", what, msec,
+	  bgp_adj_in_count (), mtype_stats_alloc (MTYPE_BGP_ADJ_IN));
+}
+
+/* Each route's received attributes must be what the peer sent, with
+ * the weight policy set on the route itself. */
+static int
+bench_check (struct bgp_node **rns, struct peer *peer, u_int32_t weight)
+{
+  int i;
+
+  for (i = 0; i < BENCH_PREFIXES; i++)
+    {
+      struct bgp_info *ri = rns[i]->info;
+      struct attr *attr = bgp_adj_in_lookup (rns[i], peer);
+
+      if (! ri || ! attr || attr->med != (u_int32_t) (i % BENCH_MEDS)
+	  || attr->weight != 0 || ri->attr->weight != weight)
+	{
+	  printf ("prefix %d: route or received attributes wrong\n", i);
+	  return 1;
+	}
+    }
+  return 0;
+}
+
+int
+main (void)
+{
+  struct bgp_node **rns;
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  struct peer *peer;
+  struct attr attr;
+  struct prefix p;
+  struct timeval start;
+  int i, failed = 0;
+
+  /* Without zebra every nexthop registration is logged, at debug. */
+  zlog_default = openzlog ("bgpadjinbench", ZLOG_BGP,
+			   LOG_CONS|LOG_NDELAY|LOG_PID, LOG_DAEMON);
+  zlog_set_level (NULL, ZLOG_DEST_SYSLOG, ZLOG_DISABLED);
+  zlog_set_level (NULL, ZLOG_DEST_STDOUT, LOG_WARNING);
+
+  master = thread_master_create ();
+  zclient = zclient_new (master);
+  /* No zebra here: selected routes go nowhere, not to stdin. */
+  zclient->sock = -1;
+  bgp_master_init ();
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_attr_init ();
+  bgp_address_init ();
+  bgp_scan_init ();
+
+  if (bgp_get (&bgp, &asn, NULL))
+    return -1;
+
+  peer = peer_create_accept (bgp);
+  peer->host = XSTRDUP (MTYPE_BGP_PEER_HOST, "feed");
+  peer->as = 200;
+  peer->local_as = bgp->as;
+  peer->sort = BGP_PEER_EBGP;
+  peer->status = Established;
+  peer->afc[AFI_IP][SAFI_UNICAST] = 1;
+  SET_FLAG (peer->af_flags[AFI_IP][SAFI_UNICAST], PEER_FLAG_SOFT_RECONFIG);
+
+  bgp_attr_default_set (&attr, BGP_ORIGIN_IGP);
+  attr.aspath = aspath_intern (aspath_str2aspath ("200 300"));
+  attr.nexthop.s_addr = htonl (0x0a000001);
+  attr.weight = 0;
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC);
+
+  rns = XCALLOC (MTYPE_TMP, BENCH_PREFIXES * sizeof (struct bgp_node *));
+
+  printf ("%d prefixes, %d distinct attributes, %lu bytes an entry\n",
+	  BENCH_PREFIXES, BENCH_MEDS, (unsigned long) sizeof (struct bgp_adj_in));
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < BENCH_PREFIXES; i++)
+    {
+      bench_prefix (&p, i);
+      attr.med = i % BENCH_MEDS;
+      bgp_update (peer, &p, &attr, AFI_IP, SAFI_UNICAST, ZEBRA_ROUTE_BGP,
+		  BGP_ROUTE_NORMAL, NULL, NULL, 0);
+      rns[i] = bgp_node_lookup (bgp->rib[AFI_IP][SAFI_UNICAST], &p);
+      bgp_unlock_node (rns[i]);
+    }
+  bench_report ("receive, no policy:", bench_msec (&start));
+
+  failed += bench_check (rns, peer, 0);
+  if (bgp_adj_in_count ())
+    {
+      printf ("expected routes accepted as received to keep no entry\n");
+      failed++;
+    }
+
+  /* Policy changes every route: the received attributes need keeping. */
+  peer->weight = 100;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  bgp_soft_reconfig_in (peer, AFI_IP, SAFI_UNICAST);
+  bench_report ("soft in, weight 100:", bench_msec (&start));
+
+  failed += bench_check (rns, peer, 100);
+  if (bgp_adj_in_count () != BENCH_PREFIXES)
+    {
+      printf ("expected an entry for every route policy changed\n");
+      failed++;
+    }
+
+  /* Nothing changed, nothing to redo. */
+  bench_drain (peer);
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  bgp_soft_reconfig_in (peer, AFI_IP, SAFI_UNICAST);
+  bench_report ("soft in, unchanged:", bench_msec (&start));
+
+  if (bm->process_main_queue && listcount (bm->process_main_queue->items))
+    {
+      printf ("expected no route reprocessed when policy is unchanged\n");
+      failed++;
+    }
+  failed += bench_check (rns, peer, 100);
+
+  /* And back again. */
+  peer->weight = 0;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  bgp_soft_reconfig_in (peer, AFI_IP, SAFI_UNICAST);
+  bench_report ("soft in, no policy:", bench_msec (&start));
+
+  failed += bench_check (rns, peer, 0);
+  if (bgp_adj_in_count () || mtype_stats_alloc (MTYPE_BGP_ADJ_IN))
+    {
+      printf ("expected the entries to be gone\n");
+      failed++;
+    }
+
+  /* Filtered routes are only in the Adj-RIB-In. */
+  aspath_unintern (&attr.aspath);
+  attr.aspath = aspath_intern (aspath_str2aspath ("200 100 300"));
+  for (i = BENCH_PREFIXES; i < BENCH_PREFIXES + 2; i++)
+    {
+      bench_prefix (&p, i);
+      bgp_update (peer, &p, &attr, AFI_IP, SAFI_UNICAST, ZEBRA_ROUTE_BGP,
+		  BGP_ROUTE_NORMAL, NULL, NULL, 0);
+      rn = bgp_node_get (bgp->rib[AFI_IP][SAFI_UNICAST], &p);
+      if (rn->info || ! bgp_adj_in_lookup (rn, peer)
+	  || bgp_adj_in_lookup (rn, peer)->aspath != attr.aspath)
+	{
+	  printf ("expected the looped route kept in Adj-RIB-In only\n");
+	  failed++;
+	}
+      bgp_unlock_node (rn);
+    }
+
+  peer->weight = 100;
+  bgp_soft_reconfig_in (peer, AFI_IP, SAFI_UNICAST);
+
+  /* An enhanced route refresh in which the peer sends all but the last
+     route again, and the second of the filtered ones but not the
+     first. */
+  bench_drain (peer);
+  bgp_set_stale_route (peer, AFI_IP, SAFI_UNICAST);
+  bench_prefix (&p, BENCH_PREFIXES + 1);
+  bgp_update (peer, &p, &attr, AFI_IP, SAFI_UNICAST, ZEBRA_ROUTE_BGP,
+	      BGP_ROUTE_NORMAL, NULL, NULL, 0);
+  aspath_unintern (&attr.aspath);
+  attr.aspath = aspath_intern (aspath_str2aspath ("200 300"));
+  for (i = 0; i < BENCH_PREFIXES - 1; i++)
+    {
+      bench_prefix (&p, i);
+      attr.med = i % BENCH_MEDS;
+      bgp_update (peer, &p, &attr, AFI_IP, SAFI_UNICAST, ZEBRA_ROUTE_BGP,
+		  BGP_ROUTE_NORMAL, NULL, NULL, 0);
+    }
+  bgp_clear_stale_route (peer, AFI_IP, SAFI_UNICAST);
+  bench_drain (peer);
+
+  /* The filtered route not sent again must not come back with the
+     next soft reconfiguration. */
+  for (i = BENCH_PREFIXES; i < BENCH_PREFIXES + 2; i++)
+    {
+      bench_prefix (&p, i);
+      rn = bgp_node_get (bgp->rib[AFI_IP][SAFI_UNICAST], &p);
+      if (! bgp_adj_in_lookup (rn, peer) != (i == BENCH_PREFIXES))
+	{
+	  printf ("expected only the filtered route not sent again to be "
+		  "swept\n");
+	  failed++;
+	}
+      bgp_unlock_node (rn);
+    }
+
+  ri = rns[BENCH_PREFIXES - 1]->info;
+  if ((ri && ! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+      || bgp_adj_in_lookup (rns[BENCH_PREFIXES - 1], peer)
+      || ! rns[0]->info
+      || CHECK_FLAG (((struct bgp_info *) rns[0]->info)->flags, BGP_INFO_STALE))
+    {
+      printf ("expected only the route not sent again to be swept\n");
+      failed++;
+    }
+
+  /* Withdraw half of them, then reset the session. */
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < BENCH_PREFIXES; i += 2)
+    {
+      bench_prefix (&p, i);
+      bgp_withdraw (peer, &p, NULL, AFI_IP, SAFI_UNICAST, ZEBRA_ROUTE_BGP,
+		    BGP_ROUTE_NORMAL, NULL, NULL);
+    }
+  bench_report ("withdraw half:", bench_msec (&start));
+
+  if (bgp_adj_in_count () != BENCH_PREFIXES / 2)
+    {
+      printf ("expected the withdrawn routes' entries to be gone\n");
+      failed++;
+    }
+
+  bench_drain (peer);
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  bgp_clear_route (peer, AFI_IP, SAFI_UNICAST, BGP_CLEAR_ROUTE_NORMAL);
+  bench_drain (peer);
+  bench_report ("session reset:", bench_msec (&start));
+
+  if (bgp_adj_in_count () || mtype_stats_alloc (MTYPE_BGP_ADJ_IN)
+      || mtype_stats_alloc (MTYPE_BGP_ADJ_IN_ARENA) || peer->adj_in_arena)
+    {
+      printf ("expected the peer's Adj-RIB-In to be gone\n");
+      failed++;
+    }
+
+  aspath_unintern (&attr.aspath);
+  bgp_attr_extra_free (&attr);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * AS path parse and intern benchmark
+ *
+ * Parses a large number of distinct AS_PATH attributes off the wire,
+ * as bgpd does for every UPDATE received, and then parses them all
+ * again to exercise the hash lookup of paths already interned.  AS
+ * path strings are only rendered when printed, so parsing should not
+ * allocate any; the last pass prints every path to show what that
+ * costs and how many strings are kept around afterwards.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "memory.h"
+#include "thread.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_aspath.h"
+
+#include "prng.h"
+
+#define BENCH_PATHS 500000
+#define BENCH_HOPS_MAX 8
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+
+/* The wire encoding of one 4-octet AS_PATH. */
+struct bench_wire
+{
+  u_char len;
+  u_char data[2 + 4 * BENCH_HOPS_MAX];
+};
+
+static void
+bench_wire (struct prng *prng, struct bench_wire *w, int i)
+{
+  int hops, h;
+  u_int32_t as;
+
+  hops = 2 + prng_rand (prng) % (BENCH_HOPS_MAX - 1);
+  w->data[0] = AS_SEQUENCE;
+  w->data[1] = hops;
+  for (h = 0; h < hops; h++)
+    {
+      /* The origin makes each path distinct. */
+      if (h == hops - 1)
+	as = 100000 + i;
+      else
+	as = 1 + prng_rand (prng) % 65000;
+      w->data[2 + h * 4] = as >> 24;
+      w->data[3 + h * 4] = as >> 16;
+      w->data[4 + h * 4] = as >> 8;
+      w->data[5 + h * 4] = as;
+    }
+  w->len = 2 + hops * 4;
+}
+
+static struct aspath *
+bench_parse (struct stream *s, struct bench_wire *w)
+{
+  stream_reset (s);
+  stream_put (s, w->data, w->len);
+  return aspath_parse (s, w->len, 1);
+}
+
+static unsigned long
+bench_msec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start) / 1000;
+}
+
+int
+main (void)
+{
+  struct prng *prng;
+  struct stream *s;
+  struct bench_wire *wires;
+  struct aspath **paths;
+  struct timeval start;
+  unsigned long msec, bytes;
+  int i, failed = 0;
+
+  master = thread_master_create ();
+  bgp_master_init ();
+  aspath_init ();
+
+  prng = prng_new (0);
+  s = stream_new (BGP_MAX_PACKET_SIZE);
+
+  wires = XCALLOC (MTYPE_TMP, BENCH_PATHS * sizeof (struct bench_wire));
+  paths = XCALLOC (MTYPE_TMP, BENCH_PATHS * sizeof (struct aspath *));
+  for (i = 0; i < BENCH_PATHS; i++)
+    bench_wire (prng, &wires[i], i);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < BENCH_PATHS; i++)
+    paths[i] = bench_parse (s, &wires[i]);
+  msec = bench_msec (&start);
+  printf ("parse %d new paths: %lu ms, %lu paths, %lu segments, "
+	  "%lu strings\n", BENCH_PATHS, msec, aspath_count (),
+	  mtype_stats_alloc (MTYPE_AS_SEG),
+	  mtype_stats_alloc (MTYPE_AS_STR));
+
+  if (aspath_count () != BENCH_PATHS)
+    {
+      printf ("expected %d distinct paths\n", BENCH_PATHS);
+      failed++;
+    }
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < BENCH_PATHS; i++)
+    {
+      struct aspath *as = bench_parse (s, &wires[i]);
+
+      if (as != paths[i])
+	failed++;
+      aspath_unintern (&as);
+    }
+  msec = bench_msec (&start);
+  printf ("parse %d known paths: %lu ms\n", BENCH_PATHS, msec);
+
+  bytes = 0;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < BENCH_PATHS; i++)
+    bytes += strlen (aspath_print (paths[i])) + 1;
+  msec = bench_msec (&start);
+  printf ("print %d paths: %lu ms, %lu bytes of strings rendered, "
+	  "%lu kept\n", BENCH_PATHS, msec, bytes,
+	  mtype_stats_alloc (MTYPE_AS_STR));
+
+  /* Rendering on demand must give the same result as ever. */
+  {
+    struct aspath *as = aspath_str2aspath ("64512 {64513,64514} (64515)");
+
+    if (strcmp (aspath_print (as), "64512 {64513,64514} (64515)"))
+      {
+	printf ("rendered \"%s\"\n", aspath_print (as));
+	failed++;
+      }
+    aspath_free (as);
+  }
+
+  for (i = 0; i < BENCH_PATHS; i++)
+    aspath_unintern (&paths[i]);
+  if (mtype_stats_alloc (MTYPE_AS_STR) != 0)
+    {
+      printf ("%lu strings left behind\n", mtype_stats_alloc (MTYPE_AS_STR));
+      failed++;
+    }
+
+  stream_free (s);
+  prng_free (prng);
+  return failed ? 1 : 0;
+}
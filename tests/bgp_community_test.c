@@ -0,0 +1,384 @@
+/*
+ * BGP community-list matching test
+ *
+ * Matches random community and large community attributes against
+ * random standard community-lists, and checks the compiled matcher
+ * gives the answers the entry by entry walk gives: for plain and exact
+ * matching, for deleting values, and after the lists change.  Then
+ * times both on routes carrying many communities tested against many
+ * lists, as routes from some exchanges are.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "memory.h"
+#include "thread.h"
+#include "filter.h"
+#include "zclient.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_lcommunity.h"
+#include "bgpd/bgp_regex.h"
+#include "bgpd/bgp_clist.h"
+
+#include "prng.h"
+
+#define TEST_LISTS	40
+#define TEST_ROUTES	2000
+#define TEST_COMMS_MAX	60
+#define BENCH_ROUNDS	10
+
+/* Values are drawn from AS 65000 to 65009, 0 to 99, so lists hit. */
+#define TEST_ASES	10
+#define TEST_VALS	100
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+struct zclient *zclient;
+
+static struct community_list_handler *ch;
+static struct community_list *lists[TEST_LISTS];
+static struct community_list *llists[TEST_LISTS];
+static struct community *routes[TEST_ROUTES];
+static struct lcommunity *lroutes[TEST_ROUTES];
+static struct prng *prng;
+
+static unsigned long
+bench_msec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start) / 1000;
+}
+
+static u_int32_t
+test_val (void)
+{
+  return ((65000 + prng_rand (prng) % TEST_ASES) << 16)
+    | (prng_rand (prng) % TEST_VALS);
+}
+
+/* The matching of community-lists entry by entry, scanning the values
+   of the route for each entry. */
+static int
+ref_include (const u_char *vals, int size, const u_char *val, int width)
+{
+  int i;
+
+  for (i = 0; i < size; i++)
+    if (memcmp (vals + i * width, val, width) == 0)
+      return 1;
+  return 0;
+}
+
+static int
+ref_entry_vals (struct community_entry *entry, const u_char **vals,
+		int *width)
+{
+  if (entry->style == LARGE_COMMUNITY_LIST_STANDARD)
+    {
+      *vals = entry->u.lcom->val;
+      *width = LCOMMUNITY_SIZE;
+      return entry->u.lcom->size;
+    }
+  *vals = (const u_char *) entry->u.com->val;
+  *width = sizeof (u_int32_t);
+  return entry->u.com->size;
+}
+
+static int
+ref_internet (struct community_entry *entry)
+{
+  u_int32_t internet = htonl (COMMUNITY_INTERNET);
+
+  return (entry->style == COMMUNITY_LIST_STANDARD
+	  && ref_include ((const u_char *) entry->u.com->val,
+			  entry->u.com->size, (u_char *) &internet, 4));
+}
+
+static int
+ref_match (const u_char *vals, int size, struct community_list *list,
+	   int exact)
+{
+  struct community_entry *entry;
+  const u_char *evals;
+  int esize, width;
+  int i;
+
+  for (entry = list->head; entry; entry = entry->next)
+    {
+      if (entry->any || ref_internet (entry))
+	return entry->direct == COMMUNITY_PERMIT;
+      if (! vals)
+	continue;
+
+      esize = ref_entry_vals (entry, &evals, &width);
+      if (exact && esize != size)
+	continue;
+      for (i = 0; i < esize; i++)
+	if (! ref_include (vals, size, evals + i * width, width))
+	  break;
+      if (i == esize)
+	return entry->direct == COMMUNITY_PERMIT;
+    }
+  return 0;
+}
+
+/* How many values deleting by the list leaves. */
+static int
+ref_delete (const u_char *vals, int size, int width,
+	    struct community_list *list)
+{
+  struct community_entry *entry;
+  const u_char *evals;
+  int esize, ewidth;
+  int left = size;
+  int i;
+
+  for (i = 0; i < size; i++)
+    for (entry = list->head; entry; entry = entry->next)
+      {
+	esize = entry->any ? 0 : ref_entry_vals (entry, &evals, &ewidth);
+	if (entry->any || ref_internet (entry)
+	    || ref_include (evals, esize, vals + i * width, width))
+	  {
+	    if (entry->direct == COMMUNITY_PERMIT)
+	      left--;
+	    break;
+	  }
+      }
+  return left;
+}
+
+/* Random lists of 1 to 6 entries of 1 to 3 values, some denying.  A
+   few end in "any" or name "internet". */
+static void
+test_lists (int n)
+{
+  char name[16];
+  char str[128];
+  u_int32_t val;
+  int entries, size;
+  int i, j, k;
+  size_t len;
+
+  for (i = 0; i < n; i++)
+    {
+      snprintf (name, sizeof (name), "L%d", i);
+      entries = 1 + prng_rand (prng) % 6;
+      for (j = 0; j < entries; j++)
+	{
+	  size = 1 + prng_rand (prng) % 3;
+	  str[0] = '\0';
+	  for (k = 0, len = 0; k < size; k++)
+	    {
+	      val = test_val ();
+	      len += snprintf (str + len, sizeof (str) - len, "%s%u:%u",
+			       k ? " " : "", val >> 16, val & 0xffff);
+	    }
+	  if (i % 13 == 5 && j == entries - 1)
+	    strcpy (str, "internet");
+	  community_list_set (ch, name, str,
+			      prng_rand (prng) % 4 ? COMMUNITY_PERMIT
+						   : COMMUNITY_DENY,
+			      COMMUNITY_LIST_STANDARD);
+
+	  for (k = 0, len = 0; k < size; k++)
+	    {
+	      val = test_val ();
+	      len += snprintf (str + len, sizeof (str) - len, "%s%u:%u:%u",
+			       k ? " " : "", val >> 16, i, val & 0xffff);
+	    }
+	  lcommunity_list_set (ch, name, str,
+			       prng_rand (prng) % 4 ? COMMUNITY_PERMIT
+						    : COMMUNITY_DENY,
+			       LARGE_COMMUNITY_LIST_STANDARD);
+	}
+      if (i % 7 == 3)
+	{
+	  community_list_set (ch, name, NULL, COMMUNITY_PERMIT,
+			      COMMUNITY_LIST_STANDARD);
+	  lcommunity_list_set (ch, name, NULL, COMMUNITY_PERMIT,
+			       LARGE_COMMUNITY_LIST_STANDARD);
+	}
+      lists[i] = community_list_lookup (ch, name, COMMUNITY_LIST_MASTER);
+      llists[i] = community_list_lookup (ch, name,
+					 LARGE_COMMUNITY_LIST_MASTER);
+    }
+}
+
+/* Interned attributes of 0 to TEST_COMMS_MAX values; a route of no
+   values stands for one without the attribute. */
+static void
+test_routes (void)
+{
+  u_int32_t vals[TEST_COMMS_MAX];
+  u_int32_t lvals[TEST_COMMS_MAX * 3];
+  u_int32_t val;
+  int size;
+  int i, j;
+
+  for (i = 0; i < TEST_ROUTES; i++)
+    {
+      size = prng_rand (prng) % (TEST_COMMS_MAX + 1);
+      for (j = 0; j < size; j++)
+	{
+	  val = test_val ();
+	  vals[j] = htonl (val);
+	  lvals[j * 3] = htonl (val >> 16);
+	  lvals[j * 3 + 1] = htonl (prng_rand (prng) % TEST_LISTS);
+	  lvals[j * 3 + 2] = htonl (val & 0xffff);
+	}
+      routes[i] = size ? community_parse (vals, size * 4) : NULL;
+      lroutes[i] = size ? lcommunity_parse ((u_int8_t *) lvals,
+					    size * LCOMMUNITY_SIZE) : NULL;
+    }
+}
+
+static int
+test_compare (const char *when)
+{
+  struct community *com, *del;
+  struct lcommunity *lcom, *ldel;
+  int hits = 0;
+  int failed = 0;
+  int i, l;
+
+  for (i = 0; i < TEST_ROUTES; i++)
+    for (l = 0; l < TEST_LISTS; l++)
+      {
+	com = routes[i];
+	lcom = lroutes[i];
+
+	if (community_list_match (com, lists[l])
+	    != ref_match (com ? (u_char *) com->val : NULL,
+			  com ? com->size : 0, lists[l], 0))
+	  failed++;
+	if (community_list_exact_match (com, lists[l])
+	    != ref_match (com ? (u_char *) com->val : NULL,
+			  com ? com->size : 0, lists[l], 1))
+	  failed++;
+	if (lcommunity_list_match (lcom, llists[l])
+	    != ref_match (lcom ? lcom->val : NULL,
+			  lcom ? lcom->size : 0, llists[l], 0))
+	  failed++;
+	hits += community_list_match (com, lists[l]);
+
+	if (com)
+	  {
+	    del = community_list_match_delete (community_dup (com), lists[l]);
+	    if (del->size != ref_delete ((u_char *) com->val, com->size, 4,
+					 lists[l]))
+	      failed++;
+	    community_free (del);
+	  }
+	if (lcom)
+	  {
+	    ldel = lcommunity_list_match_delete (lcommunity_dup (lcom),
+						 llists[l]);
+	    if (ldel->size != ref_delete (lcom->val, lcom->size,
+					  LCOMMUNITY_SIZE, llists[l]))
+	      failed++;
+	    lcommunity_free (&ldel);
+	  }
+      }
+
+  printf ("%s: %d of %d matches, %d differences\n", when, hits,
+	  TEST_ROUTES * TEST_LISTS, failed);
+  return failed;
+}
+
+static int
+bench_match (void)
+{
+  struct timeval start;
+  unsigned long ref_ms, ms;
+  int ref_hits = 0, hits = 0;
+  int r, i, l;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    for (i = 0; i < TEST_ROUTES; i++)
+      for (l = 0; l < TEST_LISTS; l++)
+	ref_hits += ref_match (routes[i] ? (u_char *) routes[i]->val : NULL,
+			       routes[i] ? routes[i]->size : 0, lists[l], 0);
+  ref_ms = bench_msec (&start);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    for (i = 0; i < TEST_ROUTES; i++)
+      for (l = 0; l < TEST_LISTS; l++)
+	hits += community_list_match (routes[i], lists[l]);
+  ms = bench_msec (&start);
+
+  printf ("%d matches of up to %d communities against %d lists: "
+	  "entry by entry %lu ms, compiled %lu ms\n",
+	  BENCH_ROUNDS * TEST_ROUTES * TEST_LISTS, TEST_COMMS_MAX,
+	  TEST_LISTS, ref_ms, ms);
+  return hits != ref_hits;
+}
+
+int
+main (void)
+{
+  int failed = 0;
+  int i;
+
+  master = thread_master_create ();
+  zclient = zclient_new (master);
+  /* Unconnected, as zclient_init would leave it. */
+  zclient->sock = -1;
+  bgp_master_init ();
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_attr_init ();
+
+  prng = prng_new (0);
+  ch = community_list_init ();
+
+  test_lists (TEST_LISTS);
+  test_routes ();
+
+  failed += test_compare ("compiled");
+  failed += bench_match ();
+
+  /* Entries added after the lists were compiled are matched too. */
+  test_lists (TEST_LISTS);
+  failed += test_compare ("lists changed");
+
+  for (i = 0; i < TEST_ROUTES; i++)
+    {
+      if (routes[i])
+	community_unintern (&routes[i]);
+      if (lroutes[i])
+	lcommunity_unintern (&lroutes[i]);
+    }
+  community_list_terminate (ch);
+  prng_free (prng);
+
+  printf ("%s\n", failed ? "failed" : "OK");
+  return failed ? 1 : 0;
+}
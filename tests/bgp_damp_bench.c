@@ -0,0 +1,224 @@
+/*
+ * BGP route flap dampening stress test
+ *
+ * Flaps a large number of prefixes from one peer until they are all
+ * suppressed, then runs the reuse timer forward until every one of
+ * them has been reused and reselected, timing each phase.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+#include <math.h>
+
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "memory.h"
+#include "thread.h"
+#include "filter.h"
+#include "linklist.h"
+#include "workqueue.h"
+#include "zclient.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_damp.h"
+
+#define BENCH_PREFIXES 100000
+#define BENCH_FLAPS         4
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+struct zclient *zclient;
+
+static struct bgp *bgp;
+static as_t asn = 100;
+
+static unsigned long
+bench_msec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start) / 1000;
+}
+
+static int
+bench_count (struct bgp_node **rns, u_int32_t flag)
+{
+  int i, count = 0;
+
+  for (i = 0; i < BENCH_PREFIXES; i++)
+    if (CHECK_FLAG (((struct bgp_info *) rns[i]->info)->flags, flag))
+      count++;
+  return count;
+}
+
+/* The integer decay must agree with the exponential it stands for. */
+static int
+bench_decay_check (time_t half_life)
+{
+  time_t t;
+
+  for (t = 0; t < half_life * 4; t += 7)
+    {
+      double want = 12000 * pow (0.5, (double) (t - t % DELTA_T) / half_life);
+      int got = bgp_damp_decay (t, 12000);
+
+      if (fabs (got - want) > 1.0)
+	{
+	  printf ("decay after %lds: %d, expected %.1f\n", (long) t, got, want);
+	  return 1;
+	}
+    }
+  return 0;
+}
+
+int
+main (void)
+{
+  struct bgp_node **rns;
+  struct bgp_info *ri;
+  struct peer *peer;
+  struct attr *attr;
+  struct thread thread;
+  struct timeval start;
+  unsigned long msec;
+  time_t t_now;
+  int i, flap, ticks, failed = 0;
+
+  master = thread_master_create ();
+  zclient = zclient_new (master);
+  /* Not connected to zebra, nothing is to be written to fd 0. */
+  zclient->sock = -1;
+  bgp_master_init ();
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_attr_init ();
+
+  if (bgp_get (&bgp, &asn, NULL))
+    return -1;
+
+  peer = peer_create_accept (bgp);
+  peer->host = XSTRDUP (MTYPE_BGP_PEER_HOST, "flapper");
+  peer->as = 200;
+  peer->local_as = bgp->as;
+  peer->sort = BGP_PEER_EBGP;
+  peer->status = Established;
+
+  bgp_damp_enable (bgp, AFI_IP, SAFI_UNICAST, DEFAULT_HALF_LIFE * 60,
+		   DEFAULT_REUSE, DEFAULT_SUPPRESS, DEFAULT_HALF_LIFE * 60 * 4);
+  failed += bench_decay_check (DEFAULT_HALF_LIFE * 60);
+
+  attr = bgp_attr_default_intern (BGP_ORIGIN_IGP);
+
+  rns = XCALLOC (MTYPE_TMP, BENCH_PREFIXES * sizeof (struct bgp_node *));
+  for (i = 0; i < BENCH_PREFIXES; i++)
+    {
+      struct prefix p;
+
+      memset (&p, 0, sizeof (p));
+      p.family = AF_INET;
+      p.prefixlen = 24;
+      p.u.prefix4.s_addr = htonl ((1 << 24) + (i << 8));
+      rns[i] = bgp_node_get (bgp->rib[AFI_IP][SAFI_UNICAST], &p);
+
+      ri = XCALLOC (MTYPE_BGP_ROUTE, sizeof (struct bgp_info));
+      ri->peer = peer;
+      ri->attr = bgp_attr_intern (attr);
+      ri->type = ZEBRA_ROUTE_BGP;
+      ri->sub_type = BGP_ROUTE_NORMAL;
+      SET_FLAG (ri->flags, BGP_INFO_VALID);
+      bgp_info_add (rns[i], ri);
+    }
+
+  printf ("%d prefixes, %d flaps each\n", BENCH_PREFIXES, BENCH_FLAPS);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (flap = 0; flap < BENCH_FLAPS; flap++)
+    for (i = 0; i < BENCH_PREFIXES; i++)
+      {
+	ri = rns[i]->info;
+	bgp_damp_withdraw (ri, rns[i], AFI_IP, SAFI_UNICAST, 0);
+	bgp_damp_update (ri, rns[i], AFI_IP, SAFI_UNICAST);
+      }
+  msec = bench_msec (&start);
+  printf ("flap: %d withdraws and updates in %lu ms, %d suppressed, "
+	  "%lu damp infos of %lu bytes\n",
+	  BENCH_PREFIXES * BENCH_FLAPS, msec,
+	  bench_count (rns, BGP_INFO_DAMPED),
+	  mtype_stats_alloc (MTYPE_BGP_DAMP_INFO),
+	  (unsigned long) sizeof (struct bgp_damp_info));
+
+  if (bench_count (rns, BGP_INFO_DAMPED) != BENCH_PREFIXES)
+    {
+      printf ("expected every prefix to be suppressed\n");
+      failed++;
+    }
+
+  /* Run the reuse timer forward until everything is back, the max
+   * suppress time should see to that.
+   */
+  t_now = bgp_clock ();
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (ticks = 1; ticks < DEFAULT_HALF_LIFE * 60 * 8 / DELTA_REUSE; ticks++)
+    {
+      bgp_damp_reuse_run (t_now + ticks * DELTA_REUSE);
+      if (bench_count (rns, BGP_INFO_DAMPED) == 0)
+	break;
+    }
+  msec = bench_msec (&start);
+  printf ("reuse: %d timer ticks (%d s) in %lu ms, %d still suppressed, "
+	  "%lu damp infos left\n", ticks, ticks * DELTA_REUSE, msec,
+	  bench_count (rns, BGP_INFO_DAMPED),
+	  mtype_stats_alloc (MTYPE_BGP_DAMP_INFO));
+
+  if (bench_count (rns, BGP_INFO_DAMPED) || bench_count (rns, BGP_INFO_HISTORY))
+    {
+      printf ("expected every prefix to be reused\n");
+      failed++;
+    }
+
+  /* Reselect the reused routes. */
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  while (bm->process_main_queue && listcount (bm->process_main_queue->items)
+	 && thread_fetch (bm->master, &thread))
+    thread_call (&thread);
+  msec = bench_msec (&start);
+  printf ("process: %d selected in %lu ms\n",
+	  bench_count (rns, BGP_INFO_SELECTED), msec);
+
+  if (bench_count (rns, BGP_INFO_SELECTED) != BENCH_PREFIXES)
+    {
+      printf ("expected every prefix to be selected\n");
+      failed++;
+    }
+
+  bgp_damp_disable (bgp, AFI_IP, SAFI_UNICAST);
+  if (mtype_stats_alloc (MTYPE_BGP_DAMP_INFO))
+    {
+      printf ("%lu damp infos left behind\n",
+	      mtype_stats_alloc (MTYPE_BGP_DAMP_INFO));
+      failed++;
+    }
+
+  return failed ? 1 : 0;
+}
@@ -35,6 +35,7 @@
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_mpath.h"
 
 #define VT100_RESET "\x1b[0m"
@@ -365,6 +366,216 @@ testcase_t test_bgp_info_mpath_update = {
   .cleanup = cleanup_bgp_info_mpath_update,
 };
 
+/*=========================================================
+ * Testcase and benchmark for shared multipath sets
+ *
+ * Every prefix is learnt from the same 16 sessions, 4 to each of 4
+ * upstreams, with the same attributes per session, as with
+ * maximum-paths 16 over 4 upstreams. All prefixes should share one
+ * multipath set, its aggregate built once.
+ */
+#define MPATH_BENCH_PREFIXES	20000
+#define MPATH_BENCH_PATHS	16
+#define MPATH_BENCH_UPSTREAMS	4
+
+struct peer mpath_bench_peer[MPATH_BENCH_PATHS];
+struct attr *mpath_bench_attr[MPATH_BENCH_PATHS];
+struct attr *mpath_bench_attr_chg;
+struct bgp_node *mpath_bench_rn;
+struct bgp_info *mpath_bench_info;
+
+static unsigned long
+bench_msec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start) / 1000;
+}
+
+static struct attr *
+mpath_bench_attr_make (int path, u_int32_t med)
+{
+  struct attr attr;
+  struct attr *new;
+  char buf[32];
+
+  bgp_attr_default_set (&attr, BGP_ORIGIN_IGP);
+  aspath_unintern (&attr.aspath);
+  snprintf (buf, sizeof (buf), "%d 65100", 65001 + path % MPATH_BENCH_UPSTREAMS);
+  attr.aspath = aspath_str2aspath (buf);
+  attr.nexthop.s_addr = htonl (0x0a000001 + path);
+  attr.med = med;
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC);
+
+  new = bgp_attr_intern (&attr);
+  bgp_attr_extra_free (&attr);
+  return new;
+}
+
+static int
+setup_bgp_mpath_set (testcase_t *t)
+{
+  char buf[32];
+  int i, p;
+
+  test_mp_bgp.maxpaths[AFI_IP][SAFI_UNICAST].maxpaths_ebgp = MPATH_BENCH_PATHS;
+  test_mp_bgp.maxpaths[AFI_IP][SAFI_UNICAST].maxpaths_ibgp = MPATH_BENCH_PATHS;
+
+  for (p = 0; p < MPATH_BENCH_PATHS; p++)
+    {
+      mpath_bench_peer[p].bgp = &test_mp_bgp;
+      mpath_bench_peer[p].local_as = 1;
+      mpath_bench_peer[p].as = 65001 + p % MPATH_BENCH_UPSTREAMS;
+      mpath_bench_peer[p].sort = BGP_PEER_EBGP;
+      snprintf (buf, sizeof (buf), "10.0.0.%d", p + 1);
+      if ((mpath_bench_peer[p].su_remote = sockunion_str2su (buf)) == NULL)
+        return -1;
+      mpath_bench_attr[p] = mpath_bench_attr_make (p, 0);
+    }
+  mpath_bench_attr_chg = mpath_bench_attr_make (5, 100);
+
+  mpath_bench_rn = XCALLOC (MTYPE_TMP, MPATH_BENCH_PREFIXES
+                                       * sizeof (struct bgp_node));
+  mpath_bench_info = XCALLOC (MTYPE_TMP, MPATH_BENCH_PREFIXES
+                                         * MPATH_BENCH_PATHS
+                                         * sizeof (struct bgp_info));
+  for (i = 0; i < MPATH_BENCH_PREFIXES; i++)
+    {
+      mpath_bench_rn[i].p.family = AF_INET;
+      mpath_bench_rn[i].p.prefixlen = 24;
+      mpath_bench_rn[i].p.u.prefix4.s_addr = htonl (0x14000000 + (i << 8));
+      for (p = 0; p < MPATH_BENCH_PATHS; p++)
+        {
+          struct bgp_info *ri = &mpath_bench_info[i * MPATH_BENCH_PATHS + p];
+
+          ri->peer = &mpath_bench_peer[p];
+          ri->attr = mpath_bench_attr[p];
+        }
+    }
+  return 0;
+}
+
+/* What bgp_best_selection and bgp_process do for one prefix, with the
+ * path of the first session always the best */
+static void
+mpath_bench_select (int i, int first)
+{
+  struct bgp_info *info = &mpath_bench_info[i * MPATH_BENCH_PATHS];
+  struct list mp_list;
+  int p;
+
+  bgp_mp_list_init (&mp_list);
+  for (p = 0; p < MPATH_BENCH_PATHS; p++)
+    bgp_mp_list_add (&mp_list, &info[p]);
+
+  bgp_info_mpath_update (&mpath_bench_rn[i], &info[0],
+                         first ? NULL : &info[0], &mp_list,
+                         AFI_IP, SAFI_UNICAST);
+  bgp_info_mpath_aggregate_update (&info[0], first ? NULL : &info[0]);
+  bgp_mp_list_clear (&mp_list);
+
+  for (p = 0; p < MPATH_BENCH_PATHS; p++)
+    UNSET_FLAG (info[p].flags, BGP_INFO_ATTR_CHANGED|BGP_INFO_MULTIPATH_CHG);
+}
+
+static int
+run_bgp_mpath_set (testcase_t *t)
+{
+  struct timeval start;
+  struct bgp_info *best;
+  struct attr *mp_attr;
+  unsigned long aggregated;
+  int test_result = TEST_PASSED;
+  int i;
+
+  /* Every prefix selected for the first time */
+  aggregated = bgp_mpath_set_aggregated ();
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < MPATH_BENCH_PREFIXES; i++)
+    mpath_bench_select (i, 1);
+  printf ("%d prefixes with %d paths: %lu ms, %lu multipath sets, "
+          "%lu aggregates built\n", MPATH_BENCH_PREFIXES, MPATH_BENCH_PATHS,
+          bench_msec (&start), bgp_mpath_set_count (),
+          bgp_mpath_set_aggregated () - aggregated);
+
+  EXPECT_TRUE (bgp_mpath_set_count () == 1, test_result);
+  EXPECT_TRUE (bgp_mpath_set_aggregated () - aggregated == 1, test_result);
+  mp_attr = bgp_info_mpath_attr (&mpath_bench_info[0]);
+  EXPECT_TRUE (mp_attr != NULL, test_result);
+  EXPECT_TRUE (mp_attr && mp_attr->aspath->segments->type == AS_SET,
+               test_result);
+  for (i = 0; i < MPATH_BENCH_PREFIXES; i++)
+    {
+      best = &mpath_bench_info[i * MPATH_BENCH_PATHS];
+      if (bgp_info_mpath_count (best) != MPATH_BENCH_PATHS - 1
+          || bgp_info_mpath_attr (best) != mp_attr)
+        break;
+    }
+  EXPECT_TRUE (i == MPATH_BENCH_PREFIXES, test_result);
+
+  /* One session changes its MED for half of the prefixes, which then
+   * share a second set */
+  aggregated = bgp_mpath_set_aggregated ();
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < MPATH_BENCH_PREFIXES; i += 2)
+    {
+      struct bgp_info *ri = &mpath_bench_info[i * MPATH_BENCH_PATHS + 5];
+
+      ri->attr = mpath_bench_attr_chg;
+      SET_FLAG (ri->flags, BGP_INFO_ATTR_CHANGED);
+      mpath_bench_select (i, 0);
+    }
+  printf ("%d prefixes changed: %lu ms, %lu multipath sets, "
+          "%lu aggregates built\n", MPATH_BENCH_PREFIXES / 2,
+          bench_msec (&start), bgp_mpath_set_count (),
+          bgp_mpath_set_aggregated () - aggregated);
+
+  EXPECT_TRUE (bgp_mpath_set_count () == 2, test_result);
+  EXPECT_TRUE (bgp_mpath_set_aggregated () - aggregated == 1, test_result);
+  EXPECT_TRUE (bgp_info_mpath_attr (&mpath_bench_info[0])
+               == bgp_info_mpath_attr (&mpath_bench_info[2 * MPATH_BENCH_PATHS]),
+               test_result);
+  EXPECT_TRUE (bgp_info_mpath_attr (&mpath_bench_info[1 * MPATH_BENCH_PATHS])
+               == mp_attr, test_result);
+
+  /* Nothing changed: nothing looked up */
+  aggregated = bgp_mpath_set_aggregated ();
+  for (i = 0; i < MPATH_BENCH_PREFIXES; i++)
+    mpath_bench_select (i, 0);
+  EXPECT_TRUE (bgp_mpath_set_aggregated () == aggregated, test_result);
+
+  return test_result;
+}
+
+static int
+cleanup_bgp_mpath_set (testcase_t *t)
+{
+  int i, p;
+
+  for (i = 0; i < MPATH_BENCH_PREFIXES * MPATH_BENCH_PATHS; i++)
+    bgp_info_mpath_free (&mpath_bench_info[i].mpath);
+  if (bgp_mpath_set_count () != 0)
+    return -1;
+
+  for (p = 0; p < MPATH_BENCH_PATHS; p++)
+    {
+      sockunion_free (mpath_bench_peer[p].su_remote);
+      bgp_attr_unintern (&mpath_bench_attr[p]);
+    }
+  bgp_attr_unintern (&mpath_bench_attr_chg);
+  XFREE (MTYPE_TMP, mpath_bench_info);
+  XFREE (MTYPE_TMP, mpath_bench_rn);
+  return 0;
+}
+
+testcase_t test_bgp_mpath_set = {
+  .desc = "Test shared multipath sets",
+  .setup = setup_bgp_mpath_set,
+  .run = run_bgp_mpath_set,
+  .cleanup = cleanup_bgp_mpath_set,
+};
+
 /*=========================================================
  * Set up testcase vector
  */
@@ -372,6 +583,7 @@ testcase_t *all_tests[] = {
   &test_bgp_cfg_maximum_paths,
   &test_bgp_mp_list,
   &test_bgp_info_mpath_update,
+  &test_bgp_mpath_set,
 };
 
 int all_tests_count = (sizeof(all_tests)/sizeof(testcase_t *));
@@ -386,6 +598,7 @@ global_test_init (void)
   zclient = zclient_new (master);
   bgp_master_init ();
   bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_attr_init ();
   
   if (fileno (stdout) >= 0)
     tty = isatty (fileno (stdout));
@@ -0,0 +1,204 @@
+/*
+ * AS path regular expression benchmark
+ *
+ * Builds a corpus of real looking AS paths, checks that the compiled
+ * AS path matcher agrees with POSIX regexec () on every one of them for
+ * a set of typical as-path access-list expressions, then times both
+ * over a table where, like a full table, many routes share a path.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "vty.h"
+#include "privs.h"
+#include "memory.h"
+#include "thread.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_regex.h"
+
+#include "prng.h"
+
+#define BENCH_PATHS   100000
+#define BENCH_ROUTES  300000
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+
+static const char *regexes[] =
+{
+  "^$",
+  "_3356_",
+  "^174_",
+  "_13335$",
+  "^(3356|1299|2914)_",
+  "_6451[2-9]_",
+  "_(64[5-9][0-9][0-9]|65[0-5][0-9][0-9])_",
+  "^[0-9]+$",
+  "^[0-9]+_[0-9]+_[0-9]+_[0-9]+_[0-9]+_",
+  "_2914_.*_4134$",
+  "(_1299)+_",
+  "_3356_3356_",
+  ".*",
+  "^1[0-9]*_",
+  "_4200000[0-9]+_",
+  "\\{[0-9]+,",
+  "_42{1,3}_",
+  NULL,
+};
+
+/* Transit ASes paths tend to start with, and origins. */
+static const as_t transit[] =
+{
+  174, 701, 1299, 2914, 3257, 3356, 3491, 6453, 6461, 6762, 6939, 7018,
+  9002, 12956,
+};
+#define TRANSIT_COUNT (sizeof (transit) / sizeof (transit[0]))
+
+static struct aspath *
+bench_path (struct prng *prng)
+{
+  char buf[256];
+  int len, i, n, hops;
+  as_t as;
+
+  len = 0;
+  hops = 1 + prng_rand (prng) % 6;
+  for (i = 0; i < hops; i++)
+    {
+      if (i < 2)
+	as = transit[(prng_rand (prng) >> 8) % TRANSIT_COUNT];
+      else if (prng_rand (prng) % 20 == 0)
+	as = 4200000000U + prng_rand (prng) % 1000;
+      else if (prng_rand (prng) % 10 == 0)
+	as = 64512 + prng_rand (prng) % 1023;
+      else
+	as = 1 + prng_rand (prng) % 60000;
+
+      /* Some prepending. */
+      n = (prng_rand (prng) % 8 == 0) ? 1 + prng_rand (prng) % 3 : 1;
+      while (n--)
+	len += snprintf (buf + len, sizeof (buf) - len, "%s%u",
+			 len ? " " : "", as);
+    }
+
+  /* The odd aggregate. */
+  if (prng_rand (prng) % 100 == 0)
+    len += snprintf (buf + len, sizeof (buf) - len, " {%u,%u}",
+		     1 + prng_rand (prng) % 60000,
+		     1 + prng_rand (prng) % 60000);
+
+  return aspath_intern (aspath_str2aspath (buf));
+}
+
+static unsigned long
+bench_usec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start);
+}
+
+int
+main (void)
+{
+  struct prng *prng;
+  struct aspath **paths;
+  struct aspath **routes;
+  struct timeval start;
+  unsigned long posix_usec, compiled_usec, warm_usec;
+  int i, r, matches, failed = 0;
+
+  master = thread_master_create ();
+  bgp_master_init ();
+  aspath_init ();
+
+  prng = prng_new (0);
+
+  paths = XCALLOC (MTYPE_TMP, BENCH_PATHS * sizeof (struct aspath *));
+  for (i = 0; i < BENCH_PATHS; i++)
+    paths[i] = bench_path (prng);
+  paths[0] = aspath_empty ();
+
+  routes = XCALLOC (MTYPE_TMP, BENCH_ROUTES * sizeof (struct aspath *));
+  for (i = 0; i < BENCH_ROUTES; i++)
+    routes[i] = paths[prng_rand (prng) % BENCH_PATHS];
+
+  printf ("%d paths, %d routes\n", BENCH_PATHS, BENCH_ROUTES);
+
+  for (r = 0; regexes[r]; r++)
+    {
+      regex_t *posix;
+      struct bgp_aspath_regex *compiled;
+
+      posix = bgp_regcomp (regexes[r]);
+      compiled = bgp_aspath_regcomp (regexes[r]);
+      if (! posix || ! compiled)
+	{
+	  printf ("%s: failed to compile\n", regexes[r]);
+	  return 1;
+	}
+
+      for (i = 0; i < BENCH_PATHS; i++)
+	if ((bgp_regexec (posix, paths[i]) == REG_NOMATCH)
+	    != (bgp_aspath_regexec (compiled, paths[i]) == REG_NOMATCH))
+	  {
+	    printf ("%s: mismatch on \"%s\"\n", regexes[r], aspath_print (paths[i]));
+	    failed++;
+	    break;
+	  }
+
+      /* Forget the memoised results of the check above. */
+      bgp_aspath_regex_free (compiled);
+      compiled = bgp_aspath_regcomp (regexes[r]);
+
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+      for (i = 0; i < BENCH_ROUTES; i++)
+	bgp_regexec (posix, routes[i]);
+      posix_usec = bench_usec (&start);
+
+      matches = 0;
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+      for (i = 0; i < BENCH_ROUTES; i++)
+	if (bgp_aspath_regexec (compiled, routes[i]) != REG_NOMATCH)
+	  matches++;
+      compiled_usec = bench_usec (&start);
+
+      /* Again, now that every path remembers its result. */
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+      for (i = 0; i < BENCH_ROUTES; i++)
+	bgp_aspath_regexec (compiled, routes[i]);
+      warm_usec = bench_usec (&start);
+
+      printf ("%-42s %6d matches, posix %4lu ms, compiled %3lu ms, "
+	      "warm %2lu ms\n", regexes[r], matches, posix_usec / 1000,
+	      compiled_usec / 1000, warm_usec / 1000);
+
+      bgp_regex_free (posix);
+      bgp_aspath_regex_free (compiled);
+    }
+
+  prng_free (prng);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,670 @@
+/*
+ * BGP RPKI origin validation test
+ *
+ * Checks validation against the ROA index for the cases of RFC 6811,
+ * and times validating a full table's worth of prefixes against a large
+ * number of ROAs.  Then runs the RTR client against a small RTR cache
+ * served from this process: a full load, an incremental update the
+ * cache announces with a Serial Notify, and a Cache Reset, checking the
+ * routes of a table are revalidated only where their ROAs changed.
+ * A truncated Error Report from the cache must drop the session.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "memory.h"
+#include "thread.h"
+#include "filter.h"
+#include "linklist.h"
+#include "zclient.h"
+#include "log.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_nexthop.h"
+#include "bgpd/bgp_rpki.h"
+
+#include "prng.h"
+
+#define BENCH_ROAS	 100000
+#define BENCH_LOOKUPS	1000000
+
+/* Routes 10.a.b.0/24 from AS 65000 + a, the cache has 10.a.0.0/16 for
+   each a. */
+#define TEST_ORIGINS	10
+#define TEST_ROUTES	100
+#define TEST_ROAS_MAX	32
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+struct zclient *zclient;
+
+static struct bgp *bgp;
+static as_t asn = 100;
+
+static unsigned long
+bench_msec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start) / 1000;
+}
+
+static void
+test_prefix (struct prefix *p, const char *str)
+{
+  if (! str2prefix (str, p))
+    abort ();
+}
+
+/* RFC 6811 cases. */
+static int
+test_validate (void)
+{
+  static const struct
+  {
+    const char *prefix;
+    as_t origin;
+    int state;
+  } cases[] =
+  {
+    { "192.0.2.0/24",	64496, BGP_RPKI_VALID },
+    { "192.0.2.128/25",	64496, BGP_RPKI_VALID },
+    { "192.0.2.128/26",	64496, BGP_RPKI_INVALID },	/* too long */
+    { "192.0.2.0/24",	64497, BGP_RPKI_INVALID },	/* wrong origin */
+    { "192.0.2.0/24",	0,     BGP_RPKI_INVALID },	/* ends in a set */
+    { "192.0.0.0/16",	64496, BGP_RPKI_NOTFOUND },	/* not covered */
+    { "198.51.100.0/24", 64496, BGP_RPKI_NOTFOUND },
+    { "203.0.113.0/24",	64498, BGP_RPKI_VALID },	/* second ROA */
+    { "203.0.113.0/24",	64499, BGP_RPKI_INVALID },	/* AS 0 ROA only */
+    { "2001:db8::/32",	64496, BGP_RPKI_VALID },
+    { "2001:db8:1::/48", 64496, BGP_RPKI_INVALID },
+  };
+  struct prefix p;
+  struct attr attr;
+  unsigned int i;
+  int failed = 0;
+
+  test_prefix (&p, "192.0.2.0/24");
+  bgp_rpki_roa_add (&p, 25, 64496);
+  test_prefix (&p, "203.0.113.0/24");
+  bgp_rpki_roa_add (&p, 24, 0);
+  test_prefix (&p, "203.0.112.0/23");
+  bgp_rpki_roa_add (&p, 24, 64498);
+  test_prefix (&p, "2001:db8::/32");
+  bgp_rpki_roa_add (&p, 32, 64496);
+
+  if (bgp_rpki_roa_add (&p, 32, 64496) == 0)
+    {
+      printf ("expected a duplicate ROA to be refused\n");
+      failed++;
+    }
+
+  for (i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+      int state;
+
+      test_prefix (&p, cases[i].prefix);
+      if ((state = bgp_rpki_validate (&p, cases[i].origin)) != cases[i].state)
+	{
+	  printf ("%s from AS%u: %s, expected %s\n", cases[i].prefix,
+		  cases[i].origin, bgp_rpki_state_str (state),
+		  bgp_rpki_state_str (cases[i].state));
+	  failed++;
+	}
+    }
+
+  /* The origin is taken from the path, our own AS for an empty one. */
+  memset (&attr, 0, sizeof (attr));
+  test_prefix (&p, "192.0.2.0/24");
+  attr.aspath = aspath_str2aspath ("64500 64496");
+  if (bgp_rpki_validate_route (&p, &attr, bgp) != BGP_RPKI_VALID)
+    failed++;
+  aspath_free (attr.aspath);
+  attr.aspath = aspath_str2aspath ("64500 {64496,64501}");
+  if (bgp_rpki_validate_route (&p, &attr, bgp) != BGP_RPKI_INVALID)
+    failed++;
+  aspath_free (attr.aspath);
+  attr.aspath = aspath_str2aspath ("");
+  if (bgp_rpki_validate_route (&p, &attr, bgp) != BGP_RPKI_INVALID)
+    failed++;
+  aspath_free (attr.aspath);
+
+  test_prefix (&p, "192.0.2.0/24");
+  bgp_rpki_roa_delete (&p, 25, 64496);
+  test_prefix (&p, "203.0.113.0/24");
+  bgp_rpki_roa_delete (&p, 24, 0);
+  test_prefix (&p, "203.0.112.0/23");
+  bgp_rpki_roa_delete (&p, 24, 64498);
+  test_prefix (&p, "2001:db8::/32");
+  bgp_rpki_roa_delete (&p, 32, 64496);
+
+  if (bgp_rpki_roa_delete (&p, 32, 64496) == 0)
+    {
+      printf ("expected withdrawing an unknown ROA to fail\n");
+      failed++;
+    }
+  bgp_rpki_revalidate ();
+
+  if (bgp_rpki_roa_count () || mtype_stats_alloc (MTYPE_BGP_RPKI_ROA))
+    {
+      printf ("expected the ROAs to be gone\n");
+      failed++;
+    }
+  return failed;
+}
+
+static void
+bench_roa (struct prng *prng, struct prefix *p, u_char *maxlen, as_t *origin)
+{
+  memset (p, 0, sizeof (struct prefix));
+  p->family = AF_INET;
+  p->prefixlen = 16 + prng_rand (prng) % 9;
+  p->u.prefix4.s_addr = htonl (prng_rand (prng));
+  apply_mask (p);
+  *maxlen = p->prefixlen + prng_rand (prng) % (25 - p->prefixlen);
+  *origin = 1 + prng_rand (prng) % 1000;
+}
+
+static int
+bench_validate (void)
+{
+  struct prng *prng;
+  struct prefix p;
+  struct timeval start;
+  unsigned long msec, roas = 0;
+  unsigned long count[BGP_RPKI_INVALID + 1] = { 0 };
+  u_char maxlen;
+  as_t origin;
+  int i, failed = 0;
+
+  prng = prng_new (0);
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < BENCH_ROAS; i++)
+    {
+      bench_roa (prng, &p, &maxlen, &origin);
+      if (bgp_rpki_roa_add (&p, maxlen, origin) == 0)
+	roas++;
+    }
+  msec = bench_msec (&start);
+  printf ("load %lu ROAs: %lu ms, %lu ROA sets\n", roas, msec,
+	  mtype_stats_alloc (MTYPE_BGP_RPKI_ROA));
+
+  if (bgp_rpki_roa_count () != roas)
+    {
+      printf ("expected %lu ROAs, have %lu\n", roas, bgp_rpki_roa_count ());
+      failed++;
+    }
+
+  memset (&p, 0, sizeof (p));
+  p.family = AF_INET;
+  p.prefixlen = 24;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < BENCH_LOOKUPS; i++)
+    {
+      p.u.prefix4.s_addr = htonl (prng_rand (prng) & 0xffffff00);
+      count[bgp_rpki_validate (&p, 1 + i % 1000)]++;
+    }
+  msec = bench_msec (&start);
+  printf ("validate %d /24s: %lu ms, %lu valid, %lu invalid, %lu not found\n",
+	  BENCH_LOOKUPS, msec, count[BGP_RPKI_VALID], count[BGP_RPKI_INVALID],
+	  count[BGP_RPKI_NOTFOUND]);
+
+  if (count[BGP_RPKI_NOT_BEING_USED])
+    failed++;
+
+  /* Withdraw them all again, the same sequence gives the same ROAs. */
+  prng_free (prng);
+  prng = prng_new (0);
+  for (i = 0; i < BENCH_ROAS; i++)
+    {
+      bench_roa (prng, &p, &maxlen, &origin);
+      bgp_rpki_roa_delete (&p, maxlen, origin);
+    }
+  bgp_rpki_revalidate ();
+
+  if (bgp_rpki_roa_count () || mtype_stats_alloc (MTYPE_BGP_RPKI_ROA))
+    {
+      printf ("expected the ROAs to be gone\n");
+      failed++;
+    }
+
+  prng_free (prng);
+  return failed;
+}
+
+/* The RTR cache stand-in.  It serves one client, version 1 only, and
+   remembers the changes of its last serial so it can answer a Serial
+   Query for the one before. */
+struct test_roa
+{
+  struct prefix p;
+  u_char maxlen;
+  as_t asn;
+  int present;
+};
+
+static struct
+{
+  int listen_fd;
+  int fd;
+  u_int16_t port;
+  u_int16_t session;
+  u_int32_t serial;
+
+  struct test_roa roas[TEST_ROAS_MAX];
+  int count;
+
+  /* Changes from serial - 1 to serial, by ROA index, 1 announce. */
+  int delta[TEST_ROAS_MAX];
+  int delta_count;
+
+  /* Answer the next Serial Query with a Cache Reset. */
+  int reset_next;
+
+  /* Error Reports from the client, and the code of the last. */
+  int errors;
+  u_int16_t error_code;
+
+  struct stream *s;
+  struct thread *t_read;
+} server;
+
+static void
+server_header (u_char type, u_int16_t session, u_int32_t length)
+{
+  stream_putc (server.s, RTR_PROTOCOL_VERSION_1);
+  stream_putc (server.s, type);
+  stream_putw (server.s, session);
+  stream_putl (server.s, length);
+}
+
+static void
+server_prefix (struct test_roa *roa, int announce)
+{
+  int v4 = roa->p.family == AF_INET;
+
+  server_header (v4 ? RTR_IPV4_PREFIX : RTR_IPV6_PREFIX, 0,
+		 v4 ? RTR_IPV4_PREFIX_SIZE : RTR_IPV6_PREFIX_SIZE);
+  stream_putc (server.s, announce ? RTR_FLAG_ANNOUNCE : 0);
+  stream_putc (server.s, roa->p.prefixlen);
+  stream_putc (server.s, roa->maxlen);
+  stream_putc (server.s, 0);
+  stream_put (server.s, &roa->p.u.prefix, v4 ? 4 : 16);
+  stream_putl (server.s, roa->asn);
+}
+
+static void
+server_send (void)
+{
+  size_t done = 0, length = stream_get_endp (server.s);
+  ssize_t n;
+
+  while (done < length)
+    {
+      if ((n = write (server.fd, STREAM_DATA (server.s) + done,
+		      length - done)) <= 0)
+	abort ();
+      done += n;
+    }
+  stream_reset (server.s);
+}
+
+static void
+server_response (int full)
+{
+  int i;
+
+  server_header (RTR_CACHE_RESPONSE, server.session, RTR_HEADER_SIZE);
+  if (full)
+    {
+      for (i = 0; i < server.count; i++)
+	if (server.roas[i].present)
+	  server_prefix (&server.roas[i], 1);
+    }
+  else
+    for (i = 0; i < server.delta_count; i++)
+      server_prefix (&server.roas[server.delta[i]],
+		     server.roas[server.delta[i]].present);
+
+  server_header (RTR_END_OF_DATA, server.session, RTR_END_OF_DATA_V1_SIZE);
+  stream_putl (server.s, server.serial);
+  stream_putl (server.s, 3600);
+  stream_putl (server.s, 600);
+  stream_putl (server.s, 7200);
+  server_send ();
+}
+
+static int
+server_read (struct thread *thread)
+{
+  u_char buf[64];
+  ssize_t n;
+
+  server.t_read = NULL;
+  if ((n = read (server.fd, buf, sizeof (buf))) < RTR_HEADER_SIZE)
+    {
+      close (server.fd);
+      server.fd = -1;
+      return 0;
+    }
+
+  switch (buf[1])
+    {
+    case RTR_RESET_QUERY:
+      server_response (1);
+      break;
+    case RTR_SERIAL_QUERY:
+      {
+	u_int32_t serial = (buf[8] << 24) | (buf[9] << 16) | (buf[10] << 8)
+			   | buf[11];
+
+	if (server.reset_next || serial != server.serial - 1)
+	  {
+	    server.reset_next = 0;
+	    server_header (RTR_CACHE_RESET, 0, RTR_HEADER_SIZE);
+	    server_send ();
+	  }
+	else
+	  server_response (0);
+      }
+      break;
+    case RTR_ERROR_REPORT:
+      server.errors++;
+      server.error_code = (buf[2] << 8) | buf[3];
+      break;
+    }
+
+  server.t_read = thread_add_read (bm->master, server_read, NULL, server.fd);
+  return 0;
+}
+
+static int
+server_accept (struct thread *thread)
+{
+  server.fd = accept (server.listen_fd, NULL, NULL);
+  if (server.fd < 0)
+    abort ();
+  server.t_read = thread_add_read (bm->master, server_read, NULL, server.fd);
+  return 0;
+}
+
+static void
+server_start (void)
+{
+  struct sockaddr_in sin;
+  socklen_t len = sizeof (sin);
+
+  memset (&sin, 0, sizeof (sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+  server.listen_fd = socket (AF_INET, SOCK_STREAM, 0);
+  if (server.listen_fd < 0
+      || bind (server.listen_fd, (struct sockaddr *) &sin, sizeof (sin)) < 0
+      || listen (server.listen_fd, 1) < 0
+      || getsockname (server.listen_fd, (struct sockaddr *) &sin, &len) < 0)
+    abort ();
+
+  server.port = ntohs (sin.sin_port);
+  server.fd = -1;
+  server.session = 4711;
+  server.s = stream_new (RTR_PDU_MAX * 16);
+  thread_add_read (bm->master, server_accept, NULL, server.listen_fd);
+}
+
+/* Change a ROA of the cache, as part of the next serial. */
+static void
+server_roa (const char *prefix, u_char maxlen, as_t asn, int present)
+{
+  struct prefix p;
+  int i;
+
+  test_prefix (&p, prefix);
+  for (i = 0; i < server.count; i++)
+    if (prefix_same (&server.roas[i].p, &p) && server.roas[i].maxlen == maxlen
+	&& server.roas[i].asn == asn)
+      break;
+
+  if (i == server.count)
+    {
+      server.roas[server.count].p = p;
+      server.roas[server.count].maxlen = maxlen;
+      server.roas[server.count].asn = asn;
+      server.count++;
+    }
+  server.roas[i].present = present;
+  server.delta[server.delta_count++] = i;
+}
+
+static void
+server_notify (void)
+{
+  server_header (RTR_SERIAL_NOTIFY, server.session, RTR_SERIAL_NOTIFY_SIZE);
+  stream_putl (server.s, server.serial);
+  server_send ();
+}
+
+/* Run the client, and the cache, until the client has the serial. */
+static int
+test_sync (u_int32_t serial)
+{
+  struct thread thread;
+  u_int32_t have;
+
+  while (bgp_rpki_cache_serial (&have) < 0 || have != serial)
+    if (thread_fetch (bm->master, &thread))
+      thread_call (&thread);
+    else
+      return 1;
+  return 0;
+}
+
+/* How many of the test routes are in state. */
+static int
+test_count (int state)
+{
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  int count = 0;
+
+  for (rn = bgp_table_top (bgp->rib[AFI_IP][SAFI_UNICAST]); rn;
+       rn = bgp_route_next (rn))
+    for (ri = rn->info; ri; ri = ri->next)
+      if (ri->rpki_state == state)
+	count++;
+  return count;
+}
+
+static int
+test_rtr (void)
+{
+  struct peer *peer;
+  struct attr attr;
+  struct prefix p;
+  struct thread thread;
+  char buf[64];
+  unsigned long before;
+  int a, b, failed = 0;
+
+  peer = peer_create_accept (bgp);
+  peer->host = XSTRDUP (MTYPE_BGP_PEER_HOST, "feed");
+  peer->as = 200;
+  peer->local_as = bgp->as;
+  peer->sort = BGP_PEER_EBGP;
+  peer->status = Established;
+  peer->afc[AFI_IP][SAFI_UNICAST] = 1;
+
+  bgp_attr_default_set (&attr, BGP_ORIGIN_IGP);
+  attr.nexthop.s_addr = htonl (0x0a000001);
+  for (a = 0; a < TEST_ORIGINS; a++)
+    {
+      snprintf (buf, sizeof (buf), "200 %d", 65000 + a);
+      attr.aspath = aspath_intern (aspath_str2aspath (buf));
+      for (b = 0; b < TEST_ROUTES; b++)
+	{
+	  snprintf (buf, sizeof (buf), "10.%d.%d.0/24", a, b);
+	  test_prefix (&p, buf);
+	  bgp_update (peer, &p, &attr, AFI_IP, SAFI_UNICAST, ZEBRA_ROUTE_BGP,
+		      BGP_ROUTE_NORMAL, NULL, NULL, 0);
+	}
+      aspath_unintern (&attr.aspath);
+    }
+
+  if (test_count (BGP_RPKI_NOT_BEING_USED) != TEST_ORIGINS * TEST_ROUTES)
+    {
+      printf ("expected no validation without ROAs\n");
+      failed++;
+    }
+
+  /* Full load. */
+  server_start ();
+  for (a = 0; a < TEST_ORIGINS; a++)
+    {
+      snprintf (buf, sizeof (buf), "10.%d.0.0/16", a);
+      server_roa (buf, 24, 65000 + a, 1);
+    }
+  server_roa ("2001:db8::/32", 48, 64496, 1);
+  server.serial = 1;
+
+  bgp_rpki_cache_set ("127.0.0.1", server.port);
+  if (test_sync (1))
+    return failed + 1;
+
+  printf ("full load: %lu ROAs, %lu routes revalidated, %d valid\n",
+	  bgp_rpki_roa_count (), bgp_rpki_revalidated (),
+	  test_count (BGP_RPKI_VALID));
+  if (bgp_rpki_roa_count () != TEST_ORIGINS + 1
+      || test_count (BGP_RPKI_VALID) != TEST_ORIGINS * TEST_ROUTES)
+    {
+      printf ("expected every route validated by the cache's ROAs\n");
+      failed++;
+    }
+
+  /* 10.3.0.0/16 moves to another AS: only its routes need looking at. */
+  before = bgp_rpki_revalidated ();
+  server.delta_count = 0;
+  server_roa ("10.3.0.0/16", 24, 65003, 0);
+  server_roa ("10.3.0.0/16", 24, 64999, 1);
+  server.serial = 2;
+  server_notify ();
+  if (test_sync (2))
+    return failed + 1;
+
+  printf ("serial update: %lu routes revalidated, %d invalid\n",
+	  bgp_rpki_revalidated () - before, test_count (BGP_RPKI_INVALID));
+  if (bgp_rpki_revalidated () - before != TEST_ROUTES
+      || test_count (BGP_RPKI_INVALID) != TEST_ROUTES)
+    {
+      printf ("expected the routes of 10.3.0.0/16 alone to change\n");
+      failed++;
+    }
+
+  /* After a cache reset the client gets everything again, but only the
+     ROA new to it changes anything, and it covers no route. */
+  before = bgp_rpki_revalidated ();
+  server.delta_count = 0;
+  server_roa ("10.100.0.0/16", 24, 65100, 1);
+  server.serial = 3;
+  server.reset_next = 1;
+  server_notify ();
+  if (test_sync (3))
+    return failed + 1;
+
+  printf ("cache reset: %lu ROAs, %lu routes revalidated\n",
+	  bgp_rpki_roa_count (), bgp_rpki_revalidated () - before);
+  if (bgp_rpki_roa_count () != TEST_ORIGINS + 2
+      || bgp_rpki_revalidated () != before
+      || test_count (BGP_RPKI_VALID) != (TEST_ORIGINS - 1) * TEST_ROUTES)
+    {
+      printf ("expected a reset to leave the routes alone\n");
+      failed++;
+    }
+
+  /* An Error Report too short for its own lengths is answered with one
+     of ours and the session dropped, rather than read past. */
+  server_header (RTR_ERROR_REPORT, RTR_ERROR_INTERNAL, RTR_HEADER_SIZE + 4);
+  stream_putl (server.s, 0);
+  server_send ();
+  while (server.fd >= 0 && thread_fetch (bm->master, &thread))
+    thread_call (&thread);
+
+  if (server.errors != 1 || server.error_code != RTR_ERROR_CORRUPT_DATA)
+    {
+      printf ("expected a truncated error report to be refused\n");
+      failed++;
+    }
+
+  /* Without the cache the ROAs go. */
+  bgp_rpki_cache_unset ();
+  if (bgp_rpki_roa_count ()
+      || test_count (BGP_RPKI_NOT_BEING_USED) != TEST_ORIGINS * TEST_ROUTES)
+    {
+      printf ("expected validation to stop with the cache gone\n");
+      failed++;
+    }
+
+  bgp_attr_extra_free (&attr);
+  return failed;
+}
+
+int
+main (void)
+{
+  int failed = 0;
+
+  /* Should the client and cache not get along, don't hang. */
+  alarm (60);
+
+  /* What the client says of the cache, not the debugging of the
+     nexthops it has no zebra to register with. */
+  zlog_default = openzlog ("testbgprpki", ZLOG_BGP,
+			   LOG_CONS|LOG_NDELAY|LOG_PID, LOG_DAEMON);
+  zlog_set_level (NULL, ZLOG_DEST_SYSLOG, ZLOG_DISABLED);
+  zlog_set_level (NULL, ZLOG_DEST_STDOUT, LOG_INFO);
+
+  master = thread_master_create ();
+  zclient = zclient_new (master);
+  /* The cache is all we connect to. */
+  zclient->sock = -1;
+  bgp_master_init ();
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_attr_init ();
+  bgp_address_init ();
+  bgp_scan_init ();
+
+  if (bgp_get (&bgp, &asn, NULL))
+    return -1;
+
+  failed += test_validate ();
+  failed += bench_validate ();
+  failed += test_rtr ();
+
+  printf ("%s\n", failed ? "failed" : "OK");
+  return failed ? 1 : 0;
+}
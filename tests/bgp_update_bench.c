@@ -0,0 +1,230 @@
+/*
+ * BGP UPDATE generation benchmark
+ *
+ * Queues a full table to a number of eBGP peers sharing one outbound
+ * encoding and measures how fast bgp_write drains the advertisement
+ * FIFOs into UPDATE messages, then churns part of the table to show
+ * withdraws and announcements sharing messages.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "memory.h"
+#include "thread.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_fsm.h"
+
+#include "prng.h"
+
+#define BENCH_PREFIXES 800000
+#define BENCH_ATTRS     40000
+#define BENCH_PEERS         4
+#define BENCH_CHURN     50000
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+
+static struct bgp *bgp;
+static as_t asn = 100;
+
+static struct peer *
+bench_peer (as_t as, const char *host)
+{
+  struct peer *peer;
+
+  peer = peer_create_accept (bgp);
+  peer->host = XSTRDUP (MTYPE_BGP_PEER_HOST, host);
+  peer->as = as;
+  peer->local_as = bgp->as;
+  peer->sort = BGP_PEER_EBGP;
+  peer->status = Established;
+  peer->synctime = bgp_clock () + 1;
+  peer->afc_nego[AFI_IP][SAFI_UNICAST] = 1;
+  SET_FLAG (peer->cap, PEER_CAP_AS4_RCV);
+  SET_FLAG (peer->af_flags[AFI_IP][SAFI_UNICAST], PEER_FLAG_SEND_COMMUNITY);
+  return peer;
+}
+
+/* Run the thread loop until PEER has nothing left to write. */
+static void
+bench_drain (struct peer *peer)
+{
+  struct thread thread;
+
+  BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+  while (peer->t_write && thread_fetch (bm->master, &thread))
+    thread_call (&thread);
+}
+
+static unsigned long
+bench_msec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start) / 1000;
+}
+
+int
+main (void)
+{
+  struct prng *prng;
+  struct attr **attrs;
+  struct bgp_node **rns;
+  struct peer *from;
+  struct peer *peers[BENCH_PEERS];
+  struct timeval start;
+  unsigned long hit, miss, bytes;
+  unsigned long msec;
+  u_int32_t updates;
+  char buf[64];
+  int i, j;
+
+  master = thread_master_create ();
+  bgp_master_init ();
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_attr_init ();
+
+  if (bgp_get (&bgp, &asn, NULL))
+    return -1;
+
+  prng = prng_new (0);
+
+  /* A spread of realistic looking paths, roughly 20 prefixes each. */
+  attrs = XCALLOC (MTYPE_TMP, BENCH_ATTRS * sizeof (struct attr *));
+  for (i = 0; i < BENCH_ATTRS; i++)
+    {
+      struct attr attr;
+
+      memset (&attr, 0, sizeof (attr));
+      bgp_attr_default_set (&attr, BGP_ORIGIN_IGP);
+      snprintf (buf, sizeof (buf), "200 %u %u %u",
+                1 + prng_rand (prng) % 4000, 1 + prng_rand (prng) % 60000,
+                1 + prng_rand (prng) % 400000);
+      aspath_free (attr.aspath);
+      attr.aspath = aspath_str2aspath (buf);
+      attr.nexthop.s_addr = htonl (0x0a000001);
+      attr.med = prng_rand (prng) % 4;
+      attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_NEXT_HOP)
+                   | ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC);
+      attrs[i] = bgp_attr_intern (&attr);
+      bgp_attr_extra_free (&attr);
+    }
+
+  from = bench_peer (200, "source");
+
+  rns = XCALLOC (MTYPE_TMP, BENCH_PREFIXES * sizeof (struct bgp_node *));
+  for (i = 0; i < BENCH_PREFIXES; i++)
+    {
+      struct prefix p;
+      struct bgp_info *ri;
+
+      memset (&p, 0, sizeof (p));
+      p.family = AF_INET;
+      p.prefixlen = 24;
+      p.u.prefix4.s_addr = htonl ((1 << 24) + (i << 8));
+      rns[i] = bgp_node_get (bgp->rib[AFI_IP][SAFI_UNICAST], &p);
+
+      ri = XCALLOC (MTYPE_BGP_ROUTE, sizeof (struct bgp_info));
+      ri->peer = from;
+      ri->attr = bgp_attr_intern (attrs[(i / 20) % BENCH_ATTRS]);
+      ri->type = ZEBRA_ROUTE_BGP;
+      ri->uptime = 0;
+      bgp_info_add (rns[i], ri);
+    }
+
+  for (j = 0; j < BENCH_PEERS; j++)
+    {
+      snprintf (buf, sizeof (buf), "peer%d", j);
+      peers[j] = bench_peer (300 + j, buf);
+      peers[j]->fd = open ("/dev/null", O_WRONLY);
+      if (peers[j]->fd < 0)
+        return -1;
+
+      for (i = 0; i < BENCH_PREFIXES; i++)
+        {
+          struct bgp_info *ri = rns[i]->info;
+
+          bgp_adj_out_set (rns[i], peers[j], &rns[i]->p, ri->attr,
+                           AFI_IP, SAFI_UNICAST, ri);
+        }
+    }
+
+  printf ("%d prefixes, %d attributes, %d peers\n",
+          BENCH_PREFIXES, BENCH_ATTRS, BENCH_PEERS);
+
+  for (j = 0; j < BENCH_PEERS; j++)
+    {
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+      bench_drain (peers[j]);
+      msec = bench_msec (&start);
+
+      attr_encode_stats (&hit, &miss, &bytes);
+      printf ("%s: %u UPDATEs in %lu.%03lu s, %lu prefixes/s "
+              "(encodings: %lu hits, %lu misses)\n",
+              peers[j]->host, peers[j]->update_out,
+              msec / 1000, msec % 1000,
+              msec ? BENCH_PREFIXES * 1000UL / msec : 0, hit, miss);
+    }
+
+  /* Withdraw some routes and move others to a new path, the withdraws
+   * should ride along in the UPDATEs carrying the announcements.
+   */
+  updates = peers[0]->update_out;
+  for (i = 0; i < BENCH_CHURN; i++)
+    {
+      struct bgp_node *rn = rns[i * 2];
+      struct bgp_info *ri = rns[i * 2 + 1]->info;
+
+      bgp_adj_out_unset (rn, peers[0], &rn->p, AFI_IP, SAFI_UNICAST);
+      bgp_adj_out_set (rns[i * 2 + 1], peers[0], &rns[i * 2 + 1]->p,
+                       attrs[(i + 1) % BENCH_ATTRS], AFI_IP, SAFI_UNICAST, ri);
+    }
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  bench_drain (peers[0]);
+  msec = bench_msec (&start);
+  printf ("churn: %d withdraws and %d updates in %u UPDATEs, %lu.%03lu s\n",
+          BENCH_CHURN, BENCH_CHURN, peers[0]->update_out - updates,
+          msec / 1000, msec % 1000);
+
+  for (j = 0; j < BENCH_PEERS; j++)
+    if (peers[j]->scount[AFI_IP][SAFI_UNICAST]
+        != (j ? BENCH_PREFIXES : BENCH_PREFIXES - BENCH_CHURN))
+      {
+        printf ("%s: unexpected prefix count %lu\n", peers[j]->host,
+                peers[j]->scount[AFI_IP][SAFI_UNICAST]);
+        return 1;
+      }
+
+  prng_free (prng);
+  return 0;
+}
@@ -0,0 +1,501 @@
+/*
+ * OSPF incremental AS-external route calculation test
+ *
+ * Gives two instances the same AS-external-LSAs from many ASBRs, some
+ * with forwarding addresses, then changes the routes to the ASBRs and
+ * forwarding addresses, the internal routes overriding externals and
+ * the LSAs themselves, a few at a time.  After each change the external
+ * routes one instance calculates incrementally must be those the other
+ * calculates from scratch.  Then times both with 100000 externals.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "memory.h"
+#include "linklist.h"
+#include "prefix.h"
+#include "table.h"
+#include "if.h"
+#include "privs.h"
+#include "zclient.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_spf.h"
+#include "ospfd/ospf_route.h"
+#include "ospfd/ospf_ase.h"
+
+#include "prng.h"
+
+#define TEST_LSAS	5000
+#define TEST_ASBRS	40
+#define TEST_ROUNDS	300
+#define BENCH_LSAS	100000
+#define BENCH_ASBRS	50
+#define BENCH_ROUNDS	20
+
+#define TEST_LSAS_MAX	BENCH_LSAS
+#define TEST_ASBRS_MAX	BENCH_ASBRS
+
+/* Networks holding the forwarding addresses, and destinations of
+   externals an internal route may override. */
+#define TEST_NETS	20
+#define TEST_OVERRIDES	20
+
+/* need these to link in libospf */
+struct zebra_privs_t ospfd_privs;
+struct thread_master *master = NULL;
+
+/* A route goes through one or both of two nexthops, as bits 0 and 1 of
+   nexthops. */
+struct test_route
+{
+  u_char present;
+  u_char external;
+  u_char nexthops;
+  u_int16_t cost;
+};
+
+static struct test_route asbrs[TEST_ASBRS_MAX];
+static struct test_route nets[TEST_NETS];
+static struct test_route overrides[TEST_OVERRIDES];
+static struct ospf_lsa *lsas[TEST_LSAS_MAX];
+static int lsas_count, asbrs_count;
+
+/* Two routes per destination, mostly. */
+#define TEST_DESTS	(lsas_count / 2)
+
+static struct ospf *instances[2];
+
+static struct prng *prng;
+
+static unsigned long
+bench_usec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start);
+}
+
+static struct in_addr
+asbr_id (int a)
+{
+  struct in_addr id;
+
+  id.s_addr = htonl (0x0a000001 + a);
+  return id;
+}
+
+static struct in_addr
+net_addr (int n, int host)
+{
+  struct in_addr addr;
+
+  addr.s_addr = htonl (0xac100000 | (n << 8) | host);
+  return addr;
+}
+
+static struct in_addr
+dest_addr (int d)
+{
+  struct in_addr addr;
+
+  addr.s_addr = htonl (0x40000000 | (d << 8));
+  return addr;
+}
+
+static void
+test_route_random (struct test_route *route)
+{
+  route->present = prng_rand (prng) % 8 != 0;
+  route->external = prng_rand (prng) % 8 != 0;
+  route->nexthops = 1 + prng_rand (prng) % 3;
+  route->cost = 1 + prng_rand (prng) % 20;
+}
+
+static struct ospf_route *
+test_route_new (u_char type, struct test_route *route)
+{
+  struct ospf_route *or;
+  struct ospf_path *path;
+  int k;
+
+  or = ospf_route_new ();
+  or->type = type;
+  or->path_type = OSPF_PATH_INTRA_AREA;
+  or->cost = route->cost;
+  if (route->external)
+    SET_FLAG (or->u.std.flags, ROUTER_LSA_EXTERNAL);
+
+  for (k = 0; k < 2; k++)
+    if (route->nexthops & (1 << k))
+      {
+	path = ospf_path_new ();
+	path->nexthop.s_addr = htonl (0xc0000201 + k);
+	path->ifindex = k + 1;
+	listnode_add (or->paths, path);
+      }
+  return or;
+}
+
+static void
+test_table_add (struct route_table *table, struct in_addr addr, int len,
+		void *info)
+{
+  struct prefix_ipv4 p;
+  struct route_node *rn;
+
+  p.family = AF_INET;
+  p.prefix = addr;
+  p.prefixlen = len;
+  rn = route_node_get (table, (struct prefix *) &p);
+  assert (rn->info == NULL);
+  rn->info = info;
+}
+
+/* What SPF would leave, installed as ospf_spf_calculate_timer() does. */
+static void
+test_spf (struct ospf *ospf)
+{
+  struct route_table *table, *rtrs;
+  struct list *list;
+  int i;
+
+  table = route_table_init ();
+  rtrs = route_table_init ();
+
+  for (i = 0; i < asbrs_count; i++)
+    if (asbrs[i].present)
+      {
+	list = list_new ();
+	listnode_add (list, test_route_new (OSPF_DESTINATION_ROUTER,
+					    &asbrs[i]));
+	test_table_add (rtrs, asbr_id (i), IPV4_MAX_BITLEN, list);
+      }
+  for (i = 0; i < TEST_NETS; i++)
+    if (nets[i].present)
+      test_table_add (table, net_addr (i, 0), 24,
+		      test_route_new (OSPF_DESTINATION_NETWORK, &nets[i]));
+  for (i = 0; i < TEST_OVERRIDES; i++)
+    if (overrides[i].present)
+      test_table_add (table, dest_addr (i * 97 % TEST_DESTS), 24,
+		      test_route_new (OSPF_DESTINATION_NETWORK,
+				      &overrides[i]));
+
+  ospf_route_install (ospf, table);
+  if (ospf->old_rtrs)
+    ospf_rtrs_free (ospf->old_rtrs);
+  ospf->old_rtrs = ospf->new_rtrs;
+  ospf->new_rtrs = rtrs;
+}
+
+/* A type-1 or type-2 external to destination i / 2, from an ASBR, one
+   in eight through a forwarding address. */
+static struct ospf_lsa *
+test_lsa_new (int i, int maxage)
+{
+  struct ospf_lsa *lsa;
+  struct as_external_lsa *al;
+  u_int32_t metric;
+  int a = i * 7 % asbrs_count;
+
+  lsa = ospf_lsa_new ();
+  lsa->data = ospf_lsa_data_new (OSPF_LSA_HEADER_SIZE + 16);
+  al = (struct as_external_lsa *) lsa->data;
+  al->header.type = OSPF_AS_EXTERNAL_LSA;
+  al->header.length = htons (OSPF_LSA_HEADER_SIZE + 16);
+  al->header.ls_age = htons (maxage ? OSPF_LSA_MAXAGE : 0);
+  al->header.id = dest_addr ((i / 2) % TEST_DESTS);
+  al->header.adv_router = asbr_id (a);
+  al->mask.s_addr = htonl (0xffffff00);
+  al->e[0].tos = (a % 4 == 0) ? 0x80 : 0;
+  metric = 1 + prng_rand (prng) % 30;
+  al->e[0].metric[0] = (metric >> 16) & 0xff;
+  al->e[0].metric[1] = (metric >> 8) & 0xff;
+  al->e[0].metric[2] = metric & 0xff;
+  if (i % 8 == 3)
+    al->e[0].fwd_addr = net_addr (i % TEST_NETS, 10 + i % 200);
+  al->e[0].route_tag = htonl (i % 5);
+
+  return lsa;
+}
+
+/* As ospf_lsa_install() does: the LSA replaced goes, then the new one
+   is added and its destination recalculated. */
+static void
+test_lsa_install (struct ospf *ospf, struct ospf_lsa *old,
+		  struct ospf_lsa *new)
+{
+  if (old)
+    ospf_ase_unregister_external_lsa (old, ospf);
+  ospf_lsdb_add (ospf->lsdb, new);
+  ospf_ase_register_external_lsa (new, ospf);
+  ospf_ase_incremental_update (ospf, new);
+}
+
+static void
+test_lsa_replace (int i)
+{
+  struct ospf_lsa *old = lsas[i];
+  int w;
+
+  lsas[i] = test_lsa_new (i, prng_rand (prng) % 4 == 0);
+  for (w = 0; w < 2; w++)
+    test_lsa_install (instances[w], old, lsas[i]);
+  ospf_lsa_discard (old);
+}
+
+static struct ospf *
+test_instance_new (void)
+{
+  struct ospf *ospf;
+
+  ospf = XCALLOC (MTYPE_OSPF_TOP, sizeof (struct ospf));
+  ospf->areas = list_new ();
+  ospf->oiflist = list_new ();
+  ospf->lsdb = ospf_lsdb_new ();
+  ospf->new_external_route = route_table_init ();
+  ospf->old_external_route = route_table_init ();
+  ospf->external_lsas = route_table_init ();
+  ospf->external_asbrs = route_table_init ();
+  ospf->external_fwds = route_table_init ();
+  ospf->external_internal = route_table_init ();
+  return ospf;
+}
+
+static void
+test_instance_free (struct ospf *ospf)
+{
+  struct route_node *rn;
+  struct ospf_lsa *lsa;
+
+  LSDB_LOOP (EXTERNAL_LSDB (ospf), rn, lsa)
+    {
+      ospf_ase_unregister_external_lsa (lsa, ospf);
+      ospf_lsdb_delete (ospf->lsdb, lsa);
+    }
+  ospf_lsdb_free (ospf->lsdb);
+
+  ospf_ase_external_deps_finish (ospf);
+  ospf_ase_external_lsas_finish (ospf->external_lsas);
+  ospf_route_table_free (ospf->new_external_route);
+  ospf_route_table_free (ospf->old_external_route);
+  ospf_route_table_free (ospf->new_table);
+  if (ospf->old_table)
+    ospf_route_table_free (ospf->old_table);
+  ospf_rtrs_free (ospf->new_rtrs);
+  if (ospf->old_rtrs)
+    ospf_rtrs_free (ospf->old_rtrs);
+  list_delete (ospf->areas);
+  list_delete (ospf->oiflist);
+  XFREE (MTYPE_OSPF_TOP, ospf);
+}
+
+static int
+test_same_route (struct ospf_route *or1, struct ospf_route *or2)
+{
+  struct listnode *node;
+  struct ospf_path *path;
+
+  if (or1->path_type != or2->path_type
+      || or1->cost != or2->cost
+      || or1->u.ext.tag != or2->u.ext.tag
+      || (or1->path_type == OSPF_PATH_TYPE2_EXTERNAL
+	  && or1->u.ext.type2_cost != or2->u.ext.type2_cost)
+      || listcount (or1->paths) != listcount (or2->paths))
+    return 0;
+
+  /* Equal cost paths may be found in any order. */
+  for (ALL_LIST_ELEMENTS_RO (or1->paths, node, path))
+    if (! ospf_path_lookup (or2->paths, path))
+      return 0;
+  return 1;
+}
+
+static int
+test_compare (struct route_table *t1, struct route_table *t2, int *routes)
+{
+  struct route_node *rn, *rn2;
+  int count1 = 0, count2 = 0;
+  int failed = 0;
+
+  for (rn = route_top (t1); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	count1++;
+	rn2 = route_node_lookup (t2, &rn->p);
+	if (! rn2)
+	  failed++;
+	else
+	  {
+	    if (! test_same_route (rn->info, rn2->info))
+	      failed++;
+	    route_unlock_node (rn2);
+	  }
+      }
+  for (rn = route_top (t2); rn; rn = route_next (rn))
+    if (rn->info)
+      count2++;
+
+  *routes = count1;
+  return failed + (count1 != count2);
+}
+
+/* A few changes to the routes or the LSAs. */
+static void
+test_change (void)
+{
+  int changes = 1 + prng_rand (prng) % 3;
+  int a;
+
+  while (changes--)
+    switch (prng_rand (prng) % 6)
+      {
+      case 0:
+	a = prng_rand (prng) % asbrs_count;
+	asbrs[a].cost = 1 + prng_rand (prng) % 20;
+	break;
+      case 1:
+	a = prng_rand (prng) % asbrs_count;
+	asbrs[a].nexthops = 1 + prng_rand (prng) % 3;
+	break;
+      case 2:
+	a = prng_rand (prng) % asbrs_count;
+	if (prng_rand (prng) % 2)
+	  asbrs[a].present = ! asbrs[a].present;
+	else
+	  asbrs[a].external = ! asbrs[a].external;
+	break;
+      case 3:
+	test_route_random (&nets[prng_rand (prng) % TEST_NETS]);
+	break;
+      case 4:
+	a = prng_rand (prng) % TEST_OVERRIDES;
+	overrides[a].present = ! overrides[a].present;
+	break;
+      case 5:
+	test_lsa_replace (prng_rand (prng) % lsas_count);
+	break;
+      }
+}
+
+static int
+test_run (int count, int asbrs_max, int rounds, int bench)
+{
+  struct timeval start;
+  unsigned long usec[2] = { 0, 0 };
+  int failed = 0;
+  int routes = 0;
+  int i, r, w;
+
+  lsas_count = count;
+  asbrs_count = asbrs_max;
+  for (i = 0; i < asbrs_count; i++)
+    test_route_random (&asbrs[i]);
+  for (i = 0; i < TEST_NETS; i++)
+    test_route_random (&nets[i]);
+  for (i = 0; i < TEST_OVERRIDES; i++)
+    test_route_random (&overrides[i]);
+
+  for (w = 0; w < 2; w++)
+    {
+      instances[w] = test_instance_new ();
+      test_spf (instances[w]);
+    }
+  for (i = 0; i < lsas_count; i++)
+    {
+      lsas[i] = test_lsa_new (i, 0);
+      for (w = 0; w < 2; w++)
+	test_lsa_install (instances[w], NULL, lsas[i]);
+    }
+  for (w = 0; w < 2; w++)
+    ospf_ase_calculate (instances[w], OSPF_ASE_CALC_FULL);
+
+  for (r = 0; r < rounds; r++)
+    {
+      if (bench)
+	{
+	  /* One ASBR's route changes. */
+	  asbrs[r % asbrs_count].cost += 1;
+	}
+      else
+	test_change ();
+
+      for (w = 0; w < 2; w++)
+	{
+	  test_spf (instances[w]);
+	  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+	  ospf_ase_calculate (instances[w], w ? OSPF_ASE_CALC_FULL
+					      : OSPF_ASE_CALC_INCREMENTAL);
+	  usec[w] += bench_usec (&start);
+	}
+
+      if (test_compare (instances[0]->old_external_route,
+			instances[1]->old_external_route, &routes))
+	{
+	  printf ("round %d: external routes differ\n", r);
+	  failed++;
+	}
+    }
+
+  if (bench)
+    printf ("%d externals from %d ASBRs, one ASBR route changing: "
+	    "incremental %lu ms, from scratch %lu ms\n",
+	    lsas_count, asbrs_count, usec[0] / 1000, usec[1] / 1000);
+  else
+    printf ("%d externals from %d ASBRs, %d rounds: %d routes, "
+	    "%d differences\n", lsas_count, asbrs_count, rounds, routes,
+	    failed);
+
+  for (w = 0; w < 2; w++)
+    test_instance_free (instances[w]);
+  for (i = 0; i < lsas_count; i++)
+    ospf_lsa_discard (lsas[i]);
+  return failed;
+}
+
+int
+main (void)
+{
+  struct timeval now;
+  int failed = 0;
+
+  ospf_master_init ();
+  master = om->master;
+  zclient = zclient_new (master);
+  /* External routes calculated are not sent to zebra. */
+  zclient->sock = -1;
+  prng = prng_new (0);
+
+  /* New LSAs are aged from the time last read. */
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+
+  failed += test_run (TEST_LSAS, TEST_ASBRS, TEST_ROUNDS, 0);
+  failed += test_run (BENCH_LSAS, BENCH_ASBRS, BENCH_ROUNDS, 1);
+
+  prng_free (prng);
+
+  printf ("%s\n", failed ? "failed" : "OK");
+  return failed ? 1 : 0;
+}
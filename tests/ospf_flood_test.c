@@ -0,0 +1,320 @@
+/*
+ * OSPF flooding test
+ *
+ * Floods a burst of AS-external-LSAs, as a change of redistribution
+ * originates them, out of broadcast interfaces with full neighbors,
+ * with flood pacing off and on.  Every LSA must go out of every
+ * interface once and be on the retransmission list of every neighbor;
+ * with pacing the LS Updates must be full.  Then times both.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "thread.h"
+#include "memory.h"
+#include "linklist.h"
+#include "prefix.h"
+#include "table.h"
+#include "if.h"
+#include "vrf.h"
+#include "stream.h"
+#include "privs.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_interface.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_neighbor.h"
+#include "ospfd/ospf_nsm.h"
+#include "ospfd/ospf_ism.h"
+#include "ospfd/ospf_packet.h"
+#include "ospfd/ospf_flood.h"
+#include "ospfd/ospf_opaque.h"
+
+#define TEST_LSAS	50000
+#define TEST_IFS	4
+#define TEST_NBRS	2
+#define TEST_MTU	1500
+
+/* need these to link in libospf */
+struct zebra_privs_t ospfd_privs;
+struct thread_master *master = NULL;
+
+static struct ospf_lsa *lsas[TEST_LSAS];
+static struct ospf_interface *ifs[TEST_IFS];
+
+static unsigned long
+bench_usec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start);
+}
+
+/* Stands for the write thread, so that packets stay queued. */
+static int
+test_write (struct thread *thread)
+{
+  return 0;
+}
+
+static struct ospf_lsa *
+test_lsa_new (struct ospf *ospf, int i)
+{
+  struct ospf_lsa *lsa;
+  struct as_external_lsa *al;
+
+  lsa = ospf_lsa_new ();
+  lsa->data = ospf_lsa_data_new (OSPF_LSA_HEADER_SIZE + 16);
+  al = (struct as_external_lsa *) lsa->data;
+  al->header.type = OSPF_AS_EXTERNAL_LSA;
+  al->header.length = htons (OSPF_LSA_HEADER_SIZE + 16);
+  al->header.id.s_addr = htonl (0x40000000 + i * 256);
+  al->header.adv_router = ospf->router_id;
+  al->header.ls_seqnum = htonl (OSPF_INITIAL_SEQUENCE_NUMBER);
+  al->mask.s_addr = htonl (0xffffff00);
+  al->e[0].metric[2] = 20;
+  return lsa;
+}
+
+/* A broadcast interface on which we are DR, with full neighbors. */
+static struct ospf_interface *
+test_if_new (struct ospf *ospf, struct ospf_area *area, int i)
+{
+  struct interface *ifp;
+  struct ospf_interface *oi;
+  struct ospf_neighbor *nbr;
+  struct prefix_ipv4 *p;
+  struct prefix key;
+  char name[INTERFACE_NAMSIZ];
+  int n;
+
+  snprintf (name, sizeof (name), "eth%d", i);
+  ifp = if_get_by_name (name);
+  ifp->ifindex = i + 1;
+  ifp->mtu = TEST_MTU;
+  ifp->flags = IFF_UP | IFF_RUNNING | IFF_BROADCAST | IFF_MULTICAST;
+
+  p = prefix_ipv4_new ();
+  p->family = AF_INET;
+  p->prefix.s_addr = htonl (0xc0a80001 | (i << 8));
+  p->prefixlen = 24;
+
+  oi = ospf_if_new (ospf, ifp, (struct prefix *) p);
+  oi->area = area;
+  oi->type = OSPF_IFTYPE_BROADCAST;
+  oi->state = ISM_DR;
+  listnode_add (area->oiflist, oi);
+  ospf_if_stream_set (oi);
+  oi->nbr_self = ospf_nbr_new (oi);
+  ospf_nbr_add_self (oi);
+
+  for (n = 0; n < TEST_NBRS; n++)
+    {
+      nbr = ospf_nbr_new (oi);
+      nbr->router_id.s_addr = htonl (0x0a000002 + i * TEST_NBRS + n);
+      nbr->src.s_addr = htonl (ntohl (p->prefix.s_addr) + 1 + n);
+      nbr->address.family = AF_INET;
+      nbr->address.prefixlen = IPV4_MAX_BITLEN;
+      nbr->address.u.prefix4 = nbr->src;
+      nbr->state = NSM_Full;
+
+      key.family = AF_INET;
+      key.prefixlen = IPV4_MAX_BITLEN;
+      key.u.prefix4 = nbr->src;
+      route_node_get (oi->nbrs, &key)->info = nbr;
+    }
+  return oi;
+}
+
+static void
+test_if_free (struct ospf_interface *oi)
+{
+  struct interface *ifp = oi->ifp;
+  struct route_node *rn;
+
+  for (rn = route_top (oi->nbrs); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	ospf_nbr_free (rn->info);
+	rn->info = NULL;
+	route_unlock_node (rn);
+      }
+  route_table_finish (oi->nbrs);
+
+  ospf_if_stream_unset (oi);
+  ospf_ls_upd_queue_empty (oi);
+  route_table_finish (oi->ls_upd_queue);
+  list_free (oi->nbr_nbma);
+  list_free (oi->ls_ack);
+  list_free (oi->ls_ack_direct.ls_ack);
+  ospf_opaque_type9_lsa_term (oi);
+
+  listnode_delete (oi->ospf->oiflist, oi);
+  listnode_delete (oi->area->oiflist, oi);
+  prefix_ipv4_free ((struct prefix_ipv4 *) oi->address);
+  XFREE (MTYPE_OSPF_IF, oi);
+
+  if_delete (ifp);
+}
+
+/* Run what the daemon would before reading more: the events, and the
+   timers due. */
+static void
+test_events (void)
+{
+  struct thread thread;
+
+  while ((master->event.count || master->ready.count)
+	 && thread_fetch (master, &thread))
+    thread_call (&thread);
+}
+
+static int
+test_run (unsigned int pacing)
+{
+  struct ospf *ospf;
+  struct ospf_area *area;
+  struct in_addr area_id = { .s_addr = 0 };
+  struct ospf_interface *oi;
+  struct ospf_packet *op;
+  struct route_node *rn;
+  struct ospf_neighbor *nbr;
+  struct thread thread;
+  struct timeval start;
+  unsigned long usec, packets = 0, partial, sent, count;
+  unsigned int per_update;
+  int failed = 0;
+  int i;
+
+  ospf = XCALLOC (MTYPE_OSPF_TOP, sizeof (struct ospf));
+  ospf->router_id.s_addr = htonl (0x0a000001);
+  ospf->areas = list_new ();
+  ospf->oiflist = list_new ();
+  ospf->vlinks = list_new ();
+  ospf->oi_write_q = list_new ();
+  ospf->lsdb = ospf_lsdb_new ();
+  ospf->ls_rxmt_nbrs = vector_init (VECTOR_MIN_SIZE);
+  ospf->flood_pacing = pacing;
+  ospf->t_write = thread_add_timer (master, test_write, ospf, 3600);
+  listnode_add (om->ospf, ospf);
+  area = ospf_area_get (ospf, area_id, OSPF_AREA_ID_FORMAT_ADDRESS);
+
+  for (i = 0; i < TEST_IFS; i++)
+    ifs[i] = test_if_new (ospf, area, i);
+  for (i = 0; i < TEST_LSAS; i++)
+    lsas[i] = test_lsa_new (ospf, i);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < TEST_LSAS; i++)
+    {
+      ospf_flood_through_as (ospf, NULL, lsas[i]);
+      test_events ();
+    }
+  /* And what flood pacing holds back. */
+  for (i = 0; i < TEST_IFS; i++)
+    while (ifs[i]->t_ls_upd_event && thread_fetch (master, &thread))
+      thread_call (&thread);
+  usec = bench_usec (&start);
+
+  /* LSAs a full LS Update carries. */
+  per_update = (TEST_MTU - sizeof (struct ip) - OSPF_HEADER_SIZE
+		- OSPF_LS_UPD_MIN_SIZE) / (OSPF_LSA_HEADER_SIZE + 16);
+
+  for (i = 0; i < TEST_IFS; i++)
+    {
+      oi = ifs[i];
+      sent = partial = 0;
+      for (op = ospf_fifo_head (oi->obuf); op; op = op->next)
+	{
+	  count = stream_getl_from (op->s, OSPF_HEADER_SIZE);
+	  sent += count;
+	  partial += count < per_update;
+	}
+
+      if (sent != TEST_LSAS || oi->ls_upd_lsa_out != TEST_LSAS
+	  || oi->ls_upd_out != oi->obuf->count || oi->ls_upd_queue_count)
+	failed++;
+      /* Updates go out before they are full only as pacing runs out. */
+      if (pacing && partial > usec / (pacing * 1000) + 1)
+	failed++;
+
+      for (rn = route_top (oi->nbrs); rn; rn = route_next (rn))
+	if ((nbr = rn->info) && nbr != oi->nbr_self
+	    && ospf_ls_retransmit_count (nbr) != TEST_LSAS)
+	  failed++;
+      packets += oi->obuf->count;
+    }
+
+  printf ("%d LSAs out of %d interfaces, flood pacing %u msec: "
+	  "%lu LS updates, %lu LSAs per update, queue at most %u, "
+	  "%lu us, %d differences\n",
+	  TEST_LSAS, TEST_IFS, pacing, packets,
+	  TEST_LSAS * TEST_IFS / packets, ifs[0]->ls_upd_queue_max,
+	  usec, failed);
+
+  for (i = 0; i < TEST_IFS; i++)
+    test_if_free (ifs[i]);
+  for (i = 0; i < TEST_LSAS; i++)
+    ospf_lsa_discard (lsas[i]);
+
+  list_delete (area->oiflist);
+  route_table_finish (area->ranges);
+  ospf_opaque_type10_lsa_term (area);
+  ospf_lsdb_free (area->lsdb);
+  XFREE (MTYPE_OSPF_AREA, area);
+
+  listnode_delete (om->ospf, ospf);
+  OSPF_TIMER_OFF (ospf->t_write);
+  ospf_lsdb_free (ospf->lsdb);
+  vector_free (ospf->ls_rxmt_nbrs);
+  list_delete (ospf->oi_write_q);
+  list_delete (ospf->areas);
+  list_delete (ospf->oiflist);
+  list_delete (ospf->vlinks);
+  XFREE (MTYPE_OSPF_TOP, ospf);
+
+  return failed;
+}
+
+int
+main (void)
+{
+  struct timeval now;
+  int failed = 0;
+
+  ospf_master_init ();
+  master = om->master;
+  cmd_init (1);
+  vrf_init ();
+  ospf_if_init ();
+
+  /* New LSAs are aged from the time last read. */
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+
+  failed += test_run (0);
+  failed += test_run (OSPF_FLOOD_PACING_DEFAULT);
+
+  printf ("%s\n", failed ? "failed" : "OK");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,606 @@
+/*
+ * OSPF graceful restart test
+ *
+ * A router, DR of a broadcast network of three neighbors and with a
+ * point-to-point link to a fourth, goes down gracefully: its grace-LSAs
+ * are flooded and acknowledged.  Back, it keeps the LSAs from before
+ * until its adjacencies are, then goes on from their sequence numbers;
+ * a second restart ends early on a topology change.  Then it helps its
+ * neighbors restart, and stops when they are done or the topology
+ * changes.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "thread.h"
+#include "memory.h"
+#include "linklist.h"
+#include "prefix.h"
+#include "table.h"
+#include "if.h"
+#include "vrf.h"
+#include "stream.h"
+#include "privs.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_interface.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_neighbor.h"
+#include "ospfd/ospf_nsm.h"
+#include "ospfd/ospf_ism.h"
+#include "ospfd/ospf_packet.h"
+#include "ospfd/ospf_flood.h"
+#include "ospfd/ospf_opaque.h"
+#include "ospfd/ospf_vty.h"
+#include "ospfd/ospf_gr.h"
+
+#define TEST_LAN_NBRS	3
+#define TEST_NBRS	(TEST_LAN_NBRS + 1)
+#define TEST_SEQ(n)	(OSPF_INITIAL_SEQUENCE_NUMBER + (n))
+
+/* need these to link in libospf */
+struct zebra_privs_t ospfd_privs;
+struct thread_master *master = NULL;
+
+static struct ospf *ospf;
+static struct ospf_area *area;
+static struct ospf_interface *lan, *ptp;
+static struct ospf_neighbor *nbrs[TEST_NBRS];	/* The last on ptp. */
+static int failed;
+
+static struct in_addr
+addr (u_int32_t a)
+{
+  struct in_addr in;
+
+  in.s_addr = htonl (a);
+  return in;
+}
+
+static void
+check (int ok, const char *what)
+{
+  printf ("%-60s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok)
+    failed++;
+}
+
+static struct ospf_interface *
+test_if_new (const char *name, int type, u_int32_t a, int len)
+{
+  struct interface *ifp;
+  struct ospf_interface *oi;
+  struct prefix_ipv4 *p;
+
+  ifp = if_get_by_name (name);
+  ifp->ifindex = type == OSPF_IFTYPE_BROADCAST ? 1 : 2;
+  ifp->mtu = 1500;
+  ifp->flags = IFF_UP | IFF_RUNNING | IFF_MULTICAST
+    | (type == OSPF_IFTYPE_BROADCAST ? IFF_BROADCAST : IFF_POINTOPOINT);
+
+  p = prefix_ipv4_new ();
+  p->family = AF_INET;
+  p->prefix.s_addr = htonl (a);
+  p->prefixlen = len;
+
+  oi = ospf_if_new (ospf, ifp, (struct prefix *) p);
+  oi->connected = connected_add_by_prefix (ifp, (struct prefix *) p, NULL);
+  oi->area = area;
+  oi->type = type;
+  oi->state = type == OSPF_IFTYPE_BROADCAST ? ISM_DR : ISM_PointToPoint;
+  listnode_add (area->oiflist, oi);
+  ospf_if_stream_set (oi);
+  oi->nbr_self = ospf_nbr_new (oi);
+  ospf_nbr_add_self (oi);
+  if (oi->state == ISM_DR)
+    DR (oi) = oi->address->u.prefix4;
+  return oi;
+}
+
+static struct ospf_neighbor *
+test_nbr_new (struct ospf_interface *oi, u_int32_t id, u_int32_t a,
+	      u_char options)
+{
+  struct ospf_neighbor *nbr;
+  struct prefix key;
+
+  nbr = ospf_nbr_new (oi);
+  nbr->router_id.s_addr = htonl (id);
+  nbr->src.s_addr = htonl (a);
+  nbr->address.family = AF_INET;
+  nbr->address.prefixlen = IPV4_MAX_BITLEN;
+  nbr->address.u.prefix4 = nbr->src;
+  nbr->options = options;
+  nbr->state = NSM_Full;
+
+  key.family = AF_INET;
+  key.prefixlen = IPV4_MAX_BITLEN;
+  key.u.prefix4 = nbr->src;
+  route_node_get (oi->nbrs, &key)->info = nbr;
+  return nbr;
+}
+
+static void
+test_if_free (struct ospf_interface *oi)
+{
+  struct interface *ifp = oi->ifp;
+  struct route_node *rn;
+
+  for (rn = route_top (oi->nbrs); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	ospf_nbr_free (rn->info);
+	rn->info = NULL;
+	route_unlock_node (rn);
+      }
+  route_table_finish (oi->nbrs);
+
+  ospf_if_stream_unset (oi);
+  ospf_ls_upd_queue_empty (oi);
+  route_table_finish (oi->ls_upd_queue);
+  list_free (oi->nbr_nbma);
+  list_free (oi->ls_ack);
+  list_free (oi->ls_ack_direct.ls_ack);
+  ospf_opaque_type9_lsa_term (oi);
+  if (oi->network_lsa_self)
+    ospf_lsa_unlock (&oi->network_lsa_self);
+
+  listnode_delete (oi->ospf->oiflist, oi);
+  listnode_delete (oi->area->oiflist, oi);
+  prefix_ipv4_free ((struct prefix_ipv4 *) oi->address);
+  XFREE (MTYPE_OSPF_IF, oi);
+
+  if_delete (ifp);
+}
+
+static void
+test_link_add (u_char **p, u_int32_t id, u_int32_t data, u_char type)
+{
+  struct router_lsa_link *l = (struct router_lsa_link *) *p;
+
+  l->link_id = addr (id);
+  l->link_data = addr (data);
+  l->m[0].type = type;
+  l->m[0].tos_count = 0;
+  l->m[0].metric = htons (10);
+  *p += OSPF_ROUTER_LSA_LINK_SIZE;
+}
+
+/* An LSA as received, from the buffer its body was written to. */
+static struct ospf_lsa *
+test_lsa_new (u_char *buf, u_char *p, u_char type, u_int32_t id,
+	      u_int32_t adv_router, u_int32_t seqnum)
+{
+  struct lsa_header *h = (struct lsa_header *) buf;
+  struct ospf_lsa *lsa;
+
+  h->ls_age = 0;
+  h->options = OSPF_OPTION_E;
+  h->type = type;
+  h->id = addr (id);
+  h->adv_router = addr (adv_router);
+  h->ls_seqnum = htonl (seqnum);
+  h->length = htons (p - buf);
+  ospf_lsa_checksum (h);
+
+  lsa = ospf_lsa_new ();
+  lsa->data = ospf_lsa_data_dup (h);
+  lsa->area = area;
+  return lsa;
+}
+
+/* Install an LSA as flooding one from a neighbor does, then run what
+   that leaves for later. */
+static void
+test_install (struct ospf_interface *oi, struct ospf_lsa *lsa)
+{
+  struct thread event;
+
+  SET_FLAG (lsa->flags, OSPF_LSA_RECEIVED);
+  ospf_lsa_is_self_originated (ospf, lsa);
+  ospf_lsa_install (ospf, oi, lsa);
+
+  if (ospf->t_gr_event)
+    {
+      event = *ospf->t_gr_event;
+      thread_cancel (ospf->t_gr_event);
+      (*event.func) (&event);
+    }
+}
+
+/* A router-LSA with a transit link to the LAN, and a point-to-point
+   link to the peer unless 0. */
+static struct ospf_lsa *
+test_router_lsa (u_int32_t id, u_int32_t lan_addr, u_int32_t peer,
+		 u_int32_t ptp_addr, u_int32_t seqnum)
+{
+  u_char buf[OSPF_MAX_LSA_SIZE];
+  struct router_lsa *rl = (struct router_lsa *) buf;
+  u_char *p;
+  int links = 0;
+
+  memset (buf, 0, sizeof (buf));
+  p = buf + OSPF_LSA_HEADER_SIZE + 4;
+  if (lan_addr)
+    {
+      test_link_add (&p, 0xc0a80001, lan_addr, LSA_LINK_TYPE_TRANSIT);
+      links++;
+    }
+  if (peer)
+    {
+      test_link_add (&p, peer, ptp_addr, LSA_LINK_TYPE_POINTOPOINT);
+      links++;
+    }
+  test_link_add (&p, ptp_addr & 0xfffffffc, 0xfffffffc, LSA_LINK_TYPE_STUB);
+  rl->links = htons (links + 1);
+  return test_lsa_new (buf, p, OSPF_ROUTER_LSA, id, id, seqnum);
+}
+
+/* The network-LSA of the LAN, from us as its DR. */
+static struct ospf_lsa *
+test_network_lsa (u_int32_t seqnum)
+{
+  u_char buf[OSPF_MAX_LSA_SIZE];
+  struct network_lsa *nl = (struct network_lsa *) buf;
+  u_char *p;
+  int n;
+
+  memset (buf, 0, sizeof (buf));
+  nl->mask = addr (0xffffff00);
+  p = buf + OSPF_LSA_HEADER_SIZE + 4;
+  memcpy (p, &ospf->router_id, 4);
+  p += 4;
+  for (n = 0; n < TEST_LAN_NBRS; n++, p += 4)
+    memcpy (p, &nbrs[n]->router_id, 4);
+  return test_lsa_new (buf, p, OSPF_NETWORK_LSA, 0xc0a80001,
+		       ntohl (ospf->router_id.s_addr), seqnum);
+}
+
+/* A grace-LSA from the neighbor. */
+static struct ospf_lsa *
+test_nbr_grace_lsa (struct ospf_neighbor *nbr, u_int32_t seqnum, int flushed)
+{
+  struct ospf_lsa *lsa;
+
+  lsa = ospf_gr_lsa_new (nbr->oi, 60, GR_REASON_RESTART);
+  lsa->flags = 0;
+  lsa->data->adv_router = nbr->router_id;
+  lsa->data->ls_seqnum = htonl (seqnum);
+  lsa->data->ls_age = htons (flushed ? OSPF_LSA_MAXAGE : 0);
+  if (nbr->oi->type == OSPF_IFTYPE_BROADCAST)
+    memcpy ((u_char *) lsa->data + OSPF_LSA_HEADER_SIZE + 20, &nbr->src, 4);
+  ospf_lsa_checksum (lsa->data);
+  return lsa;
+}
+
+/* The acknowledgement of an LSA, as read from an LS Ack. */
+static struct ospf_lsa *
+test_ack_new (struct ospf_lsa *lsa)
+{
+  struct ospf_lsa *ack;
+
+  ack = ospf_lsa_new ();
+  ack->data = ospf_lsa_data_new (OSPF_LSA_HEADER_SIZE);
+  memcpy (ack->data, lsa->data, OSPF_LSA_HEADER_SIZE);
+  return ack;
+}
+
+/* The grace-LSA on the list of the neighbor, taken off as its
+   acknowledgement does if ack is set. */
+static struct ospf_lsa *
+test_grace_listed (struct ospf_neighbor *nbr, struct ospf_lsa *lsa, int ack)
+{
+  struct ospf_lsa *key, *listed;
+
+  key = test_ack_new (lsa);
+  listed = ospf_ls_retransmit_lookup (nbr, key);
+  if (listed && ack && ospf_lsa_more_recent (listed, key) == 0)
+    ospf_ls_retransmit_delete (nbr, listed);
+  ospf_lsa_discard (key);
+  return listed;
+}
+
+static void
+test_grace_lsa (void)
+{
+  struct ospf_lsa *lsa;
+  struct ospf_gr_info info;
+
+  lsa = ospf_gr_lsa_new (lan, 120, GR_REASON_RESTART);
+  check (ntohs (lsa->data->length) == OSPF_LSA_HEADER_SIZE + 24
+	 && ospf_lsa_checksum_valid (lsa->data)
+	 && ospf_gr_lsa_parse (lsa->data, &info) == 0
+	 && info.grace_period == 120 && info.reason == GR_REASON_RESTART
+	 && info.if_address.s_addr == htonl (0xc0a80001),
+	 "grace-LSA of the LAN, with the interface address");
+
+  lsa->data->length = htons (OSPF_LSA_HEADER_SIZE + 12);
+  check (ospf_gr_lsa_parse (lsa->data, &info) < 0,
+	 "grace-LSA without a reason refused");
+  ospf_lsa_discard (lsa);
+
+  lsa = ospf_gr_lsa_new (ptp, 120, GR_REASON_RESTART);
+  check (ntohs (lsa->data->length) == OSPF_LSA_HEADER_SIZE + 16
+	 && ospf_gr_lsa_parse (lsa->data, &info) == 0
+	 && info.if_address.s_addr == 0,
+	 "grace-LSA of the point-to-point link, without");
+  ospf_lsa_discard (lsa);
+}
+
+/* Going down: grace-LSAs to the opaque-capable neighbors, acknowledged,
+   and the end of the grace period kept. */
+static void
+test_shutdown (void)
+{
+  struct ospf_lsa *sent;
+  int n, listed = 0, acked = 0;
+
+  check (ospf_gr_shutdown (ospf) && ospf->gr_state == OSPF_GR_SHUTDOWN,
+	 "going down gracefully");
+
+  sent = ospf_gr_lsa_new (lan, 120, GR_REASON_RESTART);
+  for (n = 0; n < TEST_LAN_NBRS; n++)
+    listed += test_grace_listed (nbrs[n], sent, 0) != NULL;
+  check (listed == TEST_LAN_NBRS
+	 && ospf_ls_retransmit_count (nbrs[TEST_LAN_NBRS]) == 0,
+	 "grace-LSAs to the opaque-capable neighbors only");
+  check (access (ospf_gr_state_file, R_OK) == 0, "grace period kept");
+  check (!ospf_gr_shutdown_done (ospf), "waiting for acknowledgements");
+
+  for (n = 0; n < TEST_LAN_NBRS; n++)
+    acked += test_grace_listed (nbrs[n], sent, 1) != NULL;
+  ospf_lsa_discard (sent);
+  check (acked == TEST_LAN_NBRS && ospf_gr_shutdown_done (ospf),
+	 "grace-LSAs acknowledged, gone");
+}
+
+/* Back: the LSAs from before are kept until the adjacencies are. */
+static void
+test_restart (void)
+{
+  struct ospf_lsa *lsa;
+  int n, ok;
+
+  for (n = 0; n < TEST_NBRS; n++)
+    nbrs[n]->state = NSM_ExStart;
+
+  ospf_gr_startup ();
+  check (ospf->gr_state == OSPF_GR_RESTARTING && ospf->t_gr_restart
+	 && thread_timer_remain_second (ospf->t_gr_restart) >= 118
+	 && access (ospf_gr_state_file, F_OK) < 0,
+	 "back within the grace period, restarting");
+
+  /* Our LSAs from before, and those of the neighbors, come in. */
+  test_install (lan, test_router_lsa (0x0a000001, 0xc0a80001, 0x0a000005,
+				      0x0a010001, TEST_SEQ (10)));
+  test_install (lan, test_network_lsa (TEST_SEQ (20)));
+  for (n = 0; n < TEST_LAN_NBRS; n++)
+    test_install (lan, test_router_lsa (0x0a000002 + n, 0xc0a80002 + n,
+					0, 0x0a020000 + 4 * n,
+					TEST_SEQ (1)));
+  test_install (ptp, test_router_lsa (0x0a000005, 0, 0x0a000001,
+				      0x0a010002, TEST_SEQ (1)));
+
+  ospf_router_lsa_update_area (area);
+  ospf_network_lsa_update (lan);
+  check (ospf->gr_state == OSPF_GR_RESTARTING
+	 && area->router_lsa_self == NULL && lan->network_lsa_self == NULL,
+	 "nothing originated while the adjacencies are down");
+
+  /* Our grace-LSA, from before, flooded back to us. */
+  lsa = ospf_gr_lsa_new (lan, 120, GR_REASON_RESTART);
+  lsa->data->ls_seqnum = htonl (TEST_SEQ (5));
+  check (ospf_gr_self_lsa_received (nbrs[0], lsa)
+	 && ospf->gr_seqnum == TEST_SEQ (5),
+	 "grace-LSA from before acknowledged");
+
+  for (n = 0, ok = 1; n < TEST_NBRS; n++)
+    {
+      ok &= ospf->gr_state == OSPF_GR_RESTARTING;
+      nbrs[n]->state = NSM_Full;
+      ospf_opaque_nsm_change (nbrs[n], NSM_Loading);
+    }
+  check (ok && ospf->gr_state == OSPF_GR_RESYNC && ospf->t_gr_restart == NULL,
+	 "restart over when all the adjacencies are back");
+
+  check (area->router_lsa_self
+	 && ntohl (area->router_lsa_self->data->ls_seqnum) == TEST_SEQ (11)
+	 && lan->network_lsa_self
+	 && ntohl (lan->network_lsa_self->data->ls_seqnum) == TEST_SEQ (21),
+	 "LSAs originated on from the sequence numbers before");
+
+  lsa = test_nbr_grace_lsa (nbrs[0], TEST_SEQ (6), 1);
+  lsa->data->adv_router = ospf->router_id;
+  memcpy ((u_char *) lsa->data + OSPF_LSA_HEADER_SIZE + 20,
+	  &lan->address->u.prefix4, 4);
+  lsa->data->checksum = 0;
+  for (n = 0, ok = 0; n < TEST_LAN_NBRS; n++)
+    {
+      struct ospf_lsa *listed = test_grace_listed (nbrs[n], lsa, 0);
+
+      ok += listed && IS_LSA_MAXAGE (listed)
+	&& ntohl (listed->data->ls_seqnum) == TEST_SEQ (6);
+    }
+  ospf_lsa_discard (lsa);
+  check (ok == TEST_LAN_NBRS, "grace-LSAs flushed");
+
+  /* A second restart, the point-to-point neighbor dropping the link
+     meanwhile. */
+  ospf->gr_state = OSPF_GR_NONE;
+  ospf_gr_restart_begin (ospf, 60);
+  nbrs[TEST_LAN_NBRS]->state = NSM_ExStart;
+  test_install (ptp, test_router_lsa (0x0a000005, 0, 0, 0x0a010002,
+				      TEST_SEQ (2)));
+  check (ospf->gr_state == OSPF_GR_RESYNC
+	 && ntohl (area->router_lsa_self->data->ls_seqnum) == TEST_SEQ (12),
+	 "restart over when the topology changes");
+  nbrs[TEST_LAN_NBRS]->state = NSM_Full;
+
+  /* The routes are sent, zebra removes what it kept. */
+  ospf->gr_state = OSPF_GR_NONE;
+}
+
+/* Helping the neighbors of the LAN restart. */
+static void
+test_helper (void)
+{
+  struct ospf_lsa *lsa;
+  struct in_addr *id, *lim;
+  int n, listed;
+
+  ospf->gr_helper = 1;
+  for (n = 0; n < TEST_NBRS; n++)
+    ospf_ls_retransmit_clear (nbrs[n]);
+
+  test_install (lan, test_nbr_grace_lsa (nbrs[0], TEST_SEQ (1), 0));
+  check (nbrs[0]->t_gr_helper && ospf->gr_helping == 1,
+	 "helping a neighbor restart");
+
+  OSPF_NSM_EVENT_EXECUTE (nbrs[0], NSM_InactivityTimer);
+  OSPF_NSM_EVENT_EXECUTE (nbrs[0], NSM_OneWayReceived);
+  check (nbrs[0]->state == NSM_Full, "its hellos not heard of");
+
+  /* It synchronizes its database again, still adjacent to the others. */
+  nbrs[0]->state = NSM_ExStart;
+  ospf_network_lsa_update (lan);
+  lsa = lan->network_lsa_self;
+  id = (struct in_addr *) ((u_char *) lsa->data + OSPF_LSA_HEADER_SIZE + 4);
+  lim = (struct in_addr *) ((u_char *) lsa->data + ntohs (lsa->data->length));
+  for (listed = 0; id < lim; id++)
+    listed += IPV4_ADDR_SAME (id, &nbrs[0]->router_id);
+  check (ospf_nbr_count_adjacent (lan) == TEST_LAN_NBRS && listed == 1,
+	 "described as adjacent meanwhile");
+  nbrs[0]->state = NSM_Full;
+
+  /* The network-LSA not yet acknowledged by the second. */
+  test_install (lan, test_nbr_grace_lsa (nbrs[1], TEST_SEQ (1), 0));
+  check (nbrs[1]->t_gr_helper == NULL && ospf->gr_helping == 1,
+	 "not helping with changes pending for it");
+  ospf_ls_retransmit_clear (nbrs[1]);
+  test_install (lan, test_nbr_grace_lsa (nbrs[1], TEST_SEQ (2), 0));
+  check (nbrs[1]->t_gr_helper && ospf->gr_helping == 2,
+	 "helping once acknowledged");
+
+  test_install (lan, test_nbr_grace_lsa (nbrs[1], TEST_SEQ (3), 1));
+  check (nbrs[1]->t_gr_helper == NULL && ospf->gr_helping == 1,
+	 "done when its grace-LSA is flushed");
+
+  /* Its own router-LSA changes nothing, one from another router does. */
+  test_install (lan, test_router_lsa (0x0a000002, 0, 0, 0x0a020000,
+				      TEST_SEQ (2)));
+  check (nbrs[0]->t_gr_helper && ospf->gr_helping == 1,
+	 "its own router-LSA no topology change");
+  test_install (lan, test_router_lsa (0x0a000009, 0, 0, 0x0a090000,
+				      TEST_SEQ (1)));
+  check (nbrs[0]->t_gr_helper == NULL && ospf->gr_helping == 0,
+	 "done when the topology changes");
+}
+
+int
+main (void)
+{
+  struct in_addr area_id = { .s_addr = 0 };
+  struct timeval now;
+  char path[64];
+  int n;
+
+  ospf_master_init ();
+  master = om->master;
+  cmd_init (1);
+  vrf_init ();
+  ospf_if_init ();
+  ospf_vty_init ();
+  ospf_opaque_init ();
+
+  /* New LSAs are aged from the time last read. */
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+
+  snprintf (path, sizeof (path), "/tmp/testospfgr.%d", (int) getpid ());
+  ospf_gr_state_file = path;
+
+  ospf = XCALLOC (MTYPE_OSPF_TOP, sizeof (struct ospf));
+  ospf->router_id.s_addr = htonl (0x0a000001);
+  ospf->areas = list_new ();
+  ospf->oiflist = list_new ();
+  ospf->vlinks = list_new ();
+  ospf->oi_write_q = list_new ();
+  ospf->lsdb = ospf_lsdb_new ();
+  ospf->lsdb->ospf = ospf;
+  ospf->ls_rxmt_nbrs = vector_init (VECTOR_MIN_SIZE);
+  ospf->maxage_lsa = route_table_init ();
+  ospf->min_ls_interval = OSPF_MIN_LS_INTERVAL;
+  ospf->min_ls_arrival = OSPF_MIN_LS_ARRIVAL;
+  ospf->flood_pacing = OSPF_FLOOD_PACING_DEFAULT;
+  ospf->spf_delay = OSPF_SPF_DELAY_DEFAULT;
+  ospf->spf_holdtime = OSPF_SPF_HOLDTIME_DEFAULT;
+  ospf->spf_max_holdtime = OSPF_SPF_MAX_HOLDTIME_DEFAULT;
+  ospf->spf_hold_multiplier = 1;
+  ospf->lsa_refresh_interval = OSPF_LSA_REFRESH_INTERVAL_DEFAULT;
+  ospf->lsa_wheel.done[OSPF_LSA_WHEEL_MAXAGE] =
+    ospf->lsa_wheel.done[OSPF_LSA_WHEEL_REFRESH] =
+    recent_relative_time ().tv_sec / OSPF_LSA_WHEEL_GRANULARITY;
+  SET_FLAG (ospf->config, OSPF_OPAQUE_CAPABLE);
+  ospf->gr_grace_period = OSPF_GR_GRACE_PERIOD_DEFAULT;
+  ospf_opaque_type11_lsa_init (ospf);
+  listnode_add (om->ospf, ospf);
+  area = ospf_area_get (ospf, area_id, OSPF_AREA_ID_FORMAT_ADDRESS);
+
+  lan = test_if_new ("lan0", OSPF_IFTYPE_BROADCAST, 0xc0a80001, 24);
+  ptp = test_if_new ("ptp0", OSPF_IFTYPE_POINTOPOINT, 0x0a010001, 30);
+  for (n = 0; n < TEST_LAN_NBRS; n++)
+    nbrs[n] = test_nbr_new (lan, 0x0a000002 + n, 0xc0a80002 + n,
+			    OSPF_OPTION_E | OSPF_OPTION_O);
+  nbrs[n] = test_nbr_new (ptp, 0x0a000005, 0x0a010002, OSPF_OPTION_E);
+
+  test_grace_lsa ();
+  test_shutdown ();
+  test_restart ();
+  test_helper ();
+  unlink (path);
+
+  test_if_free (lan);
+  test_if_free (ptp);
+  ospf_lsa_unlock (&area->router_lsa_self);
+  ospf_lsdb_delete_all (area->lsdb);
+  ospf_lsdb_delete_all (ospf->lsdb);
+  ospf_opaque_type11_lsa_term (ospf);
+  ospf_lsdb_free (ospf->lsdb);
+
+  list_delete (area->oiflist);
+  route_table_finish (area->ranges);
+  ospf_opaque_type10_lsa_term (area);
+  ospf_lsdb_free (area->lsdb);
+  XFREE (MTYPE_OSPF_AREA, area);
+
+  listnode_delete (om->ospf, ospf);
+  vector_free (ospf->ls_rxmt_nbrs);
+  route_table_finish (ospf->maxage_lsa);
+  list_delete (ospf->oi_write_q);
+  list_delete (ospf->areas);
+  list_delete (ospf->oiflist);
+  list_delete (ospf->vlinks);
+  XFREE (MTYPE_OSPF_TOP, ospf);
+
+  printf ("%s\n", failed ? "failed" : "OK");
+  return failed ? 1 : 0;
+}
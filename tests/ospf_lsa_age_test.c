@@ -0,0 +1,297 @@
+/*
+ * OSPF LSA age wheel test
+ *
+ * Loads a large database of summary and AS-external LSAs received over
+ * the last hour at random ages, and checks one pass of the MaxAge
+ * walker finds those that reached MaxAge, and only those, and that the
+ * wheel follows LSAs replaced and deleted.  Then times the walker on
+ * the idle database against the walk of the whole database it used to
+ * make every time.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "memory.h"
+#include "linklist.h"
+#include "prefix.h"
+#include "table.h"
+#include "privs.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_spf.h"
+#include "ospfd/ospf_opaque.h"
+
+#include "prng.h"
+
+#define TEST_LSAS	200000
+#define TEST_ROUTERS	50
+#define BENCH_TICKS	100
+
+/* need these to link in libospf */
+struct zebra_privs_t ospfd_privs;
+struct thread_master *master = NULL;
+
+static struct ospf_lsa *lsas[TEST_LSAS];
+static struct prng *prng;
+
+/* How far back the LSAs were received: an hour, or since the clock
+   started if less. */
+static time_t history;
+
+static unsigned long
+bench_usec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start);
+}
+
+/* Even LSAs are type-3 summaries in the area, odd ones AS-externals. */
+static struct ospf_lsa *
+test_lsa_new (struct ospf_area *area, int i)
+{
+  struct ospf_lsa *lsa;
+  struct summary_lsa *sl;
+  time_t now = recent_relative_time ().tv_sec;
+
+  lsa = ospf_lsa_new ();
+  lsa->data = ospf_lsa_data_new (OSPF_LSA_HEADER_SIZE + 8);
+  sl = (struct summary_lsa *) lsa->data;
+  sl->header.type = (i % 2) ? OSPF_AS_EXTERNAL_LSA : OSPF_SUMMARY_LSA;
+  sl->header.length = htons (OSPF_LSA_HEADER_SIZE + 8);
+  sl->header.ls_age = htons (prng_rand (prng) % OSPF_LSA_MAXAGE);
+  sl->header.id.s_addr = htonl (0x40000000 + (i / 2) * 256);
+  sl->header.adv_router.s_addr = htonl (0x0a000002 + i % TEST_ROUTERS);
+  sl->mask.s_addr = htonl (0xffffff00);
+  sl->metric[2] = 1 + i % 20;
+  if (i % 2 == 0)
+    lsa->area = area;
+
+  /* Received some time in the last hour. */
+  lsa->tv_recv.tv_sec = now - prng_rand (prng) % (history + 1);
+  return lsa;
+}
+
+static struct ospf_lsdb *
+test_lsdb (struct ospf_area *area, struct ospf_lsa *lsa)
+{
+  return lsa->area ? area->lsdb : area->ospf->lsdb;
+}
+
+static void
+test_walk (struct ospf *ospf)
+{
+  struct thread thread;
+
+  thread.arg = ospf;
+  ospf_lsa_maxage_walker (&thread);
+  OSPF_TIMER_OFF (ospf->t_maxage_walker);
+  OSPF_TIMER_OFF (ospf->t_maxage);
+  OSPF_TIMER_OFF (ospf->t_spf_calc);
+}
+
+/* The walker must have found every LSA past MaxAge by more than a slot
+   of the wheel, and none short of it; the wheel must hold all the
+   others. */
+static int
+test_check (struct ospf *ospf, const char *when)
+{
+  int found = 0, aged = 0, present = 0;
+  int failed = 0;
+  int i, maxage;
+
+  for (i = 0; i < TEST_LSAS; i++)
+    {
+      if (! lsas[i])
+	continue;
+      present++;
+
+      maxage = CHECK_FLAG (lsas[i]->flags, OSPF_LSA_IN_MAXAGE);
+      found += maxage != 0;
+      aged += IS_LSA_MAXAGE (lsas[i]);
+      if (maxage && ! IS_LSA_MAXAGE (lsas[i]))
+	failed++;
+      if (! maxage
+	  && get_age (lsas[i]) > OSPF_LSA_MAXAGE + OSPF_LSA_WHEEL_GRANULARITY)
+	failed++;
+      if (! maxage != (lsas[i]->wheel_slot >= 0))
+	failed++;
+    }
+  if (ospf->lsa_wheel.count[OSPF_LSA_WHEEL_MAXAGE]
+      != (unsigned long) (present - found))
+    failed++;
+
+  printf ("%s: %d LSAs, %d at MaxAge, %d found, %lu on the wheel, "
+	  "%d differences\n", when, present, aged, found,
+	  ospf->lsa_wheel.count[OSPF_LSA_WHEEL_MAXAGE], failed);
+  return failed;
+}
+
+/* What the walker did before: look at every LSA of the database. */
+static int
+test_scan (struct ospf *ospf)
+{
+  struct ospf_area *area;
+  struct listnode *node;
+  struct route_node *rn;
+  struct ospf_lsa *lsa;
+  int aged = 0;
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    LSDB_LOOP (SUMMARY_LSDB (area), rn, lsa)
+      aged += IS_LSA_MAXAGE (lsa) && ! ospf_lsa_is_self_originated (ospf, lsa);
+  LSDB_LOOP (EXTERNAL_LSDB (ospf), rn, lsa)
+    aged += IS_LSA_MAXAGE (lsa) && ! ospf_lsa_is_self_originated (ospf, lsa);
+  return aged;
+}
+
+static void
+test_free (struct ospf_area *area)
+{
+  struct ospf *ospf = area->ospf;
+  struct route_node *rn;
+  struct ospf_lsa *lsa;
+  int i;
+
+  for (rn = route_top (ospf->maxage_lsa); rn; rn = route_next (rn))
+    if ((lsa = rn->info))
+      {
+	UNSET_FLAG (lsa->flags, OSPF_LSA_IN_MAXAGE);
+	ospf_lsa_unlock (&lsa);
+	rn->info = NULL;
+	route_unlock_node (rn);
+      }
+  route_table_finish (ospf->maxage_lsa);
+
+  for (i = 0; i < TEST_LSAS; i++)
+    if (lsas[i])
+      {
+	ospf_lsdb_delete (test_lsdb (area, lsas[i]), lsas[i]);
+	ospf_lsa_discard (lsas[i]);
+	lsas[i] = NULL;
+      }
+  ospf_opaque_type10_lsa_term (area);
+  ospf_lsdb_free (area->lsdb);
+  ospf_lsdb_free (ospf->lsdb);
+
+  list_delete (area->oiflist);
+  route_table_finish (area->ranges);
+  XFREE (MTYPE_OSPF_AREA, area);
+
+  listnode_delete (om->ospf, ospf);
+  list_delete (ospf->areas);
+  list_delete (ospf->oiflist);
+  list_delete (ospf->vlinks);
+  XFREE (MTYPE_OSPF_TOP, ospf);
+}
+
+int
+main (void)
+{
+  struct ospf *ospf;
+  struct ospf_area *area;
+  struct in_addr area_id = { .s_addr = 0 };
+  struct ospf_lsa *old;
+  struct timeval start;
+  unsigned long wheel_us, scan_us;
+  int failed = 0;
+  int aged = 0;
+  int i, t;
+
+  ospf_master_init ();
+  master = om->master;
+  prng = prng_new (0);
+
+  /* New LSAs are aged from the time last read. */
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+
+  ospf = XCALLOC (MTYPE_OSPF_TOP, sizeof (struct ospf));
+  ospf->router_id.s_addr = htonl (0x0a000001);
+  ospf->areas = list_new ();
+  ospf->oiflist = list_new ();
+  ospf->vlinks = list_new ();
+  ospf->lsdb = ospf_lsdb_new ();
+  ospf->lsdb->ospf = ospf;
+  ospf->maxage_lsa = route_table_init ();
+  listnode_add (om->ospf, ospf);
+  area = ospf_area_get (ospf, area_id, OSPF_AREA_ID_FORMAT_ADDRESS);
+
+  /* The walkers last went round when the first LSA came in. */
+  history = MIN (start.tv_sec, OSPF_LSA_MAXAGE);
+  for (i = 0; i < 2; i++)
+    ospf->lsa_wheel.done[i] = (start.tv_sec - history)
+      / OSPF_LSA_WHEEL_GRANULARITY;
+
+  for (i = 0; i < TEST_LSAS; i++)
+    {
+      lsas[i] = test_lsa_new (area, i);
+      ospf_lsdb_add (test_lsdb (area, lsas[i]), lsas[i]);
+    }
+
+  test_walk (ospf);
+  failed += test_check (ospf, "loaded");
+
+  /* Newer instances of some, received now, and some gone. */
+  for (i = 0; i < TEST_LSAS; i += 3)
+    {
+      old = lsas[i];
+      lsas[i] = test_lsa_new (area, i);
+      lsas[i]->tv_recv = recent_relative_time ();
+      ospf_lsdb_add (test_lsdb (area, lsas[i]), lsas[i]);
+      ospf_lsa_discard (old);
+    }
+  for (i = 1; i < TEST_LSAS; i += 3)
+    {
+      ospf_lsdb_delete (test_lsdb (area, lsas[i]), lsas[i]);
+      ospf_lsa_discard (lsas[i]);
+      lsas[i] = NULL;
+    }
+  test_walk (ospf);
+  failed += test_check (ospf, "changed");
+
+  /* Idle: nothing comes to MaxAge between ticks.  The walks go last,
+     so the check after sees what they left. */
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (t = 0; t < BENCH_TICKS; t++)
+    aged += test_scan (ospf);
+  scan_us = bench_usec (&start);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (t = 0; t < BENCH_TICKS; t++)
+    test_walk (ospf);
+  wheel_us = bench_usec (&start);
+
+  printf ("%d idle MaxAge walks of %lu LSAs, %d at MaxAge: "
+	  "whole database %lu us, wheel %lu us\n", BENCH_TICKS,
+	  ospf->lsdb->total + area->lsdb->total, aged / BENCH_TICKS,
+	  scan_us, wheel_us);
+  failed += test_check (ospf, "idle");
+
+  test_free (area);
+  prng_free (prng);
+
+  printf ("%s\n", failed ? "failed" : "OK");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,309 @@
+/*
+ * OSPF LSDB test
+ *
+ * Loads an LSDB with 200000 LSAs of four types from 500 routers, then
+ * replaces newer instances of some and deletes others, checking after
+ * each step that lookups find what the database holds and nothing
+ * else, and that walks still see the LSAs of each type in order.
+ * Times lookups by the hash index against the per-type tables they
+ * used to descend.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "memory.h"
+#include "prefix.h"
+#include "table.h"
+#include "privs.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+
+#define TEST_LSAS	200000
+#define TEST_ROUTERS	500
+#define TEST_ROUNDS	5
+#define TEST_STRIDE(i)	((int) (((long long) (i) * 104729) % TEST_LSAS))
+
+/* need these to link in libospf */
+struct zebra_privs_t ospfd_privs;
+struct thread_master *master = NULL;
+
+static struct ospf_lsa *lsas[TEST_LSAS];
+static int present[TEST_LSAS];
+
+static unsigned long
+bench_usec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start);
+}
+
+/* The Ith LSA: a router-LSA of each router, a network-LSA of some,
+   then summary-LSAs and most of all AS-external-LSAs, spread over
+   the routers. */
+static void
+test_key (int i, u_char *type, struct in_addr *id, struct in_addr *adv)
+{
+  int r = i % TEST_ROUTERS;
+
+  adv->s_addr = htonl (0x0a000001 + r);
+  if (i < TEST_ROUTERS)
+    {
+      *type = OSPF_ROUTER_LSA;
+      *id = *adv;
+    }
+  else if (i < 10 * TEST_ROUTERS)
+    {
+      *type = OSPF_NETWORK_LSA;
+      id->s_addr = htonl (0xc0a80001 + (i << 8));
+    }
+  else if (i < TEST_LSAS / 4)
+    {
+      *type = OSPF_SUMMARY_LSA;
+      id->s_addr = htonl (0xac100000 + (i << 8));
+    }
+  else
+    {
+      *type = OSPF_AS_EXTERNAL_LSA;
+      id->s_addr = htonl (0x40000000 + (i << 8));
+    }
+}
+
+static struct ospf_lsa *
+test_lsa_new (int i, u_int32_t seqnum)
+{
+  struct ospf_lsa *lsa;
+
+  lsa = ospf_lsa_new ();
+  lsa->data = ospf_lsa_data_new (OSPF_LSA_HEADER_SIZE + 16);
+  test_key (i, &lsa->data->type, &lsa->data->id, &lsa->data->adv_router);
+  lsa->data->length = htons (OSPF_LSA_HEADER_SIZE + 16);
+  lsa->data->ls_seqnum = htonl (seqnum);
+  return lsa;
+}
+
+/* Lookups of every LSA, by LSA and by key, and of keys never added. */
+static int
+test_lookup (struct ospf_lsdb *lsdb, const char *when)
+{
+  struct in_addr id, adv;
+  u_char type;
+  unsigned long count = 0;
+  int failed = 0;
+  int i;
+
+  for (i = 0; i < TEST_LSAS; i++)
+    {
+      test_key (i, &type, &id, &adv);
+      if (ospf_lsdb_lookup_by_id (lsdb, type, id, adv)
+	  != (present[i] ? lsas[i] : NULL))
+	failed++;
+      if (ospf_lsdb_lookup (lsdb, lsas[i]) != (present[i] ? lsas[i] : NULL))
+	failed++;
+      adv.s_addr = htonl (0x0b000001 + i % TEST_ROUTERS);
+      if (ospf_lsdb_lookup_by_id (lsdb, type, id, adv) != NULL)
+	failed++;
+      count += present[i];
+    }
+  if (ospf_lsdb_count_all (lsdb) != count)
+    failed++;
+
+  printf ("%s: %lu LSAs, %d lookup differences\n",
+	  when, ospf_lsdb_count_all (lsdb), failed);
+  return failed;
+}
+
+/* Walks of each type must see its LSAs in order of ID and router,
+   and lookup_by_id_next must walk them the same. */
+static int
+test_walk (struct ospf_lsdb *lsdb)
+{
+  struct route_node *rn;
+  struct ospf_lsa *lsa, *prev, *next;
+  struct in_addr zero = { 0 };
+  unsigned long count = 0;
+  int failed = 0;
+  int type;
+
+  for (type = OSPF_MIN_LSA; type < OSPF_MAX_LSA; type++)
+    {
+      prev = NULL;
+      next = ospf_lsdb_lookup_by_id_next (lsdb, type, zero, zero, 1);
+      for (rn = route_top (lsdb->type[type].db); rn; rn = route_next (rn))
+	if ((lsa = rn->info) != NULL)
+	  {
+	    if (prev
+		&& (ntohl (prev->data->id.s_addr)
+		    > ntohl (lsa->data->id.s_addr)
+		    || (prev->data->id.s_addr == lsa->data->id.s_addr
+			&& ntohl (prev->data->adv_router.s_addr)
+			   >= ntohl (lsa->data->adv_router.s_addr))))
+	      failed++;
+	    if (next != lsa)
+	      failed++;
+	    if (ospf_lsdb_lookup (lsdb, lsa) != lsa)
+	      failed++;
+	    next = ospf_lsdb_lookup_by_id_next (lsdb, type, lsa->data->id,
+						lsa->data->adv_router, 0);
+	    prev = lsa;
+	    count++;
+	  }
+      if (next != NULL)
+	failed++;
+    }
+  if (count != ospf_lsdb_count_all (lsdb))
+    failed++;
+
+  printf ("walked %lu LSAs in order, %d differences\n", count, failed);
+  return failed;
+}
+
+/* Lookups of all keys, by the index and by the tables, in an order
+   striding through the LSAs as flooding and SPF would rather than
+   following the tables. */
+static void
+test_bench (struct ospf_lsdb *lsdb)
+{
+  struct prefix_ls lp;
+  struct route_node *rn;
+  struct timeval start;
+  unsigned long index_us, table_us, found = 0;
+  struct in_addr id, adv;
+  u_char type;
+  int i, n;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (n = 0; n < TEST_ROUNDS; n++)
+    for (i = 0; i < TEST_LSAS; i++)
+      {
+	test_key (TEST_STRIDE (i), &type, &id, &adv);
+	if (ospf_lsdb_lookup_by_id (lsdb, type, id, adv))
+	  found++;
+      }
+  index_us = bench_usec (&start);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (n = 0; n < TEST_ROUNDS; n++)
+    for (i = 0; i < TEST_LSAS; i++)
+      {
+	test_key (TEST_STRIDE (i), &type, &id, &adv);
+	memset (&lp, 0, sizeof (lp));
+	lp.prefixlen = 64;
+	lp.id = id;
+	lp.adv_router = adv;
+	if ((rn = route_node_lookup (lsdb->type[type].db,
+				     (struct prefix *) &lp)))
+	  {
+	    if (rn->info)
+	      found--;
+	    route_unlock_node (rn);
+	  }
+      }
+  table_us = bench_usec (&start);
+
+  printf ("%d lookups in %lu LSAs: tables %lu us, index %lu us (%.1fx)%s\n",
+	  TEST_ROUNDS * TEST_LSAS, ospf_lsdb_count_all (lsdb), table_us,
+	  index_us, index_us ? (double) table_us / index_us : 0.0,
+	  found ? ", DIFFERENT" : "");
+}
+
+int
+main (void)
+{
+  struct ospf_lsdb *lsdb;
+  struct ospf_lsa *old;
+  struct timeval start;
+  unsigned long add_us;
+  int failed = 0;
+  int i;
+
+  lsdb = ospf_lsdb_new ();
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < TEST_LSAS; i++)
+    {
+      lsas[i] = test_lsa_new (i, OSPF_INITIAL_SEQUENCE_NUMBER);
+      ospf_lsdb_add (lsdb, lsas[i]);
+      present[i] = 1;
+    }
+  add_us = bench_usec (&start);
+  printf ("%d LSAs added in %lu us\n", TEST_LSAS, add_us);
+
+  failed += test_lookup (lsdb, "added");
+  failed += test_walk (lsdb);
+  test_bench (lsdb);
+
+  /* Adding again changes nothing. */
+  for (i = 0; i < TEST_LSAS; i += 7)
+    ospf_lsdb_add (lsdb, lsas[i]);
+  failed += test_lookup (lsdb, "added again");
+
+  /* Newer instances of every other LSA take the place of the old. */
+  for (i = 0; i < TEST_LSAS; i += 2)
+    {
+      old = lsas[i];
+      lsas[i] = test_lsa_new (i, OSPF_INITIAL_SEQUENCE_NUMBER + 1);
+      ospf_lsdb_add (lsdb, lsas[i]);
+      ospf_lsa_discard (old);
+    }
+  failed += test_lookup (lsdb, "replaced");
+
+  /* Deleting every third LSA leaves runs with holes in them. */
+  for (i = 0; i < TEST_LSAS; i += 3)
+    {
+      ospf_lsdb_delete (lsdb, lsas[i]);
+      present[i] = 0;
+    }
+  failed += test_lookup (lsdb, "deleted");
+  failed += test_walk (lsdb);
+
+  /* An LSA not in the database, of the same key as one that is, is
+     not deleted in its place. */
+  old = test_lsa_new (1, OSPF_INITIAL_SEQUENCE_NUMBER + 2);
+  ospf_lsdb_delete (lsdb, old);
+  ospf_lsa_discard (old);
+  failed += test_lookup (lsdb, "other instance deleted");
+
+  /* Back again. */
+  for (i = 0; i < TEST_LSAS; i += 3)
+    {
+      ospf_lsdb_add (lsdb, lsas[i]);
+      present[i] = 1;
+    }
+  failed += test_lookup (lsdb, "added back");
+  test_bench (lsdb);
+
+  ospf_lsdb_delete_all (lsdb);
+  for (i = 0; i < TEST_LSAS; i++)
+    present[i] = 0;
+  failed += test_lookup (lsdb, "all deleted");
+
+  for (i = 0; i < TEST_LSAS; i++)
+    ospf_lsa_discard (lsas[i]);
+  ospf_lsdb_free (lsdb);
+
+  printf ("%s\n", failed ? "failed" : "OK");
+  return failed ? 1 : 0;
+}
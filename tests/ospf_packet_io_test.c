@@ -0,0 +1,426 @@
+/*
+ * OSPF packet I/O test
+ *
+ * Queues hellos on a datagram socket and has ospf_read take them in
+ * batches, checking that a wakeup reads no more than its budget and
+ * that the next one carries on where it stopped.  Then, where a raw
+ * socket may be opened, queues Database Description packets on two
+ * interfaces and has ospf_write send them in batches over loopback,
+ * checking the budget, the round robin between the interfaces and
+ * what arrives.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+#include <poll.h>
+
+#include "command.h"
+#include "thread.h"
+#include "memory.h"
+#include "linklist.h"
+#include "prefix.h"
+#include "table.h"
+#include "if.h"
+#include "vrf.h"
+#include "stream.h"
+#include "checksum.h"
+#include "sockopt.h"
+#include "privs.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_interface.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_neighbor.h"
+#include "ospfd/ospf_nsm.h"
+#include "ospfd/ospf_ism.h"
+#include "ospfd/ospf_packet.h"
+#include "ospfd/ospf_opaque.h"
+
+#define TEST_HELLOS	100
+#define TEST_NBRS	8
+#define TEST_DDS_LO0	100
+#define TEST_DDS_LO1	20
+
+/* need these to link in libospf */
+struct zebra_privs_t ospfd_privs;
+struct thread_master *master = NULL;
+
+static struct ospf *ospf;
+static struct ospf_area *area;
+static int failed = 0;
+
+static void
+test_check (int ok, const char *what)
+{
+  printf ("%s: %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok)
+    failed++;
+}
+
+static struct ospf_interface *
+test_if_new (const char *name, ifindex_t ifindex, u_int32_t a, int len)
+{
+  struct interface *ifp;
+  struct ospf_interface *oi;
+  struct prefix_ipv4 *p;
+
+  ifp = if_get_by_name (name);
+  ifp->ifindex = ifindex;
+  ifp->mtu = 1500;
+  ifp->flags = IFF_UP | IFF_RUNNING | IFF_BROADCAST | IFF_MULTICAST;
+
+  p = prefix_ipv4_new ();
+  p->family = AF_INET;
+  p->prefix.s_addr = htonl (a);
+  p->prefixlen = len;
+
+  oi = ospf_if_new (ospf, ifp, (struct prefix *) p);
+  oi->connected = connected_add_by_prefix (ifp, (struct prefix *) p, NULL);
+  oi->area = area;
+  oi->type = OSPF_IFTYPE_BROADCAST;
+  oi->state = ISM_DR;
+  listnode_add (area->oiflist, oi);
+  ospf_if_stream_set (oi);
+  oi->nbr_self = ospf_nbr_new (oi);
+  ospf_nbr_add_self (oi);
+  return oi;
+}
+
+static struct ospf_neighbor *
+test_nbr_new (struct ospf_interface *oi, u_int32_t id, u_int32_t a)
+{
+  struct ospf_neighbor *nbr;
+  struct prefix key;
+
+  nbr = ospf_nbr_new (oi);
+  nbr->router_id.s_addr = htonl (id);
+  nbr->src.s_addr = htonl (a);
+  nbr->address.family = AF_INET;
+  nbr->address.prefixlen = IPV4_MAX_BITLEN;
+  nbr->address.u.prefix4 = nbr->src;
+  nbr->state = NSM_ExStart;
+
+  key.family = AF_INET;
+  key.prefixlen = IPV4_MAX_BITLEN;
+  key.u.prefix4 = nbr->src;
+  route_node_get (oi->nbrs, &key)->info = nbr;
+  return nbr;
+}
+
+static void
+test_if_free (struct ospf_interface *oi)
+{
+  struct interface *ifp = oi->ifp;
+  struct route_node *rn;
+
+  for (rn = route_top (oi->nbrs); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	ospf_nbr_free (rn->info);
+	rn->info = NULL;
+	route_unlock_node (rn);
+      }
+  route_table_finish (oi->nbrs);
+
+  ospf_if_stream_unset (oi);
+  ospf_ls_upd_queue_empty (oi);
+  route_table_finish (oi->ls_upd_queue);
+  list_free (oi->nbr_nbma);
+  list_free (oi->ls_ack);
+  list_free (oi->ls_ack_direct.ls_ack);
+  ospf_opaque_type9_lsa_term (oi);
+
+  listnode_delete (oi->ospf->oiflist, oi);
+  listnode_delete (oi->area->oiflist, oi);
+  prefix_ipv4_free ((struct prefix_ipv4 *) oi->address);
+  XFREE (MTYPE_OSPF_IF, oi);
+
+  if_delete (ifp);
+}
+
+/* A hello as a neighbor sends it, IP header included, with our own
+   Router ID so that ospf_hello counts and then drops it. */
+static size_t
+test_hello (u_char *buf, u_int32_t src)
+{
+  struct ip *iph = (struct ip *) buf;
+  struct ospf_header *ospfh;
+  struct ospf_hello *hello;
+  size_t len = OSPF_HEADER_SIZE + OSPF_HELLO_MIN_SIZE;
+
+  memset (buf, 0, sizeof (struct ip) + len);
+  iph->ip_hl = sizeof (struct ip) >> 2;
+  iph->ip_v = IPVERSION;
+  iph->ip_len = sizeof (struct ip) + len;
+  iph->ip_ttl = 1;
+  iph->ip_p = IPPROTO_OSPFIGP;
+  iph->ip_src.s_addr = htonl (src);
+  iph->ip_dst.s_addr = htonl (OSPF_ALLSPFROUTERS);
+  sockopt_iphdrincl_swab_htosys (iph);
+
+  ospfh = (struct ospf_header *) (buf + sizeof (struct ip));
+  ospfh->version = OSPF_VERSION;
+  ospfh->type = OSPF_MSG_HELLO;
+  ospfh->length = htons (len);
+  ospfh->router_id = ospf->router_id;
+  ospfh->area_id = area->area_id;
+  ospfh->auth_type = htons (OSPF_AUTH_NULL);
+
+  hello = (struct ospf_hello *) ((u_char *) ospfh + OSPF_HEADER_SIZE);
+  hello->network_mask.s_addr = htonl (0xffffff00);
+  hello->hello_interval = htons (OSPF_HELLO_INTERVAL_DEFAULT);
+  hello->options = OSPF_OPTION_E;
+  hello->priority = 1;
+  hello->dead_interval = htonl (OSPF_ROUTER_DEAD_INTERVAL_DEFAULT);
+
+  ospfh->checksum = in_cksum (ospfh, len);
+  return sizeof (struct ip) + len;
+}
+
+static void
+test_read_wakeup (int fd)
+{
+  struct thread thread;
+
+  memset (&thread, 0, sizeof (thread));
+  thread.arg = ospf;
+  thread.u.fd = fd;
+  ospf_read (&thread);
+  OSPF_TIMER_OFF (ospf->t_read);
+}
+
+static void
+test_read (struct ospf_interface *oi)
+{
+  u_char buf[OSPF_MAX_PACKET_SIZE];
+  char what[64];
+  int sv[2];
+  int i, n, short_reads;
+
+  if (socketpair (AF_UNIX, SOCK_DGRAM, 0, sv) < 0)
+    {
+      perror ("socketpair");
+      failed++;
+      return;
+    }
+  ospf->fd = sv[0];
+
+  for (i = 0; i < TEST_HELLOS; i++)
+    if (send (sv[1], buf, test_hello (buf, 0xc0a80002 + i % 16), 0) < 0)
+      {
+	perror ("send");
+	failed++;
+      }
+
+  /* Wakeups until all are read, each up to the budget. */
+  for (n = 0, short_reads = 0; oi->hello_in < TEST_HELLOS && n < TEST_HELLOS;
+       n++)
+    {
+      u_int32_t before = oi->hello_in;
+
+      test_read_wakeup (sv[0]);
+      if (oi->hello_in - before
+	  != MIN (TEST_HELLOS - before, OSPF_READ_BUDGET))
+	short_reads++;
+    }
+  snprintf (what, sizeof (what), "%u hellos read in %d wakeups of %d",
+	    oi->hello_in, n, OSPF_READ_BUDGET);
+  test_check (oi->hello_in == TEST_HELLOS && short_reads == 0
+	      && n == (TEST_HELLOS + OSPF_READ_BUDGET - 1) / OSPF_READ_BUDGET,
+	      what);
+
+  /* A spurious wakeup must not block. */
+  if (OSPF_READ_BUDGET > 1)
+    {
+      test_read_wakeup (sv[0]);
+      test_check (oi->hello_in == TEST_HELLOS, "spurious read wakeup");
+    }
+
+  close (sv[0]);
+  close (sv[1]);
+  ospf->fd = -1;
+}
+
+static int
+test_write_queued (struct ospf_interface *oi)
+{
+  struct ospf_packet *op;
+  int n = 0;
+
+  for (op = ospf_fifo_head (oi->obuf); op; op = op->next)
+    n++;
+  return n;
+}
+
+static void
+test_write_wakeup (void)
+{
+  struct thread thread = *ospf->t_write;
+
+  thread_cancel (ospf->t_write);
+  (*thread.func) (&thread);
+}
+
+/* Database Description packets that arrived, from either interface. */
+static int
+test_write_received (int fd, int want)
+{
+  u_char buf[OSPF_MAX_PACKET_SIZE];
+  struct pollfd pfd;
+  struct ip *iph = (struct ip *) buf;
+  ssize_t len;
+  int n = 0;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  while (n < want && poll (&pfd, 1, 1000) > 0)
+    {
+      if ((len = recv (fd, buf, sizeof (buf), 0)) < 0)
+	break;
+      if ((size_t) len > sizeof (struct ip) + 1
+	  && (ntohl (iph->ip_src.s_addr) == 0x7f000001
+	      || ntohl (iph->ip_src.s_addr) == 0x7f010001)
+	  && buf[(iph->ip_hl << 2) + 1] == OSPF_MSG_DB_DESC)
+	n++;
+    }
+  return n;
+}
+
+static void
+test_write (struct ospf_interface *lo0, struct ospf_interface *lo1)
+{
+  struct ospf_neighbor *nbrs[TEST_NBRS];
+  char what[64];
+  int hincl = 1;
+  int fd, rfd;
+  int i, sent;
+
+  fd = socket (AF_INET, SOCK_RAW, IPPROTO_OSPFIGP);
+  rfd = socket (AF_INET, SOCK_RAW, IPPROTO_OSPFIGP);
+  if (fd < 0 || rfd < 0
+      || setsockopt (fd, IPPROTO_IP, IP_HDRINCL, &hincl, sizeof (hincl)) < 0)
+    {
+      printf ("raw sockets not permitted, write not tested\n");
+      if (fd >= 0)
+	close (fd);
+      if (rfd >= 0)
+	close (rfd);
+      return;
+    }
+  ospf->fd = fd;
+  ospf->maxsndbuflen = getsockopt_so_sendbuf (fd);
+
+  for (i = 0; i < TEST_NBRS; i++)
+    nbrs[i] = test_nbr_new (i % 2 ? lo1 : lo0, 0x0a000002 + i,
+			    (i % 2 ? 0x7f010002 : 0x7f000002) + i);
+
+  for (i = 0; i < TEST_DDS_LO0; i++)
+    ospf_db_desc_send (nbrs[(i % (TEST_NBRS / 2)) * 2]);
+  for (i = 0; i < TEST_DDS_LO1; i++)
+    ospf_db_desc_send (nbrs[(i % (TEST_NBRS / 2)) * 2 + 1]);
+
+  /* The first wakeup sends its budget, taking turns between the
+     interfaces a batch at a time, so that the short queue is done. */
+  test_write_wakeup ();
+  sent = TEST_DDS_LO0 + TEST_DDS_LO1
+    - test_write_queued (lo0) - test_write_queued (lo1);
+  snprintf (what, sizeof (what), "write wakeup 1, %d packets", sent);
+  test_check (sent == MIN (OSPF_WRITE_BUDGET, TEST_DDS_LO0 + TEST_DDS_LO1),
+	      what);
+  test_check (test_write_queued (lo1) == 0 && !lo1->on_write_q,
+	      "second interface served in turn");
+  test_check (ospf->t_write != NULL, "write thread rescheduled");
+
+  for (i = 1; ospf->t_write && i < TEST_DDS_LO0; i++)
+    test_write_wakeup ();
+  snprintf (what, sizeof (what), "all written in %d wakeups", i);
+  test_check (test_write_queued (lo0) == 0 && list_isempty (ospf->oi_write_q)
+	      && i == (TEST_DDS_LO0 + TEST_DDS_LO1 + OSPF_WRITE_BUDGET - 1)
+		      / OSPF_WRITE_BUDGET, what);
+
+  sent = test_write_received (rfd, TEST_DDS_LO0 + TEST_DDS_LO1);
+  snprintf (what, sizeof (what), "%d packets arrived", sent);
+  test_check (sent == TEST_DDS_LO0 + TEST_DDS_LO1, what);
+
+  close (fd);
+  close (rfd);
+  ospf->fd = -1;
+}
+
+int
+main (void)
+{
+  struct in_addr area_id = { .s_addr = 0 };
+  struct ospf_interface *lan, *lo0, *lo1;
+  int i;
+
+  ospf_master_init ();
+  master = om->master;
+  cmd_init (1);
+  vrf_init ();
+  ospf_if_init ();
+
+  ospf = XCALLOC (MTYPE_OSPF_TOP, sizeof (struct ospf));
+  ospf->router_id.s_addr = htonl (0x0a000001);
+  ospf->areas = list_new ();
+  ospf->oiflist = list_new ();
+  ospf->vlinks = list_new ();
+  ospf->oi_write_q = list_new ();
+  ospf->lsdb = ospf_lsdb_new ();
+  ospf->lsdb->ospf = ospf;
+  ospf->ls_rxmt_nbrs = vector_init (VECTOR_MIN_SIZE);
+  for (i = 0; i < OSPF_READ_BATCH; i++)
+    ospf->ibuf[i] = stream_new (OSPF_MAX_PACKET_SIZE+1);
+  listnode_add (om->ospf, ospf);
+  area = ospf_area_get (ospf, area_id, OSPF_AREA_ID_FORMAT_ADDRESS);
+
+  lan = test_if_new ("lan0", 1, 0xc0a80001, 24);
+  lo0 = test_if_new ("lo0", 2, 0x7f000001, 16);
+  lo1 = test_if_new ("lo1", 3, 0x7f010001, 16);
+
+  test_read (lan);
+  test_write (lo0, lo1);
+
+  test_if_free (lan);
+  test_if_free (lo0);
+  test_if_free (lo1);
+  ospf_lsdb_delete_all (area->lsdb);
+  ospf_lsdb_free (ospf->lsdb);
+
+  list_delete (area->oiflist);
+  route_table_finish (area->ranges);
+  ospf_opaque_type10_lsa_term (area);
+  ospf_lsdb_free (area->lsdb);
+  XFREE (MTYPE_OSPF_AREA, area);
+
+  listnode_delete (om->ospf, ospf);
+  for (i = 0; i < OSPF_READ_BATCH; i++)
+    stream_free (ospf->ibuf[i]);
+  vector_free (ospf->ls_rxmt_nbrs);
+  list_delete (ospf->oi_write_q);
+  list_delete (ospf->areas);
+  list_delete (ospf->oiflist);
+  list_delete (ospf->vlinks);
+  XFREE (MTYPE_OSPF_TOP, ospf);
+
+  printf ("%s\n", failed ? "failed" : "OK");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,417 @@
+/*
+ * OSPF retransmission list test
+ *
+ * Floods a database of AS-external-LSAs to the 60 full neighbors of a
+ * hub, has them all acknowledged, then floods newer instances of them
+ * and takes the old ones off the lists as installing them does.
+ * Checks the lists of every neighbor along the way, then times the same
+ * against the per-neighbor LSDBs the lists used to be, and compares the
+ * memory both take.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "thread.h"
+#include "memory.h"
+#include "linklist.h"
+#include "prefix.h"
+#include "table.h"
+#include "if.h"
+#include "vrf.h"
+#include "stream.h"
+#include "privs.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_interface.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_neighbor.h"
+#include "ospfd/ospf_nsm.h"
+#include "ospfd/ospf_ism.h"
+#include "ospfd/ospf_packet.h"
+#include "ospfd/ospf_flood.h"
+#include "ospfd/ospf_opaque.h"
+
+#define TEST_LSAS	10000
+#define TEST_NBRS	60
+
+/* need these to link in libospf */
+struct zebra_privs_t ospfd_privs;
+struct thread_master *master = NULL;
+
+static struct ospf_lsa *lsas[TEST_LSAS];
+static struct ospf_neighbor *nbrs[TEST_NBRS];
+
+static unsigned long
+bench_usec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start);
+}
+
+static struct ospf_lsa *
+test_lsa_new (struct ospf *ospf, int i, u_int32_t seqnum)
+{
+  struct ospf_lsa *lsa;
+  struct as_external_lsa *al;
+
+  lsa = ospf_lsa_new ();
+  lsa->data = ospf_lsa_data_new (OSPF_LSA_HEADER_SIZE + 16);
+  al = (struct as_external_lsa *) lsa->data;
+  al->header.type = OSPF_AS_EXTERNAL_LSA;
+  al->header.length = htons (OSPF_LSA_HEADER_SIZE + 16);
+  al->header.id.s_addr = htonl (0x40000000 + i * 256);
+  al->header.adv_router.s_addr = htonl (0x0a0000ff);
+  al->header.ls_seqnum = htonl (seqnum);
+  al->mask.s_addr = htonl (0xffffff00);
+  al->e[0].metric[2] = 20;
+  return lsa;
+}
+
+/* The hub: a broadcast interface on which we are DR, with the full
+   neighbors. */
+static struct ospf_interface *
+test_if_new (struct ospf *ospf, struct ospf_area *area)
+{
+  struct interface *ifp;
+  struct ospf_interface *oi;
+  struct ospf_neighbor *nbr;
+  struct prefix_ipv4 *p;
+  struct prefix key;
+  int n;
+
+  ifp = if_get_by_name ("hub0");
+  ifp->ifindex = 1;
+  ifp->mtu = 1500;
+  ifp->flags = IFF_UP | IFF_RUNNING | IFF_BROADCAST | IFF_MULTICAST;
+
+  p = prefix_ipv4_new ();
+  p->family = AF_INET;
+  p->prefix.s_addr = htonl (0xc0a80001);
+  p->prefixlen = 24;
+
+  oi = ospf_if_new (ospf, ifp, (struct prefix *) p);
+  oi->area = area;
+  oi->type = OSPF_IFTYPE_BROADCAST;
+  oi->state = ISM_DR;
+  listnode_add (area->oiflist, oi);
+  ospf_if_stream_set (oi);
+  oi->nbr_self = ospf_nbr_new (oi);
+  ospf_nbr_add_self (oi);
+
+  for (n = 0; n < TEST_NBRS; n++)
+    {
+      nbr = nbrs[n] = ospf_nbr_new (oi);
+      nbr->router_id.s_addr = htonl (0x0a000002 + n);
+      nbr->src.s_addr = htonl (0xc0a80002 + n);
+      nbr->address.family = AF_INET;
+      nbr->address.prefixlen = IPV4_MAX_BITLEN;
+      nbr->address.u.prefix4 = nbr->src;
+      nbr->state = NSM_Full;
+
+      key.family = AF_INET;
+      key.prefixlen = IPV4_MAX_BITLEN;
+      key.u.prefix4 = nbr->src;
+      route_node_get (oi->nbrs, &key)->info = nbr;
+    }
+  return oi;
+}
+
+static void
+test_if_free (struct ospf_interface *oi)
+{
+  struct interface *ifp = oi->ifp;
+  struct route_node *rn;
+
+  for (rn = route_top (oi->nbrs); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	ospf_nbr_free (rn->info);
+	rn->info = NULL;
+	route_unlock_node (rn);
+      }
+  route_table_finish (oi->nbrs);
+
+  ospf_if_stream_unset (oi);
+  ospf_ls_upd_queue_empty (oi);
+  route_table_finish (oi->ls_upd_queue);
+  list_free (oi->nbr_nbma);
+  list_free (oi->ls_ack);
+  list_free (oi->ls_ack_direct.ls_ack);
+  ospf_opaque_type9_lsa_term (oi);
+
+  listnode_delete (oi->ospf->oiflist, oi);
+  listnode_delete (oi->area->oiflist, oi);
+  prefix_ipv4_free ((struct prefix_ipv4 *) oi->address);
+  XFREE (MTYPE_OSPF_IF, oi);
+
+  if_delete (ifp);
+}
+
+/* The acknowledgement of an LSA, as read from an LS Ack. */
+static struct ospf_lsa *
+test_ack_new (struct ospf_lsa *lsa)
+{
+  struct ospf_lsa *ack;
+
+  ack = ospf_lsa_new ();
+  ack->data = ospf_lsa_data_new (OSPF_LSA_HEADER_SIZE);
+  memcpy (ack->data, lsa->data, OSPF_LSA_HEADER_SIZE);
+  return ack;
+}
+
+/* Every neighbor must have the LSAs of the database on its list, or
+   none. */
+static int
+test_check (int listed, const char *when)
+{
+  int failed = 0;
+  int i, n;
+
+  for (n = 0; n < TEST_NBRS; n++)
+    {
+      if (ospf_ls_retransmit_count (nbrs[n]) != (listed ? TEST_LSAS : 0))
+	failed++;
+      ospf_ls_retransmit_compact (nbrs[n]);
+      if (nbrs[n]->ls_rxmt.length != (listed ? TEST_LSAS : 0))
+	failed++;
+    }
+  for (i = 0; i < TEST_LSAS; i++)
+    {
+      if (lsas[i]->retransmit_counter != (listed ? TEST_NBRS : 0))
+	failed++;
+      if ((ospf_ls_retransmit_lookup (nbrs[i % TEST_NBRS], lsas[i])
+	   == lsas[i]) != listed)
+	failed++;
+    }
+
+  printf ("%s: %d neighbors with %lu LSAs to retransmit, %d differences\n",
+	  when, TEST_NBRS, ospf_ls_retransmit_count (nbrs[0]), failed);
+  return failed;
+}
+
+/* Flood, acknowledge, flood newer instances, as the lists do it now. */
+static unsigned long
+test_lists (struct ospf *ospf, int *failed)
+{
+  struct ospf_lsa *ack, *old;
+  struct timeval start;
+  unsigned long usec;
+  int i, n;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < TEST_LSAS; i++)
+    for (n = 0; n < TEST_NBRS; n++)
+      ospf_ls_retransmit_add (nbrs[n], lsas[i]);
+  usec = bench_usec (&start);
+  *failed += test_check (1, "flooded");
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (n = 0; n < TEST_NBRS; n++)
+    for (i = 0; i < TEST_LSAS; i++)
+      {
+	ack = test_ack_new (lsas[i]);
+	old = ospf_ls_retransmit_lookup (nbrs[n], ack);
+	if (old && ospf_lsa_more_recent (old, ack) == 0)
+	  ospf_ls_retransmit_delete (nbrs[n], old);
+	ospf_lsa_discard (ack);
+      }
+  usec += bench_usec (&start);
+  *failed += test_check (0, "acknowledged");
+
+  for (i = 0; i < TEST_LSAS; i++)
+    for (n = 0; n < TEST_NBRS; n++)
+      ospf_ls_retransmit_add (nbrs[n], lsas[i]);
+
+  /* Newer instances, flooded to all but the neighbor they came from,
+     then installed. */
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < TEST_LSAS; i++)
+    {
+      old = lsas[i];
+      lsas[i] = test_lsa_new (ospf, i, OSPF_INITIAL_SEQUENCE_NUMBER + 1);
+      for (n = 0; n < TEST_NBRS; n++)
+	if (n != i % TEST_NBRS)
+	  ospf_ls_retransmit_add (nbrs[n], lsas[i]);
+      ospf_ls_retransmit_delete_nbr_as (ospf, old);
+      ospf_lsdb_delete (ospf->lsdb, old);
+      ospf_lsdb_add (ospf->lsdb, lsas[i]);
+      ospf_lsa_discard (old);
+      ospf_ls_retransmit_add (nbrs[i % TEST_NBRS], lsas[i]);
+    }
+  usec += bench_usec (&start);
+  *failed += test_check (1, "replaced");
+
+  return usec;
+}
+
+/* The same, with the lists of the neighbors LSDBs as they used to be. */
+static unsigned long
+test_lsdbs (struct ospf *ospf, unsigned long *bytes)
+{
+  struct ospf_lsdb *rxmt[TEST_NBRS];
+  struct ospf_lsa *ack, *old, *lsr;
+  struct timeval start;
+  unsigned long usec, nodes;
+  int i, n, m;
+
+  nodes = mtype_stats_alloc (MTYPE_ROUTE_NODE);
+  for (n = 0; n < TEST_NBRS; n++)
+    rxmt[n] = ospf_lsdb_new ();
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < TEST_LSAS; i++)
+    for (n = 0; n < TEST_NBRS; n++)
+      if (ospf_lsa_more_recent (ospf_lsdb_lookup (rxmt[n], lsas[i]),
+				lsas[i]) < 0)
+	ospf_lsdb_add (rxmt[n], lsas[i]);
+  usec = bench_usec (&start);
+  *bytes = (mtype_stats_alloc (MTYPE_ROUTE_NODE) - nodes)
+    * sizeof (struct route_node)
+    + TEST_NBRS * (OSPF_MAX_LSA * sizeof (struct route_table)
+		   + sizeof (struct ospf_lsdb));
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (n = 0; n < TEST_NBRS; n++)
+    for (i = 0; i < TEST_LSAS; i++)
+      {
+	ack = test_ack_new (lsas[i]);
+	old = ospf_lsdb_lookup (rxmt[n], ack);
+	if (old && ospf_lsa_more_recent (old, ack) == 0)
+	  ospf_lsdb_delete (rxmt[n], old);
+	ospf_lsa_discard (ack);
+      }
+  usec += bench_usec (&start);
+
+  for (i = 0; i < TEST_LSAS; i++)
+    for (n = 0; n < TEST_NBRS; n++)
+      ospf_lsdb_add (rxmt[n], lsas[i]);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < TEST_LSAS; i++)
+    {
+      old = lsas[i];
+      lsas[i] = test_lsa_new (ospf, i, OSPF_INITIAL_SEQUENCE_NUMBER + 2);
+      for (n = 0; n < TEST_NBRS; n++)
+	if (n != i % TEST_NBRS)
+	  {
+	    if ((lsr = ospf_lsdb_lookup (rxmt[n], lsas[i])))
+	      ospf_lsdb_delete (rxmt[n], lsr);
+	    ospf_lsdb_add (rxmt[n], lsas[i]);
+	  }
+      /* Each neighbor looked at for the old instance. */
+      for (m = 0; m < TEST_NBRS; m++)
+	if ((lsr = ospf_lsdb_lookup (rxmt[m], old)) != NULL
+	    && lsr->data->ls_seqnum == old->data->ls_seqnum)
+	  ospf_lsdb_delete (rxmt[m], lsr);
+      ospf_lsdb_delete (ospf->lsdb, old);
+      ospf_lsdb_add (ospf->lsdb, lsas[i]);
+      ospf_lsa_discard (old);
+      ospf_lsdb_add (rxmt[i % TEST_NBRS], lsas[i]);
+    }
+  usec += bench_usec (&start);
+
+  for (n = 0; n < TEST_NBRS; n++)
+    {
+      ospf_lsdb_delete_all (rxmt[n]);
+      ospf_lsdb_free (rxmt[n]);
+    }
+  return usec;
+}
+
+int
+main (void)
+{
+  struct ospf *ospf;
+  struct ospf_area *area;
+  struct in_addr area_id = { .s_addr = 0 };
+  struct ospf_interface *oi;
+  struct timeval now;
+  unsigned long lists_us, lsdbs_us, lists_bytes, lsdbs_bytes;
+  int failed = 0;
+  int i, n;
+
+  ospf_master_init ();
+  master = om->master;
+  cmd_init (1);
+  vrf_init ();
+  ospf_if_init ();
+
+  /* New LSAs are aged from the time last read. */
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+
+  ospf = XCALLOC (MTYPE_OSPF_TOP, sizeof (struct ospf));
+  ospf->router_id.s_addr = htonl (0x0a000001);
+  ospf->areas = list_new ();
+  ospf->oiflist = list_new ();
+  ospf->vlinks = list_new ();
+  ospf->oi_write_q = list_new ();
+  ospf->lsdb = ospf_lsdb_new ();
+  ospf->lsdb->ospf = ospf;
+  ospf->ls_rxmt_nbrs = vector_init (VECTOR_MIN_SIZE);
+  listnode_add (om->ospf, ospf);
+  area = ospf_area_get (ospf, area_id, OSPF_AREA_ID_FORMAT_ADDRESS);
+  oi = test_if_new (ospf, area);
+
+  for (i = 0; i < TEST_LSAS; i++)
+    {
+      lsas[i] = test_lsa_new (ospf, i, OSPF_INITIAL_SEQUENCE_NUMBER);
+      ospf_lsdb_add (ospf->lsdb, lsas[i]);
+    }
+
+  lists_us = test_lists (ospf, &failed);
+  lists_bytes = TEST_LSAS * 2 * sizeof (u_int32_t);
+  for (n = 0; n < TEST_NBRS; n++)
+    lists_bytes += nbrs[n]->ls_rxmt.size * sizeof (struct ospf_lsa *);
+  for (n = 0; n < TEST_NBRS; n++)
+    ospf_ls_retransmit_clear (nbrs[n]);
+
+  lsdbs_us = test_lsdbs (ospf, &lsdbs_bytes);
+
+  printf ("%d LSAs to %d neighbors flooded, acknowledged, replaced: "
+	  "neighbor LSDBs %lu us, %lu bytes, lists %lu us, %lu bytes\n",
+	  TEST_LSAS, TEST_NBRS, lsdbs_us, lsdbs_bytes, lists_us, lists_bytes);
+
+  test_if_free (oi);
+  for (i = 0; i < TEST_LSAS; i++)
+    ospf_lsdb_delete (ospf->lsdb, lsas[i]);
+  ospf_lsdb_free (ospf->lsdb);
+
+  list_delete (area->oiflist);
+  route_table_finish (area->ranges);
+  ospf_opaque_type10_lsa_term (area);
+  ospf_lsdb_free (area->lsdb);
+  XFREE (MTYPE_OSPF_AREA, area);
+
+  listnode_delete (om->ospf, ospf);
+  vector_free (ospf->ls_rxmt_nbrs);
+  list_delete (ospf->oi_write_q);
+  list_delete (ospf->areas);
+  list_delete (ospf->oiflist);
+  list_delete (ospf->vlinks);
+  XFREE (MTYPE_OSPF_TOP, ospf);
+
+  printf ("%s\n", failed ? "failed" : "OK");
+  return failed ? 1 : 0;
+}
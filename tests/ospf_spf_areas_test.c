@@ -0,0 +1,513 @@
+/*
+ * OSPF multi-area SPF test
+ *
+ * Builds a router attached to many areas, each a random topology of
+ * routers joined by point-to-point links, twice: once calculating the
+ * trees of the areas in turn, once on threads.  The routes of both
+ * must be the same, from scratch and after changes to random areas.
+ * Then times both.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "memory.h"
+#include "linklist.h"
+#include "prefix.h"
+#include "table.h"
+#include "if.h"
+#include "privs.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_interface.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_spf.h"
+#include "ospfd/ospf_route.h"
+#include "ospfd/ospf_opaque.h"
+
+#include "prng.h"
+
+#define TEST_AREAS	16
+#define TEST_ROUTERS	600
+#define TEST_ROUNDS	30
+#define TEST_THREADS	4
+
+/* need these to link in libospf */
+struct zebra_privs_t ospfd_privs;
+struct thread_master *master = NULL;
+
+/* Router i of an area links to router tree[i] below it, so the area is
+   connected, and to router extra[i] at random.  The calculating router
+   is router 0 of every area, on a broadcast network with routers 1 and
+   2. */
+struct test_area
+{
+  int tree[TEST_ROUTERS];
+  int extra[TEST_ROUTERS];
+  u_int16_t metric[TEST_ROUTERS][2];
+  u_int32_t seq[TEST_ROUTERS];
+  u_int32_t net_seq;
+};
+
+static struct test_area world[TEST_AREAS];
+
+/* The same router twice: calculating in turn, and on threads. */
+static struct ospf *instances[2];
+
+static struct prng *prng;
+
+static unsigned long
+bench_usec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start);
+}
+
+static struct in_addr
+router_id (int k, int i)
+{
+  struct in_addr id;
+
+  id.s_addr = htonl (i ? 0x0a000000 | (k << 16) | i : 0x01010101);
+  return id;
+}
+
+static struct in_addr
+net_id (int k)
+{
+  struct in_addr id;
+
+  id.s_addr = htonl (0xac100001 | (k << 8));
+  return id;
+}
+
+static void
+test_link_add (u_char **p, struct in_addr id, struct in_addr data,
+	       u_char type, u_int16_t metric)
+{
+  struct router_lsa_link *l = (struct router_lsa_link *) *p;
+
+  l->link_id = id;
+  l->link_data = data;
+  l->m[0].type = type;
+  l->m[0].tos_count = 0;
+  l->m[0].metric = htons (metric);
+  *p += OSPF_ROUTER_LSA_LINK_SIZE;
+}
+
+static void
+test_lsa_install (struct ospf_area *area, struct lsa_header *data)
+{
+  struct ospf_lsa *lsa, *old;
+
+  lsa = ospf_lsa_new ();
+  lsa->data = ospf_lsa_data_dup (data);
+  lsa->area = area;
+  lsa->stat = LSA_SPF_NOT_EXPLORED;
+
+  old = ospf_lsdb_lookup (area->lsdb, lsa);
+  ospf_spf_lsa_index (lsa);
+  ospf_spf_lsa_update (area, old, lsa);
+  ospf_lsdb_add (area->lsdb, lsa);
+  if (old)
+    ospf_lsa_discard (old);
+
+  if (IPV4_ADDR_SAME (&data->id, &area->ospf->router_id)
+      && data->type == OSPF_ROUTER_LSA)
+    {
+      ospf_lsa_unlock (&area->router_lsa_self);
+      area->router_lsa_self = ospf_lsa_lock (lsa);
+    }
+}
+
+/* Area k of an instance, in the order they were created. */
+static struct ospf_area *
+test_area (int w, int k)
+{
+  struct listnode *node = listhead (instances[w]->areas);
+
+  while (k--)
+    node = listnextnode (node);
+  return listgetdata (node);
+}
+
+static void
+test_install (int k, struct lsa_header *h, u_char type, struct in_addr id,
+	      struct in_addr adv_router, u_int32_t seq, u_char *p)
+{
+  int w;
+
+  h->ls_age = 0;
+  h->type = type;
+  h->id = id;
+  h->adv_router = adv_router;
+  h->ls_seqnum = htonl (OSPF_INITIAL_SEQUENCE_NUMBER + seq);
+  h->length = htons (p - (u_char *) h);
+
+  for (w = 0; w < 2; w++)
+    test_lsa_install (test_area (w, k), h);
+}
+
+static void
+router_install (int k, int i)
+{
+  u_char buf[OSPF_MAX_LSA_SIZE];
+  struct router_lsa *rlsa = (struct router_lsa *) buf;
+  struct test_area *a = &world[k];
+  struct in_addr addr, mask;
+  u_char *p;
+  int links = 0;
+  int j;
+
+  memset (buf, 0, sizeof (buf));
+  p = buf + OSPF_LSA_HEADER_SIZE + 4;
+
+  if (i <= 2)
+    {
+      addr.s_addr = htonl (ntohl (net_id (k).s_addr) + i);
+      test_link_add (&p, net_id (k), addr, LSA_LINK_TYPE_TRANSIT, 1);
+      links++;
+    }
+
+  for (j = 3; j < TEST_ROUTERS; j++)
+    {
+      if (a->tree[j] == i || a->extra[j] == i)
+	{
+	  addr.s_addr = htonl (0x0b000000 | (k << 16) | j);
+	  test_link_add (&p, router_id (k, j), addr,
+			 LSA_LINK_TYPE_POINTOPOINT, a->metric[j][1]);
+	  links++;
+	}
+      if (j == i)
+	{
+	  addr.s_addr = htonl (0x0b000000 | (k << 16) | j);
+	  test_link_add (&p, router_id (k, a->tree[j]), addr,
+			 LSA_LINK_TYPE_POINTOPOINT, a->metric[j][0]);
+	  test_link_add (&p, router_id (k, a->extra[j]), addr,
+			 LSA_LINK_TYPE_POINTOPOINT, a->metric[j][0]);
+	  links += 2;
+	}
+    }
+
+  if (i)
+    {
+      addr.s_addr = htonl (0x64000000 | (k << 16) | (i << 4));
+      mask.s_addr = htonl (0xfffffff0);
+      test_link_add (&p, addr, mask, LSA_LINK_TYPE_STUB, 1 + i % 7);
+      links++;
+    }
+
+  assert (p <= buf + sizeof (buf));
+  rlsa->links = htons (links);
+  test_install (k, &rlsa->header, OSPF_ROUTER_LSA, router_id (k, i),
+		router_id (k, i), a->seq[i]++, p);
+}
+
+static void
+network_install (int k)
+{
+  u_char buf[OSPF_MAX_LSA_SIZE];
+  struct network_lsa *nlsa = (struct network_lsa *) buf;
+  struct in_addr *r;
+  u_char *p;
+  int i;
+
+  memset (buf, 0, sizeof (buf));
+  nlsa->mask.s_addr = htonl (0xffffff00);
+  p = buf + OSPF_LSA_HEADER_SIZE + 4;
+  for (i = 0; i <= 2; i++)
+    {
+      r = (struct in_addr *) p;
+      *r = router_id (k, i);
+      p += sizeof (struct in_addr);
+    }
+
+  test_install (k, &nlsa->header, OSPF_NETWORK_LSA, net_id (k),
+		router_id (k, 1), world[k].net_seq++, p);
+}
+
+static struct ospf *
+test_instance_new (unsigned int threads)
+{
+  struct ospf *ospf;
+  struct ospf_area *area;
+  struct ospf_interface *oi;
+  struct in_addr area_id;
+  int k;
+
+  ospf = XCALLOC (MTYPE_OSPF_TOP, sizeof (struct ospf));
+  ospf->router_id = router_id (0, 0);
+  ospf->areas = list_new ();
+  ospf->oiflist = list_new ();
+  ospf->vlinks = list_new ();
+  ospf->spf_threads = threads;
+  listnode_add (om->ospf, ospf);
+
+  for (k = 0; k < TEST_AREAS; k++)
+    {
+      area_id.s_addr = htonl (k);
+      area = ospf_area_get (ospf, area_id, OSPF_AREA_ID_FORMAT_DECIMAL);
+
+      oi = XCALLOC (MTYPE_OSPF_IF, sizeof (struct ospf_interface));
+      oi->ifp = XCALLOC (MTYPE_IF, sizeof (struct interface));
+      snprintf (oi->ifp->name, sizeof (oi->ifp->name), "eth%d", k);
+      oi->ifp->ifindex = k + 1;
+      oi->ospf = ospf;
+      oi->area = area;
+      oi->type = OSPF_IFTYPE_BROADCAST;
+      oi->lsa_pos_beg = 0;
+      oi->lsa_pos_end = 1;
+      listnode_add (area->oiflist, oi);
+    }
+  return ospf;
+}
+
+static void
+test_instance_free (struct ospf *ospf)
+{
+  struct ospf_area *area;
+  struct ospf_interface *oi;
+  struct listnode *node, *nnode, *onode;
+  struct route_node *rn;
+  struct ospf_lsa *lsa;
+
+  for (ALL_LIST_ELEMENTS (ospf->areas, node, nnode, area))
+    {
+      ospf_spf_area_finish (area);
+      ospf_lsa_unlock (&area->router_lsa_self);
+      LSDB_LOOP (ROUTER_LSDB (area), rn, lsa)
+	{
+	  ospf_lsdb_delete (area->lsdb, lsa);
+	  ospf_lsa_discard (lsa);
+	}
+      LSDB_LOOP (NETWORK_LSDB (area), rn, lsa)
+	{
+	  ospf_lsdb_delete (area->lsdb, lsa);
+	  ospf_lsa_discard (lsa);
+	}
+      ospf_opaque_type10_lsa_term (area);
+      ospf_lsdb_free (area->lsdb);
+
+      for (ALL_LIST_ELEMENTS_RO (area->oiflist, onode, oi))
+	{
+	  XFREE (MTYPE_IF, oi->ifp);
+	  XFREE (MTYPE_OSPF_IF, oi);
+	}
+      list_delete (area->oiflist);
+      route_table_finish (area->ranges);
+      XFREE (MTYPE_OSPF_AREA, area);
+    }
+
+  listnode_delete (om->ospf, ospf);
+  list_delete (ospf->areas);
+  list_delete (ospf->oiflist);
+  list_delete (ospf->vlinks);
+  XFREE (MTYPE_OSPF_TOP, ospf);
+}
+
+static void
+test_world (void)
+{
+  struct test_area *a;
+  int k, i;
+
+  instances[0] = test_instance_new (1);
+  instances[1] = test_instance_new (TEST_THREADS);
+
+  for (k = 0; k < TEST_AREAS; k++)
+    {
+      a = &world[k];
+      memset (a, 0, sizeof (*a));
+      for (i = 3; i < TEST_ROUTERS; i++)
+	{
+	  a->tree[i] = 1 + prng_rand (prng) % (i - 1);
+	  a->extra[i] = 1 + prng_rand (prng) % (TEST_ROUTERS - 1);
+	  if (a->extra[i] == i)
+	    a->extra[i] = a->tree[i];
+	  a->metric[i][0] = 1 + prng_rand (prng) % 10;
+	  a->metric[i][1] = 1 + prng_rand (prng) % 10;
+	}
+
+      network_install (k);
+      for (i = 0; i < TEST_ROUTERS; i++)
+	router_install (k, i);
+    }
+}
+
+/* A link cost changes in a random area. */
+static void
+test_change (void)
+{
+  int k = prng_rand (prng) % TEST_AREAS;
+  int i = 3 + prng_rand (prng) % (TEST_ROUTERS - 3);
+  struct test_area *a = &world[k];
+
+  a->metric[i][prng_rand (prng) % 2] = 1 + prng_rand (prng) % 10;
+  router_install (k, i);
+  router_install (k, a->tree[i]);
+  router_install (k, a->extra[i]);
+}
+
+static int
+test_paths_same (struct list *l1, struct list *l2)
+{
+  struct listnode *n1, *n2;
+  struct ospf_path *p1, *p2;
+
+  if (listcount (l1) != listcount (l2))
+    return 0;
+  for (ALL_LIST_ELEMENTS_RO (l1, n1, p1))
+    {
+      for (ALL_LIST_ELEMENTS_RO (l2, n2, p2))
+	if (IPV4_ADDR_SAME (&p1->nexthop, &p2->nexthop)
+	    && p1->ifindex == p2->ifindex)
+	  break;
+      if (n2 == NULL)
+	return 0;
+    }
+  return 1;
+}
+
+static int
+test_route_same (struct ospf_route *or1, struct ospf_route *or2)
+{
+  return or1->cost == or2->cost
+	 && or1->type == or2->type
+	 && or1->path_type == or2->path_type
+	 && IPV4_ADDR_SAME (&or1->u.std.area_id, &or2->u.std.area_id)
+	 && test_paths_same (or1->paths, or2->paths);
+}
+
+/* Networks hold a route, routers a list of them, one per area. */
+static int
+test_tables_same (struct route_table *t1, struct route_table *t2, int rtrs)
+{
+  struct route_node *rn, *rn2;
+  struct listnode *n1, *n2;
+  int count1 = 0, count2 = 0;
+  int same = 1;
+
+  for (rn = route_top (t1); rn; rn = route_next (rn))
+    {
+      if (rn->info == NULL)
+	continue;
+      count1++;
+
+      rn2 = route_node_lookup (t2, &rn->p);
+      if (rn2 == NULL || rn2->info == NULL)
+	{
+	  same = 0;
+	  continue;
+	}
+      route_unlock_node (rn2);
+
+      if (!rtrs)
+	same &= test_route_same (rn->info, rn2->info);
+      else if (listcount ((struct list *) rn->info)
+	       != listcount ((struct list *) rn2->info))
+	same = 0;
+      else
+	for (n1 = listhead ((struct list *) rn->info),
+	     n2 = listhead ((struct list *) rn2->info);
+	     n1; n1 = listnextnode (n1), n2 = listnextnode (n2))
+	  same &= test_route_same (listgetdata (n1), listgetdata (n2));
+    }
+
+  for (rn = route_top (t2); rn; rn = route_next (rn))
+    if (rn->info)
+      count2++;
+
+  return same && count1 == count2;
+}
+
+/* Calculate both instances, incrementally or from scratch, and compare
+   the routes. */
+static int
+test_calculate (int full, unsigned long usec[2])
+{
+  struct route_table *tables[2], *rtrs[2];
+  struct timeval start;
+  int same, w;
+
+  for (w = 0; w < 2; w++)
+    {
+      tables[w] = route_table_init ();
+      rtrs[w] = route_table_init ();
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+      ospf_spf_calculate_areas (instances[w], tables[w], rtrs[w], full);
+      usec[w] += bench_usec (&start);
+    }
+
+  same = test_tables_same (tables[0], tables[1], 0)
+	 && test_tables_same (rtrs[0], rtrs[1], 1)
+	 && route_table_count (tables[0]) > TEST_AREAS * (TEST_ROUTERS - 1);
+
+  for (w = 0; w < 2; w++)
+    {
+      ospf_route_table_free (tables[w]);
+      ospf_rtrs_free (rtrs[w]);
+    }
+  return !same;
+}
+
+int
+main (void)
+{
+  unsigned long full[2] = { 0, 0 }, incremental[2] = { 0, 0 };
+  struct timeval now;
+  int failed = 0;
+  int round;
+
+  ospf_master_init ();
+  master = om->master;
+  prng = prng_new (0);
+
+  /* New LSAs are aged from the time last read. */
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+
+  test_world ();
+
+  for (round = 0; round < TEST_ROUNDS; round++)
+    {
+      failed += test_calculate (1, full);
+      test_change ();
+      test_change ();
+      failed += test_calculate (0, incremental);
+    }
+
+  printf ("%d areas of %d routers, %d rounds, %d differences\n",
+	  TEST_AREAS, TEST_ROUTERS, TEST_ROUNDS, failed);
+  printf ("from scratch: in turn %lu ms, on %d threads %lu ms\n",
+	  full[0] / 1000, TEST_THREADS, full[1] / 1000);
+  printf ("incremental: in turn %lu ms, on %d threads %lu ms\n",
+	  incremental[0] / 1000, TEST_THREADS, incremental[1] / 1000);
+
+  test_instance_free (instances[0]);
+  test_instance_free (instances[1]);
+  ospf_spf_workers_finish ();
+  prng_free (prng);
+
+  printf ("%s\n", failed ? "failed" : "OK");
+  return failed ? 1 : 0;
+}
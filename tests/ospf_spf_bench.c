@@ -0,0 +1,507 @@
+/*
+ * OSPF SPF benchmark
+ *
+ * Builds an area of 5000 routers joined by point-to-point links, some
+ * of them hubs with many links, and by broadcast networks, then times
+ * calculating its shortest-path tree and intra-area routes from
+ * scratch.  The costs of the routes must be those of a plain Dijkstra
+ * over the same graph.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "memory.h"
+#include "linklist.h"
+#include "prefix.h"
+#include "table.h"
+#include "if.h"
+#include "privs.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_interface.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_spf.h"
+#include "ospfd/ospf_route.h"
+#include "ospfd/ospf_opaque.h"
+
+#include "prng.h"
+
+#define BENCH_ROUTERS	5000
+#define BENCH_NETS	500
+#define BENCH_HUBS	100
+#define BENCH_EDGES	(BENCH_ROUTERS * 3)
+#define BENCH_RUNS	50
+
+/* need these to link in libospf */
+struct zebra_privs_t ospfd_privs;
+struct thread_master *master = NULL;
+
+/* Router i links to router tree[i] below it, so the area is connected,
+   and two more, often a hub.  A quarter of the routers are also on a
+   network.  The calculating router is router 0, on networks 0 and 1. */
+struct bench_edge
+{
+  int a, b;
+  u_int16_t metric[2];
+};
+
+static struct bench_edge edges[BENCH_EDGES];
+static int nedges;
+static int router_net[BENCH_ROUTERS];
+static int net_members[BENCH_NETS];
+static u_int16_t router_net_cost[BENCH_ROUTERS];
+
+/* Edges of each router, as indices into edges. */
+static int adj_start[BENCH_ROUTERS + 1];
+static int adj[BENCH_EDGES * 2];
+
+/* Distances from the calculating router, routers then networks. */
+static u_int32_t dist[BENCH_ROUTERS + BENCH_NETS];
+
+static struct ospf_area *area;
+static struct prng *prng;
+
+static unsigned long
+bench_usec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start);
+}
+
+static struct in_addr
+router_id (int i)
+{
+  struct in_addr id;
+
+  id.s_addr = htonl (0x0a000001 + i);
+  return id;
+}
+
+static struct in_addr
+net_id (int n)
+{
+  struct in_addr id;
+
+  id.s_addr = htonl (0xac100001 | (n << 8));
+  return id;
+}
+
+static struct in_addr
+stub_prefix (int i)
+{
+  struct in_addr p;
+
+  p.s_addr = htonl (0x64000000 | (i << 4));
+  return p;
+}
+
+static u_int16_t
+stub_metric (int i)
+{
+  return 1 + i % 5;
+}
+
+static void
+bench_link_add (u_char **p, struct in_addr id, struct in_addr data,
+		u_char type, u_int16_t metric)
+{
+  struct router_lsa_link *l = (struct router_lsa_link *) *p;
+
+  l->link_id = id;
+  l->link_data = data;
+  l->m[0].type = type;
+  l->m[0].tos_count = 0;
+  l->m[0].metric = htons (metric);
+  *p += OSPF_ROUTER_LSA_LINK_SIZE;
+}
+
+static void
+bench_lsa_install (struct lsa_header *h, u_char type, struct in_addr id,
+		   struct in_addr adv_router, u_char *p)
+{
+  struct ospf_lsa *lsa;
+
+  h->type = type;
+  h->id = id;
+  h->adv_router = adv_router;
+  h->ls_seqnum = htonl (OSPF_INITIAL_SEQUENCE_NUMBER);
+  h->length = htons (p - (u_char *) h);
+
+  lsa = ospf_lsa_new ();
+  lsa->data = ospf_lsa_data_dup (h);
+  lsa->area = area;
+  ospf_spf_lsa_index (lsa);
+  ospf_lsdb_add (area->lsdb, lsa);
+
+  if (type == OSPF_ROUTER_LSA && IPV4_ADDR_SAME (&id, &area->ospf->router_id))
+    area->router_lsa_self = ospf_lsa_lock (lsa);
+}
+
+static void
+router_install (int i)
+{
+  static u_char buf[OSPF_MAX_LSA_SIZE];
+  struct router_lsa *rlsa = (struct router_lsa *) buf;
+  struct in_addr addr, mask;
+  struct bench_edge *e;
+  u_char *p;
+  int links = 0;
+  int k, side;
+
+  memset (buf, 0, sizeof (buf));
+  p = buf + OSPF_LSA_HEADER_SIZE + 4;
+
+  if (i == 0)
+    for (k = 0; k < 2; k++)
+      {
+	addr.s_addr = htonl (ntohl (net_id (k).s_addr) + 1);
+	bench_link_add (&p, net_id (k), addr, LSA_LINK_TYPE_TRANSIT, 1);
+	links++;
+      }
+  else if (router_net[i] >= 0)
+    {
+      addr.s_addr = htonl (ntohl (net_id (router_net[i]).s_addr) + 1 + i);
+      bench_link_add (&p, net_id (router_net[i]), addr,
+		      LSA_LINK_TYPE_TRANSIT, router_net_cost[i]);
+      links++;
+    }
+
+  for (k = adj_start[i]; k < adj_start[i + 1]; k++)
+    {
+      e = &edges[adj[k]];
+      side = e->b == i;
+      addr.s_addr = htonl (0x0b000000 | (adj[k] << 1) | side);
+      bench_link_add (&p, router_id (side ? e->a : e->b), addr,
+		      LSA_LINK_TYPE_POINTOPOINT, e->metric[side]);
+      links++;
+    }
+
+  if (i)
+    {
+      mask.s_addr = htonl (0xfffffff0);
+      bench_link_add (&p, stub_prefix (i), mask, LSA_LINK_TYPE_STUB,
+		      stub_metric (i));
+      links++;
+    }
+
+  assert (p <= buf + sizeof (buf));
+  rlsa->links = htons (links);
+  bench_lsa_install (&rlsa->header, OSPF_ROUTER_LSA, router_id (i),
+		     router_id (i), p);
+}
+
+static void
+network_install (int n)
+{
+  static u_char buf[OSPF_MAX_LSA_SIZE];
+  struct network_lsa *nlsa = (struct network_lsa *) buf;
+  struct in_addr *r;
+  u_char *p;
+  int i, dr = -1;
+
+  if (net_members[n] == 0)
+    return;
+
+  memset (buf, 0, sizeof (buf));
+  nlsa->mask.s_addr = htonl (0xffffff00);
+  p = buf + OSPF_LSA_HEADER_SIZE + 4;
+  for (i = 0; i < BENCH_ROUTERS; i++)
+    if (router_net[i] == n || (i == 0 && n < 2))
+      {
+	r = (struct in_addr *) p;
+	*r = router_id (i);
+	p += sizeof (struct in_addr);
+	assert (p <= buf + sizeof (buf));
+	if (dr < 0)
+	  dr = i;
+      }
+
+  bench_lsa_install (&nlsa->header, OSPF_NETWORK_LSA, net_id (n),
+		     router_id (dr), p);
+}
+
+static void
+bench_world (void)
+{
+  struct ospf *ospf;
+  struct ospf_interface *oi;
+  struct in_addr area_id = { .s_addr = 0 };
+  int i, k, e;
+
+  ospf = XCALLOC (MTYPE_OSPF_TOP, sizeof (struct ospf));
+  ospf->router_id = router_id (0);
+  ospf->areas = list_new ();
+  ospf->oiflist = list_new ();
+  ospf->vlinks = list_new ();
+  listnode_add (om->ospf, ospf);
+  area = ospf_area_get (ospf, area_id, OSPF_AREA_ID_FORMAT_ADDRESS);
+
+  for (k = 0; k < 2; k++)
+    {
+      oi = XCALLOC (MTYPE_OSPF_IF, sizeof (struct ospf_interface));
+      oi->ifp = XCALLOC (MTYPE_IF, sizeof (struct interface));
+      snprintf (oi->ifp->name, sizeof (oi->ifp->name), "eth%d", k);
+      oi->ifp->ifindex = k + 1;
+      oi->ospf = ospf;
+      oi->area = area;
+      oi->type = OSPF_IFTYPE_BROADCAST;
+      oi->lsa_pos_beg = k;
+      oi->lsa_pos_end = k + 1;
+      listnode_add (area->oiflist, oi);
+    }
+
+  for (i = 0; i < BENCH_ROUTERS; i++)
+    {
+      router_net[i] = -1;
+      if (i && prng_rand (prng) % 4 == 0)
+	{
+	  router_net[i] = prng_rand (prng) % BENCH_NETS;
+	  net_members[router_net[i]]++;
+	}
+      router_net_cost[i] = 1 + prng_rand (prng) % 10;
+    }
+
+  for (i = 2; i < BENCH_ROUTERS; i++)
+    for (k = 0; k < 3; k++)
+      {
+	struct bench_edge *be = &edges[nedges];
+
+	be->a = i;
+	if (k == 0)
+	  be->b = 1 + prng_rand (prng) % (i - 1);
+	else if (prng_rand (prng) % 3 == 0)
+	  be->b = 1 + prng_rand (prng) % BENCH_HUBS;
+	else
+	  be->b = 1 + prng_rand (prng) % (BENCH_ROUTERS - 1);
+	if (be->b == i)
+	  continue;
+	be->metric[0] = 1 + prng_rand (prng) % 10;
+	be->metric[1] = 1 + prng_rand (prng) % 10;
+	nedges++;
+      }
+
+  for (e = 0; e < nedges; e++)
+    {
+      adj_start[edges[e].a + 1]++;
+      adj_start[edges[e].b + 1]++;
+    }
+  for (i = 0; i < BENCH_ROUTERS; i++)
+    adj_start[i + 1] += adj_start[i];
+  {
+    int fill[BENCH_ROUTERS];
+
+    memcpy (fill, adj_start, sizeof (fill));
+    for (e = 0; e < nedges; e++)
+      {
+	adj[fill[edges[e].a]++] = e;
+	adj[fill[edges[e].b]++] = e;
+      }
+  }
+
+  for (i = 0; i < BENCH_NETS; i++)
+    network_install (i);
+  for (i = 0; i < BENCH_ROUTERS; i++)
+    router_install (i);
+}
+
+static void
+bench_world_free (void)
+{
+  struct ospf *ospf = area->ospf;
+  struct ospf_interface *oi;
+  struct listnode *node;
+  struct route_node *rn;
+  struct ospf_lsa *lsa;
+
+  ospf_spf_area_finish (area);
+  ospf_lsa_unlock (&area->router_lsa_self);
+  LSDB_LOOP (ROUTER_LSDB (area), rn, lsa)
+    {
+      ospf_lsdb_delete (area->lsdb, lsa);
+      ospf_lsa_discard (lsa);
+    }
+  LSDB_LOOP (NETWORK_LSDB (area), rn, lsa)
+    {
+      ospf_lsdb_delete (area->lsdb, lsa);
+      ospf_lsa_discard (lsa);
+    }
+  ospf_opaque_type10_lsa_term (area);
+  ospf_lsdb_free (area->lsdb);
+
+  for (ALL_LIST_ELEMENTS_RO (area->oiflist, node, oi))
+    {
+      XFREE (MTYPE_IF, oi->ifp);
+      XFREE (MTYPE_OSPF_IF, oi);
+    }
+  list_delete (area->oiflist);
+  route_table_finish (area->ranges);
+  XFREE (MTYPE_OSPF_AREA, area);
+
+  listnode_delete (om->ospf, ospf);
+  list_delete (ospf->areas);
+  list_delete (ospf->oiflist);
+  list_delete (ospf->vlinks);
+  XFREE (MTYPE_OSPF_TOP, ospf);
+}
+
+/* Plain Dijkstra: routers reach networks at the cost of their link,
+   networks their routers at no cost. */
+static void
+bench_reference (void)
+{
+  static u_char done[BENCH_ROUTERS + BENCH_NETS];
+  int nodes = BENCH_ROUTERS + BENCH_NETS;
+  struct bench_edge *e;
+  int i, k, v, w, side;
+  u_int32_t d;
+
+  for (i = 0; i < nodes; i++)
+    dist[i] = UINT32_MAX;
+  dist[0] = 0;
+
+  for (;;)
+    {
+      v = -1;
+      for (i = 0; i < nodes; i++)
+	if (!done[i] && dist[i] != UINT32_MAX && (v < 0 || dist[i] < dist[v]))
+	  v = i;
+      if (v < 0)
+	break;
+      done[v] = 1;
+
+      if (v >= BENCH_ROUTERS)
+	{
+	  for (w = 0; w < BENCH_ROUTERS; w++)
+	    if (router_net[w] == v - BENCH_ROUTERS && dist[v] < dist[w])
+	      dist[w] = dist[v];
+	  continue;
+	}
+
+      if (v == 0)
+	for (k = 0; k < 2; k++)
+	  if (net_members[k] && dist[BENCH_ROUTERS + k] > 1)
+	    dist[BENCH_ROUTERS + k] = 1;
+      if (v && router_net[v] >= 0)
+	{
+	  d = dist[v] + router_net_cost[v];
+	  if (d < dist[BENCH_ROUTERS + router_net[v]])
+	    dist[BENCH_ROUTERS + router_net[v]] = d;
+	}
+      for (k = adj_start[v]; k < adj_start[v + 1]; k++)
+	{
+	  e = &edges[adj[k]];
+	  side = e->b == v;
+	  w = side ? e->a : e->b;
+	  d = dist[v] + e->metric[side];
+	  if (d < dist[w])
+	    dist[w] = d;
+	}
+    }
+}
+
+static u_int32_t
+bench_route_cost (struct route_table *rt, struct in_addr addr, int len)
+{
+  struct prefix_ipv4 p;
+  struct route_node *rn;
+  struct ospf_route *or;
+  u_int32_t cost = UINT32_MAX;
+
+  p.family = AF_INET;
+  p.prefix = addr;
+  p.prefixlen = len;
+  apply_mask_ipv4 (&p);
+  rn = route_node_lookup (rt, (struct prefix *) &p);
+  if (rn)
+    {
+      if ((or = rn->info) != NULL)
+	cost = or->cost;
+      route_unlock_node (rn);
+    }
+  return cost;
+}
+
+static int
+bench_check (struct route_table *rt)
+{
+  int failed = 0;
+  int i;
+
+  for (i = 1; i < BENCH_ROUTERS; i++)
+    if (bench_route_cost (rt, stub_prefix (i), 28)
+	!= dist[i] + stub_metric (i))
+      failed++;
+  for (i = 0; i < BENCH_NETS; i++)
+    if (bench_route_cost (rt, net_id (i), 24) != dist[BENCH_ROUTERS + i])
+      failed++;
+  return failed;
+}
+
+int
+main (void)
+{
+  struct route_table *table, *rtrs;
+  struct timeval start, now;
+  unsigned long usec = 0, tree = 0, routes = 0;
+  int failed = 0;
+  int run;
+
+  ospf_master_init ();
+  master = om->master;
+  prng = prng_new (0);
+
+  /* New LSAs are aged from the time last read. */
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+
+  bench_world ();
+  bench_reference ();
+
+  for (run = 0; run < BENCH_RUNS; run++)
+    {
+      table = route_table_init ();
+      rtrs = route_table_init ();
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+      ospf_spf_calculate_areas (area->ospf, table, rtrs, 1);
+      usec += bench_usec (&start);
+      tree += area->ospf->spf_time.spf;
+      routes += area->ospf->spf_time.intra;
+
+      if (run == 0)
+	failed += bench_check (table);
+      ospf_route_table_free (table);
+      ospf_rtrs_free (rtrs);
+    }
+
+  printf ("%d routers, %d networks, %d links, %d runs, %d differences\n",
+	  BENCH_ROUTERS, BENCH_NETS, nedges, BENCH_RUNS, failed);
+  printf ("per calculation: %lu us, tree %lu us, routes %lu us\n",
+	  usec / BENCH_RUNS, tree / BENCH_RUNS, routes / BENCH_RUNS);
+
+  bench_world_free ();
+  prng_free (prng);
+
+  printf ("%s\n", failed ? "failed" : "OK");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,606 @@
+/*
+ * OSPF incremental SPF test
+ *
+ * Builds a random area of routers joined by point-to-point links and
+ * broadcast networks, then changes it one LSA at a time: link costs,
+ * links and networks coming and going, stub networks, router flags,
+ * flushed and refreshed LSAs.  After each change the routes of an area
+ * calculated incrementally must be those of the same area calculated
+ * from scratch.  Then times both on a larger area.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "memory.h"
+#include "linklist.h"
+#include "prefix.h"
+#include "table.h"
+#include "if.h"
+#include "privs.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_interface.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_spf.h"
+#include "ospfd/ospf_route.h"
+#include "ospfd/ospf_opaque.h"
+
+#include "prng.h"
+
+#define TEST_ROUTERS	300
+#define TEST_NETS	40
+#define TEST_ROUNDS	400
+#define BENCH_ROUTERS	1500
+#define BENCH_NETS	150
+#define BENCH_ROUNDS	200
+
+#define TEST_ROUTERS_MAX	BENCH_ROUTERS
+#define TEST_STUBS_MAX		3
+
+/* need these to link in libospf */
+struct zebra_privs_t ospfd_privs;
+struct thread_master *master = NULL;
+
+/* A router is in up to two networks; the first router, the calculating
+   one, is in the first two and has no other links. */
+struct test_router
+{
+  u_int32_t seq;
+  u_char flushed;
+  u_char flags;
+  u_char stubs;
+  u_int16_t stub_metric;
+  int nets[2];
+  u_int16_t net_cost[2];
+};
+
+struct test_edge
+{
+  int a, b;
+  u_int16_t metric[2];
+  int up;
+};
+
+static struct test_router routers[TEST_ROUTERS_MAX];
+static struct test_edge edges[TEST_ROUTERS_MAX * 2];
+static u_int32_t net_seq[BENCH_NETS];
+static int nrouters, nnets, nedges;
+
+/* The same area twice: calculated incrementally, and from scratch. */
+static struct ospf_area *areas[2];
+
+static struct prng *prng;
+
+static unsigned long
+bench_usec (struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start);
+}
+
+static struct in_addr
+router_id (int i)
+{
+  struct in_addr id;
+
+  id.s_addr = htonl (0x0a000001 + i);
+  return id;
+}
+
+static struct in_addr
+net_id (int n)
+{
+  struct in_addr id;
+
+  id.s_addr = htonl (0xac100001 | (n << 8));
+  return id;
+}
+
+static struct in_addr
+net_addr (int n, int i)
+{
+  struct in_addr addr;
+
+  addr.s_addr = htonl (0xac100000 | (n << 8) | (2 + i % 250));
+  return addr;
+}
+
+static void
+test_link_add (u_char **p, struct in_addr id, struct in_addr data,
+	       u_char type, u_int16_t metric)
+{
+  struct router_lsa_link *l = (struct router_lsa_link *) *p;
+
+  l->link_id = id;
+  l->link_data = data;
+  l->m[0].type = type;
+  l->m[0].tos_count = 0;
+  l->m[0].metric = htons (metric);
+  *p += OSPF_ROUTER_LSA_LINK_SIZE;
+}
+
+static void
+test_lsa_install (struct ospf_area *area, struct lsa_header *data)
+{
+  struct ospf_lsa *lsa, *old;
+
+  lsa = ospf_lsa_new ();
+  lsa->data = ospf_lsa_data_dup (data);
+  lsa->area = area;
+  lsa->stat = LSA_SPF_NOT_EXPLORED;
+
+  old = ospf_lsdb_lookup (area->lsdb, lsa);
+  ospf_spf_lsa_index (lsa);
+  ospf_spf_lsa_update (area, old, lsa);
+  ospf_lsdb_add (area->lsdb, lsa);
+  if (old)
+    ospf_lsa_discard (old);
+
+  if (IPV4_ADDR_SAME (&data->id, &area->ospf->router_id)
+      && data->type == OSPF_ROUTER_LSA)
+    {
+      ospf_lsa_unlock (&area->router_lsa_self);
+      area->router_lsa_self = ospf_lsa_lock (lsa);
+    }
+}
+
+static void
+test_header (struct lsa_header *h, u_char type, struct in_addr id,
+	     struct in_addr adv_router, u_int32_t seq, int flushed,
+	     u_char *p)
+{
+  h->ls_age = htons (flushed ? OSPF_LSA_MAXAGE : 0);
+  h->options = 0;
+  h->type = type;
+  h->id = id;
+  h->adv_router = adv_router;
+  h->ls_seqnum = htonl (OSPF_INITIAL_SEQUENCE_NUMBER + seq);
+  h->checksum = 0;
+  h->length = htons (p - (u_char *) h);
+}
+
+static void
+router_install (int i)
+{
+  u_char buf[OSPF_MAX_LSA_SIZE];
+  struct router_lsa *rlsa = (struct router_lsa *) buf;
+  struct test_router *r = &routers[i];
+  struct in_addr addr;
+  u_char *p;
+  int links = 0;
+  int e, k;
+
+  memset (buf, 0, sizeof (buf));
+  p = buf + OSPF_LSA_HEADER_SIZE + 4;
+
+  for (k = 0; k < 2; k++)
+    if (r->nets[k] >= 0)
+      {
+	test_link_add (&p, net_id (r->nets[k]), net_addr (r->nets[k], i),
+		       LSA_LINK_TYPE_TRANSIT, r->net_cost[k]);
+	links++;
+      }
+
+  for (e = 0; e < nedges; e++)
+    if (edges[e].up && (edges[e].a == i || edges[e].b == i))
+      {
+	k = edges[e].b == i;
+	addr.s_addr = htonl (0x0b000000 | (e << 1) | k);
+	test_link_add (&p, router_id (k ? edges[e].a : edges[e].b), addr,
+		       LSA_LINK_TYPE_POINTOPOINT, edges[e].metric[k]);
+	links++;
+      }
+
+  for (k = 0; k < r->stubs; k++)
+    {
+      struct in_addr mask;
+
+      /* The first stubs of every tenth router are the same prefix. */
+      if (k == 0 && i % 10 == 0)
+	addr.s_addr = htonl (0xc0a80000 | ((i / 10) % 5) << 8);
+      else
+	addr.s_addr = htonl (0x64000000 | (i << 8) | (k << 6));
+      mask.s_addr = htonl (k == 0 && i % 10 == 0 ? 0xffffff00 : 0xffffffc0);
+      test_link_add (&p, addr, mask, LSA_LINK_TYPE_STUB, r->stub_metric + k);
+      links++;
+    }
+
+  assert (p <= buf + sizeof (buf));
+  rlsa->flags = r->flags;
+  rlsa->links = htons (links);
+  test_header (&rlsa->header, OSPF_ROUTER_LSA, router_id (i), router_id (i),
+	       r->seq++, r->flushed, p);
+
+  test_lsa_install (areas[0], &rlsa->header);
+  test_lsa_install (areas[1], &rlsa->header);
+}
+
+static void
+network_install (int n)
+{
+  u_char buf[OSPF_MAX_LSA_SIZE];
+  struct network_lsa *nlsa = (struct network_lsa *) buf;
+  struct in_addr *r;
+  u_char *p;
+  int i;
+
+  memset (buf, 0, sizeof (buf));
+  nlsa->mask.s_addr = htonl (0xffffff00);
+  p = buf + OSPF_LSA_HEADER_SIZE + 4;
+  for (i = 0; i < nrouters; i++)
+    if (routers[i].nets[0] == n || routers[i].nets[1] == n)
+      {
+	r = (struct in_addr *) p;
+	*r = router_id (i);
+	p += sizeof (struct in_addr);
+	assert (p <= buf + sizeof (buf));
+      }
+
+  test_header (&nlsa->header, OSPF_NETWORK_LSA, net_id (n),
+	       router_id (n % nrouters), net_seq[n]++, 0, p);
+
+  test_lsa_install (areas[0], &nlsa->header);
+  test_lsa_install (areas[1], &nlsa->header);
+}
+
+/* The calculating router, with a broadcast interface on each of the
+   first two networks. */
+static struct ospf_area *
+test_area_new (void)
+{
+  struct ospf *ospf;
+  struct ospf_area *area;
+  struct ospf_interface *oi;
+  struct in_addr area_id = { .s_addr = 0 };
+  int k;
+
+  ospf = XCALLOC (MTYPE_OSPF_TOP, sizeof (struct ospf));
+  ospf->router_id = router_id (0);
+  ospf->areas = list_new ();
+  ospf->oiflist = list_new ();
+  ospf->vlinks = list_new ();
+  listnode_add (om->ospf, ospf);
+  area = ospf_area_get (ospf, area_id, OSPF_AREA_ID_FORMAT_ADDRESS);
+
+  for (k = 0; k < 2; k++)
+    {
+      oi = XCALLOC (MTYPE_OSPF_IF, sizeof (struct ospf_interface));
+      oi->ifp = XCALLOC (MTYPE_IF, sizeof (struct interface));
+      snprintf (oi->ifp->name, sizeof (oi->ifp->name), "eth%d", k);
+      oi->ifp->ifindex = k + 1;
+      oi->ospf = ospf;
+      oi->area = area;
+      oi->type = OSPF_IFTYPE_BROADCAST;
+      oi->lsa_pos_beg = k;
+      oi->lsa_pos_end = k + 1;
+      listnode_add (area->oiflist, oi);
+    }
+  return area;
+}
+
+static void
+test_area_free (struct ospf_area *area)
+{
+  struct ospf *ospf = area->ospf;
+  struct ospf_interface *oi;
+  struct listnode *node;
+  struct route_node *rn;
+  struct ospf_lsa *lsa;
+
+  ospf_spf_area_finish (area);
+  ospf_lsa_unlock (&area->router_lsa_self);
+  LSDB_LOOP (ROUTER_LSDB (area), rn, lsa)
+    {
+      ospf_lsdb_delete (area->lsdb, lsa);
+      ospf_lsa_discard (lsa);
+    }
+  LSDB_LOOP (NETWORK_LSDB (area), rn, lsa)
+    {
+      ospf_lsdb_delete (area->lsdb, lsa);
+      ospf_lsa_discard (lsa);
+    }
+  ospf_opaque_type10_lsa_term (area);
+  ospf_lsdb_free (area->lsdb);
+
+  for (ALL_LIST_ELEMENTS_RO (area->oiflist, node, oi))
+    {
+      XFREE (MTYPE_IF, oi->ifp);
+      XFREE (MTYPE_OSPF_IF, oi);
+    }
+  list_delete (area->oiflist);
+  route_table_finish (area->ranges);
+  XFREE (MTYPE_OSPF_AREA, area);
+
+  listnode_delete (om->ospf, ospf);
+  list_delete (ospf->areas);
+  list_delete (ospf->oiflist);
+  list_delete (ospf->vlinks);
+  XFREE (MTYPE_OSPF_TOP, ospf);
+}
+
+static void
+test_world (int nr, int nn)
+{
+  int i, e;
+
+  nrouters = nr;
+  nnets = nn;
+  nedges = nr * 2;
+
+  areas[0] = test_area_new ();
+  areas[1] = test_area_new ();
+
+  for (i = 0; i < nrouters; i++)
+    {
+      struct test_router *r = &routers[i];
+
+      memset (r, 0, sizeof (*r));
+      r->stubs = i ? prng_rand (prng) % (TEST_STUBS_MAX + 1) : 0;
+      r->stub_metric = 1 + prng_rand (prng) % 20;
+      r->nets[0] = r->nets[1] = -1;
+      if (i == 0)
+	{
+	  r->nets[0] = 0;
+	  r->nets[1] = 1;
+	}
+      else if (prng_rand (prng) % 3 == 0)
+	r->nets[prng_rand (prng) % 2] = prng_rand (prng) % nnets;
+      r->net_cost[0] = 1 + prng_rand (prng) % 10;
+      r->net_cost[1] = 1 + prng_rand (prng) % 10;
+    }
+  /* Both networks of the calculating router have someone else on. */
+  routers[1].nets[0] = 0;
+  routers[2].nets[0] = 1;
+
+  for (e = 0; e < nedges; e++)
+    {
+      edges[e].a = 1 + prng_rand (prng) % (nrouters - 1);
+      do
+	edges[e].b = 1 + prng_rand (prng) % (nrouters - 1);
+      while (edges[e].b == edges[e].a);
+      edges[e].metric[0] = 1 + prng_rand (prng) % 10;
+      edges[e].metric[1] = 1 + prng_rand (prng) % 10;
+      edges[e].up = 1;
+    }
+
+  for (i = 0; i < nnets; i++)
+    network_install (i);
+  for (i = 0; i < nrouters; i++)
+    router_install (i);
+}
+
+/* One random change to the area. */
+static void
+test_change (void)
+{
+  struct test_router *r;
+  struct test_edge *e;
+  int i, k, old;
+
+  i = 1 + prng_rand (prng) % (nrouters - 1);
+  r = &routers[i];
+  e = &edges[prng_rand (prng) % nedges];
+
+  switch (prng_rand (prng) % 8)
+    {
+    case 0:
+      e->metric[0] = 1 + prng_rand (prng) % 10;
+      router_install (e->a);
+      break;
+    case 1:
+      e->up = !e->up;
+      router_install (e->a);
+      router_install (e->b);
+      break;
+    case 2:
+      k = prng_rand (prng) % 2;
+      old = r->nets[k];
+      r->nets[k] = (old >= 0) ? -1 : (int) (prng_rand (prng) % nnets);
+      router_install (i);
+      network_install (old >= 0 ? old : r->nets[k]);
+      break;
+    case 3:
+      r->stubs = prng_rand (prng) % (TEST_STUBS_MAX + 1);
+      r->stub_metric = 1 + prng_rand (prng) % 20;
+      router_install (i);
+      break;
+    case 4:
+      r->flags ^= (prng_rand (prng) % 2) ? ROUTER_LSA_EXTERNAL
+					  : ROUTER_LSA_BORDER;
+      router_install (i);
+      break;
+    case 5:
+      r->flushed = !r->flushed;
+      router_install (i);
+      break;
+    case 6:
+      router_install (prng_rand (prng) % 4 ? i : 0);
+      break;
+    default:
+      k = prng_rand (prng) % 2;
+      r->net_cost[k] = 1 + prng_rand (prng) % 10;
+      router_install (i);
+      break;
+    }
+}
+
+static int
+test_paths_same (struct list *l1, struct list *l2)
+{
+  struct listnode *n1, *n2;
+  struct ospf_path *p1, *p2;
+
+  if (listcount (l1) != listcount (l2))
+    return 0;
+  for (ALL_LIST_ELEMENTS_RO (l1, n1, p1))
+    {
+      for (ALL_LIST_ELEMENTS_RO (l2, n2, p2))
+	if (IPV4_ADDR_SAME (&p1->nexthop, &p2->nexthop)
+	    && p1->ifindex == p2->ifindex)
+	  break;
+      if (n2 == NULL)
+	return 0;
+    }
+  return 1;
+}
+
+static int
+test_route_same (struct ospf_route *or1, struct ospf_route *or2)
+{
+  return or1->cost == or2->cost
+	 && or1->type == or2->type
+	 && or1->path_type == or2->path_type
+	 && or1->u.std.flags == or2->u.std.flags
+	 && test_paths_same (or1->paths, or2->paths);
+}
+
+/* Networks hold a route, routers a list of them, one per area. */
+static int
+test_tables_same (struct route_table *t1, struct route_table *t2, int rtrs)
+{
+  struct route_node *rn, *rn2;
+  struct listnode *n1, *n2;
+  int count1 = 0, count2 = 0;
+  int same = 1;
+
+  for (rn = route_top (t1); rn; rn = route_next (rn))
+    {
+      if (rn->info == NULL)
+	continue;
+      count1++;
+
+      rn2 = route_node_lookup (t2, &rn->p);
+      if (rn2 == NULL || rn2->info == NULL)
+	{
+	  same = 0;
+	  continue;
+	}
+      route_unlock_node (rn2);
+
+      if (!rtrs)
+	same &= test_route_same (rn->info, rn2->info);
+      else if (listcount ((struct list *) rn->info)
+	       != listcount ((struct list *) rn2->info))
+	same = 0;
+      else
+	for (n1 = listhead ((struct list *) rn->info),
+	     n2 = listhead ((struct list *) rn2->info);
+	     n1; n1 = listnextnode (n1), n2 = listnextnode (n2))
+	  same &= test_route_same (listgetdata (n1), listgetdata (n2));
+    }
+
+  for (rn = route_top (t2); rn; rn = route_next (rn))
+    if (rn->info)
+      count2++;
+
+  return same && count1 == count2;
+}
+
+static int
+test_run (int nr, int nn, int rounds, int bench)
+{
+  struct route_table *tables[2], *rtrs[2];
+  struct timeval start;
+  unsigned long usec[2] = { 0, 0 };
+  int types[OSPF_SPF_FULL + 1] = { 0, 0, 0 };
+  int failed = 0;
+  int round, w, type = 0;
+
+  test_world (nr, nn);
+
+  for (round = 0; round <= rounds; round++)
+    {
+      if (round)
+	{
+	  test_change ();
+	  if (!bench && prng_rand (prng) % 3 == 0)
+	    test_change ();
+	}
+      if (!bench && round % 100 == 50)
+	ospf_spf_tree_flush (areas[0]->ospf);
+
+      for (w = 0; w < 2; w++)
+	{
+	  tables[w] = route_table_init ();
+	  rtrs[w] = route_table_init ();
+	  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+	  type = ospf_spf_calculate_areas (areas[w]->ospf, tables[w], rtrs[w],
+					   w);
+	  if (round)
+	    usec[w] += bench_usec (&start);
+	  if (w == 0 && round)
+	    types[type]++;
+	}
+
+      if (!test_tables_same (tables[0], tables[1], 0)
+	  || !test_tables_same (rtrs[0], rtrs[1], 1))
+	{
+	  if (failed++ < 5)
+	    printf ("round %d: routes differ\n", round);
+	}
+
+      for (w = 0; w < 2; w++)
+	{
+	  ospf_route_table_free (tables[w]);
+	  ospf_rtrs_free (rtrs[w]);
+	}
+    }
+
+  printf ("%d routers, %d networks, %d rounds: %d partial, %d incremental, "
+	  "%d full, %d differences\n", nr, nn, rounds,
+	  types[OSPF_SPF_PARTIAL], types[OSPF_SPF_INCREMENTAL],
+	  types[OSPF_SPF_FULL], failed);
+  if (bench)
+    printf ("incremental %lu ms, from scratch %lu ms\n",
+	    usec[0] / 1000, usec[1] / 1000);
+
+  /* Every kind of calculation was exercised. */
+  if (!bench && (types[OSPF_SPF_PARTIAL] == 0
+		 || types[OSPF_SPF_INCREMENTAL] == 0
+		 || types[OSPF_SPF_FULL] == 0))
+    failed++;
+
+  test_area_free (areas[0]);
+  test_area_free (areas[1]);
+  return failed;
+}
+
+int
+main (void)
+{
+  int failed = 0;
+
+  ospf_master_init ();
+  master = om->master;
+  prng = prng_new (0);
+
+  failed += test_run (TEST_ROUTERS, TEST_NETS, TEST_ROUNDS, 0);
+  failed += test_run (BENCH_ROUTERS, BENCH_NETS, BENCH_ROUNDS, 1);
+
+  prng_free (prng);
+
+  printf ("%s\n", failed ? "failed" : "OK");
+  return failed ? 1 : 0;
+}
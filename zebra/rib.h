@@ -80,6 +80,7 @@ struct rib
 #define RIB_ENTRY_REMOVED	(1 << 0)
 #define RIB_ENTRY_CHANGED	(1 << 1)
 #define RIB_ENTRY_SELECTED_FIB	(1 << 2)
+#define RIB_ENTRY_STALE		(1 << 3)
 
   /* Nexthop information. */
   u_char nexthop_num;
@@ -448,6 +449,8 @@ extern void rib_close_table (struct route_table *);
 extern void rib_close (void);
 extern void rib_init (void);
 extern unsigned long rib_score_proto (u_char proto);
+extern unsigned long rib_mark_stale (u_char proto);
+extern unsigned long rib_sweep_stale (u_char proto);
 
 extern int
 static_add_ipv4_safi (safi_t safi, struct prefix *p, struct in_addr *gate,
@@ -1093,6 +1093,70 @@ rib_uninstall (struct route_node *rn, struct rib *rib)
 
 static void rib_unlink (struct route_node *, struct rib *);
 
+/* The nexthop after 'nexthop', in the order ALL_NEXTHOPS_RO takes. */
+static struct nexthop *
+rib_nexthop_walk (struct nexthop *nexthop, struct nexthop **tnexthop,
+                  int *recursing)
+{
+  if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE))
+    {
+      *recursing = 1;
+      return nexthop->resolved;
+    }
+  if (nexthop->next)
+    return *recursing ? nexthop->next : (*tnexthop = nexthop->next);
+  *recursing = 0;
+  return *tnexthop = (*tnexthop)->next;
+}
+
+/* Whether 'new', sent again by the owner of the stale route 'old' after
+ * a restart, would put in the kernel just what 'old' has there.  If so
+ * 'new' takes over the kernel entry as it is, and the kernel hears
+ * nothing of it.
+ */
+static int
+rib_stale_takeover (struct rib *old, struct rib *new)
+{
+  struct nexthop *onh, *otnh, *nnh, *ntnh;
+  int orecursing, nrecursing;
+
+  if (! CHECK_FLAG (old->status, RIB_ENTRY_STALE)
+      || old->type != new->type
+      || old->mtu != new->mtu
+      || old->nexthop_mtu != new->nexthop_mtu)
+    return 0;
+
+  otnh = onh = old->nexthop;
+  ntnh = nnh = new->nexthop;
+  orecursing = nrecursing = 0;
+  while (onh && nnh)
+    {
+      int installed = (CHECK_FLAG (nnh->flags, NEXTHOP_FLAG_ACTIVE)
+                       && ! CHECK_FLAG (nnh->flags, NEXTHOP_FLAG_RECURSIVE));
+
+      if (! nexthop_same_no_recurse (onh, nnh)
+          || memcmp (&onh->src, &nnh->src, sizeof (onh->src))
+          || ! CHECK_FLAG (onh->flags, NEXTHOP_FLAG_RECURSIVE)
+             != ! CHECK_FLAG (nnh->flags, NEXTHOP_FLAG_RECURSIVE)
+          || ! CHECK_FLAG (onh->flags, NEXTHOP_FLAG_FIB) != ! installed)
+        return 0;
+
+      onh = rib_nexthop_walk (onh, &otnh, &orecursing);
+      nnh = rib_nexthop_walk (nnh, &ntnh, &nrecursing);
+    }
+  if (onh || nnh)
+    return 0;
+
+  for (ALL_NEXTHOPS_RO (old->nexthop, onh, otnh, orecursing))
+    UNSET_FLAG (onh->flags, NEXTHOP_FLAG_FIB);
+  for (ALL_NEXTHOPS_RO (new->nexthop, nnh, ntnh, nrecursing))
+    if (CHECK_FLAG (nnh->flags, NEXTHOP_FLAG_ACTIVE)
+        && ! CHECK_FLAG (nnh->flags, NEXTHOP_FLAG_RECURSIVE))
+      SET_FLAG (nnh->flags, NEXTHOP_FLAG_FIB);
+
+  return 1;
+}
+
 /*
  * rib_can_delete_dest
  *
@@ -1281,7 +1345,9 @@ rib_process (struct route_node *rn)
           {
             /* Install new or replace existing FIB entry */
             SET_FLAG (new_fib->status, RIB_ENTRY_SELECTED_FIB);
-            if (! RIB_SYSTEM_ROUTE (new_fib))
+            if (! RIB_SYSTEM_ROUTE (new_fib)
+                && ! (old_fib && old_fib != new_fib
+                      && rib_stale_takeover (old_fib, new_fib)))
               rib_update_kernel (rn, old_fib, new_fib);
           }
 
@@ -3094,6 +3160,87 @@ rib_score_proto (u_char proto)
   return cnt;
 }
 
+/* Mark routes of type 'proto' stale, for their owner to send again or
+ * have swept, leaving them in the kernel meanwhile. */
+static unsigned long
+rib_mark_stale_table (u_char proto, struct route_table *table)
+{
+  struct route_node *rn;
+  struct rib *rib;
+  unsigned long n = 0;
+
+  if (table)
+    for (rn = route_top (table); rn; rn = route_next (rn))
+      RNODE_FOREACH_RIB (rn, rib)
+        {
+          if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+            continue;
+          if (rib->type == proto)
+            {
+              SET_FLAG (rib->status, RIB_ENTRY_STALE);
+              n++;
+            }
+        }
+
+  return n;
+}
+
+unsigned long
+rib_mark_stale (u_char proto)
+{
+  vrf_iter_t iter;
+  struct zebra_vrf *zvrf;
+  unsigned long cnt = 0;
+
+  for (iter = vrf_first (); iter != VRF_ITER_INVALID; iter = vrf_next (iter))
+    if ((zvrf = vrf_iter2info (iter)) != NULL)
+      cnt += rib_mark_stale_table (proto, zvrf->table[AFI_IP][SAFI_UNICAST])
+            +rib_mark_stale_table (proto, zvrf->table[AFI_IP6][SAFI_UNICAST]);
+
+  return cnt;
+}
+
+/* Remove the stale routes of type 'proto' their owner did not send
+ * again, in one pass over the tables. */
+static unsigned long
+rib_sweep_stale_table (u_char proto, struct route_table *table)
+{
+  struct route_node *rn;
+  struct rib *rib;
+  struct rib *next;
+  unsigned long n = 0;
+
+  if (table)
+    for (rn = route_top (table); rn; rn = route_next (rn))
+      RNODE_FOREACH_RIB_SAFE (rn, rib, next)
+        {
+          if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+            continue;
+          if (rib->type == proto && CHECK_FLAG (rib->status, RIB_ENTRY_STALE))
+            {
+              rib_delnode (rn, rib);
+              n++;
+            }
+        }
+
+  return n;
+}
+
+unsigned long
+rib_sweep_stale (u_char proto)
+{
+  vrf_iter_t iter;
+  struct zebra_vrf *zvrf;
+  unsigned long cnt = 0;
+
+  for (iter = vrf_first (); iter != VRF_ITER_INVALID; iter = vrf_next (iter))
+    if ((zvrf = vrf_iter2info (iter)) != NULL)
+      cnt += rib_sweep_stale_table (proto, zvrf->table[AFI_IP][SAFI_UNICAST])
+            +rib_sweep_stale_table (proto, zvrf->table[AFI_IP6][SAFI_UNICAST]);
+
+  return cnt;
+}
+
 /* Close RIB and clean up kernel routes. */
 void
 rib_close_table (struct route_table *table)
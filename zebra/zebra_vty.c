@@ -2385,28 +2385,79 @@ DEFUN (show_ip_route,
   return do_show_ip_route(vty, SAFI_UNICAST, vrf_id);
 }
 
-static int do_show_ip_route(struct vty *vty, safi_t safi, vrf_id_t vrf_id)
+/* Progress of a "show ip route" that is written out as the vty drains.
+   The table is looked up again on every step, in case the VRF went
+   away in between, and the walk resumes after the last prefix shown. */
+struct show_ip_route_state
+{
+  safi_t safi;
+  vrf_id_t vrf_id;
+  int started;
+  int first;
+  struct prefix last;
+};
+
+static void
+show_ip_route_state_free (void *arg)
+{
+  XFREE (MTYPE_SHOW_ROUTE_STATE, arg);
+}
+
+static int
+show_ip_route_walk (struct vty *vty, void *arg)
 {
+  struct show_ip_route_state *state = arg;
   struct route_table *table;
   struct route_node *rn;
   struct rib *rib;
-  int first = 1;
 
-  table = zebra_vrf_table (AFI_IP, safi, vrf_id);
+  table = zebra_vrf_table (AFI_IP, state->safi, state->vrf_id);
   if (! table)
-    return CMD_SUCCESS;
+    return 0;
+
+  if (state->started)
+    rn = route_table_get_next (table, &state->last);
+  else
+    rn = route_top (table);
+  state->started = 1;
 
   /* Show all IPv4 routes. */
-  for (rn = route_top (table); rn; rn = route_next (rn))
-    RNODE_FOREACH_RIB (rn, rib)
-      {
-	if (first)
-	  {
-	    vty_out (vty, SHOW_ROUTE_V4_HEADER);
-	    first = 0;
-	  }
-	vty_show_ip_route (vty, rn, rib);
-      }
+  for (; rn; rn = route_next (rn))
+    {
+      RNODE_FOREACH_RIB (rn, rib)
+	{
+	  if (state->first)
+	    {
+	      vty_out (vty, SHOW_ROUTE_V4_HEADER);
+	      state->first = 0;
+	    }
+	  vty_show_ip_route (vty, rn, rib);
+	}
+
+      if (vty_output_full (vty))
+	{
+	  prefix_copy (&state->last, &rn->p);
+	  route_unlock_node (rn);
+	  return 1;
+	}
+    }
+  return 0;
+}
+
+static int do_show_ip_route(struct vty *vty, safi_t safi, vrf_id_t vrf_id)
+{
+  struct show_ip_route_state *state;
+
+  state = XCALLOC (MTYPE_SHOW_ROUTE_STATE, sizeof (*state));
+  state->safi = safi;
+  state->vrf_id = vrf_id;
+  state->first = 1;
+
+  if (show_ip_route_walk (vty, state))
+    vty_output_defer (vty, show_ip_route_walk, state,
+		      show_ip_route_state_free);
+  else
+    show_ip_route_state_free (state);
   return CMD_SUCCESS;
 }
 
@@ -76,6 +76,12 @@ zserv_delayed_close(struct thread *thread)
  */
 static int route_type_oaths[ZEBRA_ROUTE_MAX];
 
+/* Routes of a type whose client went away asking us to keep them are
+ * kept, as stale, until it comes back and says it has sent them all
+ * again, or until this timer is up.
+ */
+static struct thread *stale_timers[ZEBRA_ROUTE_MAX];
+
 static int
 zserv_flush_data(struct thread *thread)
 {
@@ -1355,6 +1361,23 @@ zread_router_id_delete (struct zserv *client, u_short length, vrf_id_t vrf_id)
   return 0;
 }
 
+/* Tell a client coming back that its routes from before were kept, as
+   stale, so it can hold off changing them until it has all of its own
+   again. */
+static int
+zsend_stale_kept (struct zserv *client)
+{
+  struct stream *s;
+
+  s = client->obuf;
+  stream_reset (s);
+
+  zserv_create_header (s, ZEBRA_STALE_KEPT, VRF_DEFAULT);
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  return zebra_server_send_message(client);
+}
+
 /* Tie up route-type and client->sock */
 static void
 zread_hello (struct zserv *client)
@@ -1371,16 +1394,57 @@ zread_hello (struct zserv *client)
                     client->sock, zebra_route_string(proto));
 
       /* if route-type was binded by other client */
-      if (route_type_oaths[proto])
+      if (route_type_oaths[proto] && route_type_oaths[proto] != client->sock)
         zlog_warn ("sender of %s routes changed %c->%c",
                     zebra_route_string(proto), route_type_oaths[proto],
                     client->sock);
 
       route_type_oaths[proto] = client->sock;
       client->proto = proto;
+
+      if (STREAM_READABLE (client->ibuf) >= 2)
+        client->stale_time = stream_getw (client->ibuf);
+
+      if (stale_timers[proto])
+        {
+          zlog_notice ("client %d keeps stale %s routes until it has sent "
+                       "them again", client->sock, zebra_route_string(proto));
+          zsend_stale_kept (client);
+        }
     }
 }
 
+/* Remove the stale routes of one type that were not sent again. */
+static void
+zebra_stale_sweep (int proto, const char *why)
+{
+  THREAD_TIMER_OFF (stale_timers[proto]);
+  zlog_notice ("%s, %lu stale %s routes removed from the rib",
+               why, rib_sweep_stale (proto), zebra_route_string (proto));
+}
+
+static int
+zebra_stale_timer (struct thread *thread)
+{
+  int i;
+
+  for (i = 0; i < ZEBRA_ROUTE_MAX; i++)
+    if (stale_timers[i] == thread)
+      {
+        stale_timers[i] = NULL;
+        zebra_stale_sweep (i, "stale time is up");
+      }
+  return 0;
+}
+
+/* The client has sent all its routes again. */
+static void
+zread_stale_sweep (struct zserv *client)
+{
+  if (client->proto && stale_timers[client->proto])
+    zebra_stale_sweep (client->proto, "client has sent its routes again");
+}
+
 /* Unregister all information in a VRF. */
 static int
 zread_vrf_unregister (struct zserv *client, u_short length, vrf_id_t vrf_id)
@@ -1400,15 +1464,26 @@ zread_vrf_unregister (struct zserv *client, u_short length, vrf_id_t vrf_id)
  * and returns number of deleted routes.
  */
 static void
-zebra_score_rib (int client_sock)
+zebra_score_rib (struct zserv *client)
 {
   int i;
 
   for (i = ZEBRA_ROUTE_RIP; i < ZEBRA_ROUTE_MAX; i++)
-    if (client_sock == route_type_oaths[i])
+    if (client->sock == route_type_oaths[i])
       {
-        zlog_notice ("client %d disconnected. %lu %s routes removed from the rib",
-                      client_sock, rib_score_proto (i), zebra_route_string (i));
+        if (client->stale_time)
+          {
+            zlog_notice ("client %d disconnected. %lu %s routes kept stale "
+                         "for %u seconds", client->sock, rib_mark_stale (i),
+                         zebra_route_string (i), client->stale_time);
+            THREAD_TIMER_OFF (stale_timers[i]);
+            stale_timers[i] = thread_add_timer (zebrad.master,
+                                                zebra_stale_timer, NULL,
+                                                client->stale_time);
+          }
+        else
+          zlog_notice ("client %d disconnected. %lu %s routes removed from the rib",
+                        client->sock, rib_score_proto (i), zebra_route_string (i));
         route_type_oaths[i] = 0;
         break;
       }
@@ -1425,7 +1500,7 @@ zebra_client_close (struct zserv *client)
   if (client->sock)
     {
       close (client->sock);
-      zebra_score_rib (client->sock);
+      zebra_score_rib (client);
       client->sock = -1;
     }
 
@@ -1648,6 +1723,9 @@ zebra_client_read (struct thread *thread)
     case ZEBRA_HELLO:
       zread_hello (client);
       break;
+    case ZEBRA_STALE_SWEEP:
+      zread_stale_sweep (client);
+      break;
     case ZEBRA_VRF_UNREGISTER:
       zread_vrf_unregister (client, length, vrf_id);
     case ZEBRA_NEXTHOP_REGISTER:
@@ -71,6 +71,9 @@ struct zserv
   /* client's protocol */
   u_char proto;
 
+  /* Seconds to keep the client's routes, as stale, once it goes. */
+  u_int16_t stale_time;
+
   /* Statistics */
   u_int32_t redist_v4_add_cnt;
   u_int32_t redist_v4_del_cnt;